@@ -16,6 +16,15 @@
 //
 //     vxiiduu               11-Oct-2022  Initial creation.
 //     vxiiduu               06-Nov-2022  Refactor and create KexLdr* section
+//     agent                 17-Oct-2026  Move the VXL file format to VxlFile.h
+//     agent                 17-Oct-2026  Add VXL merge streams
+//     agent                 17-Oct-2026  Add VxlConvertLogEntryTimes
+//     agent                 17-Oct-2026  Read deferred text into a caller buffer
+//     agent                 17-Oct-2026  Add LogCompressed setting
+//     agent                 18-Oct-2026  Add LogMappedWrite setting
+//     agent                 18-Oct-2026  Add LogDeferredFormatting setting
+//     agent                 18-Oct-2026  Say when buffered entries are lost
+//     agent                 18-Oct-2026  Say when processes leave a session
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -79,6 +88,9 @@
 #define KEX_RTL_STRING_MAPPER_CASE_INSENSITIVE_KEYS 1
 #define KEX_RTL_STRING_MAPPER_FLAGS_VALID_MASK (KEX_RTL_STRING_MAPPER_CASE_INSENSITIVE_KEYS)
 
+#define KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE 1
+#define KEX_RTL_STRING_SEARCHER_FLAGS_VALID_MASK (KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE)
+
 //
 // When you define new custom NTSTATUS values, make sure to update the code
 // in status.c to convert it into a string.
@@ -109,6 +121,7 @@
 #define STATUS_KEXSETUP_FAILURE					DEFINE_KEX_NTSTATUS(NTSTATUS_ERROR, 9)
 #define STATUS_IMAGE_SECTION_NOT_FOUND			DEFINE_KEX_NTSTATUS(NTSTATUS_ERROR, 10)
 #define STATUS_DLL_NOT_IN_SYSTEM_ROOT			DEFINE_KEX_NTSTATUS(NTSTATUS_ERROR, 11)
+#define STATUS_TEXT_INDEX_NOT_READY				DEFINE_KEX_NTSTATUS(NTSTATUS_ERROR, 12)
 
 #define KEXDATA_FLAG_PROPAGATED				1	// Indicates that this process was spawned from a VxKex-enabled parent
 #define KEXDATA_FLAG_IFEO_OPTIONS_PRESENT	2	// Indicates that this process has VxKex options set in IFEO
@@ -161,7 +174,110 @@ typedef struct _KEX_RTL_STRING_MAPPER_HASH_TABLE_ENTRY {
 	UNICODE_STRING					Value;
 } TYPEDEF_TYPE_NAME(KEX_RTL_STRING_MAPPER_HASH_TABLE_ENTRY);
 
-#define VXLL_VERSION 1
+// Opaque. See KexDll\strsrch.c.
+typedef struct _KEX_RTL_STRING_SEARCHER TYPEDEF_TYPE_NAME(KEX_RTL_STRING_SEARCHER);
+
+#include <VxlFile.h>
+
+//
+// Flags for VxlOpenLogEx.
+//
+// VXL_OPEN_ASYNCHRONOUS_WRITE
+//   Log entries are placed into per-thread ring buffers and written to the
+//   file in batches by a background thread. Only valid with GENERIC_WRITE.
+//   Call VxlFlushLog to force buffered entries out to the file. KexDll does
+//   this for its own log when the process raises a system error exception
+//   (e.g. an access violation), but entries which are still buffered when a
+//   process is ended with TerminateProcess are lost.
+//
+// VXL_OPEN_MAPPED_WRITE
+//   Instead of calling NtWriteFile for each entry, the log file is grown in
+//   large chunks and entries are copied straight into a mapped view of the
+//   end of the file. Only valid with GENERIC_WRITE.
+//
+// VXL_OPEN_DEFERRED_FORMATTING
+//   Instead of formatting the text of each entry when it is written, store
+//   the format string and a copy of the arguments, and format the text when
+//   the entry is read. Entries whose format strings can't be handled this
+//   way are formatted immediately as usual. Only valid with GENERIC_WRITE.
+//
+// VXL_OPEN_COMPRESSED
+//   Log entries are collected into blocks of up to VXL_BLOCK_SIZE bytes,
+//   and each block is compressed and written to the file as a whole once
+//   it is full. Entries that are still in the current block are written
+//   when VxlFlushLog or VxlCloseLog is called, or, together with
+//   VXL_OPEN_ASYNCHRONOUS_WRITE, by the background thread once the block
+//   has been waiting for a couple of seconds. The file system compression
+//   attribute is not set on new files opened with this flag. Only valid
+//   with GENERIC_WRITE.
+//
+// VXL_OPEN_SESSION
+//   The log file can be shared with other processes, which then append their
+//   entries to the same file (see VxlDuplicateSessionLog and
+//   VxlJoinSessionLog). Entries from different processes are told apart by
+//   their process ID. Writes are serialized between all processes in the
+//   session, so this cannot be combined with VXL_OPEN_MAPPED_WRITE. A
+//   process which can't get its turn within a few seconds leaves the
+//   session and writes to a log file of its own next to the session log
+//   instead. Only valid with GENERIC_WRITE.
+//
+// VXL_OPEN_INCREMENTAL_INDEX
+//   Only the first few thousand entries are indexed when the log is opened.
+//   The rest are indexed by a background thread, or when they are first
+//   read. Once a large log has been fully indexed, the index is saved to a
+//   .vxli file next to it, which is used instead of scanning the log the
+//   next time it is opened, if the log has not changed. Only valid with
+//   GENERIC_READ. Has no effect on version 1 log files.
+//
+// VXL_OPEN_FOLLOW
+//   The log is expected to still be written to while it is being read. Call
+//   VxlWaitForNewEntries to pick up entries which were written after the log
+//   was opened. An empty log may be opened. Implies VXL_OPEN_INCREMENTAL_INDEX.
+//   Only valid with GENERIC_READ. Has no effect on version 1 log files, for
+//   which VxlWaitForNewEntries fails with STATUS_INVALID_OPEN_MODE.
+//
+// VXL_OPEN_TEXT_INDEX
+//   Build an index of the text of the log in the background, which lets
+//   VxlQueryTextIndex find the entries that contain a piece of text without
+//   looking at all of them. The index is saved to a .vxlt file next to the
+//   log, which is used the next time the log is opened, if the log has not
+//   changed. Small logs don't get an index. Implies VXL_OPEN_INCREMENTAL_INDEX.
+//   Only valid with GENERIC_READ. Has no effect on version 1 log files.
+//
+
+#define VXL_OPEN_ASYNCHRONOUS_WRITE		1
+#define VXL_OPEN_MAPPED_WRITE			2
+#define VXL_OPEN_DEFERRED_FORMATTING	4
+#define VXL_OPEN_COMPRESSED				8
+#define VXL_OPEN_SESSION				16
+#define VXL_OPEN_INCREMENTAL_INDEX		32
+#define VXL_OPEN_FOLLOW					64
+#define VXL_OPEN_TEXT_INDEX				128
+#define VXL_OPEN_FLAGS_VALID_MASK		(VXL_OPEN_ASYNCHRONOUS_WRITE | VXL_OPEN_MAPPED_WRITE | \
+										 VXL_OPEN_DEFERRED_FORMATTING | VXL_OPEN_COMPRESSED | \
+										 VXL_OPEN_SESSION | VXL_OPEN_INCREMENTAL_INDEX | \
+										 VXL_OPEN_FOLLOW | VXL_OPEN_TEXT_INDEX)
+#define VXL_OPEN_READ_FLAGS				(VXL_OPEN_INCREMENTAL_INDEX | VXL_OPEN_FOLLOW | VXL_OPEN_TEXT_INDEX)
+
+// Shortest text that VxlQueryTextIndex can look up.
+#define VXL_TEXT_INDEX_MINIMUM_QUERY_CCH	3
+
+// Text buffer for VxlReadLogRange which is big enough for the text of any
+// one entry. Longer text doesn't fit in a UNICODE_STRING anyway.
+#define VXL_READ_TEXT_BUFFER_CCH			0x10000
+
+//
+// Handles which allow another process to write to a session log. They are
+// valid in the process they were duplicated into. Handle values are stored
+// as ULONGs so that the structure is the same size for 32-bit and 64-bit
+// processes.
+//
+
+typedef struct _VXLSESSIONHANDLES {
+	ULONG		FileHandle;
+	ULONG		MutantHandle;			// serializes writes and string definitions
+	ULONG		SectionHandle;			// shared VXLSESSIONDATA
+} TYPEDEF_TYPE_NAME(VXLSESSIONHANDLES);
 
 typedef enum _VXLLOGINFOCLASS {
 	LogLibraryVersion,
@@ -173,67 +289,69 @@ typedef enum _VXLLOGINFOCLASS {
 	LogNumberOfDebugEvents,
 	LogTotalNumberOfEvents,
 	LogSourceApplication,
+	LogNumberOfSourceComponents,
+	LogNumberOfSourceFiles,
+	LogNumberOfSourceFunctions,
+	LogNumberOfIndexedEvents,		// less than LogTotalNumberOfEvents while indexing
 	MaxLogInfoClass
 } VXLLOGINFOCLASS;
 
-typedef enum _VXLSEVERITY {
-	LogSeverityInvalidValue = -1,
-	LogSeverityCritical,
-	LogSeverityError,
-	LogSeverityWarning,
-	LogSeverityInformation,
-	LogSeverityDetail,
-	LogSeverityDebug,
-	LogSeverityMaximumValue
-} VXLSEVERITY;
-
 // All UNICODE_STRINGs in VXLLOGENTRY are guaranteed to be null terminated.
 // So you can pass the buffers directly to Win32 functions.
 typedef struct _VXLLOGENTRY {
 	UNICODE_STRING			TextHeader;
 	UNICODE_STRING			Text;
-	UCHAR					SourceComponentIndex;
-	UCHAR					SourceFileIndex;
-	UCHAR					SourceFunctionIndex;
+	USHORT					SourceComponentIndex;	// see VxlGetSourceString
+	USHORT					SourceFileIndex;
+	USHORT					SourceFunctionIndex;
 	ULONG					SourceLine;
 	CLIENT_ID				ClientId;
 	VXLSEVERITY				Severity;
 	SYSTEMTIME				Time;
 } TYPEDEF_TYPE_NAME(VXLLOGENTRY);
 
-typedef struct _VXLLOGFILEHEADER {
-	CHAR		Magic[4];
-	ULONG		Version;
-	ULONG		EventSeverityTypeCount[LogSeverityMaximumValue];
-	WCHAR		SourceApplication[32];
-	WCHAR		SourceComponents[64][16];
-	WCHAR		SourceFiles[128][16];
-	WCHAR		SourceFunctions[256][64];
-	BOOLEAN		Dirty;
-} TYPEDEF_TYPE_NAME(VXLLOGFILEHEADER);
-
-typedef struct _VXLLOGFILEENTRY {
-	union {
-		FILETIME	Time;
-		LONGLONG	Time64;
-	};
-
-	// Do not directly use CLIENT_ID here since its size varies with
-	// bitness. (contains HANDLE members)
-	ULONG		ProcessId;
-	ULONG		ThreadId;
-
-	VXLSEVERITY	Severity;
-	ULONG		SourceLine;
-	UCHAR		SourceComponentIndex;
-	UCHAR		SourceFileIndex;
-	UCHAR		SourceFunctionIndex;
-
-	USHORT		TextHeaderCch;
-	USHORT		TextCch;
-
-	WCHAR		Text[];
-} TYPEDEF_TYPE_NAME(VXLLOGFILEENTRY);
+// A log entry as returned by VxlReadLogRange. The strings point straight
+// into the log and stay valid until it is closed, unless TextIsTransient is
+// set. The timestamp is left in UTC; convert it with VxlConvertLogEntryTimes.
+//
+// The text of entries written with VXL_OPEN_DEFERRED_FORMATTING isn't in the
+// log. It is formatted into the caller's text buffer, and TextIsTransient is
+// set: the text is only valid until the buffer is used for something else.
+// If no text buffer was given, such text is left empty.
+typedef struct _VXLLOGENTRYVIEW {
+	UNICODE_STRING			TextHeader;
+	UNICODE_STRING			Text;
+	LONGLONG				Time64;
+	USHORT					SourceComponentIndex;
+	USHORT					SourceFileIndex;
+	USHORT					SourceFunctionIndex;
+	ULONG					SourceLine;
+	ULONG					ProcessId;
+	ULONG					ThreadId;
+	VXLSEVERITY				Severity;				// LogSeverityInvalidValue if unreadable
+	BOOLEAN					TextIsTransient;
+} TYPEDEF_TYPE_NAME(VXLLOGENTRYVIEW);
+
+typedef enum _VXLEXPORTFORMAT {
+	VxlExportFormatText,					// UTF-8, laid out like VxlView's text, ISO 8601 local time
+	VxlExportFormatCsv,
+	VxlExportFormatJsonLines,
+	VxlExportFormatMaximum
+} VXLEXPORTFORMAT;
+
+// Return FALSE to cancel the export.
+typedef BOOLEAN (NTAPI *PVXL_EXPORT_PROGRESS_ROUTINE) (
+	IN	PVOID	Context,
+	IN	ULONG	NumberOfEntriesWritten,
+	IN	ULONG	NumberOfEntries);
+
+// An entry returned by VxlReadMergeStream.
+typedef struct _VXLMERGEDENTRY {
+	ULONG					LogIndex;				// which of the logs given to VxlCreateMergeStream
+	ULONG					EntryIndex;				// index of the entry in that log
+} TYPEDEF_TYPE_NAME(VXLMERGEDENTRY);
+
+typedef struct _VXLMERGECONTEXT *TYPEDEF_TYPE_NAME(VXLMERGEHANDLE);
 
 // index cache (EntryIndexToFileOffset) makes reading and sorting the
 // log file faster. Without it, writing the log file is very fast but
@@ -245,11 +363,46 @@ typedef struct _VXLCONTEXT {
 
 	union {
 		PVXLLOGFILEHEADER		Header;
+		PVXLLOGFILEHEADER_V1	HeaderV1;			// only when Header->Version == 1
 		PBYTE					MappedFile;			// only populated in READ ONLY mode, otherwise NULL
 		PVOID					MappedSection;		// ^
 	};
 
+	// source component, file and function names (see vxlsrc.c)
+	struct _VXLSOURCETABLES	*SourceTables;
+
+	// recently formatted text of deferred entries read by VxlReadLog (see vxldefer.c)
+	// only populated in READ ONLY mode, otherwise NULL
+	struct _VXLFORMATTEDTEXTCACHE *FormattedTextCache;
+
 	ULONG					OpenMode;				// GENERIC_READ or GENERIC_WRITE
+	ULONG					Flags;					// VXL_OPEN_*
+
+	// only populated when VXL_OPEN_ASYNCHRONOUS_WRITE was specified, otherwise NULL
+	struct _VXLASYNCCONTEXT	*AsyncContext;
+
+	// only populated when VXL_OPEN_MAPPED_WRITE was specified, otherwise NULL
+	struct _VXLMAPCONTEXT	*MapContext;
+
+	// only populated when VXL_OPEN_COMPRESSED was specified, otherwise NULL
+	struct _VXLBLOCKCONTEXT	*BlockContext;
+
+	// compressed blocks in the file, sorted by entry index (see vxlblock.c)
+	// only populated in READ ONLY mode, otherwise NULL
+	struct _VXLBLOCKINDEXENTRY *Blocks;
+	ULONG					NumberOfBlocks;
+
+	// only populated when VXL_OPEN_SESSION was specified, otherwise NULL
+	struct _VXLSESSIONCONTEXT *SessionContext;
+
+	// only populated when VXL_OPEN_INCREMENTAL_INDEX was specified, otherwise NULL
+	struct _VXLINDEXCONTEXT	*IndexContext;
+
+	// only populated when VXL_OPEN_FOLLOW was specified, otherwise NULL
+	struct _VXLFOLLOWCONTEXT *FollowContext;
+
+	// only populated when VXL_OPEN_TEXT_INDEX was specified, otherwise NULL
+	struct _VXLTEXTINDEXCONTEXT *TextIndexContext;
 } TYPEDEF_TYPE_NAME(VXLCONTEXT);
 
 typedef PVXLCONTEXT TYPEDEF_TYPE_NAME(VXLHANDLE);
@@ -283,6 +436,17 @@ typedef struct _KEX_IFEO_PARAMETERS {
 	ULONG						StrongVersionSpoof;				// KEX_STRONGSPOOF_*
 } TYPEDEF_TYPE_NAME(KEX_IFEO_PARAMETERS);
 
+//
+// Data which a parent process passes down to a child process through
+// Peb->SubSystemData during propagation. The same rule applies as for
+// KEX_IFEO_PARAMETERS.
+//
+
+typedef struct _KEX_PROPAGATED_DATA {
+	KEX_IFEO_PARAMETERS			IfeoParameters;
+	VXLSESSIONHANDLES			SessionLog;						// all zero if there is none
+} TYPEDEF_TYPE_NAME(KEX_PROPAGATED_DATA);
+
 //
 // A KEX_PROCESS_DATA structure for the current process can be obtained
 // outside of KexDll by calling the exported function KexDataInitialize.
@@ -304,6 +468,16 @@ typedef struct _KEX_PROCESS_DATA {
 	HANDLE					BaseNamedObjects;			// object directory handle
 	HANDLE					UntrustedNamedObjects;
 	HANDLE					KsecDD;						// handle to \Device\KsecDD
+	VXLSEVERITY				LogSeverityThreshold;		// least severe event that is logged
+	ULONG					LogMaximumTotalMegabytes;	// 0 = no limit on total log size
+	ULONG					LogMaximumFilesPerImage;	// 0 = no limit on logs per program
+	ULONG					LogMaximumAgeDays;			// 0 = logs are never too old
+	ULONG					LogRingFilesPerImage;		// 0 = don't reuse log files
+	ULONG					LogSessionMode;				// child processes write to our log
+	ULONG					LogAsynchronousWrite;		// 0 = write each log entry immediately
+	ULONG					LogCompressed;				// 0 = don't compress log files
+	ULONG					LogMappedWrite;				// 0 = don't write through a mapped view
+	ULONG					LogDeferredFormatting;		// 0 = format log entries when written
 } TYPEDEF_TYPE_NAME(KEX_PROCESS_DATA);
 
 #pragma endregion
@@ -431,6 +605,18 @@ KEXAPI NTSTATUS NTAPI KexRtlBatchApplyStringMapper(
 	IN OUT	UNICODE_STRING					KeyToValue[],
 	IN		ULONG							KeyToValueCount);
 
+KEXAPI NTSTATUS NTAPI KexRtlCreateStringSearcher(
+	OUT		PPKEX_RTL_STRING_SEARCHER	StringSearcher,
+	IN		PCUNICODE_STRING			Needle,
+	IN		ULONG						Flags OPTIONAL);
+
+KEXAPI NTSTATUS NTAPI KexRtlDeleteStringSearcher(
+	IN		PPKEX_RTL_STRING_SEARCHER	StringSearcher);
+
+KEXAPI PWCHAR NTAPI KexRtlApplyStringSearcher(
+	IN		PKEX_RTL_STRING_SEARCHER	StringSearcher,
+	IN		PCUNICODE_STRING			Haystack);
+
 KEXAPI PIMAGE_SECTION_HEADER NTAPI KexRtlSectionTableFromRva(
 	IN	PIMAGE_NT_HEADERS	NtHeaders,
 	IN	ULONG				ImageRva);
@@ -584,9 +770,47 @@ KEXAPI NTSTATUS NTAPI VxlOpenLog(
 	IN		ACCESS_MASK			DesiredAccess,
 	IN		ULONG				CreateDisposition);
 
+KEXAPI NTSTATUS NTAPI VxlOpenLogEx(
+	OUT		PVXLHANDLE			LogHandle,
+	IN		PUNICODE_STRING		SourceApplication OPTIONAL,
+	IN		POBJECT_ATTRIBUTES	ObjectAttributes,
+	IN		ACCESS_MASK			DesiredAccess,
+	IN		ULONG				CreateDisposition,
+	IN		ULONG				Flags);
+
 KEXAPI NTSTATUS NTAPI VxlCloseLog(
 	IN OUT	PVXLHANDLE		LogHandle);
 
+KEXAPI NTSTATUS NTAPI VxlJoinSessionLog(
+	OUT		PVXLHANDLE			LogHandle,
+	IN		PCVXLSESSIONHANDLES	SessionHandles,
+	IN		ULONG				Flags);
+
+//
+// vxlsess.c
+//
+
+KEXAPI NTSTATUS NTAPI VxlDuplicateSessionLog(
+	IN		VXLHANDLE			LogHandle,
+	IN		HANDLE				ProcessHandle,
+	OUT		PVXLSESSIONHANDLES	SessionHandles);
+
+//
+// vxlasync.c
+//
+
+KEXAPI NTSTATUS NTAPI VxlFlushLog(
+	IN		VXLHANDLE		LogHandle);
+
+//
+// vxlsrc.c
+//
+
+KEXAPI PCWSTR NTAPI VxlGetSourceString(
+	IN		VXLHANDLE		LogHandle,
+	IN		VXLSOURCETYPE	SourceType,
+	IN		ULONG			Index);
+
 //
 // vxlquery.c
 //
@@ -611,8 +835,18 @@ KEXAPI NTSTATUS NTAPI VxlQueryInformationLog(
 		Severity, \
 		__VA_ARGS__)
 
+//
+// Events that are less severe than KexData->LogSeverityThreshold are thrown
+// away before any of the arguments are evaluated. Debug events are not
+// compiled at all in release builds.
+//
+
 #define KexLogEvent(Severity, ...) \
-	VxlWriteLog(KexData->LogHandle, KEX_COMPONENT, Severity, __VA_ARGS__)
+	do { \
+		if ((Severity) <= KexData->LogSeverityThreshold) { \
+			VxlWriteLog(KexData->LogHandle, KEX_COMPONENT, Severity, __VA_ARGS__); \
+		} \
+	} while (0)
 
 #define KexLogCriticalEvent(...)	KexLogEvent(LogSeverityCritical, __VA_ARGS__)
 #define KexLogErrorEvent(...)		KexLogEvent(LogSeverityError, __VA_ARGS__)
@@ -623,7 +857,7 @@ KEXAPI NTSTATUS NTAPI VxlQueryInformationLog(
 #if defined(_DEBUG) || defined(RELEASE_DEBUGLOGS_ENABLED)
 #  define KexLogDebugEvent(...)		KexLogEvent(LogSeverityDebug, __VA_ARGS__)
 #else
-#  define KexLogDebugEvent(...)
+#  define KexLogDebugEvent(...)		do {} while (0)
 #endif
 
 KEXAPI NTSTATUS CDECL VxlWriteLogEx(
@@ -651,6 +885,83 @@ KEXAPI NTSTATUS NTAPI VxlReadMultipleEntriesLog(
 	IN		ULONG			LogEntryIndexEnd,
 	OUT		PVXLLOGENTRY	Entry[]);
 
+KEXAPI NTSTATUS NTAPI VxlReadLogRange(
+	IN		VXLHANDLE			LogHandle,
+	IN		ULONG				FirstEntryIndex,
+	IN		ULONG				NumberOfEntries,
+	OUT		PVXLLOGENTRYVIEW	Views,
+	OUT		PULONG				NumberOfEntriesRead,
+	OUT		PWSTR				TextBuffer OPTIONAL,
+	IN		ULONG				TextBufferCch);
+
+KEXAPI VOID NTAPI VxlConvertLogEntryTime(
+	IN		LONGLONG		Time64,
+	OUT		PSYSTEMTIME		Time);
+
+KEXAPI VOID NTAPI VxlConvertLogEntryTimes(
+	IN		ULONG				NumberOfEntries,
+	IN		PCVXLLOGENTRYVIEW	Views,
+	OUT		PSYSTEMTIME			Times);
+
+//
+// vxltail.c
+//
+
+KEXAPI NTSTATUS NTAPI VxlWaitForNewEntries(
+	IN		VXLHANDLE		LogHandle,
+	IN		ULONG			NumberOfKnownEntries,
+	IN		PLARGE_INTEGER	Timeout OPTIONAL,
+	OUT		PULONG			NumberOfEntries OPTIONAL);
+
+//
+// vxlexprt.c
+//
+
+KEXAPI NTSTATUS NTAPI VxlExportLog(
+	IN	VXLHANDLE						LogHandle,
+	IN	HANDLE							FileHandle,
+	IN	VXLEXPORTFORMAT					Format,
+	IN	PVXL_EXPORT_PROGRESS_ROUTINE	ProgressRoutine OPTIONAL,
+	IN	PVOID							ProgressContext OPTIONAL);
+
+KEXAPI NTSTATUS NTAPI VxlExportMergedLogs(
+	IN	ULONG							NumberOfLogs,
+	IN	PVXLHANDLE						LogHandles,
+	IN	HANDLE							FileHandle,
+	IN	VXLEXPORTFORMAT					Format,
+	IN	PVXL_EXPORT_PROGRESS_ROUTINE	ProgressRoutine OPTIONAL,
+	IN	PVOID							ProgressContext OPTIONAL);
+
+//
+// vxlmerge.c
+//
+
+KEXAPI NTSTATUS NTAPI VxlCreateMergeStream(
+	OUT	PVXLMERGEHANDLE	MergeHandle,
+	IN	ULONG			NumberOfLogs,
+	IN	PVXLHANDLE		LogHandles,
+	OUT	PULONG			NumberOfEntries OPTIONAL);
+
+KEXAPI NTSTATUS NTAPI VxlReadMergeStream(
+	IN	VXLMERGEHANDLE	MergeHandle,
+	IN	ULONG			MaximumNumberOfEntries,
+	OUT	PVXLMERGEDENTRY	Entries,
+	OUT	PULONG			NumberOfEntriesRead);
+
+KEXAPI VOID NTAPI VxlCloseMergeStream(
+	IN OUT	PVXLMERGEHANDLE	MergeHandle);
+
+//
+// vxltext.c
+//
+
+KEXAPI NTSTATUS NTAPI VxlQueryTextIndex(
+	IN		VXLHANDLE			LogHandle,
+	IN		PCUNICODE_STRING	Text,
+	OUT		PPULONG				EntryIndices,
+	OUT		PULONG				NumberOfEntryIndices,
+	OUT		PULONG				NumberOfIndexedEntries);
+
 //
 // vxlsever.c
 //
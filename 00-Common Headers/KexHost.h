@@ -0,0 +1,367 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     KexHost.h
+//
+// Abstract:
+//
+//     Minimal replacement for KexComm.h which allows portable parts of VxKex
+//     (for example, the VXL block compressor) to be built and tested with an
+//     ordinary C compiler on a non-Windows build host.
+//
+//     Source files which can be built this way include this header instead
+//     of their usual headers when KEX_ENV_HOST is defined. Only the types
+//     and macros which are actually used by such files are defined here.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Environment:
+//
+//     Build host (gcc or clang, any operating system).
+//
+// Revision History:
+//
+//     agent                 17-Oct-2026  Initial creation.
+//     agent                 17-Oct-2026  Add what the string search needs.
+//     agent                 17-Oct-2026  Add what the export formatter needs.
+//     agent                 17-Oct-2026  Add what vxltool needs.
+//     agent                 17-Oct-2026  Add SYSTEMTIME.
+//     agent                 17-Oct-2026  Add what the import rewrite engine
+//                                        needs.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#ifndef KEX_ENV_HOST
+#  define KEX_ENV_HOST
+#endif
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST const
+#define STATIC static
+#define INLINE inline
+#define FORCEINLINE inline __attribute__((always_inline))
+#define VOLATILE volatile
+#define EXTERN extern
+#define NTAPI
+
+#define VOID void
+#define TRUE 1
+#define FALSE 0
+
+typedef uint8_t BYTE;
+typedef uint8_t UCHAR;
+typedef char CHAR;
+typedef int16_t SHORT;
+typedef uint16_t USHORT;
+typedef uint16_t WORD;
+typedef uint16_t WCHAR;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef uint32_t DWORD;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef uintptr_t ULONG_PTR;
+typedef size_t SIZE_T;
+typedef uint8_t BOOLEAN;
+typedef LONG NTSTATUS;
+
+#define GEN_STD_TYPEDEFS(Type) \
+	typedef Type *P##Type; \
+	typedef Type **PP##Type; \
+	typedef CONST Type *PC##Type; \
+	typedef CONST Type **PPC##Type
+
+#define TYPEDEF_TYPE_NAME(Type) Type; GEN_STD_TYPEDEFS(Type)
+
+typedef void *PVOID;
+typedef const void *PCVOID;
+typedef PVOID *PPVOID;
+GEN_STD_TYPEDEFS(BYTE);
+GEN_STD_TYPEDEFS(UCHAR);
+GEN_STD_TYPEDEFS(USHORT);
+GEN_STD_TYPEDEFS(WCHAR);
+GEN_STD_TYPEDEFS(ULONG);
+GEN_STD_TYPEDEFS(ULONGLONG);
+GEN_STD_TYPEDEFS(LONGLONG);
+GEN_STD_TYPEDEFS(BOOLEAN);
+typedef WCHAR *PWSTR;
+typedef CONST WCHAR *PCWSTR;
+typedef CHAR *PSTR;
+typedef CONST CHAR *PCSTR;
+
+typedef struct _UNICODE_STRING {
+	USHORT	Length;
+	USHORT	MaximumLength;
+	PWSTR	Buffer;
+} TYPEDEF_TYPE_NAME(UNICODE_STRING);
+
+typedef struct _ANSI_STRING {
+	USHORT	Length;
+	USHORT	MaximumLength;
+	PSTR	Buffer;
+} TYPEDEF_TYPE_NAME(ANSI_STRING);
+
+typedef struct _FILETIME {
+	DWORD	dwLowDateTime;
+	DWORD	dwHighDateTime;
+} FILETIME, *PFILETIME;
+
+typedef struct _SYSTEMTIME {
+	WORD	wYear;
+	WORD	wMonth;
+	WORD	wDayOfWeek;
+	WORD	wDay;
+	WORD	wHour;
+	WORD	wMinute;
+	WORD	wSecond;
+	WORD	wMilliseconds;
+} SYSTEMTIME, *PSYSTEMTIME;
+
+#define NT_SUCCESS(Status) (((NTSTATUS) (Status)) >= 0)
+
+#define STATUS_SUCCESS					((NTSTATUS) 0x00000000L)
+#define STATUS_NO_MORE_ENTRIES			((NTSTATUS) 0x8000001AL)
+#define STATUS_INVALID_PARAMETER		((NTSTATUS) 0xC000000DL)
+#define STATUS_NO_MEMORY				((NTSTATUS) 0xC0000017L)
+#define STATUS_BUFFER_TOO_SMALL			((NTSTATUS) 0xC0000023L)
+#define STATUS_VERSION_MISMATCH			((NTSTATUS) 0xC0000059L)
+#define STATUS_FILE_INVALID				((NTSTATUS) 0xC0000098L)
+#define STATUS_FILE_CORRUPT_ERROR		((NTSTATUS) 0xC0000102L)
+#define STATUS_OPEN_FAILED				((NTSTATUS) 0xC0000136L)
+#define STATUS_NOT_FOUND				((NTSTATUS) 0xC0000225L)
+#define STATUS_BAD_COMPRESSION_BUFFER	((NTSTATUS) 0xC0000242L)
+#define STATUS_INVALID_IMAGE_FORMAT		((NTSTATUS) 0xC000007BL)
+#define STATUS_INSUFFICIENT_RESOURCES	((NTSTATUS) 0xC000009AL)
+
+// From KexDll.h
+#define STATUS_IMAGE_NO_IMPORT_DIRECTORY		((NTSTATUS) 0xE0000000L)
+#define STATUS_STRING_MAPPER_ENTRY_NOT_FOUND	((NTSTATUS) 0xE0000001L)
+
+#define ASSERT(Condition) assert(Condition)
+#define ASSUME(Condition) assert(Condition)
+#define C_ASSERT(Condition) typedef char __C_ASSERT__[(Condition) ? 1 : -1]
+
+#define until(Condition) while (!(Condition))
+#define unless(Condition) if (!(Condition))
+
+#define ANYSIZE_ARRAY 1
+#define ARRAYSIZE(Array) (sizeof(Array) / sizeof((Array)[0]))
+#define FIELD_OFFSET(Type, Field) ((LONG) offsetof(Type, Field))
+
+#define RtlCopyMemory(Destination, Source, Length) memcpy((Destination), (Source), (Length))
+#define RtlMoveMemory(Destination, Source, Length) memmove((Destination), (Source), (Length))
+#define RtlZeroMemory(Destination, Length) memset((Destination), 0, (Length))
+#define RtlFillMemory(Destination, Length, Fill) memset((Destination), (Fill), (Length))
+#define RtlEqualMemory(Source1, Source2, Length) (!memcmp((Source1), (Source2), (Length)))
+
+#ifndef min
+#  define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+#ifndef max
+#  define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define RVA_TO_VA(base, rva) ((PVOID) (((PBYTE) (base)) + (rva)))
+#define VA_TO_RVA(base, va) ((ULONG_PTR) (((PBYTE) (va)) - ((PBYTE) (base))))
+
+#define MAXUSHORT 0xFFFF
+#define MAXULONG 0xFFFFFFFF
+#define PAGE_SIZE 0x1000
+
+#define ToUpper(c) (((c) >= 'a' && (c) <= 'z') ? ((c) - 32) : (c))
+
+//
+// String literals for UNICODE_STRINGs. WCHAR is 16 bits, like on Windows,
+// so these need u"" strings (C11) instead of L"" ones.
+//
+
+#define _L(str) u##str
+#define RTL_CONSTANT_STRING(s) { sizeof( s ) - sizeof( (s)[0] ), sizeof( s ), s }
+#define RtlInitEmptyUnicodeString(UnicodeString, InitBuffer, BufferCb) \
+	((UnicodeString)->Buffer = (InitBuffer), \
+	 (UnicodeString)->Length = 0, \
+	 (UnicodeString)->MaximumLength = (USHORT) (BufferCb))
+
+#define KexRtlUnicodeStringCch(UnicodeString) ((UnicodeString)->Length / sizeof(WCHAR))
+#define WELL_FORMED_UNICODE_STRING(s) ((s) != NULL && !((s)->Length & 1) && !((s)->MaximumLength & 1) && ((s)->Length <= (s)->MaximumLength))
+#define VALID_UNICODE_STRING(s) (WELL_FORMED_UNICODE_STRING(s) && (s)->Buffer != NULL && (s)->MaximumLength != 0)
+
+//
+// PE image structures, as in winnt.h.
+//
+
+#define IMAGE_DOS_SIGNATURE					0x5A4D
+#define IMAGE_NT_SIGNATURE					0x00004550
+#define IMAGE_NT_OPTIONAL_HDR32_MAGIC		0x10B
+#define IMAGE_NT_OPTIONAL_HDR64_MAGIC		0x20B
+#define IMAGE_NUMBEROF_DIRECTORY_ENTRIES	16
+#define IMAGE_SIZEOF_SHORT_NAME				8
+
+#define IMAGE_DIRECTORY_ENTRY_IMPORT		1
+#define IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT	11
+
+#define IMAGE_FILE_MACHINE_I386				0x014C
+#define IMAGE_FILE_MACHINE_AMD64			0x8664
+
+#define IMAGE_SCN_MEM_EXECUTE				0x20000000
+#define IMAGE_SCN_MEM_READ					0x40000000
+#define IMAGE_SCN_MEM_WRITE					0x80000000
+
+typedef struct _IMAGE_DOS_HEADER {
+	WORD	e_magic;
+	WORD	e_cblp;
+	WORD	e_cp;
+	WORD	e_crlc;
+	WORD	e_cparhdr;
+	WORD	e_minalloc;
+	WORD	e_maxalloc;
+	WORD	e_ss;
+	WORD	e_sp;
+	WORD	e_csum;
+	WORD	e_ip;
+	WORD	e_cs;
+	WORD	e_lfarlc;
+	WORD	e_ovno;
+	WORD	e_res[4];
+	WORD	e_oemid;
+	WORD	e_oeminfo;
+	WORD	e_res2[10];
+	LONG	e_lfanew;
+} IMAGE_DOS_HEADER, *PIMAGE_DOS_HEADER;
+
+typedef struct _IMAGE_FILE_HEADER {
+	WORD	Machine;
+	WORD	NumberOfSections;
+	DWORD	TimeDateStamp;
+	DWORD	PointerToSymbolTable;
+	DWORD	NumberOfSymbols;
+	WORD	SizeOfOptionalHeader;
+	WORD	Characteristics;
+} IMAGE_FILE_HEADER, *PIMAGE_FILE_HEADER;
+
+typedef struct _IMAGE_DATA_DIRECTORY {
+	DWORD	VirtualAddress;
+	DWORD	Size;
+} IMAGE_DATA_DIRECTORY, *PIMAGE_DATA_DIRECTORY;
+
+typedef struct _IMAGE_OPTIONAL_HEADER32 {
+	WORD					Magic;
+	BYTE					MajorLinkerVersion;
+	BYTE					MinorLinkerVersion;
+	DWORD					SizeOfCode;
+	DWORD					SizeOfInitializedData;
+	DWORD					SizeOfUninitializedData;
+	DWORD					AddressOfEntryPoint;
+	DWORD					BaseOfCode;
+	DWORD					BaseOfData;
+	DWORD					ImageBase;
+	DWORD					SectionAlignment;
+	DWORD					FileAlignment;
+	WORD					MajorOperatingSystemVersion;
+	WORD					MinorOperatingSystemVersion;
+	WORD					MajorImageVersion;
+	WORD					MinorImageVersion;
+	WORD					MajorSubsystemVersion;
+	WORD					MinorSubsystemVersion;
+	DWORD					Win32VersionValue;
+	DWORD					SizeOfImage;
+	DWORD					SizeOfHeaders;
+	DWORD					CheckSum;
+	WORD					Subsystem;
+	WORD					DllCharacteristics;
+	DWORD					SizeOfStackReserve;
+	DWORD					SizeOfStackCommit;
+	DWORD					SizeOfHeapReserve;
+	DWORD					SizeOfHeapCommit;
+	DWORD					LoaderFlags;
+	DWORD					NumberOfRvaAndSizes;
+	IMAGE_DATA_DIRECTORY	DataDirectory[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+} IMAGE_OPTIONAL_HEADER32, *PIMAGE_OPTIONAL_HEADER32;
+
+typedef struct _IMAGE_OPTIONAL_HEADER64 {
+	WORD					Magic;
+	BYTE					MajorLinkerVersion;
+	BYTE					MinorLinkerVersion;
+	DWORD					SizeOfCode;
+	DWORD					SizeOfInitializedData;
+	DWORD					SizeOfUninitializedData;
+	DWORD					AddressOfEntryPoint;
+	DWORD					BaseOfCode;
+	ULONGLONG				ImageBase;
+	DWORD					SectionAlignment;
+	DWORD					FileAlignment;
+	WORD					MajorOperatingSystemVersion;
+	WORD					MinorOperatingSystemVersion;
+	WORD					MajorImageVersion;
+	WORD					MinorImageVersion;
+	WORD					MajorSubsystemVersion;
+	WORD					MinorSubsystemVersion;
+	DWORD					Win32VersionValue;
+	DWORD					SizeOfImage;
+	DWORD					SizeOfHeaders;
+	DWORD					CheckSum;
+	WORD					Subsystem;
+	WORD					DllCharacteristics;
+	ULONGLONG				SizeOfStackReserve;
+	ULONGLONG				SizeOfStackCommit;
+	ULONGLONG				SizeOfHeapReserve;
+	ULONGLONG				SizeOfHeapCommit;
+	DWORD					LoaderFlags;
+	DWORD					NumberOfRvaAndSizes;
+	IMAGE_DATA_DIRECTORY	DataDirectory[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+} IMAGE_OPTIONAL_HEADER64, *PIMAGE_OPTIONAL_HEADER64;
+
+typedef struct _IMAGE_NT_HEADERS32 {
+	DWORD					Signature;
+	IMAGE_FILE_HEADER		FileHeader;
+	IMAGE_OPTIONAL_HEADER32	OptionalHeader;
+} IMAGE_NT_HEADERS32, *PIMAGE_NT_HEADERS32;
+
+typedef struct _IMAGE_NT_HEADERS64 {
+	DWORD					Signature;
+	IMAGE_FILE_HEADER		FileHeader;
+	IMAGE_OPTIONAL_HEADER64	OptionalHeader;
+} IMAGE_NT_HEADERS64, *PIMAGE_NT_HEADERS64;
+
+typedef struct _IMAGE_SECTION_HEADER {
+	BYTE	Name[IMAGE_SIZEOF_SHORT_NAME];
+
+	union {
+		DWORD	PhysicalAddress;
+		DWORD	VirtualSize;
+	} Misc;
+
+	DWORD	VirtualAddress;
+	DWORD	SizeOfRawData;
+	DWORD	PointerToRawData;
+	DWORD	PointerToRelocations;
+	DWORD	PointerToLinenumbers;
+	WORD	NumberOfRelocations;
+	WORD	NumberOfLinenumbers;
+	DWORD	Characteristics;
+} IMAGE_SECTION_HEADER, *PIMAGE_SECTION_HEADER;
+
+typedef struct _IMAGE_IMPORT_DESCRIPTOR {
+	union {
+		DWORD	Characteristics;
+		DWORD	OriginalFirstThunk;
+	};
+
+	DWORD	TimeDateStamp;
+	DWORD	ForwarderChain;
+	DWORD	Name;
+	DWORD	FirstThunk;
+} IMAGE_IMPORT_DESCRIPTOR, *PIMAGE_IMPORT_DESCRIPTOR;
\ No newline at end of file
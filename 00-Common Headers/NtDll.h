@@ -25,6 +25,8 @@
 //
 //     vxiiduu               26-Mar-2022  Initial creation.
 //     vxiiduu               26-Sep-2022  Add header.
+//     agent                 18-Oct-2026  Add RtlAddVectoredExceptionHandler.
+//     agent                 18-Oct-2026  Add owner, ACE and SID functions.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -3173,6 +3175,16 @@ NTSYSCALLAPI NTSTATUS NTAPI NtReleaseSemaphore(
 	IN		LONG						ReleaseCount,
 	OUT		PLONG						PreviousCount OPTIONAL);
 
+NTSYSCALLAPI NTSTATUS NTAPI NtCreateMutant(
+	OUT		PHANDLE				MutantHandle,
+	IN		ACCESS_MASK			DesiredAccess,
+	IN		POBJECT_ATTRIBUTES	ObjectAttributes OPTIONAL,
+	IN		BOOLEAN				InitialOwner);
+
+NTSYSCALLAPI NTSTATUS NTAPI NtReleaseMutant(
+	IN		HANDLE				MutantHandle,
+	OUT		PLONG				PreviousCount OPTIONAL);
+
 typedef VOID (NTAPI *PIO_APC_ROUTINE) (
 	IN		PVOID				ApcContext,
 	IN		PIO_STATUS_BLOCK	IoStatusBlock,
@@ -3221,6 +3233,25 @@ NTSYSCALLAPI NTSTATUS NTAPI NtWriteFile(
 	IN		PLONGLONG			ByteOffset OPTIONAL,
 	IN		PULONG				Key OPTIONAL);
 
+NTSYSCALLAPI NTSTATUS NTAPI NtLockFile(
+	IN		HANDLE				FileHandle,
+	IN		HANDLE				Event OPTIONAL,
+	IN		PIO_APC_ROUTINE		ApcRoutine OPTIONAL,
+	IN		PVOID				ApcContext OPTIONAL,
+	OUT		PIO_STATUS_BLOCK	IoStatusBlock,
+	IN		PLONGLONG			ByteOffset,
+	IN		PLONGLONG			Length,
+	IN		ULONG				Key,
+	IN		BOOLEAN				FailImmediately,
+	IN		BOOLEAN				ExclusiveLock);
+
+NTSYSCALLAPI NTSTATUS NTAPI NtUnlockFile(
+	IN		HANDLE				FileHandle,
+	OUT		PIO_STATUS_BLOCK	IoStatusBlock,
+	IN		PLONGLONG			ByteOffset,
+	IN		PLONGLONG			Length,
+	IN		ULONG				Key);
+
 NTSYSCALLAPI NTSTATUS NTAPI NtFsControlFile(
 	IN		HANDLE				FileHandle,
 	IN		HANDLE				Event OPTIONAL,
@@ -3677,6 +3708,17 @@ NTSYSCALLAPI NTSTATUS NTAPI NtQueryDirectoryFile(
 	IN		PUNICODE_STRING				FileName OPTIONAL,
 	IN		BOOLEAN						RestartScan);
 
+NTSYSCALLAPI NTSTATUS NTAPI NtNotifyChangeDirectoryFile(
+	IN		HANDLE						DirectoryHandle,
+	IN		HANDLE						Event OPTIONAL,
+	IN		PIO_APC_ROUTINE				ApcRoutine OPTIONAL,
+	IN		PVOID						ApcContext OPTIONAL,
+	OUT		PIO_STATUS_BLOCK			IoStatusBlock,
+	OUT		PVOID						Buffer,
+	IN		ULONG						Length,
+	IN		ULONG						CompletionFilter,
+	IN		BOOLEAN						WatchTree);
+
 NTSYSCALLAPI NTSTATUS NTAPI NtCreateEvent(
 	OUT		PHANDLE				EventHandle,
 	IN		ACCESS_MASK			DesiredAccess,
@@ -3778,6 +3820,13 @@ NTSYSCALLAPI NTSTATUS NTAPI NtQueryDefaultLocale(
 	IN		BOOLEAN		UserProfile,
     OUT		PLCID		DefaultUILanguageId);
 
+NTSYSCALLAPI NTSTATUS NTAPI NtQueryPerformanceCounter(
+	OUT		PLONGLONG	PerformanceCounter,
+	OUT		PLONGLONG	PerformanceFrequency OPTIONAL);
+
+NTSYSCALLAPI NTSTATUS NTAPI NtYieldExecution(
+	VOID);
+
 #pragma endregion
 
 #pragma region Nt* function declarations (not in Windows 7)
@@ -4250,6 +4299,10 @@ NTSYSAPI VOID NTAPI RtlGetNtVersionNumbers(
 NTSYSAPI VOID NTAPI RtlRaiseStatus(
 	IN	NTSTATUS	Status);
 
+NTSYSAPI PVOID NTAPI RtlAddVectoredExceptionHandler(
+	IN	ULONG						First,
+	IN	PVECTORED_EXCEPTION_HANDLER	Handler);
+
 NTSYSAPI BOOLEAN NTAPI RtlSetCurrentTransaction(
 	IN	HANDLE	TransactionHandle);
 
@@ -4391,6 +4444,12 @@ NTSYSAPI NTSTATUS NTAPI RtlAddMandatoryAce(
 	IN		UCHAR	AceType,
 	IN		ULONG	AccessMask);
 
+NTSYSAPI NTSTATUS NTAPI RtlAddAccessAllowedAce(
+	IN OUT	PACL		Acl,
+	IN		ULONG		AceRevision,
+	IN		ACCESS_MASK	AccessMask,
+	IN		PSID		Sid);
+
 NTSYSAPI NTSTATUS NTAPI RtlCreateSecurityDescriptor(
 	OUT		PSECURITY_DESCRIPTOR	SecurityDescriptor,
 	IN		ULONG					Revision);
@@ -4407,9 +4466,36 @@ NTSYSAPI NTSTATUS NTAPI RtlSetSaclSecurityDescriptor(
 	IN		PACL					Sacl OPTIONAL,
 	IN		BOOLEAN					SaclDefaulted);
 
+NTSYSAPI NTSTATUS NTAPI RtlSetOwnerSecurityDescriptor(
+	IN OUT	PSECURITY_DESCRIPTOR	SecurityDescriptor,
+	IN		PSID					Owner OPTIONAL,
+	IN		BOOLEAN					OwnerDefaulted);
+
+NTSYSAPI NTSTATUS NTAPI RtlGetOwnerSecurityDescriptor(
+	IN		PSECURITY_DESCRIPTOR	SecurityDescriptor,
+	OUT		PSID					*Owner,
+	OUT		PBOOLEAN				OwnerDefaulted);
+
+NTSYSAPI NTSTATUS NTAPI RtlSetControlSecurityDescriptor(
+	IN OUT	PSECURITY_DESCRIPTOR		SecurityDescriptor,
+	IN		SECURITY_DESCRIPTOR_CONTROL	ControlBitsOfInterest,
+	IN		SECURITY_DESCRIPTOR_CONTROL	ControlBitsToSet);
+
 NTSYSAPI BOOLEAN NTAPI RtlValidSid(
 	IN	PSID	Sid);
 
+NTSYSAPI BOOLEAN NTAPI RtlEqualSid(
+	IN	PSID	Sid1,
+	IN	PSID	Sid2);
+
+NTSYSAPI ULONG NTAPI RtlLengthSid(
+	IN	PSID	Sid);
+
+NTSYSAPI NTSTATUS NTAPI RtlConvertSidToUnicodeString(
+	OUT	PUNICODE_STRING	UnicodeString,
+	IN	PSID			Sid,
+	IN	BOOLEAN			AllocateDestinationString);
+
 NTSYSAPI PULONG NTAPI RtlSubAuthoritySid(
 	IN	PSID	Sid,
 	IN	ULONG	SubAuthority);
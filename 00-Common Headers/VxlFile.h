@@ -0,0 +1,223 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     VxlFile.h
+//
+// Abstract:
+//
+//     On-disk format of VXL log files.
+//
+//     This header is included by KexDll.h, and also by tools which read log
+//     files on a non-Windows host (with KEX_ENV_HOST defined and KexHost.h
+//     included first), so it must not depend on anything except the basic
+//     types.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation (moved from KexDll.h).
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//
+// Version history of the log file format:
+//
+//   1: Original format. Source component, file and function names are
+//      stored in fixed size tables in the header (VXLLOGFILEHEADER_V1).
+//   2: Compact header with HeaderSize and CommittedLength. The file is a
+//      stream of records (VXLLOGFILERECORD). Source names are defined by
+//      VXLLOGFILESTRING records which always come before the first log
+//      entry that refers to them.
+//      A reader must never look at data at or beyond CommittedLength,
+//      since the file may be allocated in advance of the data that is
+//      actually written to it.
+//
+
+#define VXLL_VERSION 2
+#define VXLL_V1_HEADER_SIZE (sizeof(VXLLOGFILEHEADER_V1))
+
+typedef enum _VXLSOURCETYPE {
+	VxlSourceComponent,
+	VxlSourceFile,
+	VxlSourceFunction,
+	VxlSourceFormat,						// format strings of deferred entries
+	VxlSourceMaximum
+} VXLSOURCETYPE;
+
+typedef enum _VXLSEVERITY {
+	LogSeverityInvalidValue = -1,
+	LogSeverityCritical,
+	LogSeverityError,
+	LogSeverityWarning,
+	LogSeverityInformation,
+	LogSeverityDetail,
+	LogSeverityDebug,
+	LogSeverityMaximumValue
+} VXLSEVERITY;
+
+typedef struct _VXLLOGFILEHEADER {
+	CHAR		Magic[4];
+	ULONG		Version;
+	ULONG		EventSeverityTypeCount[LogSeverityMaximumValue];
+	WCHAR		SourceApplication[32];
+	BOOLEAN		Dirty;
+	ULONG		HeaderSize;				// file offset of the first record
+	ULONGLONG	CommittedLength;		// file offset one past the last complete record
+} TYPEDEF_TYPE_NAME(VXLLOGFILEHEADER);
+
+#define VXL_RECORD_LOG_ENTRY			1
+#define VXL_RECORD_SOURCE_STRING		2
+#define VXL_RECORD_DEFERRED_LOG_ENTRY	3
+#define VXL_RECORD_COMPRESSED_BLOCK		4
+
+// Unknown record types should be skipped.
+typedef struct _VXLLOGFILERECORD {
+	USHORT		RecordType;				// VXL_RECORD_*
+	USHORT		RecordSize;				// including this header
+} TYPEDEF_TYPE_NAME(VXLLOGFILERECORD);
+
+typedef struct _VXLLOGFILEENTRY {
+	USHORT		RecordType;				// VXL_RECORD_LOG_ENTRY
+	USHORT		RecordSize;
+
+	// Do not directly use CLIENT_ID here since its size varies with
+	// bitness. (contains HANDLE members)
+	ULONG		ProcessId;
+
+	union {
+		FILETIME	Time;
+		LONGLONG	Time64;
+	};
+
+	ULONG		ThreadId;
+	VXLSEVERITY	Severity;
+	ULONG		SourceLine;
+	UCHAR		SourceComponentIndex;
+	UCHAR		Reserved;
+	USHORT		SourceFileIndex;
+	USHORT		SourceFunctionIndex;
+
+	USHORT		TextHeaderCch;
+	USHORT		TextCch;
+
+	WCHAR		Text[];
+} TYPEDEF_TYPE_NAME(VXLLOGFILEENTRY);
+
+//
+// A log entry whose text has not been formatted yet. Everything up to and
+// including SourceFunctionIndex is the same as in VXLLOGFILEENTRY.
+// Arguments is a sequence of VXLDEFERREDARGUMENT structures, one for each
+// argument consumed by the format string, in order.
+//
+
+typedef struct _VXLLOGFILEDEFERREDENTRY {
+	USHORT		RecordType;				// VXL_RECORD_DEFERRED_LOG_ENTRY
+	USHORT		RecordSize;
+	ULONG		ProcessId;
+
+	union {
+		FILETIME	Time;
+		LONGLONG	Time64;
+	};
+
+	ULONG		ThreadId;
+	VXLSEVERITY	Severity;
+	ULONG		SourceLine;
+	UCHAR		SourceComponentIndex;
+	UCHAR		Reserved;
+	USHORT		SourceFileIndex;
+	USHORT		SourceFunctionIndex;
+
+	USHORT		FormatIndex;			// index of a VxlSourceFormat string
+	USHORT		ArgumentsCb;
+
+	BYTE		Arguments[];
+} TYPEDEF_TYPE_NAME(VXLLOGFILEDEFERREDENTRY);
+
+#define VXL_ARGUMENT_INT32				1	// Data is a LONG
+#define VXL_ARGUMENT_INT64				2	// Data is a LONGLONG (also used for doubles)
+#define VXL_ARGUMENT_POINTER			3	// Data is a ULONGLONG; pointer-sized integers too
+#define VXL_ARGUMENT_NULL_POINTER		4	// a NULL string pointer; no Data
+#define VXL_ARGUMENT_WIDE_STRING		5	// Data is a null terminated WCHAR string
+#define VXL_ARGUMENT_ANSI_STRING		6	// Data is a null terminated CHAR string
+#define VXL_ARGUMENT_UNICODE_STRING		7	// Data is the contents of a UNICODE_STRING
+#define VXL_ARGUMENT_ANSI_COUNTED		8	// Data is the contents of an ANSI_STRING
+
+// Each argument is padded to a multiple of 2 bytes.
+typedef struct _VXLDEFERREDARGUMENT {
+	UCHAR		Type;					// VXL_ARGUMENT_*
+	UCHAR		Reserved;
+	USHORT		DataCb;
+	BYTE		Data[];
+} TYPEDEF_TYPE_NAME(VXLDEFERREDARGUMENT);
+
+// Size of an argument, including its header and padding.
+#define VXL_ARGUMENT_SIZE(DataCb) (((FIELD_OFFSET(VXLDEFERREDARGUMENT, Data) + (DataCb)) + 1) & ~1)
+
+//
+// A block of log entry records (VXL_RECORD_LOG_ENTRY and
+// VXL_RECORD_DEFERRED_LOG_ENTRY) which are compressed together. Source string
+// records are never put into a block. Data is in the LZ4 block format, or it
+// is stored as-is if DataCb == UncompressedCb.
+//
+
+#define VXL_BLOCK_SIZE					0xF000
+
+typedef struct _VXLLOGFILEBLOCK {
+	USHORT		RecordType;				// VXL_RECORD_COMPRESSED_BLOCK
+	USHORT		RecordSize;
+	USHORT		DataCb;
+	USHORT		UncompressedCb;			// no more than VXL_BLOCK_SIZE
+	ULONG		EntryCount;				// number of log entries in the block
+	BYTE		Data[];
+} TYPEDEF_TYPE_NAME(VXLLOGFILEBLOCK);
+
+typedef struct _VXLLOGFILESTRING {
+	USHORT		RecordType;				// VXL_RECORD_SOURCE_STRING
+	USHORT		RecordSize;
+	USHORT		SourceType;				// VXLSOURCETYPE
+	USHORT		Index;					// always the next unused index for SourceType
+	WCHAR		String[];				// null terminated
+} TYPEDEF_TYPE_NAME(VXLLOGFILESTRING);
+
+//
+// Version 1 structures. These are only used to read old log files.
+//
+
+typedef struct _VXLLOGFILEHEADER_V1 {
+	CHAR		Magic[4];
+	ULONG		Version;
+	ULONG		EventSeverityTypeCount[LogSeverityMaximumValue];
+	WCHAR		SourceApplication[32];
+	WCHAR		SourceComponents[64][16];
+	WCHAR		SourceFiles[128][16];
+	WCHAR		SourceFunctions[256][64];
+	BOOLEAN		Dirty;
+} TYPEDEF_TYPE_NAME(VXLLOGFILEHEADER_V1);
+
+typedef struct _VXLLOGFILEENTRY_V1 {
+	union {
+		FILETIME	Time;
+		LONGLONG	Time64;
+	};
+
+	ULONG		ProcessId;
+	ULONG		ThreadId;
+
+	VXLSEVERITY	Severity;
+	ULONG		SourceLine;
+	UCHAR		SourceComponentIndex;
+	UCHAR		SourceFileIndex;
+	UCHAR		SourceFunctionIndex;
+
+	USHORT		TextHeaderCch;
+	USHORT		TextCch;
+
+	WCHAR		Text[];
+} TYPEDEF_TYPE_NAME(VXLLOGFILEENTRY_V1);
\ No newline at end of file
@@ -0,0 +1,541 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     redirgen.c
+//
+// Abstract:
+//
+//     Generates the DLL redirect table (KexDll/redirtbl.h) from the list of
+//     redirects in KexDll/redirects.h.
+//
+//     The redirect table is a minimal perfect hash over the DLL names, so
+//     that KexDll can look a name up with one hash, one probe and one compare
+//     in read-only data, instead of building a hash table at every process
+//     start. Finding the hash parameters takes a search, which is done here
+//     on the build host. See redirhash.h for the hash itself.
+//
+//     It only uses the C library, so it can be built on the build host as
+//     well as on Windows under Cygwin or MSYS2.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Also generate an ANSI copy of the table.
+//     agent                17-Oct-2026  Generate a version number for the table.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <KexHost.h>
+#include "redirhash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <ctype.h>
+
+// DLL names are short. This is only a limit on what redirects.h can contain.
+#define REDIRECT_MAXIMUM_NAME_CCH		64
+#define REDIRECT_MAXIMUM_ENTRIES		4096
+#define REDIRECT_MAXIMUM_SEEDS			100000
+
+// Values are lined up in the generated table, like in redirects.h.
+#define REDIRECT_KEY_COLUMN_WIDTH		REDIRECT_MAXIMUM_NAME_CCH
+
+typedef struct _REDIRECT {
+	CHAR		Key[REDIRECT_MAXIMUM_NAME_CCH + 1];
+	CHAR		Value[REDIRECT_MAXIMUM_NAME_CCH + 1];
+	ULONG		Line;
+	ULONG		Hash;
+} TYPEDEF_TYPE_NAME(REDIRECT);
+
+STATIC REDIRECT Redirects[REDIRECT_MAXIMUM_ENTRIES];
+STATIC ULONG NumberOfRedirects;
+
+STATIC ULONG Seed;
+STATIC ULONG NumberOfBuckets;
+STATIC USHORT Displacements[REDIRECT_MAXIMUM_ENTRIES];
+STATIC ULONG SlotRedirect[REDIRECT_MAXIMUM_ENTRIES];
+
+STATIC ULONG HashName(
+	IN	PCSTR	Name,
+	IN	ULONG	HashSeed)
+{
+	WCHAR Buffer[REDIRECT_MAXIMUM_NAME_CCH];
+	ULONG Index;
+
+	for (Index = 0; Name[Index] != '\0'; ++Index) {
+		Buffer[Index] = (UCHAR) Name[Index];
+	}
+
+	return KexHashDllRedirectKey(Buffer, Index, HashSeed);
+}
+
+//
+// Read a quoted string at Position. Returns a pointer to the character after
+// the closing quote, or NULL if there isn't a valid string there.
+//
+
+STATIC PCSTR ReadQuotedName(
+	IN	PCSTR	Position,
+	OUT	PSTR	Name)
+{
+	ULONG Cch;
+
+	while (isspace((UCHAR) *Position)) {
+		++Position;
+	}
+
+	if (*Position++ != '"') {
+		return NULL;
+	}
+
+	for (Cch = 0; *Position != '"'; ++Cch, ++Position) {
+		// DLL names in an import table are ANSI, and the lookup only folds
+		// ASCII letters, so nothing else may be used.
+		if (Cch == REDIRECT_MAXIMUM_NAME_CCH || *Position == '\0' ||
+			*Position == '\\' || (UCHAR) *Position < 0x20 || (UCHAR) *Position >= 0x7F) {
+
+			return NULL;
+		}
+
+		Name[Cch] = *Position;
+	}
+
+	Name[Cch] = '\0';
+	return (Cch != 0) ? Position + 1 : NULL;
+}
+
+STATIC BOOLEAN ReadRedirects(
+	IN	PCSTR	FileName)
+{
+	FILE *File;
+	CHAR LineBuffer[1024];
+	ULONG LineNumber;
+	BOOLEAN Success;
+
+	File = fopen(FileName, "r");
+
+	if (!File) {
+		perror(FileName);
+		return FALSE;
+	}
+
+	LineNumber = 0;
+	Success = TRUE;
+
+	while (fgets(LineBuffer, sizeof(LineBuffer), File)) {
+		PCSTR Position;
+		PREDIRECT Redirect;
+		ULONG Index;
+
+		++LineNumber;
+		Position = LineBuffer;
+
+		while (isspace((UCHAR) *Position)) {
+			++Position;
+		}
+
+		// This also skips the #define of the macro itself.
+		if (strncmp(Position, "DLL_REDIRECT(", 13) != 0) {
+			continue;
+		}
+
+		if (NumberOfRedirects == REDIRECT_MAXIMUM_ENTRIES) {
+			fprintf(stderr, "%s:%u: too many redirects\n", FileName, LineNumber);
+			Success = FALSE;
+			break;
+		}
+
+		Redirect = &Redirects[NumberOfRedirects];
+		Redirect->Line = LineNumber;
+		Position = ReadQuotedName(Position + 13, Redirect->Key);
+
+		if (Position) {
+			while (isspace((UCHAR) *Position)) {
+				++Position;
+			}
+
+			if (*Position++ == ',') {
+				Position = ReadQuotedName(Position, Redirect->Value);
+			} else {
+				Position = NULL;
+			}
+		}
+
+		if (!Position) {
+			fprintf(stderr, "%s:%u: expected DLL_REDIRECT(\"name\", \"name\")\n",
+					FileName, LineNumber);
+			Success = FALSE;
+			continue;
+		}
+
+		//
+		// Import table entries are rewritten in place, so the new name must
+		// fit where the old one was.
+		//
+
+		if (strlen(Redirect->Value) > strlen(Redirect->Key)) {
+			fprintf(stderr, "%s:%u: \"%s\" is longer than \"%s\"\n",
+					FileName, LineNumber, Redirect->Value, Redirect->Key);
+			Success = FALSE;
+			continue;
+		}
+
+		for (Index = 0; Index < NumberOfRedirects; ++Index) {
+			if (strcasecmp(Redirects[Index].Key, Redirect->Key) == 0) {
+				fprintf(stderr, "%s:%u: \"%s\" is already redirected on line %u\n",
+						FileName, LineNumber, Redirect->Key, Redirects[Index].Line);
+				Success = FALSE;
+				break;
+			}
+		}
+
+		if (Index == NumberOfRedirects) {
+			++NumberOfRedirects;
+		}
+	}
+
+	fclose(File);
+
+	if (Success && NumberOfRedirects == 0) {
+		fprintf(stderr, "%s: no redirects found\n", FileName);
+		Success = FALSE;
+	}
+
+	return Success;
+}
+
+//
+// Try to place every key into its own slot using the current seed. Buckets
+// with the most keys are placed first, while there is still a lot of room.
+//
+
+STATIC BOOLEAN PlaceRedirects(
+	VOID)
+{
+	STATIC ULONG BucketSize[REDIRECT_MAXIMUM_ENTRIES];
+	STATIC ULONG BucketOrder[REDIRECT_MAXIMUM_ENTRIES];
+	STATIC BOOLEAN SlotUsed[REDIRECT_MAXIMUM_ENTRIES];
+	ULONG Slots[REDIRECT_MAXIMUM_ENTRIES];
+	ULONG Index;
+	ULONG OtherIndex;
+
+	for (Index = 0; Index < NumberOfRedirects; ++Index) {
+		Redirects[Index].Hash = HashName(Redirects[Index].Key, Seed);
+
+		// Keys with the same hash can never be told apart.
+		for (OtherIndex = 0; OtherIndex < Index; ++OtherIndex) {
+			if (Redirects[OtherIndex].Hash == Redirects[Index].Hash) {
+				return FALSE;
+			}
+		}
+	}
+
+	memset(BucketSize, 0, sizeof(BucketSize));
+	memset(SlotUsed, 0, sizeof(SlotUsed));
+
+	for (Index = 0; Index < NumberOfRedirects; ++Index) {
+		++BucketSize[KexGetDllRedirectBucket(Redirects[Index].Hash, NumberOfBuckets)];
+	}
+
+	// insertion sort, biggest first
+	for (Index = 0; Index < NumberOfBuckets; ++Index) {
+		for (OtherIndex = Index; OtherIndex > 0; --OtherIndex) {
+			if (BucketSize[BucketOrder[OtherIndex - 1]] >= BucketSize[Index]) {
+				break;
+			}
+
+			BucketOrder[OtherIndex] = BucketOrder[OtherIndex - 1];
+		}
+
+		BucketOrder[OtherIndex] = Index;
+	}
+
+	for (Index = 0; Index < NumberOfBuckets; ++Index) {
+		ULONG Bucket;
+		ULONG Displacement;
+
+		Bucket = BucketOrder[Index];
+		Displacements[Bucket] = 0;
+
+		if (BucketSize[Bucket] == 0) {
+			continue;
+		}
+
+		for (Displacement = 0; Displacement <= 0xFFFF; ++Displacement) {
+			ULONG Count;
+
+			Count = 0;
+
+			for (OtherIndex = 0; OtherIndex < NumberOfRedirects; ++OtherIndex) {
+				ULONG Slot;
+				ULONG Previous;
+
+				if (KexGetDllRedirectBucket(Redirects[OtherIndex].Hash, NumberOfBuckets) != Bucket) {
+					continue;
+				}
+
+				Slot = KexGetDllRedirectSlot(
+					Redirects[OtherIndex].Hash,
+					Displacement,
+					NumberOfRedirects);
+
+				if (SlotUsed[Slot]) {
+					break;
+				}
+
+				for (Previous = 0; Previous < Count; ++Previous) {
+					if (Slots[Previous] == Slot) {
+						break;
+					}
+				}
+
+				if (Previous != Count) {
+					break;
+				}
+
+				SlotRedirect[Slot] = OtherIndex;
+				Slots[Count++] = Slot;
+			}
+
+			if (Count == BucketSize[Bucket]) {
+				break;
+			}
+		}
+
+		if (Displacement > 0xFFFF) {
+			return FALSE;
+		}
+
+		Displacements[Bucket] = (USHORT) Displacement;
+
+		for (OtherIndex = 0; OtherIndex < BucketSize[Bucket]; ++OtherIndex) {
+			SlotUsed[Slots[OtherIndex]] = TRUE;
+		}
+	}
+
+	return TRUE;
+}
+
+//
+// Look every key up the same way that KexDll will, in case the generator
+// and the lookup ever disagree.
+//
+
+STATIC BOOLEAN VerifyRedirects(
+	VOID)
+{
+	ULONG Index;
+
+	for (Index = 0; Index < NumberOfRedirects; ++Index) {
+		CHAR UpperKey[REDIRECT_MAXIMUM_NAME_CCH + 1];
+		ULONG Hash;
+		ULONG Slot;
+		ULONG Cch;
+
+		// also checks that the hash doesn't care about case
+		for (Cch = 0; Redirects[Index].Key[Cch] != '\0'; ++Cch) {
+			UpperKey[Cch] = toupper((UCHAR) Redirects[Index].Key[Cch]);
+		}
+
+		UpperKey[Cch] = '\0';
+		Hash = HashName(UpperKey, Seed);
+
+		if (KexHashDllRedirectKeyA(Redirects[Index].Key, Cch, Seed) != Hash ||
+			!KexEqualDllRedirectKeyA(Redirects[Index].Key, UpperKey, Cch)) {
+
+			fprintf(stderr, "redirgen: the ANSI lookup of \"%s\" doesn't match\n", Redirects[Index].Key);
+			return FALSE;
+		}
+
+		Slot = KexGetDllRedirectSlot(
+			Hash,
+			Displacements[KexGetDllRedirectBucket(Hash, NumberOfBuckets)],
+			NumberOfRedirects);
+
+		if (SlotRedirect[Slot] != Index) {
+			fprintf(stderr, "redirgen: \"%s\" is not in its slot\n", Redirects[Index].Key);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+STATIC VOID WriteTableEntries(
+	IN	FILE	*File,
+	IN	PCSTR	MacroName)
+{
+	ULONG Index;
+	ULONG Padding;
+
+	Padding = REDIRECT_KEY_COLUMN_WIDTH - strlen(MacroName);
+
+	for (Index = 0; Index < NumberOfRedirects; ++Index) {
+		PCREDIRECT Redirect;
+
+		Redirect = &Redirects[SlotRedirect[Index]];
+
+		fprintf(File, "\t%s(\"%s\",%*s\"%s\")\n",
+				MacroName,
+				Redirect->Key,
+				(int) (Padding - strlen(Redirect->Key)), "",
+				Redirect->Value);
+	}
+}
+
+//
+// The version changes whenever the contents of the table do. KexDll uses it
+// to tell whether cached rewrite plans were made with the same table.
+//
+
+STATIC ULONG GetTableVersion(
+	VOID)
+{
+	ULONG Version;
+	ULONG Index;
+
+	Version = 0x811C9DC5 ^ Seed;
+
+	for (Index = 0; Index < NumberOfRedirects; ++Index) {
+		PCREDIRECT Redirect;
+		PCSTR Character;
+
+		Redirect = &Redirects[SlotRedirect[Index]];
+
+		// both strings including the null terminators
+		for (Character = Redirect->Key; ; ++Character) {
+			Version = (Version ^ (UCHAR) *Character) * 0x01000193;
+
+			if (*Character == '\0') {
+				break;
+			}
+		}
+
+		for (Character = Redirect->Value; ; ++Character) {
+			Version = (Version ^ (UCHAR) *Character) * 0x01000193;
+
+			if (*Character == '\0') {
+				break;
+			}
+		}
+	}
+
+	return Version;
+}
+
+STATIC BOOLEAN WriteTable(
+	IN	PCSTR	FileName)
+{
+	FILE *File;
+	ULONG Index;
+
+	File = fopen(FileName, "w");
+
+	if (!File) {
+		perror(FileName);
+		return FALSE;
+	}
+
+	fprintf(File,
+		"//\n"
+		"// DLL redirect table. This file is generated by redirgen from redirects.h,\n"
+		"// so don't edit it - edit redirects.h and run \"make table\" in\n"
+		"// 01-Development Utilities\\redirgen instead.\n"
+		"//\n"
+		"// The table is a minimal perfect hash over the DLL names. See redirhash.h.\n"
+		"//\n"
+		"\n"
+		"#define DLL_REDIRECT_TABLE_VERSION\t\t\t0x%08X\n"
+		"#define DLL_REDIRECT_HASH_SEED\t\t\t\t0x%08X\n"
+		"#define DLL_REDIRECT_NUMBER_OF_BUCKETS\t\t%u\n"
+		"#define DLL_REDIRECT_NUMBER_OF_SLOTS\t\t%u\n"
+		"\n"
+		"#define DLL_REDIRECT(Key, Value) {RTL_CONSTANT_STRING(_L(Key)), RTL_CONSTANT_STRING(_L(Value))},\n"
+		"#define DLL_REDIRECT_ANSI(Key, Value) {RTL_CONSTANT_STRING(Key), RTL_CONSTANT_STRING(Value)},\n"
+		"\n"
+		"STATIC CONST USHORT DllRedirectDisplacements[DLL_REDIRECT_NUMBER_OF_BUCKETS] = {",
+		GetTableVersion(), Seed, NumberOfBuckets, NumberOfRedirects);
+
+	for (Index = 0; Index < NumberOfBuckets; ++Index) {
+		fprintf(File, "%s%u,", (Index % 16 == 0) ? "\n\t" : " ", Displacements[Index]);
+	}
+
+	fprintf(File,
+		"\n"
+		"};\n"
+		"\n"
+		"STATIC CONST UNICODE_STRING DllRedirectTable[DLL_REDIRECT_NUMBER_OF_SLOTS][2] = {\n");
+
+	WriteTableEntries(File, "DLL_REDIRECT");
+
+	fprintf(File,
+		"};\n"
+		"\n"
+		"// The same table again, for looking up names from import tables.\n"
+		"STATIC CONST ANSI_STRING DllRedirectAnsiTable[DLL_REDIRECT_NUMBER_OF_SLOTS][2] = {\n");
+
+	WriteTableEntries(File, "DLL_REDIRECT_ANSI");
+
+	fprintf(File,
+		"};\n"
+		"\n"
+		"#undef DLL_REDIRECT\n"
+		"#undef DLL_REDIRECT_ANSI");
+
+	if (fclose(File) != 0) {
+		perror(FileName);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+int main(
+	int		argc,
+	char	**argv)
+{
+	if (argc != 3) {
+		fputs(
+			"Usage: redirgen redirects.h redirtbl.h\n"
+			"\n"
+			"Generates the DLL redirect table from the list of redirects.\n",
+			stderr);
+
+		return 2;
+	}
+
+	unless (ReadRedirects(argv[1])) {
+		return 1;
+	}
+
+	// About two keys per bucket. Fewer buckets make the table smaller, but
+	// take longer to find displacements for.
+	NumberOfBuckets = (NumberOfRedirects + 1) / 2;
+
+	for (Seed = 0; Seed < REDIRECT_MAXIMUM_SEEDS; ++Seed) {
+		if (PlaceRedirects()) {
+			break;
+		}
+	}
+
+	if (Seed == REDIRECT_MAXIMUM_SEEDS) {
+		fprintf(stderr, "redirgen: no perfect hash found for %u redirects\n", NumberOfRedirects);
+		return 1;
+	}
+
+	unless (VerifyRedirects()) {
+		return 1;
+	}
+
+	unless (WriteTable(argv[2])) {
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
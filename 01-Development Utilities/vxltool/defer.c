@@ -0,0 +1,586 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     defer.c
+//
+// Abstract:
+//
+//     Formats the text of deferred log entries (see KexDll\vxldefer.c).
+//
+//     KexDll lays the stored arguments out like a va_list and hands them to
+//     StringCchVPrintf, which we can't do here, since the C library on the
+//     build host has a different idea of what %s, %S, %wZ and friends mean
+//     and how big a wchar_t is. Instead, the format string is walked in the
+//     same way as VxlpCaptureArguments does, and each argument is formatted
+//     as the Windows C runtime would have done it.
+//
+//     ANSI strings are assumed to be Latin-1, since there is no way to know
+//     which code page the process that wrote them was using.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "vxltool.h"
+
+typedef enum _ARGUMENTSIZE {
+	ArgumentSizeDefault,
+	ArgumentSizeShort,
+	ArgumentSizeLong,
+	ArgumentSizeLongLong,
+	ArgumentSizePointer
+} ARGUMENTSIZE;
+
+typedef struct _ARGUMENTREADER {
+	PCBYTE	Arguments;
+	ULONG	ArgumentsCb;
+	ULONG	Offset;
+} TYPEDEF_TYPE_NAME(ARGUMENTREADER);
+
+typedef struct _TEXTWRITER {
+	PWSTR	Buffer;
+	ULONG	MaxCch;
+	ULONG	Cch;
+	BOOLEAN	OutOfMemory;
+} TYPEDEF_TYPE_NAME(TEXTWRITER);
+
+STATIC CONST CHAR NullString[] = "(null)";
+
+STATIC VOID PutCharacter(
+	IN OUT	PTEXTWRITER	Writer,
+	IN		WCHAR		Character)
+{
+	if (Writer->Cch == Writer->MaxCch) {
+		PWSTR NewBuffer;
+		ULONG NewMaxCch;
+
+		if (Writer->MaxCch >= DEFERRED_MAXIMUM_TEXT_CCH) {
+			// too long - cut it off
+			return;
+		}
+
+		NewMaxCch = min(max(Writer->MaxCch * 2, 256), DEFERRED_MAXIMUM_TEXT_CCH);
+		NewBuffer = (PWSTR) realloc(Writer->Buffer, NewMaxCch * sizeof(WCHAR));
+
+		if (!NewBuffer) {
+			Writer->OutOfMemory = TRUE;
+			return;
+		}
+
+		Writer->Buffer = NewBuffer;
+		Writer->MaxCch = NewMaxCch;
+	}
+
+	Writer->Buffer[Writer->Cch++] = Character;
+}
+
+//
+// Write a wide or ANSI string, taking the field width and precision into
+// account. Cch is the length of the string, not counting any terminator.
+//
+
+STATIC VOID PutField(
+	IN OUT	PTEXTWRITER	Writer,
+	IN		PCVOID		String,
+	IN		BOOLEAN		Wide,
+	IN		ULONG		Cch,
+	IN		LONG		Width,
+	IN		LONG		Precision,
+	IN		BOOLEAN		LeftJustify)
+{
+	ULONG Index;
+	LONG Padding;
+
+	if (Precision >= 0 && (ULONG) Precision < Cch) {
+		Cch = Precision;
+	}
+
+	Padding = (Width > (LONG) Cch) ? Width - (LONG) Cch : 0;
+
+	if (!LeftJustify) {
+		while (Padding--) {
+			PutCharacter(Writer, ' ');
+		}
+	}
+
+	for (Index = 0; Index < Cch; ++Index) {
+		WCHAR Character;
+
+		if (Wide) {
+			RtlCopyMemory(&Character, (PCBYTE) String + Index * sizeof(WCHAR), sizeof(WCHAR));
+		} else {
+			Character = ((PCBYTE) String)[Index];
+		}
+
+		PutCharacter(Writer, Character);
+	}
+
+	if (LeftJustify) {
+		while (Padding-- > 0) {
+			PutCharacter(Writer, ' ');
+		}
+	}
+}
+
+//
+// Get the next argument. If the format string asks for more arguments than
+// there are, the missing ones are reported with a Type of 0, and should be
+// treated as zeroes or NULLs, like KexDll does.
+//
+
+STATIC NTSTATUS GetArgument(
+	IN OUT	PARGUMENTREADER	Reader,
+	OUT		PUCHAR			Type,
+	OUT		PCBYTE			*Data,
+	OUT		PUSHORT			DataCb)
+{
+	VXLDEFERREDARGUMENT Argument;
+
+	*Type = 0;
+	*Data = NULL;
+	*DataCb = 0;
+
+	if (Reader->Offset >= Reader->ArgumentsCb) {
+		return STATUS_SUCCESS;
+	}
+
+	if (Reader->Offset + FIELD_OFFSET(VXLDEFERREDARGUMENT, Data) > Reader->ArgumentsCb) {
+		return STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	RtlCopyMemory(&Argument, Reader->Arguments + Reader->Offset, FIELD_OFFSET(VXLDEFERREDARGUMENT, Data));
+
+	if (Reader->Offset + VXL_ARGUMENT_SIZE(Argument.DataCb) > Reader->ArgumentsCb) {
+		return STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	*Type = Argument.Type;
+	*Data = Reader->Arguments + Reader->Offset + FIELD_OFFSET(VXLDEFERREDARGUMENT, Data);
+	*DataCb = Argument.DataCb;
+
+	Reader->Offset += VXL_ARGUMENT_SIZE(Argument.DataCb);
+	return STATUS_SUCCESS;
+}
+
+STATIC NTSTATUS GetIntegerArgument(
+	IN OUT	PARGUMENTREADER	Reader,
+	OUT		PULONGLONG		Value)
+{
+	NTSTATUS Status;
+	UCHAR Type;
+	PCBYTE Data;
+	USHORT DataCb;
+
+	Status = GetArgument(Reader, &Type, &Data, &DataCb);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	*Value = 0;
+
+	switch (Type) {
+	case 0:
+	case VXL_ARGUMENT_NULL_POINTER:
+		break;
+	case VXL_ARGUMENT_INT32:
+		{
+			LONG Value32;
+
+			if (DataCb != sizeof(LONG)) {
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+
+			RtlCopyMemory(&Value32, Data, sizeof(LONG));
+			*Value = (ULONGLONG) (LONGLONG) Value32;
+		}
+
+		break;
+	case VXL_ARGUMENT_INT64:
+	case VXL_ARGUMENT_POINTER:
+		if (DataCb != sizeof(ULONGLONG)) {
+			return STATUS_FILE_CORRUPT_ERROR;
+		}
+
+		RtlCopyMemory(Value, Data, sizeof(ULONGLONG));
+		break;
+	default:
+		return STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Format a number with the C library and write it out. Spec is the flags,
+// width and precision, which have already been checked.
+//
+
+STATIC VOID PutNumber(
+	IN OUT	PTEXTWRITER	Writer,
+	IN		PCSTR		Spec,
+	IN		CHAR		Conversion,
+	IN		ULONGLONG	Value,
+	IN		BOOLEAN		Signed,
+	IN		BOOLEAN		Float)
+{
+	CHAR Format[32];
+	CHAR Number[512];
+	int Length;
+
+	if (Float) {
+		double Double;
+
+		RtlCopyMemory(&Double, &Value, sizeof(Double));
+		snprintf(Format, sizeof(Format), "%%%s%c", Spec, Conversion);
+		Length = snprintf(Number, sizeof(Number), Format, Double);
+	} else {
+		snprintf(Format, sizeof(Format), "%%%sll%c", Spec, Conversion);
+
+		if (Signed) {
+			Length = snprintf(Number, sizeof(Number), Format, (long long) Value);
+		} else {
+			Length = snprintf(Number, sizeof(Number), Format, (unsigned long long) Value);
+		}
+	}
+
+	if (Length < 0) {
+		return;
+	}
+
+	PutField(Writer, Number, FALSE, (ULONG) min((ULONG) Length, sizeof(Number) - 1), 0, -1, FALSE);
+}
+
+NTSTATUS FormatDeferredText(
+	IN		PCWSTR			Format,
+	IN		PCBYTE			Arguments,
+	IN		ULONG			ArgumentsCb,
+	IN OUT	PWSTR			*Buffer,
+	IN OUT	PULONG			BufferMaxCch,
+	OUT		PULONG			TextCch)
+{
+	NTSTATUS Status;
+	ARGUMENTREADER Reader;
+	TEXTWRITER Writer;
+	PCWSTR Pointer;
+
+	Reader.Arguments = Arguments;
+	Reader.ArgumentsCb = ArgumentsCb;
+	Reader.Offset = 0;
+
+	Writer.Buffer = *Buffer;
+	Writer.MaxCch = *BufferMaxCch;
+	Writer.Cch = 0;
+	Writer.OutOfMemory = FALSE;
+
+	Status = STATUS_SUCCESS;
+
+	for (Pointer = Format; *Pointer && NT_SUCCESS(Status); ++Pointer) {
+		CHAR Spec[24];
+		ULONG SpecCch;
+		BOOLEAN LeftJustify;
+		LONG Width;
+		LONG Precision;
+		ARGUMENTSIZE Size;
+		ULONGLONG Value;
+
+		if (*Pointer != '%') {
+			PutCharacter(&Writer, *Pointer);
+			continue;
+		}
+
+		++Pointer;
+
+		if (*Pointer == '%') {
+			PutCharacter(&Writer, '%');
+			continue;
+		}
+
+		//
+		// Flags, width and precision are collected into Spec, which is
+		// used for numbers. Strings and characters only care about the
+		// width, precision and the - flag.
+		//
+
+		SpecCch = 0;
+		LeftJustify = FALSE;
+
+		while (*Pointer == '-' || *Pointer == '+' || *Pointer == ' ' ||
+			   *Pointer == '#' || *Pointer == '0') {
+
+			if (*Pointer == '-') {
+				LeftJustify = TRUE;
+			}
+
+			if (SpecCch < 8) {
+				Spec[SpecCch++] = (CHAR) *Pointer;
+			}
+
+			++Pointer;
+		}
+
+		Width = 0;
+
+		if (*Pointer == '*') {
+			Status = GetIntegerArgument(&Reader, &Value);
+			Width = (LONG) Value;
+
+			if (Width < 0) {
+				LeftJustify = TRUE;
+				Spec[SpecCch++] = '-';
+				Width = -Width;
+			}
+
+			++Pointer;
+		} else {
+			while (*Pointer >= '0' && *Pointer <= '9') {
+				Width = min(Width * 10 + (*Pointer - '0'), 10000);
+				++Pointer;
+			}
+		}
+
+		Precision = -1;
+
+		if (*Pointer == '.') {
+			++Pointer;
+
+			if (*Pointer == '*') {
+				Status = GetIntegerArgument(&Reader, &Value);
+				Precision = (LONG) Value;
+				++Pointer;
+			} else {
+				Precision = 0;
+
+				while (*Pointer >= '0' && *Pointer <= '9') {
+					Precision = min(Precision * 10 + (*Pointer - '0'), 10000);
+					++Pointer;
+				}
+			}
+		}
+
+		if (!NT_SUCCESS(Status)) {
+			break;
+		}
+
+		Width = min(Width, 10000);
+		Precision = min(Precision, 400);
+
+		if (Precision >= 0) {
+			SpecCch += sprintf(Spec + SpecCch, "%ld.%ld", (long) Width, (long) Precision);
+		} else {
+			SpecCch += sprintf(Spec + SpecCch, "%ld", (long) Width);
+		}
+
+		//
+		// size
+		//
+
+		Size = ArgumentSizeDefault;
+
+		switch (*Pointer) {
+		case 'h':
+			Size = ArgumentSizeShort;
+			++Pointer;
+
+			if (*Pointer == 'h') {
+				++Pointer;
+			}
+
+			break;
+		case 'l':
+			Size = ArgumentSizeLong;
+			++Pointer;
+
+			if (*Pointer == 'l') {
+				Size = ArgumentSizeLongLong;
+				++Pointer;
+			}
+
+			break;
+		case 'w':
+			Size = ArgumentSizeLong;
+			++Pointer;
+			break;
+		case 'L':
+		case 'q':
+		case 'j':
+			Size = ArgumentSizeLongLong;
+			++Pointer;
+			break;
+		case 'z':
+		case 't':
+			Size = ArgumentSizePointer;
+			++Pointer;
+			break;
+		case 'I':
+			++Pointer;
+
+			if (Pointer[0] == '6' && Pointer[1] == '4') {
+				Size = ArgumentSizeLongLong;
+				Pointer += 2;
+			} else if (Pointer[0] == '3' && Pointer[1] == '2') {
+				Pointer += 2;
+			} else {
+				Size = ArgumentSizePointer;
+			}
+
+			break;
+		}
+
+		//
+		// type
+		//
+
+		switch (*Pointer) {
+		case 'c':
+		case 'C':
+			Status = GetIntegerArgument(&Reader, &Value);
+
+			if (NT_SUCCESS(Status)) {
+				WCHAR Character;
+
+				// %c is a WCHAR in wide printf, unless it is %hc or %C.
+				if ((*Pointer == 'c' && Size != ArgumentSizeShort) ||
+					(*Pointer == 'C' && Size == ArgumentSizeLong)) {
+
+					Character = (WCHAR) Value;
+				} else {
+					Character = (BYTE) Value;
+				}
+
+				PutField(&Writer, &Character, TRUE, 1, Width, -1, LeftJustify);
+			}
+
+			break;
+		case 'd':
+		case 'i':
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			Status = GetIntegerArgument(&Reader, &Value);
+
+			if (NT_SUCCESS(Status)) {
+				BOOLEAN Signed;
+
+				Signed = (*Pointer == 'd' || *Pointer == 'i');
+
+				if (Size == ArgumentSizeShort) {
+					Value = Signed ? (ULONGLONG) (LONGLONG) (SHORT) Value : (USHORT) Value;
+				} else if (Size == ArgumentSizeDefault || Size == ArgumentSizeLong) {
+					Value = Signed ? (ULONGLONG) (LONGLONG) (LONG) Value : (ULONG) Value;
+				}
+
+				PutNumber(&Writer, Spec, (CHAR) *Pointer, Value, Signed, FALSE);
+			}
+
+			break;
+		case 'e':
+		case 'E':
+		case 'f':
+		case 'F':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			Status = GetIntegerArgument(&Reader, &Value);
+
+			if (NT_SUCCESS(Status)) {
+				PutNumber(&Writer, Spec, (CHAR) *Pointer, Value, TRUE, TRUE);
+			}
+
+			break;
+		case 'p':
+		case 'P':
+			Status = GetIntegerArgument(&Reader, &Value);
+
+			if (NT_SUCCESS(Status)) {
+				CHAR Number[17];
+
+				// The Windows C runtime prints pointers as upper case hex,
+				// padded to the size of a pointer in the process that
+				// wrote the log, which we have to guess.
+				if (Value > 0xFFFFFFFF) {
+					snprintf(Number, sizeof(Number), "%016llX", (unsigned long long) Value);
+				} else {
+					snprintf(Number, sizeof(Number), "%08lX", (unsigned long) Value);
+				}
+
+				PutField(&Writer, Number, FALSE, (ULONG) strlen(Number), Width, -1, LeftJustify);
+			}
+
+			break;
+		case 's':
+		case 'S':
+		case 'Z':
+			{
+				UCHAR Type;
+				PCBYTE Data;
+				USHORT DataCb;
+
+				Status = GetArgument(&Reader, &Type, &Data, &DataCb);
+				if (!NT_SUCCESS(Status)) {
+					break;
+				}
+
+				switch (Type) {
+				case 0:
+				case VXL_ARGUMENT_NULL_POINTER:
+					PutField(&Writer, NullString, FALSE, sizeof(NullString) - 1, Width, Precision, LeftJustify);
+					break;
+				case VXL_ARGUMENT_WIDE_STRING:
+					if (DataCb < sizeof(WCHAR) || (DataCb & 1)) {
+						Status = STATUS_FILE_CORRUPT_ERROR;
+						break;
+					}
+
+					PutField(&Writer, Data, TRUE, DataCb / sizeof(WCHAR) - 1, Width, Precision, LeftJustify);
+					break;
+				case VXL_ARGUMENT_ANSI_STRING:
+					if (DataCb < sizeof(CHAR)) {
+						Status = STATUS_FILE_CORRUPT_ERROR;
+						break;
+					}
+
+					PutField(&Writer, Data, FALSE, DataCb - 1, Width, Precision, LeftJustify);
+					break;
+				case VXL_ARGUMENT_UNICODE_STRING:
+					PutField(&Writer, Data, TRUE, DataCb / sizeof(WCHAR), Width, Precision, LeftJustify);
+					break;
+				case VXL_ARGUMENT_ANSI_COUNTED:
+					PutField(&Writer, Data, FALSE, DataCb, Width, Precision, LeftJustify);
+					break;
+				default:
+					Status = STATUS_FILE_CORRUPT_ERROR;
+					break;
+				}
+			}
+
+			break;
+		default:
+			// VxlpCaptureArguments doesn't defer anything else.
+			Status = STATUS_FILE_CORRUPT_ERROR;
+			break;
+		}
+
+		if (*Pointer == '\0') {
+			break;
+		}
+	}
+
+	*Buffer = Writer.Buffer;
+	*BufferMaxCch = Writer.MaxCch;
+	*TextCch = Writer.Cch;
+
+	if (Writer.OutOfMemory) {
+		return STATUS_NO_MEMORY;
+	}
+
+	return Status;
+}
\ No newline at end of file
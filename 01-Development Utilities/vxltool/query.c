@@ -0,0 +1,490 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     query.c
+//
+// Abstract:
+//
+//     Filtering and counting of log entries.
+//
+//     The filters are applied in the same order as LogEntryMatchesFilters
+//     in VxlView (cheapest first, text search last), so that a query gives
+//     the same results as the equivalent filter in the viewer.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "vxltool.h"
+
+STATIC CONST PCSTR SeverityNames[] = {
+	"Critical",
+	"Error",
+	"Warning",
+	"Information",
+	"Detail",
+	"Debug",
+	"Unknown"
+};
+
+C_ASSERT(ARRAYSIZE(SeverityNames) == LogSeverityMaximumValue + 1);
+
+//
+// WCHAR is not wchar_t on most build hosts, so L"" can't be used for
+// these. They are widened when first asked for.
+//
+
+STATIC WCHAR SeverityText[ARRAYSIZE(SeverityNames)][12];
+
+PCWSTR SeverityToText(
+	IN	VXLSEVERITY	Severity)
+{
+	PWSTR Text;
+
+	if (Severity < 0 || Severity >= LogSeverityMaximumValue) {
+		Severity = LogSeverityMaximumValue;
+	}
+
+	Text = SeverityText[Severity];
+
+	if (Text[0] == '\0') {
+		ULONG Index;
+
+		for (Index = 0; SeverityNames[Severity][Index] != '\0'; ++Index) {
+			Text[Index] = SeverityNames[Severity][Index];
+		}
+	}
+
+	return Text;
+}
+
+STATIC BOOLEAN StringEqualI(
+	IN	PCWSTR	String1,
+	IN	PCWSTR	String2)
+{
+	WCHAR Character1;
+	WCHAR Character2;
+
+	do {
+		Character1 = *String1++;
+		Character2 = *String2++;
+
+		if (Character1 >= 'A' && Character1 <= 'Z') {
+			Character1 += 'a' - 'A';
+		}
+
+		if (Character2 >= 'A' && Character2 <= 'Z') {
+			Character2 += 'a' - 'A';
+		}
+	} while (Character1 == Character2 && Character1 != '\0');
+
+	return (Character1 == Character2);
+}
+
+STATIC BOOLEAN IdIsInList(
+	IN	ULONG	Id,
+	IN	PULONG	List,
+	IN	ULONG	NumberOfIds)
+{
+	ULONG Index;
+
+	for (Index = 0; Index < NumberOfIds; ++Index) {
+		if (List[Index] == Id) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+BOOLEAN LogEntryMatchesQuery(
+	IN	PQUERY		Query,
+	IN	PCLOGENTRY	Entry)
+{
+	BOOLEAN LogEntryMatchesTextFilter;
+
+	// 1. severity
+	if (!Query->AnySeverity) {
+		if (Entry->Severity < 0 || Entry->Severity >= LogSeverityMaximumValue) {
+			return FALSE;
+		}
+
+		if (Query->Severities[Entry->Severity] == FALSE) {
+			return FALSE;
+		}
+	}
+
+	// 2. time, process and thread
+	if (Entry->Time64 < Query->Since || Entry->Time64 >= Query->Until) {
+		return FALSE;
+	}
+
+	if (Query->ProcessIds && !IdIsInList(Entry->ProcessId, Query->ProcessIds, Query->NumberOfProcessIds)) {
+		return FALSE;
+	}
+
+	if (Query->ThreadIds && !IdIsInList(Entry->ThreadId, Query->ThreadIds, Query->NumberOfThreadIds)) {
+		return FALSE;
+	}
+
+	// 3. source component. The component name of an entry is a pointer into
+	//    the string table of its log, so consecutive entries from the same
+	//    component don't need to be compared again.
+	if (Query->Components) {
+		if (Entry->SourceComponent != Query->LastComponent) {
+			ULONG Index;
+
+			Query->LastComponent = Entry->SourceComponent;
+			Query->LastComponentMatched = FALSE;
+
+			for (Index = 0; Index < Query->NumberOfComponents; ++Index) {
+				if (StringEqualI(Entry->SourceComponent, Query->Components[Index])) {
+					Query->LastComponentMatched = TRUE;
+					break;
+				}
+			}
+		}
+
+		if (!Query->LastComponentMatched) {
+			return FALSE;
+		}
+	}
+
+	// 4. text
+	if (!Query->TextSearcher) {
+		return TRUE;
+	}
+
+	LogEntryMatchesTextFilter = FALSE;
+
+	if (KexRtlpSearchString(Query->TextSearcher, Entry->TextHeader, Entry->TextHeaderCch)) {
+		LogEntryMatchesTextFilter = TRUE;
+	} else if (!Query->HeaderOnly && Entry->Text != NULL) {
+		if (KexRtlpSearchString(Query->TextSearcher, Entry->Text, Entry->TextCch)) {
+			LogEntryMatchesTextFilter = TRUE;
+		}
+	}
+
+	return (LogEntryMatchesTextFilter != Query->TextInverted);
+}
+
+BOOLEAN InitializeTopCounters(
+	OUT	PTOPCOUNTERS	TopCounters,
+	IN	ULONG			Capacity)
+{
+	RtlZeroMemory(TopCounters, sizeof(*TopCounters));
+
+	TopCounters->Capacity = Capacity;
+	TopCounters->NumberOfBuckets = 16;
+
+	while (TopCounters->NumberOfBuckets < Capacity * 2) {
+		TopCounters->NumberOfBuckets *= 2;
+	}
+
+	TopCounters->Counters = (PTOPCOUNTER) malloc(Capacity * sizeof(TOPCOUNTER));
+	TopCounters->Heap = (PPTOPCOUNTER) malloc(Capacity * sizeof(PTOPCOUNTER));
+	TopCounters->Buckets = (PPTOPCOUNTER) calloc(TopCounters->NumberOfBuckets, sizeof(PTOPCOUNTER));
+
+	if (!TopCounters->Counters || !TopCounters->Heap || !TopCounters->Buckets) {
+		FreeTopCounters(TopCounters);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+VOID FreeTopCounters(
+	IN	PTOPCOUNTERS	TopCounters)
+{
+	free(TopCounters->Counters);
+	free(TopCounters->Heap);
+	free(TopCounters->Buckets);
+	RtlZeroMemory(TopCounters, sizeof(*TopCounters));
+}
+
+STATIC ULONG HashKey(
+	IN	PCWSTR	Key,
+	IN	ULONG	KeyCch)
+{
+	ULONG Hash;
+	ULONG Index;
+
+	// FNV-1a
+	Hash = 2166136261UL;
+
+	for (Index = 0; Index < KeyCch; ++Index) {
+		Hash ^= Key[Index];
+		Hash *= 16777619UL;
+	}
+
+	return Hash;
+}
+
+STATIC VOID SwapHeapEntries(
+	IN	PTOPCOUNTERS	TopCounters,
+	IN	ULONG			Index1,
+	IN	ULONG			Index2)
+{
+	PTOPCOUNTER Counter;
+
+	Counter = TopCounters->Heap[Index1];
+	TopCounters->Heap[Index1] = TopCounters->Heap[Index2];
+	TopCounters->Heap[Index2] = Counter;
+
+	TopCounters->Heap[Index1]->HeapIndex = Index1;
+	TopCounters->Heap[Index2]->HeapIndex = Index2;
+}
+
+STATIC VOID SiftUp(
+	IN	PTOPCOUNTERS	TopCounters,
+	IN	ULONG			Index)
+{
+	while (Index > 0) {
+		ULONG Parent;
+
+		Parent = (Index - 1) / 2;
+
+		if (TopCounters->Heap[Parent]->Count <= TopCounters->Heap[Index]->Count) {
+			break;
+		}
+
+		SwapHeapEntries(TopCounters, Parent, Index);
+		Index = Parent;
+	}
+}
+
+STATIC VOID SiftDown(
+	IN	PTOPCOUNTERS	TopCounters,
+	IN	ULONG			Index)
+{
+	until (FALSE) {
+		ULONG Smallest;
+		ULONG Child;
+
+		Smallest = Index;
+		Child = Index * 2 + 1;
+
+		if (Child < TopCounters->NumberOfCounters &&
+			TopCounters->Heap[Child]->Count < TopCounters->Heap[Smallest]->Count) {
+
+			Smallest = Child;
+		}
+
+		++Child;
+
+		if (Child < TopCounters->NumberOfCounters &&
+			TopCounters->Heap[Child]->Count < TopCounters->Heap[Smallest]->Count) {
+
+			Smallest = Child;
+		}
+
+		if (Smallest == Index) {
+			break;
+		}
+
+		SwapHeapEntries(TopCounters, Index, Smallest);
+		Index = Smallest;
+	}
+}
+
+STATIC VOID UnlinkCounter(
+	IN	PTOPCOUNTERS	TopCounters,
+	IN	PTOPCOUNTER		Counter)
+{
+	PPTOPCOUNTER Link;
+
+	Link = &TopCounters->Buckets[Counter->Hash & (TopCounters->NumberOfBuckets - 1)];
+
+	while (*Link != Counter) {
+		Link = &(*Link)->Next;
+	}
+
+	*Link = Counter->Next;
+}
+
+STATIC VOID CountKey(
+	IN	PTOPCOUNTERS	TopCounters,
+	IN	PCWSTR			Key,
+	IN	ULONG			KeyCch)
+{
+	ULONG Hash;
+	PPTOPCOUNTER Bucket;
+	PTOPCOUNTER Counter;
+
+	KeyCch = min(KeyCch, TOP_MAXIMUM_KEY_CCH);
+	Hash = HashKey(Key, KeyCch);
+	Bucket = &TopCounters->Buckets[Hash & (TopCounters->NumberOfBuckets - 1)];
+
+	for (Counter = *Bucket; Counter != NULL; Counter = Counter->Next) {
+		if (Counter->Hash == Hash && Counter->KeyCch == KeyCch &&
+			RtlEqualMemory(Counter->Key, Key, KeyCch * sizeof(WCHAR))) {
+
+			++Counter->Count;
+			SiftDown(TopCounters, Counter->HeapIndex);
+			return;
+		}
+	}
+
+	if (TopCounters->NumberOfCounters < TopCounters->Capacity) {
+		Counter = &TopCounters->Counters[TopCounters->NumberOfCounters];
+		Counter->Count = 1;
+		Counter->Error = 0;
+		Counter->HeapIndex = TopCounters->NumberOfCounters;
+		TopCounters->Heap[TopCounters->NumberOfCounters++] = Counter;
+	} else {
+		//
+		// Out of counters. The key with the lowest count makes way for the
+		// new one, which inherits its count (it might have been seen that
+		// many times already, for all we know).
+		//
+
+		Counter = TopCounters->Heap[0];
+		UnlinkCounter(TopCounters, Counter);
+
+		Counter->Error = Counter->Count;
+		++Counter->Count;
+		TopCounters->Approximate = TRUE;
+	}
+
+	Counter->Hash = Hash;
+	Counter->KeyCch = KeyCch;
+	RtlCopyMemory(Counter->Key, Key, KeyCch * sizeof(WCHAR));
+
+	Counter->Next = *Bucket;
+	*Bucket = Counter;
+
+	SiftUp(TopCounters, Counter->HeapIndex);
+	SiftDown(TopCounters, Counter->HeapIndex);
+}
+
+STATIC ULONG AppendString(
+	OUT	PWSTR	Buffer,
+	IN	ULONG	BufferCch,
+	IN	PCWSTR	String)
+{
+	ULONG Index;
+
+	for (Index = 0; Index < BufferCch && String[Index] != '\0'; ++Index) {
+		Buffer[Index] = String[Index];
+	}
+
+	return Index;
+}
+
+STATIC ULONG AppendNumber(
+	OUT	PWSTR	Buffer,
+	IN	ULONG	BufferCch,
+	IN	ULONG	Number)
+{
+	CHAR Digits[12];
+	ULONG DigitsCch;
+	ULONG Index;
+
+	DigitsCch = (ULONG) sprintf(Digits, "%lu", (unsigned long) Number);
+
+	for (Index = 0; Index < BufferCch && Index < DigitsCch; ++Index) {
+		Buffer[Index] = Digits[Index];
+	}
+
+	return Index;
+}
+
+VOID CountTopKey(
+	IN	PTOPCOUNTERS	TopCounters,
+	IN	TOPKEY			KeyType,
+	IN	PCLOGENTRY		Entry)
+{
+	WCHAR Key[TOP_MAXIMUM_KEY_CCH];
+	ULONG KeyCch;
+
+	switch (KeyType) {
+	case TopKeyComponent:
+		KeyCch = AppendString(Key, ARRAYSIZE(Key), Entry->SourceComponent);
+		break;
+	case TopKeyFile:
+		KeyCch = AppendString(Key, ARRAYSIZE(Key), Entry->SourceFile);
+		break;
+	case TopKeyFunction:
+		KeyCch = AppendString(Key, ARRAYSIZE(Key), Entry->SourceFunction);
+		break;
+	case TopKeySource:
+		KeyCch = AppendString(Key, ARRAYSIZE(Key), Entry->SourceFile);
+
+		if (KeyCch < ARRAYSIZE(Key)) {
+			Key[KeyCch++] = ':';
+		}
+
+		KeyCch += AppendNumber(Key + KeyCch, ARRAYSIZE(Key) - KeyCch, Entry->SourceLine);
+		break;
+	case TopKeyHeader:
+		// not copied - CountKey cuts it off at TOP_MAXIMUM_KEY_CCH
+		CountKey(TopCounters, Entry->TextHeader, Entry->TextHeaderCch);
+		return;
+	case TopKeyProcessId:
+		KeyCch = AppendNumber(Key, ARRAYSIZE(Key), Entry->ProcessId);
+		break;
+	case TopKeyThreadId:
+		KeyCch = AppendNumber(Key, ARRAYSIZE(Key), Entry->ThreadId);
+		break;
+	case TopKeySeverity:
+		KeyCch = AppendString(Key, ARRAYSIZE(Key), SeverityToText(Entry->Severity));
+		break;
+	default:
+		ASSERT(FALSE);
+		return;
+	}
+
+	CountKey(TopCounters, Key, KeyCch);
+}
+
+STATIC int CompareTopCounters(
+	IN	const void	*Element1,
+	IN	const void	*Element2)
+{
+	PCTOPCOUNTER Counter1;
+	PCTOPCOUNTER Counter2;
+	ULONG KeyCch;
+	int Result;
+
+	Counter1 = *(PCTOPCOUNTER *) Element1;
+	Counter2 = *(PCTOPCOUNTER *) Element2;
+
+	if (Counter1->Count != Counter2->Count) {
+		return (Counter1->Count > Counter2->Count) ? -1 : 1;
+	}
+
+	// so that the output doesn't depend on the order of the heap
+	KeyCch = min(Counter1->KeyCch, Counter2->KeyCch);
+	Result = memcmp(Counter1->Key, Counter2->Key, KeyCch * sizeof(WCHAR));
+
+	if (Result == 0) {
+		Result = (int) Counter1->KeyCch - (int) Counter2->KeyCch;
+	}
+
+	return Result;
+}
+
+//
+// Sorts the counters by count, highest first, and returns how many there
+// are. The sorted counters are in TopCounters->Heap, which is no longer a
+// heap afterwards, so no more keys can be counted.
+//
+
+ULONG SortTopCounters(
+	IN	PTOPCOUNTERS	TopCounters)
+{
+	qsort(
+		TopCounters->Heap,
+		TopCounters->NumberOfCounters,
+		sizeof(PTOPCOUNTER),
+		CompareTopCounters);
+
+	return TopCounters->NumberOfCounters;
+}
\ No newline at end of file
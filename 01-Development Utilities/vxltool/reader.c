@@ -0,0 +1,629 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     reader.c
+//
+// Abstract:
+//
+//     Reads the entries of a VXL log file from start to end.
+//
+//     Unlike VxlOpenLog, this doesn't build an index of the whole file or
+//     keep the text of deferred entries around: the file is mapped, the
+//     records are looked at one after another, and only the current
+//     compressed block and the text of the current deferred entry are kept
+//     in memory. This means that logs of any size can be read in a fixed
+//     amount of memory, but entries can only be read in order.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                18-Oct-2026  Fix a signed/unsigned comparison.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "vxltool.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+STATIC CONST CHAR VXLL_MAGIC[] = {'V','X','L','L'};
+STATIC CONST WCHAR EmptyString[] = {'\0'};
+
+// Source string indices in log entries are no bigger than a USHORT.
+#define MAXIMUM_SOURCE_STRINGS 0x10000
+
+//
+// Used when reading a log file. String must stay valid until the reader is
+// closed (normally it points into the mapped file).
+//
+
+STATIC NTSTATUS AddSourceString(
+	IN	PLOGREADER		Reader,
+	IN	ULONG			SourceType,
+	IN	ULONG			Index,
+	IN	PCWSTR			String)
+{
+	ULONG NumberOfStrings;
+
+	if (SourceType >= VxlSourceMaximum) {
+		// Don't fail - a later version might add more source types.
+		return STATUS_SUCCESS;
+	}
+
+	NumberOfStrings = Reader->NumberOfSourceStrings[SourceType];
+
+	if (Index != NumberOfStrings || Index >= MAXIMUM_SOURCE_STRINGS) {
+		return STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	if (NumberOfStrings == Reader->MaximumSourceStrings[SourceType]) {
+		PCWSTR *NewStrings;
+		ULONG NewMaximum;
+
+		NewMaximum = max(NumberOfStrings * 2, 64);
+		NewStrings = (PCWSTR *) realloc((PVOID) Reader->SourceStrings[SourceType], NewMaximum * sizeof(PCWSTR));
+
+		if (!NewStrings) {
+			return STATUS_NO_MEMORY;
+		}
+
+		Reader->SourceStrings[SourceType] = NewStrings;
+		Reader->MaximumSourceStrings[SourceType] = NewMaximum;
+	}
+
+	Reader->SourceStrings[SourceType][Reader->NumberOfSourceStrings[SourceType]++] = String;
+	return STATUS_SUCCESS;
+}
+
+STATIC PCWSTR GetSourceString(
+	IN	PLOGREADER		Reader,
+	IN	VXLSOURCETYPE	SourceType,
+	IN	ULONG			Index)
+{
+	if (Index >= Reader->NumberOfSourceStrings[SourceType]) {
+		return EmptyString;
+	}
+
+	return Reader->SourceStrings[SourceType][Index];
+}
+
+//
+// Version 1 files keep the source names in fixed size arrays in the header,
+// which aren't null terminated if the name fills the whole array. Make
+// null terminated copies of them.
+//
+
+STATIC NTSTATUS LoadSourceStringsV1(
+	IN	PLOGREADER		Reader)
+{
+	STATIC CONST struct {
+		VXLSOURCETYPE	SourceType;
+		ULONG			FieldOffset;
+		ULONG			NumberOfNames;
+		ULONG			NameCch;
+	} Tables[] = {
+		{VxlSourceComponent,	FIELD_OFFSET(VXLLOGFILEHEADER_V1, SourceComponents),	64,		16},
+		{VxlSourceFile,			FIELD_OFFSET(VXLLOGFILEHEADER_V1, SourceFiles),			128,	16},
+		{VxlSourceFunction,		FIELD_OFFSET(VXLLOGFILEHEADER_V1, SourceFunctions),		256,	64}
+	};
+
+	NTSTATUS Status;
+	PWSTR NextString;
+	ULONG TableIndex;
+
+	Reader->OwnedStrings = (PWSTR) malloc(
+		(64 * (16 + 1) + 128 * (16 + 1) + 256 * (64 + 1)) * sizeof(WCHAR));
+
+	if (!Reader->OwnedStrings) {
+		return STATUS_NO_MEMORY;
+	}
+
+	NextString = Reader->OwnedStrings;
+
+	for (TableIndex = 0; TableIndex < ARRAYSIZE(Tables); ++TableIndex) {
+		PCBYTE Names;
+		ULONG Index;
+
+		Names = Reader->MappedFile + Tables[TableIndex].FieldOffset;
+
+		for (Index = 0; Index < Tables[TableIndex].NumberOfNames; ++Index) {
+			PCBYTE Name;
+			ULONG NameCch;
+
+			Name = Names + Index * Tables[TableIndex].NameCch * sizeof(WCHAR);
+			RtlCopyMemory(NextString, Name, Tables[TableIndex].NameCch * sizeof(WCHAR));
+			NextString[Tables[TableIndex].NameCch] = '\0';
+
+			if (NextString[0] == '\0') {
+				break;
+			}
+
+			Status = AddSourceString(Reader, Tables[TableIndex].SourceType, Index, NextString);
+			if (!NT_SUCCESS(Status)) {
+				return Status;
+			}
+
+			for (NameCch = 0; NextString[NameCch] != '\0'; ++NameCch);
+			NextString += NameCch + 1;
+		}
+	}
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS OpenLogReader(
+	OUT	PLOGREADER		Reader,
+	IN	PCSTR			FileName)
+{
+	NTSTATUS Status;
+	int FileDescriptor;
+	struct stat FileInformation;
+	PVOID MappedFile;
+	VXLLOGFILEHEADER Header;
+
+	RtlZeroMemory(Reader, sizeof(*Reader));
+	Reader->FileName = FileName;
+
+	//
+	// Map the whole file. Only the part which is being read has to be in
+	// memory at any one time, and we tell the system that the file will be
+	// read from start to end, so that it can read ahead and throw away the
+	// pages which we are finished with.
+	//
+
+	FileDescriptor = open(FileName, O_RDONLY);
+	if (FileDescriptor == -1) {
+		return STATUS_OPEN_FAILED;
+	}
+
+	if (fstat(FileDescriptor, &FileInformation) == -1) {
+		close(FileDescriptor);
+		return STATUS_OPEN_FAILED;
+	}
+
+	if ((ULONGLONG) FileInformation.st_size < sizeof(VXLLOGFILEHEADER) ||
+		(ULONGLONG) FileInformation.st_size != (SIZE_T) FileInformation.st_size) {
+
+		close(FileDescriptor);
+		return STATUS_FILE_INVALID;
+	}
+
+	MappedFile = mmap(NULL, (SIZE_T) FileInformation.st_size, PROT_READ, MAP_PRIVATE, FileDescriptor, 0);
+	close(FileDescriptor);
+
+	if (MappedFile == MAP_FAILED) {
+		return STATUS_OPEN_FAILED;
+	}
+
+	posix_madvise(MappedFile, (SIZE_T) FileInformation.st_size, POSIX_MADV_SEQUENTIAL);
+
+	Reader->MappedFile = (PBYTE) MappedFile;
+	Reader->MappedSize = (ULONGLONG) FileInformation.st_size;
+
+	//
+	// Validate the header. This is the same as what VxlOpenLog does.
+	//
+
+	RtlCopyMemory(&Header, Reader->MappedFile, sizeof(Header));
+
+	if (!RtlEqualMemory(Header.Magic, VXLL_MAGIC, sizeof(VXLL_MAGIC))) {
+		Status = STATUS_FILE_INVALID;
+		goto Failure;
+	}
+
+	if (Header.Version == 0 || Header.Version > VXLL_VERSION) {
+		Status = STATUS_VERSION_MISMATCH;
+		goto Failure;
+	}
+
+	Reader->Version = Header.Version;
+
+	if (Header.Version == 1) {
+		ULONG Index;
+
+		if (Reader->MappedSize < VXLL_V1_HEADER_SIZE) {
+			Status = STATUS_FILE_INVALID;
+			goto Failure;
+		}
+
+		// Version 1 files have no record of how much data they contain,
+		// so we have to trust the entry counts.
+		for (Index = 0; Index < LogSeverityMaximumValue; ++Index) {
+			Reader->RemainingEntries += Header.EventSeverityTypeCount[Index];
+		}
+
+		Reader->Offset = VXLL_V1_HEADER_SIZE;
+		Reader->EndOfData = Reader->MappedSize;
+
+		Status = LoadSourceStringsV1(Reader);
+		if (!NT_SUCCESS(Status)) {
+			goto Failure;
+		}
+	} else {
+		if (Header.HeaderSize < sizeof(VXLLOGFILEHEADER) ||
+			Header.CommittedLength < Header.HeaderSize) {
+
+			Status = STATUS_FILE_INVALID;
+			goto Failure;
+		}
+
+		if (Header.CommittedLength > Reader->MappedSize) {
+			// file was truncated
+			Status = STATUS_FILE_CORRUPT_ERROR;
+			goto Failure;
+		}
+
+		Reader->Offset = Header.HeaderSize;
+		Reader->EndOfData = Header.CommittedLength;
+	}
+
+	return STATUS_SUCCESS;
+
+Failure:
+	CloseLogReader(Reader);
+	return Status;
+}
+
+VOID CloseLogReader(
+	IN	PLOGREADER		Reader)
+{
+	ULONG Index;
+
+	if (Reader->MappedFile) {
+		munmap(Reader->MappedFile, (SIZE_T) Reader->MappedSize);
+		Reader->MappedFile = NULL;
+	}
+
+	for (Index = 0; Index < VxlSourceMaximum; ++Index) {
+		free((PVOID) Reader->SourceStrings[Index]);
+		Reader->SourceStrings[Index] = NULL;
+		Reader->NumberOfSourceStrings[Index] = 0;
+		Reader->MaximumSourceStrings[Index] = 0;
+	}
+
+	free(Reader->OwnedStrings);
+	Reader->OwnedStrings = NULL;
+
+	free(Reader->FormattedText);
+	Reader->FormattedText = NULL;
+	Reader->FormattedTextMaxCch = 0;
+}
+
+//
+// Split the text of an entry at the first double newline, unless it is at
+// the very end, in the same way as VxlpSplitLogText.
+//
+
+STATIC VOID SplitLogText(
+	IN	PCWSTR			Text,
+	IN	ULONG			TextCch,
+	OUT	PLOGENTRY		Entry)
+{
+	ULONG Index;
+
+	Entry->TextHeader = Text;
+	Entry->TextHeaderCch = TextCch;
+	Entry->Text = NULL;
+	Entry->TextCch = 0;
+
+	for (Index = 0; Index + 4 < TextCch; ++Index) {
+		if (Text[Index] == '\r' && Text[Index + 1] == '\n' &&
+			Text[Index + 2] == '\r' && Text[Index + 3] == '\n') {
+
+			Entry->TextHeaderCch = Index;
+			Entry->Text = Text + Index + 4;
+			Entry->TextCch = TextCch - Index - 4;
+			break;
+		}
+	}
+}
+
+//
+// Fill out the text of an entry from the TextHeaderCch and TextCch fields
+// of a file entry, which both include a null terminator (or are 0).
+//
+
+STATIC NTSTATUS SetLogEntryText(
+	IN	PCWSTR			Text,
+	IN	ULONG			TextHeaderCch,
+	IN	ULONG			TextCch,
+	IN	ULONG			AvailableCb,
+	OUT	PLOGENTRY		Entry)
+{
+	if ((TextHeaderCch + TextCch) * sizeof(WCHAR) > AvailableCb) {
+		return STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	Entry->TextHeader = TextHeaderCch ? Text : EmptyString;
+	Entry->TextHeaderCch = TextHeaderCch ? TextHeaderCch - 1 : 0;
+	Entry->Text = TextCch ? Text + TextHeaderCch : NULL;
+	Entry->TextCch = TextCch ? TextCch - 1 : 0;
+
+	return STATUS_SUCCESS;
+}
+
+STATIC NTSTATUS ReadLogEntryV1(
+	IN	PLOGREADER		Reader,
+	OUT	PLOGENTRY		Entry)
+{
+	NTSTATUS Status;
+	VXLLOGFILEENTRY_V1 FileEntry;
+	PCBYTE Record;
+	ULONGLONG AvailableCb;
+
+	if (Reader->RemainingEntries == 0) {
+		return STATUS_NO_MORE_ENTRIES;
+	}
+
+	if (Reader->Offset + sizeof(VXLLOGFILEENTRY_V1) > Reader->EndOfData) {
+		return STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	Record = Reader->MappedFile + Reader->Offset;
+	RtlCopyMemory(&FileEntry, Record, sizeof(FileEntry));
+	AvailableCb = Reader->EndOfData - Reader->Offset - sizeof(VXLLOGFILEENTRY_V1);
+
+	Status = SetLogEntryText(
+		(PCWSTR) (Record + sizeof(VXLLOGFILEENTRY_V1)),
+		FileEntry.TextHeaderCch,
+		FileEntry.TextCch,
+		(ULONG) min(AvailableCb, 0xFFFFFFFF),
+		Entry);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	Entry->SourceComponent	= GetSourceString(Reader, VxlSourceComponent, FileEntry.SourceComponentIndex);
+	Entry->SourceFile		= GetSourceString(Reader, VxlSourceFile, FileEntry.SourceFileIndex);
+	Entry->SourceFunction	= GetSourceString(Reader, VxlSourceFunction, FileEntry.SourceFunctionIndex);
+	Entry->SourceLine		= FileEntry.SourceLine;
+	Entry->ProcessId		= FileEntry.ProcessId;
+	Entry->ThreadId			= FileEntry.ThreadId;
+	Entry->Severity			= FileEntry.Severity;
+	Entry->Time64			= FileEntry.Time64;
+
+	Reader->Offset += sizeof(VXLLOGFILEENTRY_V1) + (FileEntry.TextHeaderCch + FileEntry.TextCch) * sizeof(WCHAR);
+	--Reader->RemainingEntries;
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Fill out an entry from a VXL_RECORD_LOG_ENTRY or VXL_RECORD_DEFERRED_LOG_ENTRY
+// record, which is known to fit in the file (or block). Records are always
+// 2-byte aligned, but not necessarily any more than that.
+//
+
+STATIC NTSTATUS ReadLogEntryRecord(
+	IN	PLOGREADER		Reader,
+	IN	PCBYTE			Record,
+	IN	ULONG			RecordCb,
+	OUT	PLOGENTRY		Entry)
+{
+	NTSTATUS Status;
+	VXLLOGFILEENTRY FileEntry;
+
+	// The fields before the text are the same in deferred entries, which
+	// can be shorter than a VXLLOGFILEENTRY (same checks as VxlpIsValidLogEntryRecord).
+	if (RecordCb < FIELD_OFFSET(VXLLOGFILEDEFERREDENTRY, Arguments)) {
+		return STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	RtlCopyMemory(&FileEntry, Record, FIELD_OFFSET(VXLLOGFILEENTRY, Text));
+
+	if (FileEntry.RecordType == VXL_RECORD_LOG_ENTRY) {
+		if (RecordCb < sizeof(VXLLOGFILEENTRY)) {
+			return STATUS_FILE_CORRUPT_ERROR;
+		}
+
+		Status = SetLogEntryText(
+			(PCWSTR) (Record + FIELD_OFFSET(VXLLOGFILEENTRY, Text)),
+			FileEntry.TextHeaderCch,
+			FileEntry.TextCch,
+			RecordCb - FIELD_OFFSET(VXLLOGFILEENTRY, Text),
+			Entry);
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+	} else {
+		VXLLOGFILEDEFERREDENTRY DeferredEntry;
+		PCWSTR Format;
+		ULONG TextCch;
+
+		RtlCopyMemory(&DeferredEntry, Record, FIELD_OFFSET(VXLLOGFILEDEFERREDENTRY, Arguments));
+
+		if ((ULONG) FIELD_OFFSET(VXLLOGFILEDEFERREDENTRY, Arguments) + DeferredEntry.ArgumentsCb > RecordCb) {
+			return STATUS_FILE_CORRUPT_ERROR;
+		}
+
+		//
+		// The text is formatted into a buffer which is reused for the next
+		// deferred entry. If the arguments are damaged, show the format
+		// string instead, like the log viewer does.
+		//
+
+		if (DeferredEntry.FormatIndex < Reader->NumberOfSourceStrings[VxlSourceFormat]) {
+			Format = Reader->SourceStrings[VxlSourceFormat][DeferredEntry.FormatIndex];
+
+			Status = FormatDeferredText(
+				Format,
+				Record + FIELD_OFFSET(VXLLOGFILEDEFERREDENTRY, Arguments),
+				DeferredEntry.ArgumentsCb,
+				&Reader->FormattedText,
+				&Reader->FormattedTextMaxCch,
+				&TextCch);
+
+			if (NT_SUCCESS(Status)) {
+				SplitLogText(Reader->FormattedText, TextCch, Entry);
+			} else if (Status == STATUS_FILE_CORRUPT_ERROR) {
+				for (TextCch = 0; Format[TextCch] != '\0'; ++TextCch);
+				SplitLogText(Format, TextCch, Entry);
+			} else {
+				return Status;
+			}
+		} else {
+			SplitLogText(EmptyString, 0, Entry);
+		}
+	}
+
+	Entry->SourceComponent	= GetSourceString(Reader, VxlSourceComponent, FileEntry.SourceComponentIndex);
+	Entry->SourceFile		= GetSourceString(Reader, VxlSourceFile, FileEntry.SourceFileIndex);
+	Entry->SourceFunction	= GetSourceString(Reader, VxlSourceFunction, FileEntry.SourceFunctionIndex);
+	Entry->SourceLine		= FileEntry.SourceLine;
+	Entry->ProcessId		= FileEntry.ProcessId;
+	Entry->ThreadId			= FileEntry.ThreadId;
+	Entry->Severity			= FileEntry.Severity;
+	Entry->Time64			= FileEntry.Time64;
+
+	return STATUS_SUCCESS;
+}
+
+STATIC NTSTATUS LoadBlock(
+	IN	PLOGREADER		Reader,
+	IN	PCBYTE			Record,
+	IN	ULONG			RecordCb)
+{
+	NTSTATUS Status;
+	VXLLOGFILEBLOCK Block;
+	ULONG DecompressedCb;
+
+	if (RecordCb < sizeof(VXLLOGFILEBLOCK)) {
+		return STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	RtlCopyMemory(&Block, Record, sizeof(Block));
+
+	if (RecordCb < sizeof(VXLLOGFILEBLOCK) + Block.DataCb ||
+		Block.DataCb > Block.UncompressedCb ||
+		Block.UncompressedCb > VXL_BLOCK_SIZE) {
+
+		return STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	if (Block.DataCb == Block.UncompressedCb) {
+		RtlCopyMemory(Reader->BlockData, Record + FIELD_OFFSET(VXLLOGFILEBLOCK, Data), Block.DataCb);
+	} else {
+		Status = VxlpDecompressBlock(
+			Record + FIELD_OFFSET(VXLLOGFILEBLOCK, Data),
+			Block.DataCb,
+			Reader->BlockData,
+			Block.UncompressedCb,
+			&DecompressedCb);
+
+		if (!NT_SUCCESS(Status) || DecompressedCb != Block.UncompressedCb) {
+			return STATUS_FILE_CORRUPT_ERROR;
+		}
+	}
+
+	Reader->BlockCb = Block.UncompressedCb;
+	Reader->BlockOffset = 0;
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Read the next entry. Returns STATUS_NO_MORE_ENTRIES at the end of the
+// log. Any other error means that the rest of the log can't be read.
+//
+
+NTSTATUS ReadLogEntry(
+	IN	PLOGREADER		Reader,
+	OUT	PLOGENTRY		Entry)
+{
+	NTSTATUS Status;
+
+	if (Reader->Version == 1) {
+		return ReadLogEntryV1(Reader, Entry);
+	}
+
+	while (TRUE) {
+		VXLLOGFILERECORD Record;
+		PCBYTE RecordData;
+
+		//
+		// Entries in the current block come first.
+		//
+
+		if (Reader->BlockOffset + sizeof(VXLLOGFILERECORD) <= Reader->BlockCb) {
+			RecordData = (PCBYTE) Reader->BlockData + Reader->BlockOffset;
+			RtlCopyMemory(&Record, RecordData, sizeof(Record));
+
+			if (Record.RecordSize < sizeof(VXLLOGFILERECORD) || (Record.RecordSize & 1) ||
+				Reader->BlockOffset + Record.RecordSize > Reader->BlockCb) {
+
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+
+			Reader->BlockOffset += Record.RecordSize;
+
+			if (Record.RecordType == VXL_RECORD_LOG_ENTRY || Record.RecordType == VXL_RECORD_DEFERRED_LOG_ENTRY) {
+				return ReadLogEntryRecord(Reader, RecordData, Record.RecordSize, Entry);
+			}
+
+			continue;
+		}
+
+		if (Reader->Offset + sizeof(VXLLOGFILERECORD) > Reader->EndOfData) {
+			return STATUS_NO_MORE_ENTRIES;
+		}
+
+		RecordData = Reader->MappedFile + Reader->Offset;
+		RtlCopyMemory(&Record, RecordData, sizeof(Record));
+
+		if (Record.RecordSize < sizeof(VXLLOGFILERECORD) || (Record.RecordSize & 1) ||
+			Reader->Offset + Record.RecordSize > Reader->EndOfData) {
+
+			return STATUS_FILE_CORRUPT_ERROR;
+		}
+
+		Reader->Offset += Record.RecordSize;
+
+		switch (Record.RecordType) {
+		case VXL_RECORD_LOG_ENTRY:
+		case VXL_RECORD_DEFERRED_LOG_ENTRY:
+			return ReadLogEntryRecord(Reader, RecordData, Record.RecordSize, Entry);
+		case VXL_RECORD_COMPRESSED_BLOCK:
+			Status = LoadBlock(Reader, RecordData, Record.RecordSize);
+			if (!NT_SUCCESS(Status)) {
+				return Status;
+			}
+
+			break;
+		case VXL_RECORD_SOURCE_STRING:
+			{
+				VXLLOGFILESTRING StringRecord;
+				PCWSTR String;
+
+				RtlCopyMemory(&StringRecord, RecordData, FIELD_OFFSET(VXLLOGFILESTRING, String));
+				String = (PCWSTR) (RecordData + FIELD_OFFSET(VXLLOGFILESTRING, String));
+
+				if (Record.RecordSize < sizeof(VXLLOGFILESTRING) + sizeof(WCHAR) ||
+					String[(Record.RecordSize - sizeof(VXLLOGFILESTRING)) / sizeof(WCHAR) - 1] != '\0') {
+
+					return STATUS_FILE_CORRUPT_ERROR;
+				}
+
+				Status = AddSourceString(Reader, StringRecord.SourceType, StringRecord.Index, String);
+				if (!NT_SUCCESS(Status)) {
+					return Status;
+				}
+			}
+
+			break;
+		default:
+			// Unknown record types should be skipped.
+			break;
+		}
+	}
+}
\ No newline at end of file
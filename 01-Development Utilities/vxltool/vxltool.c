@@ -0,0 +1,1031 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxltool.c
+//
+// Abstract:
+//
+//     Command line tool for querying VXL log files without VxlView.
+//
+//     vxltool reads one or more logs from start to end, keeps the entries
+//     which match the query and either writes them out (as text, CSV or
+//     JSON lines - the same formats as VxlView's export) or counts them by
+//     some key to show the most common ones. If there is more than one log,
+//     their entries are merged by time.
+//
+//     It is meant for logs which are too large to comfortably open in
+//     VxlView, and for scripts. It only uses the C library and POSIX file
+//     mapping, so it can be built on the build host as well as on Windows
+//     under Cygwin or MSYS2.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Keep a time conversion cache for output.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "vxltool.h"
+
+#include <errno.h>
+#include <limits.h>
+
+#define OUTPUT_BUFFER_SIZE				0x40000
+
+// One input log, and the entry which it will hand out next.
+typedef struct _INPUT {
+	LOGREADER				Reader;
+	LOGENTRY				Entry;
+	ULONG					Order;					// position on the command line
+} TYPEDEF_TYPE_NAME(INPUT);
+
+STATIC CONST PCSTR TopKeyNames[] = {
+	NULL,
+	"component",
+	"file",
+	"function",
+	"source",
+	"header",
+	"pid",
+	"tid",
+	"severity"
+};
+
+C_ASSERT(ARRAYSIZE(TopKeyNames) == TopKeyMaximum);
+
+STATIC BYTE OutputBuffer[OUTPUT_BUFFER_SIZE];
+STATIC ULONG OutputCb;
+STATIC BOOLEAN OutputFailed;
+STATIC VXLTIMECACHE OutputTimeCache;
+
+STATIC VOID PrintUsage(
+	VOID)
+{
+	fputs(
+		"Usage: vxltool [options] log.vxl [log.vxl ...]\n"
+		"\n"
+		"Writes out the entries of one or more VXL logs which match a query.\n"
+		"Entries of several logs are merged by time.\n"
+		"\n"
+		"Query:\n"
+		"  -s, --severity LIST   only these severities (critical, error, warning,\n"
+		"                        information, detail, debug)\n"
+		"  -c, --component LIST  only these source components\n"
+		"  -p, --pid LIST        only these process IDs\n"
+		"  -t, --tid LIST        only these thread IDs\n"
+		"      --since TIME      only entries at or after TIME\n"
+		"      --until TIME      only entries before TIME\n"
+		"  -x, --text TEXT       only entries containing TEXT\n"
+		"      --case            the text search is case sensitive\n"
+		"      --header-only     only search the text header\n"
+		"      --invert          only entries NOT containing TEXT\n"
+		"\n"
+		"Output:\n"
+		"  -f, --format FORMAT   text (default), csv or jsonl\n"
+		"      --count           only write the number of matching entries\n"
+		"      --top KEY         write the most common values of KEY among the\n"
+		"                        matching entries: component, file, function,\n"
+		"                        source, header, pid, tid or severity\n"
+		"  -n NUMBER             how many values --top writes (default 20)\n"
+		"\n"
+		"LISTs are separated by commas. TIMEs are UTC, written as\n"
+		"YYYY-MM-DD[THH:MM[:SS[.mmm]]]. Times in text output are also UTC.\n",
+		stdout);
+}
+
+PCSTR StatusToText(
+	IN	NTSTATUS	Status)
+{
+	switch (Status) {
+	case STATUS_NO_MEMORY:
+		return "out of memory";
+	case STATUS_VERSION_MISMATCH:
+		return "the log was written by a newer version of VxKex";
+	case STATUS_FILE_INVALID:
+		return "not a VXL log";
+	case STATUS_FILE_CORRUPT_ERROR:
+		return "the log is damaged";
+	case STATUS_BAD_COMPRESSION_BUFFER:
+		return "a compressed block of the log is damaged";
+	case STATUS_OPEN_FAILED:
+		return strerror(errno);
+	default:
+		return "unknown error";
+	}
+}
+
+//
+// Output
+//
+
+STATIC VOID FlushOutput(
+	VOID)
+{
+	if (OutputCb && !OutputFailed) {
+		if (fwrite(OutputBuffer, 1, OutputCb, stdout) != OutputCb) {
+			OutputFailed = TRUE;
+		}
+	}
+
+	OutputCb = 0;
+}
+
+STATIC VOID WriteAscii(
+	IN	PCSTR	String)
+{
+	ULONG StringCb;
+
+	StringCb = (ULONG) strlen(String);
+
+	if (OutputCb + StringCb > OUTPUT_BUFFER_SIZE) {
+		FlushOutput();
+	}
+
+	RtlCopyMemory(OutputBuffer + OutputCb, String, StringCb);
+	OutputCb += StringCb;
+}
+
+STATIC VOID WriteLogEntry(
+	IN	VXLEXPORTFORMAT	Format,
+	IN	PCLOGENTRY		Entry)
+{
+	VXLFORMATENTRY FormatEntry;
+	ULONG EntryCb;
+
+	FormatEntry.TextHeader		= Entry->TextHeader;
+	FormatEntry.TextHeaderCch	= Entry->TextHeaderCch;
+	FormatEntry.Text			= Entry->Text;
+	FormatEntry.TextCch			= Entry->TextCch;
+	FormatEntry.Severity		= SeverityToText(Entry->Severity);
+	FormatEntry.SourceComponent	= Entry->SourceComponent;
+	FormatEntry.SourceFile		= Entry->SourceFile;
+	FormatEntry.SourceFunction	= Entry->SourceFunction;
+	FormatEntry.SourceLine		= Entry->SourceLine;
+	FormatEntry.ProcessId		= Entry->ProcessId;
+	FormatEntry.ThreadId		= Entry->ThreadId;
+	FormatEntry.Time64			= Entry->Time64;
+
+	EntryCb = VxlpFormatLogEntry(
+		Format,
+		&FormatEntry,
+		0,
+		&OutputTimeCache,
+		OutputBuffer + OutputCb,
+		OUTPUT_BUFFER_SIZE - OutputCb);
+
+	if (OutputCb + EntryCb <= OUTPUT_BUFFER_SIZE) {
+		OutputCb += EntryCb;
+		return;
+	}
+
+	FlushOutput();
+
+	if (EntryCb <= OUTPUT_BUFFER_SIZE) {
+		OutputCb = VxlpFormatLogEntry(Format, &FormatEntry, 0, &OutputTimeCache, OutputBuffer, OUTPUT_BUFFER_SIZE);
+	} else {
+		PBYTE Buffer;
+
+		// Very big entry. This is rare enough that it can have its own buffer.
+		Buffer = (PBYTE) malloc(EntryCb);
+
+		if (Buffer) {
+			VxlpFormatLogEntry(Format, &FormatEntry, 0, &OutputTimeCache, Buffer, EntryCb);
+
+			if (!OutputFailed && fwrite(Buffer, 1, EntryCb, stdout) != EntryCb) {
+				OutputFailed = TRUE;
+			}
+
+			free(Buffer);
+		}
+	}
+}
+
+STATIC VOID WriteTopCounters(
+	IN	VXLEXPORTFORMAT	Format,
+	IN	PTOPCOUNTERS	TopCounters,
+	IN	ULONG			MaximumCount)
+{
+	ULONG NumberOfCounters;
+	ULONG Index;
+
+	NumberOfCounters = min(SortTopCounters(TopCounters), MaximumCount);
+
+	if (Format == VxlExportFormatCsv) {
+		WriteAscii("Count,Error,Key\r\n");
+	}
+
+	for (Index = 0; Index < NumberOfCounters; ++Index) {
+		PCTOPCOUNTER Counter;
+		CHAR Number[64];
+		ULONG KeyCb;
+
+		Counter = TopCounters->Heap[Index];
+
+		switch (Format) {
+		case VxlExportFormatText:
+			sprintf(Number, "%10lu  ", (unsigned long) Counter->Count);
+			break;
+		case VxlExportFormatCsv:
+			sprintf(Number, "%lu,%lu,", (unsigned long) Counter->Count, (unsigned long) Counter->Error);
+			break;
+		case VxlExportFormatJsonLines:
+			sprintf(Number, "{\"count\":%lu,\"error\":%lu,\"key\":",
+				(unsigned long) Counter->Count, (unsigned long) Counter->Error);
+			break;
+		default:
+			ASSERT (FALSE);
+			return;
+		}
+
+		WriteAscii(Number);
+
+		// Keys are at most TOP_MAXIMUM_KEY_CCH long, so this always fits
+		// in an empty buffer.
+		KeyCb = VxlpFormatString(Format, Counter->Key, Counter->KeyCch, OutputBuffer + OutputCb, OUTPUT_BUFFER_SIZE - OutputCb);
+
+		if (OutputCb + KeyCb > OUTPUT_BUFFER_SIZE) {
+			FlushOutput();
+			KeyCb = VxlpFormatString(Format, Counter->Key, Counter->KeyCch, OutputBuffer, OUTPUT_BUFFER_SIZE);
+		}
+
+		OutputCb += KeyCb;
+
+		if (Format == VxlExportFormatText && Counter->Error != 0) {
+			sprintf(Number, " (up to %lu less)", (unsigned long) Counter->Error);
+			WriteAscii(Number);
+		}
+
+		WriteAscii(Format == VxlExportFormatJsonLines ? "}\n" : (Format == VxlExportFormatCsv ? "\r\n" : "\n"));
+	}
+}
+
+//
+// Parsing of arguments
+//
+
+STATIC BOOLEAN EqualI(
+	IN	PCSTR	String1,
+	IN	PCSTR	String2)
+{
+	while (*String1 && *String2) {
+		CHAR Character1;
+		CHAR Character2;
+
+		Character1 = *String1++;
+		Character2 = *String2++;
+
+		if (Character1 >= 'A' && Character1 <= 'Z') {
+			Character1 += 'a' - 'A';
+		}
+
+		if (Character2 >= 'A' && Character2 <= 'Z') {
+			Character2 += 'a' - 'A';
+		}
+
+		if (Character1 != Character2) {
+			return FALSE;
+		}
+	}
+
+	return (*String1 == *String2);
+}
+
+//
+// Convert a UTF-8 string (which is what we get on the command line) to a
+// newly allocated, null terminated UTF-16 string. Invalid sequences become
+// U+FFFD.
+//
+
+STATIC PWSTR Utf8ToUtf16(
+	IN	PCSTR	String,
+	OUT	PULONG	StringCch OPTIONAL)
+{
+	PCBYTE Pointer;
+	PWSTR Buffer;
+	ULONG Cch;
+
+	// never more UTF-16 code units than there are UTF-8 bytes
+	Buffer = (PWSTR) malloc((strlen(String) + 1) * sizeof(WCHAR));
+	if (!Buffer) {
+		return NULL;
+	}
+
+	Pointer = (PCBYTE) String;
+	Cch = 0;
+
+	while (*Pointer) {
+		ULONG CodePoint;
+		ULONG Continuation;
+		ULONG Minimum;
+
+		if (*Pointer < 0x80) {
+			Buffer[Cch++] = *Pointer++;
+			continue;
+		} else if ((*Pointer & 0xE0) == 0xC0) {
+			CodePoint = *Pointer & 0x1F;
+			Continuation = 1;
+			Minimum = 0x80;
+		} else if ((*Pointer & 0xF0) == 0xE0) {
+			CodePoint = *Pointer & 0x0F;
+			Continuation = 2;
+			Minimum = 0x800;
+		} else if ((*Pointer & 0xF8) == 0xF0) {
+			CodePoint = *Pointer & 0x07;
+			Continuation = 3;
+			Minimum = 0x10000;
+		} else {
+			Buffer[Cch++] = 0xFFFD;
+			++Pointer;
+			continue;
+		}
+
+		++Pointer;
+
+		while (Continuation && (*Pointer & 0xC0) == 0x80) {
+			CodePoint = (CodePoint << 6) | (*Pointer++ & 0x3F);
+			--Continuation;
+		}
+
+		if (Continuation || CodePoint < Minimum || CodePoint > 0x10FFFF ||
+			(CodePoint >= 0xD800 && CodePoint <= 0xDFFF)) {
+
+			Buffer[Cch++] = 0xFFFD;
+		} else if (CodePoint >= 0x10000) {
+			CodePoint -= 0x10000;
+			Buffer[Cch++] = (WCHAR) (0xD800 | (CodePoint >> 10));
+			Buffer[Cch++] = (WCHAR) (0xDC00 | (CodePoint & 0x3FF));
+		} else {
+			Buffer[Cch++] = (WCHAR) CodePoint;
+		}
+	}
+
+	Buffer[Cch] = '\0';
+
+	if (StringCch) {
+		*StringCch = Cch;
+	}
+
+	return Buffer;
+}
+
+//
+// Split a comma separated list. The list is modified.
+//
+
+STATIC ULONG SplitList(
+	IN	PSTR	List,
+	OUT	PSTR	**Items)
+{
+	ULONG NumberOfItems;
+	PSTR Pointer;
+
+	NumberOfItems = 1;
+
+	for (Pointer = List; *Pointer; ++Pointer) {
+		if (*Pointer == ',') {
+			++NumberOfItems;
+		}
+	}
+
+	*Items = (PSTR *) malloc(NumberOfItems * sizeof(PSTR));
+	if (!*Items) {
+		return 0;
+	}
+
+	NumberOfItems = 0;
+	(*Items)[NumberOfItems++] = List;
+
+	for (Pointer = List; *Pointer; ++Pointer) {
+		if (*Pointer == ',') {
+			*Pointer = '\0';
+			(*Items)[NumberOfItems++] = Pointer + 1;
+		}
+	}
+
+	return NumberOfItems;
+}
+
+STATIC BOOLEAN ParseIdList(
+	IN	PSTR	List,
+	OUT	PULONG	*Ids,
+	OUT	PULONG	NumberOfIds)
+{
+	PSTR *Items;
+	ULONG NumberOfItems;
+	ULONG Index;
+
+	NumberOfItems = SplitList(List, &Items);
+	if (NumberOfItems == 0) {
+		return FALSE;
+	}
+
+	*Ids = (PULONG) malloc(NumberOfItems * sizeof(ULONG));
+	*NumberOfIds = NumberOfItems;
+
+	if (!*Ids) {
+		free(Items);
+		return FALSE;
+	}
+
+	for (Index = 0; Index < NumberOfItems; ++Index) {
+		PSTR End;
+		unsigned long Id;
+
+		errno = 0;
+		Id = strtoul(Items[Index], &End, 0);
+
+		if (End == Items[Index] || *End != '\0' || errno || Id > 0xFFFFFFFFUL) {
+			fprintf(stderr, "vxltool: '%s' is not a valid ID\n", Items[Index]);
+			free(Items);
+			return FALSE;
+		}
+
+		(*Ids)[Index] = (ULONG) Id;
+	}
+
+	free(Items);
+	return TRUE;
+}
+
+STATIC BOOLEAN ParseSeverityList(
+	IN	PSTR	List,
+	OUT	PQUERY	Query)
+{
+	PSTR *Items;
+	ULONG NumberOfItems;
+	ULONG Index;
+
+	NumberOfItems = SplitList(List, &Items);
+	if (NumberOfItems == 0) {
+		return FALSE;
+	}
+
+	for (Index = 0; Index < NumberOfItems; ++Index) {
+		VXLSEVERITY Severity;
+		CHAR Name[16];
+
+		for (Severity = 0; Severity < LogSeverityMaximumValue; ++Severity) {
+			ULONG Cch;
+			PCWSTR Text;
+
+			Text = SeverityToText(Severity);
+
+			for (Cch = 0; Text[Cch] != '\0'; ++Cch) {
+				Name[Cch] = (CHAR) Text[Cch];
+			}
+
+			Name[Cch] = '\0';
+
+			if (EqualI(Items[Index], Name)) {
+				break;
+			}
+		}
+
+		if (Severity == LogSeverityMaximumValue) {
+			fprintf(stderr, "vxltool: '%s' is not a severity\n", Items[Index]);
+			free(Items);
+			return FALSE;
+		}
+
+		Query->Severities[Severity] = TRUE;
+	}
+
+	Query->AnySeverity = FALSE;
+	free(Items);
+	return TRUE;
+}
+
+STATIC BOOLEAN ParseComponentList(
+	IN	PSTR	List,
+	OUT	PQUERY	Query)
+{
+	PSTR *Items;
+	ULONG NumberOfItems;
+	ULONG Index;
+
+	NumberOfItems = SplitList(List, &Items);
+	if (NumberOfItems == 0) {
+		return FALSE;
+	}
+
+	Query->Components = (PWSTR *) calloc(NumberOfItems, sizeof(PWSTR));
+	Query->NumberOfComponents = NumberOfItems;
+
+	if (!Query->Components) {
+		free(Items);
+		return FALSE;
+	}
+
+	for (Index = 0; Index < NumberOfItems; ++Index) {
+		Query->Components[Index] = Utf8ToUtf16(Items[Index], NULL);
+
+		if (!Query->Components[Index]) {
+			free(Items);
+			return FALSE;
+		}
+	}
+
+	free(Items);
+	return TRUE;
+}
+
+STATIC BOOLEAN ParseDigits(
+	IN OUT	PCSTR	*Pointer,
+	IN		ULONG	NumberOfDigits,
+	OUT		PULONG	Value)
+{
+	*Value = 0;
+
+	while (NumberOfDigits--) {
+		if (**Pointer < '0' || **Pointer > '9') {
+			return FALSE;
+		}
+
+		*Value = *Value * 10 + (*(*Pointer)++ - '0');
+	}
+
+	return TRUE;
+}
+
+//
+// Parse YYYY-MM-DD[THH:MM[:SS[.mmm]]][Z] (UTC) into a Windows timestamp.
+// A space is accepted in place of the T, so that times can be copied out
+// of the text export.
+//
+
+STATIC BOOLEAN ParseTime(
+	IN	PCSTR		String,
+	OUT	PLONGLONG	Time64)
+{
+	ULONG Year;
+	ULONG Month;
+	ULONG Day;
+	ULONG Hour;
+	ULONG Minute;
+	ULONG Second;
+	ULONG Millisecond;
+	LONGLONG Days;
+	LONG Era;
+	ULONG YearOfEra;
+	ULONG DayOfYear;
+
+	Hour = Minute = Second = Millisecond = 0;
+
+	if (!ParseDigits(&String, 4, &Year) || *String++ != '-' ||
+		!ParseDigits(&String, 2, &Month) || *String++ != '-' ||
+		!ParseDigits(&String, 2, &Day)) {
+
+		return FALSE;
+	}
+
+	if (*String == 'T' || *String == ' ') {
+		++String;
+
+		if (!ParseDigits(&String, 2, &Hour) || *String++ != ':' ||
+			!ParseDigits(&String, 2, &Minute)) {
+
+			return FALSE;
+		}
+
+		if (*String == ':') {
+			++String;
+
+			if (!ParseDigits(&String, 2, &Second)) {
+				return FALSE;
+			}
+
+			if (*String == '.') {
+				++String;
+
+				if (!ParseDigits(&String, 3, &Millisecond)) {
+					return FALSE;
+				}
+			}
+		}
+	}
+
+	if (*String == 'Z') {
+		++String;
+	}
+
+	if (*String != '\0' || Year < 1601 || Month < 1 || Month > 12 || Day < 1 || Day > 31 ||
+		Hour > 23 || Minute > 59 || Second > 59) {
+
+		return FALSE;
+	}
+
+	//
+	// Days since 1 March of year 0, the inverse of what vxlfmt.c does when
+	// it turns a timestamp into a date.
+	//
+
+	if (Month <= 2) {
+		--Year;
+	}
+
+	Era = (LONG) (Year / 400);
+	YearOfEra = Year - Era * 400;
+	DayOfYear = (153 * (Month > 2 ? Month - 3 : Month + 9) + 2) / 5 + Day - 1;
+	Days = (LONGLONG) Era * 146097 + YearOfEra * 365 + YearOfEra / 4 - YearOfEra / 100 + DayOfYear;
+
+	// 584694 days from 1 March 0000 to 1 January 1601
+	Days -= 584694;
+
+	*Time64 = Days * VXL_TIME_UNITS_PER_DAY +
+		((LONGLONG) Hour * 3600 + Minute * 60 + Second) * VXL_TIME_UNITS_PER_SECOND +
+		(LONGLONG) Millisecond * VXL_TIME_UNITS_PER_MILLISECOND;
+
+	return TRUE;
+}
+
+STATIC BOOLEAN SetTextFilter(
+	IN	PCSTR	Text,
+	IN	BOOLEAN	CaseSensitive,
+	OUT	PQUERY	Query)
+{
+	PWSTR Needle;
+	ULONG NeedleCch;
+
+	Needle = Utf8ToUtf16(Text, &NeedleCch);
+	if (!Needle) {
+		return FALSE;
+	}
+
+	if (NeedleCch == 0) {
+		// empty filter always matches
+		free(Needle);
+		return TRUE;
+	}
+
+	Query->TextSearcher = (PKEX_RTL_STRING_SEARCHER) malloc(KEX_SEARCH_SEARCHER_SIZE(NeedleCch));
+	if (!Query->TextSearcher) {
+		free(Needle);
+		return FALSE;
+	}
+
+	KexRtlpInitializeStringSearcher(
+		Query->TextSearcher,
+		Needle,
+		NeedleCch,
+		CaseSensitive ? 0 : KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE);
+
+	free(Needle);
+	return TRUE;
+}
+
+//
+// Merging of several logs. The inputs which still have entries are kept
+// in a min-heap ordered by the time of their next entry (and by their
+// position on the command line, so that entries with the same time come
+// out in a predictable order). Entries of each log are assumed to be in
+// order already, which they are unless the clock was changed.
+//
+
+STATIC BOOLEAN InputIsBefore(
+	IN	PCINPUT	Input1,
+	IN	PCINPUT	Input2)
+{
+	if (Input1->Entry.Time64 != Input2->Entry.Time64) {
+		return (Input1->Entry.Time64 < Input2->Entry.Time64);
+	}
+
+	return (Input1->Order < Input2->Order);
+}
+
+STATIC VOID SiftDownInput(
+	IN	PPINPUT	Heap,
+	IN	ULONG	HeapSize,
+	IN	ULONG	Index)
+{
+	until (FALSE) {
+		ULONG Smallest;
+		ULONG Child;
+		PINPUT Input;
+
+		Smallest = Index;
+		Child = Index * 2 + 1;
+
+		if (Child < HeapSize && InputIsBefore(Heap[Child], Heap[Smallest])) {
+			Smallest = Child;
+		}
+
+		++Child;
+
+		if (Child < HeapSize && InputIsBefore(Heap[Child], Heap[Smallest])) {
+			Smallest = Child;
+		}
+
+		if (Smallest == Index) {
+			break;
+		}
+
+		Input = Heap[Index];
+		Heap[Index] = Heap[Smallest];
+		Heap[Smallest] = Input;
+		Index = Smallest;
+	}
+}
+
+//
+// Read the next entry of an input. Returns FALSE if there are no more,
+// either because the end of the log was reached or because of an error,
+// which is reported.
+//
+
+STATIC BOOLEAN AdvanceInput(
+	IN	PINPUT	Input,
+	OUT	PBOOLEAN	ErrorOccurred)
+{
+	NTSTATUS Status;
+
+	Status = ReadLogEntry(&Input->Reader, &Input->Entry);
+
+	if (NT_SUCCESS(Status) && Status != STATUS_NO_MORE_ENTRIES) {
+		return TRUE;
+	}
+
+	if (Status != STATUS_NO_MORE_ENTRIES) {
+		fprintf(stderr, "vxltool: %s: %s, the rest of it was skipped\n",
+			Input->Reader.FileName, StatusToText(Status));
+
+		*ErrorOccurred = TRUE;
+	}
+
+	return FALSE;
+}
+
+int main(
+	IN	int		argc,
+	IN	char	**argv)
+{
+	QUERY Query;
+	VXLEXPORTFORMAT Format;
+	TOPKEY TopKey;
+	TOPCOUNTERS TopCounters;
+	ULONG TopCount;
+	BOOLEAN CountOnly;
+	BOOLEAN CaseSensitive;
+	PCSTR Text;
+	PINPUT Inputs;
+	PPINPUT Heap;
+	ULONG NumberOfInputs;
+	ULONG HeapSize;
+	ULONGLONG NumberOfMatches;
+	BOOLEAN ErrorOccurred;
+	int ArgumentIndex;
+	int FirstInput;
+
+	RtlZeroMemory(&Query, sizeof(Query));
+	Query.AnySeverity = TRUE;
+	Query.Since = LLONG_MIN;
+	Query.Until = LLONG_MAX;
+
+	Format = VxlExportFormatText;
+	TopKey = TopKeyNone;
+	TopCount = 20;
+	CountOnly = FALSE;
+	CaseSensitive = FALSE;
+	Text = NULL;
+	ErrorOccurred = FALSE;
+	VxlpInitializeTimeCache(&OutputTimeCache);
+
+	//
+	// Parse the command line.
+	//
+
+	for (ArgumentIndex = 1; ArgumentIndex < argc; ++ArgumentIndex) {
+		PSTR Argument;
+		PSTR Value;
+
+		Argument = argv[ArgumentIndex];
+
+		if (Argument[0] != '-' || Argument[1] == '\0') {
+			break;
+		}
+
+		if (strcmp(Argument, "--") == 0) {
+			++ArgumentIndex;
+			break;
+		}
+
+		if (strcmp(Argument, "-h") == 0 || strcmp(Argument, "--help") == 0) {
+			PrintUsage();
+			return 0;
+		} else if (strcmp(Argument, "--count") == 0) {
+			CountOnly = TRUE;
+			continue;
+		} else if (strcmp(Argument, "--case") == 0) {
+			CaseSensitive = TRUE;
+			continue;
+		} else if (strcmp(Argument, "--invert") == 0) {
+			Query.TextInverted = TRUE;
+			continue;
+		} else if (strcmp(Argument, "--header-only") == 0) {
+			Query.HeaderOnly = TRUE;
+			continue;
+		}
+
+		// everything else takes a value
+		if (ArgumentIndex + 1 >= argc) {
+			fprintf(stderr, "vxltool: %s needs a value\n", Argument);
+			return 2;
+		}
+
+		Value = argv[++ArgumentIndex];
+
+		if (strcmp(Argument, "-f") == 0 || strcmp(Argument, "--format") == 0) {
+			if (EqualI(Value, "text")) {
+				Format = VxlExportFormatText;
+			} else if (EqualI(Value, "csv")) {
+				Format = VxlExportFormatCsv;
+			} else if (EqualI(Value, "jsonl") || EqualI(Value, "json")) {
+				Format = VxlExportFormatJsonLines;
+			} else {
+				fprintf(stderr, "vxltool: '%s' is not an output format\n", Value);
+				return 2;
+			}
+		} else if (strcmp(Argument, "-s") == 0 || strcmp(Argument, "--severity") == 0) {
+			if (!ParseSeverityList(Value, &Query)) {
+				return 2;
+			}
+		} else if (strcmp(Argument, "-c") == 0 || strcmp(Argument, "--component") == 0) {
+			if (!ParseComponentList(Value, &Query)) {
+				return 2;
+			}
+		} else if (strcmp(Argument, "-p") == 0 || strcmp(Argument, "--pid") == 0) {
+			if (!ParseIdList(Value, &Query.ProcessIds, &Query.NumberOfProcessIds)) {
+				return 2;
+			}
+		} else if (strcmp(Argument, "-t") == 0 || strcmp(Argument, "--tid") == 0) {
+			if (!ParseIdList(Value, &Query.ThreadIds, &Query.NumberOfThreadIds)) {
+				return 2;
+			}
+		} else if (strcmp(Argument, "--since") == 0 || strcmp(Argument, "--until") == 0) {
+			if (!ParseTime(Value, Argument[2] == 's' ? &Query.Since : &Query.Until)) {
+				fprintf(stderr, "vxltool: '%s' is not a valid time\n", Value);
+				return 2;
+			}
+		} else if (strcmp(Argument, "-x") == 0 || strcmp(Argument, "--text") == 0) {
+			Text = Value;
+		} else if (strcmp(Argument, "--top") == 0) {
+			for (TopKey = TopKeyNone + 1; TopKey < TopKeyMaximum; ++TopKey) {
+				if (EqualI(Value, TopKeyNames[TopKey])) {
+					break;
+				}
+			}
+
+			if (TopKey == TopKeyMaximum) {
+				fprintf(stderr, "vxltool: '%s' is not something --top can count\n", Value);
+				return 2;
+			}
+		} else if (strcmp(Argument, "-n") == 0) {
+			PSTR End;
+
+			TopCount = (ULONG) strtoul(Value, &End, 10);
+
+			if (End == Value || *End != '\0' || TopCount == 0) {
+				fprintf(stderr, "vxltool: '%s' is not a valid number\n", Value);
+				return 2;
+			}
+		} else {
+			fprintf(stderr, "vxltool: unknown option %s (try --help)\n", Argument);
+			return 2;
+		}
+	}
+
+	FirstInput = ArgumentIndex;
+	NumberOfInputs = (ULONG) (argc - FirstInput);
+
+	if (NumberOfInputs == 0) {
+		PrintUsage();
+		return 2;
+	}
+
+	if (Text && !SetTextFilter(Text, CaseSensitive, &Query)) {
+		fprintf(stderr, "vxltool: %s\n", StatusToText(STATUS_NO_MEMORY));
+		return 2;
+	}
+
+	if (TopKey != TopKeyNone && !InitializeTopCounters(&TopCounters, max(TopCount, TOP_DEFAULT_CAPACITY))) {
+		fprintf(stderr, "vxltool: %s\n", StatusToText(STATUS_NO_MEMORY));
+		return 2;
+	}
+
+	//
+	// Open the logs and read the first entry of each one.
+	//
+
+	Inputs = (PINPUT) calloc(NumberOfInputs, sizeof(INPUT));
+	Heap = (PPINPUT) calloc(NumberOfInputs, sizeof(PINPUT));
+
+	if (!Inputs || !Heap) {
+		fprintf(stderr, "vxltool: %s\n", StatusToText(STATUS_NO_MEMORY));
+		return 2;
+	}
+
+	HeapSize = 0;
+
+	for (ArgumentIndex = 0; (ULONG) ArgumentIndex < NumberOfInputs; ++ArgumentIndex) {
+		NTSTATUS Status;
+		PINPUT Input;
+
+		Input = &Inputs[ArgumentIndex];
+		Input->Order = ArgumentIndex;
+
+		Status = OpenLogReader(&Input->Reader, argv[FirstInput + ArgumentIndex]);
+		if (!NT_SUCCESS(Status)) {
+			fprintf(stderr, "vxltool: %s: %s\n", argv[FirstInput + ArgumentIndex], StatusToText(Status));
+			ErrorOccurred = TRUE;
+			continue;
+		}
+
+		if (AdvanceInput(Input, &ErrorOccurred)) {
+			Heap[HeapSize++] = Input;
+		}
+	}
+
+	for (ArgumentIndex = (int) HeapSize / 2 - 1; ArgumentIndex >= 0; --ArgumentIndex) {
+		SiftDownInput(Heap, HeapSize, ArgumentIndex);
+	}
+
+	//
+	// Go through the entries in order of time.
+	//
+
+	if (!CountOnly && TopKey == TopKeyNone) {
+		OutputCb = VxlpFormatExportHeader(Format, OutputBuffer, OUTPUT_BUFFER_SIZE);
+	}
+
+	NumberOfMatches = 0;
+
+	while (HeapSize != 0 && !OutputFailed) {
+		PINPUT Input;
+
+		Input = Heap[0];
+
+		if (LogEntryMatchesQuery(&Query, &Input->Entry)) {
+			++NumberOfMatches;
+
+			if (TopKey != TopKeyNone) {
+				CountTopKey(&TopCounters, TopKey, &Input->Entry);
+			} else if (!CountOnly) {
+				WriteLogEntry(Format, &Input->Entry);
+			}
+		}
+
+		unless (AdvanceInput(Input, &ErrorOccurred)) {
+			Heap[0] = Heap[--HeapSize];
+		}
+
+		SiftDownInput(Heap, HeapSize, 0);
+	}
+
+	if (CountOnly) {
+		CHAR Number[32];
+
+		sprintf(Number, "%llu\n", (unsigned long long) NumberOfMatches);
+		WriteAscii(Number);
+	} else if (TopKey != TopKeyNone) {
+		WriteTopCounters(Format, &TopCounters, TopCount);
+
+		if (TopCounters.Approximate) {
+			fprintf(stderr,
+				"vxltool: there were more than %lu different keys, so some counts are approximate\n",
+				(unsigned long) TopCounters.Capacity);
+		}
+
+		FreeTopCounters(&TopCounters);
+	}
+
+	FlushOutput();
+
+	if (OutputFailed || fflush(stdout) != 0) {
+		fprintf(stderr, "vxltool: could not write the output: %s\n", strerror(errno));
+		ErrorOccurred = TRUE;
+	}
+
+	for (ArgumentIndex = 0; (ULONG) ArgumentIndex < NumberOfInputs; ++ArgumentIndex) {
+		CloseLogReader(&Inputs[ArgumentIndex].Reader);
+	}
+
+	free(Inputs);
+	free(Heap);
+	free(Query.TextSearcher);
+	free(Query.ProcessIds);
+	free(Query.ThreadIds);
+
+	if (Query.Components) {
+		for (ArgumentIndex = 0; (ULONG) ArgumentIndex < Query.NumberOfComponents; ++ArgumentIndex) {
+			free(Query.Components[ArgumentIndex]);
+		}
+
+		free(Query.Components);
+	}
+
+	return ErrorOccurred ? 2 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,220 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxltool.h
+//
+// Abstract:
+//
+//     Private header file for vxltool.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <KexHost.h>
+#include <VxlFile.h>
+#include "vxlcomp.h"
+#include "vxlfmt.h"
+#include "strsrch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Longest key kept by the top-N counter. Longer keys (usually text headers)
+// are cut off, so entries which only differ after this many characters are
+// counted together.
+//
+
+#define TOP_MAXIMUM_KEY_CCH				200
+#define TOP_DEFAULT_CAPACITY			4096
+
+// Text of a deferred entry is never allowed to grow longer than this.
+#define DEFERRED_MAXIMUM_TEXT_CCH		0x10000
+
+//
+// A log entry, as returned by ReadLogEntry. All strings point into the
+// mapped file or into buffers owned by the reader, and stay valid until
+// the next entry is read from the same reader.
+//
+
+typedef struct _LOGENTRY {
+	PCWSTR					TextHeader;
+	ULONG					TextHeaderCch;			// not including the null terminator
+	PCWSTR					Text;					// NULL if the entry has no body text
+	ULONG					TextCch;
+	PCWSTR					SourceComponent;		// never NULL
+	PCWSTR					SourceFile;
+	PCWSTR					SourceFunction;
+	ULONG					SourceLine;
+	ULONG					ProcessId;
+	ULONG					ThreadId;
+	VXLSEVERITY				Severity;				// may be out of range in a damaged file
+	LONGLONG				Time64;					// UTC
+} TYPEDEF_TYPE_NAME(LOGENTRY);
+
+//
+// Reads the entries of one log file in order, without building an index
+// of the whole file. Memory use doesn't depend on the size of the log,
+// except for the source string tables.
+//
+
+typedef struct _LOGREADER {
+	PCSTR					FileName;
+	PBYTE					MappedFile;
+	ULONGLONG				MappedSize;
+	ULONG					Version;
+
+	ULONGLONG				Offset;					// of the next record or v1 entry
+	ULONGLONG				EndOfData;
+	ULONG					RemainingEntries;		// v1 files only
+
+	// current compressed block, if any
+	ULONGLONG				BlockData[VXL_BLOCK_SIZE / sizeof(ULONGLONG)];
+	ULONG					BlockCb;
+	ULONG					BlockOffset;
+
+	// source strings (see VXLSOURCETYPE)
+	PCWSTR					*SourceStrings[VxlSourceMaximum];
+	ULONG					NumberOfSourceStrings[VxlSourceMaximum];
+	ULONG					MaximumSourceStrings[VxlSourceMaximum];
+	PWSTR					OwnedStrings;			// copies of v1 source names
+
+	// text of the current deferred entry
+	PWSTR					FormattedText;
+	ULONG					FormattedTextMaxCch;
+} TYPEDEF_TYPE_NAME(LOGREADER);
+
+typedef enum _TOPKEY {
+	TopKeyNone,
+	TopKeyComponent,
+	TopKeyFile,
+	TopKeyFunction,
+	TopKeySource,							// file:line
+	TopKeyHeader,
+	TopKeyProcessId,
+	TopKeyThreadId,
+	TopKeySeverity,
+	TopKeyMaximum
+} TOPKEY;
+
+typedef struct _QUERY {
+	BOOLEAN					Severities[LogSeverityMaximumValue];
+	BOOLEAN					AnySeverity;
+
+	PWSTR					*Components;			// NULL if any component is allowed
+	ULONG					NumberOfComponents;
+
+	PULONG					ProcessIds;				// NULL if any process is allowed
+	ULONG					NumberOfProcessIds;
+	PULONG					ThreadIds;
+	ULONG					NumberOfThreadIds;
+
+	LONGLONG				Since;					// inclusive
+	LONGLONG				Until;					// exclusive
+
+	PKEX_RTL_STRING_SEARCHER TextSearcher;			// NULL if there is no text filter
+	BOOLEAN					TextInverted;
+	BOOLEAN					HeaderOnly;
+
+	// the last component name which was checked, and whether it matched
+	PCWSTR					LastComponent;
+	BOOLEAN					LastComponentMatched;
+} TYPEDEF_TYPE_NAME(QUERY);
+
+typedef struct _TOPCOUNTER {
+	ULONG					Count;
+	ULONG					Error;					// Count may be too high by up to this much
+	ULONG					Hash;
+	ULONG					HeapIndex;
+	struct _TOPCOUNTER		*Next;					// in the same hash bucket
+	ULONG					KeyCch;
+	WCHAR					Key[TOP_MAXIMUM_KEY_CCH];
+} TYPEDEF_TYPE_NAME(TOPCOUNTER);
+
+//
+// Counts how often each key turns up, using a fixed number of counters
+// (the "space saving" algorithm). If there are more distinct keys than
+// counters, the least counted key is replaced, so the counts of keys which
+// are seen rarely may be too high, but the most frequent keys are always
+// kept.
+//
+
+typedef struct _TOPCOUNTERS {
+	PTOPCOUNTER				Counters;
+	PPTOPCOUNTER			Heap;					// min-heap on Count
+	PPTOPCOUNTER			Buckets;
+	ULONG					NumberOfBuckets;		// power of 2
+	ULONG					Capacity;
+	ULONG					NumberOfCounters;
+	BOOLEAN					Approximate;			// TRUE once a counter has been replaced
+} TYPEDEF_TYPE_NAME(TOPCOUNTERS);
+
+//
+// reader.c
+//
+
+NTSTATUS OpenLogReader(
+	OUT	PLOGREADER			Reader,
+	IN	PCSTR				FileName);
+
+VOID CloseLogReader(
+	IN	PLOGREADER			Reader);
+
+NTSTATUS ReadLogEntry(
+	IN	PLOGREADER			Reader,
+	OUT	PLOGENTRY			Entry);
+
+//
+// defer.c
+//
+
+NTSTATUS FormatDeferredText(
+	IN		PCWSTR			Format,
+	IN		PCBYTE			Arguments,
+	IN		ULONG			ArgumentsCb,
+	IN OUT	PWSTR			*Buffer,
+	IN OUT	PULONG			BufferMaxCch,
+	OUT		PULONG			TextCch);
+
+//
+// query.c
+//
+
+PCWSTR SeverityToText(
+	IN	VXLSEVERITY			Severity);
+
+BOOLEAN LogEntryMatchesQuery(
+	IN	PQUERY				Query,
+	IN	PCLOGENTRY			Entry);
+
+BOOLEAN InitializeTopCounters(
+	OUT	PTOPCOUNTERS		TopCounters,
+	IN	ULONG				Capacity);
+
+VOID FreeTopCounters(
+	IN	PTOPCOUNTERS		TopCounters);
+
+VOID CountTopKey(
+	IN	PTOPCOUNTERS		TopCounters,
+	IN	TOPKEY				KeyType,
+	IN	PCLOGENTRY			Entry);
+
+ULONG SortTopCounters(
+	IN	PTOPCOUNTERS		TopCounters);
+
+//
+// vxltool.c
+//
+
+PCSTR StatusToText(
+	IN	NTSTATUS			Status);
\ No newline at end of file
@@ -0,0 +1,55 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     hosttest.h
+//
+// Abstract:
+//
+//     Things which all of the host tests in this folder need: the CHECK
+//     macro, the failure count which it keeps, and a small random number
+//     generator which always starts from the same seed, so that a failure
+//     can be reproduced.
+//
+// Author:
+//
+//     agent (18-Oct-2026)
+//
+// Revision History:
+//
+//     agent                18-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <KexHost.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// seconds from 1 January 1601 to 1 January 1970
+#define UNIX_EPOCH_SECONDS 11644473600LL
+
+// Not every program which includes this uses CHECK (e.g. the fuzz target).
+STATIC ULONG Failures __attribute__((unused));
+
+#define CHECK(Condition) \
+	do { \
+		if (!(Condition)) { \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #Condition); \
+			++Failures; \
+		} \
+	} while (0)
+
+// xorshift32
+STATIC INLINE ULONG Random(
+	VOID)
+{
+	STATIC ULONG State = 0x12345678;
+
+	State ^= State << 13;
+	State ^= State >> 17;
+	State ^= State << 5;
+	return State;
+}
\ No newline at end of file
@@ -17,6 +17,12 @@
 //
 //     vxiiduu              14-Oct-2022  Initial creation.
 //     vxiiduu              05-Jan-2023  Convert to user friendly NTSTATUS.
+//     agent                17-Oct-2026  Add sync vs. async throughput benchmark.
+//     agent                17-Oct-2026  Benchmark mapped write mode as well.
+//     agent                17-Oct-2026  Benchmark deferred formatting.
+//     agent                17-Oct-2026  Benchmark process startup at each log
+//                                       severity threshold.
+//     agent                17-Oct-2026  Benchmark compressed mode.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -26,6 +32,16 @@
 #include <KexDll.h>
 
 #define TEST_LOG_FILE_NAME L"\\??\\C:\\Users\\vxiiduu\\Desktop\\Test.vxl"
+#define BENCHMARK_SYNC_LOG_FILE_NAME L"\\??\\C:\\Users\\vxiiduu\\Desktop\\TestSync.vxl"
+#define BENCHMARK_ASYNC_LOG_FILE_NAME L"\\??\\C:\\Users\\vxiiduu\\Desktop\\TestAsync.vxl"
+#define BENCHMARK_MAPPED_LOG_FILE_NAME L"\\??\\C:\\Users\\vxiiduu\\Desktop\\TestMapped.vxl"
+#define BENCHMARK_ASYNC_MAPPED_LOG_FILE_NAME L"\\??\\C:\\Users\\vxiiduu\\Desktop\\TestAsyncMapped.vxl"
+#define BENCHMARK_DEFERRED_LOG_FILE_NAME L"\\??\\C:\\Users\\vxiiduu\\Desktop\\TestDeferred.vxl"
+#define BENCHMARK_COMPRESSED_LOG_FILE_NAME L"\\??\\C:\\Users\\vxiiduu\\Desktop\\TestCompressed.vxl"
+#define STARTUP_TEST_EXE_NAME L"\\??\\C:\\Users\\vxiiduu\\Desktop\\StartupTest.exe"
+#define STARTUP_TEST_ITERATIONS 50
+#define NUMBER_OF_THREADS 6
+#define ENTRIES_PER_THREAD 100000
 VXLHANDLE LogHandle;
 
 NTSTATUS NTAPI ThreadProc(
@@ -37,7 +53,7 @@ NTSTATUS NTAPI ThreadProc(
 
 	Severity = (VXLSEVERITY) (ULONG) Parameter;
 
-	for (Index = 0; Index < 100000; ++Index) {
+	for (Index = 0; Index < ENTRIES_PER_THREAD; ++Index) {
 		Status = VxlWriteLog(
 			LogHandle,
 			KEX_COMPONENT,
@@ -55,6 +71,268 @@ NTSTATUS NTAPI ThreadProc(
 	return Status;
 }
 
+//
+// Write NUMBER_OF_THREADS * ENTRIES_PER_THREAD entries to a fresh log file
+// and print how long it took. The time includes closing the log, so that
+// buffered entries which still have to be written out are accounted for.
+//
+NTSTATUS BenchmarkThroughput(
+	IN	PCWSTR	FileName,
+	IN	ULONG	Flags)
+{
+	NTSTATUS Status;
+	UNICODE_STRING SourceApplication;
+	UNICODE_STRING LogFileName;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	HANDLE ThreadHandles[NUMBER_OF_THREADS];
+	LONGLONG StartTime;
+	LONGLONG EndTime;
+	LONGLONG Frequency;
+	ULONG Milliseconds;
+	ULONG Index;
+
+	RtlInitConstantUnicodeString(&SourceApplication, L"VxKex");
+	RtlInitUnicodeString(&LogFileName, FileName);
+	InitializeObjectAttributes(&ObjectAttributes, &LogFileName, OBJ_CASE_INSENSITIVE, NULL, NULL);
+
+	Status = VxlOpenLogEx(
+		&LogHandle,
+		&SourceApplication,
+		&ObjectAttributes,
+		GENERIC_WRITE,
+		FILE_OVERWRITE_IF,
+		Flags);
+
+	if (!NT_SUCCESS(Status)) {
+		DbgPrint("Failed to open benchmark log file. NTSTATUS error code: %ws\r\n",
+			KexRtlNtStatusToString(Status));
+		return Status;
+	}
+
+	NtQueryPerformanceCounter(&StartTime, &Frequency);
+
+	for (Index = 0; Index < NUMBER_OF_THREADS; ++Index) {
+		Status = RtlCreateUserThread(
+			NtCurrentProcess(),
+			NULL,
+			FALSE,
+			0,
+			0,
+			0,
+			ThreadProc,
+			(PVOID) Index,
+			&ThreadHandles[Index],
+			NULL);
+
+		if (!NT_SUCCESS(Status)) {
+			DbgPrint("Failed to create thread #%d. NTSTATUS error code: %ws\r\n",
+				Index, KexRtlNtStatusToString(Status));
+			NtTerminateProcess(NtCurrentProcess(), Status);
+		}
+	}
+
+	NtWaitForMultipleObjects(
+		ARRAYSIZE(ThreadHandles),
+		ThreadHandles,
+		WaitAllObject,
+		FALSE,
+		NULL);
+
+	Status = VxlCloseLog(&LogHandle);
+	NtQueryPerformanceCounter(&EndTime, NULL);
+
+	Milliseconds = (ULONG) (((EndTime - StartTime) * 1000) / Frequency);
+
+	DbgPrint("%s%s%s%s: %lu entries in %lu ms (%lu entries/sec)\r\n",
+		(Flags & VXL_OPEN_ASYNCHRONOUS_WRITE) ? "Asynchronous" : "Synchronous",
+		(Flags & VXL_OPEN_MAPPED_WRITE) ? ", mapped" : "",
+		(Flags & VXL_OPEN_DEFERRED_FORMATTING) ? ", deferred" : "",
+		(Flags & VXL_OPEN_COMPRESSED) ? ", compressed" : "",
+		NUMBER_OF_THREADS * ENTRIES_PER_THREAD,
+		Milliseconds,
+		(ULONG) ((NUMBER_OF_THREADS * ENTRIES_PER_THREAD * 1000ULL) / max(Milliseconds, 1)));
+
+	ForEachArrayItem (ThreadHandles, Index) {
+		NtClose(ThreadHandles[Index]);
+	}
+
+	return Status;
+}
+
+//
+// Run a VxKex-enabled program which exits immediately STARTUP_TEST_ITERATIONS
+// times, and print the average time from process creation to process exit.
+// The log severity threshold is set in HKCU before starting the processes.
+//
+NTSTATUS BenchmarkProcessStartup(
+	IN	HANDLE		VxKexKeyHandle,
+	IN	VXLSEVERITY	Threshold)
+{
+	NTSTATUS Status;
+	UNICODE_STRING ValueName;
+	UNICODE_STRING ImagePathName;
+	PRTL_USER_PROCESS_PARAMETERS ProcessParameters;
+	RTL_USER_PROCESS_INFORMATION ProcessInformation;
+	LONGLONG StartTime;
+	LONGLONG EndTime;
+	LONGLONG Frequency;
+	ULONG Microseconds;
+	ULONG Index;
+
+	RtlInitConstantUnicodeString(&ValueName, L"LogSeverityThreshold");
+	RtlInitConstantUnicodeString(&ImagePathName, STARTUP_TEST_EXE_NAME);
+
+	Status = NtSetValueKey(
+		VxKexKeyHandle,
+		&ValueName,
+		0,
+		REG_DWORD,
+		&Threshold,
+		sizeof(Threshold));
+
+	if (!NT_SUCCESS(Status)) {
+		DbgPrint("Failed to set log severity threshold. NTSTATUS error code: %ws\r\n",
+			KexRtlNtStatusToString(Status));
+		return Status;
+	}
+
+	Status = RtlCreateProcessParameters(
+		&ProcessParameters,
+		&ImagePathName,
+		NULL,
+		NULL,
+		&ImagePathName,
+		NULL,
+		NULL,
+		NULL,
+		NULL,
+		NULL);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	NtQueryPerformanceCounter(&StartTime, &Frequency);
+
+	for (Index = 0; Index < STARTUP_TEST_ITERATIONS; ++Index) {
+		Status = RtlCreateUserProcess(
+			&ImagePathName,
+			OBJ_CASE_INSENSITIVE,
+			ProcessParameters,
+			NULL,
+			NULL,
+			NULL,
+			FALSE,
+			NULL,
+			NULL,
+			&ProcessInformation);
+
+		if (!NT_SUCCESS(Status)) {
+			DbgPrint("Failed to create process #%lu. NTSTATUS error code: %ws\r\n",
+				Index, KexRtlNtStatusToString(Status));
+			break;
+		}
+
+		NtResumeThread(ProcessInformation.Thread, NULL);
+		NtWaitForSingleObject(ProcessInformation.Process, FALSE, NULL);
+		NtClose(ProcessInformation.Thread);
+		NtClose(ProcessInformation.Process);
+	}
+
+	NtQueryPerformanceCounter(&EndTime, NULL);
+	RtlDestroyProcessParameters(ProcessParameters);
+
+	if (Index == 0) {
+		return Status;
+	}
+
+	Microseconds = (ULONG) (((EndTime - StartTime) * 1000000) / (Frequency * Index));
+
+	DbgPrint("Process startup with threshold %ws: %lu us average over %lu runs\r\n",
+		VxlSeverityToText_ENG(Threshold, FALSE),
+		Microseconds,
+		Index);
+
+	return Status;
+}
+
+//
+// Benchmark process startup at every log severity threshold, and then put
+// the user's original setting back.
+//
+NTSTATUS BenchmarkProcessStartupAllThresholds(
+	VOID)
+{
+	NTSTATUS Status;
+	HANDLE CurrentUserKeyHandle;
+	HANDLE KeyHandle;
+	UNICODE_STRING KeyName;
+	UNICODE_STRING ValueName;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	BYTE OriginalValueBuffer[sizeof(KEY_VALUE_PARTIAL_INFORMATION) + sizeof(ULONG)];
+	PKEY_VALUE_PARTIAL_INFORMATION OriginalValue;
+	ULONG ResultLength;
+	NTSTATUS OriginalValueStatus;
+	VXLSEVERITY Threshold;
+
+	Status = RtlOpenCurrentUser(KEY_ENUMERATE_SUB_KEYS, &CurrentUserKeyHandle);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	RtlInitConstantUnicodeString(&KeyName, L"Software\\VXsoft\\VxKex");
+	RtlInitConstantUnicodeString(&ValueName, L"LogSeverityThreshold");
+
+	InitializeObjectAttributes(
+		&ObjectAttributes,
+		&KeyName,
+		OBJ_CASE_INSENSITIVE,
+		CurrentUserKeyHandle,
+		NULL);
+
+	Status = NtOpenKey(
+		&KeyHandle,
+		KEY_READ | KEY_WRITE | KEY_WOW64_64KEY,
+		&ObjectAttributes);
+
+	SafeClose(CurrentUserKeyHandle);
+
+	if (!NT_SUCCESS(Status)) {
+		DbgPrint("Failed to open VxKex HKCU key. NTSTATUS error code: %ws\r\n",
+			KexRtlNtStatusToString(Status));
+		return Status;
+	}
+
+	OriginalValue = (PKEY_VALUE_PARTIAL_INFORMATION) OriginalValueBuffer;
+
+	OriginalValueStatus = NtQueryValueKey(
+		KeyHandle,
+		&ValueName,
+		KeyValuePartialInformation,
+		OriginalValue,
+		sizeof(OriginalValueBuffer),
+		&ResultLength);
+
+	for (Threshold = LogSeverityCritical; Threshold < LogSeverityMaximumValue; ++Threshold) {
+		BenchmarkProcessStartup(KeyHandle, Threshold);
+	}
+
+	if (NT_SUCCESS(OriginalValueStatus)) {
+		NtSetValueKey(
+			KeyHandle,
+			&ValueName,
+			0,
+			OriginalValue->Type,
+			OriginalValue->Data,
+			OriginalValue->DataLength);
+	} else {
+		NtDeleteValueKey(KeyHandle, &ValueName);
+	}
+
+	SafeClose(KeyHandle);
+	return STATUS_SUCCESS;
+}
+
 NTSTATUS NTAPI EntryPoint(
 	IN	PVOID	Parameter)
 {
@@ -63,7 +341,7 @@ NTSTATUS NTAPI EntryPoint(
 	UNICODE_STRING SourceApplication;
 	UNICODE_STRING LogFileName;
 	OBJECT_ATTRIBUTES ObjectAttributes;
-	HANDLE ThreadHandles[6];
+	HANDLE ThreadHandles[NUMBER_OF_THREADS];
 	ULONG Index;
 
 	RtlInitConstantUnicodeString(&SourceApplication, L"VxKex");
@@ -123,7 +401,7 @@ NTSTATUS NTAPI EntryPoint(
 		}
 	}
 
-	for (Index = 0; Index < 6; ++Index) {
+	for (Index = 0; Index < NUMBER_OF_THREADS; ++Index) {
 		Status = RtlCreateUserThread(
 			NtCurrentProcess(),
 			NULL,
@@ -158,6 +436,25 @@ NTSTATUS NTAPI EntryPoint(
 
 	Status = VxlCloseLog(&LogHandle);
 
+	//
+	// Compare throughput of the different write modes.
+	//
+
+	BenchmarkThroughput(BENCHMARK_SYNC_LOG_FILE_NAME, 0);
+	BenchmarkThroughput(BENCHMARK_ASYNC_LOG_FILE_NAME, VXL_OPEN_ASYNCHRONOUS_WRITE);
+	BenchmarkThroughput(BENCHMARK_MAPPED_LOG_FILE_NAME, VXL_OPEN_MAPPED_WRITE);
+	BenchmarkThroughput(BENCHMARK_ASYNC_MAPPED_LOG_FILE_NAME, VXL_OPEN_ASYNCHRONOUS_WRITE | VXL_OPEN_MAPPED_WRITE);
+	BenchmarkThroughput(BENCHMARK_DEFERRED_LOG_FILE_NAME,
+		VXL_OPEN_ASYNCHRONOUS_WRITE | VXL_OPEN_MAPPED_WRITE | VXL_OPEN_DEFERRED_FORMATTING);
+	BenchmarkThroughput(BENCHMARK_COMPRESSED_LOG_FILE_NAME,
+		VXL_OPEN_ASYNCHRONOUS_WRITE | VXL_OPEN_MAPPED_WRITE | VXL_OPEN_DEFERRED_FORMATTING | VXL_OPEN_COMPRESSED);
+
+	//
+	// See how much the log severity threshold saves at process startup.
+	//
+
+	BenchmarkProcessStartupAllThresholds();
+
 	// no need to bother closing thread handles
 	LdrShutdownProcess();
 	return NtTerminateProcess(NtCurrentProcess(), Status);
@@ -0,0 +1,384 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     fuzz.c
+//
+// Abstract:
+//
+//     Fuzz target for the import rewrite engine (KexDll\rwengine.c).
+//
+//     An input which starts with "MZ" is an image file, which is laid out
+//     the way the loader maps it and rewritten. Anything else fills in the
+//     import directory and the DLL names of a synthetic image (see
+//     InitializeTestImage):
+//
+//       byte 0       TEST_IMAGE_* flags in the low 4 bits, and bit 4 for
+//                    KEX_IMPORT_REWRITE_KERNEL32
+//       bytes 1-2    offset of the import directory in .rdata
+//       byte 3       how much to cut off the end of the image, in units of
+//                    32 bytes
+//       the rest     copied to the start of .rdata (and on into .data)
+//
+//     Either way, the image is allocated at exactly its size so that the
+//     address sanitizer catches reads past the end, and any write outside
+//     of a DLL name or the bound import data directory entry aborts.
+//
+//     Build with "make libfuzzer" (which needs clang) to run it under
+//     libFuzzer. "make fuzz" builds it with a small driver of its own, which
+//     replays the files given on the command line, then mutates them and
+//     generates synthetic images for a number of rounds.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                18-Oct-2026  Use hosttest.h.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "rwtest.h"
+
+#define FUZZ_HEADER_SIZE 4
+
+#ifdef KEX_FUZZ_STANDALONE
+STATIC VOID SaveCrashingInput(
+	VOID);
+#else
+#  define SaveCrashingInput()
+#endif
+
+STATIC VOID FuzzImage(
+	IN	PCSTR	Name,
+	IN	PCBYTE	ImageData,
+	IN	ULONG	ImageSize,
+	IN	ULONG	Flags)
+{
+	PBYTE Image;
+	KEX_IMPORT_REWRITE Rewrite;
+	ULONG Problems;
+	ULONG OutOfBoundsWrites;
+
+	Image = (PBYTE) malloc(ImageSize);
+
+	if (!Image) {
+		return;
+	}
+
+	RtlCopyMemory(Image, ImageData, ImageSize);
+	RewriteTestImage(Name, Image, ImageSize, Flags, &Rewrite, &Problems, &OutOfBoundsWrites);
+
+	if (Problems != 0) {
+		// libFuzzer saves the input itself.
+		SaveCrashingInput();
+		fflush(stdout);
+		abort();
+	}
+
+	free(Image);
+}
+
+int LLVMFuzzerTestOneInput(
+	PCBYTE	Data,
+	SIZE_T	Size)
+{
+	if (Size >= 2 && Data[0] == 'M' && Data[1] == 'Z') {
+		ULONG ImageSize;
+		PBYTE Image;
+
+		ImageSize = GetMappedImageSize(Data, Size);
+
+		if (ImageSize == 0) {
+			return 0;
+		}
+
+		Image = (PBYTE) malloc(ImageSize);
+
+		if (!Image) {
+			return 0;
+		}
+
+		MapImage(Data, Size, Image, ImageSize);
+		FuzzImage("image", Image, ImageSize, 0);
+		FuzzImage("image (kernel32)", Image, ImageSize, KEX_IMPORT_REWRITE_KERNEL32);
+		free(Image);
+	} else if (Size >= FUZZ_HEADER_SIZE) {
+		STATIC BYTE Image[TEST_IMAGE_SIZE];
+		ULONG ImportDirectoryOffset;
+		ULONG ImageSize;
+		ULONG Flags;
+
+		InitializeTestImage(Image, Data[0] & 0x0F);
+
+		ImportDirectoryOffset = (Data[1] | (Data[2] << 8)) % (TEST_IMAGE_DATA_RVA - TEST_IMAGE_RDATA_RVA);
+		GetTestImageDataDirectory(Image, IMAGE_DIRECTORY_ENTRY_IMPORT)->VirtualAddress =
+			TEST_IMAGE_RDATA_RVA + ImportDirectoryOffset;
+
+		ImageSize = TEST_IMAGE_SIZE - Data[3] * 32;
+		Flags = (Data[0] & 0x10) ? KEX_IMPORT_REWRITE_KERNEL32 : 0;
+
+		RtlCopyMemory(
+			Image + TEST_IMAGE_RDATA_RVA,
+			Data + FUZZ_HEADER_SIZE,
+			min(Size - FUZZ_HEADER_SIZE, TEST_IMAGE_SIZE - TEST_IMAGE_RDATA_RVA));
+
+		FuzzImage("synthetic image", Image, ImageSize, Flags);
+	}
+
+	return 0;
+}
+
+#ifdef KEX_FUZZ_STANDALONE
+
+//
+// The driver. Synthetic images are generated with real DLL names in them,
+// which random bytes would almost never produce.
+//
+
+#define DEFAULT_ROUNDS 100000
+#define SYNTHETIC_INPUT_SIZE (FUZZ_HEADER_SIZE + TEST_IMAGE_SIZE - TEST_IMAGE_RDATA_RVA)
+#define NAME_SLOT_OFFSET 0x400
+#define NAME_SLOT_SIZE 0x40
+
+STATIC PCSTR DllNames[] = {
+	"kernel32.dll",
+	"KERNEL32.DLL",
+	"ntdll.dll",
+	"user32",
+	"foo.dll",
+	"api-ms-win-core-heap-l1-2-0.dll",
+	"api-ms-win-core-synch-l1-2-0.dll",
+	"ext-ms-win-gdi-dc-create-l1-1-0.dll",
+	"api-",
+	".dll",
+	"",
+};
+
+#define CRASHING_INPUT_FILE_NAME "rwenginefuzz-crash"
+
+typedef struct _SEED {
+	PBYTE	Data;
+	SIZE_T	Size;
+} TYPEDEF_TYPE_NAME(SEED);
+
+STATIC PCBYTE CurrentInput;
+STATIC SIZE_T CurrentInputSize;
+
+STATIC VOID GenerateSyntheticInput(
+	OUT	PBYTE	Input)
+{
+	PBYTE Body;
+	ULONG ImportDirectoryOffset;
+	ULONG NumberOfDescriptors;
+	ULONG Index;
+
+	RtlZeroMemory(Input, SYNTHETIC_INPUT_SIZE);
+	Body = Input + FUZZ_HEADER_SIZE;
+
+	Input[0] = (BYTE) (Random() & 0x1F);
+	ImportDirectoryOffset = (Random() & 3) ? 0 : Random() % (TEST_IMAGE_DATA_RVA - TEST_IMAGE_RDATA_RVA);
+	Input[1] = (BYTE) ImportDirectoryOffset;
+	Input[2] = (BYTE) (ImportDirectoryOffset >> 8);
+	Input[3] = (Random() & 7) ? 0 : (BYTE) Random();
+
+	//
+	// Put the names in slots after the import directory (unless the import
+	// directory was put somewhere else), each one sometimes cut short or
+	// with its null terminator missing.
+	//
+
+	for (Index = 0; Index < 16; ++Index) {
+		PSTR Slot;
+		PCSTR DllName;
+		ULONG Cch;
+
+		Slot = (PSTR) Body + NAME_SLOT_OFFSET + Index * NAME_SLOT_SIZE;
+		DllName = DllNames[Random() % ARRAYSIZE(DllNames)];
+		Cch = (ULONG) strlen(DllName);
+		RtlCopyMemory(Slot, DllName, Cch);
+
+		if ((Random() & 7) == 0) {
+			RtlFillMemory(Slot + (Cch ? Random() % Cch : 0), NAME_SLOT_SIZE / 2, 'x');
+		}
+	}
+
+	//
+	// A descriptor points at one of the slots, or anywhere near the end of
+	// the image, or anywhere at all.
+	//
+
+	NumberOfDescriptors = Random() % 12;
+
+	for (Index = 0; Index < NumberOfDescriptors; ++Index) {
+		ULONG Offset;
+		ULONG NameRva;
+
+		Offset = ImportDirectoryOffset + Index * sizeof(IMAGE_IMPORT_DESCRIPTOR) +
+			FIELD_OFFSET(IMAGE_IMPORT_DESCRIPTOR, Name);
+
+		if (Offset + sizeof(ULONG) > SYNTHETIC_INPUT_SIZE - FUZZ_HEADER_SIZE) {
+			break;
+		}
+
+		switch (Random() % 8) {
+		case 0:
+			NameRva = TEST_IMAGE_SIZE - (Random() % 64);
+			break;
+		case 1:
+			NameRva = Random();
+			break;
+		default:
+			NameRva = TEST_IMAGE_RDATA_RVA + NAME_SLOT_OFFSET + (Random() % 16) * NAME_SLOT_SIZE;
+			break;
+		}
+
+		RtlCopyMemory(Body + Offset, &NameRva, sizeof(NameRva));
+	}
+}
+
+STATIC VOID SaveCrashingInput(
+	VOID)
+{
+	FILE *File;
+
+	File = fopen(CRASHING_INPUT_FILE_NAME, "wb");
+
+	if (File) {
+		fwrite(CurrentInput, 1, CurrentInputSize, File);
+		fclose(File);
+		printf("the input was saved to " CRASHING_INPUT_FILE_NAME "\n");
+	}
+}
+
+STATIC VOID RunInput(
+	IN	PCBYTE	Input,
+	IN	SIZE_T	InputSize)
+{
+	CurrentInput = Input;
+	CurrentInputSize = InputSize;
+	LLVMFuzzerTestOneInput(Input, InputSize);
+}
+
+STATIC BOOLEAN ReadSeed(
+	IN	PCSTR	FileName,
+	OUT	PSEED	Seed)
+{
+	FILE *File;
+	long FileSize;
+
+	File = fopen(FileName, "rb");
+
+	if (!File) {
+		return FALSE;
+	}
+
+	fseek(File, 0, SEEK_END);
+	FileSize = ftell(File);
+	fseek(File, 0, SEEK_SET);
+
+	Seed->Size = (SIZE_T) max(FileSize, 0);
+	Seed->Data = (PBYTE) malloc(Seed->Size + 1);
+
+	if (!Seed->Data || fread(Seed->Data, 1, Seed->Size, File) != Seed->Size) {
+		fclose(File);
+		free(Seed->Data);
+		return FALSE;
+	}
+
+	fclose(File);
+	return TRUE;
+}
+
+int main(
+	int		argc,
+	char	**argv)
+{
+	PSEED Seeds;
+	ULONG NumberOfSeeds;
+	ULONG NumberOfRounds;
+	PBYTE Input;
+	SIZE_T MaximumSeedSize;
+	ULONG Round;
+	int Index;
+
+	Seeds = (PSEED) calloc(argc, sizeof(SEED));
+	NumberOfSeeds = 0;
+	NumberOfRounds = DEFAULT_ROUNDS;
+	MaximumSeedSize = SYNTHETIC_INPUT_SIZE;
+
+	for (Index = 1; Index < argc; ++Index) {
+		if (!strcmp(argv[Index], "-n") && Index + 1 < argc) {
+			NumberOfRounds = (ULONG) strtoul(argv[++Index], NULL, 0);
+			continue;
+		}
+
+		unless (ReadSeed(argv[Index], &Seeds[NumberOfSeeds])) {
+			printf("%s: can't read\n", argv[Index]);
+			return 1;
+		}
+
+		// Replay it as it is first.
+		RunInput(Seeds[NumberOfSeeds].Data, Seeds[NumberOfSeeds].Size);
+		MaximumSeedSize = max(MaximumSeedSize, Seeds[NumberOfSeeds].Size);
+		++NumberOfSeeds;
+	}
+
+	Input = (PBYTE) malloc(MaximumSeedSize);
+
+	if (!Input) {
+		return 1;
+	}
+
+	for (Round = 0; Round < NumberOfRounds; ++Round) {
+		SIZE_T InputSize;
+
+		if (NumberOfSeeds != 0 && (Round & 1)) {
+			PCSEED Seed;
+			ULONG NumberOfMutations;
+			ULONG Mutation;
+
+			//
+			// Change a few bytes of a seed, mostly in the headers, where
+			// the interesting fields are.
+			//
+
+			Seed = &Seeds[Random() % NumberOfSeeds];
+			InputSize = Seed->Size;
+			RtlCopyMemory(Input, Seed->Data, InputSize);
+
+			if (InputSize == 0) {
+				continue;
+			}
+
+			NumberOfMutations = 1 + Random() % 8;
+
+			for (Mutation = 0; Mutation < NumberOfMutations; ++Mutation) {
+				SIZE_T Offset;
+
+				if (Random() & 1) {
+					Offset = Random() % min(InputSize, 0x400);
+				} else {
+					Offset = Random() % InputSize;
+				}
+
+				Input[Offset] = (BYTE) Random();
+			}
+		} else {
+			GenerateSyntheticInput(Input);
+			InputSize = SYNTHETIC_INPUT_SIZE;
+		}
+
+		RunInput(Input, InputSize);
+	}
+
+	printf("%lu seeds replayed, %lu rounds without problems\n",
+		   (unsigned long) NumberOfSeeds,
+		   (unsigned long) NumberOfRounds);
+
+	return 0;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,540 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     image.c
+//
+// Abstract:
+//
+//     Synthetic images, and checks that a rewrite only changed what it was
+//     allowed to, for the import rewrite engine test and fuzz target.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "rwtest.h"
+
+#define ROUND_UP(Value, Alignment) (((Value) + (Alignment) - 1) & ~((ULONGLONG) (Alignment) - 1))
+
+// Don't flood the output with one line per byte.
+#define MAXIMUM_REPORTED_BYTES 8
+
+// Nothing real comes close, and it stops the fuzzer asking for gigabytes.
+#define MAXIMUM_MAPPED_IMAGE_SIZE (16 * 1024 * 1024)
+
+VOID InitializeTestImage(
+	OUT	PBYTE	Image,
+	IN	ULONG	Flags)
+{
+	PIMAGE_DOS_HEADER DosHeader;
+	PIMAGE_NT_HEADERS32 NtHeaders32;
+	PIMAGE_NT_HEADERS64 NtHeaders64;
+	PIMAGE_SECTION_HEADER SectionHeaders;
+	ULONG SectionAlignment;
+
+	RtlZeroMemory(Image, TEST_IMAGE_SIZE);
+
+	DosHeader = (PIMAGE_DOS_HEADER) Image;
+	DosHeader->e_magic = IMAGE_DOS_SIGNATURE;
+	DosHeader->e_lfanew = 0x80;
+
+	NtHeaders32 = (PIMAGE_NT_HEADERS32) (Image + DosHeader->e_lfanew);
+	NtHeaders64 = (PIMAGE_NT_HEADERS64) NtHeaders32;
+	NtHeaders32->Signature = IMAGE_NT_SIGNATURE;
+	NtHeaders32->FileHeader.NumberOfSections = 3;
+
+	SectionAlignment = (Flags & TEST_IMAGE_SMALL_ALIGNMENT) ? 0x200 : PAGE_SIZE;
+
+	if (Flags & TEST_IMAGE_32BIT) {
+		NtHeaders32->FileHeader.Machine = IMAGE_FILE_MACHINE_I386;
+		NtHeaders32->FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER32);
+		NtHeaders32->OptionalHeader.Magic = IMAGE_NT_OPTIONAL_HDR32_MAGIC;
+		NtHeaders32->OptionalHeader.SectionAlignment = SectionAlignment;
+		NtHeaders32->OptionalHeader.FileAlignment = 0x200;
+		NtHeaders32->OptionalHeader.SizeOfImage = TEST_IMAGE_SIZE;
+		NtHeaders32->OptionalHeader.SizeOfHeaders = 0x400;
+		NtHeaders32->OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+		SectionHeaders = (PIMAGE_SECTION_HEADER) (NtHeaders32 + 1);
+	} else {
+		NtHeaders64->FileHeader.Machine = IMAGE_FILE_MACHINE_AMD64;
+		NtHeaders64->FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER64);
+		NtHeaders64->OptionalHeader.Magic = IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+		NtHeaders64->OptionalHeader.SectionAlignment = SectionAlignment;
+		NtHeaders64->OptionalHeader.FileAlignment = 0x200;
+		NtHeaders64->OptionalHeader.SizeOfImage = TEST_IMAGE_SIZE;
+		NtHeaders64->OptionalHeader.SizeOfHeaders = 0x400;
+		NtHeaders64->OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+		SectionHeaders = (PIMAGE_SECTION_HEADER) (NtHeaders64 + 1);
+	}
+
+	RtlCopyMemory(SectionHeaders[0].Name, ".text", 5);
+	SectionHeaders[0].VirtualAddress = TEST_IMAGE_TEXT_RVA;
+	SectionHeaders[0].Misc.VirtualSize = TEST_IMAGE_RDATA_RVA - TEST_IMAGE_TEXT_RVA;
+	SectionHeaders[0].Characteristics = IMAGE_SCN_MEM_READ;
+
+	unless (Flags & TEST_IMAGE_READONLY_TEXT) {
+		SectionHeaders[0].Characteristics |= IMAGE_SCN_MEM_EXECUTE;
+	}
+
+	RtlCopyMemory(SectionHeaders[1].Name, ".rdata", 6);
+	SectionHeaders[1].VirtualAddress = TEST_IMAGE_RDATA_RVA;
+	SectionHeaders[1].Misc.VirtualSize = TEST_IMAGE_DATA_RVA - TEST_IMAGE_RDATA_RVA;
+	SectionHeaders[1].Characteristics = IMAGE_SCN_MEM_READ;
+
+	RtlCopyMemory(SectionHeaders[2].Name, ".data", 5);
+	SectionHeaders[2].VirtualAddress = TEST_IMAGE_DATA_RVA;
+	SectionHeaders[2].Misc.VirtualSize = TEST_IMAGE_SIZE - TEST_IMAGE_DATA_RVA;
+	SectionHeaders[2].Characteristics = IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+
+	GetTestImageDataDirectory(Image, IMAGE_DIRECTORY_ENTRY_IMPORT)->VirtualAddress = TEST_IMAGE_RDATA_RVA;
+
+	if (Flags & TEST_IMAGE_BOUND_IMPORTS) {
+		PIMAGE_DATA_DIRECTORY BoundImportDirectory;
+
+		// The contents don't matter, since the engine only clears the entry.
+		BoundImportDirectory = GetTestImageDataDirectory(Image, IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT);
+		BoundImportDirectory->VirtualAddress = 0x300;
+		BoundImportDirectory->Size = 0x20;
+	}
+}
+
+PIMAGE_DATA_DIRECTORY GetTestImageDataDirectory(
+	IN	PBYTE	Image,
+	IN	ULONG	Index)
+{
+	PIMAGE_NT_HEADERS32 NtHeaders32;
+
+	NtHeaders32 = (PIMAGE_NT_HEADERS32) (Image + ((PIMAGE_DOS_HEADER) Image)->e_lfanew);
+
+	if (NtHeaders32->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
+		return &((PIMAGE_NT_HEADERS64) NtHeaders32)->OptionalHeader.DataDirectory[Index];
+	} else {
+		return &NtHeaders32->OptionalHeader.DataDirectory[Index];
+	}
+}
+
+ULONG GetMappedImageSize(
+	IN	PCBYTE	File,
+	IN	SIZE_T	FileSize)
+{
+	CONST IMAGE_NT_HEADERS32 *NtHeaders;
+	ULONG NtHeadersOffset;
+
+	if (FileSize < sizeof(IMAGE_DOS_HEADER) ||
+		((CONST IMAGE_DOS_HEADER *) File)->e_magic != IMAGE_DOS_SIGNATURE) {
+
+		return 0;
+	}
+
+	NtHeadersOffset = (ULONG) ((CONST IMAGE_DOS_HEADER *) File)->e_lfanew;
+
+	if (NtHeadersOffset > FileSize || FileSize - NtHeadersOffset < sizeof(IMAGE_NT_HEADERS32)) {
+		return 0;
+	}
+
+	NtHeaders = (CONST IMAGE_NT_HEADERS32 *) (File + NtHeadersOffset);
+
+	if (NtHeaders->Signature != IMAGE_NT_SIGNATURE ||
+		(NtHeaders->OptionalHeader.Magic != IMAGE_NT_OPTIONAL_HDR32_MAGIC &&
+		 NtHeaders->OptionalHeader.Magic != IMAGE_NT_OPTIONAL_HDR64_MAGIC)) {
+
+		return 0;
+	}
+
+	// The fields we need are at the same offsets in PE32 and PE32+.
+	if (NtHeaders->OptionalHeader.SizeOfImage == 0 ||
+		NtHeaders->OptionalHeader.SizeOfImage > MAXIMUM_MAPPED_IMAGE_SIZE) {
+
+		return 0;
+	}
+
+	return NtHeaders->OptionalHeader.SizeOfImage;
+}
+
+VOID MapImage(
+	IN	PCBYTE	File,
+	IN	SIZE_T	FileSize,
+	OUT	PBYTE	Image,
+	IN	ULONG	ImageSize)
+{
+	CONST IMAGE_NT_HEADERS32 *NtHeaders;
+	CONST IMAGE_SECTION_HEADER *SectionHeaders;
+	ULONG NtHeadersOffset;
+	ULONG SectionHeadersOffset;
+	ULONGLONG Size;
+	ULONG Index;
+
+	// GetMappedImageSize has checked the headers this uses.
+	NtHeadersOffset = (ULONG) ((CONST IMAGE_DOS_HEADER *) File)->e_lfanew;
+	NtHeaders = (CONST IMAGE_NT_HEADERS32 *) (File + NtHeadersOffset);
+
+	RtlZeroMemory(Image, ImageSize);
+
+	Size = min(NtHeaders->OptionalHeader.SizeOfHeaders, ImageSize);
+	Size = min(Size, FileSize);
+	RtlCopyMemory(Image, File, (SIZE_T) Size);
+
+	//
+	// Copy each section's raw data to its RVA. Anything which would be
+	// outside of the file or the image is left out, rather than rejecting
+	// the whole file - the engine is meant to cope with that.
+	//
+
+	SectionHeadersOffset = NtHeadersOffset + FIELD_OFFSET(IMAGE_NT_HEADERS32, OptionalHeader) +
+		NtHeaders->FileHeader.SizeOfOptionalHeader;
+
+	if (SectionHeadersOffset > FileSize) {
+		return;
+	}
+
+	SectionHeaders = (CONST IMAGE_SECTION_HEADER *) (File + SectionHeadersOffset);
+
+	for (Index = 0; Index < NtHeaders->FileHeader.NumberOfSections; ++Index) {
+		CONST IMAGE_SECTION_HEADER *SectionHeader;
+
+		if (SectionHeadersOffset + (Index + 1) * (ULONGLONG) sizeof(IMAGE_SECTION_HEADER) > FileSize) {
+			break;
+		}
+
+		SectionHeader = &SectionHeaders[Index];
+
+		Size = SectionHeader->SizeOfRawData;
+
+		if (SectionHeader->Misc.VirtualSize != 0) {
+			Size = min(Size, SectionHeader->Misc.VirtualSize);
+		}
+
+		if (SectionHeader->PointerToRawData >= FileSize || SectionHeader->VirtualAddress >= ImageSize) {
+			continue;
+		}
+
+		Size = min(Size, FileSize - SectionHeader->PointerToRawData);
+		Size = min(Size, ImageSize - SectionHeader->VirtualAddress);
+
+		RtlCopyMemory(
+			Image + SectionHeader->VirtualAddress,
+			File + SectionHeader->PointerToRawData,
+			(SIZE_T) Size);
+	}
+}
+
+NTSTATUS RewriteTestImage(
+	IN	PCSTR					Name,
+	IN OUT	PBYTE				Image,
+	IN	ULONG					ImageSize,
+	IN	ULONG					Flags,
+	OUT	PKEX_IMPORT_REWRITE		Rewrite,
+	OUT	PULONG					Problems,
+	OUT	PULONG					OutOfBoundsWrites)
+{
+	NTSTATUS Status;
+	PBYTE OriginalImage;
+
+	*Problems = 0;
+	*OutOfBoundsWrites = 0;
+
+	OriginalImage = (PBYTE) malloc(ImageSize);
+
+	if (!OriginalImage) {
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlCopyMemory(OriginalImage, Image, ImageSize);
+
+	Status = KexpInitializeImportRewrite(Image, ImageSize, Flags, Rewrite);
+
+	if (NT_SUCCESS(Status)) {
+		KexpPlanImportRewrite(Rewrite);
+		Status = KexpPrepareImportRewrite(Rewrite);
+	}
+
+	if (NT_SUCCESS(Status)) {
+		if (Rewrite->NumberOfWrites != 0) {
+			KexpApplyImportRewrite(Rewrite);
+		}
+
+		*Problems = VerifyImportRewrite(Name, OriginalImage, Image, ImageSize, Rewrite, OutOfBoundsWrites);
+	} else if (!RtlEqualMemory(OriginalImage, Image, ImageSize)) {
+		printf("%s: the image changed, even though the rewrite failed\n", Name);
+		*Problems = 1;
+	}
+
+	free(OriginalImage);
+	return Status;
+}
+
+ULONG GetImageProtection(
+	IN	PCBYTE	Image,
+	IN	ULONG	ImageSize,
+	IN	ULONG	Rva)
+{
+	CONST IMAGE_NT_HEADERS32 *NtHeaders;
+	CONST IMAGE_SECTION_HEADER *SectionHeaders;
+	ULONG SectionAlignment;
+	ULONG NtHeadersOffset;
+	ULONG SectionHeadersOffset;
+	ULONG Index;
+
+	if (Rva >= ROUND_UP(ImageSize, PAGE_SIZE) || ImageSize < sizeof(IMAGE_DOS_HEADER)) {
+		return 0;
+	}
+
+	NtHeadersOffset = (ULONG) ((CONST IMAGE_DOS_HEADER *) Image)->e_lfanew;
+
+	if (NtHeadersOffset > ImageSize || ImageSize - NtHeadersOffset < sizeof(IMAGE_NT_HEADERS32)) {
+		return 0;
+	}
+
+	NtHeaders = (CONST IMAGE_NT_HEADERS32 *) (Image + NtHeadersOffset);
+	SectionAlignment = NtHeaders->OptionalHeader.SectionAlignment;
+
+	if (SectionAlignment < PAGE_SIZE) {
+		// The whole image is mapped as one block.
+		return TEST_PROTECTION_MAPPED | TEST_PROTECTION_READ | TEST_PROTECTION_WRITE | TEST_PROTECTION_EXECUTE;
+	}
+
+	SectionHeadersOffset = NtHeadersOffset + FIELD_OFFSET(IMAGE_NT_HEADERS32, OptionalHeader) +
+		NtHeaders->FileHeader.SizeOfOptionalHeader;
+
+	if (SectionHeadersOffset > ImageSize ||
+		(ImageSize - SectionHeadersOffset) / sizeof(IMAGE_SECTION_HEADER) < NtHeaders->FileHeader.NumberOfSections) {
+
+		return 0;
+	}
+
+	SectionHeaders = (CONST IMAGE_SECTION_HEADER *) (Image + SectionHeadersOffset);
+
+	for (Index = 0; Index < NtHeaders->FileHeader.NumberOfSections; ++Index) {
+		ULONGLONG SectionSize;
+		ULONG Protection;
+
+		SectionSize = SectionHeaders[Index].Misc.VirtualSize;
+
+		if (SectionSize == 0) {
+			SectionSize = SectionHeaders[Index].SizeOfRawData;
+		}
+
+		SectionSize = ROUND_UP(SectionSize, SectionAlignment);
+
+		if (Rva < SectionHeaders[Index].VirtualAddress ||
+			Rva - SectionHeaders[Index].VirtualAddress >= SectionSize) {
+
+			continue;
+		}
+
+		Protection = TEST_PROTECTION_MAPPED;
+
+		if (SectionHeaders[Index].Characteristics & IMAGE_SCN_MEM_READ) {
+			Protection |= TEST_PROTECTION_READ;
+		}
+
+		if (SectionHeaders[Index].Characteristics & IMAGE_SCN_MEM_WRITE) {
+			Protection |= TEST_PROTECTION_WRITE;
+		}
+
+		if (SectionHeaders[Index].Characteristics & IMAGE_SCN_MEM_EXECUTE) {
+			Protection |= TEST_PROTECTION_EXECUTE;
+		}
+
+		return Protection;
+	}
+
+	if (Rva < ROUND_UP(NtHeaders->OptionalHeader.SizeOfHeaders, PAGE_SIZE)) {
+		return TEST_PROTECTION_MAPPED | TEST_PROTECTION_READ;
+	}
+
+	return 0;
+}
+
+ULONG VerifyImportRewrite(
+	IN	PCSTR					Name,
+	IN	PCBYTE					OriginalImage,
+	IN	PCBYTE					Image,
+	IN	ULONG					ImageSize,
+	IN	PCKEX_IMPORT_REWRITE	Rewrite,
+	OUT	PULONG					OutOfBoundsWrites)
+{
+	ULONG Problems;
+	PBYTE Allowed;
+	ULONG Index;
+	ULONG Offset;
+
+	Problems = 0;
+	*OutOfBoundsWrites = 0;
+
+	//
+	// Each window must be whole pages inside the image, with the same
+	// protection all the way through, and not overlap any other window.
+	//
+
+	for (Index = 0; Index < Rewrite->NumberOfWindows; ++Index) {
+		PCKEX_REWRITE_WINDOW Window;
+		ULONG OtherIndex;
+		ULONG Protection;
+
+		Window = &Rewrite->Windows[Index];
+
+		if (Window->Rva % PAGE_SIZE != 0 || Window->Size % PAGE_SIZE != 0 || Window->Size == 0 ||
+			Window->Rva + (ULONGLONG) Window->Size > ROUND_UP(ImageSize, PAGE_SIZE)) {
+
+			printf("%s: bad window %#lx+%#lx\n", Name,
+				   (unsigned long) Window->Rva, (unsigned long) Window->Size);
+
+			++Problems;
+			continue;
+		}
+
+		Protection = GetImageProtection(OriginalImage, ImageSize, Window->Rva);
+
+		for (Offset = PAGE_SIZE; Offset < Window->Size; Offset += PAGE_SIZE) {
+			if (GetImageProtection(OriginalImage, ImageSize, Window->Rva + Offset) != Protection) {
+				printf("%s: window %#lx+%#lx has pages with different protections\n", Name,
+					   (unsigned long) Window->Rva, (unsigned long) Window->Size);
+
+				++Problems;
+				break;
+			}
+		}
+
+		if (Protection == 0) {
+			printf("%s: window %#lx+%#lx isn't mapped\n", Name,
+				   (unsigned long) Window->Rva, (unsigned long) Window->Size);
+
+			++Problems;
+		}
+
+		for (OtherIndex = 0; OtherIndex < Index; ++OtherIndex) {
+			PCKEX_REWRITE_WINDOW OtherWindow;
+
+			OtherWindow = &Rewrite->Windows[OtherIndex];
+
+			if (Window->Rva < OtherWindow->Rva + OtherWindow->Size &&
+				OtherWindow->Rva < Window->Rva + Window->Size) {
+
+				printf("%s: windows %lu and %lu overlap\n", Name,
+					   (unsigned long) OtherIndex, (unsigned long) Index);
+
+				++Problems;
+			}
+		}
+	}
+
+	if (Rewrite->NumberOfRejectedWrites != 0) {
+		printf("%s: %lu writes were outside of the windows\n", Name,
+			   (unsigned long) Rewrite->NumberOfRejectedWrites);
+
+		++Problems;
+	}
+
+	if (Rewrite->NumberOfWrites == 0 && Rewrite->NumberOfWindows != 0) {
+		printf("%s: windows without anything to write\n", Name);
+		++Problems;
+	}
+
+	//
+	// Work out which bytes may change: the DLL names of the import
+	// descriptors (as they were before), and the bound import data
+	// directory entry.
+	//
+
+	Allowed = (PBYTE) calloc(ImageSize, 1);
+
+	if (!Allowed) {
+		printf("%s: out of memory\n", Name);
+		return Problems + 1;
+	}
+
+	if (Rewrite->ImportDescriptors) {
+		ULONG DescriptorsOffset;
+
+		DescriptorsOffset = (ULONG) ((PCBYTE) Rewrite->ImportDescriptors - Image);
+
+		for (Index = 0; Index < Rewrite->NumberOfImportDescriptors; ++Index) {
+			IMAGE_IMPORT_DESCRIPTOR Descriptor;
+
+			RtlCopyMemory(
+				&Descriptor,
+				OriginalImage + DescriptorsOffset + Index * sizeof(IMAGE_IMPORT_DESCRIPTOR),
+				sizeof(Descriptor));
+
+			for (Offset = Descriptor.Name; Offset < ImageSize; ++Offset) {
+				Allowed[Offset] = TRUE;
+
+				if (OriginalImage[Offset] == '\0') {
+					break;
+				}
+			}
+		}
+	}
+
+	if (Rewrite->BoundImportDirectory) {
+		Offset = (ULONG) ((PCBYTE) Rewrite->BoundImportDirectory - Image);
+		RtlFillMemory(Allowed + Offset, sizeof(IMAGE_DATA_DIRECTORY), TRUE);
+	}
+
+	for (Offset = 0; Offset < ImageSize; ++Offset) {
+		BOOLEAN InWindow;
+
+		if (Offset % PAGE_SIZE == 0 && ImageSize - Offset >= PAGE_SIZE &&
+			RtlEqualMemory(OriginalImage + Offset, Image + Offset, PAGE_SIZE)) {
+
+			// Most of the image doesn't change.
+			Offset += PAGE_SIZE - 1;
+			continue;
+		}
+
+		if (OriginalImage[Offset] == Image[Offset]) {
+			continue;
+		}
+
+		InWindow = FALSE;
+
+		for (Index = 0; Index < Rewrite->NumberOfWindows; ++Index) {
+			if (Offset >= Rewrite->Windows[Index].Rva &&
+				Offset - Rewrite->Windows[Index].Rva < Rewrite->Windows[Index].Size) {
+
+				InWindow = TRUE;
+				break;
+			}
+		}
+
+		if (!Allowed[Offset] || !InWindow) {
+			if (*OutOfBoundsWrites < MAXIMUM_REPORTED_BYTES) {
+				printf("%s: byte at %#lx changed (%s)\n", Name, (unsigned long) Offset,
+					   Allowed[Offset] ? "outside of the windows" : "not part of a DLL name");
+			}
+
+			++*OutOfBoundsWrites;
+		}
+	}
+
+	if (*OutOfBoundsWrites != 0) {
+		printf("%s: %lu bytes changed which shouldn't have\n", Name, (unsigned long) *OutOfBoundsWrites);
+		++Problems;
+	}
+
+	//
+	// The bound import directory must be gone if anything was rewritten.
+	//
+
+	if (Rewrite->BoundImportDirectory && Rewrite->NumberOfRewrittenNames != 0) {
+		IMAGE_DATA_DIRECTORY BoundImportDirectory;
+
+		RtlCopyMemory(&BoundImportDirectory, Rewrite->BoundImportDirectory, sizeof(BoundImportDirectory));
+
+		if (BoundImportDirectory.VirtualAddress != 0 || BoundImportDirectory.Size != 0) {
+			printf("%s: the bound import directory wasn't cleared\n", Name);
+			++Problems;
+		}
+	}
+
+	free(Allowed);
+	return Problems;
+}
\ No newline at end of file
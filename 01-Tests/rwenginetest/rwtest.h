@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     rwtest.h
+//
+// Abstract:
+//
+//     Declarations shared by the import rewrite engine test (test.c) and the
+//     fuzz target (fuzz.c).
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                18-Oct-2026  Use hosttest.h.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "hosttest.h"
+#include "rwengine.h"
+
+//
+// Synthetic images have the headers, an executable .text section, a
+// read-only .rdata section (which has the import directory at its start)
+// and a writable .data section, like most DLLs.
+//
+
+#define TEST_IMAGE_TEXT_RVA			0x1000
+#define TEST_IMAGE_RDATA_RVA		0x2000
+#define TEST_IMAGE_DATA_RVA			0x5000
+#define TEST_IMAGE_SIZE				0x6000
+
+#define TEST_IMAGE_32BIT			1	// PE32 instead of PE32+
+#define TEST_IMAGE_BOUND_IMPORTS	2	// has a bound import directory
+#define TEST_IMAGE_READONLY_TEXT	4	// .text isn't executable
+#define TEST_IMAGE_SMALL_ALIGNMENT	8	// section alignment less than a page
+
+VOID InitializeTestImage(
+	OUT	PBYTE	Image,
+	IN	ULONG	Flags);
+
+PIMAGE_DATA_DIRECTORY GetTestImageDataDirectory(
+	IN	PBYTE	Image,
+	IN	ULONG	Index);
+
+//
+// Lay out an image file (e.g. a DLL from the corpus) the way the loader
+// maps it. GetMappedImageSize returns 0 if the file isn't something which
+// can be mapped, otherwise the number of bytes MapImage needs.
+//
+
+ULONG GetMappedImageSize(
+	IN	PCBYTE	File,
+	IN	SIZE_T	FileSize);
+
+VOID MapImage(
+	IN	PCBYTE	File,
+	IN	SIZE_T	FileSize,
+	OUT	PBYTE	Image,
+	IN	ULONG	ImageSize);
+
+//
+// Page protection of an RVA in a mapped image, worked out the way the
+// memory manager does it (and separately from the engine, which has its
+// own idea of it). Returns 0 for addresses which aren't mapped. Mapped pages
+// always have TEST_PROTECTION_MAPPED, even in a section with no access.
+//
+
+#define TEST_PROTECTION_READ		1
+#define TEST_PROTECTION_WRITE		2
+#define TEST_PROTECTION_EXECUTE		4
+#define TEST_PROTECTION_MAPPED		8
+
+ULONG GetImageProtection(
+	IN	PCBYTE	Image,
+	IN	ULONG	ImageSize,
+	IN	ULONG	Rva);
+
+//
+// Compare an image before and after a rewrite, and check the windows the
+// engine asked for. Prints every problem prefixed with Name, and returns how
+// many there were. Writes outside of the DLL names and the bound import data
+// directory are counted in OutOfBoundsWrites.
+//
+
+ULONG VerifyImportRewrite(
+	IN	PCSTR					Name,
+	IN	PCBYTE					OriginalImage,
+	IN	PCBYTE					Image,
+	IN	ULONG					ImageSize,
+	IN	PCKEX_IMPORT_REWRITE	Rewrite,
+	OUT	PULONG					OutOfBoundsWrites);
+
+//
+// Rewrite the import directory of an image in memory the same way as
+// KexRewriteImageImportDirectory does (without the plan cache and page
+// protection changes), then check the result with VerifyImportRewrite.
+// Returns the status of whichever step failed. Problems is only counted if
+// the rewrite went ahead.
+//
+
+NTSTATUS RewriteTestImage(
+	IN	PCSTR					Name,
+	IN OUT	PBYTE				Image,
+	IN	ULONG					ImageSize,
+	IN	ULONG					Flags,
+	OUT	PKEX_IMPORT_REWRITE		Rewrite,
+	OUT	PULONG					Problems,
+	OUT	PULONG					OutOfBoundsWrites);
\ No newline at end of file
@@ -0,0 +1,1021 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     test.c
+//
+// Abstract:
+//
+//     Host test and benchmark for the import rewrite engine
+//     (KexDll\rwengine.c). Build and run it on any machine with a C compiler
+//     by typing "make check" in this directory.
+//
+//     Apart from the built-in checks, every file named on the command line
+//     (or found in a directory named on the command line) which is a PE
+//     image is laid out the way the loader maps it and rewritten the same
+//     way as KexRewriteImageImportDirectory does it, with the real page
+//     protections, so that a write outside of the windows the engine asked
+//     for crashes just like it would on Windows. With -b, each image is also
+//     timed.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                18-Oct-2026  Use hosttest.h.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "rwtest.h"
+#include "redirects.h"
+
+#include <time.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define NAMES_RVA (TEST_IMAGE_RDATA_RVA + 0x800)
+#define MAXIMUM_NAME_CCH 256
+#define BENCHMARK_ITERATIONS 20000
+
+STATIC BOOLEAN Benchmark;
+STATIC BOOLEAN ProtectPages;
+
+//
+// Look up an ASCII DLL name with KexpLookupDllRewriteEntry, and return the
+// rewritten name as ASCII (or NULL if there is no entry).
+//
+
+STATIC PCSTR LookUp(
+	IN	PCSTR	DllName)
+{
+	STATIC CHAR Result[MAXIMUM_NAME_CCH];
+	WCHAR Buffer[MAXIMUM_NAME_CCH];
+	UNICODE_STRING UnicodeDllName;
+	UNICODE_STRING RewrittenDllName;
+	NTSTATUS Status;
+	ULONG Index;
+
+	for (Index = 0; DllName[Index] != '\0'; ++Index) {
+		Buffer[Index] = (UCHAR) DllName[Index];
+	}
+
+	UnicodeDllName.Buffer = Buffer;
+	UnicodeDllName.Length = (USHORT) (Index * sizeof(WCHAR));
+	UnicodeDllName.MaximumLength = sizeof(Buffer);
+
+	Status = KexpLookupDllRewriteEntry(&UnicodeDllName, &RewrittenDllName);
+
+	if (Status == STATUS_STRING_MAPPER_ENTRY_NOT_FOUND) {
+		return NULL;
+	}
+
+	CHECK (NT_SUCCESS(Status));
+
+	for (Index = 0; Index < KexRtlUnicodeStringCch(&RewrittenDllName); ++Index) {
+		Result[Index] = (CHAR) RewrittenDllName.Buffer[Index];
+	}
+
+	Result[Index] = '\0';
+	return Result;
+}
+
+STATIC BOOLEAN LookUpIs(
+	IN	PCSTR	DllName,
+	IN	PCSTR	Expected)
+{
+	PCSTR RewrittenDllName;
+
+	RewrittenDllName = LookUp(DllName);
+
+	if (!RewrittenDllName || !Expected) {
+		return RewrittenDllName == Expected;
+	}
+
+	return !strcmp(RewrittenDllName, Expected);
+}
+
+STATIC VOID ToAnsi(
+	IN	PCUNICODE_STRING	String,
+	OUT	PSTR				Buffer)
+{
+	ULONG Index;
+
+	for (Index = 0; Index < KexRtlUnicodeStringCch(String); ++Index) {
+		Buffer[Index] = (CHAR) String->Buffer[Index];
+	}
+
+	Buffer[Index] = '\0';
+}
+
+//
+// Every entry of redirects.h must be found, with and without a .dll
+// extension, in any case, and with an API set version suffix if it is an
+// API set.
+//
+
+STATIC VOID TestLookups(
+	VOID)
+{
+	ULONG Index;
+
+	for (Index = 0; Index < ARRAYSIZE(DllRedirects); ++Index) {
+		CHAR DllName[MAXIMUM_NAME_CCH];
+		CHAR RewrittenDllName[MAXIMUM_NAME_CCH];
+		CHAR Name[MAXIMUM_NAME_CCH + 16];
+		ULONG CharacterIndex;
+
+		ToAnsi(&DllRedirects[Index][0], DllName);
+		ToAnsi(&DllRedirects[Index][1], RewrittenDllName);
+
+		if (!strncmp(DllName, "api-", 4) || !strncmp(DllName, "ext-", 4)) {
+			sprintf(Name, "%s-l1-1-0", DllName);
+			CHECK (LookUpIs(Name, RewrittenDllName));
+
+			sprintf(Name, "%s-l2-3-4.dll", DllName);
+			CHECK (LookUpIs(Name, RewrittenDllName));
+		} else {
+			CHECK (LookUpIs(DllName, RewrittenDllName));
+
+			sprintf(Name, "%s.dll", DllName);
+			CHECK (LookUpIs(Name, RewrittenDllName));
+		}
+
+		sprintf(Name, "%s%s", DllName, strncmp(DllName, "api-", 4) && strncmp(DllName, "ext-", 4) ? ".DLL" : "-L1-1-0.DLL");
+
+		for (CharacterIndex = 0; Name[CharacterIndex] != '\0'; ++CharacterIndex) {
+			Name[CharacterIndex] = (CHAR) ToUpper(Name[CharacterIndex]);
+		}
+
+		CHECK (LookUpIs(Name, RewrittenDllName));
+
+		// The static lookup takes the name without anything stripped.
+		CHECK (KexpLookupStaticDllRewriteEntry(&DllRedirects[Index][0]) != NULL);
+	}
+
+	CHECK (LookUpIs("", NULL));
+	CHECK (LookUpIs(".dll", NULL));
+	CHECK (LookUpIs("api-", NULL));
+	CHECK (LookUpIs("foo.dll", NULL));
+	CHECK (LookUpIs("kernel33.dll", NULL));
+	CHECK (LookUpIs("kernel32.dll.dll", NULL));
+	CHECK (LookUpIs("xkernel32.dll", NULL));
+
+	// Too short to have a version suffix, so nothing is stripped.
+	CHECK (LookUpIs("api-ms-wi.dll", NULL));
+
+	// The suffix is always stripped from API sets, even if it isn't one.
+	CHECK (LookUpIs("api-ms-win-core-heap", NULL));
+	CHECK (LookUpIs("api-ms-win-core-heapxxxxxxx.dll", "kxbase"));
+}
+
+//
+// Synthetic images.
+//
+
+STATIC VOID AddImport(
+	IN	PBYTE	Image,
+	IN	ULONG	DescriptorIndex,
+	IN	ULONG	NameRva,
+	IN	PCSTR	DllName)
+{
+	PIMAGE_IMPORT_DESCRIPTOR ImportDescriptors;
+
+	ImportDescriptors = (PIMAGE_IMPORT_DESCRIPTOR) (Image + TEST_IMAGE_RDATA_RVA);
+	ImportDescriptors[DescriptorIndex].Name = NameRva;
+
+	if (DllName) {
+		strcpy((PSTR) Image + NameRva, DllName);
+	}
+}
+
+STATIC BOOLEAN NameIs(
+	IN	PCBYTE	Image,
+	IN	ULONG	NameRva,
+	IN	PCSTR	Expected)
+{
+	return !strcmp((PCSTR) Image + NameRva, Expected);
+}
+
+//
+// Rewrite a synthetic image. Any problem found by VerifyImportRewrite is a
+// failure. Returns the status of the rewrite.
+//
+
+STATIC NTSTATUS Rewrite(
+	IN	PCSTR					Name,
+	IN	PBYTE					Image,
+	IN	ULONG					ImageSize,
+	IN	ULONG					Flags,
+	OUT	PKEX_IMPORT_REWRITE		Rewrite)
+{
+	NTSTATUS Status;
+	ULONG Problems;
+	ULONG OutOfBoundsWrites;
+
+	Status = RewriteTestImage(Name, Image, ImageSize, Flags, Rewrite, &Problems, &OutOfBoundsWrites);
+	CHECK (Problems == 0);
+	return Status;
+}
+
+STATIC VOID TestBasic(
+	IN	ULONG	ImageFlags)
+{
+	STATIC BYTE Image[TEST_IMAGE_SIZE];
+	KEX_IMPORT_REWRITE Result;
+
+	InitializeTestImage(Image, ImageFlags);
+	AddImport(Image, 0, NAMES_RVA + 0x00, "kernel32.dll");
+	AddImport(Image, 1, NAMES_RVA + 0x20, "foo.dll");
+	AddImport(Image, 2, NAMES_RVA + 0x40, "USER32.DLL");
+	AddImport(Image, 3, NAMES_RVA + 0x60, "api-ms-win-core-heap-l1-2-0.dll");
+	AddImport(Image, 4, NAMES_RVA + 0xA0, "ntdll");
+
+	CHECK (Rewrite("basic", Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	CHECK (Result.NumberOfImportDescriptors == 5);
+	CHECK (Result.Plan.NumberOfRewrites == 4);
+	CHECK (!Result.Plan.Incomplete);
+	CHECK (Result.NumberOfRewrittenNames == 4);
+	CHECK (NameIs(Image, NAMES_RVA + 0x00, "kxbase"));
+	CHECK (NameIs(Image, NAMES_RVA + 0x20, "foo.dll"));
+	CHECK (NameIs(Image, NAMES_RVA + 0x40, "kxuser"));
+	CHECK (NameIs(Image, NAMES_RVA + 0x60, "kxbase"));
+	CHECK (NameIs(Image, NAMES_RVA + 0xA0, "kxnt"));
+
+	// All of the names are in one page of .rdata.
+	CHECK (Result.NumberOfWindows == 1);
+	CHECK (Result.Windows[0].Rva == TEST_IMAGE_RDATA_RVA && Result.Windows[0].Size == PAGE_SIZE);
+	CHECK (!Result.ClearBoundImportDirectory);
+
+	// Nothing happens the second time round.
+	CHECK (Rewrite("basic again", Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	CHECK (Result.NumberOfWrites == 0 && Result.NumberOfWindows == 0);
+}
+
+STATIC VOID TestBoundImports(
+	VOID)
+{
+	STATIC BYTE Image[TEST_IMAGE_SIZE];
+	KEX_IMPORT_REWRITE Result;
+
+	//
+	// With an executable .text section in between, the headers and .rdata
+	// need a window each.
+	//
+
+	InitializeTestImage(Image, TEST_IMAGE_BOUND_IMPORTS);
+	AddImport(Image, 0, NAMES_RVA, "kernel32.dll");
+
+	CHECK (Rewrite("bound", Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	CHECK (Result.ClearBoundImportDirectory);
+	CHECK (Result.NumberOfWindows == 2);
+	CHECK (GetTestImageDataDirectory(Image, IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT)->VirtualAddress == 0);
+
+	//
+	// When everything from the headers to .rdata is read-only, one window
+	// covers it all.
+	//
+
+	InitializeTestImage(Image, TEST_IMAGE_BOUND_IMPORTS | TEST_IMAGE_READONLY_TEXT);
+	AddImport(Image, 0, NAMES_RVA, "kernel32.dll");
+
+	CHECK (Rewrite("bound, read-only .text", Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	CHECK (Result.NumberOfWindows == 1);
+	CHECK (Result.Windows[0].Rva == 0 && Result.Windows[0].Size == TEST_IMAGE_RDATA_RVA + PAGE_SIZE);
+
+	//
+	// The bound import directory stays if nothing is rewritten.
+	//
+
+	InitializeTestImage(Image, TEST_IMAGE_BOUND_IMPORTS);
+	AddImport(Image, 0, NAMES_RVA, "foo.dll");
+
+	CHECK (Rewrite("bound, no rewrites", Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	CHECK (Result.NumberOfWindows == 0);
+	CHECK (GetTestImageDataDirectory(Image, IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT)->VirtualAddress != 0);
+}
+
+STATIC VOID TestKernel32(
+	VOID)
+{
+	STATIC BYTE Image[TEST_IMAGE_SIZE];
+	KEX_IMPORT_REWRITE Result;
+
+	InitializeTestImage(Image, 0);
+	AddImport(Image, 0, NAMES_RVA + 0x00, "api-ms-win-core-heap-l1-2-0.dll");
+	AddImport(Image, 1, NAMES_RVA + 0x40, "ntdll.dll");
+	AddImport(Image, 2, NAMES_RVA + 0x60, "user32.dll");
+
+	CHECK (Rewrite("kernel32", Image, sizeof(Image), KEX_IMPORT_REWRITE_KERNEL32, &Result) == STATUS_SUCCESS);
+	CHECK (!Result.PlanIsShareable);
+	CHECK (Result.NumberOfRewrittenNames == 1);
+	CHECK (NameIs(Image, NAMES_RVA + 0x00, "api-ms-win-core-heap-l1-2-0.dll"));
+	CHECK (NameIs(Image, NAMES_RVA + 0x40, "kxnt.dll"));
+	CHECK (NameIs(Image, NAMES_RVA + 0x60, "user32.dll"));
+}
+
+STATIC VOID TestLayouts(
+	VOID)
+{
+	STATIC BYTE Image[TEST_IMAGE_SIZE];
+	KEX_IMPORT_REWRITE Result;
+
+	//
+	// With a section alignment of less than a page, the whole image has
+	// one protection.
+	//
+
+	InitializeTestImage(Image, TEST_IMAGE_SMALL_ALIGNMENT | TEST_IMAGE_BOUND_IMPORTS);
+	AddImport(Image, 0, NAMES_RVA, "kernel32.dll");
+
+	CHECK (Rewrite("small alignment", Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	CHECK (Result.NumberOfRewrittenNames == 1);
+	CHECK (Result.NumberOfWindows == 1);
+
+	//
+	// A name which runs from .rdata into .data would need its pages
+	// unprotected in two goes. The loader never makes such images, so
+	// the engine just refuses, and the image is left alone.
+	//
+
+	InitializeTestImage(Image, 0);
+	AddImport(Image, 0, NAMES_RVA, "user32.dll");
+	AddImport(Image, 1, TEST_IMAGE_DATA_RVA - 4, "kernel32.dll");
+
+	CHECK (Rewrite("straddling name", Image, sizeof(Image), 0, &Result) == STATUS_INVALID_IMAGE_FORMAT);
+	CHECK (NameIs(Image, NAMES_RVA, "user32.dll"));
+	CHECK (NameIs(Image, TEST_IMAGE_DATA_RVA - 4, "kernel32.dll"));
+
+	//
+	// Names in every part of the image.
+	//
+
+	InitializeTestImage(Image, TEST_IMAGE_BOUND_IMPORTS);
+	AddImport(Image, 0, 0x380, "kernel32.dll");
+	AddImport(Image, 1, TEST_IMAGE_TEXT_RVA, "kernel32.dll");
+	AddImport(Image, 2, NAMES_RVA, "kernel32.dll");
+	AddImport(Image, 3, TEST_IMAGE_DATA_RVA, "kernel32.dll");
+
+	CHECK (Rewrite("everywhere", Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	CHECK (Result.NumberOfRewrittenNames == 4);
+	CHECK (Result.NumberOfWindows == 4);
+
+	//
+	// PE32.
+	//
+
+	TestBasic(TEST_IMAGE_32BIT);
+}
+
+STATIC VOID TestIncompletePlan(
+	VOID)
+{
+	STATIC BYTE Image[TEST_IMAGE_SIZE];
+	KEX_IMPORT_REWRITE Result;
+	ULONG Index;
+
+	InitializeTestImage(Image, 0);
+
+	for (Index = 0; Index < KEX_REWRITE_PLAN_MAXIMUM_REWRITES + 12; ++Index) {
+		AddImport(Image, Index, NAMES_RVA + Index * 16, "user32.dll");
+	}
+
+	CHECK (Rewrite("incomplete plan", Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	CHECK (Result.Plan.Incomplete);
+	CHECK (Result.NumberOfRewrittenNames == KEX_REWRITE_PLAN_MAXIMUM_REWRITES + 12);
+
+	for (Index = 0; Index < KEX_REWRITE_PLAN_MAXIMUM_REWRITES + 12; ++Index) {
+		CHECK (NameIs(Image, NAMES_RVA + Index * 16, "kxuser"));
+	}
+}
+
+//
+// A plan from the cache might not match the image (if the cache is stale
+// or someone has been scribbling on it), and mustn't be trusted.
+//
+
+STATIC VOID TestMismatchedPlan(
+	VOID)
+{
+	STATIC BYTE Image[TEST_IMAGE_SIZE];
+	STATIC BYTE OriginalImage[TEST_IMAGE_SIZE];
+	KEX_IMPORT_REWRITE Result;
+	ULONG Problems;
+	ULONG OutOfBoundsWrites;
+
+	InitializeTestImage(Image, 0);
+	AddImport(Image, 0, NAMES_RVA + 0x00, "kernel32.dll");
+	AddImport(Image, 1, NAMES_RVA + 0x20, "foo.dll");
+	RtlCopyMemory(OriginalImage, Image, sizeof(Image));
+
+	CHECK (KexpInitializeImportRewrite(Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	Result.Plan.NumberOfRewrites = 3;
+	Result.Plan.DescriptorIndices[0] = 1;
+	Result.Plan.DescriptorIndices[1] = 2;
+	Result.Plan.DescriptorIndices[2] = 500;
+
+	CHECK (KexpPrepareImportRewrite(&Result) == STATUS_SUCCESS);
+	CHECK (Result.NumberOfWrites == 0 && Result.NumberOfWindows == 0);
+
+	KexpApplyImportRewrite(&Result);
+	CHECK (Result.NumberOfRewrittenNames == 0);
+
+	Problems = VerifyImportRewrite("mismatched plan", OriginalImage, Image, sizeof(Image), &Result, &OutOfBoundsWrites);
+	CHECK (Problems == 0);
+	CHECK (RtlEqualMemory(OriginalImage, Image, sizeof(Image)));
+
+	//
+	// Only what's in the plan gets rewritten, even if there is more.
+	//
+
+	AddImport(Image, 2, NAMES_RVA + 0x40, "user32.dll");
+	RtlCopyMemory(OriginalImage, Image, sizeof(Image));
+
+	CHECK (KexpInitializeImportRewrite(Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	Result.Plan.NumberOfRewrites = 1;
+	Result.Plan.DescriptorIndices[0] = 2;
+
+	CHECK (KexpPrepareImportRewrite(&Result) == STATUS_SUCCESS);
+	KexpApplyImportRewrite(&Result);
+	CHECK (Result.NumberOfRewrittenNames == 1);
+	CHECK (NameIs(Image, NAMES_RVA + 0x00, "kernel32.dll"));
+	CHECK (NameIs(Image, NAMES_RVA + 0x40, "kxuser"));
+
+	Problems = VerifyImportRewrite("partial plan", OriginalImage, Image, sizeof(Image), &Result, &OutOfBoundsWrites);
+	CHECK (Problems == 0);
+}
+
+STATIC VOID TestMalformed(
+	VOID)
+{
+	STATIC BYTE Image[TEST_IMAGE_SIZE];
+	KEX_IMPORT_REWRITE Result;
+	PIMAGE_DATA_DIRECTORY ImportDirectory;
+	ULONG Index;
+
+	//
+	// A name which isn't null terminated before the end of the image, and
+	// one which is outside of it.
+	//
+
+	InitializeTestImage(Image, 0);
+	AddImport(Image, 0, TEST_IMAGE_SIZE - 8, NULL);
+	RtlCopyMemory(Image + TEST_IMAGE_SIZE - 8, "kernel32", 8);
+	AddImport(Image, 1, TEST_IMAGE_SIZE, NULL);
+	AddImport(Image, 2, 0xFFFFFFFF, NULL);
+	AddImport(Image, 3, NAMES_RVA, "");
+
+	CHECK (Rewrite("unterminated", Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	CHECK (Result.NumberOfImportDescriptors == 4);
+	CHECK (Result.NumberOfWrites == 0);
+
+	//
+	// No import directory, an empty one, and ones which run off the end.
+	//
+
+	InitializeTestImage(Image, 0);
+	ImportDirectory = GetTestImageDataDirectory(Image, IMAGE_DIRECTORY_ENTRY_IMPORT);
+	ImportDirectory->VirtualAddress = 0;
+	CHECK (Rewrite("no imports", Image, sizeof(Image), 0, &Result) == STATUS_IMAGE_NO_IMPORT_DIRECTORY);
+
+	InitializeTestImage(Image, 0);
+	CHECK (Rewrite("empty imports", Image, sizeof(Image), 0, &Result) == STATUS_INVALID_IMAGE_FORMAT);
+
+	ImportDirectory = GetTestImageDataDirectory(Image, IMAGE_DIRECTORY_ENTRY_IMPORT);
+	ImportDirectory->VirtualAddress = TEST_IMAGE_SIZE;
+	CHECK (Rewrite("imports outside", Image, sizeof(Image), 0, &Result) == STATUS_INVALID_IMAGE_FORMAT);
+
+	ImportDirectory->VirtualAddress = TEST_IMAGE_SIZE - 3 * sizeof(IMAGE_IMPORT_DESCRIPTOR) - 4;
+	RtlFillMemory(Image + ImportDirectory->VirtualAddress, TEST_IMAGE_SIZE - ImportDirectory->VirtualAddress, 0x41);
+	CHECK (Rewrite("unterminated imports", Image, sizeof(Image), 0, &Result) == STATUS_INVALID_IMAGE_FORMAT);
+
+	//
+	// Images which are smaller than they say, and bad headers.
+	//
+
+	InitializeTestImage(Image, 0);
+	AddImport(Image, 0, NAMES_RVA, "kernel32.dll");
+
+	for (Index = 0x100; Index < NAMES_RVA; Index += 0x100) {
+		NTSTATUS Status;
+
+		Status = Rewrite("truncated", Image, Index, 0, &Result);
+
+		if (Index <= TEST_IMAGE_RDATA_RVA) {
+			CHECK (Status == STATUS_INVALID_IMAGE_FORMAT);
+		} else {
+			// The import directory is there, but the name isn't.
+			CHECK (Status == STATUS_SUCCESS && Result.NumberOfWrites == 0);
+		}
+	}
+
+	// The name is cut off just before its null terminator, and then not.
+	CHECK (Rewrite("truncated name", Image, NAMES_RVA + 12, 0, &Result) == STATUS_SUCCESS);
+	CHECK (Result.NumberOfWrites == 0);
+	CHECK (Rewrite("whole name", Image, NAMES_RVA + 13, 0, &Result) == STATUS_SUCCESS);
+	CHECK (Result.NumberOfRewrittenNames == 1);
+
+	InitializeTestImage(Image, 0);
+	AddImport(Image, 0, NAMES_RVA, "kernel32.dll");
+	((PIMAGE_DOS_HEADER) Image)->e_lfanew = TEST_IMAGE_SIZE - 8;
+	CHECK (Rewrite("bad e_lfanew", Image, sizeof(Image), 0, &Result) == STATUS_INVALID_IMAGE_FORMAT);
+
+	InitializeTestImage(Image, 0);
+	AddImport(Image, 0, NAMES_RVA, "kernel32.dll");
+	((PIMAGE_NT_HEADERS64) (Image + 0x80))->FileHeader.NumberOfSections = 0xFFFF;
+	CHECK (Rewrite("too many sections", Image, sizeof(Image), 0, &Result) == STATUS_INVALID_IMAGE_FORMAT);
+
+	InitializeTestImage(Image, 0);
+	AddImport(Image, 0, NAMES_RVA, "kernel32.dll");
+	((PIMAGE_NT_HEADERS64) (Image + 0x80))->FileHeader.SizeOfOptionalHeader = 0x10;
+	CHECK (Rewrite("short optional header", Image, sizeof(Image), 0, &Result) == STATUS_INVALID_IMAGE_FORMAT);
+
+	InitializeTestImage(Image, 0);
+	AddImport(Image, 0, NAMES_RVA, "kernel32.dll");
+	((PIMAGE_NT_HEADERS64) (Image + 0x80))->OptionalHeader.NumberOfRvaAndSizes = 1;
+	CHECK (Rewrite("no import data directory", Image, sizeof(Image), 0, &Result) == STATUS_IMAGE_NO_IMPORT_DIRECTORY);
+
+	InitializeTestImage(Image, 0);
+	AddImport(Image, 0, NAMES_RVA, "kernel32.dll");
+	((PIMAGE_SECTION_HEADER) (Image + 0x80 + sizeof(IMAGE_NT_HEADERS64)))[2].VirtualAddress = TEST_IMAGE_TEXT_RVA;
+	CHECK (Rewrite("unsorted sections", Image, sizeof(Image), 0, &Result) == STATUS_INVALID_IMAGE_FORMAT);
+}
+
+//
+// Overrides are tested last, because once one has added a DLL which isn't in
+// the generated table, plans can't be shared any more for the rest of the
+// run.
+//
+
+STATIC VOID TestOverrides(
+	VOID)
+{
+	STATIC BYTE Image[TEST_IMAGE_SIZE];
+	STATIC UNICODE_STRING Kernel32 = RTL_CONSTANT_STRING(_L("kernel32"));
+	STATIC UNICODE_STRING Foo = RTL_CONSTANT_STRING(_L("foo"));
+	STATIC UNICODE_STRING LongName = RTL_CONSTANT_STRING(_L("averyveryverylongname"));
+	STATIC UNICODE_STRING KxBase = RTL_CONSTANT_STRING(_L("kxbase"));
+	KEX_IMPORT_REWRITE Result;
+
+	//
+	// Removing an entry takes effect even with a shareable plan, which
+	// still has it in.
+	//
+
+	CHECK (KexRemoveDllRewriteEntry(&Kernel32) == STATUS_SUCCESS);
+	CHECK (KexRemoveDllRewriteEntry(&Kernel32) == STATUS_STRING_MAPPER_ENTRY_NOT_FOUND);
+	CHECK (KexRemoveDllRewriteEntry(&Foo) == STATUS_STRING_MAPPER_ENTRY_NOT_FOUND);
+	CHECK (LookUpIs("KERNEL32.dll", NULL));
+	CHECK (LookUpIs("kernelbase.dll", "kxbase"));
+
+	InitializeTestImage(Image, 0);
+	AddImport(Image, 0, NAMES_RVA + 0x00, "kernel32.dll");
+	AddImport(Image, 1, NAMES_RVA + 0x20, "foo.dll");
+	AddImport(Image, 2, NAMES_RVA + 0x40, "kernelbase.dll");
+
+	CHECK (Rewrite("removed entry", Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	CHECK (Result.PlanIsShareable);
+	CHECK (Result.Plan.NumberOfRewrites == 2);
+	CHECK (Result.NumberOfRewrittenNames == 1);
+	CHECK (NameIs(Image, NAMES_RVA + 0x00, "kernel32.dll"));
+	CHECK (NameIs(Image, NAMES_RVA + 0x40, "kxbase"));
+
+	//
+	// Putting it back, and adding a new one.
+	//
+
+	CHECK (KexAddDllRewriteEntry(&Kernel32, &KxBase) == STATUS_SUCCESS);
+	CHECK (KexAddDllRewriteEntry(&Foo, &KxBase) == STATUS_SUCCESS);
+	CHECK (KexAddDllRewriteEntry(&LongName, &KxBase) == STATUS_SUCCESS);
+	CHECK (LookUpIs("kernel32", "kxbase"));
+	CHECK (LookUpIs("FOO.DLL", "kxbase"));
+
+	InitializeTestImage(Image, 0);
+	AddImport(Image, 0, NAMES_RVA + 0x00, "kernel32.dll");
+	AddImport(Image, 1, NAMES_RVA + 0x20, "foo.dll");
+	AddImport(Image, 2, NAMES_RVA + 0x40, "Foo");
+
+	CHECK (Rewrite("added entries", Image, sizeof(Image), 0, &Result) == STATUS_SUCCESS);
+	CHECK (!Result.PlanIsShareable);
+	CHECK (Result.NumberOfRewrittenNames == 2);
+	CHECK (NameIs(Image, NAMES_RVA + 0x00, "kxbase"));
+	CHECK (NameIs(Image, NAMES_RVA + 0x20, "kxbase"));
+
+	// The new name doesn't fit in place of "Foo", so it stays.
+	CHECK (NameIs(Image, NAMES_RVA + 0x40, "Foo"));
+}
+
+//
+// Images from disk.
+//
+
+STATIC sigjmp_buf FaultJump;
+STATIC VOLATILE sig_atomic_t Rewriting;
+
+STATIC VOID FaultHandler(
+	int		Signal)
+{
+	if (Rewriting) {
+		siglongjmp(FaultJump, 1);
+	}
+
+	signal(Signal, SIG_DFL);
+	raise(Signal);
+}
+
+STATIC int GetHostProtection(
+	IN	ULONG	Protection)
+{
+	// Nothing is executed, so executable pages are just readable.
+	if (Protection & TEST_PROTECTION_WRITE) {
+		return PROT_READ | PROT_WRITE;
+	} else if (Protection & (TEST_PROTECTION_READ | TEST_PROTECTION_EXECUTE)) {
+		return PROT_READ;
+	} else {
+		return PROT_NONE;
+	}
+}
+
+//
+// Give each page of the image the protection it would have on Windows.
+// Only possible if the host has 4K pages as well.
+//
+
+STATIC VOID ProtectImage(
+	IN	PBYTE	Image,
+	IN	ULONG	ImageSize)
+{
+	ULONG Rva;
+
+	unless (ProtectPages) {
+		return;
+	}
+
+	for (Rva = 0; Rva < ImageSize; Rva += PAGE_SIZE) {
+		mprotect(Image + Rva, PAGE_SIZE, GetHostProtection(GetImageProtection(Image, ImageSize, Rva)));
+	}
+}
+
+STATIC VOID UnprotectImage(
+	IN	PBYTE	Image,
+	IN	ULONG	ImageSize)
+{
+	if (ProtectPages) {
+		mprotect(Image, ImageSize, PROT_READ | PROT_WRITE);
+	}
+}
+
+//
+// Check that each import name was rewritten to what the Unicode lookup says
+// (which is what KexRewriteDllPath uses), or left alone.
+//
+
+STATIC ULONG CheckRewrittenNames(
+	IN	PCSTR					Name,
+	IN	PCBYTE					OriginalImage,
+	IN	PCBYTE					Image,
+	IN	ULONG					ImageSize,
+	IN	PCKEX_IMPORT_REWRITE	Rewrite)
+{
+	ULONG Problems;
+	ULONG Index;
+
+	Problems = 0;
+
+	for (Index = 0; Index < Rewrite->NumberOfImportDescriptors; ++Index) {
+		ULONG NameRva;
+		PCSTR OriginalDllName;
+		PCSTR Expected;
+		SIZE_T Cch;
+
+		NameRva = Rewrite->ImportDescriptors[Index].Name;
+
+		if (NameRva >= ImageSize) {
+			continue;
+		}
+
+		OriginalDllName = (PCSTR) OriginalImage + NameRva;
+		Cch = strnlen(OriginalDllName, ImageSize - NameRva);
+
+		if (Cch == 0 || Cch >= MAXIMUM_NAME_CCH || Cch == ImageSize - NameRva) {
+			continue;
+		}
+
+		Expected = LookUp(OriginalDllName);
+
+		if (!Expected || strlen(Expected) > Cch) {
+			Expected = OriginalDllName;
+		}
+
+		if (strcmp((PCSTR) Image + NameRva, Expected)) {
+			printf("%s: %s became %s instead of %s\n", Name, OriginalDllName, (PCSTR) Image + NameRva, Expected);
+			++Problems;
+		}
+	}
+
+	return Problems;
+}
+
+STATIC double Seconds(
+	IN	clock_t	Start)
+{
+	return (double) (clock() - Start) / CLOCKS_PER_SEC;
+}
+
+STATIC VOID TestImageFile(
+	IN	PCSTR	FileName)
+{
+	FILE *File;
+	PBYTE FileData;
+	SIZE_T FileSize;
+	ULONG ImageSize;
+	ULONG AllocationSize;
+	PBYTE Image;
+	PBYTE OriginalImage;
+	NTSTATUS Status;
+	KEX_IMPORT_REWRITE Result;
+	ULONG ProtectCalls;
+	ULONG OutOfBoundsWrites;
+	ULONG Index;
+	BOOLEAN Faulted;
+
+	File = fopen(FileName, "rb");
+
+	if (!File) {
+		printf("%s: can't open\n", FileName);
+		++Failures;
+		return;
+	}
+
+	fseek(File, 0, SEEK_END);
+	FileSize = (SIZE_T) ftell(File);
+	fseek(File, 0, SEEK_SET);
+
+	FileData = (PBYTE) malloc(FileSize ? FileSize : 1);
+
+	if (!FileData || fread(FileData, 1, FileSize, File) != FileSize) {
+		printf("%s: can't read\n", FileName);
+		++Failures;
+		fclose(File);
+		free(FileData);
+		return;
+	}
+
+	fclose(File);
+	ImageSize = GetMappedImageSize(FileData, FileSize);
+
+	if (ImageSize == 0) {
+		// Not an image. The corpus may have other files in it.
+		free(FileData);
+		return;
+	}
+
+	//
+	// The image is followed by a guard page, so that reading past the end
+	// of it crashes.
+	//
+
+	AllocationSize = (ImageSize + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+	OriginalImage = (PBYTE) malloc(ImageSize);
+
+	if (!OriginalImage || posix_memalign((PVOID *) &Image, PAGE_SIZE, AllocationSize + PAGE_SIZE) != 0) {
+		printf("%s: out of memory\n", FileName);
+		++Failures;
+		free(OriginalImage);
+		free(FileData);
+		return;
+	}
+
+	MapImage(FileData, FileSize, Image, ImageSize);
+	RtlCopyMemory(OriginalImage, Image, ImageSize);
+	free(FileData);
+
+	if (ProtectPages) {
+		mprotect(Image + AllocationSize, PAGE_SIZE, PROT_NONE);
+	}
+
+	ProtectImage(Image, ImageSize);
+
+	//
+	// This is the same sequence of steps as KexRewriteImageImportDirectory.
+	//
+
+	Status = KexpInitializeImportRewrite(Image, ImageSize, 0, &Result);
+
+	if (Status == STATUS_IMAGE_NO_IMPORT_DIRECTORY) {
+		printf("%-44s no imports\n", FileName);
+		goto Exit;
+	}
+
+	CHECK (NT_SUCCESS(Status));
+
+	if (!NT_SUCCESS(Status)) {
+		printf("%s: status %08lx\n", FileName, (unsigned long) Status);
+		goto Exit;
+	}
+
+	KexpPlanImportRewrite(&Result);
+	Status = KexpPrepareImportRewrite(&Result);
+	CHECK (NT_SUCCESS(Status));
+
+	if (!NT_SUCCESS(Status)) {
+		printf("%s: status %08lx\n", FileName, (unsigned long) Status);
+		goto Exit;
+	}
+
+	ProtectCalls = 0;
+	Faulted = FALSE;
+
+	if (Result.NumberOfWrites != 0) {
+		for (Index = 0; Index < Result.NumberOfWindows; ++Index) {
+			if (ProtectPages) {
+				mprotect(Image + Result.Windows[Index].Rva, Result.Windows[Index].Size, PROT_READ | PROT_WRITE);
+			}
+
+			++ProtectCalls;
+		}
+
+		Rewriting = TRUE;
+
+		if (sigsetjmp(FaultJump, 1) == 0) {
+			KexpApplyImportRewrite(&Result);
+		} else {
+			printf("%s: the rewrite wrote to a page which wasn't made writable\n", FileName);
+			Faulted = TRUE;
+			++Failures;
+		}
+
+		Rewriting = FALSE;
+		ProtectImage(Image, ImageSize);
+	}
+
+	UnprotectImage(Image, ImageSize);
+
+	unless (Faulted) {
+		CHECK (VerifyImportRewrite(FileName, OriginalImage, Image, ImageSize, &Result, &OutOfBoundsWrites) == 0);
+		CHECK (CheckRewrittenNames(FileName, OriginalImage, Image, ImageSize, &Result) == 0);
+
+		printf("%-44s %4lu imports, %3lu rewritten, %lu windows, %lu protection changes, %lu out of bounds\n",
+			   FileName,
+			   (unsigned long) Result.NumberOfImportDescriptors,
+			   (unsigned long) Result.NumberOfRewrittenNames,
+			   (unsigned long) Result.NumberOfWindows,
+			   (unsigned long) ProtectCalls,
+			   (unsigned long) OutOfBoundsWrites);
+	}
+
+	if (Benchmark) {
+		clock_t Start;
+		double PrepareTime;
+		double RewriteTime;
+
+		//
+		// Time working out the rewrite on its own (which is all that
+		// happens to images which don't need anything rewritten), and the
+		// whole rewrite. Before each rewrite, the windows are copied back
+		// from the original image, which counts towards the time.
+		//
+
+		RtlCopyMemory(Image, OriginalImage, ImageSize);
+		Start = clock();
+
+		for (Index = 0; Index < BENCHMARK_ITERATIONS; ++Index) {
+			KexpInitializeImportRewrite(OriginalImage, ImageSize, 0, &Result);
+			KexpPlanImportRewrite(&Result);
+			KexpPrepareImportRewrite(&Result);
+		}
+
+		PrepareTime = Seconds(Start);
+		Start = clock();
+
+		for (Index = 0; Index < BENCHMARK_ITERATIONS; ++Index) {
+			ULONG WindowIndex;
+
+			KexpInitializeImportRewrite(Image, ImageSize, 0, &Result);
+			KexpPlanImportRewrite(&Result);
+			KexpPrepareImportRewrite(&Result);
+			KexpApplyImportRewrite(&Result);
+
+			for (WindowIndex = 0; WindowIndex < Result.NumberOfWindows; ++WindowIndex) {
+				PCKEX_REWRITE_WINDOW Window;
+
+				Window = &Result.Windows[WindowIndex];
+
+				RtlCopyMemory(
+					Image + Window->Rva,
+					OriginalImage + Window->Rva,
+					min(Window->Size, ImageSize - Window->Rva));
+			}
+		}
+
+		RewriteTime = Seconds(Start);
+
+		printf("%-44s %8.3f us to prepare, %8.3f us to rewrite\n",
+			   "",
+			   PrepareTime * 1e6 / BENCHMARK_ITERATIONS,
+			   RewriteTime * 1e6 / BENCHMARK_ITERATIONS);
+	}
+
+Exit:
+	UnprotectImage(Image, AllocationSize + PAGE_SIZE);
+	free(Image);
+	free(OriginalImage);
+}
+
+STATIC VOID TestImageFiles(
+	IN	PCSTR	Path)
+{
+	struct stat Stat;
+	DIR *Directory;
+	struct dirent *Entry;
+
+	if (stat(Path, &Stat) != 0) {
+		printf("%s: not found\n", Path);
+		++Failures;
+		return;
+	}
+
+	unless (S_ISDIR(Stat.st_mode)) {
+		TestImageFile(Path);
+		return;
+	}
+
+	Directory = opendir(Path);
+
+	if (!Directory) {
+		printf("%s: can't open\n", Path);
+		++Failures;
+		return;
+	}
+
+	while ((Entry = readdir(Directory)) != NULL) {
+		PSTR EntryPath;
+
+		if (Entry->d_name[0] == '.') {
+			continue;
+		}
+
+		EntryPath = (PSTR) malloc(strlen(Path) + strlen(Entry->d_name) + 2);
+
+		if (!EntryPath) {
+			++Failures;
+			break;
+		}
+
+		sprintf(EntryPath, "%s/%s", Path, Entry->d_name);
+		TestImageFiles(EntryPath);
+		free(EntryPath);
+	}
+
+	closedir(Directory);
+}
+
+int main(
+	int		argc,
+	char	**argv)
+{
+	struct sigaction Action;
+	int Index;
+
+	TestLookups();
+	TestBasic(0);
+	TestBoundImports();
+	TestKernel32();
+	TestLayouts();
+	TestIncompletePlan();
+	TestMismatchedPlan();
+	TestMalformed();
+
+	RtlZeroMemory(&Action, sizeof(Action));
+	Action.sa_handler = FaultHandler;
+	sigaction(SIGSEGV, &Action, NULL);
+	sigaction(SIGBUS, &Action, NULL);
+
+	ProtectPages = (sysconf(_SC_PAGESIZE) == PAGE_SIZE);
+
+	for (Index = 1; Index < argc; ++Index) {
+		if (!strcmp(argv[Index], "-b")) {
+			Benchmark = TRUE;
+		} else {
+			TestImageFiles(argv[Index]);
+		}
+	}
+
+	TestOverrides();
+
+	if (Failures) {
+		printf("%lu checks failed\n", (unsigned long) Failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,380 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     test.c
+//
+// Abstract:
+//
+//     Host test and benchmark for the UTF-16 substring search engine
+//     (KexDll\strsrch.c). Build and run it on any machine with a C compiler
+//     by typing "make" in this directory. The benchmark compares it with
+//     StringSearchIW from KexStrSafe.h, which is what the log viewer used
+//     to filter entries with.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                18-Oct-2026  Use hosttest.h.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "hosttest.h"
+#include "strsrch.h"
+
+#include <time.h>
+
+#define MAXIMUM_NEEDLE_CCH 48
+#define MAXIMUM_HAYSTACK_CCH 100
+#define BENCHMARK_ENTRIES 200000
+#define BENCHMARK_ITERATIONS 10
+
+STATIC CONST CHAR *MethodNames[] = {"horspool", "sse2", "avx2"};
+
+//
+// Copied from KexStrSafe.h, which can't be used on the build host.
+//
+
+#define ToUpper(c) (((c) >= 'a' && (c) <= 'z') ? ((c) - 32) : (c))
+
+STATIC BOOLEAN StringSearchIW(
+	IN	PCWSTR	Haystack,
+	IN	PCWSTR	Needle)
+{
+	WCHAR NeedleFirst;
+
+	NeedleFirst = ToUpper(*Needle);
+
+	while (TRUE) {
+		PCWSTR Needle2 = Needle;
+
+		while (ToUpper(*Haystack) != NeedleFirst) {
+			if (!*++Haystack) {
+				return FALSE;
+			}
+		}
+
+		while (*Haystack && *Needle2 && ToUpper(*Haystack) == ToUpper(*Needle2)) {
+			if (!*++Needle2) {
+				return TRUE;
+			}
+
+			if (!*++Haystack) {
+				return FALSE;
+			}
+		}
+	}
+}
+
+STATIC PCWCHAR ReferenceSearch(
+	IN	PCWSTR	Haystack,
+	IN	ULONG	HaystackCch,
+	IN	PCWSTR	Needle,
+	IN	ULONG	NeedleCch,
+	IN	BOOLEAN	CaseInsensitive)
+{
+	ULONG Position;
+	ULONG Index;
+
+	for (Position = 0; Position + NeedleCch <= HaystackCch; ++Position) {
+		for (Index = 0; Index < NeedleCch; ++Index) {
+			WCHAR HaystackCharacter;
+			WCHAR NeedleCharacter;
+
+			HaystackCharacter = Haystack[Position + Index];
+			NeedleCharacter = Needle[Index];
+
+			if (CaseInsensitive) {
+				HaystackCharacter = ToUpper(HaystackCharacter);
+				NeedleCharacter = ToUpper(NeedleCharacter);
+			}
+
+			if (HaystackCharacter != NeedleCharacter) {
+				break;
+			}
+		}
+
+		if (Index == NeedleCch) {
+			return Haystack + Position;
+		}
+	}
+
+	return NULL;
+}
+
+//
+// Pick characters from a small alphabet so that there are plenty of partial
+// matches. It includes the characters on either side of the ASCII letters,
+// and characters which share a low byte with them (they share an entry in
+// the shift table).
+//
+
+STATIC WCHAR RandomCharacter(
+	VOID)
+{
+	STATIC CONST WCHAR Alphabet[] = {
+		'a', 'A', 'b', 'B', 'z', 'Z', '`', '{', '@', '[',
+		0xFF41, 0x0161, 0x8061, 0xFFFF, 0x0100
+	};
+
+	return Alphabet[Random() % ARRAYSIZE(Alphabet)];
+}
+
+STATIC VOID TestMethod(
+	IN	KEX_SEARCH_METHOD	Method)
+{
+	STATIC BYTE SearcherBuffer[KEX_SEARCH_SEARCHER_SIZE(MAXIMUM_NEEDLE_CCH) + 8];
+	PKEX_RTL_STRING_SEARCHER Searcher;
+	WCHAR Needle[MAXIMUM_NEEDLE_CCH];
+	ULONG Iteration;
+
+	Searcher = (PKEX_RTL_STRING_SEARCHER) SearcherBuffer;
+
+	for (Iteration = 0; Iteration < 200000; ++Iteration) {
+		PWCHAR Haystack;
+		ULONG HaystackCch;
+		ULONG NeedleCch;
+		ULONG Index;
+		BOOLEAN CaseInsensitive;
+		PCWCHAR Expected;
+		PCWCHAR Actual;
+
+		NeedleCch = 1 + Random() % MAXIMUM_NEEDLE_CCH;
+		HaystackCch = Random() % (MAXIMUM_HAYSTACK_CCH + 1);
+		CaseInsensitive = (BOOLEAN) (Random() & 1);
+
+		// exactly the right size, so that an over-read shows up under a memory checker
+		Haystack = (PWCHAR) malloc((HaystackCch + 1) * sizeof(WCHAR));
+
+		for (Index = 0; Index < HaystackCch; ++Index) {
+			Haystack[Index] = RandomCharacter();
+		}
+
+		Haystack[HaystackCch] = '\0';
+
+		//
+		// Most of the time, take the needle from the haystack so that it's
+		// actually there (possibly with different case).
+		//
+
+		if (HaystackCch >= NeedleCch && (Random() % 4) != 0) {
+			ULONG Start;
+
+			Start = Random() % (HaystackCch - NeedleCch + 1);
+
+			for (Index = 0; Index < NeedleCch; ++Index) {
+				Needle[Index] = Haystack[Start + Index];
+
+				if (CaseInsensitive && Needle[Index] >= 'A' && Needle[Index] <= 'Z' && (Random() & 1)) {
+					Needle[Index] += 32;
+				}
+			}
+		} else {
+			for (Index = 0; Index < NeedleCch; ++Index) {
+				Needle[Index] = RandomCharacter();
+			}
+		}
+
+		KexRtlpInitializeStringSearcher(
+			Searcher,
+			Needle,
+			NeedleCch,
+			CaseInsensitive ? KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE : 0);
+
+		Searcher->Method = Method;
+
+		Expected = ReferenceSearch(Haystack, HaystackCch, Needle, NeedleCch, CaseInsensitive);
+		Actual = KexRtlpSearchString(Searcher, Haystack, HaystackCch);
+		CHECK (Actual == Expected);
+
+		free(Haystack);
+	}
+
+	printf("%-8s checked\n", MethodNames[Method]);
+}
+
+STATIC VOID TestEdgeCases(
+	VOID)
+{
+	STATIC BYTE SearcherBuffer[KEX_SEARCH_SEARCHER_SIZE(8)];
+	STATIC CONST WCHAR Haystack[] = {'a', 'b', 'c', 'a', 'b', 'C'};
+	STATIC CONST WCHAR Needle[] = {'a', 'B', 'c'};
+	PKEX_RTL_STRING_SEARCHER Searcher;
+
+	Searcher = (PKEX_RTL_STRING_SEARCHER) SearcherBuffer;
+
+	KexRtlpInitializeStringSearcher(Searcher, Needle, 0, 0);
+	CHECK (KexRtlpSearchString(Searcher, Haystack, ARRAYSIZE(Haystack)) == Haystack);
+	CHECK (KexRtlpSearchString(Searcher, Haystack, 0) == Haystack);
+
+	KexRtlpInitializeStringSearcher(Searcher, Needle, ARRAYSIZE(Needle), 0);
+	CHECK (KexRtlpSearchString(Searcher, Haystack, ARRAYSIZE(Haystack)) == NULL);
+	CHECK (KexRtlpSearchString(Searcher, Haystack, 2) == NULL);
+
+	KexRtlpInitializeStringSearcher(Searcher, Needle, ARRAYSIZE(Needle), KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE);
+	CHECK (KexRtlpSearchString(Searcher, Haystack, ARRAYSIZE(Haystack)) == Haystack);
+	CHECK (KexRtlpSearchString(Searcher, Haystack + 1, ARRAYSIZE(Haystack) - 1) == Haystack + 3);
+	CHECK (Searcher->Needle[1] == 'B');
+	CHECK (Searcher->Needle[ARRAYSIZE(Needle)] == '\0');
+}
+
+//
+// Make something that looks like the text of a log: lots of short entries,
+// each with its own null terminator, like the text in the log viewer.
+//
+
+STATIC PWCHAR MakeLogEntries(
+	OUT	PULONG	Offsets,
+	IN	ULONG	NumberOfEntries)
+{
+	STATIC CONST CHAR *Phrases[] = {
+		"Process created",
+		"Loaded DLL: C:\\Windows\\system32\\kernel32.dll",
+		"Rewrote import api-ms-win-core-synch-l1-2-0.dll -> kxbase.dll",
+		"Hooked function NtQueryInformationProcess",
+		"GetProcAddress failed for CreateRemoteThreadEx",
+		"The VxKex version is 1.1.2.1400 (Release)"
+	};
+
+	PWCHAR Text;
+	ULONG Position;
+	ULONG Entry;
+
+	Text = (PWCHAR) malloc(NumberOfEntries * 96 * sizeof(WCHAR));
+	Position = 0;
+
+	for (Entry = 0; Entry < NumberOfEntries; ++Entry) {
+		CONST CHAR *Phrase;
+		CHAR Suffix[24];
+		ULONG Index;
+
+		Offsets[Entry] = Position;
+		Phrase = Phrases[Random() % ARRAYSIZE(Phrases)];
+
+		for (Index = 0; Phrase[Index]; ++Index) {
+			Text[Position++] = Phrase[Index];
+		}
+
+		sprintf(Suffix, " #%lu", (unsigned long) Entry);
+
+		for (Index = 0; Suffix[Index]; ++Index) {
+			Text[Position++] = Suffix[Index];
+		}
+
+		Text[Position++] = '\0';
+	}
+
+	Offsets[NumberOfEntries] = Position;
+	return Text;
+}
+
+STATIC VOID BenchmarkNeedle(
+	IN	PCWSTR		Text,
+	IN	PCULONG		Offsets,
+	IN	CONST CHAR	*NeedleAnsi)
+{
+	STATIC BYTE SearcherBuffer[KEX_SEARCH_SEARCHER_SIZE(MAXIMUM_NEEDLE_CCH)];
+	PKEX_RTL_STRING_SEARCHER Searcher;
+	KEX_SEARCH_METHOD Method;
+	KEX_SEARCH_METHOD BestMethod;
+	WCHAR Needle[MAXIMUM_NEEDLE_CCH + 1];
+	ULONG NeedleCch;
+	ULONG Iteration;
+	ULONG Entry;
+	ULONG Matches;
+	clock_t Start;
+	double Seconds;
+	double Megabytes;
+
+	Searcher = (PKEX_RTL_STRING_SEARCHER) SearcherBuffer;
+	Megabytes = (double) Offsets[BENCHMARK_ENTRIES] * sizeof(WCHAR) * BENCHMARK_ITERATIONS / (1024 * 1024);
+
+	for (NeedleCch = 0; NeedleAnsi[NeedleCch]; ++NeedleCch) {
+		Needle[NeedleCch] = NeedleAnsi[NeedleCch];
+	}
+
+	Needle[NeedleCch] = '\0';
+	printf("needle \"%s\":\n", NeedleAnsi);
+
+	Matches = 0;
+	Start = clock();
+
+	for (Iteration = 0; Iteration < BENCHMARK_ITERATIONS; ++Iteration) {
+		for (Entry = 0; Entry < BENCHMARK_ENTRIES; ++Entry) {
+			Matches += StringSearchIW(Text + Offsets[Entry], Needle);
+		}
+	}
+
+	Seconds = (double) (clock() - Start) / CLOCKS_PER_SEC;
+	printf("  %-14s %7lu matches %8.0f MB/s\n", "StringSearchIW",
+		   (unsigned long) Matches, Megabytes / (Seconds > 0 ? Seconds : 1e-9));
+
+	BestMethod = KexRtlpQuerySearchMethod();
+
+	for (Method = SearchMethodHorspool; Method <= BestMethod; ++Method) {
+		KexRtlpInitializeStringSearcher(Searcher, Needle, NeedleCch, KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE);
+		Searcher->Method = Method;
+
+		Matches = 0;
+		Start = clock();
+
+		for (Iteration = 0; Iteration < BENCHMARK_ITERATIONS; ++Iteration) {
+			for (Entry = 0; Entry < BENCHMARK_ENTRIES; ++Entry) {
+				Matches += KexRtlpSearchString(
+					Searcher,
+					Text + Offsets[Entry],
+					Offsets[Entry + 1] - Offsets[Entry] - 1) != NULL;
+			}
+		}
+
+		Seconds = (double) (clock() - Start) / CLOCKS_PER_SEC;
+		printf("  %-14s %7lu matches %8.0f MB/s\n", MethodNames[Method],
+			   (unsigned long) Matches, Megabytes / (Seconds > 0 ? Seconds : 1e-9));
+	}
+}
+
+STATIC VOID Benchmark(
+	VOID)
+{
+	PULONG Offsets;
+	PWCHAR Text;
+
+	Offsets = (PULONG) malloc((BENCHMARK_ENTRIES + 1) * sizeof(ULONG));
+	Text = MakeLogEntries(Offsets, BENCHMARK_ENTRIES);
+
+	BenchmarkNeedle(Text, Offsets, "dll");
+	BenchmarkNeedle(Text, Offsets, "createremotethreadex");
+	BenchmarkNeedle(Text, Offsets, "this text does not appear anywhere in the log");
+
+	free(Text);
+	free(Offsets);
+}
+
+int main(
+	int		argc,
+	char	**argv)
+{
+	KEX_SEARCH_METHOD Method;
+
+	TestEdgeCases();
+
+	for (Method = SearchMethodHorspool; Method <= KexRtlpQuerySearchMethod(); ++Method) {
+		TestMethod(Method);
+	}
+
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		Benchmark();
+	}
+
+	if (Failures) {
+		printf("%lu checks failed\n", (unsigned long) Failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
\ No newline at end of file
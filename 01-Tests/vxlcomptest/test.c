@@ -0,0 +1,319 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     test.c
+//
+// Abstract:
+//
+//     Host test and benchmark for the VXL block compressor and block index
+//     (KexDll\vxlcomp.c). Build and run it on any machine with a C compiler
+//     by typing "make" in this directory.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                18-Oct-2026  Use hosttest.h.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "hosttest.h"
+#include "vxlcomp.h"
+
+#include <time.h>
+
+#define BLOCK_SIZE 0xF000
+#define BENCHMARK_ITERATIONS 2000
+
+STATIC BYTE WorkSpace[VXL_COMPRESS_WORKSPACE_SIZE];
+STATIC BYTE Input[BLOCK_SIZE];
+STATIC BYTE Compressed[VXL_COMPRESS_BOUND(BLOCK_SIZE)];
+STATIC BYTE Decompressed[BLOCK_SIZE];
+
+//
+// Fill the buffer with something that looks like the contents of a block:
+// log entries made of a fixed-size binary header followed by UTF-16 text
+// which repeats itself a lot, but not exactly.
+//
+
+STATIC ULONG FillWithLogEntries(
+	OUT	PBYTE	Buffer,
+	IN	ULONG	BufferCb)
+{
+	STATIC CONST CHAR *Phrases[] = {
+		"Process created",
+		"Loaded DLL: C:\\Windows\\system32\\kernel32.dll",
+		"Rewrote import api-ms-win-core-synch-l1-2-0.dll -> kxbase.dll",
+		"Hooked function NtQueryInformationProcess",
+		"GetProcAddress failed for CreateRemoteThreadEx",
+		"The VxKex version is 1.1.2.1400 (Release)"
+	};
+
+	ULONG Position;
+	ULONG Sequence;
+
+	Position = 0;
+	Sequence = 0;
+
+	while (Position + 40 + 256 < BufferCb) {
+		CONST CHAR *Phrase;
+		ULONG Index;
+
+		RtlZeroMemory(&Buffer[Position], 40);
+		Buffer[Position] = 1;
+		Buffer[Position + 4] = 0x34;
+		Buffer[Position + 8] = (BYTE) Sequence;
+		Buffer[Position + 9] = (BYTE) (Sequence >> 8);
+		Buffer[Position + 16] = (BYTE) (Random() % 6);
+		Position += 38;
+
+		Phrase = Phrases[Random() % ARRAYSIZE(Phrases)];
+
+		for (Index = 0; Phrase[Index]; ++Index) {
+			Buffer[Position++] = Phrase[Index];
+			Buffer[Position++] = 0;
+		}
+
+		Position += sprintf((char *) &Buffer[Position], " #%lu", (unsigned long) Sequence);
+		Buffer[Position++] = 0;
+		Buffer[Position++] = 0;
+		++Sequence;
+	}
+
+	RtlZeroMemory(&Buffer[Position], BufferCb - Position);
+	return BufferCb;
+}
+
+STATIC VOID TestRoundTrip(
+	IN	CONST CHAR	*Description,
+	IN	PCVOID		Data,
+	IN	ULONG		DataCb)
+{
+	NTSTATUS Status;
+	ULONG CompressedCb;
+	ULONG DecompressedCb;
+
+	Status = VxlpCompressBlock(Data, DataCb, Compressed, sizeof(Compressed), &CompressedCb, WorkSpace);
+	CHECK (NT_SUCCESS(Status));
+	CHECK (CompressedCb <= VXL_COMPRESS_BOUND(DataCb));
+
+	Status = VxlpDecompressBlock(Compressed, CompressedCb, Decompressed, DataCb, &DecompressedCb);
+	CHECK (NT_SUCCESS(Status));
+	CHECK (DecompressedCb == DataCb);
+	CHECK (RtlEqualMemory(Decompressed, Data, DataCb));
+
+	printf("%-24s %6lu -> %6lu bytes\n", Description,
+		   (unsigned long) DataCb, (unsigned long) CompressedCb);
+}
+
+STATIC VOID TestCompressor(
+	VOID)
+{
+	ULONG Index;
+	ULONG Size;
+
+	TestRoundTrip("empty", Input, 0);
+
+	for (Size = 1; Size < 40; ++Size) {
+		for (Index = 0; Index < Size; ++Index) {
+			Input[Index] = (BYTE) (Index % 3);
+		}
+
+		TestRoundTrip("tiny", Input, Size);
+	}
+
+	RtlFillMemory(Input, sizeof(Input), 'A');
+	TestRoundTrip("run of one byte", Input, sizeof(Input));
+
+	for (Index = 0; Index < sizeof(Input); ++Index) {
+		Input[Index] = (BYTE) Random();
+	}
+
+	TestRoundTrip("random", Input, sizeof(Input));
+
+	FillWithLogEntries(Input, sizeof(Input));
+	TestRoundTrip("log entries", Input, sizeof(Input));
+
+	for (Size = 1; Size < sizeof(Input); Size = Size * 3 + 7) {
+		TestRoundTrip("log entries (partial)", Input, Size);
+	}
+}
+
+//
+// Output buffer too small must fail cleanly in both directions.
+//
+
+STATIC VOID TestSmallBuffers(
+	VOID)
+{
+	NTSTATUS Status;
+	ULONG CompressedCb;
+	ULONG DecompressedCb;
+
+	for (CompressedCb = 0; CompressedCb < 0x100; ++CompressedCb) {
+		Input[CompressedCb] = (BYTE) Random();
+	}
+
+	Status = VxlpCompressBlock(Input, 0x100, Compressed, 0x80, &CompressedCb, WorkSpace);
+	CHECK (Status == STATUS_BUFFER_TOO_SMALL);
+
+	FillWithLogEntries(Input, sizeof(Input));
+	Status = VxlpCompressBlock(Input, sizeof(Input), Compressed, sizeof(Compressed), &CompressedCb, WorkSpace);
+	CHECK (NT_SUCCESS(Status));
+
+	Status = VxlpDecompressBlock(Compressed, CompressedCb, Decompressed, sizeof(Input) - 1, &DecompressedCb);
+	CHECK (Status == STATUS_BAD_COMPRESSION_BUFFER);
+}
+
+//
+// Malformed compressed data must be rejected, or at least must not cause
+// any access outside the buffers. Run this under a memory checker (for
+// example, make check CFLAGS=-fsanitize=address) to be sure.
+//
+
+STATIC VOID TestMalformedInput(
+	VOID)
+{
+	NTSTATUS Status;
+	ULONG CompressedCb;
+	ULONG DecompressedCb;
+	ULONG Iteration;
+	ULONG Rejected;
+	STATIC CONST BYTE ZeroOffset[] = {0x14, 'a', 0x00, 0x00, 0x00};
+	STATIC CONST BYTE OffsetTooFar[] = {0x14, 'a', 0x02, 0x00, 0x00};
+	STATIC CONST BYTE NoFinalLiterals[] = {0x14, 'a', 0x01, 0x00};
+	STATIC CONST BYTE LengthRunsOff[] = {0xF0, 0xFF, 0xFF};
+
+	CHECK (VxlpDecompressBlock(ZeroOffset, sizeof(ZeroOffset), Decompressed, sizeof(Decompressed), &DecompressedCb) == STATUS_BAD_COMPRESSION_BUFFER);
+	CHECK (VxlpDecompressBlock(OffsetTooFar, sizeof(OffsetTooFar), Decompressed, sizeof(Decompressed), &DecompressedCb) == STATUS_BAD_COMPRESSION_BUFFER);
+	CHECK (VxlpDecompressBlock(NoFinalLiterals, sizeof(NoFinalLiterals), Decompressed, sizeof(Decompressed), &DecompressedCb) == STATUS_BAD_COMPRESSION_BUFFER);
+	CHECK (VxlpDecompressBlock(LengthRunsOff, sizeof(LengthRunsOff), Decompressed, sizeof(Decompressed), &DecompressedCb) == STATUS_BAD_COMPRESSION_BUFFER);
+	CHECK (VxlpDecompressBlock(Compressed, 0, Decompressed, sizeof(Decompressed), &DecompressedCb) == STATUS_BAD_COMPRESSION_BUFFER);
+
+	FillWithLogEntries(Input, sizeof(Input));
+	Status = VxlpCompressBlock(Input, sizeof(Input), Compressed, sizeof(Compressed), &CompressedCb, WorkSpace);
+	CHECK (NT_SUCCESS(Status));
+
+	Rejected = 0;
+
+	for (Iteration = 0; Iteration < 20000; ++Iteration) {
+		STATIC BYTE Corrupted[sizeof(Compressed)];
+		ULONG CorruptedCb;
+
+		RtlCopyMemory(Corrupted, Compressed, CompressedCb);
+		CorruptedCb = CompressedCb;
+
+		if (Iteration & 1) {
+			CorruptedCb = Random() % CompressedCb;
+		} else {
+			Corrupted[Random() % CompressedCb] = (BYTE) Random();
+		}
+
+		Status = VxlpDecompressBlock(Corrupted, CorruptedCb, Decompressed, sizeof(Decompressed), &DecompressedCb);
+
+		if (!NT_SUCCESS(Status)) {
+			++Rejected;
+		} else {
+			CHECK (DecompressedCb <= sizeof(Decompressed));
+		}
+	}
+
+	printf("corrupted blocks rejected: %lu of %lu\n", (unsigned long) Rejected, (unsigned long) Iteration);
+}
+
+STATIC VOID TestBlockIndex(
+	VOID)
+{
+	VXLBLOCKINDEXENTRY Blocks[4];
+	ULONG Index;
+
+	RtlZeroMemory(Blocks, sizeof(Blocks));
+
+	// Entries 0-9 are in a block, 10-14 are uncompressed, 15-34 and 35-39
+	// are in blocks, and 40 onwards is uncompressed.
+	Blocks[0].FirstEntryIndex = 0;		Blocks[0].EntryCount = 10;
+	Blocks[1].FirstEntryIndex = 15;		Blocks[1].EntryCount = 20;
+	Blocks[2].FirstEntryIndex = 35;		Blocks[2].EntryCount = 5;
+	Blocks[3].FirstEntryIndex = 100;	Blocks[3].EntryCount = 1;
+
+	CHECK (VxlpFindBlockIndexEntry(Blocks, 0, 0) == NULL);
+
+	for (Index = 0; Index < 110; ++Index) {
+		PVXLBLOCKINDEXENTRY Expected;
+
+		if (Index < 10) {
+			Expected = &Blocks[0];
+		} else if (Index >= 15 && Index < 35) {
+			Expected = &Blocks[1];
+		} else if (Index >= 35 && Index < 40) {
+			Expected = &Blocks[2];
+		} else if (Index == 100) {
+			Expected = &Blocks[3];
+		} else {
+			Expected = NULL;
+		}
+
+		CHECK (VxlpFindBlockIndexEntry(Blocks, ARRAYSIZE(Blocks), Index) == Expected);
+	}
+}
+
+STATIC VOID Benchmark(
+	VOID)
+{
+	ULONG Iteration;
+	ULONG CompressedCb;
+	ULONG DecompressedCb;
+	clock_t Start;
+	double CompressSeconds;
+	double DecompressSeconds;
+	double Megabytes;
+
+	FillWithLogEntries(Input, sizeof(Input));
+
+	Start = clock();
+
+	for (Iteration = 0; Iteration < BENCHMARK_ITERATIONS; ++Iteration) {
+		VxlpCompressBlock(Input, sizeof(Input), Compressed, sizeof(Compressed), &CompressedCb, WorkSpace);
+	}
+
+	CompressSeconds = (double) (clock() - Start) / CLOCKS_PER_SEC;
+	Start = clock();
+
+	for (Iteration = 0; Iteration < BENCHMARK_ITERATIONS; ++Iteration) {
+		VxlpDecompressBlock(Compressed, CompressedCb, Decompressed, sizeof(Decompressed), &DecompressedCb);
+	}
+
+	DecompressSeconds = (double) (clock() - Start) / CLOCKS_PER_SEC;
+	Megabytes = (double) sizeof(Input) * BENCHMARK_ITERATIONS / (1024 * 1024);
+
+	printf("ratio %.2f, compress %.0f MB/s, decompress %.0f MB/s\n",
+		   (double) sizeof(Input) / CompressedCb,
+		   Megabytes / (CompressSeconds > 0 ? CompressSeconds : 1e-9),
+		   Megabytes / (DecompressSeconds > 0 ? DecompressSeconds : 1e-9));
+}
+
+int main(
+	int		argc,
+	char	**argv)
+{
+	TestCompressor();
+	TestSmallBuffers();
+	TestMalformedInput();
+	TestBlockIndex();
+
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		Benchmark();
+	}
+
+	if (Failures) {
+		printf("%lu checks failed\n", (unsigned long) Failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,300 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     test.c
+//
+// Abstract:
+//
+//     Host test for the VXL export formatter (KexDll\vxlfmt.c). Build and
+//     run it on any machine with a C compiler by typing "make check" in this
+//     directory.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Test VxlpFormatString.
+//     agent                17-Oct-2026  Pass a time cache to VxlpFormatLogEntry.
+//     agent                18-Oct-2026  Use hosttest.h.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "hosttest.h"
+#include "vxlfmt.h"
+
+#include <time.h>
+
+//
+// Widen an ASCII string literal into a static buffer.
+//
+
+STATIC PCWSTR Widen(
+	IN	PCSTR	String,
+	OUT	PWSTR	Buffer)
+{
+	ULONG Index;
+
+	for (Index = 0; String[Index] != '\0'; ++Index) {
+		Buffer[Index] = (WCHAR) (BYTE) String[Index];
+	}
+
+	Buffer[Index] = '\0';
+	return Buffer;
+}
+
+STATIC ULONG Cch(
+	IN	PCWSTR	String)
+{
+	ULONG Length;
+
+	for (Length = 0; String[Length] != '\0'; ++Length);
+	return Length;
+}
+
+//
+// Format an entry and compare the result with what it should be. Also
+// checks that a buffer which is one byte too small is left alone past its
+// end, and that the size needed is reported correctly.
+//
+
+STATIC VOID CheckFormat(
+	IN	VXLEXPORTFORMAT		Format,
+	IN	PCVXLFORMATENTRY	Entry,
+	IN	LONGLONG			TimeZoneBias,
+	IN	PCSTR				Expected)
+{
+	BYTE Buffer[1024];
+	VXLTIMECACHE TimeCache;
+	ULONG ExpectedCb;
+	ULONG Cb;
+
+	ExpectedCb = (ULONG) strlen(Expected);
+	VxlpInitializeTimeCache(&TimeCache);
+
+	memset(Buffer, 0xCC, sizeof(Buffer));
+	Cb = VxlpFormatLogEntry(Format, Entry, TimeZoneBias, &TimeCache, Buffer, ExpectedCb - 1);
+	CHECK (Cb == ExpectedCb);
+	CHECK (Buffer[ExpectedCb - 1] == 0xCC);
+
+	Cb = VxlpFormatLogEntry(Format, Entry, TimeZoneBias, &TimeCache, Buffer, sizeof(Buffer));
+	CHECK (Cb == ExpectedCb);
+
+	if (Cb != ExpectedCb || memcmp(Buffer, Expected, ExpectedCb) != 0) {
+		printf("format %d:\n  expected: %s\n  got:      %.*s\n", Format, Expected, (int) min(Cb, sizeof(Buffer)), Buffer);
+		++Failures;
+	}
+}
+
+STATIC VOID TestHeaders(
+	VOID)
+{
+	BYTE Buffer[256];
+	ULONG Cb;
+
+	Cb = VxlpFormatExportHeader(VxlExportFormatText, Buffer, sizeof(Buffer));
+	CHECK (Cb == 3 && memcmp(Buffer, "\xEF\xBB\xBF", 3) == 0);
+
+	Cb = VxlpFormatExportHeader(VxlExportFormatCsv, Buffer, sizeof(Buffer));
+	CHECK (Cb > 3 && memcmp(Buffer, "\xEF\xBB\xBFTime,Severity,", 17) == 0);
+	CHECK (Buffer[Cb - 2] == '\r' && Buffer[Cb - 1] == '\n');
+
+	Cb = VxlpFormatExportHeader(VxlExportFormatJsonLines, Buffer, sizeof(Buffer));
+	CHECK (Cb == 0);
+}
+
+STATIC VOID TestFormats(
+	VOID)
+{
+	VXLFORMATENTRY Entry;
+	WCHAR Buffers[8][64];
+	LONGLONG Time64;
+
+	// 17 October 2026, 12:34:56.789 UTC
+	Time64 = (1792240496LL + UNIX_EPOCH_SECONDS) * VXL_TIME_UNITS_PER_SECOND + 789 * VXL_TIME_UNITS_PER_MILLISECOND;
+
+	memset(&Entry, 0, sizeof(Entry));
+	Entry.TextHeader = Widen("Loaded kernel32.dll", Buffers[0]);
+	Entry.TextHeaderCch = Cch(Entry.TextHeader);
+	Entry.Severity = Widen("Information", Buffers[1]);
+	Entry.SourceComponent = Widen("Ldr", Buffers[2]);
+	Entry.SourceFile = Widen("dllrewrt.c", Buffers[3]);
+	Entry.SourceFunction = Widen("KexRewriteImportTableOfDll", Buffers[4]);
+	Entry.SourceLine = 123;
+	Entry.ProcessId = 0x1a2b;
+	Entry.ThreadId = 0x3c;
+	Entry.Time64 = Time64;
+
+	// one hour ahead of UTC
+	CheckFormat(VxlExportFormatText, &Entry, -3600 * VXL_TIME_UNITS_PER_SECOND,
+		"[2026-10-17 13:34:56.789 1a2b:003c Ldr\\dllrewrt.c:123 (KexRewriteImportTableOfDll)] "
+		"Loaded kernel32.dll\r\n");
+
+	CheckFormat(VxlExportFormatCsv, &Entry, 0,
+		"2026-10-17T12:34:56.789Z,Information,6699,60,\"Ldr\",\"dllrewrt.c\",123,"
+		"\"KexRewriteImportTableOfDll\",\"Loaded kernel32.dll\",\r\n");
+
+	CheckFormat(VxlExportFormatJsonLines, &Entry, 0,
+		"{\"time\":\"2026-10-17T12:34:56.789Z\",\"severity\":\"Information\",\"pid\":6699,\"tid\":60,"
+		"\"component\":\"Ldr\",\"file\":\"dllrewrt.c\",\"line\":123,"
+		"\"function\":\"KexRewriteImportTableOfDll\",\"header\":\"Loaded kernel32.dll\",\"text\":null}\n");
+
+	//
+	// Body text, characters which need escaping, and non-ASCII text
+	// (including a surrogate pair and an unpaired surrogate).
+	//
+
+	Entry.TextHeader = Widen("say \"hi\", then\tgo\\", Buffers[0]);
+	Entry.TextHeaderCch = Cch(Entry.TextHeader);
+	Buffers[5][0] = 0x00E9;		// e with acute accent
+	Buffers[5][1] = 0x20AC;		// euro sign
+	Buffers[5][2] = 0xD83D;		// U+1F600
+	Buffers[5][3] = 0xDE00;
+	Buffers[5][4] = 0xDC00;		// unpaired
+	Buffers[5][5] = '\n';
+	Buffers[5][6] = 0x0001;
+	Buffers[5][7] = '\0';
+	Entry.Text = Buffers[5];
+	Entry.TextCch = 7;
+
+	CheckFormat(VxlExportFormatText, &Entry, 0,
+		"[2026-10-17 12:34:56.789 1a2b:003c Ldr\\dllrewrt.c:123 (KexRewriteImportTableOfDll)] "
+		"say \"hi\", then\tgo\\ // \xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xEF\xBF\xBD\n\x01\r\n");
+
+	CheckFormat(VxlExportFormatCsv, &Entry, 0,
+		"2026-10-17T12:34:56.789Z,Information,6699,60,\"Ldr\",\"dllrewrt.c\",123,"
+		"\"KexRewriteImportTableOfDll\",\"say \"\"hi\"\", then\tgo\\\","
+		"\"\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xEF\xBF\xBD\n\x01\"\r\n");
+
+	CheckFormat(VxlExportFormatJsonLines, &Entry, 0,
+		"{\"time\":\"2026-10-17T12:34:56.789Z\",\"severity\":\"Information\",\"pid\":6699,\"tid\":60,"
+		"\"component\":\"Ldr\",\"file\":\"dllrewrt.c\",\"line\":123,"
+		"\"function\":\"KexRewriteImportTableOfDll\",\"header\":\"say \\\"hi\\\", then\\tgo\\\\\","
+		"\"text\":\"\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xEF\xBF\xBD\\n\\u0001\"}\n");
+
+	// An empty body is still written out as an empty string.
+	Entry.TextCch = 0;
+
+	CheckFormat(VxlExportFormatJsonLines, &Entry, 0,
+		"{\"time\":\"2026-10-17T12:34:56.789Z\",\"severity\":\"Information\",\"pid\":6699,\"tid\":60,"
+		"\"component\":\"Ldr\",\"file\":\"dllrewrt.c\",\"line\":123,"
+		"\"function\":\"KexRewriteImportTableOfDll\",\"header\":\"say \\\"hi\\\", then\\tgo\\\\\","
+		"\"text\":\"\"}\n");
+}
+
+STATIC VOID TestStrings(
+	VOID)
+{
+	WCHAR String[32];
+	BYTE Buffer[64];
+	ULONG Cb;
+
+	Widen("a \"b\", c", String);
+
+	Cb = VxlpFormatString(VxlExportFormatText, String, Cch(String), Buffer, sizeof(Buffer));
+	CHECK (Cb == 8 && memcmp(Buffer, "a \"b\", c", Cb) == 0);
+
+	Cb = VxlpFormatString(VxlExportFormatCsv, String, Cch(String), Buffer, sizeof(Buffer));
+	CHECK (Cb == 12 && memcmp(Buffer, "\"a \"\"b\"\", c\"", Cb) == 0);
+
+	Cb = VxlpFormatString(VxlExportFormatJsonLines, String, Cch(String), Buffer, sizeof(Buffer));
+	CHECK (Cb == 12 && memcmp(Buffer, "\"a \\\"b\\\", c\"", Cb) == 0);
+
+	// nothing is written past the end of a buffer which is too small
+	memset(Buffer, 0xCC, sizeof(Buffer));
+	Cb = VxlpFormatString(VxlExportFormatCsv, String, Cch(String), Buffer, 4);
+	CHECK (Cb == 12 && Buffer[4] == 0xCC);
+}
+
+//
+// Compare the date conversion against the C library for lots of random
+// times between 1970 and 2200, and a few times which are easy to get wrong.
+//
+
+STATIC VOID TestDates(
+	VOID)
+{
+	STATIC CONST LONGLONG Fixed[] = {
+		0,							// 1970-01-01
+		951782400,					// 2000-02-29
+		951868800,					// 2000-03-01
+		4107456000LL,				// 2100-02-28
+		4107542400LL,				// 2100-03-01
+		1709164800,					// 2024-02-29
+		1735689599,					// 2024-12-31 23:59:59
+	};
+
+	VXLFORMATENTRY Entry;
+	VXLTIMECACHE TimeCache;
+	WCHAR Empty[1];
+	ULONG Index;
+
+	VxlpInitializeTimeCache(&TimeCache);
+	Empty[0] = '\0';
+	memset(&Entry, 0, sizeof(Entry));
+	Entry.TextHeader = Empty;
+	Entry.Severity = Empty;
+	Entry.SourceComponent = Empty;
+	Entry.SourceFile = Empty;
+	Entry.SourceFunction = Empty;
+
+	for (Index = 0; Index < 100000 + ARRAYSIZE(Fixed); ++Index) {
+		LONGLONG Seconds;
+		time_t UnixTime;
+		struct tm *Tm;
+		CHAR Expected[64];
+		BYTE Buffer[256];
+		ULONG Cb;
+
+		if (Index < ARRAYSIZE(Fixed)) {
+			Seconds = Fixed[Index];
+		} else {
+			Seconds = (((ULONGLONG) Random() << 32) | Random()) % 7258118400LL;
+		}
+
+		UnixTime = (time_t) Seconds;
+		Tm = gmtime(&UnixTime);
+
+		if (!Tm) {
+			continue;
+		}
+
+		snprintf(Expected, sizeof(Expected), "%04d-%02d-%02dT%02d:%02d:%02d.000Z",
+				 Tm->tm_year + 1900, Tm->tm_mon + 1, Tm->tm_mday,
+				 Tm->tm_hour, Tm->tm_min, Tm->tm_sec);
+
+		Entry.Time64 = (Seconds + UNIX_EPOCH_SECONDS) * VXL_TIME_UNITS_PER_SECOND;
+		Cb = VxlpFormatLogEntry(VxlExportFormatCsv, &Entry, 0, &TimeCache, Buffer, sizeof(Buffer));
+		CHECK (Cb > 24);
+
+		if (memcmp(Buffer, Expected, 24) != 0) {
+			printf("date: expected %s, got %.24s\n", Expected, Buffer);
+			++Failures;
+
+			if (Failures > 10) {
+				return;
+			}
+		}
+	}
+}
+
+int main(
+	int		argc,
+	char	**argv)
+{
+	TestHeaders();
+	TestFormats();
+	TestStrings();
+	TestDates();
+
+	if (Failures) {
+		printf("%lu checks failed\n", (unsigned long) Failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     test.c
+//
+// Abstract:
+//
+//     Host test for the log entry time conversion (KexDll\vxltime.c). Build
+//     and run it on any machine with a C compiler by typing "make check" in
+//     this directory.
+//
+//     Every conversion is checked against gmtime. Times are converted in
+//     time order, in random order, and in time order with small random
+//     steps, so that the cached hour and day are both reused and replaced.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                18-Oct-2026  Use hosttest.h.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "hosttest.h"
+#include "vxltime.h"
+
+#include <time.h>
+
+// 1 January 2200, in seconds since 1 January 1970
+#define LATEST_SECONDS 7258118400LL
+
+STATIC ULONGLONG Random64(
+	VOID)
+{
+	return ((ULONGLONG) Random() << 32) | Random();
+}
+
+//
+// Convert a time (in 100ns intervals since 1970) with the cache and check
+// the result against gmtime.
+//
+
+STATIC VOID CheckTime(
+	IN OUT	PVXLTIMECACHE	TimeCache,
+	IN		LONGLONG		UnixTime64)
+{
+	SYSTEMTIME Time;
+	time_t UnixTime;
+	struct tm *Tm;
+
+	if (Failures > 10) {
+		return;
+	}
+
+	VxlpConvertTime(TimeCache, UnixTime64 + UNIX_EPOCH_SECONDS * VXL_TIME_UNITS_PER_SECOND, &Time);
+
+	UnixTime = (time_t) (UnixTime64 / VXL_TIME_UNITS_PER_SECOND);
+	Tm = gmtime(&UnixTime);
+
+	if (!Tm) {
+		return;
+	}
+
+	if (Time.wYear != Tm->tm_year + 1900 ||
+		Time.wMonth != Tm->tm_mon + 1 ||
+		Time.wDay != Tm->tm_mday ||
+		Time.wDayOfWeek != Tm->tm_wday ||
+		Time.wHour != Tm->tm_hour ||
+		Time.wMinute != Tm->tm_min ||
+		Time.wSecond != Tm->tm_sec ||
+		Time.wMilliseconds != (UnixTime64 / VXL_TIME_UNITS_PER_MILLISECOND) % 1000) {
+
+		printf("time %lld:\n  expected: %04d-%02d-%02d (%d) %02d:%02d:%02d.%03d\n"
+			   "  got:      %04u-%02u-%02u (%u) %02u:%02u:%02u.%03u\n",
+			   (long long) UnixTime64,
+			   Tm->tm_year + 1900, Tm->tm_mon + 1, Tm->tm_mday, Tm->tm_wday,
+			   Tm->tm_hour, Tm->tm_min, Tm->tm_sec,
+			   (int) ((UnixTime64 / VXL_TIME_UNITS_PER_MILLISECOND) % 1000),
+			   Time.wYear, Time.wMonth, Time.wDay, Time.wDayOfWeek,
+			   Time.wHour, Time.wMinute, Time.wSecond, Time.wMilliseconds);
+
+		++Failures;
+	}
+}
+
+//
+// Times which are easy to get wrong: leap days, the ends of years and
+// centuries, and the last moment of an hour.
+//
+
+STATIC VOID TestFixed(
+	VOID)
+{
+	STATIC CONST LONGLONG Fixed[] = {
+		0,							// 1970-01-01
+		951782400,					// 2000-02-29
+		951868800,					// 2000-03-01
+		4107456000LL,				// 2100-02-28
+		4107542400LL,				// 2100-03-01
+		1709164800,					// 2024-02-29
+		1735689599,					// 2024-12-31 23:59:59
+		1735689600,					// 2025-01-01
+	};
+
+	VXLTIMECACHE TimeCache;
+	ULONG Index;
+
+	VxlpInitializeTimeCache(&TimeCache);
+
+	for (Index = 0; Index < ARRAYSIZE(Fixed); ++Index) {
+		CheckTime(&TimeCache, Fixed[Index] * VXL_TIME_UNITS_PER_SECOND);
+
+		if (Fixed[Index] != 0) {
+			CheckTime(&TimeCache, Fixed[Index] * VXL_TIME_UNITS_PER_SECOND - 1);
+		}
+
+		CheckTime(&TimeCache, Fixed[Index] * VXL_TIME_UNITS_PER_SECOND + VXL_TIME_UNITS_PER_HOUR - 1);
+	}
+}
+
+STATIC VOID TestRandom(
+	VOID)
+{
+	VXLTIMECACHE TimeCache;
+	ULONG Index;
+
+	VxlpInitializeTimeCache(&TimeCache);
+
+	for (Index = 0; Index < 1000000; ++Index) {
+		CheckTime(&TimeCache, Random64() % (LATEST_SECONDS * VXL_TIME_UNITS_PER_SECOND));
+	}
+}
+
+//
+// Times which go forward in small steps, the way they do in a log, with the
+// occasional step backwards (entries from different threads can be slightly
+// out of order) and the occasional big jump.
+//
+
+STATIC VOID TestSequential(
+	VOID)
+{
+	VXLTIMECACHE TimeCache;
+	LONGLONG UnixTime64;
+	ULONG Index;
+
+	VxlpInitializeTimeCache(&TimeCache);
+	UnixTime64 = 946684800LL * VXL_TIME_UNITS_PER_SECOND - VXL_TIME_UNITS_PER_DAY;
+
+	for (Index = 0; Index < 10000000; ++Index) {
+		ULONG Step;
+
+		Step = Random();
+
+		if ((Step & 0xFFFF) == 0) {
+			UnixTime64 = Random64() % (LATEST_SECONDS * VXL_TIME_UNITS_PER_SECOND);
+		} else if ((Step & 0xFF) == 0) {
+			UnixTime64 -= (Step >> 8) % VXL_TIME_UNITS_PER_MINUTE;
+		} else {
+			UnixTime64 += (Step >> 8) % (VXL_TIME_UNITS_PER_SECOND / 2);
+		}
+
+		if (UnixTime64 < 0 || UnixTime64 >= LATEST_SECONDS * VXL_TIME_UNITS_PER_SECOND) {
+			UnixTime64 = 0;
+		}
+
+		CheckTime(&TimeCache, UnixTime64);
+	}
+}
+
+//
+// Times before 1601 can't be shown, and come out as the start of 1601.
+//
+
+STATIC VOID TestNegative(
+	VOID)
+{
+	VXLTIMECACHE TimeCache;
+	SYSTEMTIME Time;
+
+	VxlpInitializeTimeCache(&TimeCache);
+	VxlpConvertTime(&TimeCache, -1, &Time);
+
+	CHECK (Time.wYear == 1601);
+	CHECK (Time.wMonth == 1);
+	CHECK (Time.wDay == 1);
+	CHECK (Time.wDayOfWeek == 1);
+	CHECK (Time.wHour == 0);
+	CHECK (Time.wMinute == 0);
+	CHECK (Time.wSecond == 0);
+	CHECK (Time.wMilliseconds == 0);
+}
+
+int main(
+	int		argc,
+	char	**argv)
+{
+	TestFixed();
+	TestRandom();
+	TestSequential();
+	TestNegative();
+
+	if (Failures) {
+		printf("%lu checks failed\n", (unsigned long) Failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
\ No newline at end of file
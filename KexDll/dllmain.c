@@ -26,6 +26,9 @@
 //     vxiiduu              05-Jan-2023  Convert to user friendly NTSTATUS.
 //     vxiiduu              23-Feb-2024  Remove support for advanced logging.
 //     vxiiduu              23-Feb-2024  Remove unneeded debug logging
+//     agent                17-Oct-2026  Skip log events when there is no log.
+//     agent                17-Oct-2026  Finalize the log retention index.
+//     agent                18-Oct-2026  Flush buffered log entries on crashes.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -121,6 +124,16 @@ BOOL WINAPI DllMain(
 		//
 
 		KexOpenVxlLogForCurrentApplication(&KexData->LogHandle);
+		KexInstallLogFlushExceptionHandler();
+
+		if (KexIsReleaseBuild && !KexData->LogHandle) {
+			//
+			// Log events have nowhere to go (in debug builds they are still
+			// sent to the debugger), so don't waste time formatting them.
+			//
+
+			KexData->LogSeverityThreshold = LogSeverityInvalidValue;
+		}
 
 		//
 		// Hook hard errors so that we can log various kinds of loader failures.
@@ -247,6 +260,7 @@ BOOL WINAPI DllMain(
 		ASSERT (NT_SUCCESS(Status));
 	} else if (Reason == DLL_PROCESS_DETACH) {
 		VxlCloseLog(&KexData->LogHandle);
+		KexpFinalizeLogRetentionPolicy();
 	}
 
 	return TRUE;
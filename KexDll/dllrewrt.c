@@ -24,42 +24,27 @@
 //     vxiiduu              13-Mar-2024  Move DLL redirects into a static table
 //                                       instead of reading them from registry.
 //     YuZhouRen            12-Jan-2025  Fix IE crash bug.
+//     agent                17-Oct-2026  Look redirects up in a generated perfect
+//                                       hash table instead of filling a string
+//                                       mapper at startup.
+//     agent                17-Oct-2026  Rewrite import table names without
+//                                       converting them to Unicode.
+//     agent                17-Oct-2026  Plan import rewrites before doing them,
+//                                       and share the plans between processes.
+//     agent                17-Oct-2026  Move the rewrite table and import
+//                                       rewriting into rwengine.c, and change
+//                                       page protections once per image.
+//     agent                17-Oct-2026  Move KexpLookupDllRewriteEntry into
+//                                       rwengine.c.
+//     agent                18-Oct-2026  Pass the whole import rewrite to the
+//                                       plan cache, which checks plans
+//                                       against the import directory.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "buildcfg.h"
 #include "kexdllp.h"
 
-STATIC PKEX_RTL_STRING_MAPPER DllRewriteStringMapper = NULL;
-
-// This header file contains the definition of the DLL rewrite table.
-#include "redirects.h"
-
-NTSTATUS KexAddDllRewriteEntry(
-	IN	PCUNICODE_STRING	DllName,
-	IN	PCUNICODE_STRING	RewrittenDllName)
-{
-	ASSUME (DllRewriteStringMapper != NULL);
-	ASSUME (VALID_UNICODE_STRING(DllName));
-	ASSUME (VALID_UNICODE_STRING(RewrittenDllName));
-
-	return KexRtlInsertEntryStringMapper(
-		DllRewriteStringMapper,
-		DllName,
-		RewrittenDllName);
-}
-
-NTSTATUS KexRemoveDllRewriteEntry(
-	IN	PCUNICODE_STRING	DllName)
-{
-	ASSUME (DllRewriteStringMapper != NULL);
-	ASSUME (VALID_UNICODE_STRING(DllName));
-
-	return KexRtlRemoveEntryStringMapper(
-		DllRewriteStringMapper,
-		DllName);
-}
-
 //
 // Initialize the DLL rewrite subsystem.
 //
@@ -68,7 +53,6 @@ NTSTATUS KexInitializeDllRewrite(
 	VOID)
 {
 	NTSTATUS Status;
-	ULONG Index;
 	WCHAR IEPath[MAX_PATH] = L"X:\\Program Files\\Internet Explorer\\iexplore.exe";
 	WCHAR IEPath_x86[MAX_PATH] = L"X:\\Program Files (x86)\\Internet Explorer\\iexplore.exe";
 	BOOL IsIE;
@@ -78,41 +62,27 @@ NTSTATUS KexInitializeDllRewrite(
 	IsIE = StringEqualI(NtCurrentPeb()->ProcessParameters->ImagePathName.Buffer, IEPath) || StringEqualI(NtCurrentPeb()->ProcessParameters->ImagePathName.Buffer, IEPath_x86);
 	if (IsIE) KexLogInformationEvent(L"This is an IE process, kernel32 will not be redirected, or this process might crash.");
 
-	ASSERT (DllRewriteStringMapper == NULL);
+	if (IsIE) {
+		UNICODE_STRING Kernel32;
 
-	//
-	// Create the DLL rewrite string mapper.
-	//
-
-	Status = KexRtlCreateStringMapper(
-		&DllRewriteStringMapper, 
-		KEX_RTL_STRING_MAPPER_CASE_INSENSITIVE_KEYS);
-
-	ASSERT (NT_SUCCESS(Status));
-
-	if (!NT_SUCCESS(Status)) {
-		return Status;
+		RtlInitConstantUnicodeString(&Kernel32, L"kernel32");
+		Status = KexRemoveDllRewriteEntry(&Kernel32);
+		ASSERT (NT_SUCCESS(Status));
 	}
 
-	ASSERT (DllRewriteStringMapper != NULL);
-
 	//
-	// Populate the DLL rewrite string mapper.
+	// Check the DLL rewrite table and open the rewrite plan cache. Import
+	// directories are simply walked every time if this fails, so it doesn't
+	// matter much.
 	//
 
-	ForEachArrayItem (DllRedirects, Index) {
-		ASSERT (VALID_UNICODE_STRING(&DllRedirects[Index][0]));
-		ASSERT (VALID_UNICODE_STRING(&DllRedirects[Index][1]));
-
-		unless (IsIE && DllRedirects[Index][0].Buffer == L"kernel32") {
-			Status = KexAddDllRewriteEntry(
-				&DllRedirects[Index][0],
-				&DllRedirects[Index][1]);
+	Status = KexpInitializeDllRewriteEngine();
 
-			ASSERT (NT_SUCCESS(Status));
-
-			if (!NT_SUCCESS(Status)) return Status;
-		}
+	if (!NT_SUCCESS(Status)) {
+		KexLogDetailEvent(
+			L"The rewrite plan cache could not be opened.\r\n\r\n"
+			L"NTSTATUS error code: %s",
+			KexRtlNtStatusToString(Status));
 	}
 
 	//
@@ -143,170 +113,6 @@ NTSTATUS KexInitializeDllRewrite(
 	return Status;
 }
 
-//
-// This function accepts DLL base names only. They may or may not have a .dll
-// extension.
-//
-// Callers are forbidden from editing the contents of RewrittenDllName->Buffer.
-// If you do that, then you will modify the entry inside the string mapper
-// itself, and cause a lot of problems.
-//
-STATIC NTSTATUS KexpLookupDllRewriteEntry(
-	IN	PCUNICODE_STRING		DllName,
-	OUT	PUNICODE_STRING			RewrittenDllName)
-{
-	NTSTATUS Status;
-	UNICODE_STRING CleanDllName;
-	UNICODE_STRING DotDll;
-	UNICODE_STRING ApiPrefix;
-	UNICODE_STRING ExtPrefix;
-	USHORT MaximumRewrittenLength;
-
-	ASSERT (DllRewriteStringMapper != NULL);
-	ASSERT (VALID_UNICODE_STRING(DllName));
-	ASSERT (RewrittenDllName != NULL);
-
-	CleanDllName = *DllName;
-
-	RtlInitConstantUnicodeString(&DotDll, L".dll");
-	RtlInitConstantUnicodeString(&ApiPrefix, L"api-");
-	RtlInitConstantUnicodeString(&ExtPrefix, L"ext-");
-
-	//
-	// If the name of the DLL has a .dll extension, shorten the length of it
-	// so that it doesn't have a .dll extension anymore.
-	// This allows image files to import from DLLs with no extension without
-	// choking up the dll rewrite.
-	//
-
-	MaximumRewrittenLength = CleanDllName.Length;
-
-	if (KexRtlUnicodeStringEndsWith(&CleanDllName, &DotDll, TRUE)) {
-		CleanDllName.Length -= KexRtlUnicodeStringCch(&DotDll) * sizeof(WCHAR);
-	}
-
-	//
-	// If the name of the DLL starts with "api-" or "ext-" (i.e. it's an API set DLL),
-	// then remove the -lX-Y-Z suffix as well.
-	// This code will have to be revised when API sets start appearing with
-	// individual X-Y-Z numbers greater than 9.
-	//
-
-	if (RtlPrefixUnicodeString(&ApiPrefix, &CleanDllName, TRUE) ||
-		RtlPrefixUnicodeString(&ExtPrefix, &CleanDllName, TRUE)) {
-
-		CleanDllName.Length -= 7 * sizeof(WCHAR);
-	}
-
-	//
-	// Now look up the DLL in the DLL rewrite string mapper to see whether we
-	// have a rewrite entry for it.
-	//
-
-	Status = KexRtlLookupEntryStringMapper(
-		DllRewriteStringMapper,
-		&CleanDllName,
-		RewrittenDllName);
-
-	ASSERT (NT_SUCCESS(Status) || Status == STATUS_STRING_MAPPER_ENTRY_NOT_FOUND);
-
-	if (!NT_SUCCESS(Status)) {
-		return Status;
-	}
-
-	//
-	// Check to see that the cch of the rewritten DLL is not greater than the
-	// cch of the original DLL. This shouldn't happen unless someone has made
-	// a mistake with the DLL rewrite table.
-	//
-
-	ASSERT (RewrittenDllName->Length <= MaximumRewrittenLength);
-	ASSERT (VALID_UNICODE_STRING(RewrittenDllName));
-
-	return STATUS_SUCCESS;
-}
-
-//
-// Rewrite a DLL name based on the string mapper entries.
-// This function is meant to operate directly on the import directories of
-// loaded images, not for general use.
-//
-STATIC NTSTATUS KexpRewriteImportTableDllNameInPlace(
-	IN OUT	PANSI_STRING			AnsiDllName)
-{
-	NTSTATUS Status;
-	UNICODE_STRING DllName;
-	UNICODE_STRING RewrittenDllName;
-
-	ASSERT (AnsiDllName != NULL);
-	ASSERT (AnsiDllName->Length != 0);
-	ASSERT (AnsiDllName->MaximumLength >= AnsiDllName->Length);
-	ASSERT (AnsiDllName->Buffer != NULL);
-
-	//
-	// This Unicode DLL name gets allocated from the heap.
-	// We have to remember to free it.
-	//
-	
-	Status = RtlAnsiStringToUnicodeString(&DllName, AnsiDllName, TRUE);
-	ASSERT (NT_SUCCESS(Status));
-
-	if (!NT_SUCCESS(Status)) {
-		return Status;
-	}
-
-	//
-	// Lookup the name of the DLL to see whether we should rewrite it.
-	// If no entry was found in the string mapper, or another error occurred,
-	// just return and leave the original DLL name un-modified.
-	//
-
-	Status = KexpLookupDllRewriteEntry(
-		&DllName,
-		&RewrittenDllName);
-
-	ASSERT (NT_SUCCESS(Status) || Status == STATUS_STRING_MAPPER_ENTRY_NOT_FOUND);
-
-	if (!NT_SUCCESS(Status)) {
-		goto Exit;
-	}
-
-	try {
-		//
-		// Convert to ANSI. This will result in RtlUnicodeStringToAnsiString writing
-		// directly into the import table of an image file, so that's why we put
-		// this code in a try-except block (in case we screwed up with memory access
-		// flags earlier, or some weirdly formatted DLL file lays things out in an
-		// unexpected way).
-		//
-
-		Status = RtlUnicodeStringToAnsiString(
-			AnsiDllName,
-			&RewrittenDllName,
-			FALSE);
-
-		ASSERT (NT_SUCCESS(Status));
-
-	} except (GetExceptionCode() == STATUS_ACCESS_VIOLATION) {
-		Status = GetExceptionCode();
-
-		KexLogErrorEvent(
-			L"Failed to rewrite DLL import (%wZ -> %wZ): STATUS_ACCESS_VIOLATION",
-			&DllName,
-			&RewrittenDllName);
-
-		ASSERT (FALSE);
-	}
-
-Exit:
-	if (NT_SUCCESS(Status)) {
-		KexLogDetailEvent(L"Rewrote DLL import: %wZ -> %wZ", &DllName, &RewrittenDllName);
-	}
-
-	RtlFreeUnicodeString(&DllName);
-	return Status;
-}
-
 //
 // Determine whether the imports of a particular DLL (identified by name and
 // path) should be rewritten.
@@ -443,17 +249,13 @@ NTSTATUS KexRewriteImageImportDirectory(
 {
 	NTSTATUS Status;
 	PIMAGE_NT_HEADERS NtHeaders;
-	PIMAGE_FILE_HEADER CoffHeader;
-	PIMAGE_OPTIONAL_HEADER OptionalHeader;
-	PIMAGE_DATA_DIRECTORY ImportDirectory;
-	PIMAGE_IMPORT_DESCRIPTOR ImportDescriptor;
 	UNICODE_STRING Kernel32;
-	BOOLEAN AtLeastOneImportWasRewritten;
-	ULONG OldProtect;
-
-	AtLeastOneImportWasRewritten = FALSE;
+	ULONG Flags;
+	KEX_IMPORT_REWRITE Rewrite;
+	ULONG OldProtect[KEX_IMPORT_REWRITE_MAXIMUM_WINDOWS];
+	ULONG NumberOfProtectedWindows;
+	ULONG Index;
 
-	ASSERT (DllRewriteStringMapper != NULL);
 	ASSERT (ImageBase != NULL);
 	ASSERT (VALID_UNICODE_STRING(BaseImageName));
 	ASSERT (VALID_UNICODE_STRING(FullImageName));
@@ -470,11 +272,7 @@ NTSTATUS KexRewriteImageImportDirectory(
 		return Status;
 	}
 
-	CoffHeader = &NtHeaders->FileHeader;
-	OptionalHeader = &NtHeaders->OptionalHeader;
-	ImportDirectory = &OptionalHeader->DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
-
-	if ((KexRtlCurrentProcessBitness() == 64) != (CoffHeader->Machine == 0x8664)) {
+	if ((KexRtlCurrentProcessBitness() == 64) != (NtHeaders->FileHeader.Machine == 0x8664)) {
 		//
 		// 32-bit dll loaded in 64-bit process or vice versa
 		// This can happen with resource-only DLLs, in which case there are no
@@ -484,135 +282,137 @@ NTSTATUS KexRewriteImageImportDirectory(
 		return STATUS_IMAGE_MACHINE_TYPE_MISMATCH;
 	}
 
-	if (OptionalHeader->NumberOfRvaAndSizes < (IMAGE_DIRECTORY_ENTRY_IMPORT + 1) ||
-		ImportDirectory->VirtualAddress == 0) {
-		//
-		// There is no import directory in the image (e.g. resource-only DLL).
-		//
-
-		return STATUS_IMAGE_NO_IMPORT_DIRECTORY;
-	}
-
-	ImportDescriptor = (PIMAGE_IMPORT_DESCRIPTOR) RVA_TO_VA(ImageBase, ImportDirectory->VirtualAddress);
+	//
+	// Only NTDLL gets rewritten in kernel32.
+	//
 
-	if (ImportDescriptor->Name == 0) {
-		//
-		// There shouldn't be an import directory if it has no entries.
-		//
+	RtlInitConstantUnicodeString(&Kernel32, L"kernel32.dll");
+	Flags = 0;
 
-		return STATUS_INVALID_IMAGE_FORMAT;
+	if (RtlEqualUnicodeString(BaseImageName, &Kernel32, TRUE)) {
+		Flags |= KEX_IMPORT_REWRITE_KERNEL32;
 	}
 
-	//
-	// Set the entire section that contains the image import directory to read-write.
-	//
-	
-	Status = KexLdrProtectImageImportSection(
+	Status = KexpInitializeImportRewrite(
 		ImageBase,
-		PAGE_READWRITE,
-		&OldProtect);
-
-	ASSERT (NT_SUCCESS(Status));
+		NtHeaders->OptionalHeader.SizeOfImage,
+		Flags,
+		&Rewrite);
 
 	if (!NT_SUCCESS(Status)) {
+		// e.g. no import directory (resource-only DLL)
 		return Status;
 	}
 
 	//
-	// Check if this is kernel32.
+	// Find out what has to be rewritten, unless another process (or this
+	// one) has already done that for the same image.
 	//
 
-	RtlInitConstantUnicodeString(&Kernel32, L"kernel32.dll");
-
-	if (RtlEqualUnicodeString(BaseImageName, &Kernel32, TRUE)) {
-		PSTR NtdllImport;
+	unless (Rewrite.PlanIsShareable && KexpLookupRewritePlan(FullImageName, NtHeaders, &Rewrite)) {
+		KexpPlanImportRewrite(&Rewrite);
 
-		// On Windows 7, NTDLL is always the 2nd import of kernel32.
-		NtdllImport = (PSTR) RVA_TO_VA(ImageBase, ImportDescriptor[1].Name);
-		ASSERT (StringEqualA(NtdllImport, "ntdll.dll"));
-
-		RtlCopyMemory(NtdllImport, "kxnt.dll", sizeof("kxnt.dll"));
-		AtLeastOneImportWasRewritten = TRUE;
-		goto SkipNormalImportRewrite;
+		if (Rewrite.PlanIsShareable && !Rewrite.Plan.Incomplete) {
+			KexpStoreRewritePlan(FullImageName, NtHeaders, &Rewrite);
+		}
 	}
 
 	//
-	// Walk through imports and rewrite each one if necessary.
+	// Work out which pages will be written to. Still nothing is written and
+	// no page protections are changed.
 	//
 
-	do {
-		PSTR DllNameBuffer;
-		ANSI_STRING ImportedDllNameAnsi;
-
-		DllNameBuffer = (PSTR) RVA_TO_VA(ImageBase, ImportDescriptor->Name);
-		RtlInitAnsiString(&ImportedDllNameAnsi, DllNameBuffer);
-
-		Status = KexpRewriteImportTableDllNameInPlace(
-			&ImportedDllNameAnsi);
-
-		ASSERT (NT_SUCCESS(Status) || Status == STATUS_STRING_MAPPER_ENTRY_NOT_FOUND);
-
-		if (NT_SUCCESS(Status)) {
-			AtLeastOneImportWasRewritten = TRUE;
-		}
-	} while ((++ImportDescriptor)->Name != 0);
+	Status = KexpPrepareImportRewrite(&Rewrite);
+	ASSERT (NT_SUCCESS(Status));
 
-SkipNormalImportRewrite:
+	if (!NT_SUCCESS(Status)) {
+		KexLogErrorEvent(
+			L"Failed to prepare the import directory of %wZ for rewriting.\r\n\r\n"
+			L"NTSTATUS error code: %s",
+			BaseImageName,
+			KexRtlNtStatusToString(Status));
 
-	// restore old permissions
-	Status = KexLdrProtectImageImportSection(
-		ImageBase,
-		OldProtect,
-		&OldProtect);
+		return Status;
+	}
 
-	ASSERT (NT_SUCCESS(Status));
+	if (Rewrite.NumberOfWrites == 0) {
+		// Nothing to do, so don't touch the image at all.
+		return STATUS_SUCCESS;
+	}
 
-	if (AtLeastOneImportWasRewritten) {
-		PIMAGE_DATA_DIRECTORY BoundImportDirectory;
-		PVOID DataDirectoryPtr;
-		SIZE_T DataDirectorySize;
+	//
+	// Make the pages writable. The bound import data directory is usually
+	// in the same window as the DLL names, or doesn't need to be cleared at
+	// all, so this is normally done only once per image.
+	//
 
-		//
-		// A Bound Import Directory will cause process initialization to fail if we have rewritten
-		// anything. So we simply zero it out.
-		// Bound imports are a performance optimization, but basically we can't use it because
-		// the bound import addresses are dependent on the "real" function addresses within the
-		// imported DLL - and since we have replaced one or more imported DLLs, these pre-calculated
-		// function addresses are no longer valid, so we just have to delete it.
-		//
+	for (NumberOfProtectedWindows = 0;
+		 NumberOfProtectedWindows < Rewrite.NumberOfWindows;
+		 ++NumberOfProtectedWindows) {
 
-		BoundImportDirectory = &OptionalHeader->DataDirectory[IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT];
+		PVOID WindowAddress;
+		SIZE_T WindowSize;
 
-		DataDirectoryPtr = BoundImportDirectory;
-		DataDirectorySize = sizeof(IMAGE_DATA_DIRECTORY);
+		WindowAddress = RVA_TO_VA(ImageBase, Rewrite.Windows[NumberOfProtectedWindows].Rva);
+		WindowSize = Rewrite.Windows[NumberOfProtectedWindows].Size;
 
 		Status = NtProtectVirtualMemory(
 			NtCurrentProcess(),
-			&DataDirectoryPtr,
-			&DataDirectorySize,
+			&WindowAddress,
+			&WindowSize,
 			PAGE_READWRITE,
-			&OldProtect);
+			&OldProtect[NumberOfProtectedWindows]);
 
 		ASSERT (NT_SUCCESS(Status));
 
 		if (!NT_SUCCESS(Status)) {
-			return Status;
+			break;
 		}
+	}
 
-		// Zero it out.
-		RtlZeroMemory(BoundImportDirectory, sizeof(*BoundImportDirectory));
+	if (NT_SUCCESS(Status)) {
+		try {
+			//
+			// This writes directly into the import table of an image file, so
+			// that's why we put this code in a try-except block (in case some
+			// weirdly formatted DLL file lays things out in an unexpected way).
+			//
 
-		Status = NtProtectVirtualMemory(
+			KexpApplyImportRewrite(&Rewrite);
+		} except (GetExceptionCode() == STATUS_ACCESS_VIOLATION) {
+			Status = GetExceptionCode();
+
+			KexLogErrorEvent(
+				L"Failed to rewrite the imports of %wZ: STATUS_ACCESS_VIOLATION",
+				BaseImageName);
+
+			ASSERT (FALSE);
+		}
+	}
+
+	//
+	// Restore old permissions.
+	//
+
+	for (Index = 0; Index < NumberOfProtectedWindows; ++Index) {
+		NTSTATUS RestoreStatus;
+		PVOID WindowAddress;
+		SIZE_T WindowSize;
+
+		WindowAddress = RVA_TO_VA(ImageBase, Rewrite.Windows[Index].Rva);
+		WindowSize = Rewrite.Windows[Index].Size;
+
+		RestoreStatus = NtProtectVirtualMemory(
 			NtCurrentProcess(),
-			&DataDirectoryPtr,
-			&DataDirectorySize,
-			OldProtect,
-			&OldProtect);
+			&WindowAddress,
+			&WindowSize,
+			OldProtect[Index],
+			&OldProtect[Index]);
 
-		ASSERT (NT_SUCCESS(Status));
+		ASSERT (NT_SUCCESS(RestoreStatus));
 	}
 
-	return STATUS_SUCCESS;
+	return Status;
 }
 
 //
@@ -643,8 +443,6 @@ NTSTATUS KexRewriteDllPath(
 	// Validate parameters.
 	//
 
-	ASSERT (DllRewriteStringMapper != NULL);
-
 	ASSERT (VALID_UNICODE_STRING(DllPath));
 	ASSERT (DllPath->Length != 0);
 	ASSERT (DllPath->Buffer != NULL);
@@ -6,7 +6,9 @@
 //
 // Abstract:
 //
-//     Contains the exception filter for general protected functions in KexDll.
+//     Contains the exception filter for general protected functions in KexDll,
+//     and the exception handler which writes out buffered log entries when
+//     the application crashes.
 //
 // Author:
 //
@@ -17,6 +19,8 @@
 //     vxiiduu              30-Oct-2022  Initial creation.
 //     vxiiduu              23-Feb-2024  VxlWriteLogEx is no longer a protected
 //                                       function - remove extra SEH wrapping
+//     agent                17-Oct-2026  Flush buffered log entries.
+//     agent                18-Oct-2026  Flush them on any serious exception.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -80,5 +84,60 @@ ULONG KexDllProtectedFunctionExceptionFilter(
 			ExceptionRecord->ExceptionAddress);
 	}
 
+	// The process may be about to go down. Make sure the entries logged
+	// so far actually reach the log file.
+	VxlFlushLog(KexData->LogHandle);
+
 	return EXCEPTION_EXECUTE_HANDLER;
+}
+
+//
+// Called for every exception in the process, before any frame-based
+// handler. When the log is buffered, write out what has been buffered so far
+// in case the exception is about to end the process. Nothing is handled here.
+//
+STATIC LONG NTAPI KexpLogFlushExceptionHandler(
+	IN	PEXCEPTION_POINTERS	ExceptionPointers)
+{
+	STATIC LONG VOLATILE Flushing = FALSE;
+	NTSTATUS ExceptionCode;
+
+	ExceptionCode = ExceptionPointers->ExceptionRecord->ExceptionCode;
+
+	//
+	// Only look at system error codes. This leaves out breakpoints, guard
+	// pages, debug output and application-defined codes such as C++
+	// exceptions, which a lot of programs throw and catch all the time.
+	//
+
+	if ((ExceptionCode & 0xF0000000) != 0xC0000000) {
+		return EXCEPTION_CONTINUE_SEARCH;
+	}
+
+	// An exception while flushing mustn't start another flush.
+	if (InterlockedCompareExchange(&Flushing, TRUE, FALSE) == FALSE) {
+		VxlpFlushLogNoWait(KexData->LogHandle);
+		InterlockedExchange(&Flushing, FALSE);
+	}
+
+	return EXCEPTION_CONTINUE_SEARCH;
+}
+
+//
+// Make sure that buffered log entries aren't lost when the application
+// crashes. There is nothing to do when the log isn't buffered, since every
+// entry is already in the file by the time VxlWriteLog returns.
+//
+VOID KexInstallLogFlushExceptionHandler(
+	VOID)
+{
+	VXLHANDLE LogHandle;
+
+	LogHandle = KexData->LogHandle;
+
+	if (!LogHandle || (!LogHandle->AsyncContext && !LogHandle->BlockContext)) {
+		return;
+	}
+
+	RtlAddVectoredExceptionHandler(TRUE, KexpLogFlushExceptionHandler);
 }
\ No newline at end of file
@@ -19,6 +19,13 @@
 //     vxiiduu              06-Nov-2022  Add IFEO parameter reading.
 //     vxiiduu              07-Nov-2022  Remove spurious range check.
 //     vxiiduu              23-Feb-2024  Add setting to disable logging.
+//     agent                17-Oct-2026  Add log severity threshold setting.
+//     agent                17-Oct-2026  Add log retention settings.
+//     agent                17-Oct-2026  Add session log setting.
+//     agent                17-Oct-2026  Add asynchronous log write setting.
+//     agent                17-Oct-2026  Add log compression setting.
+//     agent                18-Oct-2026  Add mapped log write setting.
+//     agent                18-Oct-2026  Add deferred log formatting setting.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -48,6 +55,16 @@ KEX_PROCESS_DATA _KexData = {
 	NULL,														// BaseNamedObjects
 	NULL,														// UntrustedBaseNamedObjects
 	NULL,														// KsecDD
+	LogSeverityDebug,											// LogSeverityThreshold
+	0,															// LogMaximumTotalMegabytes
+	0,															// LogMaximumFilesPerImage
+	0,															// LogMaximumAgeDays
+	0,															// LogRingFilesPerImage
+	0,															// LogSessionMode
+	0,															// LogAsynchronousWrite
+	0,															// LogCompressed
+	0,															// LogMappedWrite
+	0,															// LogDeferredFormatting
 };
 
 PKEX_PROCESS_DATA KexData = NULL;
@@ -84,6 +101,16 @@ STATIC NTSTATUS KexpInitializeGlobalConfig(
 	ULONG QueryTableNumberOfElements;
 	KEX_RTL_QUERY_KEY_MULTIPLE_VARIABLE_TABLE_ENTRY QueryTable[] = {
 		{RTL_CONSTANT_STRING(L"EnableLogging"), 0, 8, &EnableLogging, REG_RESTRICT_DWORD, 0},
+		GENERATE_QKMV_TABLE_ENTRY					(LogSeverityThreshold, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogMaximumTotalMegabytes, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogMaximumFilesPerImage, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogMaximumAgeDays, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogRingFilesPerImage, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogSessionMode, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogAsynchronousWrite, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogCompressed, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogMappedWrite, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogDeferredFormatting, REG_RESTRICT_DWORD),
 		GENERATE_QKMV_TABLE_ENTRY_UNICODE_STRING	(KexDir),
 		GENERATE_QKMV_TABLE_ENTRY_UNICODE_STRING	(LogDir)
 	};
@@ -149,6 +176,16 @@ STATIC NTSTATUS KexpInitializeLocalConfig(
 	ULONG QueryTableNumberOfElements;
 	KEX_RTL_QUERY_KEY_MULTIPLE_VARIABLE_TABLE_ENTRY QueryTable[] = {
 		{RTL_CONSTANT_STRING(L"EnableLogging"), 0, 8, &EnableLogging, REG_RESTRICT_DWORD, 0},
+		GENERATE_QKMV_TABLE_ENTRY					(LogSeverityThreshold, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogMaximumTotalMegabytes, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogMaximumFilesPerImage, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogMaximumAgeDays, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogRingFilesPerImage, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogSessionMode, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogAsynchronousWrite, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogCompressed, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogMappedWrite, REG_RESTRICT_DWORD),
+		GENERATE_QKMV_TABLE_ENTRY					(LogDeferredFormatting, REG_RESTRICT_DWORD),
 		GENERATE_QKMV_TABLE_ENTRY_UNICODE_STRING	(LogDir)
 	};
 
@@ -345,6 +382,11 @@ KEXAPI NTSTATUS NTAPI KexDataInitialize(
 	KexpInitializeGlobalConfig();
 	KexpInitializeLocalConfig();
 
+	if ((ULONG) _KexData.LogSeverityThreshold >= LogSeverityMaximumValue) {
+		// Garbage in the registry. Log everything, as if it wasn't there.
+		_KexData.LogSeverityThreshold = LogSeverityDebug;
+	}
+
 	//
 	// Assemble Kex3264Dir
 	//
@@ -66,6 +66,9 @@ ULONG KexDllProtectedFunctionExceptionFilter(
 	IN	NTSTATUS			ExceptionCode,
 	IN	PEXCEPTION_POINTERS	ExceptionPointers);
 
+VOID KexInstallLogFlushExceptionHandler(
+	VOID);
+
 #if DISABLE_PROTECTED_FUNCTION == FALSE
 #  define PROTECTED_FUNCTION { try
 
@@ -144,13 +147,6 @@ NTSTATUS KexRewriteDllPath(
 	IN	PCUNICODE_STRING	DllPath,
 	OUT	PUNICODE_STRING		RewrittenDllNameOut);
 
-NTSTATUS KexAddDllRewriteEntry(
-	IN	PCUNICODE_STRING	DllName,
-	IN	PCUNICODE_STRING	RewrittenDllName);
-
-NTSTATUS KexRemoveDllRewriteEntry(
-	IN	PCUNICODE_STRING	DllName);
-
 //
 // kexdata.c
 //
@@ -179,6 +175,43 @@ NORETURN VOID KexHeErrorBox(
 NTSTATUS KexOpenVxlLogForCurrentApplication(
 	OUT	PVXLHANDLE	LogHandle);
 
+//
+// logrot.c
+//
+
+BOOLEAN KexpIsLogRetentionPolicyEnabled(
+	VOID);
+
+NTSTATUS KexpApplyLogRetentionPolicy(
+	IN		HANDLE			LogDirHandle,
+	IN OUT	PUNICODE_STRING	LogFileName);
+
+VOID KexpFinalizeLogRetentionPolicy(
+	VOID);
+
+//
+// rwengine.c
+//
+
+#include "rwengine.h"
+
+//
+// rwplan.c
+//
+
+NTSTATUS KexpOpenRewritePlanCache(
+	IN	ULONG	TableVersion);
+
+BOOLEAN KexpLookupRewritePlan(
+	IN		PCUNICODE_STRING		FullImageName,
+	IN		PIMAGE_NT_HEADERS		NtHeaders,
+	IN OUT	PKEX_IMPORT_REWRITE		Rewrite);
+
+VOID KexpStoreRewritePlan(
+	IN	PCUNICODE_STRING		FullImageName,
+	IN	PIMAGE_NT_HEADERS		NtHeaders,
+	IN	PCKEX_IMPORT_REWRITE	Rewrite);
+
 //
 // rtlrng.c
 //
@@ -193,6 +226,346 @@ NTSTATUS KexRtlInitializeRandomNumberGenerator(
 VOID KexApplyVersionSpoof(
 	VOID);
 
+//
+// vxlasync.c
+//
+
+#define VXL_ASYNC_RING_COUNT			8
+#define VXL_ASYNC_RING_SIZE				0x8000		// must be a power of 2
+#define VXL_ASYNC_BATCH_SIZE			0x10000
+#define VXL_ASYNC_MAXIMUM_RECORD_SIZE	(VXL_ASYNC_RING_SIZE / 4)
+#define VXL_ASYNC_FLUSH_INTERVAL		250			// milliseconds
+
+typedef struct _VXLASYNCRING {
+	// Head and Tail are free-running byte offsets. They are only reduced
+	// modulo VXL_ASYNC_RING_SIZE when indexing into Buffer.
+	ULONG VOLATILE			Head;
+	ULONG VOLATILE			Tail;
+	PBYTE					Buffer;
+} TYPEDEF_TYPE_NAME(VXLASYNCRING);
+
+typedef struct _VXLASYNCCONTEXT {
+	RTL_SRWLOCK				FlushLock;
+	HANDLE					FlusherThread;
+	HANDLE					WakeEvent;
+	BOOLEAN VOLATILE		ShutdownRequested;
+	PBYTE					BatchBuffer;			// only touched while FlushLock is held
+	VXLASYNCRING			Rings[VXL_ASYNC_RING_COUNT];
+} TYPEDEF_TYPE_NAME(VXLASYNCCONTEXT);
+
+NTSTATUS VxlpCreateAsyncContext(
+	IN	VXLHANDLE			LogHandle);
+
+VOID VxlpDestroyAsyncContext(
+	IN	VXLHANDLE			LogHandle);
+
+VOID VxlpFlushLogNoWait(
+	IN	VXLHANDLE			LogHandle);
+
+NTSTATUS VxlpAsyncWriteLogFileEntry(
+	IN	VXLHANDLE			LogHandle,
+	IN	PCVXLLOGFILEENTRY	FileEntry,
+	IN	ULONG				FileEntryCb);
+
+//
+// vxlmap.c
+//
+
+#define VXL_MAP_GROWTH_INCREMENT		0x100000	// 1MB
+#define VXL_MAP_VIEW_ALIGNMENT			0x10000		// allocation granularity
+#define VXL_MAP_COMMIT_TIMEOUT			10000		// ms without any writer committing
+#define VXL_MAP_BACKOFF_INTERVAL		1			// ms to sleep while waiting for a writer
+
+typedef struct _VXLMAPCONTEXT {
+	// Held shared while copying into the window, and exclusive while the
+	// window is being moved or the file is being grown.
+	RTL_SRWLOCK				WindowLock;
+	HANDLE					SectionHandle;
+	PBYTE					Window;
+	ULONGLONG				WindowOffset;			// file offset of Window[0]
+	ULONGLONG				WindowEnd;				// also the allocated length of the file
+	LONGLONG VOLATILE		ReservedLength;
+	LONGLONG VOLATILE		CommittedLength;
+	LONG VOLATILE			Failed;					// nothing more can be committed
+} TYPEDEF_TYPE_NAME(VXLMAPCONTEXT);
+
+NTSTATUS VxlpCreateMapContext(
+	IN	VXLHANDLE			LogHandle);
+
+VOID VxlpDestroyMapContext(
+	IN	VXLHANDLE			LogHandle);
+
+NTSTATUS VxlpMappedAppendLogFileEntries(
+	IN	VXLHANDLE			LogHandle,
+	IN	PCVOID				Buffer,
+	IN	ULONG				BufferCb,
+	IN	PCULONG				SeverityCounts);
+
+//
+// vxlcomp.c
+//
+
+#include "vxlcomp.h"
+
+//
+// strsrch.c
+//
+
+#include "strsrch.h"
+
+//
+// vxltime.c
+//
+
+#include "vxltime.h"
+
+//
+// vxlfmt.c
+//
+
+#include "vxlfmt.h"
+
+//
+// vxlblock.c
+//
+
+#define VXL_BLOCK_MAXIMUM_AGE			2000		// ms before the flusher writes out a partly filled block
+
+typedef struct _VXLBLOCKCONTEXT {
+	RTL_SRWLOCK				Lock;
+	ULONG					BufferCb;
+	ULONG					EntryCount;
+	LONGLONG				FirstEntryTime;			// when the first entry went into the current block
+	ULONG					SeverityCounts[LogSeverityMaximumValue];
+	BYTE					Buffer[VXL_BLOCK_SIZE];		// entries in the current block
+	BYTE					WorkSpace[VXL_COMPRESS_WORKSPACE_SIZE];
+	BYTE					RecordBuffer[sizeof(VXLLOGFILEBLOCK) + VXL_BLOCK_SIZE + 1];
+} TYPEDEF_TYPE_NAME(VXLBLOCKCONTEXT);
+
+NTSTATUS VxlpCreateBlockContext(
+	IN	VXLHANDLE			LogHandle);
+
+VOID VxlpDestroyBlockContext(
+	IN	VXLHANDLE			LogHandle);
+
+NTSTATUS VxlpFlushBlock(
+	IN	VXLHANDLE			LogHandle);
+
+VOID VxlpTryFlushBlock(
+	IN	VXLHANDLE			LogHandle);
+
+NTSTATUS VxlpFlushOldBlock(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONG				MaximumAge);
+
+NTSTATUS VxlpBlockAppendLogFileEntries(
+	IN	VXLHANDLE			LogHandle,
+	IN	PCVOID				Buffer,
+	IN	ULONG				BufferCb);
+
+NTSTATUS VxlpAddBlockToIndex(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONG				FileOffset,
+	IN	ULONG				FirstEntryIndex,
+	IN	ULONG				EntryCount);
+
+NTSTATUS VxlpGetLogFileEntry(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONG				EntryIndex,
+	OUT	PPVOID				FileEntry);
+
+VOID VxlpGetLogFileEntries(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONG				FirstEntryIndex,
+	IN	ULONG				NumberOfEntries,
+	OUT	PVOID				FileEntries[]);
+
+VOID VxlpFreeBlockIndex(
+	IN	VXLHANDLE			LogHandle);
+
+//
+// vxlindex.c
+//
+
+#define VXL_INDEX_CHUNK_SIZE				0x1000		// entries indexed at a time
+#define VXL_INDEX_FILE_MINIMUM_ENTRIES		0x10000		// smaller logs don't get a .vxli file
+
+#define VXLI_VERSION						1
+
+//
+// A .vxli file sits next to a log file and lets it be opened for reading
+// without scanning it. It is only used if the log has not changed since the
+// .vxli file was written. The header is followed by:
+//
+//   ULONG				EntryOffsets[NumberOfEntries];
+//   VXLINDEXFILEBLOCK	Blocks[NumberOfBlocks];
+//   ULONG				StringOffsets[sum of NumberOfStrings];
+//
+// String offsets are grouped by source type and sorted by index.
+//
+
+typedef struct _VXLINDEXFILEHEADER {
+	CHAR					Magic[4];				// VXLI
+	ULONG					Version;				// VXLI_VERSION
+	ULONGLONG				LogCommittedLength;
+	LONGLONG				LogLastWriteTime;
+	ULONG					NumberOfEntries;
+	ULONG					NumberOfBlocks;
+	ULONG					NumberOfStrings[VxlSourceMaximum];
+	ULONG					Flags;					// none defined, written as zero
+	ULONG					Reserved;
+} TYPEDEF_TYPE_NAME(VXLINDEXFILEHEADER);
+
+typedef struct _VXLINDEXFILEBLOCK {
+	ULONG					FileOffset;
+	ULONG					FirstEntryIndex;
+	ULONG					EntryCount;
+} TYPEDEF_TYPE_NAME(VXLINDEXFILEBLOCK);
+
+typedef struct _VXLINDEXCONTEXT {
+	ULONG VOLATILE			NumberOfEntries;		// entries visible to the reader
+	ULONG VOLATILE			NumberOfIndexedEntries;
+	ULONG					NumberOfCommittedEntries;
+	ULONG					NumberOfReservedEntries;
+	ULONG					NumberOfUncheckedEntries;	// offsets taken from a .vxli file
+	ULONGLONG				CommittedLength;		// of the log, when it was last looked at
+	ULONGLONG				ScanOffset;				// next record to look at
+	NTSTATUS				ScanStatus;				// why the scan stopped early
+	BOOLEAN VOLATILE		Complete;
+	BOOLEAN VOLATILE		ShutdownRequested;
+	HANDLE					IndexerThread;
+	PVOID					IndexFileView;			// EntryIndexToFileOffset points in here
+} TYPEDEF_TYPE_NAME(VXLINDEXCONTEXT);
+
+NTSTATUS VxlpGetLogFileName(
+	IN	VXLHANDLE			LogHandle,
+	OUT	PUNICODE_STRING		FileName);
+
+NTSTATUS VxlpQueryLogLastWriteTime(
+	IN	VXLHANDLE			LogHandle,
+	OUT	PLONGLONG			LastWriteTime);
+
+NTSTATUS VxlpCreateIndexContext(
+	IN	VXLHANDLE			LogHandle);
+
+VOID VxlpDestroyIndexContext(
+	IN	VXLHANDLE			LogHandle);
+
+NTSTATUS VxlpEnsureEntryIndexed(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONG				EntryIndex);
+
+NTSTATUS VxlpCompleteIndex(
+	IN	VXLHANDLE			LogHandle);
+
+NTSTATUS VxlpIndexNewRecords(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONGLONG			CommittedLength,
+	IN	ULONG				MaximumNumberOfEntries);
+
+//
+// vxltext.c
+//
+
+#define VXL_TEXT_INDEX_MINIMUM_ENTRIES		0x10000		// smaller logs are quick enough to search
+#define VXL_TEXT_INDEX_BUCKET_BITS			18
+#define VXL_TEXT_INDEX_NUMBER_OF_BUCKETS	(1UL << VXL_TEXT_INDEX_BUCKET_BITS)
+#define VXL_TEXT_INDEX_MAXIMUM_TRIGRAMS		32			// looked up per query
+
+#define VXLT_VERSION						1
+
+//
+// A .vxlt file sits next to a log file and lists, for every trigram (three
+// characters in a row, folded to upper case) in the text of the log, which
+// entries contain it. Trigrams are hashed into a fixed number of buckets,
+// so a bucket may list entries which only contain a different trigram with
+// the same hash. The header is followed by:
+//
+//   ULONG				BucketOffsets[NumberOfBuckets + 1];
+//   BYTE				Postings[PostingsCb];
+//
+// The postings of bucket N are the bytes from BucketOffsets[N] up to
+// BucketOffsets[N + 1]. They are entry indices in increasing order, each
+// stored as the distance from the previous one (the first one as its index
+// plus one) in 7-bit groups, least significant first, with the high bit set
+// on all but the last byte.
+//
+// The same layout is used in memory when the index can't be saved.
+//
+
+typedef struct _VXLTEXTINDEXHEADER {
+	CHAR					Magic[4];				// VXLT
+	ULONG					Version;				// VXLT_VERSION
+	ULONGLONG				LogCommittedLength;
+	LONGLONG				LogLastWriteTime;
+	ULONG					NumberOfEntries;
+	ULONG					NumberOfBuckets;
+	ULONG					PostingsCb;
+	ULONG					Reserved;
+} TYPEDEF_TYPE_NAME(VXLTEXTINDEXHEADER);
+
+typedef struct _VXLTEXTINDEXCONTEXT {
+	PCVXLTEXTINDEXHEADER VOLATILE	TextIndex;		// NULL until it has been built or loaded
+	BOOLEAN							Mapped;			// TextIndex is a view of a .vxlt file
+	NTSTATUS VOLATILE				BuildStatus;	// why there is no index
+	BOOLEAN VOLATILE				ShutdownRequested;
+	HANDLE							BuilderThread;
+} TYPEDEF_TYPE_NAME(VXLTEXTINDEXCONTEXT);
+
+NTSTATUS VxlpCreateTextIndexContext(
+	IN	VXLHANDLE			LogHandle);
+
+VOID VxlpDestroyTextIndexContext(
+	IN	VXLHANDLE			LogHandle);
+
+//
+// vxltail.c
+//
+
+#define VXL_FOLLOW_POLL_INTERVAL			250			// ms
+
+typedef struct _VXLFOLLOWCONTEXT {
+	SIZE_T					MappedLength;			// size of the current view of the log
+	PVOID					*RetiredViews;			// older views, kept until the log is closed
+	ULONG					NumberOfRetiredViews;
+
+	HANDLE					DirectoryHandle;		// directory the log is in
+	HANDLE					ChangeEvent;			// set when something in it changes
+	LONG VOLATILE			NotificationPending;
+	IO_STATUS_BLOCK			IoStatusBlock;
+	ULONG					NotifyBuffer[64];
+} TYPEDEF_TYPE_NAME(VXLFOLLOWCONTEXT);
+
+NTSTATUS VxlpCreateFollowContext(
+	IN	VXLHANDLE			LogHandle,
+	IN	SIZE_T				MappedLength);
+
+VOID VxlpDestroyFollowContext(
+	IN	VXLHANDLE			LogHandle);
+
+//
+// vxlmerge.c
+//
+
+#define VXL_MERGE_WINDOW_SIZE		64			// timestamps looked up from a log at a time
+
+typedef struct _VXLMERGECURSOR {
+	VXLHANDLE				LogHandle;
+	ULONG					NumberOfEntries;		// when the stream was created
+	ULONG					WindowEntryIndex;		// index of the entry whose time is in Times[0]
+	ULONG					WindowCount;
+	ULONG					WindowPosition;			// next entry of this log to be returned
+	LONGLONG				LastTime;				// used for entries which can't be read
+	LONGLONG				Times[VXL_MERGE_WINDOW_SIZE];
+} TYPEDEF_TYPE_NAME(VXLMERGECURSOR);
+
+typedef struct _VXLMERGECONTEXT {
+	ULONG					NumberOfLogs;
+	ULONG					HeapSize;				// number of logs which have entries left
+	PULONG					Heap;					// log indices, ordered by the time of their next entry
+	VXLMERGECURSOR			Cursors[ANYSIZE_ARRAY];
+} TYPEDEF_TYPE_NAME(VXLMERGECONTEXT);
+
 //
 // vxlpriv.c
 //
@@ -203,21 +576,218 @@ NTSTATUS VxlpFlushLogFileHeader(
 ULONG VxlpGetTotalLogEntryCount(
 	IN	VXLHANDLE			LogHandle);
 
-NTSTATUS VxlpFindOrCreateSourceComponentIndex(
+ULONG VxlpGetLogFileHeaderSize(
+	IN	PCVXLLOGFILEHEADER	Header);
+
+ULONG VxlpSizeOfLogFileEntryV1(
+	IN	PCVXLLOGFILEENTRY_V1	Entry);
+
+BOOLEAN VxlpIsValidLogEntryRecord(
+	IN	PCVXLLOGFILERECORD	Record);
+
+NTSTATUS VxlpIndexRecords(
+	IN		VXLHANDLE			LogHandle,
+	IN OUT	PULONGLONG			Offset,
+	IN OUT	PULONG				Index,
+	IN		ULONG				StopIndex,
+	IN		ULONG				TotalLogEntryCount,
+	IN		ULONGLONG			EndOfData);
+
+NTSTATUS VxlpBuildIndex(
+	IN	VXLHANDLE			LogHandle);
+
+VOID VxlpSplitLogText(
+	IN OUT	PWSTR			Text,
+	IN OUT	PULONG			TextCch,
+	OUT		PULONG			TextHeaderCch,
+	OUT		PULONG			TextBodyCch);
+
+//
+// vxlsess.c
+//
+
+#define VXL_SESSION_LOCK_TIMEOUT		5000		// ms before giving up on the session
+
+typedef struct _VXLSESSIONDATA {
+	LONG VOLATILE			NumberOfWriters;		// processes which have the log open
+} TYPEDEF_TYPE_NAME(VXLSESSIONDATA);
+
+typedef struct _VXLSESSIONCONTEXT {
+	HANDLE					MutantHandle;
+	HANDLE					SectionHandle;
+	PVXLSESSIONDATA			Data;					// view of SectionHandle
+	ULONGLONG				ScannedLength;			// strings defined before here are loaded
+	BOOLEAN					Owner;					// created the session
+	LONG VOLATILE			Detached;				// gave up waiting for the session lock
+	LONG VOLATILE			PrivateLogOpened;		// tried to open PrivateLog
+	VXLHANDLE VOLATILE		PrivateLog;				// written to instead, once detached
+} TYPEDEF_TYPE_NAME(VXLSESSIONCONTEXT);
+
+NTSTATUS VxlpCreateSessionContext(
 	IN	VXLHANDLE			LogHandle,
-	IN	PCWSTR				SourceComponent,
-	OUT	PUCHAR				SourceComponentIndex);
+	IN	PCVXLSESSIONHANDLES	SessionHandles OPTIONAL);
+
+VOID VxlpDestroySessionContext(
+	IN	VXLHANDLE			LogHandle);
 
-NTSTATUS VxlpFindOrCreateSourceFileIndex(
+NTSTATUS VxlpAcquireSessionLock(
+	IN	VXLHANDLE			LogHandle);
+
+VOID VxlpReleaseSessionLock(
+	IN	VXLHANDLE			LogHandle);
+
+BOOLEAN VxlpLeaveSession(
+	IN	VXLHANDLE			LogHandle);
+
+VXLHANDLE VxlpGetSessionPrivateLog(
+	IN	VXLHANDLE			LogHandle);
+
+NTSTATUS VxlpLoadSessionSourceStrings(
+	IN	VXLHANDLE			LogHandle);
+
+//
+// vxlsrc.c
+//
+
+#define VXL_STRING_TABLE_PAGE_SIZE		256
+#define VXL_CALL_SITE_CACHE_SIZE		256			// must be a power of 2
+
+//
+// Strings are stored in fixed size pages which are never moved or freed
+// while the log is open, so that a string can be looked up by index without
+// holding the lock.
+//
+
+typedef struct _VXLSTRINGTABLE {
+	ULONG VOLATILE			NumberOfStrings;
+	ULONG					MaximumNumberOfStrings;
+	ULONG					NumberOfBuckets;		// power of 2, or 0 if no hash index
+	PUSHORT					Buckets;				// string index + 1, or 0 if empty
+	PCWSTR					*Pages[0x10000 / VXL_STRING_TABLE_PAGE_SIZE];
+} TYPEDEF_TYPE_NAME(VXLSTRINGTABLE);
+
+//
+// Remembers which indices a particular call site (identified by the
+// address of its __FUNCTIONW__ string) resolved to last time.
+//
+
+typedef struct _VXLCALLSITE {
+	PCWSTR VOLATILE			SourceFunction;
+	USHORT VOLATILE			SourceComponentIndex;
+	USHORT VOLATILE			SourceFileIndex;
+	USHORT VOLATILE			SourceFunctionIndex;
+} TYPEDEF_TYPE_NAME(VXLCALLSITE);
+
+typedef struct _VXLFORMATCACHEENTRY {
+	PCWSTR VOLATILE			Format;
+	USHORT VOLATILE			FormatIndex;
+} TYPEDEF_TYPE_NAME(VXLFORMATCACHEENTRY);
+
+typedef struct _VXLSOURCETABLES {
+	RTL_SRWLOCK				Lock;					// held exclusive when adding strings
+	BOOLEAN					OwnsStrings;			// TRUE in write mode
+	VXLSTRINGTABLE			Tables[VxlSourceMaximum];
+	VXLCALLSITE				CallSiteCache[VXL_CALL_SITE_CACHE_SIZE];
+	VXLFORMATCACHEENTRY		FormatCache[VXL_CALL_SITE_CACHE_SIZE];
+} TYPEDEF_TYPE_NAME(VXLSOURCETABLES);
+
+NTSTATUS VxlpCreateSourceTables(
+	IN	VXLHANDLE			LogHandle);
+
+VOID VxlpDestroySourceTables(
+	IN	VXLHANDLE			LogHandle);
+
+NTSTATUS VxlpAddSourceString(
 	IN	VXLHANDLE			LogHandle,
-	IN	PCWSTR				SourceFile,
-	OUT	PUCHAR				SourceFileIndex);
+	IN	VXLSOURCETYPE		SourceType,
+	IN	ULONG				Index,
+	IN	PCWSTR				String);
+
+NTSTATUS VxlpLoadSourceStrings(
+	IN	VXLHANDLE			LogHandle,
+	IN	PCVOID				FileData,
+	IN	ULONGLONG			FileDataOffset,
+	IN	ULONGLONG			StartOffset,
+	IN	ULONGLONG			EndOffset);
 
-NTSTATUS VxlpFindOrCreateSourceFunctionIndex(
+NTSTATUS VxlpFindOrCreateSourceIndices(
 	IN	VXLHANDLE			LogHandle,
+	IN	PCWSTR				SourceComponent,
+	IN	PCWSTR				SourceFile,
 	IN	PCWSTR				SourceFunction,
-	OUT	PUCHAR				SourceFunctionIndex);
+	OUT	PVXLLOGFILEENTRY	FileEntry);
 
-NTSTATUS VxlpBuildIndex(
+NTSTATUS VxlpFindOrCreateFormatIndex(
+	IN	VXLHANDLE			LogHandle,
+	IN	PCWSTR				Format,
+	OUT	PUSHORT				FormatIndex);
+
+//
+// vxldefer.c
+//
+
+#define VXL_DEFERRED_MAXIMUM_ARGUMENTS	32
+#define VXL_FORMATTED_TEXT_CACHE_SIZE	256			// entries, for VxlReadLog
+
+typedef struct _VXLFORMATTEDTEXT {
+	ULONG					LogEntryIndex;
+	ULONG					TextHeaderCch;
+	ULONG					TextCch;
+	WCHAR					Text[];
+} TYPEDEF_TYPE_NAME(VXLFORMATTEDTEXT);
+
+// Protected by the lock of the log handle.
+typedef struct _VXLFORMATTEDTEXTCACHE {
+	ULONG					NextSlot;
+	PVXLFORMATTEDTEXT		Slots[VXL_FORMATTED_TEXT_CACHE_SIZE];
+} TYPEDEF_TYPE_NAME(VXLFORMATTEDTEXTCACHE);
+
+NTSTATUS VxlpWriteDeferredLogEntry(
+	IN	VXLHANDLE			LogHandle,
+	IN	PCWSTR				SourceComponent,
+	IN	PCWSTR				SourceFile,
+	IN	ULONG				SourceLine,
+	IN	PCWSTR				SourceFunction,
+	IN	VXLSEVERITY			Severity,
+	IN	PCWSTR				Format,
+	IN	ARGLIST				ArgList);
+
+NTSTATUS VxlpGetDeferredLogEntryText(
+	IN	VXLHANDLE					LogHandle,
+	IN	PCVXLLOGFILEDEFERREDENTRY	FileEntry,
+	OUT	PWSTR						Buffer,
+	IN	ULONG						BufferCch,
+	OUT	PULONG						TextHeaderCch,
+	OUT	PULONG						TextCch);
+
+NTSTATUS VxlpGetCachedDeferredLogEntryText(
+	IN	VXLHANDLE					LogHandle,
+	IN	ULONG						LogEntryIndex,
+	IN	PCVXLLOGFILEDEFERREDENTRY	FileEntry,
+	OUT	PPCVXLFORMATTEDTEXT			FormattedText);
+
+VOID VxlpFreeFormattedTextCache(
 	IN	VXLHANDLE			LogHandle);
 
+//
+// vxlwrite.c
+//
+
+NTSTATUS VxlpWriteLogFileEntry(
+	IN	VXLHANDLE			LogHandle,
+	IN	PCVOID				FileEntry,
+	IN	ULONG				FileEntryCb,
+	IN	VXLSEVERITY			Severity);
+
+NTSTATUS VxlpAppendLogFileEntries(
+	IN	VXLHANDLE			LogHandle,
+	IN	PCVOID				Buffer,
+	IN	ULONG				BufferCb,
+	IN	PCULONG				SeverityCounts);
+
+NTSTATUS VxlpAppendLogFileRecords(
+	IN	VXLHANDLE			LogHandle,
+	IN	PCVOID				Buffer,
+	IN	ULONG				BufferCb,
+	IN	PCULONG				SeverityCounts);
+
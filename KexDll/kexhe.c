@@ -28,6 +28,7 @@
 //     vxiiduu              06-Nov-2022  KEXDLL init failure message now works
 //                                       even if KexSrv is not running.
 //     vxiiduu              05-Jan-2023  Convert to user friendly NTSTATUS.
+//     agent                17-Oct-2026  Flush buffered log entries.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -109,6 +110,9 @@ NTSTATUS NTAPI Ext_NtRaiseHardError(
 		StringParameter1,
 		StringParameter2);
 
+	// Hard errors are frequently followed by process termination.
+	VxlFlushLog(KexData->LogHandle);
+
 	//
 	// call original NtRaiseHardError
 	//
@@ -194,5 +198,6 @@ NORETURN VOID KexHeErrorBox(
 	IN	PCWSTR	ErrorMessage)
 {
 	KexMessageBox(MB_ICONERROR, L"Application Error (VxKex)", ErrorMessage);
+	VxlFlushLog(KexData->LogHandle);
 	NtTerminateProcess(NtCurrentProcess(), STATUS_KEXDLL_INITIALIZATION_FAILURE);
 }
\ No newline at end of file
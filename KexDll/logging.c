@@ -19,6 +19,16 @@
 // Revision History:
 //
 //     vxiiduu              23-Feb-2024  Initial creation.
+//     agent                17-Oct-2026  Open the log in asynchronous mode.
+//     agent                17-Oct-2026  Open the log in mapped mode.
+//     agent                17-Oct-2026  Use deferred formatting.
+//     agent                17-Oct-2026  Compress the log.
+//     agent                17-Oct-2026  Apply the log retention policy.
+//     agent                17-Oct-2026  Join or open session logs.
+//     agent                17-Oct-2026  Make asynchronous writing opt-in.
+//     agent                17-Oct-2026  Make compression opt-in.
+//     agent                18-Oct-2026  Make mapped writing opt-in.
+//     agent                18-Oct-2026  Make deferred formatting opt-in.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -36,6 +46,8 @@ NTSTATUS KexOpenVxlLogForCurrentApplication(
 	HANDLE LogDirHandle;
 	OBJECT_ATTRIBUTES ObjectAttributes;
 	USHORT TemporaryLength;
+	PKEX_PROPAGATED_DATA PropagatedData;
+	ULONG OpenFlags;
 
 	ASSERT (LogHandle != NULL);
 	ASSERT (KexData != NULL);
@@ -47,6 +59,67 @@ NTSTATUS KexOpenVxlLogForCurrentApplication(
 		return STATUS_USER_DISABLED;
 	}
 
+	//
+	// Asynchronous writing is only turned on when the user asks for it.
+	// Buffered entries are written out when the log is closed at process
+	// detach and when an exception is raised (see except.c), but a process
+	// which is ended with TerminateProcess loses whatever has not been
+	// flushed yet.
+	//
+	// The same goes for compression, which keeps the entries of the current
+	// block in memory until the block is full.
+	//
+	// Mapped writing grows the file in large chunks, and only VxlCloseLog
+	// trims it back. A process which is killed (which happens all the time
+	// to browser renderers) leaves a log of at least a megabyte behind, most
+	// of it zeroes, so that is opt-in too.
+	//
+	// Deferred entries can't be read by older versions of the log viewer,
+	// and their text has to be formatted again every time it is searched or
+	// exported, so they are only written when the user asks for them.
+	//
+
+	OpenFlags = 0;
+
+	if (KexData->LogDeferredFormatting) {
+		OpenFlags |= VXL_OPEN_DEFERRED_FORMATTING;
+	}
+
+	if (KexData->LogAsynchronousWrite) {
+		OpenFlags |= VXL_OPEN_ASYNCHRONOUS_WRITE;
+	}
+
+	if (KexData->LogCompressed) {
+		OpenFlags |= VXL_OPEN_COMPRESSED;
+	}
+
+	//
+	// If the parent process is writing a session log, it has given us
+	// handles to it. Join its session instead of creating a log file of our
+	// own. The handles belong to the log handle after this, so remove them
+	// from the inherited data.
+	//
+
+	PropagatedData = (PKEX_PROPAGATED_DATA) NtCurrentPeb()->SubSystemData;
+
+	if (PropagatedData && PropagatedData->SessionLog.FileHandle) {
+		VXLSESSIONHANDLES SessionHandles;
+
+		SessionHandles = PropagatedData->SessionLog;
+		RtlZeroMemory(&PropagatedData->SessionLog, sizeof(PropagatedData->SessionLog));
+
+		Status = VxlJoinSessionLog(
+			LogHandle,
+			&SessionHandles,
+			OpenFlags);
+
+		if (NT_SUCCESS(Status)) {
+			return Status;
+		}
+
+		// Fall back to a log file of our own.
+	}
+
 	Status = RtlDosPathNameToNtPathName_U_WithStatus(
 		KexData->LogDir.Buffer,
 		&LogDir,
@@ -111,6 +184,15 @@ NTSTATUS KexOpenVxlLogForCurrentApplication(
 
 		RtlAppendUnicodeToString(&LogFileName, L".vxl");
 
+		//
+		// Delete old log files if the user has set limits on them. In ring
+		// mode, this changes the log file name to one we can overwrite.
+		//
+
+		if (KexpIsLogRetentionPolicyEnabled()) {
+			KexpApplyLogRetentionPolicy(LogDirHandle, &LogFileName);
+		}
+
 		//
 		// Open the log file.
 		//
@@ -122,13 +204,40 @@ NTSTATUS KexOpenVxlLogForCurrentApplication(
 			LogDirHandle,
 			NULL);
 
+		//
+		// Session logs can't be written in mapped mode, since every process
+		// would need to reserve space at the end of the file.
+		//
+
+		if (KexData->LogSessionMode) {
+			OpenFlags |= VXL_OPEN_SESSION;
+		} else if (KexData->LogMappedWrite) {
+			OpenFlags |= VXL_OPEN_MAPPED_WRITE;
+		}
+
 		RtlInitConstantUnicodeString(&SourceApplication, L"VxKex");
-		Status = VxlOpenLog(
+		Status = VxlOpenLogEx(
 			LogHandle,
 			&SourceApplication,
 			&ObjectAttributes,
 			GENERIC_WRITE,
-			FILE_OVERWRITE_IF);
+			FILE_OVERWRITE_IF,
+			OpenFlags);
+
+		if (!NT_SUCCESS(Status) && Status != STATUS_ACCESS_DENIED) {
+			//
+			// Couldn't set up the buffers, the flusher thread or the mapped
+			// view. Plain synchronous logging is slower but still better than
+			// not logging at all.
+			//
+
+			Status = VxlOpenLog(
+				LogHandle,
+				&SourceApplication,
+				&ObjectAttributes,
+				GENERIC_WRITE,
+				FILE_OVERWRITE_IF);
+		}
 
 		// We can get STATUS_ACCESS_DENIED if running in a sandboxed Chromium process.
 		// This is normal and there's nothing wrong.
@@ -0,0 +1,874 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     logrot.c
+//
+// Abstract:
+//
+//     Log retention. Every process which runs under VxKex creates a new log
+//     file, so without some kind of limit the log directory grows forever.
+//     The user can configure the following limits (all 0 = disabled):
+//
+//       LogMaximumTotalMegabytes - total size of all log files
+//       LogMaximumFilesPerImage  - number of log files per program name
+//       LogMaximumAgeDays        - age of the oldest log file
+//       LogRingFilesPerImage     - instead of creating a new log file every
+//                                  time, reuse the same N files per program
+//
+//     The limits are enforced once, when the log file is opened. In order to
+//     avoid enumerating a log directory which may contain thousands of files
+//     on every process startup, we keep a small index file in the log
+//     directory (VxlIndex.dat) which lists the log files created under the
+//     retention policy, oldest first. The index is protected by a byte range
+//     lock, so processes starting at the same time don't trample on each
+//     other.
+//
+//     Log files which were created while no retention policy was configured
+//     are not in the index and are therefore never deleted automatically.
+//
+//     The .vxli and .vxlt files which the log viewer saves next to a log (see
+//     vxlindex.c and vxltext.c) belong to that log. They count towards the
+//     total size, and are deleted along with it.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Environment:
+//
+//     Open: during initialization.
+//     Finalize: during process detach.
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Handle .vxli and .vxlt files.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+
+#define KEX_LOG_INDEX_FILE_NAME			L"VxlIndex.dat"
+#define KEX_LOG_INDEX_SIGNATURE			'IXLV'
+#define KEX_LOG_INDEX_VERSION			1
+#define KEX_LOG_INDEX_MAXIMUM_ENTRIES	0x10000
+#define KEX_LOG_INDEX_FILE_NAME_CCH		128
+#define KEX_LOG_INDEX_NO_RING_SLOT		0xFFFFFFFF
+#define KEX_LOG_MAXIMUM_RING_FILES		64
+#define KEX_LOG_SIDECAR_SUFFIXES		L"it"		// .vxli and .vxlt
+
+typedef struct _KEX_LOG_INDEX_HEADER {
+	ULONG		Signature;					// KEX_LOG_INDEX_SIGNATURE
+	ULONG		Version;					// KEX_LOG_INDEX_VERSION
+	ULONG		NumberOfEntries;
+	ULONG		Reserved;
+} TYPEDEF_TYPE_NAME(KEX_LOG_INDEX_HEADER);
+
+typedef struct _KEX_LOG_INDEX_ENTRY {
+	ULONGLONG	CreationTime;				// system time
+	ULONGLONG	FileSize;					// 0 if not known yet
+	ULONG		ImageNameHash;				// RtlHashUnicodeString of image base name
+	ULONG		ProcessId;					// 0 once the log has been closed
+	ULONG		RingSlot;					// or KEX_LOG_INDEX_NO_RING_SLOT
+	ULONG		Reserved;
+	WCHAR		FileName[KEX_LOG_INDEX_FILE_NAME_CCH];	// empty = removed
+} TYPEDEF_TYPE_NAME(KEX_LOG_INDEX_ENTRY);
+
+C_ASSERT (sizeof(KEX_LOG_INDEX_HEADER) == 16);
+C_ASSERT (sizeof(KEX_LOG_INDEX_ENTRY) == 288);
+
+#define TICKS_PER_DAY (24ULL * 60 * 60 * 10000000)
+
+//
+// These are kept open for the lifetime of the process, so that the size of
+// our own log file can be recorded when it is closed.
+//
+
+STATIC HANDLE LogIndexDirectoryHandle = NULL;
+STATIC HANDLE LogIndexFileHandle = NULL;
+STATIC WCHAR OwnLogFileName[KEX_LOG_INDEX_FILE_NAME_CCH];
+
+BOOLEAN KexpIsLogRetentionPolicyEnabled(
+	VOID)
+{
+	return (KexData->LogMaximumTotalMegabytes ||
+			KexData->LogMaximumFilesPerImage ||
+			KexData->LogMaximumAgeDays ||
+			KexData->LogRingFilesPerImage);
+}
+
+STATIC NTSTATUS KexpLockLogIndex(
+	IN	BOOLEAN	Lock)
+{
+	IO_STATUS_BLOCK IoStatusBlock;
+	LONGLONG ByteOffset;
+	LONGLONG Length;
+
+	ByteOffset = 0;
+	Length = MAXLONGLONG;
+
+	if (Lock) {
+		// The handle is synchronous, so this waits until we own the lock.
+		return NtLockFile(
+			LogIndexFileHandle,
+			NULL,
+			NULL,
+			NULL,
+			&IoStatusBlock,
+			&ByteOffset,
+			&Length,
+			0,
+			FALSE,
+			TRUE);
+	} else {
+		return NtUnlockFile(
+			LogIndexFileHandle,
+			&IoStatusBlock,
+			&ByteOffset,
+			&Length,
+			0);
+	}
+}
+
+//
+// Read the whole index into a newly allocated array, leaving room for
+// ExtraEntries more entries at the end. A missing, truncated or corrupt index
+// is treated as an empty one - it will be rewritten from scratch.
+//
+
+STATIC NTSTATUS KexpReadLogIndex(
+	OUT	PPKEX_LOG_INDEX_ENTRY	Entries,
+	OUT	PULONG					NumberOfEntries,
+	IN	ULONG					ExtraEntries)
+{
+	NTSTATUS Status;
+	IO_STATUS_BLOCK IoStatusBlock;
+	KEX_LOG_INDEX_HEADER Header;
+	LONGLONG ByteOffset;
+	ULONG Index;
+
+	*Entries = NULL;
+	*NumberOfEntries = 0;
+
+	ByteOffset = 0;
+	Status = NtReadFile(
+		LogIndexFileHandle,
+		NULL,
+		NULL,
+		NULL,
+		&IoStatusBlock,
+		&Header,
+		sizeof(Header),
+		&ByteOffset,
+		NULL);
+
+	if (!NT_SUCCESS(Status) ||
+		IoStatusBlock.Information != sizeof(Header) ||
+		Header.Signature != KEX_LOG_INDEX_SIGNATURE ||
+		Header.Version != KEX_LOG_INDEX_VERSION ||
+		Header.NumberOfEntries > KEX_LOG_INDEX_MAXIMUM_ENTRIES) {
+
+		Header.NumberOfEntries = 0;
+	}
+
+	*Entries = SafeAlloc(KEX_LOG_INDEX_ENTRY, Header.NumberOfEntries + ExtraEntries + 1);
+	if (!*Entries) {
+		return STATUS_NO_MEMORY;
+	}
+
+	if (Header.NumberOfEntries == 0) {
+		return STATUS_SUCCESS;
+	}
+
+	ByteOffset = sizeof(Header);
+	Status = NtReadFile(
+		LogIndexFileHandle,
+		NULL,
+		NULL,
+		NULL,
+		&IoStatusBlock,
+		*Entries,
+		Header.NumberOfEntries * sizeof(KEX_LOG_INDEX_ENTRY),
+		&ByteOffset,
+		NULL);
+
+	if (!NT_SUCCESS(Status)) {
+		// Start over with an empty index.
+		return STATUS_SUCCESS;
+	}
+
+	*NumberOfEntries = (ULONG) (IoStatusBlock.Information / sizeof(KEX_LOG_INDEX_ENTRY));
+
+	for (Index = 0; Index < *NumberOfEntries; ++Index) {
+		// Never trust file names read from disk to be null terminated.
+		(*Entries)[Index].FileName[KEX_LOG_INDEX_FILE_NAME_CCH - 1] = '\0';
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Write back the index, dropping removed entries.
+//
+
+STATIC NTSTATUS KexpWriteLogIndex(
+	IN	PKEX_LOG_INDEX_ENTRY	Entries,
+	IN	ULONG					NumberOfEntries)
+{
+	NTSTATUS Status;
+	IO_STATUS_BLOCK IoStatusBlock;
+	KEX_LOG_INDEX_HEADER Header;
+	LONGLONG ByteOffset;
+	LONGLONG EndOfFile;
+	ULONG Index;
+	ULONG NumberOfLiveEntries;
+
+	NumberOfLiveEntries = 0;
+
+	for (Index = 0; Index < NumberOfEntries; ++Index) {
+		if (Entries[Index].FileName[0] != '\0') {
+			Entries[NumberOfLiveEntries++] = Entries[Index];
+		}
+	}
+
+	Header.Signature = KEX_LOG_INDEX_SIGNATURE;
+	Header.Version = KEX_LOG_INDEX_VERSION;
+	Header.NumberOfEntries = NumberOfLiveEntries;
+	Header.Reserved = 0;
+
+	ByteOffset = 0;
+	Status = NtWriteFile(
+		LogIndexFileHandle,
+		NULL,
+		NULL,
+		NULL,
+		&IoStatusBlock,
+		&Header,
+		sizeof(Header),
+		&ByteOffset,
+		NULL);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	if (NumberOfLiveEntries != 0) {
+		ByteOffset = sizeof(Header);
+		Status = NtWriteFile(
+			LogIndexFileHandle,
+			NULL,
+			NULL,
+			NULL,
+			&IoStatusBlock,
+			Entries,
+			NumberOfLiveEntries * sizeof(KEX_LOG_INDEX_ENTRY),
+			&ByteOffset,
+			NULL);
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+	}
+
+	EndOfFile = sizeof(Header) + (LONGLONG) NumberOfLiveEntries * sizeof(KEX_LOG_INDEX_ENTRY);
+
+	return NtSetInformationFile(
+		LogIndexFileHandle,
+		&IoStatusBlock,
+		&EndOfFile,
+		sizeof(EndOfFile),
+		FileEndOfFileInformation);
+}
+
+//
+// Returns TRUE if the process which created a log file might still be
+// writing to it. When in doubt, we assume that it is.
+//
+
+STATIC BOOLEAN KexpIsLogFileInUse(
+	IN	PCKEX_LOG_INDEX_ENTRY	Entry)
+{
+	NTSTATUS Status;
+	HANDLE ProcessHandle;
+	CLIENT_ID ClientId;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	LARGE_INTEGER Timeout;
+
+	if (Entry->ProcessId == 0) {
+		// closed normally
+		return FALSE;
+	}
+
+	ClientId.UniqueProcess = UlongToHandle(Entry->ProcessId);
+	ClientId.UniqueThread = NULL;
+	InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
+
+	Status = NtOpenProcess(
+		&ProcessHandle,
+		SYNCHRONIZE,
+		&ObjectAttributes,
+		&ClientId);
+
+	if (!NT_SUCCESS(Status)) {
+		return !(Status == STATUS_INVALID_CID || Status == STATUS_INVALID_PARAMETER);
+	}
+
+	//
+	// If the process ID has been reused, this gives a false positive, which
+	// is harmless - the file just lives a little longer.
+	//
+
+	Timeout.QuadPart = 0;
+	Status = NtWaitForSingleObject(ProcessHandle, FALSE, &Timeout);
+	SafeClose(ProcessHandle);
+
+	return (Status == STATUS_TIMEOUT);
+}
+
+//
+// Get the name of one of the files which sit next to a log, which is the
+// name of the log with Suffix on the end. The buffer must have room for
+// KEX_LOG_INDEX_FILE_NAME_CCH + 1 characters.
+//
+
+STATIC VOID KexpGetLogSidecarFileName(
+	IN	PCWSTR	FileName,
+	IN	WCHAR	Suffix,
+	OUT	PWSTR	SidecarFileName)
+{
+	StringCchPrintf(SidecarFileName, KEX_LOG_INDEX_FILE_NAME_CCH + 1, L"%s%wc", FileName, Suffix);
+}
+
+STATIC ULONGLONG KexpQueryLogFileSize(
+	IN	PCWSTR	FileName)
+{
+	NTSTATUS Status;
+	UNICODE_STRING FileNameUs;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	FILE_NETWORK_OPEN_INFORMATION FileInformation;
+
+	RtlInitUnicodeString(&FileNameUs, FileName);
+	InitializeObjectAttributes(
+		&ObjectAttributes,
+		&FileNameUs,
+		OBJ_CASE_INSENSITIVE,
+		LogIndexDirectoryHandle,
+		NULL);
+
+	Status = NtQueryFullAttributesFile(&ObjectAttributes, &FileInformation);
+	if (!NT_SUCCESS(Status)) {
+		return 0;
+	}
+
+	return FileInformation.EndOfFile.QuadPart;
+}
+
+//
+// The size of the .vxli and .vxlt files of a log. These are created by the
+// log viewer at any time after the log has been closed, so unlike the size of
+// the log itself, this isn't recorded in the index.
+//
+
+STATIC ULONGLONG KexpQueryLogSidecarFileSize(
+	IN	PCWSTR	FileName)
+{
+	WCHAR SidecarFileName[KEX_LOG_INDEX_FILE_NAME_CCH + 1];
+	PCWSTR Suffix;
+	ULONGLONG TotalSize;
+
+	TotalSize = 0;
+
+	for (Suffix = KEX_LOG_SIDECAR_SUFFIXES; *Suffix != '\0'; ++Suffix) {
+		KexpGetLogSidecarFileName(FileName, *Suffix, SidecarFileName);
+		TotalSize += KexpQueryLogFileSize(SidecarFileName);
+	}
+
+	return TotalSize;
+}
+
+STATIC NTSTATUS KexpDeleteLogDirectoryFile(
+	IN	PCWSTR	FileName)
+{
+	NTSTATUS Status;
+	HANDLE FileHandle;
+	UNICODE_STRING FileNameUs;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	IO_STATUS_BLOCK IoStatusBlock;
+
+	RtlInitUnicodeString(&FileNameUs, FileName);
+	InitializeObjectAttributes(
+		&ObjectAttributes,
+		&FileNameUs,
+		OBJ_CASE_INSENSITIVE,
+		LogIndexDirectoryHandle,
+		NULL);
+
+	Status = NtOpenFile(
+		&FileHandle,
+		DELETE | SYNCHRONIZE,
+		&ObjectAttributes,
+		&IoStatusBlock,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		FILE_DELETE_ON_CLOSE | FILE_NON_DIRECTORY_FILE);
+
+	if (NT_SUCCESS(Status)) {
+		SafeClose(FileHandle);
+	}
+
+	return Status;
+}
+
+//
+// Delete the log file described by an index entry (unless DeleteFile is
+// FALSE) and mark the entry as removed. Returns FALSE if the file is still in
+// use or could not be deleted, in which case the entry stays in the index and
+// we will try again next time.
+//
+// The .vxli and .vxlt files of the log are deleted either way, since they
+// are no good for a ring file which is about to be overwritten either.
+//
+
+STATIC BOOLEAN KexpRemoveLogIndexEntry(
+	IN OUT	PKEX_LOG_INDEX_ENTRY	Entry,
+	IN		BOOLEAN					DeleteFile)
+{
+	NTSTATUS Status;
+	WCHAR SidecarFileName[KEX_LOG_INDEX_FILE_NAME_CCH + 1];
+	PCWSTR Suffix;
+
+	if (Entry->FileName[0] == '\0') {
+		// already removed
+		return FALSE;
+	}
+
+	if (DeleteFile) {
+		if (KexpIsLogFileInUse(Entry)) {
+			return FALSE;
+		}
+
+		Status = KexpDeleteLogDirectoryFile(Entry->FileName);
+
+		unless (NT_SUCCESS(Status) || Status == STATUS_OBJECT_NAME_NOT_FOUND) {
+			// If the user deleted the file themselves, that's fine.
+			return FALSE;
+		}
+	}
+
+	//
+	// If a log viewer still has one of these open, it can't be deleted. That
+	// is rare enough not to bother keeping the entry around for.
+	//
+
+	for (Suffix = KEX_LOG_SIDECAR_SUFFIXES; *Suffix != '\0'; ++Suffix) {
+		KexpGetLogSidecarFileName(Entry->FileName, *Suffix, SidecarFileName);
+		KexpDeleteLogDirectoryFile(SidecarFileName);
+	}
+
+	Entry->FileName[0] = '\0';
+	return TRUE;
+}
+
+//
+// Find an index entry for one of the ring files of the current program which
+// can be overwritten. If there is an unused ring slot, *Entry is set to NULL
+// and that slot is returned. If every slot is held by a running process,
+// KEX_LOG_INDEX_NO_RING_SLOT is returned.
+//
+
+STATIC ULONG KexpSelectRingSlot(
+	IN	PKEX_LOG_INDEX_ENTRY	Entries,
+	IN	ULONG					NumberOfEntries,
+	IN	ULONG					ImageNameHash,
+	OUT	PPKEX_LOG_INDEX_ENTRY	Entry)
+{
+	ULONG Index;
+	ULONG Slot;
+	ULONG NumberOfRingFiles;
+	ULONGLONG SlotsInIndex;
+	PKEX_LOG_INDEX_ENTRY OldestEntry;
+
+	NumberOfRingFiles = min(KexData->LogRingFilesPerImage, KEX_LOG_MAXIMUM_RING_FILES);
+	SlotsInIndex = 0;
+	OldestEntry = NULL;
+
+	for (Index = 0; Index < NumberOfEntries; ++Index) {
+		PKEX_LOG_INDEX_ENTRY CurrentEntry;
+
+		CurrentEntry = &Entries[Index];
+
+		if (CurrentEntry->FileName[0] == '\0' ||
+			CurrentEntry->ImageNameHash != ImageNameHash ||
+			CurrentEntry->RingSlot >= NumberOfRingFiles) {
+
+			continue;
+		}
+
+		SlotsInIndex |= 1ULL << CurrentEntry->RingSlot;
+
+		//
+		// Entries are ordered oldest first, so the first one we come across
+		// which isn't in use is the one to reuse.
+		//
+
+		if (!OldestEntry && !KexpIsLogFileInUse(CurrentEntry)) {
+			OldestEntry = CurrentEntry;
+		}
+	}
+
+	for (Slot = 0; Slot < NumberOfRingFiles; ++Slot) {
+		if (!(SlotsInIndex & (1ULL << Slot))) {
+			*Entry = NULL;
+			return Slot;
+		}
+	}
+
+	*Entry = OldestEntry;
+
+	if (OldestEntry) {
+		return OldestEntry->RingSlot;
+	} else {
+		return KEX_LOG_INDEX_NO_RING_SLOT;
+	}
+}
+
+//
+// Enforce the retention policy and add the log file which is about to be
+// opened to the index. In ring mode, LogFileName is replaced with the name
+// of the ring file to overwrite.
+//
+// LogDirHandle is duplicated, the caller may close it afterwards.
+//
+
+NTSTATUS KexpApplyLogRetentionPolicy(
+	IN		HANDLE			LogDirHandle,
+	IN OUT	PUNICODE_STRING	LogFileName)
+{
+	NTSTATUS Status;
+	UNICODE_STRING IndexFileName;
+	UNICODE_STRING ImageNameWithoutExtension;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	IO_STATUS_BLOCK IoStatusBlock;
+	PKEX_LOG_INDEX_ENTRY Entries;
+	PKEX_LOG_INDEX_ENTRY NewEntry;
+	PKEX_LOG_INDEX_ENTRY RingEntry;
+	ULONG NumberOfEntries;
+	ULONG Index;
+	ULONG ImageNameHash;
+	ULONG RingSlot;
+	LONGLONG CurrentTime;
+
+	ASSERT (KexpIsLogRetentionPolicyEnabled());
+	ASSERT (LogIndexFileHandle == NULL);
+
+	if (LogFileName->Length / sizeof(WCHAR) >= KEX_LOG_INDEX_FILE_NAME_CCH) {
+		return STATUS_NAME_TOO_LONG;
+	}
+
+	Status = NtDuplicateObject(
+		NtCurrentProcess(),
+		LogDirHandle,
+		NtCurrentProcess(),
+		&LogIndexDirectoryHandle,
+		0,
+		0,
+		DUPLICATE_SAME_ACCESS);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	RtlInitConstantUnicodeString(&IndexFileName, KEX_LOG_INDEX_FILE_NAME);
+	InitializeObjectAttributes(
+		&ObjectAttributes,
+		&IndexFileName,
+		OBJ_CASE_INSENSITIVE,
+		LogIndexDirectoryHandle,
+		NULL);
+
+	Status = NtCreateFile(
+		&LogIndexFileHandle,
+		GENERIC_READ | GENERIC_WRITE,
+		&ObjectAttributes,
+		&IoStatusBlock,
+		NULL,
+		FILE_ATTRIBUTE_NORMAL,
+		FILE_SHARE_READ | FILE_SHARE_WRITE,
+		FILE_OPEN_IF,
+		FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE,
+		NULL,
+		0);
+
+	if (!NT_SUCCESS(Status)) {
+		SafeClose(LogIndexDirectoryHandle);
+		return Status;
+	}
+
+	Status = KexpLockLogIndex(TRUE);
+	if (!NT_SUCCESS(Status)) {
+		SafeClose(LogIndexFileHandle);
+		SafeClose(LogIndexDirectoryHandle);
+		return Status;
+	}
+
+	Entries = NULL;
+
+	try {
+		Status = KexpReadLogIndex(&Entries, &NumberOfEntries, 1);
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		NtQuerySystemTime((PLARGE_INTEGER) &CurrentTime);
+
+		RtlHashUnicodeString(
+			&KexData->ImageBaseName,
+			TRUE,
+			HASH_STRING_ALGORITHM_X65599,
+			&ImageNameHash);
+
+		//
+		// 1. Delete logs which are too old.
+		//
+
+		if (KexData->LogMaximumAgeDays) {
+			ULONGLONG MaximumAge;
+
+			MaximumAge = KexData->LogMaximumAgeDays * TICKS_PER_DAY;
+
+			for (Index = 0; Index < NumberOfEntries; ++Index) {
+				if ((ULONGLONG) (CurrentTime - Entries[Index].CreationTime) > MaximumAge) {
+					KexpRemoveLogIndexEntry(&Entries[Index], TRUE);
+				} else {
+					// all remaining entries are newer
+					break;
+				}
+			}
+		}
+
+		//
+		// 2. In ring mode, pick which of our ring files to overwrite. Its old
+		//    index entry is dropped without deleting the file.
+		//
+
+		RingSlot = KEX_LOG_INDEX_NO_RING_SLOT;
+
+		if (KexData->LogRingFilesPerImage) {
+			RingSlot = KexpSelectRingSlot(Entries, NumberOfEntries, ImageNameHash, &RingEntry);
+
+			if (RingSlot != KEX_LOG_INDEX_NO_RING_SLOT) {
+				HRESULT Result;
+
+				KexRtlPathRemoveExtension(&KexData->ImageBaseName, &ImageNameWithoutExtension);
+
+				Result = StringCchPrintf(
+					LogFileName->Buffer,
+					KEX_LOG_INDEX_FILE_NAME_CCH,
+					L"%.*s-ring%lu.vxl",
+					KexRtlUnicodeStringCch(&ImageNameWithoutExtension),
+					ImageNameWithoutExtension.Buffer,
+					RingSlot);
+
+				if (SUCCEEDED(Result)) {
+					KexRtlUpdateNullTerminatedUnicodeStringLength(LogFileName);
+
+					if (RingEntry) {
+						KexpRemoveLogIndexEntry(RingEntry, FALSE);
+					}
+				} else {
+					// Name too long. Fall back to an ordinary log file.
+					RingSlot = KEX_LOG_INDEX_NO_RING_SLOT;
+				}
+			}
+		}
+
+		//
+		// 3. Make room for the new log among the logs of the same program.
+		//
+
+		if (KexData->LogMaximumFilesPerImage) {
+			ULONG NumberOfImageFiles;
+
+			NumberOfImageFiles = 0;
+
+			for (Index = 0; Index < NumberOfEntries; ++Index) {
+				if (Entries[Index].FileName[0] != '\0' &&
+					Entries[Index].ImageNameHash == ImageNameHash) {
+
+					++NumberOfImageFiles;
+				}
+			}
+
+			for (Index = 0; Index < NumberOfEntries; ++Index) {
+				if (NumberOfImageFiles < KexData->LogMaximumFilesPerImage) {
+					break;
+				}
+
+				if (Entries[Index].ImageNameHash == ImageNameHash &&
+					KexpRemoveLogIndexEntry(&Entries[Index], TRUE)) {
+
+					--NumberOfImageFiles;
+				}
+			}
+		}
+
+		//
+		// 4. Delete the oldest logs until the total size is within the limit.
+		//    Sizes are recorded when a log is closed. Logs whose size we
+		//    don't know yet (still running, or crashed) are measured now, and
+		//    so are the .vxli and .vxlt files of every log.
+		//
+
+		if (KexData->LogMaximumTotalMegabytes) {
+			ULONGLONG TotalSize;
+			ULONGLONG MaximumTotalSize;
+
+			TotalSize = 0;
+			MaximumTotalSize = (ULONGLONG) KexData->LogMaximumTotalMegabytes << 20;
+
+			for (Index = 0; Index < NumberOfEntries; ++Index) {
+				if (Entries[Index].FileName[0] == '\0') {
+					continue;
+				}
+
+				if (Entries[Index].FileSize == 0) {
+					Entries[Index].FileSize = KexpQueryLogFileSize(Entries[Index].FileName);
+				}
+
+				TotalSize += Entries[Index].FileSize;
+				TotalSize += KexpQueryLogSidecarFileSize(Entries[Index].FileName);
+			}
+
+			for (Index = 0; Index < NumberOfEntries; ++Index) {
+				ULONGLONG FileSize;
+
+				if (TotalSize <= MaximumTotalSize) {
+					break;
+				}
+
+				if (Entries[Index].FileName[0] == '\0') {
+					continue;
+				}
+
+				FileSize = Entries[Index].FileSize;
+				FileSize += KexpQueryLogSidecarFileSize(Entries[Index].FileName);
+
+				if (KexpRemoveLogIndexEntry(&Entries[Index], TRUE)) {
+					TotalSize -= FileSize;
+				}
+			}
+		}
+
+		//
+		// 5. Add our own log file to the end of the index.
+		//
+
+		NewEntry = &Entries[NumberOfEntries++];
+		NewEntry->CreationTime = CurrentTime;
+		NewEntry->FileSize = 0;
+		NewEntry->ImageNameHash = ImageNameHash;
+		NewEntry->ProcessId = HandleToUlong(NtCurrentTeb()->ClientId.UniqueProcess);
+		NewEntry->RingSlot = RingSlot;
+		NewEntry->Reserved = 0;
+
+		RtlCopyMemory(NewEntry->FileName, LogFileName->Buffer, LogFileName->Length);
+		NewEntry->FileName[LogFileName->Length / sizeof(WCHAR)] = '\0';
+
+		RtlCopyMemory(OwnLogFileName, NewEntry->FileName, sizeof(OwnLogFileName));
+
+		Status = KexpWriteLogIndex(Entries, NumberOfEntries);
+	} finally {
+		KexpLockLogIndex(FALSE);
+		SafeFree(Entries);
+
+		if (!NT_SUCCESS(Status)) {
+			SafeClose(LogIndexFileHandle);
+			SafeClose(LogIndexDirectoryHandle);
+		}
+	}
+
+	return Status;
+}
+
+//
+// Record the final size of our log file in the index, and mark it as no
+// longer in use. Call this after the log file has been closed.
+//
+
+VOID KexpFinalizeLogRetentionPolicy(
+	VOID)
+{
+	NTSTATUS Status;
+	PKEX_LOG_INDEX_ENTRY Entries;
+	ULONG NumberOfEntries;
+	ULONG Index;
+	ULONG ProcessId;
+	UNICODE_STRING OwnFileName;
+
+	if (!LogIndexFileHandle) {
+		return;
+	}
+
+	Status = KexpLockLogIndex(TRUE);
+	if (!NT_SUCCESS(Status)) {
+		SafeClose(LogIndexFileHandle);
+		SafeClose(LogIndexDirectoryHandle);
+		return;
+	}
+
+	Entries = NULL;
+	ProcessId = HandleToUlong(NtCurrentTeb()->ClientId.UniqueProcess);
+	RtlInitUnicodeString(&OwnFileName, OwnLogFileName);
+
+	try {
+		Status = KexpReadLogIndex(&Entries, &NumberOfEntries, 0);
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		//
+		// Search from the end, since our entry is likely to be recent.
+		//
+
+		Index = NumberOfEntries;
+
+		while (Index--) {
+			UNICODE_STRING EntryFileName;
+
+			if (Entries[Index].ProcessId != ProcessId) {
+				continue;
+			}
+
+			RtlInitUnicodeString(&EntryFileName, Entries[Index].FileName);
+
+			if (RtlEqualUnicodeString(&EntryFileName, &OwnFileName, TRUE)) {
+				IO_STATUS_BLOCK IoStatusBlock;
+				LONGLONG ByteOffset;
+
+				Entries[Index].FileSize = KexpQueryLogFileSize(OwnLogFileName);
+				Entries[Index].ProcessId = 0;
+
+				// Only this one entry changed, so only write that.
+				ByteOffset = sizeof(KEX_LOG_INDEX_HEADER) + (LONGLONG) Index * sizeof(KEX_LOG_INDEX_ENTRY);
+				NtWriteFile(
+					LogIndexFileHandle,
+					NULL,
+					NULL,
+					NULL,
+					&IoStatusBlock,
+					&Entries[Index],
+					sizeof(KEX_LOG_INDEX_ENTRY),
+					&ByteOffset,
+					NULL);
+
+				break;
+			}
+		}
+	} finally {
+		KexpLockLogIndex(FALSE);
+		SafeFree(Entries);
+		SafeClose(LogIndexFileHandle);
+		SafeClose(LogIndexDirectoryHandle);
+	}
+}
\ No newline at end of file
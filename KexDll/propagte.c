@@ -30,6 +30,9 @@
 //     vxiiduu              21-Mar-2024  Fix propagation again for 32-bit
 //	   vxiiduu				20-May-2024  Remove useless fallback code in
 //										 Ext_NtCreateUserProcess.
+//     agent                17-Oct-2026  Pass session log handles to child
+//                                       processes.
+//     agent                18-Oct-2026  Only ask for PROCESS_DUP_HANDLE if needed.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -241,19 +244,22 @@ KEXAPI NTSTATUS NTAPI KexInitializePropagation(
 
 	//
 	// Check the SubSystemData pointer. If it's non-null, it points to a
-	// KEX_IFEO_PARAMETERS structure inherited from the parent process, and
-	// it means we are propagated.
+	// KEX_PROPAGATED_DATA structure inherited from the parent process, and
+	// it means we are propagated. Any session log handles in it have already
+	// been taken by KexOpenVxlLogForCurrentApplication.
 	//
 
 	Peb = NtCurrentPeb();
 
 	if (Peb->SubSystemData) {
 		NTSTATUS Status;
+		PKEX_PROPAGATED_DATA InheritedData;
 		PKEX_IFEO_PARAMETERS InheritedIfeoParameters;
 		SIZE_T RegionSize;
 
 		KexData->Flags |= KEXDATA_FLAG_PROPAGATED;
-		InheritedIfeoParameters = (PKEX_IFEO_PARAMETERS) Peb->SubSystemData;
+		InheritedData = (PKEX_PROPAGATED_DATA) Peb->SubSystemData;
+		InheritedIfeoParameters = &InheritedData->IfeoParameters;
 
 		KexLogDebugEvent(
 			L"Found Peb->SubSystemData pointer 0x%p",
@@ -287,7 +293,7 @@ KEXAPI NTSTATUS NTAPI KexInitializePropagation(
 
 		Status = NtFreeVirtualMemory(
 			NtCurrentProcess(),
-			(PPVOID) &InheritedIfeoParameters,
+			(PPVOID) &InheritedData,
 			&RegionSize,
 			MEM_RELEASE);
 
@@ -295,7 +301,7 @@ KEXAPI NTSTATUS NTAPI KexInitializePropagation(
 
 		if (!NT_SUCCESS(Status)) {
 			KexLogWarningEvent(
-				L"Failed to free the temporary propagation KEX_IFEO_PARAMETERS.\r\n\r\n"
+				L"Failed to free the temporary propagation KEX_PROPAGATED_DATA.\r\n\r\n"
 				L"NTSTATUS error code: %s (0x%08lx)",
 				KexRtlNtStatusToString(Status), Status);
 		}
@@ -559,6 +565,7 @@ STATIC NTSTATUS NTAPI Ext_NtCreateUserProcess(
 
 	PVOID IfeoParametersBaseAddress;
 	SIZE_T IfeoParametersSize;
+	KEX_PROPAGATED_DATA PropagatedData;
 
 	RemoteNtOpenKey = 0;
 
@@ -577,10 +584,17 @@ STATIC NTSTATUS NTAPI Ext_NtCreateUserProcess(
 	//    so that we can install the hooks and have them called at the
 	//    appropriate time.
 	//
+	// 4. We need to be able to duplicate the session log handles into the
+	//    new process, if we are writing a session log.
+	//
 
 	ModifiedProcessDesiredAccess |= PROCESS_VM_OPERATION | PROCESS_VM_READ | PROCESS_VM_WRITE;
 	ModifiedThreadDesiredAccess |= THREAD_SUSPEND_RESUME;
 	ModifiedThreadFlags |= THREAD_CREATE_FLAGS_CREATE_SUSPENDED;
+
+	if (KexData->LogHandle && (KexData->LogHandle->Flags & VXL_OPEN_SESSION)) {
+		ModifiedProcessDesiredAccess |= PROCESS_DUP_HANDLE;
+	}
 	
 	Status = KexNtCreateUserProcess(
 		ProcessHandle,
@@ -765,17 +779,36 @@ STATIC NTSTATUS NTAPI Ext_NtCreateUserProcess(
 	}
 
 	//
-	// Pass down the VxKex IFEO parameters into the child process.
-	// We will allocate memory for the parameters, copy the data, and then
-	// place a pointer into the PEB of the child process.
+	// Pass down the VxKex IFEO parameters (and session log handles, if any)
+	// into the child process. We will allocate memory for the parameters,
+	// copy the data, and then place a pointer into the PEB of the child
+	// process.
 	//
 	// If the child process is a WOW64 process, then we will use the 32-bit
 	// PEB. If the child process is a 64-bit process, we will use the 64-bit
 	// PEB.
 	//
 
+	RtlZeroMemory(&PropagatedData, sizeof(PropagatedData));
+	PropagatedData.IfeoParameters = KexData->IfeoParameters;
+
+	if (KexData->LogHandle && (KexData->LogHandle->Flags & VXL_OPEN_SESSION)) {
+		Status = VxlDuplicateSessionLog(
+			KexData->LogHandle,
+			*ProcessHandle,
+			&PropagatedData.SessionLog);
+
+		if (!NT_SUCCESS(Status)) {
+			// Not fatal - the child will just open its own log file.
+			KexLogWarningEvent(
+				L"Failed to duplicate session log handles into child process.\r\n\r\n"
+				L"NTSTATUS error code: %s (0x%08lx)",
+				KexRtlNtStatusToString(Status), Status);
+		}
+	}
+
 	IfeoParametersBaseAddress = NULL;
-	IfeoParametersSize = sizeof(KEX_IFEO_PARAMETERS);
+	IfeoParametersSize = sizeof(KEX_PROPAGATED_DATA);
 
 	Status = NtAllocateVirtualMemory(
 		*ProcessHandle,
@@ -789,7 +822,7 @@ STATIC NTSTATUS NTAPI Ext_NtCreateUserProcess(
 
 	if (!NT_SUCCESS(Status)) {
 		KexLogWarningEvent(
-			L"Failed to allocate for KEX_IFEO_PARAMETERS in child process.\r\n\r\n"
+			L"Failed to allocate for KEX_PROPAGATED_DATA in child process.\r\n\r\n"
 			L"NTSTATUS error code: %s",
 			KexRtlNtStatusToString(Status));
 		goto BailOut;
@@ -798,15 +831,15 @@ STATIC NTSTATUS NTAPI Ext_NtCreateUserProcess(
 	Status = NtWriteVirtualMemory(
 		*ProcessHandle,
 		IfeoParametersBaseAddress,
-		&KexData->IfeoParameters,
-		sizeof(KexData->IfeoParameters),
+		&PropagatedData,
+		sizeof(PropagatedData),
 		NULL);
 
 	ASSERT (NT_SUCCESS(Status));
 
 	if (!NT_SUCCESS(Status)) {
 		KexLogWarningEvent(
-			L"Failed to write KEX_IFEO_PARAMETERS into child process.\r\n\r\n"
+			L"Failed to write KEX_PROPAGATED_DATA into child process.\r\n\r\n"
 			L"NTSTATUS error code: %s (0x%08lx)",
 			KexRtlNtStatusToString(Status), Status);
 		goto BailOut;
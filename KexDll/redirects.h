@@ -3,6 +3,10 @@
 // outside of KexDir and WinDir. The DLL redirect routine strips the .dll suffix,
 // if present, from the DLL name.
 //
+// This list isn't used directly. redirgen turns it into a perfect hash table
+// (redirtbl.h), so run "make table" in 01-Development Utilities\redirgen after
+// changing it. Debug builds check that the two match.
+//
 
 #define DLL_REDIRECT(Key, Value) {RTL_CONSTANT_STRING(_L(Key)), RTL_CONSTANT_STRING(_L(Value))},
 
@@ -103,7 +107,6 @@ STATIC CONST UNICODE_STRING DllRedirects[][2] = {
 	DLL_REDIRECT("api-ms-win-core-rtlsupport",					"kxnt"				)
 	DLL_REDIRECT("api-ms-win-core-shlwapi-legacy",				"kxuser"			)
 	DLL_REDIRECT("api-ms-win-core-shlwapi-obsolete",			"kxuser"			)
-	DLL_REDIRECT("api-ms-win-core-string-obsolete",				"kxbase"			)
 	DLL_REDIRECT("api-ms-win-core-sidebyside",					"kxbase"			)
 	DLL_REDIRECT("api-ms-win-core-string",						"kxbase"			)
 	DLL_REDIRECT("api-ms-win-core-string-obsolete",				"kxbase"			)
@@ -0,0 +1,185 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     redirhash.h
+//
+// Abstract:
+//
+//     The hash function behind the generated DLL redirect table (redirtbl.h).
+//
+//     redirgen, which generates the table on the build host, and dllrewrt.c,
+//     which looks names up in it, must agree exactly on how a DLL name is
+//     hashed, so both of them use the function in this header. It must not
+//     depend on anything except the basic types.
+//
+//     The table is a minimal perfect hash: every key has its own slot and
+//     there are no empty slots. A key is hashed once. Part of the hash picks
+//     a bucket, whose displacement (chosen by redirgen) is mixed back into the
+//     hash to get the slot. Names which are not in the table also land on
+//     some slot, so the key stored there has to be compared.
+//
+//     DLL names in import tables are ANSI, so there are ANSI versions of the
+//     hash and compare which give the same results for ASCII names. That way
+//     import tables can be rewritten without converting every name to
+//     Unicode and back.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Add ANSI versions for import tables.
+//     agent                17-Oct-2026  Add a compare for Unicode names.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//
+// Keys are case-insensitive. Only ASCII letters are folded, since all of
+// the DLL names in the table are ASCII.
+//
+
+STATIC FORCEINLINE ULONG KexHashDllRedirectKey(
+	IN	PCWCHAR	Name,
+	IN	ULONG	NameCch,
+	IN	ULONG	Seed)
+{
+	ULONG Hash;
+	ULONG Index;
+
+	// FNV-1a
+	Hash = 0x811C9DC5 ^ Seed;
+
+	for (Index = 0; Index < NameCch; ++Index) {
+		WCHAR Character;
+
+		Character = Name[Index];
+
+		if (Character >= 'A' && Character <= 'Z') {
+			Character += 'a' - 'A';
+		}
+
+		Hash ^= Character;
+		Hash *= 0x01000193;
+	}
+
+	return Hash;
+}
+
+STATIC FORCEINLINE ULONG KexHashDllRedirectKeyA(
+	IN	PCSTR	Name,
+	IN	ULONG	NameCch,
+	IN	ULONG	Seed)
+{
+	ULONG Hash;
+	ULONG Index;
+
+	Hash = 0x811C9DC5 ^ Seed;
+
+	for (Index = 0; Index < NameCch; ++Index) {
+		UCHAR Character;
+
+		Character = (UCHAR) Name[Index];
+
+		if (Character >= 'A' && Character <= 'Z') {
+			Character += 'a' - 'A';
+		}
+
+		Hash ^= Character;
+		Hash *= 0x01000193;
+	}
+
+	return Hash;
+}
+
+//
+// Compare an ANSI name with a key, folding ASCII letters only. Both must be
+// NameCch characters long.
+//
+
+STATIC FORCEINLINE BOOLEAN KexEqualDllRedirectKeyA(
+	IN	PCSTR	Key,
+	IN	PCSTR	Name,
+	IN	ULONG	NameCch)
+{
+	ULONG Index;
+
+	for (Index = 0; Index < NameCch; ++Index) {
+		UCHAR KeyCharacter;
+		UCHAR NameCharacter;
+
+		KeyCharacter = (UCHAR) Key[Index];
+		NameCharacter = (UCHAR) Name[Index];
+
+		if (KeyCharacter >= 'A' && KeyCharacter <= 'Z') {
+			KeyCharacter += 'a' - 'A';
+		}
+
+		if (NameCharacter >= 'A' && NameCharacter <= 'Z') {
+			NameCharacter += 'a' - 'A';
+		}
+
+		if (KeyCharacter != NameCharacter) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+//
+// Compare a Unicode name with an ANSI key in the same way.
+//
+
+STATIC FORCEINLINE BOOLEAN KexEqualDllRedirectKey(
+	IN	PCSTR	Key,
+	IN	PCWCHAR	Name,
+	IN	ULONG	NameCch)
+{
+	ULONG Index;
+
+	for (Index = 0; Index < NameCch; ++Index) {
+		UCHAR KeyCharacter;
+		WCHAR NameCharacter;
+
+		KeyCharacter = (UCHAR) Key[Index];
+		NameCharacter = Name[Index];
+
+		if (KeyCharacter >= 'A' && KeyCharacter <= 'Z') {
+			KeyCharacter += 'a' - 'A';
+		}
+
+		if (NameCharacter >= 'A' && NameCharacter <= 'Z') {
+			NameCharacter += 'a' - 'A';
+		}
+
+		if (KeyCharacter != NameCharacter) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+STATIC FORCEINLINE ULONG KexGetDllRedirectBucket(
+	IN	ULONG	Hash,
+	IN	ULONG	NumberOfBuckets)
+{
+	return (Hash >> 16) % NumberOfBuckets;
+}
+
+STATIC FORCEINLINE ULONG KexGetDllRedirectSlot(
+	IN	ULONG	Hash,
+	IN	ULONG	Displacement,
+	IN	ULONG	NumberOfSlots)
+{
+	Hash ^= Displacement;
+	Hash *= 0x9E3779B1;
+	Hash ^= Hash >> 15;
+
+	return Hash % NumberOfSlots;
+}
\ No newline at end of file
@@ -0,0 +1,1254 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     rwengine.c
+//
+// Abstract:
+//
+//     The DLL rewrite table, and the engine which rewrites the names of DLLs
+//     in the import directories of loaded images.
+//
+//     Rewriting an import directory is done in three steps. First the import
+//     directory is read (or a plan for it is taken from the plan cache) to
+//     find out which DLL names will change. Then the pages which will be
+//     written to are worked out, including the bound import data directory
+//     if it has to be cleared, and grouped into as few windows of pages with
+//     the same protection as possible. Only then does the caller change the
+//     page protections, once per window, and have the names written.
+//     Images where nothing changes are never written to or unprotected.
+//
+//     Nothing in here trusts the image layout: every RVA is checked against
+//     the size of the image. The loader only gives us images which the
+//     kernel has already checked, but the engine is also run against
+//     arbitrary files on the build host.
+//
+//     This file does not use anything from the rest of KexDll (except in
+//     the native-only part at the end), and can be built on a non-Windows
+//     host with KEX_ENV_HOST defined for testing and benchmarking.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation, from parts of
+//                                       dllrewrt.c.
+//     agent                17-Oct-2026  Compare names without Rtl functions so
+//                                       that lookups can be tested on the host.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef KEX_ENV_HOST
+#  include <KexHost.h>
+#  include "rwengine.h"
+#  define KexLogDetailEvent(...)
+#else
+#  include "buildcfg.h"
+#  include "kexdllp.h"
+#endif
+
+#include "redirhash.h"
+
+// This header file contains the DLL rewrite table. It is generated from
+// redirects.h by redirgen.
+#include "redirtbl.h"
+
+#if defined(_DEBUG) && !defined(KEX_ENV_HOST)
+// Only used to check that redirtbl.h is up to date.
+#  include "redirects.h"
+#endif
+
+#define KEX_IMAGE_REGION_NONE	0xFFFFFFFF
+
+#define KEX_IMAGE_REGION_PROTECTION_MASK \
+	(IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE)
+
+//
+// Changes made to the DLL rewrite table at run time (for the IE kernel32
+// exclusion, and by ashselec.c) go into this small table, which is searched
+// before the generated one. An override with a NULL RewrittenDllName.Buffer
+// hides the generated entry for that DLL.
+//
+// There are usually none of these, and never more than a few.
+//
+
+#define DLL_REWRITE_MAXIMUM_OVERRIDES 8
+
+typedef struct _DLL_REWRITE_OVERRIDE {
+	UNICODE_STRING	DllName;
+	UNICODE_STRING	RewrittenDllName;
+} TYPEDEF_TYPE_NAME(DLL_REWRITE_OVERRIDE);
+
+//
+// One DLL name in an import directory, and what it is rewritten to. The new
+// name comes either from the generated table (or is the kxnt.dll name for
+// kernel32), or from an override.
+//
+
+typedef struct _KEX_IMPORT_NAME_REWRITE {
+	PSTR					DllName;
+	ULONG					DllNameCch;
+	PCSTR					RewrittenDllName;
+	PCDLL_REWRITE_OVERRIDE	Override;
+	ULONG					RewrittenDllNameCch;
+} TYPEDEF_TYPE_NAME(KEX_IMPORT_NAME_REWRITE);
+
+STATIC DLL_REWRITE_OVERRIDE DllRewriteOverrides[DLL_REWRITE_MAXIMUM_OVERRIDES];
+STATIC ULONG NumberOfDllRewriteOverrides = 0;
+
+//
+// Set once an override adds a DLL which isn't in the generated table. Import
+// rewrite plans made after that depend on this process, so they can't be
+// shared with other processes through the plan cache (rwplan.c).
+//
+
+STATIC BOOLEAN DllRewriteOverridesAddEntries = FALSE;
+
+//
+// Look up a DLL base name (without .dll extension) in the generated table.
+// Returns NULL if there is no entry for it.
+//
+
+PCUNICODE_STRING KexpLookupStaticDllRewriteEntry(
+	IN	PCUNICODE_STRING	DllName)
+{
+	ULONG DllNameCch;
+	ULONG Hash;
+	ULONG Slot;
+	PCANSI_STRING Key;
+
+	DllNameCch = KexRtlUnicodeStringCch(DllName);
+	Hash = KexHashDllRedirectKey(DllName->Buffer, DllNameCch, DLL_REDIRECT_HASH_SEED);
+
+	Slot = KexGetDllRedirectSlot(
+		Hash,
+		DllRedirectDisplacements[KexGetDllRedirectBucket(Hash, DLL_REDIRECT_NUMBER_OF_BUCKETS)],
+		DLL_REDIRECT_NUMBER_OF_SLOTS);
+
+	// The keys are the same in both tables, and the ANSI one is quicker to
+	// compare with.
+	Key = &DllRedirectAnsiTable[Slot][0];
+
+	if (Key->Length == DllNameCch && KexEqualDllRedirectKey(Key->Buffer, DllName->Buffer, DllNameCch)) {
+		return &DllRedirectTable[Slot][1];
+	}
+
+	return NULL;
+}
+
+STATIC PDLL_REWRITE_OVERRIDE KexpFindDllRewriteOverride(
+	IN	PCUNICODE_STRING	DllName)
+{
+	ULONG Index;
+
+	for (Index = 0; Index < NumberOfDllRewriteOverrides; ++Index) {
+		PCUNICODE_STRING OverrideDllName;
+		ULONG CharacterIndex;
+
+		OverrideDllName = &DllRewriteOverrides[Index].DllName;
+
+		if (OverrideDllName->Length != DllName->Length) {
+			continue;
+		}
+
+		for (CharacterIndex = 0; CharacterIndex < KexRtlUnicodeStringCch(DllName); ++CharacterIndex) {
+			if (ToUpper(OverrideDllName->Buffer[CharacterIndex]) !=
+				ToUpper(DllName->Buffer[CharacterIndex])) {
+
+				break;
+			}
+		}
+
+		if (CharacterIndex == KexRtlUnicodeStringCch(DllName)) {
+			return &DllRewriteOverrides[Index];
+		}
+	}
+
+	return NULL;
+}
+
+//
+// Returns TRUE if there is an override for a DLL base name (without .dll
+// extension). If the override removes the DLL from the table, the buffer
+// of RewrittenDllName is NULL.
+//
+
+BOOLEAN KexpLookupDllRewriteOverride(
+	IN	PCUNICODE_STRING	DllName,
+	OUT	PUNICODE_STRING		RewrittenDllName)
+{
+	PCDLL_REWRITE_OVERRIDE Override;
+
+	if (NumberOfDllRewriteOverrides == 0) {
+		return FALSE;
+	}
+
+	Override = KexpFindDllRewriteOverride(DllName);
+
+	if (!Override) {
+		return FALSE;
+	}
+
+	*RewrittenDllName = Override->RewrittenDllName;
+	return TRUE;
+}
+
+//
+// ANSI versions of the above, for names in import tables. DllName doesn't
+// have to be null terminated.
+//
+
+STATIC PCANSI_STRING KexpLookupStaticDllRewriteEntryA(
+	IN	PCSTR	DllName,
+	IN	ULONG	DllNameCch)
+{
+	ULONG Hash;
+	ULONG Slot;
+	PCANSI_STRING Key;
+
+	Hash = KexHashDllRedirectKeyA(DllName, DllNameCch, DLL_REDIRECT_HASH_SEED);
+
+	Slot = KexGetDllRedirectSlot(
+		Hash,
+		DllRedirectDisplacements[KexGetDllRedirectBucket(Hash, DLL_REDIRECT_NUMBER_OF_BUCKETS)],
+		DLL_REDIRECT_NUMBER_OF_SLOTS);
+
+	Key = &DllRedirectAnsiTable[Slot][0];
+
+	if (Key->Length == DllNameCch && KexEqualDllRedirectKeyA(Key->Buffer, DllName, DllNameCch)) {
+		return &DllRedirectAnsiTable[Slot][1];
+	}
+
+	return NULL;
+}
+
+STATIC PDLL_REWRITE_OVERRIDE KexpFindDllRewriteOverrideA(
+	IN	PCSTR	DllName,
+	IN	ULONG	DllNameCch)
+{
+	ULONG Index;
+
+	for (Index = 0; Index < NumberOfDllRewriteOverrides; ++Index) {
+		PCUNICODE_STRING OverrideDllName;
+		ULONG CharacterIndex;
+
+		OverrideDllName = &DllRewriteOverrides[Index].DllName;
+
+		if (KexRtlUnicodeStringCch(OverrideDllName) != DllNameCch) {
+			continue;
+		}
+
+		for (CharacterIndex = 0; CharacterIndex < DllNameCch; ++CharacterIndex) {
+			if (ToUpper(OverrideDllName->Buffer[CharacterIndex]) !=
+				ToUpper((UCHAR) DllName[CharacterIndex])) {
+
+				break;
+			}
+		}
+
+		if (CharacterIndex == DllNameCch) {
+			return &DllRewriteOverrides[Index];
+		}
+	}
+
+	return NULL;
+}
+
+//
+// Like the string mapper which used to hold the DLL rewrite entries, this
+// does not copy the strings. They must stay valid for as long as the entry
+// is in use.
+//
+
+NTSTATUS KexAddDllRewriteEntry(
+	IN	PCUNICODE_STRING	DllName,
+	IN	PCUNICODE_STRING	RewrittenDllName)
+{
+	PDLL_REWRITE_OVERRIDE Override;
+
+	ASSUME (VALID_UNICODE_STRING(DllName));
+	ASSUME (VALID_UNICODE_STRING(RewrittenDllName));
+	ASSERT (RewrittenDllName->Buffer != NULL);
+
+	Override = KexpFindDllRewriteOverride(DllName);
+
+	if (!Override) {
+		if (NumberOfDllRewriteOverrides == ARRAYSIZE(DllRewriteOverrides)) {
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+
+		Override = &DllRewriteOverrides[NumberOfDllRewriteOverrides++];
+		Override->DllName = *DllName;
+	}
+
+	unless (KexpLookupStaticDllRewriteEntry(DllName)) {
+		DllRewriteOverridesAddEntries = TRUE;
+	}
+
+	Override->RewrittenDllName = *RewrittenDllName;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS KexRemoveDllRewriteEntry(
+	IN	PCUNICODE_STRING	DllName)
+{
+	PDLL_REWRITE_OVERRIDE Override;
+
+	ASSUME (VALID_UNICODE_STRING(DllName));
+
+	Override = KexpFindDllRewriteOverride(DllName);
+
+	if (Override) {
+		if (Override->RewrittenDllName.Buffer == NULL) {
+			// already removed
+			return STATUS_STRING_MAPPER_ENTRY_NOT_FOUND;
+		}
+	} else {
+		unless (KexpLookupStaticDllRewriteEntry(DllName)) {
+			return STATUS_STRING_MAPPER_ENTRY_NOT_FOUND;
+		}
+
+		if (NumberOfDllRewriteOverrides == ARRAYSIZE(DllRewriteOverrides)) {
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+
+		Override = &DllRewriteOverrides[NumberOfDllRewriteOverrides++];
+		Override->DllName = *DllName;
+	}
+
+	RtlInitEmptyUnicodeString(&Override->RewrittenDllName, NULL, 0);
+	return STATUS_SUCCESS;
+}
+
+//
+// This function accepts DLL base names only. They may or may not have a .dll
+// extension.
+//
+// RewrittenDllName->Buffer points into the DLL rewrite table, which is
+// read-only. Callers must not try to edit it.
+//
+NTSTATUS KexpLookupDllRewriteEntry(
+	IN	PCUNICODE_STRING		DllName,
+	OUT	PUNICODE_STRING			RewrittenDllName)
+{
+	UNICODE_STRING CleanDllName;
+	ULONG CleanDllNameCch;
+	USHORT MaximumRewrittenLength;
+
+	ASSERT (VALID_UNICODE_STRING(DllName));
+	ASSERT (RewrittenDllName != NULL);
+
+	CleanDllName = *DllName;
+	CleanDllNameCch = KexRtlUnicodeStringCch(&CleanDllName);
+
+	//
+	// If the name of the DLL has a .dll extension, shorten the length of it
+	// so that it doesn't have a .dll extension anymore.
+	// This allows image files to import from DLLs with no extension without
+	// choking up the dll rewrite.
+	//
+
+	MaximumRewrittenLength = CleanDllName.Length;
+
+	if (CleanDllNameCch >= 4 && KexEqualDllRedirectKey(".dll", &CleanDllName.Buffer[CleanDllNameCch - 4], 4)) {
+		CleanDllNameCch -= 4;
+	}
+
+	//
+	// If the name of the DLL starts with "api-" or "ext-" (i.e. it's an API set DLL),
+	// then remove the -lX-Y-Z suffix as well.
+	// This code will have to be revised when API sets start appearing with
+	// individual X-Y-Z numbers greater than 9.
+	//
+
+	if (CleanDllNameCch > 4 + 7 &&
+		(KexEqualDllRedirectKey("api-", CleanDllName.Buffer, 4) ||
+		 KexEqualDllRedirectKey("ext-", CleanDllName.Buffer, 4))) {
+
+		CleanDllNameCch -= 7;
+	}
+
+	CleanDllName.Length = (USHORT) (CleanDllNameCch * sizeof(WCHAR));
+
+	//
+	// Now look up the DLL in the DLL rewrite table to see whether we have a
+	// rewrite entry for it. Overrides come first.
+	//
+
+	if (KexpLookupDllRewriteOverride(&CleanDllName, RewrittenDllName)) {
+		if (RewrittenDllName->Buffer == NULL) {
+			return STATUS_STRING_MAPPER_ENTRY_NOT_FOUND;
+		}
+	} else {
+		PCUNICODE_STRING StaticRewrittenDllName;
+
+		StaticRewrittenDllName = KexpLookupStaticDllRewriteEntry(&CleanDllName);
+
+		if (!StaticRewrittenDllName) {
+			return STATUS_STRING_MAPPER_ENTRY_NOT_FOUND;
+		}
+
+		*RewrittenDllName = *StaticRewrittenDllName;
+	}
+
+	//
+	// Check to see that the cch of the rewritten DLL is not greater than the
+	// cch of the original DLL. This shouldn't happen unless someone has made
+	// a mistake with the DLL rewrite table.
+	//
+
+	ASSERT (RewrittenDllName->Length <= MaximumRewrittenLength);
+	ASSERT (VALID_UNICODE_STRING(RewrittenDllName));
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Remove the .dll extension and the -lX-Y-Z suffix of API set DLLs from an
+// ANSI DLL name, the same way as KexpLookupDllRewriteEntry does. Returns the
+// number of characters which are left.
+//
+STATIC ULONG KexpCleanImportTableDllName(
+	IN	PCSTR	DllName,
+	IN	ULONG	DllNameCch)
+{
+	if (DllNameCch >= 4 && KexEqualDllRedirectKeyA(".dll", &DllName[DllNameCch - 4], 4)) {
+		DllNameCch -= 4;
+	}
+
+	if (DllNameCch > 4 + 7 &&
+		(KexEqualDllRedirectKeyA("api-", DllName, 4) || KexEqualDllRedirectKeyA("ext-", DllName, 4))) {
+
+		DllNameCch -= 7;
+	}
+
+	return DllNameCch;
+}
+
+//
+// Get the DLL name of an import descriptor. Returns NULL if the name isn't
+// inside the image, or isn't null terminated before the end of it.
+//
+STATIC PSTR KexpGetImportTableDllName(
+	IN	PCKEX_IMPORT_REWRITE	Rewrite,
+	IN	ULONG					DescriptorIndex,
+	OUT	PULONG					DllNameCch)
+{
+	ULONG NameRva;
+	PSTR DllName;
+	ULONG MaximumCch;
+	ULONG Index;
+
+	ASSERT (DescriptorIndex < Rewrite->NumberOfImportDescriptors);
+
+	NameRva = Rewrite->ImportDescriptors[DescriptorIndex].Name;
+
+	if (NameRva >= Rewrite->SizeOfImage) {
+		return NULL;
+	}
+
+	DllName = (PSTR) RVA_TO_VA(Rewrite->ImageBase, NameRva);
+	MaximumCch = Rewrite->SizeOfImage - NameRva;
+
+	for (Index = 0; Index < MaximumCch; ++Index) {
+		if (DllName[Index] == '\0') {
+			*DllNameCch = Index;
+			return DllName;
+		}
+	}
+
+	return NULL;
+}
+
+//
+// Find out what the DLL name of an import descriptor gets rewritten to,
+// taking overrides into account. This only reads the import directory.
+// Returns FALSE if the name stays as it is.
+//
+STATIC BOOLEAN KexpLookupImportTableDllName(
+	IN	PCKEX_IMPORT_REWRITE		Rewrite,
+	IN	ULONG						DescriptorIndex,
+	OUT	PKEX_IMPORT_NAME_REWRITE	NameRewrite)
+{
+	ULONG CleanDllNameCch;
+
+	NameRewrite->DllName = KexpGetImportTableDllName(
+		Rewrite,
+		DescriptorIndex,
+		&NameRewrite->DllNameCch);
+
+	if (!NameRewrite->DllName || NameRewrite->DllNameCch == 0) {
+		return FALSE;
+	}
+
+	NameRewrite->RewrittenDllName = NULL;
+	NameRewrite->Override = NULL;
+
+	if (Rewrite->Flags & KEX_IMPORT_REWRITE_KERNEL32) {
+		//
+		// Only NTDLL is rewritten in kernel32, so that certain functions
+		// such as LoadLibrary and CreateFileMapping end up going through
+		// KxNt. On Windows 7, it is always the 2nd import of kernel32.
+		//
+
+		if (NameRewrite->DllNameCch != 9 ||
+			!KexEqualDllRedirectKeyA("ntdll.dll", NameRewrite->DllName, 9)) {
+
+			return FALSE;
+		}
+
+		NameRewrite->RewrittenDllName = "kxnt.dll";
+		NameRewrite->RewrittenDllNameCch = 8;
+		return TRUE;
+	}
+
+	CleanDllNameCch = KexpCleanImportTableDllName(
+		NameRewrite->DllName,
+		NameRewrite->DllNameCch);
+
+	//
+	// Look the name up. Overrides come first.
+	//
+
+	if (NumberOfDllRewriteOverrides != 0) {
+		NameRewrite->Override = KexpFindDllRewriteOverrideA(
+			NameRewrite->DllName,
+			CleanDllNameCch);
+	}
+
+	if (NameRewrite->Override) {
+		if (NameRewrite->Override->RewrittenDllName.Buffer == NULL) {
+			return FALSE;
+		}
+
+		NameRewrite->RewrittenDllNameCch = KexRtlUnicodeStringCch(
+			&NameRewrite->Override->RewrittenDllName);
+	} else {
+		PCANSI_STRING RewrittenDllName;
+
+		RewrittenDllName = KexpLookupStaticDllRewriteEntryA(
+			NameRewrite->DllName,
+			CleanDllNameCch);
+
+		if (!RewrittenDllName) {
+			return FALSE;
+		}
+
+		NameRewrite->RewrittenDllName = RewrittenDllName->Buffer;
+		NameRewrite->RewrittenDllNameCch = RewrittenDllName->Length;
+	}
+
+	//
+	// The new name (and its null terminator) has to fit where the old one
+	// was. redirgen makes sure of that for the generated table, but not for
+	// overrides.
+	//
+
+	if (NameRewrite->RewrittenDllNameCch > NameRewrite->DllNameCch) {
+		ASSERT (NameRewrite->Override != NULL);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+//
+// Find out which part of the image an RVA is in, for the purpose of page
+// protection: 0 is the headers, and otherwise it is the section number plus
+// one. Returns KEX_IMAGE_REGION_NONE if the RVA isn't in the image.
+//
+// In images with a section alignment smaller than a page, everything is
+// mapped with the same protection, so the whole image is one region.
+//
+STATIC ULONG KexpGetImageRegion(
+	IN	PCKEX_IMPORT_REWRITE	Rewrite,
+	IN	ULONG					Rva)
+{
+	ULONG Index;
+
+	if (Rva >= Rewrite->SizeOfImage) {
+		return KEX_IMAGE_REGION_NONE;
+	}
+
+	if (Rewrite->SectionAlignment < PAGE_SIZE) {
+		return 0;
+	}
+
+	for (Index = Rewrite->FileHeader->NumberOfSections; Index != 0; --Index) {
+		PIMAGE_SECTION_HEADER SectionHeader;
+
+		SectionHeader = &Rewrite->SectionHeaders[Index - 1];
+
+		if (Rva >= SectionHeader->VirtualAddress) {
+			ULONGLONG SectionSize;
+
+			//
+			// Sections are mapped up to the next multiple of the section
+			// alignment.
+			//
+
+			SectionSize = SectionHeader->Misc.VirtualSize;
+
+			if (SectionSize == 0) {
+				SectionSize = SectionHeader->SizeOfRawData;
+			}
+
+			SectionSize = (SectionSize + Rewrite->SectionAlignment - 1) & ~((ULONGLONG) Rewrite->SectionAlignment - 1);
+
+			if (Rva - SectionHeader->VirtualAddress >= SectionSize) {
+				// In the gap after the section, or past the last one.
+				return KEX_IMAGE_REGION_NONE;
+			}
+
+			return Index;
+		}
+	}
+
+	if (Rva >= ((Rewrite->SizeOfHeaders + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))) {
+		// Between the headers and the first section.
+		return KEX_IMAGE_REGION_NONE;
+	}
+
+	return 0;
+}
+
+STATIC ULONG KexpGetImageRegionProtection(
+	IN	PCKEX_IMPORT_REWRITE	Rewrite,
+	IN	ULONG					Region)
+{
+	if (Region == 0) {
+		return IMAGE_SCN_MEM_READ;
+	}
+
+	return Rewrite->SectionHeaders[Region - 1].Characteristics & KEX_IMAGE_REGION_PROTECTION_MASK;
+}
+
+//
+// Add a range of bytes which will be written to, to the window for its
+// region (or a new one). Windows are made of whole pages.
+//
+STATIC NTSTATUS KexpAddImportRewriteRange(
+	IN OUT	PKEX_IMPORT_REWRITE	Rewrite,
+	IN		ULONG				Rva,
+	IN		ULONG				Size)
+{
+	ULONG Region;
+	ULONG WindowStart;
+	ULONG WindowEnd;
+	ULONG Index;
+
+	ASSERT (Size != 0);
+
+	Region = KexpGetImageRegion(Rewrite, Rva);
+
+	if (Region == KEX_IMAGE_REGION_NONE ||
+		Size > Rewrite->SizeOfImage - Rva ||
+		KexpGetImageRegion(Rewrite, Rva + Size - 1) != Region) {
+
+		return STATUS_INVALID_IMAGE_FORMAT;
+	}
+
+	WindowStart = Rva & ~(PAGE_SIZE - 1);
+	WindowEnd = ((Rva + Size - 1) & ~(PAGE_SIZE - 1)) + PAGE_SIZE;
+
+	for (Index = 0; Index < Rewrite->NumberOfWindows; ++Index) {
+		PKEX_REWRITE_WINDOW Window;
+
+		Window = &Rewrite->Windows[Index];
+
+		if (KexpGetImageRegion(Rewrite, Window->Rva) == Region) {
+			WindowStart = min(WindowStart, Window->Rva);
+			WindowEnd = max(WindowEnd, Window->Rva + Window->Size);
+
+			Window->Rva = WindowStart;
+			Window->Size = WindowEnd - WindowStart;
+			return STATUS_SUCCESS;
+		}
+	}
+
+	if (Rewrite->NumberOfWindows == ARRAYSIZE(Rewrite->Windows)) {
+		// DLL names scattered all over the image.
+		return STATUS_INVALID_IMAGE_FORMAT;
+	}
+
+	Rewrite->Windows[Rewrite->NumberOfWindows].Rva = WindowStart;
+	Rewrite->Windows[Rewrite->NumberOfWindows].Size = WindowEnd - WindowStart;
+	++Rewrite->NumberOfWindows;
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Two windows can be joined into one if everything from the start of the
+// first one to the end of the second one has the same protection. Windows
+// are sorted by RVA.
+//
+STATIC BOOLEAN KexpCanJoinRewriteWindows(
+	IN	PCKEX_IMPORT_REWRITE	Rewrite,
+	IN	PCKEX_REWRITE_WINDOW	FirstWindow,
+	IN	PCKEX_REWRITE_WINDOW	SecondWindow)
+{
+	ULONG FirstRegion;
+	ULONG LastRegion;
+	ULONG Protection;
+	ULONG Region;
+
+	FirstRegion = KexpGetImageRegion(Rewrite, FirstWindow->Rva);
+	LastRegion = KexpGetImageRegion(Rewrite, SecondWindow->Rva);
+	Protection = KexpGetImageRegionProtection(Rewrite, FirstRegion);
+
+	ASSERT (FirstRegion <= LastRegion);
+
+	for (Region = FirstRegion + 1; Region <= LastRegion; ++Region) {
+		ULONG RegionStart;
+
+		if (KexpGetImageRegionProtection(Rewrite, Region) != Protection) {
+			return FALSE;
+		}
+
+		//
+		// There mustn't be a gap between the regions either, since it
+		// wouldn't be mapped.
+		//
+
+		RegionStart = Rewrite->SectionHeaders[Region - 1].VirtualAddress;
+
+		if (RegionStart == 0 || KexpGetImageRegion(Rewrite, RegionStart - 1) != Region - 1) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+//
+// Find the import directory of an image and get ready to rewrite it.
+//
+//   ImageBase
+//     Base address of the image, mapped the way the loader does.
+//
+//   ImageSize
+//     How many bytes at ImageBase can be read. In a process this is
+//     simply the SizeOfImage from the headers.
+//
+//   Flags
+//     May contain KEX_IMPORT_REWRITE_KERNEL32, which rewrites NTDLL to
+//     KxNt and nothing else.
+//
+NTSTATUS KexpInitializeImportRewrite(
+	IN	PVOID				ImageBase,
+	IN	ULONG				ImageSize,
+	IN	ULONG				Flags,
+	OUT	PKEX_IMPORT_REWRITE	Rewrite)
+{
+	PIMAGE_DOS_HEADER DosHeader;
+	PIMAGE_NT_HEADERS32 NtHeaders32;
+	PIMAGE_NT_HEADERS64 NtHeaders64;
+	ULONG NtHeadersOffset;
+	ULONG SectionHeadersOffset;
+	ULONG NumberOfRvaAndSizes;
+	ULONG SizeOfOptionalHeader;
+	ULONG DataDirectoryOffset;
+	PIMAGE_DATA_DIRECTORY DataDirectory;
+	PIMAGE_DATA_DIRECTORY ImportDirectory;
+	ULONG MaximumNumberOfImportDescriptors;
+	ULONG Index;
+
+	ASSERT (ImageBase != NULL);
+	ASSERT (Rewrite != NULL);
+
+	RtlZeroMemory(Rewrite, sizeof(*Rewrite));
+
+	Rewrite->ImageBase = ImageBase;
+	Rewrite->Flags = Flags;
+	Rewrite->PlanIsShareable = !(Flags & KEX_IMPORT_REWRITE_KERNEL32) && !DllRewriteOverridesAddEntries;
+
+	//
+	// Find the NT headers.
+	//
+
+	if (ImageSize < sizeof(IMAGE_DOS_HEADER)) {
+		return STATUS_INVALID_IMAGE_FORMAT;
+	}
+
+	DosHeader = (PIMAGE_DOS_HEADER) ImageBase;
+	NtHeadersOffset = (ULONG) DosHeader->e_lfanew;
+
+	if (DosHeader->e_magic != IMAGE_DOS_SIGNATURE ||
+		NtHeadersOffset > ImageSize ||
+		ImageSize - NtHeadersOffset < sizeof(IMAGE_NT_HEADERS32)) {
+
+		return STATUS_INVALID_IMAGE_FORMAT;
+	}
+
+	NtHeaders32 = (PIMAGE_NT_HEADERS32) RVA_TO_VA(ImageBase, NtHeadersOffset);
+	NtHeaders64 = (PIMAGE_NT_HEADERS64) NtHeaders32;
+
+	if (NtHeaders32->Signature != IMAGE_NT_SIGNATURE) {
+		return STATUS_INVALID_IMAGE_FORMAT;
+	}
+
+	Rewrite->FileHeader = &NtHeaders32->FileHeader;
+	SizeOfOptionalHeader = Rewrite->FileHeader->SizeOfOptionalHeader;
+
+	//
+	// The few fields used from here on are at the same offsets in the 32 and
+	// 64 bit optional headers, except for the data directories.
+	//
+
+	if (NtHeaders32->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
+		if (ImageSize - NtHeadersOffset < sizeof(IMAGE_NT_HEADERS64)) {
+			return STATUS_INVALID_IMAGE_FORMAT;
+		}
+
+		NumberOfRvaAndSizes = NtHeaders64->OptionalHeader.NumberOfRvaAndSizes;
+		DataDirectoryOffset = FIELD_OFFSET(IMAGE_OPTIONAL_HEADER64, DataDirectory);
+		DataDirectory = NtHeaders64->OptionalHeader.DataDirectory;
+	} else if (NtHeaders32->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC) {
+		NumberOfRvaAndSizes = NtHeaders32->OptionalHeader.NumberOfRvaAndSizes;
+		DataDirectoryOffset = FIELD_OFFSET(IMAGE_OPTIONAL_HEADER32, DataDirectory);
+		DataDirectory = NtHeaders32->OptionalHeader.DataDirectory;
+	} else {
+		return STATUS_INVALID_IMAGE_FORMAT;
+	}
+
+	Rewrite->SizeOfImage = min(NtHeaders32->OptionalHeader.SizeOfImage, ImageSize);
+	Rewrite->SizeOfHeaders = NtHeaders32->OptionalHeader.SizeOfHeaders;
+	Rewrite->SectionAlignment = NtHeaders32->OptionalHeader.SectionAlignment;
+
+	// Only the data directories which are inside the optional header count.
+	if (SizeOfOptionalHeader < DataDirectoryOffset) {
+		return STATUS_INVALID_IMAGE_FORMAT;
+	}
+
+	NumberOfRvaAndSizes = min(
+		NumberOfRvaAndSizes,
+		(SizeOfOptionalHeader - DataDirectoryOffset) / sizeof(IMAGE_DATA_DIRECTORY));
+
+	//
+	// The section headers follow the optional header.
+	//
+
+	SectionHeadersOffset = NtHeadersOffset + FIELD_OFFSET(IMAGE_NT_HEADERS32, OptionalHeader) + SizeOfOptionalHeader;
+
+	if (SectionHeadersOffset > Rewrite->SizeOfImage ||
+		(Rewrite->SizeOfImage - SectionHeadersOffset) / sizeof(IMAGE_SECTION_HEADER) <
+		Rewrite->FileHeader->NumberOfSections) {
+
+		return STATUS_INVALID_IMAGE_FORMAT;
+	}
+
+	Rewrite->SectionHeaders = (PIMAGE_SECTION_HEADER) RVA_TO_VA(ImageBase, SectionHeadersOffset);
+
+	if (Rewrite->SectionAlignment >= PAGE_SIZE) {
+		ULONG PreviousSectionEnd;
+
+		//
+		// The memory manager only maps images whose sections are aligned
+		// and sorted, so that's what the page protection code assumes.
+		//
+
+		if (Rewrite->SectionAlignment & (Rewrite->SectionAlignment - 1)) {
+			return STATUS_INVALID_IMAGE_FORMAT;
+		}
+
+		PreviousSectionEnd = 0;
+
+		for (Index = 0; Index < Rewrite->FileHeader->NumberOfSections; ++Index) {
+			PIMAGE_SECTION_HEADER SectionHeader;
+			ULONG SectionSize;
+
+			SectionHeader = &Rewrite->SectionHeaders[Index];
+			SectionSize = SectionHeader->Misc.VirtualSize;
+
+			if (SectionSize == 0) {
+				SectionSize = SectionHeader->SizeOfRawData;
+			}
+
+			if (SectionHeader->VirtualAddress % Rewrite->SectionAlignment != 0 ||
+				SectionHeader->VirtualAddress < PreviousSectionEnd ||
+				SectionHeader->VirtualAddress > MAXULONG - SectionSize) {
+
+				return STATUS_INVALID_IMAGE_FORMAT;
+			}
+
+			PreviousSectionEnd = SectionHeader->VirtualAddress + SectionSize;
+		}
+	}
+
+	//
+	// Find the import directory. It ends with a descriptor whose Name is 0,
+	// which must be inside the image.
+	//
+
+	if (NumberOfRvaAndSizes <= IMAGE_DIRECTORY_ENTRY_IMPORT ||
+		DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress == 0) {
+		//
+		// There is no import directory in the image (e.g. resource-only DLL).
+		//
+
+		return STATUS_IMAGE_NO_IMPORT_DIRECTORY;
+	}
+
+	if (NumberOfRvaAndSizes > IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT) {
+		Rewrite->BoundImportDirectory = &DataDirectory[IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT];
+	}
+
+	ImportDirectory = &DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+
+	if (ImportDirectory->VirtualAddress >= Rewrite->SizeOfImage) {
+		return STATUS_INVALID_IMAGE_FORMAT;
+	}
+
+	Rewrite->ImportDescriptors = (PIMAGE_IMPORT_DESCRIPTOR) RVA_TO_VA(
+		ImageBase,
+		ImportDirectory->VirtualAddress);
+
+	MaximumNumberOfImportDescriptors =
+		(Rewrite->SizeOfImage - ImportDirectory->VirtualAddress) / sizeof(IMAGE_IMPORT_DESCRIPTOR);
+
+	for (Index = 0; Index < MaximumNumberOfImportDescriptors; ++Index) {
+		if (Rewrite->ImportDescriptors[Index].Name == 0) {
+			break;
+		}
+	}
+
+	if (Index == 0 || Index == MaximumNumberOfImportDescriptors) {
+		//
+		// There shouldn't be an import directory if it has no entries, and
+		// it mustn't run off the end of the image.
+		//
+
+		return STATUS_INVALID_IMAGE_FORMAT;
+	}
+
+	Rewrite->NumberOfImportDescriptors = Index;
+	return STATUS_SUCCESS;
+}
+
+//
+// Find out which import descriptors name a DLL which will be rewritten. This
+// only reads the import directory.
+//
+// If the plan is shareable, it doesn't take overrides into account, since
+// it may be used by other processes. Overrides which remove entries are
+// taken care of when the plan is carried out.
+//
+VOID KexpPlanImportRewrite(
+	IN OUT	PKEX_IMPORT_REWRITE	Rewrite)
+{
+	PKEX_REWRITE_PLAN Plan;
+	ULONG Index;
+
+	Plan = &Rewrite->Plan;
+	Plan->NumberOfRewrites = 0;
+	Plan->Incomplete = FALSE;
+
+	for (Index = 0; Index < Rewrite->NumberOfImportDescriptors; ++Index) {
+		if (Rewrite->PlanIsShareable) {
+			PCSTR DllName;
+			ULONG DllNameCch;
+
+			DllName = KexpGetImportTableDllName(Rewrite, Index, &DllNameCch);
+
+			if (!DllName) {
+				continue;
+			}
+
+			DllNameCch = KexpCleanImportTableDllName(DllName, DllNameCch);
+
+			unless (KexpLookupStaticDllRewriteEntryA(DllName, DllNameCch)) {
+				continue;
+			}
+		} else {
+			KEX_IMPORT_NAME_REWRITE NameRewrite;
+
+			unless (KexpLookupImportTableDllName(Rewrite, Index, &NameRewrite)) {
+				continue;
+			}
+		}
+
+		if (Plan->NumberOfRewrites == ARRAYSIZE(Plan->DescriptorIndices) || Index > MAXUSHORT) {
+			// Rewrite everything the slow way.
+			Plan->Incomplete = TRUE;
+			break;
+		}
+
+		Plan->DescriptorIndices[Plan->NumberOfRewrites++] = (USHORT) Index;
+	}
+}
+
+//
+// Work out which pages have to be writable to carry out the plan, without
+// writing anything. If NumberOfWrites is 0 afterwards, nothing needs to be
+// done to the image at all.
+//
+// Each name in the plan is looked up again, which also applies overrides
+// and guards against a plan from the cache which doesn't match.
+//
+NTSTATUS KexpPrepareImportRewrite(
+	IN OUT	PKEX_IMPORT_REWRITE	Rewrite)
+{
+	NTSTATUS Status;
+	PCKEX_REWRITE_PLAN Plan;
+	ULONG NumberOfCandidates;
+	ULONG Index;
+
+	Plan = &Rewrite->Plan;
+	Rewrite->NumberOfWrites = 0;
+	Rewrite->ClearBoundImportDirectory = FALSE;
+	Rewrite->NumberOfWindows = 0;
+
+	if (Plan->Incomplete) {
+		NumberOfCandidates = Rewrite->NumberOfImportDescriptors;
+	} else {
+		NumberOfCandidates = Plan->NumberOfRewrites;
+	}
+
+	for (Index = 0; Index < NumberOfCandidates; ++Index) {
+		ULONG DescriptorIndex;
+		KEX_IMPORT_NAME_REWRITE NameRewrite;
+
+		DescriptorIndex = Plan->Incomplete ? Index : Plan->DescriptorIndices[Index];
+
+		if (DescriptorIndex >= Rewrite->NumberOfImportDescriptors) {
+			continue;
+		}
+
+		unless (KexpLookupImportTableDllName(Rewrite, DescriptorIndex, &NameRewrite)) {
+			continue;
+		}
+
+		Status = KexpAddImportRewriteRange(
+			Rewrite,
+			(ULONG) VA_TO_RVA(Rewrite->ImageBase, NameRewrite.DllName),
+			NameRewrite.RewrittenDllNameCch + 1);
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+
+		++Rewrite->NumberOfWrites;
+	}
+
+	if (Rewrite->NumberOfWrites == 0) {
+		return STATUS_SUCCESS;
+	}
+
+	//
+	// A Bound Import Directory will cause process initialization to fail if we have rewritten
+	// anything. So we simply zero it out.
+	// Bound imports are a performance optimization, but basically we can't use it because
+	// the bound import addresses are dependent on the "real" function addresses within the
+	// imported DLL - and since we have replaced one or more imported DLLs, these pre-calculated
+	// function addresses are no longer valid, so we just have to delete it.
+	//
+	// Most images don't have one, and then the headers don't need to be
+	// touched.
+	//
+
+	if (Rewrite->BoundImportDirectory &&
+		(Rewrite->BoundImportDirectory->VirtualAddress != 0 || Rewrite->BoundImportDirectory->Size != 0)) {
+
+		Status = KexpAddImportRewriteRange(
+			Rewrite,
+			(ULONG) VA_TO_RVA(Rewrite->ImageBase, Rewrite->BoundImportDirectory),
+			sizeof(IMAGE_DATA_DIRECTORY));
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+
+		Rewrite->ClearBoundImportDirectory = TRUE;
+	}
+
+	//
+	// Sort the windows by RVA, then join neighbours wherever that doesn't
+	// give any page a different protection.
+	//
+
+	for (Index = 1; Index < Rewrite->NumberOfWindows; ++Index) {
+		KEX_REWRITE_WINDOW Window;
+		ULONG InsertionIndex;
+
+		Window = Rewrite->Windows[Index];
+
+		for (InsertionIndex = Index; InsertionIndex != 0; --InsertionIndex) {
+			if (Rewrite->Windows[InsertionIndex - 1].Rva < Window.Rva) {
+				break;
+			}
+
+			Rewrite->Windows[InsertionIndex] = Rewrite->Windows[InsertionIndex - 1];
+		}
+
+		Rewrite->Windows[InsertionIndex] = Window;
+	}
+
+	Index = 0;
+
+	while (Index + 1 < Rewrite->NumberOfWindows) {
+		PKEX_REWRITE_WINDOW Window;
+		PCKEX_REWRITE_WINDOW NextWindow;
+
+		Window = &Rewrite->Windows[Index];
+		NextWindow = &Rewrite->Windows[Index + 1];
+
+		unless (KexpCanJoinRewriteWindows(Rewrite, Window, NextWindow)) {
+			++Index;
+			continue;
+		}
+
+		Window->Size = NextWindow->Rva + NextWindow->Size - Window->Rva;
+
+		RtlMoveMemory(
+			&Rewrite->Windows[Index + 1],
+			&Rewrite->Windows[Index + 2],
+			(Rewrite->NumberOfWindows - Index - 2) * sizeof(KEX_REWRITE_WINDOW));
+
+		--Rewrite->NumberOfWindows;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+STATIC BOOLEAN KexpIsInRewriteWindow(
+	IN	PCKEX_IMPORT_REWRITE	Rewrite,
+	IN	PCVOID					Address,
+	IN	ULONG					Size)
+{
+	ULONG_PTR Rva;
+	ULONG Index;
+
+	Rva = VA_TO_RVA(Rewrite->ImageBase, Address);
+
+	for (Index = 0; Index < Rewrite->NumberOfWindows; ++Index) {
+		PCKEX_REWRITE_WINDOW Window;
+
+		Window = &Rewrite->Windows[Index];
+
+		if (Rva >= Window->Rva && Rva - Window->Rva <= Window->Size &&
+			Size <= Window->Size - (Rva - Window->Rva)) {
+
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+//
+// Carry out a rewrite prepared by KexpPrepareImportRewrite. The caller must
+// have made all of the windows writable.
+//
+// Every write is checked against the windows first. One which is outside
+// of them is counted in NumberOfRejectedWrites and not done, since it would
+// mean that the import directory changed since it was prepared.
+//
+VOID KexpApplyImportRewrite(
+	IN OUT	PKEX_IMPORT_REWRITE	Rewrite)
+{
+	PCKEX_REWRITE_PLAN Plan;
+	ULONG NumberOfCandidates;
+	ULONG Index;
+
+	Plan = &Rewrite->Plan;
+	Rewrite->NumberOfRewrittenNames = 0;
+	Rewrite->NumberOfRejectedWrites = 0;
+
+	if (Plan->Incomplete) {
+		NumberOfCandidates = Rewrite->NumberOfImportDescriptors;
+	} else {
+		NumberOfCandidates = Plan->NumberOfRewrites;
+	}
+
+	for (Index = 0; Index < NumberOfCandidates; ++Index) {
+		ULONG DescriptorIndex;
+		KEX_IMPORT_NAME_REWRITE NameRewrite;
+		ULONG CharacterIndex;
+
+		DescriptorIndex = Plan->Incomplete ? Index : Plan->DescriptorIndices[Index];
+
+		if (DescriptorIndex >= Rewrite->NumberOfImportDescriptors) {
+			continue;
+		}
+
+		unless (KexpLookupImportTableDllName(Rewrite, DescriptorIndex, &NameRewrite)) {
+			continue;
+		}
+
+		unless (KexpIsInRewriteWindow(Rewrite, NameRewrite.DllName, NameRewrite.RewrittenDllNameCch + 1)) {
+			++Rewrite->NumberOfRejectedWrites;
+			ASSERT (FALSE);
+			continue;
+		}
+
+		if (NameRewrite.Override) {
+			KexLogDetailEvent(
+				L"Rewrote DLL import: %hs -> %wZ",
+				NameRewrite.DllName,
+				&NameRewrite.Override->RewrittenDllName);
+		} else {
+			KexLogDetailEvent(
+				L"Rewrote DLL import: %hs -> %hs",
+				NameRewrite.DllName,
+				NameRewrite.RewrittenDllName);
+		}
+
+		for (CharacterIndex = 0; CharacterIndex < NameRewrite.RewrittenDllNameCch; ++CharacterIndex) {
+			if (NameRewrite.Override) {
+				// Override names are plain ASCII, like everything else here.
+				ASSERT (NameRewrite.Override->RewrittenDllName.Buffer[CharacterIndex] < 0x80);
+				NameRewrite.DllName[CharacterIndex] = (CHAR) NameRewrite.Override->RewrittenDllName.Buffer[CharacterIndex];
+			} else {
+				NameRewrite.DllName[CharacterIndex] = NameRewrite.RewrittenDllName[CharacterIndex];
+			}
+		}
+
+		NameRewrite.DllName[NameRewrite.RewrittenDllNameCch] = '\0';
+		++Rewrite->NumberOfRewrittenNames;
+	}
+
+	if (Rewrite->ClearBoundImportDirectory && Rewrite->NumberOfRewrittenNames != 0) {
+		if (KexpIsInRewriteWindow(Rewrite, Rewrite->BoundImportDirectory, sizeof(IMAGE_DATA_DIRECTORY))) {
+			RtlZeroMemory(Rewrite->BoundImportDirectory, sizeof(IMAGE_DATA_DIRECTORY));
+		} else {
+			++Rewrite->NumberOfRejectedWrites;
+			ASSERT (FALSE);
+		}
+	}
+}
+
+#ifndef KEX_ENV_HOST
+NTSTATUS KexpInitializeDllRewriteEngine(
+	VOID)
+{
+#ifdef _DEBUG
+	ULONG Index;
+
+	//
+	// Check that the generated table matches redirects.h, in case someone
+	// forgot to run redirgen after changing it.
+	//
+
+	ASSERT (ARRAYSIZE(DllRedirects) == DLL_REDIRECT_NUMBER_OF_SLOTS);
+
+	ForEachArrayItem (DllRedirects, Index) {
+		PCUNICODE_STRING RewrittenDllName;
+
+		RewrittenDllName = KexpLookupStaticDllRewriteEntry(&DllRedirects[Index][0]);
+
+		ASSERT (RewrittenDllName != NULL);
+		ASSERT (RtlEqualUnicodeString(RewrittenDllName, &DllRedirects[Index][1], FALSE));
+	}
+#endif
+
+	//
+	// Open the rewrite plan cache. Plans are tied to this version of the
+	// table.
+	//
+
+	return KexpOpenRewritePlanCache(DLL_REDIRECT_TABLE_VERSION);
+}
+#endif
\ No newline at end of file
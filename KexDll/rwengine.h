@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     rwengine.h
+//
+// Abstract:
+//
+//     Declarations for the import rewrite engine (rwengine.c).
+//     This header is also used by the host build of rwengine.c, so it must
+//     not depend on anything except the basic types and the PE structures.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Add KexpLookupDllRewriteEntry.
+//     agent                18-Oct-2026  Make room in cached plans for a check
+//                                       of the import directory.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//
+// Which import descriptors of an image name a DLL that gets rewritten.
+// If there are more of them than fit, Incomplete is set and the whole
+// import directory has to be walked instead.
+//
+
+#define KEX_REWRITE_PLAN_MAXIMUM_REWRITES	46
+
+typedef struct _KEX_REWRITE_PLAN {
+	ULONG		NumberOfRewrites;
+	BOOLEAN		Incomplete;
+	USHORT		DescriptorIndices[KEX_REWRITE_PLAN_MAXIMUM_REWRITES];
+} TYPEDEF_TYPE_NAME(KEX_REWRITE_PLAN);
+
+//
+// A range of pages which has to be made writable while the import
+// directory is rewritten. Every page in a window has the same protection,
+// so it can be changed and restored with one call each.
+//
+// Usually the DLL names are all in one section, and the bound import data
+// directory is either empty or in a part of the image which can be covered
+// by the same window, so there is only one.
+//
+
+#define KEX_IMPORT_REWRITE_MAXIMUM_WINDOWS	4
+
+typedef struct _KEX_REWRITE_WINDOW {
+	ULONG		Rva;
+	ULONG		Size;
+} TYPEDEF_TYPE_NAME(KEX_REWRITE_WINDOW);
+
+#define KEX_IMPORT_REWRITE_KERNEL32			1
+
+typedef struct _KEX_IMPORT_REWRITE {
+	PVOID						ImageBase;
+	ULONG						SizeOfImage;
+	ULONG						SizeOfHeaders;
+	ULONG						SectionAlignment;
+	ULONG						Flags;
+	BOOLEAN						PlanIsShareable;
+
+	PIMAGE_FILE_HEADER			FileHeader;
+	PIMAGE_SECTION_HEADER		SectionHeaders;
+	PIMAGE_DATA_DIRECTORY		BoundImportDirectory;		// NULL if there is none
+	PIMAGE_IMPORT_DESCRIPTOR	ImportDescriptors;
+	ULONG						NumberOfImportDescriptors;
+
+	KEX_REWRITE_PLAN			Plan;
+
+	//
+	// Filled in by KexpPrepareImportRewrite.
+	//
+
+	ULONG						NumberOfWrites;
+	BOOLEAN						ClearBoundImportDirectory;
+	ULONG						NumberOfWindows;
+	KEX_REWRITE_WINDOW			Windows[KEX_IMPORT_REWRITE_MAXIMUM_WINDOWS];
+
+	//
+	// Filled in by KexpApplyImportRewrite.
+	//
+
+	ULONG						NumberOfRewrittenNames;
+	ULONG						NumberOfRejectedWrites;		// outside of every window
+} TYPEDEF_TYPE_NAME(KEX_IMPORT_REWRITE);
+
+NTSTATUS KexAddDllRewriteEntry(
+	IN	PCUNICODE_STRING	DllName,
+	IN	PCUNICODE_STRING	RewrittenDllName);
+
+NTSTATUS KexRemoveDllRewriteEntry(
+	IN	PCUNICODE_STRING	DllName);
+
+PCUNICODE_STRING KexpLookupStaticDllRewriteEntry(
+	IN	PCUNICODE_STRING	DllName);
+
+NTSTATUS KexpLookupDllRewriteEntry(
+	IN	PCUNICODE_STRING	DllName,
+	OUT	PUNICODE_STRING		RewrittenDllName);
+
+BOOLEAN KexpLookupDllRewriteOverride(
+	IN	PCUNICODE_STRING	DllName,
+	OUT	PUNICODE_STRING		RewrittenDllName);
+
+NTSTATUS KexpInitializeImportRewrite(
+	IN	PVOID				ImageBase,
+	IN	ULONG				ImageSize,
+	IN	ULONG				Flags,
+	OUT	PKEX_IMPORT_REWRITE	Rewrite);
+
+VOID KexpPlanImportRewrite(
+	IN OUT	PKEX_IMPORT_REWRITE	Rewrite);
+
+NTSTATUS KexpPrepareImportRewrite(
+	IN OUT	PKEX_IMPORT_REWRITE	Rewrite);
+
+VOID KexpApplyImportRewrite(
+	IN OUT	PKEX_IMPORT_REWRITE	Rewrite);
+
+#ifndef KEX_ENV_HOST
+NTSTATUS KexpInitializeDllRewriteEngine(
+	VOID);
+#endif
\ No newline at end of file
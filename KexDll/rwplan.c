@@ -0,0 +1,755 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     rwplan.c
+//
+// Abstract:
+//
+//     A cache of import rewrite plans which is shared between the processes
+//     of a user.
+//
+//     Most DLLs which get loaded are the same ones every time (system DLLs,
+//     and the DLLs of programs which are used often), so there is no need to
+//     walk their import directories and look up every imported DLL name
+//     each time one of them is mapped. Once a process has found out which
+//     import descriptors of an image have to be rewritten, it records that
+//     in a file in the log directory, which every process maps. Nothing is
+//     cached when logging is disabled, since the log directory isn't to be
+//     written to then.
+//
+//     The log directory may be shared by every user of the computer, so each
+//     user has their own file, named after their SID. It is created with the
+//     user as the owner and a DACL which only lets the user, administrators
+//     and SYSTEM in. A file which already exists is only used if the user
+//     owns it and it isn't a link to another file, so another user can't
+//     get a process to use plans that they wrote.
+//
+//     Images are identified by a hash of the full path together with the
+//     TimeDateStamp, SizeOfImage and CheckSum from their headers, so an
+//     image which is replaced by another version gets a new plan. Plans are
+//     also tagged with the version of the DLL redirect table, since a plan
+//     made with a different table can't be used, and with the number of
+//     import descriptors and a hash of where they point, which are checked
+//     against the image before a plan is used instead of walking them.
+//
+//     The file is an open-addressing hash table of fixed size entries with
+//     no lock. Each entry has a sequence number which is odd while a process
+//     is writing to it. Readers copy an entry and check that the sequence
+//     number didn't change in the meantime. A process which dies while
+//     writing leaves the entry odd, and it is never used again.
+//
+//     The cache is only a hint: each rewrite in a plan still looks the name
+//     up, so a wrong plan can at worst cause an import to be missed.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Environment:
+//
+//     Open: during initialization.
+//     Lookup/store: from the DLL notification callback.
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                18-Oct-2026  Keep a separate cache for each user,
+//                                       check plans against the import
+//                                       directory and don't cache anything
+//                                       when logging is disabled.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+#include "redirhash.h"
+
+#define KEX_REWRITE_PLAN_CACHE_FILE_PREFIX		L"RwPlans-"
+#define KEX_REWRITE_PLAN_CACHE_FILE_EXTENSION	L".dat"
+#define KEX_REWRITE_PLAN_CACHE_SIGNATURE		'NPWR'
+#define KEX_REWRITE_PLAN_CACHE_VERSION			2
+#define KEX_REWRITE_PLAN_CACHE_ENTRIES			8192
+#define KEX_REWRITE_PLAN_CACHE_MAXIMUM_PROBES	8
+#define KEX_REWRITE_PLAN_CACHE_PATH_SEED		0x52575054
+
+typedef struct _KEX_REWRITE_PLAN_CACHE_HEADER {
+	ULONG		Signature;					// KEX_REWRITE_PLAN_CACHE_SIGNATURE
+	ULONG		Version;					// KEX_REWRITE_PLAN_CACHE_VERSION
+	ULONG		NumberOfEntries;
+	ULONG		Reserved[29];
+} TYPEDEF_TYPE_NAME(KEX_REWRITE_PLAN_CACHE_HEADER);
+
+typedef struct _KEX_REWRITE_PLAN_CACHE_ENTRY {
+	VOLATILE LONG	Sequence;				// 0 = empty, odd = being written
+	ULONG			TableVersion;			// DLL_REDIRECT_TABLE_VERSION
+	ULONG			PathHash[2];
+	ULONG			TimeDateStamp;
+	ULONG			SizeOfImage;
+	ULONG			CheckSum;
+	ULONG			DescriptorHash;			// see KexpHashImportDescriptors
+	USHORT			NumberOfImportDescriptors;
+	USHORT			NumberOfRewrites;
+	USHORT			DescriptorIndices[KEX_REWRITE_PLAN_MAXIMUM_REWRITES];
+} TYPEDEF_TYPE_NAME(KEX_REWRITE_PLAN_CACHE_ENTRY);
+
+C_ASSERT (sizeof(KEX_REWRITE_PLAN_CACHE_HEADER) == 128);
+C_ASSERT (sizeof(KEX_REWRITE_PLAN_CACHE_ENTRY) == 128);
+
+#define KEX_REWRITE_PLAN_CACHE_SIZE \
+	(sizeof(KEX_REWRITE_PLAN_CACHE_HEADER) + \
+	 KEX_REWRITE_PLAN_CACHE_ENTRIES * sizeof(KEX_REWRITE_PLAN_CACHE_ENTRY))
+
+STATIC PKEX_REWRITE_PLAN_CACHE_HEADER RewritePlanCache = NULL;
+STATIC ULONG RewritePlanTableVersion = 0;
+
+STATIC PKEX_REWRITE_PLAN_CACHE_ENTRY KexpGetRewritePlanCacheEntry(
+	IN	ULONG	Index)
+{
+	ASSERT (RewritePlanCache != NULL);
+	ASSERT (Index < KEX_REWRITE_PLAN_CACHE_ENTRIES);
+
+	return &((PKEX_REWRITE_PLAN_CACHE_ENTRY) (RewritePlanCache + 1))[Index];
+}
+
+//
+// Get the SID of the user which this process runs as.
+//
+
+STATIC NTSTATUS KexpGetRewritePlanCacheUser(
+	OUT	PSID	UserSid,
+	IN	ULONG	UserSidLength)
+{
+	NTSTATUS Status;
+	HANDLE TokenHandle;
+	ULONG ReturnLength;
+
+	struct {
+		TOKEN_USER	TokenUser;
+		BYTE		SidBuffer[SECURITY_MAX_SID_SIZE];
+	} TokenInformation;
+
+	Status = NtOpenProcessToken(
+		NtCurrentProcess(),
+		TOKEN_QUERY,
+		&TokenHandle);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	Status = NtQueryInformationToken(
+		TokenHandle,
+		TokenUser,
+		&TokenInformation,
+		sizeof(TokenInformation),
+		&ReturnLength);
+
+	SafeClose(TokenHandle);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	return RtlCopySid(UserSidLength, UserSid, TokenInformation.TokenUser.User.Sid);
+}
+
+//
+// Check that a cache file which may have been there already is one which
+// this user made, and not a hard link or reparse point which another user
+// has put in its place.
+//
+
+STATIC NTSTATUS KexpCheckRewritePlanCacheFile(
+	IN	HANDLE	FileHandle,
+	IN	PSID	UserSid)
+{
+	NTSTATUS Status;
+	IO_STATUS_BLOCK IoStatusBlock;
+	FILE_BASIC_INFORMATION BasicInformation;
+	FILE_STANDARD_INFORMATION StandardInformation;
+	ULONG SecurityDescriptorBuffer[(sizeof(SECURITY_DESCRIPTOR) + SECURITY_MAX_SID_SIZE) / sizeof(ULONG) + 1];
+	ULONG LengthNeeded;
+	PSID Owner;
+	BOOLEAN OwnerDefaulted;
+
+	Status = NtQueryInformationFile(
+		FileHandle,
+		&IoStatusBlock,
+		&BasicInformation,
+		sizeof(BasicInformation),
+		FileBasicInformation);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	Status = NtQueryInformationFile(
+		FileHandle,
+		&IoStatusBlock,
+		&StandardInformation,
+		sizeof(StandardInformation),
+		FileStandardInformation);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	if ((BasicInformation.FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) ||
+		StandardInformation.NumberOfLinks != 1) {
+
+		return STATUS_FILE_INVALID;
+	}
+
+	if (StandardInformation.EndOfFile.QuadPart != 0 &&
+		StandardInformation.EndOfFile.QuadPart != KEX_REWRITE_PLAN_CACHE_SIZE) {
+
+		return STATUS_FILE_INVALID;
+	}
+
+	Status = NtQuerySecurityObject(
+		FileHandle,
+		OWNER_SECURITY_INFORMATION,
+		(PSECURITY_DESCRIPTOR) SecurityDescriptorBuffer,
+		sizeof(SecurityDescriptorBuffer),
+		&LengthNeeded);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	Status = RtlGetOwnerSecurityDescriptor(
+		(PSECURITY_DESCRIPTOR) SecurityDescriptorBuffer,
+		&Owner,
+		&OwnerDefaulted);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	if (!Owner || !RtlEqualSid(Owner, UserSid)) {
+		return STATUS_INVALID_OWNER;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Open the cache file of the current user in the log directory, creating it
+// if it isn't there yet.
+//
+
+STATIC NTSTATUS KexpOpenRewritePlanCacheFile(
+	OUT	PHANDLE	FileHandle,
+	IN	HANDLE	LogDirHandle)
+{
+	NTSTATUS Status;
+	ULONG UserSidBuffer[SECURITY_MAX_SID_SIZE / sizeof(ULONG)];
+	BYTE SystemSidBuffer[] = {1, 1, 0, 0, 0, 0, 0, 5, 18, 0, 0, 0};
+	BYTE AdministratorsSidBuffer[] = {1, 2, 0, 0, 0, 0, 0, 5, 32, 0, 0, 0, 32, 2, 0, 0};
+	ULONG DaclBuffer[(sizeof(ACL) + 3 * (sizeof(ACCESS_ALLOWED_ACE) + SECURITY_MAX_SID_SIZE)) / sizeof(ULONG)];
+	PSID UserSid;
+	PACL Dacl;
+	SECURITY_DESCRIPTOR SecurityDescriptor;
+	UNICODE_STRING UserSidString;
+	UNICODE_STRING CacheFileName;
+	WCHAR CacheFileNameBuffer[256];
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	IO_STATUS_BLOCK IoStatusBlock;
+
+	*FileHandle = NULL;
+	UserSid = (PSID) UserSidBuffer;
+	Dacl = (PACL) DaclBuffer;
+
+	Status = KexpGetRewritePlanCacheUser(UserSid, sizeof(UserSidBuffer));
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	//
+	// The file name is RwPlans-<SID>.dat.
+	//
+
+	Status = RtlConvertSidToUnicodeString(&UserSidString, UserSid, TRUE);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	RtlInitEmptyUnicodeString(&CacheFileName, CacheFileNameBuffer, sizeof(CacheFileNameBuffer));
+	RtlAppendUnicodeToString(&CacheFileName, KEX_REWRITE_PLAN_CACHE_FILE_PREFIX);
+	RtlAppendUnicodeStringToString(&CacheFileName, &UserSidString);
+	Status = RtlAppendUnicodeToString(&CacheFileName, KEX_REWRITE_PLAN_CACHE_FILE_EXTENSION);
+	RtlFreeUnicodeString(&UserSidString);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	//
+	// Only the user, administrators and SYSTEM get access to a new file. The
+	// DACL is protected so that nothing is inherited from the log directory.
+	//
+
+	Status = RtlCreateAcl(Dacl, sizeof(DaclBuffer), ACL_REVISION);
+	ASSERT (NT_SUCCESS(Status));
+	Status = RtlAddAccessAllowedAce(Dacl, ACL_REVISION, FILE_ALL_ACCESS, UserSid);
+	ASSERT (NT_SUCCESS(Status));
+	Status = RtlAddAccessAllowedAce(Dacl, ACL_REVISION, FILE_ALL_ACCESS, (PSID) AdministratorsSidBuffer);
+	ASSERT (NT_SUCCESS(Status));
+	Status = RtlAddAccessAllowedAce(Dacl, ACL_REVISION, FILE_ALL_ACCESS, (PSID) SystemSidBuffer);
+	ASSERT (NT_SUCCESS(Status));
+
+	Status = RtlCreateSecurityDescriptor(&SecurityDescriptor, SECURITY_DESCRIPTOR_REVISION);
+	ASSERT (NT_SUCCESS(Status));
+	Status = RtlSetOwnerSecurityDescriptor(&SecurityDescriptor, UserSid, FALSE);
+	ASSERT (NT_SUCCESS(Status));
+	Status = RtlSetDaclSecurityDescriptor(&SecurityDescriptor, TRUE, Dacl, FALSE);
+	ASSERT (NT_SUCCESS(Status));
+	Status = RtlSetControlSecurityDescriptor(&SecurityDescriptor, SE_DACL_PROTECTED, SE_DACL_PROTECTED);
+	ASSERT (NT_SUCCESS(Status));
+
+	InitializeObjectAttributes(
+		&ObjectAttributes,
+		&CacheFileName,
+		OBJ_CASE_INSENSITIVE,
+		LogDirHandle,
+		&SecurityDescriptor);
+
+	//
+	// FILE_OPEN_REPARSE_POINT makes a reparse point get opened itself instead
+	// of what it points to, so that KexpCheckRewritePlanCacheFile sees it.
+	//
+
+	Status = NtCreateFile(
+		FileHandle,
+		GENERIC_READ | GENERIC_WRITE,
+		&ObjectAttributes,
+		&IoStatusBlock,
+		NULL,
+		FILE_ATTRIBUTE_NORMAL,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		FILE_OPEN_IF,
+		FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE | FILE_OPEN_REPARSE_POINT,
+		NULL,
+		0);
+
+	if (!NT_SUCCESS(Status)) {
+		*FileHandle = NULL;
+		return Status;
+	}
+
+	Status = KexpCheckRewritePlanCacheFile(*FileHandle, UserSid);
+
+	if (!NT_SUCCESS(Status)) {
+		SafeClose(*FileHandle);
+	}
+
+	return Status;
+}
+
+//
+// Open and map the cache file. TableVersion is the version of the DLL
+// redirect table which the plans of this process are made with.
+//
+
+NTSTATUS KexpOpenRewritePlanCache(
+	IN	ULONG	TableVersion)
+{
+	NTSTATUS Status;
+	UNICODE_STRING LogDir;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	HANDLE LogDirHandle;
+	HANDLE FileHandle;
+	HANDLE SectionHandle;
+	LONGLONG SectionSize;
+	PVOID View;
+	SIZE_T ViewSize;
+	PKEX_REWRITE_PLAN_CACHE_HEADER Header;
+
+	ASSERT (RewritePlanCache == NULL);
+
+	if (KexData->Flags & KEXDATA_FLAG_DISABLE_LOGGING) {
+		// Don't create anything in the log directory.
+		return STATUS_USER_DISABLED;
+	}
+
+	Status = RtlDosPathNameToNtPathName_U_WithStatus(
+		KexData->LogDir.Buffer,
+		&LogDir,
+		NULL,
+		NULL);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	LogDirHandle = NULL;
+	FileHandle = NULL;
+	SectionHandle = NULL;
+	View = NULL;
+
+	try {
+		InitializeObjectAttributes(
+			&ObjectAttributes,
+			&LogDir,
+			OBJ_CASE_INSENSITIVE,
+			NULL,
+			NULL);
+
+		Status = KexRtlCreateDirectoryRecursive(
+			&LogDirHandle,
+			FILE_TRAVERSE,
+			&ObjectAttributes,
+			FILE_SHARE_READ | FILE_SHARE_WRITE);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		Status = KexpOpenRewritePlanCacheFile(&FileHandle, LogDirHandle);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		//
+		// A new (empty) file gets extended to the size of the section. New
+		// parts of the file read as zeroes, which means empty entries.
+		//
+
+		SectionSize = KEX_REWRITE_PLAN_CACHE_SIZE;
+
+		Status = NtCreateSection(
+			&SectionHandle,
+			SECTION_MAP_READ | SECTION_MAP_WRITE,
+			NULL,
+			(PLARGE_INTEGER) &SectionSize,
+			PAGE_READWRITE,
+			SEC_COMMIT,
+			FileHandle);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		ViewSize = KEX_REWRITE_PLAN_CACHE_SIZE;
+
+		Status = NtMapViewOfSection(
+			SectionHandle,
+			NtCurrentProcess(),
+			&View,
+			0,
+			0,
+			NULL,
+			&ViewSize,
+			ViewUnmap,
+			0,
+			PAGE_READWRITE);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		Header = (PKEX_REWRITE_PLAN_CACHE_HEADER) View;
+
+		//
+		// Whoever gets here first with a new file fills in the header. If two
+		// processes do it at the same time, one of them may see the version
+		// before it is written and go without the cache this time.
+		//
+
+		if (InterlockedCompareExchange((PLONG) &Header->Signature, KEX_REWRITE_PLAN_CACHE_SIGNATURE, 0) == 0) {
+			Header->NumberOfEntries = KEX_REWRITE_PLAN_CACHE_ENTRIES;
+			InterlockedExchange((PLONG) &Header->Version, KEX_REWRITE_PLAN_CACHE_VERSION);
+		}
+
+		if (Header->Signature != KEX_REWRITE_PLAN_CACHE_SIGNATURE ||
+			Header->Version != KEX_REWRITE_PLAN_CACHE_VERSION ||
+			Header->NumberOfEntries != KEX_REWRITE_PLAN_CACHE_ENTRIES) {
+
+			Status = STATUS_FILE_INVALID;
+			leave;
+		}
+
+		RewritePlanCache = Header;
+		RewritePlanTableVersion = TableVersion;
+		View = NULL;
+	} except (GetExceptionCode() == STATUS_IN_PAGE_ERROR) {
+		Status = GetExceptionCode();
+	}
+
+	if (View) {
+		NtUnmapViewOfSection(NtCurrentProcess(), View);
+	}
+
+	// The view keeps the section and the file open.
+	SafeClose(SectionHandle);
+	SafeClose(FileHandle);
+	SafeClose(LogDirHandle);
+	RtlFreeUnicodeString(&LogDir);
+
+	return Status;
+}
+
+//
+// Hash where each import descriptor points. This isn't meant to be hard to
+// fool (the file is protected for that), only to notice an import directory
+// which doesn't look like the one the plan was made for.
+//
+
+STATIC ULONG KexpHashImportDescriptors(
+	IN	PCKEX_IMPORT_REWRITE	Rewrite)
+{
+	ULONG Hash;
+	ULONG Index;
+
+	// FNV-1a, a descriptor at a time
+	Hash = 0x811C9DC5;
+
+	for (Index = 0; Index < Rewrite->NumberOfImportDescriptors; ++Index) {
+		Hash ^= Rewrite->ImportDescriptors[Index].Name;
+		Hash *= 0x01000193;
+		Hash ^= Rewrite->ImportDescriptors[Index].FirstThunk;
+		Hash *= 0x01000193;
+	}
+
+	return Hash;
+}
+
+STATIC VOID KexpGetRewritePlanCacheKey(
+	IN	PCUNICODE_STRING				FullImageName,
+	IN	PIMAGE_NT_HEADERS				NtHeaders,
+	IN	PCKEX_IMPORT_REWRITE			Rewrite,
+	OUT	PKEX_REWRITE_PLAN_CACHE_ENTRY	Key)
+{
+	RtlHashUnicodeString(
+		FullImageName,
+		TRUE,
+		HASH_STRING_ALGORITHM_X65599,
+		&Key->PathHash[0]);
+
+	Key->PathHash[1] = KexHashDllRedirectKey(
+		FullImageName->Buffer,
+		KexRtlUnicodeStringCch(FullImageName),
+		KEX_REWRITE_PLAN_CACHE_PATH_SEED);
+
+	Key->TableVersion = RewritePlanTableVersion;
+	Key->TimeDateStamp = NtHeaders->FileHeader.TimeDateStamp;
+	Key->SizeOfImage = NtHeaders->OptionalHeader.SizeOfImage;
+	Key->CheckSum = NtHeaders->OptionalHeader.CheckSum;
+	Key->DescriptorHash = KexpHashImportDescriptors(Rewrite);
+	Key->NumberOfImportDescriptors = (USHORT) Rewrite->NumberOfImportDescriptors;
+}
+
+STATIC BOOLEAN KexpRewritePlanCacheKeysEqual(
+	IN	PCKEX_REWRITE_PLAN_CACHE_ENTRY	Entry1,
+	IN	PCKEX_REWRITE_PLAN_CACHE_ENTRY	Entry2)
+{
+	return (Entry1->TableVersion == Entry2->TableVersion &&
+			Entry1->PathHash[0] == Entry2->PathHash[0] &&
+			Entry1->PathHash[1] == Entry2->PathHash[1] &&
+			Entry1->TimeDateStamp == Entry2->TimeDateStamp &&
+			Entry1->SizeOfImage == Entry2->SizeOfImage &&
+			Entry1->CheckSum == Entry2->CheckSum &&
+			Entry1->DescriptorHash == Entry2->DescriptorHash &&
+			Entry1->NumberOfImportDescriptors == Entry2->NumberOfImportDescriptors);
+}
+
+//
+// Copy an entry out of the cache, if it isn't being written to. Returns
+// the sequence number of the copy, or 0 if there is nothing to copy.
+//
+
+STATIC LONG KexpReadRewritePlanCacheEntry(
+	IN	PKEX_REWRITE_PLAN_CACHE_ENTRY	Entry,
+	OUT	PKEX_REWRITE_PLAN_CACHE_ENTRY	Copy)
+{
+	LONG Sequence;
+
+	Sequence = Entry->Sequence;
+
+	if (Sequence == 0 || (Sequence & 1)) {
+		return 0;
+	}
+
+	MemoryBarrier();
+	RtlCopyMemory(Copy, (PVOID) Entry, sizeof(*Copy));
+	MemoryBarrier();
+
+	if (Entry->Sequence != Sequence) {
+		return 0;
+	}
+
+	return Sequence;
+}
+
+//
+// Look for the rewrite plan of an image in the cache and put it into
+// Rewrite->Plan. Returns FALSE if there isn't one which fits the import
+// directory of the image.
+//
+
+BOOLEAN KexpLookupRewritePlan(
+	IN		PCUNICODE_STRING		FullImageName,
+	IN		PIMAGE_NT_HEADERS		NtHeaders,
+	IN OUT	PKEX_IMPORT_REWRITE		Rewrite)
+{
+	PKEX_REWRITE_PLAN Plan;
+	KEX_REWRITE_PLAN_CACHE_ENTRY Key;
+	ULONG Probe;
+	ULONG RewriteIndex;
+
+	if (!RewritePlanCache || Rewrite->NumberOfImportDescriptors > MAXUSHORT) {
+		return FALSE;
+	}
+
+	Plan = &Rewrite->Plan;
+
+	try {
+		KexpGetRewritePlanCacheKey(FullImageName, NtHeaders, Rewrite, &Key);
+
+		for (Probe = 0; Probe < KEX_REWRITE_PLAN_CACHE_MAXIMUM_PROBES; ++Probe) {
+			KEX_REWRITE_PLAN_CACHE_ENTRY Entry;
+			ULONG Index;
+
+			Index = (Key.PathHash[0] + Probe) % KEX_REWRITE_PLAN_CACHE_ENTRIES;
+
+			unless (KexpReadRewritePlanCacheEntry(KexpGetRewritePlanCacheEntry(Index), &Entry)) {
+				continue;
+			}
+
+			unless (KexpRewritePlanCacheKeysEqual(&Entry, &Key)) {
+				continue;
+			}
+
+			if (Entry.NumberOfRewrites > ARRAYSIZE(Plan->DescriptorIndices)) {
+				// garbage
+				return FALSE;
+			}
+
+			for (RewriteIndex = 0; RewriteIndex < Entry.NumberOfRewrites; ++RewriteIndex) {
+				if (Entry.DescriptorIndices[RewriteIndex] >= Rewrite->NumberOfImportDescriptors) {
+					return FALSE;
+				}
+			}
+
+			Plan->NumberOfRewrites = Entry.NumberOfRewrites;
+			Plan->Incomplete = FALSE;
+
+			RtlCopyMemory(
+				Plan->DescriptorIndices,
+				Entry.DescriptorIndices,
+				Entry.NumberOfRewrites * sizeof(Plan->DescriptorIndices[0]));
+
+			KexLogDebugEvent(
+				L"Found the rewrite plan of %wZ in the cache (%lu rewrites)",
+				FullImageName,
+				Plan->NumberOfRewrites);
+
+			return TRUE;
+		}
+	} except (GetExceptionCode() == STATUS_IN_PAGE_ERROR) {
+		NOTHING;
+	}
+
+	return FALSE;
+}
+
+//
+// Put the rewrite plan of an image into the cache. If all of the entries it
+// could go into are in use, the first one is replaced. Nothing happens if
+// another process is writing to that entry at the same time.
+//
+
+VOID KexpStoreRewritePlan(
+	IN	PCUNICODE_STRING		FullImageName,
+	IN	PIMAGE_NT_HEADERS		NtHeaders,
+	IN	PCKEX_IMPORT_REWRITE	Rewrite)
+{
+	PCKEX_REWRITE_PLAN Plan;
+	KEX_REWRITE_PLAN_CACHE_ENTRY Key;
+	PKEX_REWRITE_PLAN_CACHE_ENTRY Entry;
+	ULONG Probe;
+	LONG Sequence;
+
+	Plan = &Rewrite->Plan;
+
+	ASSERT (!Plan->Incomplete);
+	ASSERT (Plan->NumberOfRewrites <= ARRAYSIZE(Key.DescriptorIndices));
+
+	if (!RewritePlanCache || Rewrite->NumberOfImportDescriptors > MAXUSHORT) {
+		return;
+	}
+
+	try {
+		KexpGetRewritePlanCacheKey(FullImageName, NtHeaders, Rewrite, &Key);
+
+		Entry = NULL;
+
+		for (Probe = 0; Probe < KEX_REWRITE_PLAN_CACHE_MAXIMUM_PROBES; ++Probe) {
+			PKEX_REWRITE_PLAN_CACHE_ENTRY Candidate;
+			KEX_REWRITE_PLAN_CACHE_ENTRY Copy;
+
+			Candidate = KexpGetRewritePlanCacheEntry(
+				(Key.PathHash[0] + Probe) % KEX_REWRITE_PLAN_CACHE_ENTRIES);
+
+			if (Candidate->Sequence == 0) {
+				Entry = Candidate;
+				break;
+			}
+
+			if (KexpReadRewritePlanCacheEntry(Candidate, &Copy)) {
+				if (KexpRewritePlanCacheKeysEqual(&Copy, &Key)) {
+					// another process got here first
+					return;
+				}
+
+				if (Copy.TableVersion != Key.TableVersion) {
+					// left over from a different version of VxKex
+					Entry = Candidate;
+					break;
+				}
+			}
+		}
+
+		if (!Entry) {
+			Entry = KexpGetRewritePlanCacheEntry(Key.PathHash[0] % KEX_REWRITE_PLAN_CACHE_ENTRIES);
+		}
+
+		Sequence = Entry->Sequence;
+
+		if (Sequence & 1) {
+			return;
+		}
+
+		if (InterlockedCompareExchange(&Entry->Sequence, Sequence + 1, Sequence) != Sequence) {
+			return;
+		}
+
+		Entry->TableVersion = Key.TableVersion;
+		Entry->PathHash[0] = Key.PathHash[0];
+		Entry->PathHash[1] = Key.PathHash[1];
+		Entry->TimeDateStamp = Key.TimeDateStamp;
+		Entry->SizeOfImage = Key.SizeOfImage;
+		Entry->CheckSum = Key.CheckSum;
+		Entry->DescriptorHash = Key.DescriptorHash;
+		Entry->NumberOfImportDescriptors = Key.NumberOfImportDescriptors;
+		Entry->NumberOfRewrites = (USHORT) Plan->NumberOfRewrites;
+
+		RtlCopyMemory(
+			Entry->DescriptorIndices,
+			Plan->DescriptorIndices,
+			Plan->NumberOfRewrites * sizeof(Entry->DescriptorIndices[0]));
+
+		// Skip 0 when the sequence number wraps around, since it means empty.
+		Sequence += 2;
+
+		if (Sequence == 0) {
+			Sequence = 2;
+		}
+
+		InterlockedExchange(&Entry->Sequence, Sequence);
+	} except (GetExceptionCode() == STATUS_IN_PAGE_ERROR) {
+		NOTHING;
+	}
+}
\ No newline at end of file
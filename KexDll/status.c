@@ -46,6 +46,7 @@ PCWSTR NTAPI KexRtlNtStatusToString(
 	case STATUS_KEXSETUP_FAILURE:				return L"STATUS_KEXSETUP_FAILURE";
 	case STATUS_IMAGE_SECTION_NOT_FOUND:		return L"STATUS_IMAGE_SECTION_NOT_FOUND";
 	case STATUS_DLL_NOT_IN_SYSTEM_ROOT:			return L"STATUS_DLL_NOT_IN_SYSTEM_ROOT";
+	case STATUS_TEXT_INDEX_NOT_READY:			return L"STATUS_TEXT_INDEX_NOT_READY";
 
 	//
 	// All this other stuff is auto generated with a powershell script
@@ -0,0 +1,523 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     strsrch.c
+//
+// Abstract:
+//
+//     Substring search for UTF-16 text, for callers which search through a
+//     lot of text for the same needle (for example, the text filter in the
+//     log viewer).
+//
+//     The needle is prepared once: it is case folded if the search is case
+//     insensitive, and a Boyer-Moore-Horspool shift table is built for it.
+//     Short needles are then searched for with SSE2 or AVX2, by comparing
+//     the first and last characters of the needle against a whole block of
+//     haystack positions at once and only looking at the rest of the needle
+//     where both of them match. Long needles, and processors without SSE2,
+//     use Horspool.
+//
+//     Case folding is the same as ToUpper in KexStrSafe.h: only the ASCII
+//     letters are folded. This keeps the results the same as StringSearchI.
+//
+//     This file does not use anything from the rest of KexDll (except in
+//     the public wrappers at the end), and can be built on a non-Windows
+//     host with KEX_ENV_HOST defined for testing and benchmarking (see
+//     01-Tests/strsrchtest).
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef KEX_ENV_HOST
+#  include <KexHost.h>
+#  include "strsrch.h"
+#else
+#  include "buildcfg.h"
+#  include "kexdllp.h"
+#endif
+
+//
+// SSE2 can be used on any x86 or x64 compiler. The AVX2 intrinsics need
+// Visual Studio 2012 or later (or gcc/clang on the build host), so with
+// older compilers only the SSE2 path is built.
+//
+
+#if defined(KEX_ENV_HOST)
+#  if defined(__SSE2__)
+#    include <emmintrin.h>
+#    define KEX_SEARCH_SSE2
+#    if defined(__GNUC__)
+#      include <immintrin.h>
+#      define KEX_SEARCH_AVX2
+#      define KEX_TARGET_AVX2 __attribute__((target("avx2")))
+#    endif
+#  endif
+#elif defined(_M_IX86) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define KEX_SEARCH_SSE2
+#  if _MSC_VER >= 1700
+#    include <immintrin.h>
+#    define KEX_SEARCH_AVX2
+#    define KEX_TARGET_AVX2
+#  endif
+#endif
+
+STATIC FORCEINLINE WCHAR KexRtlpFoldCharacter(
+	IN	WCHAR	Character)
+{
+	return (Character >= 'a' && Character <= 'z') ? (WCHAR) (Character - 32) : Character;
+}
+
+//
+// Compare Cch characters of the haystack against the (already folded)
+// needle.
+//
+
+STATIC FORCEINLINE BOOLEAN KexRtlpEqualFolded(
+	IN	PCWCHAR	Haystack,
+	IN	PCWCHAR	Needle,
+	IN	ULONG	Cch,
+	IN	BOOLEAN	CaseInsensitive)
+{
+	ULONG Index;
+
+	unless (CaseInsensitive) {
+		return RtlEqualMemory(Haystack, Needle, Cch * sizeof(WCHAR));
+	}
+
+	for (Index = 0; Index < Cch; ++Index) {
+		if (KexRtlpFoldCharacter(Haystack[Index]) != Needle[Index]) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+STATIC PCWCHAR KexRtlpSearchHorspool(
+	IN	PCKEX_RTL_STRING_SEARCHER	Searcher,
+	IN	PCWSTR						Haystack,
+	IN	ULONG						HaystackCch)
+{
+	ULONG Position;
+	ULONG LastIndex;
+	WCHAR Last;
+	WCHAR Character;
+	BOOLEAN CaseInsensitive;
+
+	CaseInsensitive = (Searcher->Flags & KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE) ? TRUE : FALSE;
+	LastIndex = Searcher->NeedleCch - 1;
+	Last = Searcher->Needle[LastIndex];
+
+	for (Position = 0; Position + LastIndex < HaystackCch; Position += Searcher->Shift[Character & 0xFF]) {
+		Character = Haystack[Position + LastIndex];
+
+		if (CaseInsensitive) {
+			Character = KexRtlpFoldCharacter(Character);
+		}
+
+		if (Character == Last &&
+			KexRtlpEqualFolded(Haystack + Position, Searcher->Needle, LastIndex, CaseInsensitive)) {
+
+			return Haystack + Position;
+		}
+	}
+
+	return NULL;
+}
+
+#ifdef KEX_SEARCH_SSE2
+STATIC FORCEINLINE ULONG KexRtlpLowestSetBit(
+	IN	ULONG	Mask)
+{
+#ifdef KEX_ENV_HOST
+	return __builtin_ctz(Mask);
+#else
+	ULONG Index;
+
+	_BitScanForward(&Index, Mask);
+	return Index;
+#endif
+}
+
+//
+// The candidate positions come out of the block comparisons as a mask with
+// two bits per character. Check the middle of the needle at each of them.
+//
+
+STATIC FORCEINLINE PCWCHAR KexRtlpCheckCandidates(
+	IN	PCKEX_RTL_STRING_SEARCHER	Searcher,
+	IN	PCWSTR						Haystack,
+	IN	ULONG						Mask,
+	IN	BOOLEAN						CaseInsensitive)
+{
+	ULONG LastIndex;
+	PCWCHAR Candidate;
+
+	LastIndex = Searcher->NeedleCch - 1;
+
+	while (Mask) {
+		Candidate = Haystack + KexRtlpLowestSetBit(Mask) / 2;
+
+		if (LastIndex <= 1 ||
+			KexRtlpEqualFolded(Candidate + 1, Searcher->Needle + 1, LastIndex - 1, CaseInsensitive)) {
+
+			return Candidate;
+		}
+
+		// clear both bits belonging to this character
+		Mask &= Mask - 1;
+		Mask &= Mask - 1;
+	}
+
+	return NULL;
+}
+
+STATIC FORCEINLINE __m128i KexRtlpFoldSse2(
+	IN	__m128i	Characters)
+{
+	__m128i IsLowerCase;
+
+	// The comparisons are signed, so characters from U+8000 up are never folded.
+	IsLowerCase = _mm_and_si128(
+		_mm_cmpgt_epi16(Characters, _mm_set1_epi16('a' - 1)),
+		_mm_cmplt_epi16(Characters, _mm_set1_epi16('z' + 1)));
+
+	return _mm_sub_epi16(Characters, _mm_and_si128(IsLowerCase, _mm_set1_epi16(32)));
+}
+
+STATIC PCWCHAR KexRtlpSearchSse2(
+	IN	PCKEX_RTL_STRING_SEARCHER	Searcher,
+	IN	PCWSTR						Haystack,
+	IN	ULONG						HaystackCch)
+{
+	__m128i First;
+	__m128i Last;
+	__m128i BlockFirst;
+	__m128i BlockLast;
+	ULONG Position;
+	ULONG LastIndex;
+	ULONG Mask;
+	PCWCHAR Match;
+	BOOLEAN CaseInsensitive;
+
+	CaseInsensitive = (Searcher->Flags & KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE) ? TRUE : FALSE;
+	LastIndex = Searcher->NeedleCch - 1;
+	First = _mm_set1_epi16((SHORT) Searcher->Needle[0]);
+	Last = _mm_set1_epi16((SHORT) Searcher->Needle[LastIndex]);
+
+	for (Position = 0; Position + LastIndex + 8 <= HaystackCch; Position += 8) {
+		BlockFirst = _mm_loadu_si128((CONST __m128i *) (Haystack + Position));
+		BlockLast = _mm_loadu_si128((CONST __m128i *) (Haystack + Position + LastIndex));
+
+		if (CaseInsensitive) {
+			BlockFirst = KexRtlpFoldSse2(BlockFirst);
+			BlockLast = KexRtlpFoldSse2(BlockLast);
+		}
+
+		Mask = _mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi16(BlockFirst, First),
+			_mm_cmpeq_epi16(BlockLast, Last)));
+
+		if (Mask) {
+			Match = KexRtlpCheckCandidates(Searcher, Haystack + Position, Mask, CaseInsensitive);
+
+			if (Match) {
+				return Match;
+			}
+		}
+	}
+
+	// less than a block left
+	Match = KexRtlpSearchHorspool(Searcher, Haystack + Position, HaystackCch - Position);
+	return Match;
+}
+#endif
+
+#ifdef KEX_SEARCH_AVX2
+STATIC FORCEINLINE KEX_TARGET_AVX2 __m256i KexRtlpFoldAvx2(
+	IN	__m256i	Characters)
+{
+	__m256i IsLowerCase;
+
+	IsLowerCase = _mm256_and_si256(
+		_mm256_cmpgt_epi16(Characters, _mm256_set1_epi16('a' - 1)),
+		_mm256_cmpgt_epi16(_mm256_set1_epi16('z' + 1), Characters));
+
+	return _mm256_sub_epi16(Characters, _mm256_and_si256(IsLowerCase, _mm256_set1_epi16(32)));
+}
+
+STATIC KEX_TARGET_AVX2 PCWCHAR KexRtlpSearchAvx2(
+	IN	PCKEX_RTL_STRING_SEARCHER	Searcher,
+	IN	PCWSTR						Haystack,
+	IN	ULONG						HaystackCch)
+{
+	__m256i First;
+	__m256i Last;
+	__m256i BlockFirst;
+	__m256i BlockLast;
+	ULONG Position;
+	ULONG LastIndex;
+	ULONG Mask;
+	PCWCHAR Match;
+	BOOLEAN CaseInsensitive;
+
+	CaseInsensitive = (Searcher->Flags & KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE) ? TRUE : FALSE;
+	LastIndex = Searcher->NeedleCch - 1;
+	First = _mm256_set1_epi16((SHORT) Searcher->Needle[0]);
+	Last = _mm256_set1_epi16((SHORT) Searcher->Needle[LastIndex]);
+
+	for (Position = 0; Position + LastIndex + 16 <= HaystackCch; Position += 16) {
+		BlockFirst = _mm256_loadu_si256((CONST __m256i *) (Haystack + Position));
+		BlockLast = _mm256_loadu_si256((CONST __m256i *) (Haystack + Position + LastIndex));
+
+		if (CaseInsensitive) {
+			BlockFirst = KexRtlpFoldAvx2(BlockFirst);
+			BlockLast = KexRtlpFoldAvx2(BlockLast);
+		}
+
+		Mask = (ULONG) _mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi16(BlockFirst, First),
+			_mm256_cmpeq_epi16(BlockLast, Last)));
+
+		if (Mask) {
+			Match = KexRtlpCheckCandidates(Searcher, Haystack + Position, Mask, CaseInsensitive);
+
+			if (Match) {
+				return Match;
+			}
+		}
+	}
+
+	// less than a block left
+	Match = KexRtlpSearchSse2(Searcher, Haystack + Position, HaystackCch - Position);
+	return Match;
+}
+#endif
+
+//
+// Find out which search method the processor supports.
+//
+
+KEX_SEARCH_METHOD KexRtlpQuerySearchMethod(
+	VOID)
+{
+#if defined(KEX_SEARCH_AVX2) && defined(KEX_ENV_HOST)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		return SearchMethodAvx2;
+	}
+#elif defined(KEX_SEARCH_AVX2)
+	INT CpuInfo[4];
+
+	//
+	// AVX2 needs support from both the processor and the OS (which must
+	// save the YMM registers on context switches - Windows 7 does this
+	// from SP1 onwards).
+	//
+
+	__cpuid(CpuInfo, 0);
+
+	if (CpuInfo[0] >= 7) {
+		__cpuid(CpuInfo, 1);
+
+		// OSXSAVE and AVX
+		if ((CpuInfo[2] & 0x18000000) == 0x18000000 && (_xgetbv(0) & 6) == 6) {
+			__cpuidex(CpuInfo, 7, 0);
+
+			if (CpuInfo[1] & 0x20) {
+				return SearchMethodAvx2;
+			}
+		}
+	}
+#endif
+
+#if defined(KEX_SEARCH_SSE2) && defined(_M_IX86)
+	unless (SharedUserData->ProcessorFeatures[PF_XMMI64_INSTRUCTIONS_AVAILABLE]) {
+		return SearchMethodHorspool;
+	}
+#endif
+
+#ifdef KEX_SEARCH_SSE2
+	return SearchMethodSse2;
+#else
+	return SearchMethodHorspool;
+#endif
+}
+
+//
+// Prepare a needle for searching. Searcher must have room for at least
+// KEX_SEARCH_SEARCHER_SIZE(NeedleCch) bytes.
+//
+
+VOID KexRtlpInitializeStringSearcher(
+	OUT	PKEX_RTL_STRING_SEARCHER	Searcher,
+	IN	PCWSTR						Needle,
+	IN	ULONG						NeedleCch,
+	IN	ULONG						Flags)
+{
+	ULONG Index;
+
+	ASSERT (Searcher != NULL);
+	ASSERT (NeedleCch <= 0xFFFF);
+
+	Searcher->Flags = Flags;
+	Searcher->NeedleCch = NeedleCch;
+
+	for (Index = 0; Index < NeedleCch; ++Index) {
+		if (Flags & KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE) {
+			Searcher->Needle[Index] = KexRtlpFoldCharacter(Needle[Index]);
+		} else {
+			Searcher->Needle[Index] = Needle[Index];
+		}
+	}
+
+	Searcher->Needle[NeedleCch] = '\0';
+
+	//
+	// Characters which share a low byte share an entry in the shift table,
+	// so each entry has the smallest shift of any of them. Since the shifts
+	// get smaller towards the end of the needle, that's the last one written.
+	//
+
+	for (Index = 0; Index < KEX_SEARCH_SHIFT_TABLE_SIZE; ++Index) {
+		Searcher->Shift[Index] = (USHORT) NeedleCch;
+	}
+
+	for (Index = 0; Index + 1 < NeedleCch; ++Index) {
+		Searcher->Shift[Searcher->Needle[Index] & 0xFF] = (USHORT) (NeedleCch - 1 - Index);
+	}
+
+	if (NeedleCch >= KEX_SEARCH_HORSPOOL_THRESHOLD) {
+		Searcher->Method = SearchMethodHorspool;
+	} else {
+		Searcher->Method = KexRtlpQuerySearchMethod();
+	}
+}
+
+//
+// Returns the address of the first occurrence of the needle in Haystack, or
+// NULL if it isn't there. An empty needle is found at the start.
+//
+
+PCWCHAR KexRtlpSearchString(
+	IN	PCKEX_RTL_STRING_SEARCHER	Searcher,
+	IN	PCWSTR						Haystack,
+	IN	ULONG						HaystackCch)
+{
+	if (Searcher->NeedleCch == 0) {
+		return Haystack;
+	}
+
+	if (Searcher->NeedleCch > HaystackCch) {
+		return NULL;
+	}
+
+	switch (Searcher->Method) {
+#ifdef KEX_SEARCH_AVX2
+	case SearchMethodAvx2:
+		return KexRtlpSearchAvx2(Searcher, Haystack, HaystackCch);
+#endif
+#ifdef KEX_SEARCH_SSE2
+	case SearchMethodSse2:
+		return KexRtlpSearchSse2(Searcher, Haystack, HaystackCch);
+#endif
+	default:
+		return KexRtlpSearchHorspool(Searcher, Haystack, HaystackCch);
+	}
+}
+
+#ifndef KEX_ENV_HOST
+//
+// Create a new string searcher.
+//
+//   StringSearcher
+//     Pointer that receives the address of the opaque string
+//     searcher object.
+//
+//   Needle
+//     The string to search for. The searcher keeps its own copy.
+//
+//   Flags
+//     May contain any of the KEX_RTL_STRING_SEARCHER_* flags.
+//     Invalid flags will cause STATUS_INVALID_PARAMETER_3.
+//
+KEXAPI NTSTATUS NTAPI KexRtlCreateStringSearcher(
+	OUT		PPKEX_RTL_STRING_SEARCHER	StringSearcher,
+	IN		PCUNICODE_STRING			Needle,
+	IN		ULONG						Flags OPTIONAL)
+{
+	PKEX_RTL_STRING_SEARCHER Searcher;
+	ULONG NeedleCch;
+
+	if (!StringSearcher) {
+		return STATUS_INVALID_PARAMETER_1;
+	}
+
+	*StringSearcher = NULL;
+
+	if (!Needle) {
+		return STATUS_INVALID_PARAMETER_2;
+	}
+
+	if (Flags & ~(KEX_RTL_STRING_SEARCHER_FLAGS_VALID_MASK)) {
+		return STATUS_INVALID_PARAMETER_3;
+	}
+
+	NeedleCch = KexRtlUnicodeStringCch(Needle);
+
+	Searcher = (PKEX_RTL_STRING_SEARCHER) SafeAlloc(BYTE, KEX_SEARCH_SEARCHER_SIZE(NeedleCch));
+	if (!Searcher) {
+		return STATUS_NO_MEMORY;
+	}
+
+	KexRtlpInitializeStringSearcher(Searcher, Needle->Buffer, NeedleCch, Flags);
+	*StringSearcher = Searcher;
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Delete a string searcher.
+//
+//   StringSearcher
+//     Pointer to the opaque string searcher object. It is set to NULL.
+//
+KEXAPI NTSTATUS NTAPI KexRtlDeleteStringSearcher(
+	IN		PPKEX_RTL_STRING_SEARCHER	StringSearcher)
+{
+	if (!StringSearcher || !*StringSearcher) {
+		return STATUS_INVALID_PARAMETER_1;
+	}
+
+	SafeFree(*StringSearcher);
+	return STATUS_SUCCESS;
+}
+
+//
+// Search for the needle of a string searcher. Returns the address of the
+// character in Haystack where the needle starts, or NULL if it could not
+// be found. Any number of threads can use the same searcher at once.
+//
+KEXAPI PWCHAR NTAPI KexRtlApplyStringSearcher(
+	IN		PKEX_RTL_STRING_SEARCHER	StringSearcher,
+	IN		PCUNICODE_STRING			Haystack)
+{
+	ASSERT (StringSearcher != NULL);
+	ASSERT (Haystack != NULL);
+
+	return (PWCHAR) KexRtlpSearchString(
+		StringSearcher,
+		Haystack->Buffer,
+		KexRtlUnicodeStringCch(Haystack));
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     strsrch.h
+//
+// Abstract:
+//
+//     Declarations for the UTF-16 substring search engine (strsrch.c).
+//     This header is also used by the host build of strsrch.c, so it must
+//     not depend on anything except the basic types.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//
+// Needles at least this long are searched for with Boyer-Moore-Horspool
+// even when SIMD is available, since the skip distance is big enough to
+// beat looking at every position of the haystack.
+//
+
+#define KEX_SEARCH_HORSPOOL_THRESHOLD	32
+
+// The shift table is indexed by the low byte of each (folded) character.
+#define KEX_SEARCH_SHIFT_TABLE_SIZE		256
+
+// Size of a string searcher for a needle of NeedleCch characters.
+#define KEX_SEARCH_SEARCHER_SIZE(NeedleCch) \
+	(FIELD_OFFSET(KEX_RTL_STRING_SEARCHER, Needle) + ((NeedleCch) + 1) * sizeof(WCHAR))
+
+typedef enum _KEX_SEARCH_METHOD {
+	SearchMethodHorspool,
+	SearchMethodSse2,
+	SearchMethodAvx2,
+	SearchMethodMaximumValue
+} TYPEDEF_TYPE_NAME(KEX_SEARCH_METHOD);
+
+#ifdef KEX_ENV_HOST
+typedef struct _KEX_RTL_STRING_SEARCHER TYPEDEF_TYPE_NAME(KEX_RTL_STRING_SEARCHER);
+#  define KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE 1
+#  define KEX_RTL_STRING_SEARCHER_FLAGS_VALID_MASK (KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE)
+#endif
+
+//
+// A needle which has been prepared for searching. The public API only sees
+// this as an opaque pointer.
+//
+
+struct _KEX_RTL_STRING_SEARCHER {
+	ULONG					Flags;
+	KEX_SEARCH_METHOD		Method;
+	ULONG					NeedleCch;
+	USHORT					Shift[KEX_SEARCH_SHIFT_TABLE_SIZE];	// Horspool bad character shift
+	WCHAR					Needle[ANYSIZE_ARRAY];				// folded if case insensitive
+};
+
+KEX_SEARCH_METHOD KexRtlpQuerySearchMethod(
+	VOID);
+
+VOID KexRtlpInitializeStringSearcher(
+	OUT	PKEX_RTL_STRING_SEARCHER	Searcher,
+	IN	PCWSTR						Needle,
+	IN	ULONG						NeedleCch,
+	IN	ULONG						Flags);
+
+PCWCHAR KexRtlpSearchString(
+	IN	PCKEX_RTL_STRING_SEARCHER	Searcher,
+	IN	PCWSTR						Haystack,
+	IN	ULONG						HaystackCch);
\ No newline at end of file
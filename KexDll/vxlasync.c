@@ -0,0 +1,607 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxlasync.c
+//
+// Abstract:
+//
+//     Asynchronous (buffered) write mode for log files.
+//
+//     Instead of taking the log lock and calling NtWriteFile for every entry,
+//     each writer copies its entry into one of a fixed number of ring buffers
+//     which is chosen by thread ID. Space in a ring is reserved with a single
+//     compare-exchange, so writers on different threads never wait on each
+//     other, and nothing on the write path touches the heap.
+//
+//     A background flusher thread drains the rings, merges the entries into
+//     time stamp order and writes them to the file in large batches.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  VxlFlushLog also flushes compressed blocks
+//     agent                17-Oct-2026  Write out compressed blocks which get too old
+//     agent                18-Oct-2026  Add VxlpFlushLogNoWait for crashes
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+
+#define VXL_ASYNC_RECORD_FREE		0
+#define VXL_ASYNC_RECORD_COMMITTED	1
+#define VXL_ASYNC_RECORD_PADDING	2
+
+//
+// Every entry in a ring is preceded by this header. The size is always a
+// multiple of 8 so that the VXLLOGFILEENTRY which follows is aligned.
+// State is written last by the producer, and the consumer will not look
+// at anything else in the record until it sees a non-free state.
+//
+
+typedef struct _VXLASYNCRECORD {
+	ULONG			Size;
+	LONG VOLATILE	State;
+} TYPEDEF_TYPE_NAME(VXLASYNCRECORD);
+
+STATIC INLINE ULONG VxlpAsyncRecordSize(
+	IN	ULONG	FileEntryCb)
+{
+	return (sizeof(VXLASYNCRECORD) + FileEntryCb + 7) & ~7;
+}
+
+STATIC INLINE PVXLASYNCRING VxlpAsyncRingForCurrentThread(
+	IN	PVXLASYNCCONTEXT	AsyncContext)
+{
+	ULONG ThreadId;
+
+	// Thread IDs are always multiples of 4.
+	ThreadId = HandleToUlong(NtCurrentTeb()->ClientId.UniqueThread);
+	return &AsyncContext->Rings[(ThreadId >> 2) % VXL_ASYNC_RING_COUNT];
+}
+
+//
+// Reserve RecordCb contiguous bytes in the ring. If the record will not fit
+// before the end of the buffer, the remaining space at the end is filled with
+// a padding record and the reservation starts at the beginning of the buffer.
+//
+// Returns FALSE if the ring does not currently have enough free space.
+//
+
+STATIC BOOLEAN VxlpAsyncReserveRecord(
+	IN	PVXLASYNCRING		Ring,
+	IN	ULONG				RecordCb,
+	OUT	PPVXLASYNCRECORD	Record,
+	OUT	PBOOLEAN			CrossedHalfFull)
+{
+	ULONG Head;
+	ULONG Tail;
+	ULONG Offset;
+	ULONG Contiguous;
+	ULONG Needed;
+
+	ASSERT (Ring != NULL);
+	ASSERT (RecordCb <= VXL_ASYNC_MAXIMUM_RECORD_SIZE);
+	ASSERT (Record != NULL);
+	ASSERT (CrossedHalfFull != NULL);
+
+	do {
+		Head = Ring->Head;
+		Tail = Ring->Tail;
+		Offset = Head & (VXL_ASYNC_RING_SIZE - 1);
+		Contiguous = VXL_ASYNC_RING_SIZE - Offset;
+		Needed = RecordCb;
+
+		if (Contiguous < RecordCb) {
+			Needed += Contiguous;
+		}
+
+		if (Head - Tail + Needed > VXL_ASYNC_RING_SIZE) {
+			return FALSE;
+		}
+	} until (InterlockedCompareExchange(
+		(PLONG) &Ring->Head,
+		(LONG) (Head + Needed),
+		(LONG) Head) == (LONG) Head);
+
+	if (Needed != RecordCb) {
+		PVXLASYNCRECORD Padding;
+
+		Padding = (PVXLASYNCRECORD) (Ring->Buffer + Offset);
+		Padding->Size = Contiguous;
+		InterlockedExchange(&Padding->State, VXL_ASYNC_RECORD_PADDING);
+		Offset = 0;
+	}
+
+	*Record = (PVXLASYNCRECORD) (Ring->Buffer + Offset);
+	*CrossedHalfFull = (Head - Tail <= VXL_ASYNC_RING_SIZE / 2 &&
+						Head - Tail + Needed > VXL_ASYNC_RING_SIZE / 2);
+
+	return TRUE;
+}
+
+//
+// Return the oldest committed record in the ring, or NULL if there is
+// none. Padding records encountered along the way are released.
+// Must be called with the flush lock held.
+//
+
+STATIC PVXLASYNCRECORD VxlpAsyncPeekRecord(
+	IN	PVXLASYNCRING		Ring)
+{
+	PVXLASYNCRECORD Record;
+
+	while (Ring->Tail != Ring->Head) {
+		Record = (PVXLASYNCRECORD) (Ring->Buffer + (Ring->Tail & (VXL_ASYNC_RING_SIZE - 1)));
+
+		if (Record->State == VXL_ASYNC_RECORD_COMMITTED) {
+			return Record;
+		} else if (Record->State == VXL_ASYNC_RECORD_PADDING) {
+			ULONG Size;
+
+			Size = Record->Size;
+			RtlZeroMemory(Record, Size);
+			InterlockedExchangeAdd((PLONG) &Ring->Tail, Size);
+		} else {
+			// Reserved, but the producer hasn't finished copying yet.
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+//
+// Give the space occupied by a record back to producers. The whole record
+// is zeroed first, so that a stale state value can never be mistaken for a
+// committed record once the space is reused with different boundaries.
+//
+
+STATIC VOID VxlpAsyncReleaseRecord(
+	IN	PVXLASYNCRING		Ring,
+	IN	PVXLASYNCRECORD		Record)
+{
+	ULONG Size;
+
+	ASSERT (Record == (PVXLASYNCRECORD) (Ring->Buffer + (Ring->Tail & (VXL_ASYNC_RING_SIZE - 1))));
+
+	Size = Record->Size;
+	RtlZeroMemory(Record, Size);
+	InterlockedExchangeAdd((PLONG) &Ring->Tail, Size);
+}
+
+//
+// Move everything that is currently committed in the rings out to the file.
+// Must be called with the flush lock held.
+//
+
+STATIC NTSTATUS VxlpAsyncDrain(
+	IN	VXLHANDLE	LogHandle)
+{
+	NTSTATUS Status;
+	PVXLASYNCCONTEXT AsyncContext;
+	ULONG SeverityCounts[LogSeverityMaximumValue];
+	ULONG BatchCb;
+	ULONG DrainedCb;
+	ULONG Index;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->AsyncContext != NULL);
+
+	AsyncContext = LogHandle->AsyncContext;
+	Status = STATUS_SUCCESS;
+	BatchCb = 0;
+	DrainedCb = 0;
+	RtlZeroMemory(SeverityCounts, sizeof(SeverityCounts));
+
+	//
+	// Don't let busy producers keep us in here forever - stop after we have
+	// drained the equivalent of every ring once.
+	//
+
+	while (DrainedCb < VXL_ASYNC_RING_COUNT * VXL_ASYNC_RING_SIZE) {
+		PVXLASYNCRING OldestRing;
+		PVXLASYNCRECORD OldestRecord;
+		PVXLLOGFILEENTRY OldestEntry;
+		ULONG EntryCb;
+
+		//
+		// Each ring is already in order, so pick whichever ring has the
+		// oldest entry at its tail.
+		//
+
+		OldestRing = NULL;
+		OldestRecord = NULL;
+		OldestEntry = NULL;
+
+		ForEachArrayItem (AsyncContext->Rings, Index) {
+			PVXLASYNCRECORD Record;
+			PVXLLOGFILEENTRY Entry;
+
+			Record = VxlpAsyncPeekRecord(&AsyncContext->Rings[Index]);
+
+			if (!Record) {
+				continue;
+			}
+
+			Entry = (PVXLLOGFILEENTRY) (Record + 1);
+
+			if (!OldestEntry || Entry->Time64 < OldestEntry->Time64) {
+				OldestRing = &AsyncContext->Rings[Index];
+				OldestRecord = Record;
+				OldestEntry = Entry;
+			}
+		}
+
+		if (!OldestEntry) {
+			break;
+		}
+
+		EntryCb = OldestEntry->RecordSize;
+		ASSERT (EntryCb <= OldestRecord->Size - sizeof(VXLASYNCRECORD));
+
+		if (BatchCb + EntryCb > VXL_ASYNC_BATCH_SIZE) {
+			Status = VxlpAppendLogFileEntries(LogHandle, AsyncContext->BatchBuffer, BatchCb, SeverityCounts);
+			BatchCb = 0;
+			RtlZeroMemory(SeverityCounts, sizeof(SeverityCounts));
+		}
+
+		RtlCopyMemory(AsyncContext->BatchBuffer + BatchCb, OldestEntry, EntryCb);
+		BatchCb += EntryCb;
+
+		if (OldestEntry->Severity >= 0 && OldestEntry->Severity < LogSeverityMaximumValue) {
+			++SeverityCounts[OldestEntry->Severity];
+		}
+
+		DrainedCb += OldestRecord->Size;
+		VxlpAsyncReleaseRecord(OldestRing, OldestRecord);
+	}
+
+	if (BatchCb != 0) {
+		Status = VxlpAppendLogFileEntries(LogHandle, AsyncContext->BatchBuffer, BatchCb, SeverityCounts);
+	}
+
+	return Status;
+}
+
+//
+// Move everything in the rings to the file, or into the current block in
+// compressed mode. The block itself is left alone, so that the periodic
+// flushes don't produce lots of tiny blocks. The flusher thread writes it
+// out separately once it is VXL_BLOCK_MAXIMUM_AGE old.
+//
+
+STATIC NTSTATUS VxlpAsyncFlush(
+	IN	VXLHANDLE	LogHandle)
+{
+	NTSTATUS Status;
+	PVXLASYNCCONTEXT AsyncContext;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->AsyncContext != NULL);
+
+	AsyncContext = LogHandle->AsyncContext;
+
+	RtlAcquireSRWLockExclusive(&AsyncContext->FlushLock);
+	Status = VxlpAsyncDrain(LogHandle);
+	RtlReleaseSRWLockExclusive(&AsyncContext->FlushLock);
+
+	return Status;
+}
+
+STATIC NTSTATUS NTAPI VxlpAsyncFlusherThreadProc(
+	IN	PVOID	Parameter)
+{
+	VXLHANDLE LogHandle;
+	PVXLASYNCCONTEXT AsyncContext;
+	LARGE_INTEGER Timeout;
+
+	LogHandle = (VXLHANDLE) Parameter;
+	AsyncContext = LogHandle->AsyncContext;
+	Timeout.QuadPart = -(VXL_ASYNC_FLUSH_INTERVAL * 10000LL);
+
+	until (AsyncContext->ShutdownRequested) {
+		NtWaitForSingleObject(AsyncContext->WakeEvent, FALSE, &Timeout);
+		VxlpAsyncFlush(LogHandle);
+		VxlpFlushOldBlock(LogHandle, VXL_BLOCK_MAXIMUM_AGE);
+	}
+
+	// Nothing in this thread touches LogHandle after this point.
+	RtlExitUserThread(STATUS_SUCCESS);
+}
+
+//
+// Force all log entries which have been buffered by VxlWriteLogEx out to
+// the log file. This function does nothing (and succeeds) if the log was
+// not opened with VXL_OPEN_ASYNCHRONOUS_WRITE or VXL_OPEN_COMPRESSED.
+//
+// Entries which are still being copied into a buffer by another thread
+// at the time of the call may not be written.
+//
+NTSTATUS NTAPI VxlFlushLog(
+	IN	VXLHANDLE	LogHandle)
+{
+	NTSTATUS Status;
+	NTSTATUS BlockStatus;
+
+	if (!LogHandle) {
+		return STATUS_INVALID_HANDLE;
+	}
+
+	Status = STATUS_SUCCESS;
+
+	if (LogHandle->AsyncContext) {
+		Status = VxlpAsyncFlush(LogHandle);
+	}
+
+	// Write out the partly filled block, even though it compresses worse.
+	BlockStatus = VxlpFlushBlock(LogHandle);
+
+	if (NT_SUCCESS(Status)) {
+		Status = BlockStatus;
+	}
+
+	return Status;
+}
+
+//
+// Called from VxlWriteLogEx once the entry has been formatted and its
+// source indices have been filled in.
+//
+
+//
+// Like VxlFlushLog, but never waits for a lock. Called when the process may
+// be about to crash, in which case the thread that holds a lock may be the
+// one which crashed, or may never run again. Whatever can't be written out
+// without waiting is lost.
+//
+
+VOID VxlpFlushLogNoWait(
+	IN	VXLHANDLE	LogHandle)
+{
+	PVXLASYNCCONTEXT AsyncContext;
+
+	if (!LogHandle) {
+		return;
+	}
+
+	AsyncContext = LogHandle->AsyncContext;
+
+	if (AsyncContext && AsyncContext->BatchBuffer &&
+		RtlTryAcquireSRWLockExclusive(&AsyncContext->FlushLock)) {
+
+		VxlpAsyncDrain(LogHandle);
+		RtlReleaseSRWLockExclusive(&AsyncContext->FlushLock);
+	}
+
+	VxlpTryFlushBlock(LogHandle);
+}
+
+NTSTATUS VxlpAsyncWriteLogFileEntry(
+	IN	VXLHANDLE			LogHandle,
+	IN	PCVXLLOGFILEENTRY	FileEntry,
+	IN	ULONG				FileEntryCb)
+{
+	PVXLASYNCCONTEXT AsyncContext;
+	ULONG SeverityCounts[LogSeverityMaximumValue];
+	ULONG RecordCb;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->AsyncContext != NULL);
+	ASSERT (FileEntry != NULL);
+
+	AsyncContext = LogHandle->AsyncContext;
+	RecordCb = VxlpAsyncRecordSize(FileEntryCb);
+
+	if (RecordCb <= VXL_ASYNC_MAXIMUM_RECORD_SIZE) {
+		PVXLASYNCRING Ring;
+		PVXLASYNCRECORD Record;
+		BOOLEAN CrossedHalfFull;
+		ULONG Attempt;
+
+		Ring = VxlpAsyncRingForCurrentThread(AsyncContext);
+
+		for (Attempt = 0; Attempt < 3; ++Attempt) {
+			if (VxlpAsyncReserveRecord(Ring, RecordCb, &Record, &CrossedHalfFull)) {
+				Record->Size = RecordCb;
+				RtlCopyMemory(Record + 1, FileEntry, FileEntryCb);
+				InterlockedExchange(&Record->State, VXL_ASYNC_RECORD_COMMITTED);
+
+				if (CrossedHalfFull) {
+					NtSetEvent(AsyncContext->WakeEvent, NULL);
+				}
+
+				return STATUS_SUCCESS;
+			}
+
+			//
+			// The ring is full. Rather than wait for the flusher thread to get
+			// around to it, drain the rings ourselves.
+			//
+
+			VxlpAsyncFlush(LogHandle);
+		}
+	}
+
+	//
+	// Either the entry is too big to go through a ring, or the ring is still
+	// full after draining it (some other thread has reserved space but not
+	// finished copying its entry). Write it out directly.
+	//
+
+	ASSERT (FileEntry->Severity >= 0 && FileEntry->Severity < LogSeverityMaximumValue);
+
+	RtlZeroMemory(SeverityCounts, sizeof(SeverityCounts));
+	++SeverityCounts[FileEntry->Severity];
+
+	return VxlpAppendLogFileEntries(LogHandle, FileEntry, FileEntryCb, SeverityCounts);
+}
+
+NTSTATUS VxlpCreateAsyncContext(
+	IN	VXLHANDLE	LogHandle)
+{
+	NTSTATUS Status;
+	PVXLASYNCCONTEXT AsyncContext;
+	PVOID RegionBase;
+	SIZE_T RegionSize;
+	ULONG Index;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->OpenMode == GENERIC_WRITE);
+	ASSERT (LogHandle->AsyncContext == NULL);
+
+	AsyncContext = SafeAlloc(VXLASYNCCONTEXT, 1);
+	if (!AsyncContext) {
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlZeroMemory(AsyncContext, sizeof(*AsyncContext));
+	RtlInitializeSRWLock(&AsyncContext->FlushLock);
+	LogHandle->AsyncContext = AsyncContext;
+
+	//
+	// All ring buffers and the batch buffer come from a single allocation.
+	// Fresh pages are zeroed, which every ring relies on.
+	//
+
+	RegionBase = NULL;
+	RegionSize = (VXL_ASYNC_RING_COUNT * VXL_ASYNC_RING_SIZE) + VXL_ASYNC_BATCH_SIZE;
+
+	Status = NtAllocateVirtualMemory(
+		NtCurrentProcess(),
+		&RegionBase,
+		0,
+		&RegionSize,
+		MEM_RESERVE | MEM_COMMIT,
+		PAGE_READWRITE);
+
+	if (!NT_SUCCESS(Status)) {
+		VxlpDestroyAsyncContext(LogHandle);
+		return Status;
+	}
+
+	ForEachArrayItem (AsyncContext->Rings, Index) {
+		AsyncContext->Rings[Index].Buffer = (PBYTE) RegionBase + (Index * VXL_ASYNC_RING_SIZE);
+	}
+
+	AsyncContext->BatchBuffer = (PBYTE) RegionBase + (VXL_ASYNC_RING_COUNT * VXL_ASYNC_RING_SIZE);
+
+	Status = NtCreateEvent(
+		&AsyncContext->WakeEvent,
+		EVENT_ALL_ACCESS,
+		NULL,
+		SynchronizationEvent,
+		FALSE);
+
+	if (!NT_SUCCESS(Status)) {
+		VxlpDestroyAsyncContext(LogHandle);
+		return Status;
+	}
+
+	Status = RtlCreateUserThread(
+		NtCurrentProcess(),
+		NULL,
+		FALSE,
+		0,
+		0,
+		0,
+		VxlpAsyncFlusherThreadProc,
+		LogHandle,
+		&AsyncContext->FlusherThread,
+		NULL);
+
+	if (!NT_SUCCESS(Status)) {
+		AsyncContext->FlusherThread = NULL;
+		VxlpDestroyAsyncContext(LogHandle);
+		return Status;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Stop the flusher thread, write out anything still buffered and free the
+// async context. After this returns, the log handle is in synchronous mode.
+//
+
+VOID VxlpDestroyAsyncContext(
+	IN	VXLHANDLE	LogHandle)
+{
+	NTSTATUS Status;
+	PVXLASYNCCONTEXT AsyncContext;
+	BOOLEAN FlusherStopped;
+
+	ASSERT (LogHandle != NULL);
+
+	AsyncContext = LogHandle->AsyncContext;
+
+	if (!AsyncContext) {
+		return;
+	}
+
+	FlusherStopped = TRUE;
+
+	if (AsyncContext->FlusherThread) {
+		LARGE_INTEGER Timeout;
+
+		AsyncContext->ShutdownRequested = TRUE;
+		NtSetEvent(AsyncContext->WakeEvent, NULL);
+
+		//
+		// During process exit the flusher thread has already been terminated,
+		// so this wait completes immediately. The timeout is only there so
+		// that we can't hang forever if the flusher is somehow stuck.
+		//
+
+		Timeout.QuadPart = -(5000 * 10000LL);
+		Status = NtWaitForSingleObject(AsyncContext->FlusherThread, FALSE, &Timeout);
+
+		if (Status != STATUS_WAIT_0) {
+			FlusherStopped = FALSE;
+		}
+
+		SafeClose(AsyncContext->FlusherThread);
+	}
+
+	//
+	// If the flusher was terminated in the middle of a flush, the flush lock
+	// will never be released. Don't wait on it in that case - losing the last
+	// few entries is better than hanging the process on exit.
+	//
+
+	if (AsyncContext->BatchBuffer &&
+		RtlTryAcquireSRWLockExclusive(&AsyncContext->FlushLock)) {
+
+		VxlpAsyncDrain(LogHandle);
+		RtlReleaseSRWLockExclusive(&AsyncContext->FlushLock);
+	}
+
+	LogHandle->AsyncContext = NULL;
+
+	if (!FlusherStopped) {
+		// The flusher may still be using the buffers. Leak them.
+		return;
+	}
+
+	if (AsyncContext->Rings[0].Buffer) {
+		PVOID RegionBase;
+		SIZE_T RegionSize;
+
+		RegionBase = AsyncContext->Rings[0].Buffer;
+		RegionSize = 0;
+
+		NtFreeVirtualMemory(
+			NtCurrentProcess(),
+			&RegionBase,
+			&RegionSize,
+			MEM_RELEASE);
+	}
+
+	SafeClose(AsyncContext->WakeEvent);
+	SafeFree(AsyncContext);
+}
\ No newline at end of file
@@ -0,0 +1,618 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxlblock.c
+//
+// Abstract:
+//
+//     Compressed log files (VXL_OPEN_COMPRESSED).
+//
+//     When writing, log entries are collected in memory until there are
+//     about VXL_BLOCK_SIZE bytes of them, and then the whole block is
+//     compressed (see vxlcomp.c) and written out as a single record.
+//
+//     When reading, only the headers of the block records are looked at
+//     while the log is being opened. A block is decompressed the first time
+//     one of the entries inside it is read, and stays decompressed until the
+//     log is closed.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Support incremental indexing.
+//     agent                17-Oct-2026  Look up ranges of entries at once.
+//     agent                17-Oct-2026  Let the flusher write out old blocks.
+//     agent                18-Oct-2026  Add VxlpTryFlushBlock.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+
+C_ASSERT (VXL_BLOCK_SIZE <= 0xFFFF - sizeof(VXLLOGFILEBLOCK) - 1);
+
+NTSTATUS VxlpCreateBlockContext(
+	IN	VXLHANDLE	LogHandle)
+{
+	PVXLBLOCKCONTEXT BlockContext;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->OpenMode == GENERIC_WRITE);
+	ASSERT (LogHandle->BlockContext == NULL);
+
+	BlockContext = SafeAlloc(VXLBLOCKCONTEXT, 1);
+	if (!BlockContext) {
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlInitializeSRWLock(&BlockContext->Lock);
+	BlockContext->BufferCb = 0;
+	BlockContext->EntryCount = 0;
+	BlockContext->FirstEntryTime = 0;
+	RtlZeroMemory(BlockContext->SeverityCounts, sizeof(BlockContext->SeverityCounts));
+
+	LogHandle->BlockContext = BlockContext;
+	return STATUS_SUCCESS;
+}
+
+//
+// Compress the current block and write it to the file. Must be called with
+// the block lock held. The block is emptied even if it couldn't be written,
+// since there is no reason to think that trying again will work any better.
+//
+
+STATIC NTSTATUS VxlpFlushBlockLocked(
+	IN	VXLHANDLE	LogHandle)
+{
+	NTSTATUS Status;
+	PVXLBLOCKCONTEXT BlockContext;
+	PVXLLOGFILEBLOCK Block;
+	ULONG DataCb;
+	ULONG RecordCb;
+
+	BlockContext = LogHandle->BlockContext;
+
+	if (BlockContext->BufferCb == 0) {
+		return STATUS_SUCCESS;
+	}
+
+	Block = (PVXLLOGFILEBLOCK) BlockContext->RecordBuffer;
+
+	//
+	// If the data doesn't get any smaller, store it as it is.
+	//
+
+	Status = VxlpCompressBlock(
+		BlockContext->Buffer,
+		BlockContext->BufferCb,
+		Block->Data,
+		BlockContext->BufferCb - 1,
+		&DataCb,
+		BlockContext->WorkSpace);
+
+	if (!NT_SUCCESS(Status)) {
+		RtlCopyMemory(Block->Data, BlockContext->Buffer, BlockContext->BufferCb);
+		DataCb = BlockContext->BufferCb;
+	}
+
+	// Keep the records which follow this one 2-byte aligned.
+	RecordCb = FIELD_OFFSET(VXLLOGFILEBLOCK, Data) + DataCb;
+
+	if (RecordCb & 1) {
+		Block->Data[DataCb] = 0;
+		++RecordCb;
+	}
+
+	Block->RecordType = VXL_RECORD_COMPRESSED_BLOCK;
+	Block->RecordSize = (USHORT) RecordCb;
+	Block->DataCb = (USHORT) DataCb;
+	Block->UncompressedCb = (USHORT) BlockContext->BufferCb;
+	Block->EntryCount = BlockContext->EntryCount;
+
+	Status = VxlpAppendLogFileRecords(
+		LogHandle,
+		Block,
+		RecordCb,
+		BlockContext->SeverityCounts);
+
+	BlockContext->BufferCb = 0;
+	BlockContext->EntryCount = 0;
+	RtlZeroMemory(BlockContext->SeverityCounts, sizeof(BlockContext->SeverityCounts));
+
+	return Status;
+}
+
+NTSTATUS VxlpFlushBlock(
+	IN	VXLHANDLE	LogHandle)
+{
+	NTSTATUS Status;
+	PVXLBLOCKCONTEXT BlockContext;
+
+	ASSERT (LogHandle != NULL);
+
+	BlockContext = LogHandle->BlockContext;
+
+	if (!BlockContext) {
+		return STATUS_SUCCESS;
+	}
+
+	RtlAcquireSRWLockExclusive(&BlockContext->Lock);
+	Status = VxlpFlushBlockLocked(LogHandle);
+	RtlReleaseSRWLockExclusive(&BlockContext->Lock);
+
+	return Status;
+}
+
+//
+// Write out the current block, unless another thread is using it. For use
+// when the process may be about to crash, since the thread which holds the
+// lock may never release it.
+//
+
+VOID VxlpTryFlushBlock(
+	IN	VXLHANDLE	LogHandle)
+{
+	PVXLBLOCKCONTEXT BlockContext;
+
+	ASSERT (LogHandle != NULL);
+
+	BlockContext = LogHandle->BlockContext;
+
+	if (BlockContext && RtlTryAcquireSRWLockExclusive(&BlockContext->Lock)) {
+		VxlpFlushBlockLocked(LogHandle);
+		RtlReleaseSRWLockExclusive(&BlockContext->Lock);
+	}
+}
+
+//
+// Write out the current block if its first entry went into it more than
+// MaximumAge milliseconds ago. Called periodically by the asynchronous
+// flusher, so that a program which logs a little and then crashes doesn't
+// take a whole block of entries with it.
+//
+
+NTSTATUS VxlpFlushOldBlock(
+	IN	VXLHANDLE	LogHandle,
+	IN	ULONG		MaximumAge)
+{
+	NTSTATUS Status;
+	PVXLBLOCKCONTEXT BlockContext;
+	LONGLONG CurrentTime;
+
+	ASSERT (LogHandle != NULL);
+
+	BlockContext = LogHandle->BlockContext;
+
+	if (!BlockContext) {
+		return STATUS_SUCCESS;
+	}
+
+	Status = STATUS_SUCCESS;
+	NtQuerySystemTime((PLARGE_INTEGER) &CurrentTime);
+
+	RtlAcquireSRWLockExclusive(&BlockContext->Lock);
+
+	if (BlockContext->BufferCb != 0 &&
+		CurrentTime - BlockContext->FirstEntryTime >= MaximumAge * 10000LL) {
+
+		Status = VxlpFlushBlockLocked(LogHandle);
+	}
+
+	RtlReleaseSRWLockExclusive(&BlockContext->Lock);
+
+	return Status;
+}
+
+//
+// Write out whatever is left in the current block, and free the block
+// context. The asynchronous context, if any, must already have been
+// destroyed, since it writes into the block.
+//
+
+VOID VxlpDestroyBlockContext(
+	IN	VXLHANDLE	LogHandle)
+{
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->AsyncContext == NULL);
+
+	if (!LogHandle->BlockContext) {
+		return;
+	}
+
+	//
+	// During process exit, a thread may have been terminated while it was
+	// holding the block lock. Don't hang waiting for it.
+	//
+
+	if (RtlTryAcquireSRWLockExclusive(&LogHandle->BlockContext->Lock)) {
+		VxlpFlushBlockLocked(LogHandle);
+		RtlReleaseSRWLockExclusive(&LogHandle->BlockContext->Lock);
+	}
+
+	SafeFree(LogHandle->BlockContext);
+}
+
+//
+// Add one or more complete log entries, laid out back to back in Buffer,
+// to the current block. Blocks which fill up are written out as we go.
+//
+
+NTSTATUS VxlpBlockAppendLogFileEntries(
+	IN	VXLHANDLE	LogHandle,
+	IN	PCVOID		Buffer,
+	IN	ULONG		BufferCb)
+{
+	NTSTATUS Status;
+	NTSTATUS FlushStatus;
+	PVXLBLOCKCONTEXT BlockContext;
+	ULONG Offset;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->BlockContext != NULL);
+	ASSERT (Buffer != NULL);
+
+	BlockContext = LogHandle->BlockContext;
+	Status = STATUS_SUCCESS;
+
+	RtlAcquireSRWLockExclusive(&BlockContext->Lock);
+
+	for (Offset = 0; Offset < BufferCb; ) {
+		PCVXLLOGFILEENTRY Entry;
+		ULONG EntryCb;
+
+		// Both kinds of log entry have the severity in the same place.
+		Entry = (PCVXLLOGFILEENTRY) RVA_TO_VA(Buffer, Offset);
+		EntryCb = Entry->RecordSize;
+
+		ASSERT (EntryCb >= sizeof(VXLLOGFILERECORD));
+		ASSERT (EntryCb <= BufferCb - Offset);
+		ASSERT (Entry->Severity >= 0 && Entry->Severity < LogSeverityMaximumValue);
+
+		if (BlockContext->BufferCb + EntryCb > VXL_BLOCK_SIZE) {
+			FlushStatus = VxlpFlushBlockLocked(LogHandle);
+
+			if (!NT_SUCCESS(FlushStatus)) {
+				Status = FlushStatus;
+			}
+		}
+
+		if (EntryCb > VXL_BLOCK_SIZE) {
+			ULONG SeverityCounts[LogSeverityMaximumValue];
+
+			//
+			// This entry doesn't fit into a block at all, so it is written
+			// on its own, uncompressed. The block we just flushed contains
+			// all entries before it, so they stay in order.
+			//
+
+			RtlZeroMemory(SeverityCounts, sizeof(SeverityCounts));
+			++SeverityCounts[Entry->Severity];
+
+			FlushStatus = VxlpAppendLogFileRecords(LogHandle, Entry, EntryCb, SeverityCounts);
+
+			if (!NT_SUCCESS(FlushStatus)) {
+				Status = FlushStatus;
+			}
+		} else {
+			if (BlockContext->BufferCb == 0) {
+				NtQuerySystemTime((PLARGE_INTEGER) &BlockContext->FirstEntryTime);
+			}
+
+			RtlCopyMemory(BlockContext->Buffer + BlockContext->BufferCb, Entry, EntryCb);
+			BlockContext->BufferCb += EntryCb;
+			BlockContext->EntryCount += 1;
+			BlockContext->SeverityCounts[Entry->Severity] += 1;
+		}
+
+		Offset += EntryCb;
+	}
+
+	RtlReleaseSRWLockExclusive(&BlockContext->Lock);
+	return Status;
+}
+
+//
+// Called while building the index for each block record found in the file.
+// The offsets of the entries inside the block are only filled in when the
+// block is decompressed.
+//
+
+NTSTATUS VxlpAddBlockToIndex(
+	IN	VXLHANDLE	LogHandle,
+	IN	ULONG		FileOffset,
+	IN	ULONG		FirstEntryIndex,
+	IN	ULONG		EntryCount)
+{
+	PVXLBLOCKINDEXENTRY Block;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->OpenMode == GENERIC_READ);
+
+	//
+	// The array starts with room for 16 blocks, and doubles in size whenever
+	// it is full.
+	//
+
+	if (LogHandle->NumberOfBlocks == 0 ||
+		(LogHandle->NumberOfBlocks >= 16 && (LogHandle->NumberOfBlocks & (LogHandle->NumberOfBlocks - 1)) == 0)) {
+
+		PVXLBLOCKINDEXENTRY NewBlocks;
+		ULONG NewMaximum;
+
+		NewMaximum = max(LogHandle->NumberOfBlocks * 2, 16);
+
+		if (LogHandle->Blocks) {
+			NewBlocks = SafeReAlloc(LogHandle->Blocks, VXLBLOCKINDEXENTRY, NewMaximum);
+		} else {
+			NewBlocks = SafeAlloc(VXLBLOCKINDEXENTRY, NewMaximum);
+		}
+
+		if (!NewBlocks) {
+			return STATUS_NO_MEMORY;
+		}
+
+		LogHandle->Blocks = NewBlocks;
+	}
+
+	ASSERT (LogHandle->NumberOfBlocks == 0 ||
+			FirstEntryIndex >= LogHandle->Blocks[LogHandle->NumberOfBlocks - 1].FirstEntryIndex);
+
+	Block = &LogHandle->Blocks[LogHandle->NumberOfBlocks++];
+	Block->FileOffset = FileOffset;
+	Block->FirstEntryIndex = FirstEntryIndex;
+	Block->EntryCount = EntryCount;
+	Block->Data = NULL;
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Decompress a block and fill in the index for the entries inside it.
+// Several threads may do this for the same block at the same time; only
+// one of them gets to keep its copy.
+//
+
+STATIC NTSTATUS VxlpLoadBlock(
+	IN	VXLHANDLE			LogHandle,
+	IN	PVXLBLOCKINDEXENTRY	Block)
+{
+	NTSTATUS Status;
+	PCVXLLOGFILEBLOCK BlockRecord;
+	PBYTE Data;
+	ULONG DataCb;
+	ULONG Offset;
+	ULONG EntryIndex;
+
+	BlockRecord = (PCVXLLOGFILEBLOCK) RVA_TO_VA(LogHandle->MappedFile, Block->FileOffset);
+
+	Data = SafeAlloc(BYTE, max(BlockRecord->UncompressedCb, 1));
+	if (!Data) {
+		return STATUS_NO_MEMORY;
+	}
+
+	if (BlockRecord->DataCb == BlockRecord->UncompressedCb) {
+		RtlCopyMemory(Data, BlockRecord->Data, BlockRecord->DataCb);
+		DataCb = BlockRecord->DataCb;
+		Status = STATUS_SUCCESS;
+	} else {
+		Status = VxlpDecompressBlock(
+			BlockRecord->Data,
+			BlockRecord->DataCb,
+			Data,
+			BlockRecord->UncompressedCb,
+			&DataCb);
+	}
+
+	if (NT_SUCCESS(Status) && DataCb != BlockRecord->UncompressedCb) {
+		Status = STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	//
+	// Find the entries inside the block. There must be exactly as many of
+	// them as the block header says.
+	//
+
+	EntryIndex = Block->FirstEntryIndex;
+	Offset = 0;
+
+	while (NT_SUCCESS(Status) && Offset + sizeof(VXLLOGFILERECORD) <= DataCb) {
+		PCVXLLOGFILERECORD Record;
+
+		Record = (PCVXLLOGFILERECORD) (Data + Offset);
+
+		if (Record->RecordSize < sizeof(VXLLOGFILERECORD) || Record->RecordSize > DataCb - Offset) {
+			Status = STATUS_FILE_CORRUPT_ERROR;
+			break;
+		}
+
+		if (Record->RecordType == VXL_RECORD_LOG_ENTRY || Record->RecordType == VXL_RECORD_DEFERRED_LOG_ENTRY) {
+			if (!VxlpIsValidLogEntryRecord(Record) ||
+				EntryIndex - Block->FirstEntryIndex >= Block->EntryCount) {
+
+				Status = STATUS_FILE_CORRUPT_ERROR;
+				break;
+			}
+
+			LogHandle->EntryIndexToFileOffset[EntryIndex++] = Offset;
+		}
+
+		Offset += Record->RecordSize;
+	}
+
+	if (NT_SUCCESS(Status) && EntryIndex - Block->FirstEntryIndex != Block->EntryCount) {
+		Status = STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	if (!NT_SUCCESS(Status)) {
+		SafeFree(Data);
+		return Status;
+	}
+
+	if (InterlockedCompareExchangePointer((PVOID *) &Block->Data, Data, NULL) != NULL) {
+		// Another thread beat us to it. It has filled in the same offsets.
+		SafeFree(Data);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Get a pointer to the log entry record with the specified index, which
+// may be either in the mapped file or inside a decompressed block.
+//
+
+STATIC NTSTATUS VxlpGetLogFileEntryInternal(
+	IN	VXLHANDLE	LogHandle,
+	IN	ULONG		EntryIndex,
+	OUT	PPVOID		FileEntry)
+{
+	PVXLBLOCKINDEXENTRY Block;
+	ULONG Offset;
+
+	Block = VxlpFindBlockIndexEntry(LogHandle->Blocks, LogHandle->NumberOfBlocks, EntryIndex);
+	Offset = LogHandle->EntryIndexToFileOffset[EntryIndex];
+
+	if (!Block) {
+		if (LogHandle->IndexContext && EntryIndex < LogHandle->IndexContext->NumberOfUncheckedEntries) {
+			//
+			// The offset came from a .vxli file rather than from scanning
+			// the log, so it has not been checked yet.
+			//
+
+			PCVXLLOGFILERECORD Record;
+
+			if (Offset < LogHandle->Header->HeaderSize ||
+				Offset + sizeof(VXLLOGFILERECORD) > LogHandle->Header->CommittedLength) {
+
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+
+			Record = (PCVXLLOGFILERECORD) RVA_TO_VA(LogHandle->MappedFile, Offset);
+
+			if (Offset + Record->RecordSize > LogHandle->Header->CommittedLength ||
+				!VxlpIsValidLogEntryRecord(Record)) {
+
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+		}
+
+		*FileEntry = RVA_TO_VA(LogHandle->MappedFile, Offset);
+		return STATUS_SUCCESS;
+	}
+
+	if (!Block->Data) {
+		NTSTATUS Status;
+
+		Status = VxlpLoadBlock(LogHandle, Block);
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+	}
+
+	*FileEntry = RVA_TO_VA(Block->Data, LogHandle->EntryIndexToFileOffset[EntryIndex]);
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS VxlpGetLogFileEntry(
+	IN	VXLHANDLE	LogHandle,
+	IN	ULONG		EntryIndex,
+	OUT	PPVOID		FileEntry)
+{
+	NTSTATUS Status;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->MappedFile != NULL);
+	ASSERT (LogHandle->EntryIndexToFileOffset != NULL);
+	ASSERT (FileEntry != NULL);
+
+	if (!LogHandle->IndexContext) {
+		return VxlpGetLogFileEntryInternal(LogHandle, EntryIndex, FileEntry);
+	}
+
+	//
+	// The log is being indexed incrementally (see vxlindex.c). The block
+	// array may be reallocated while the index grows, so look it up under
+	// the lock.
+	//
+
+	Status = VxlpEnsureEntryIndexed(LogHandle, EntryIndex);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	RtlAcquireSRWLockShared(&LogHandle->Lock);
+	Status = VxlpGetLogFileEntryInternal(LogHandle, EntryIndex, FileEntry);
+	RtlReleaseSRWLockShared(&LogHandle->Lock);
+
+	return Status;
+}
+
+//
+// Same as VxlpGetLogFileEntry, for NumberOfEntries consecutive entries. The
+// index is only extended, and the lock only taken, once for the whole range.
+// If an entry can't be looked up, its pointer is set to NULL and the rest of
+// the range is still looked up.
+//
+
+VOID VxlpGetLogFileEntries(
+	IN	VXLHANDLE	LogHandle,
+	IN	ULONG		FirstEntryIndex,
+	IN	ULONG		NumberOfEntries,
+	OUT	PVOID		FileEntries[])
+{
+	NTSTATUS Status;
+	ULONG Index;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->MappedFile != NULL);
+	ASSERT (LogHandle->EntryIndexToFileOffset != NULL);
+	ASSERT (FileEntries != NULL);
+	ASSERT (NumberOfEntries != 0);
+
+	if (LogHandle->IndexContext) {
+		Status = VxlpEnsureEntryIndexed(LogHandle, FirstEntryIndex + NumberOfEntries - 1);
+
+		if (!NT_SUCCESS(Status)) {
+			RtlZeroMemory(FileEntries, NumberOfEntries * sizeof(PVOID));
+			return;
+		}
+
+		RtlAcquireSRWLockShared(&LogHandle->Lock);
+	}
+
+	for (Index = 0; Index < NumberOfEntries; ++Index) {
+		Status = VxlpGetLogFileEntryInternal(LogHandle, FirstEntryIndex + Index, &FileEntries[Index]);
+
+		if (!NT_SUCCESS(Status)) {
+			FileEntries[Index] = NULL;
+		}
+	}
+
+	if (LogHandle->IndexContext) {
+		RtlReleaseSRWLockShared(&LogHandle->Lock);
+	}
+}
+
+VOID VxlpFreeBlockIndex(
+	IN	VXLHANDLE	LogHandle)
+{
+	ULONG Index;
+
+	ASSERT (LogHandle != NULL);
+
+	if (!LogHandle->Blocks) {
+		return;
+	}
+
+	for (Index = 0; Index < LogHandle->NumberOfBlocks; ++Index) {
+		SafeFree(LogHandle->Blocks[Index].Data);
+	}
+
+	SafeFree(LogHandle->Blocks);
+	LogHandle->NumberOfBlocks = 0;
+}
\ No newline at end of file
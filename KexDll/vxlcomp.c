@@ -0,0 +1,456 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxlcomp.c
+//
+// Abstract:
+//
+//     Block compressor for VXL log files, and lookup in the block index.
+//
+//     The compressed data is in the LZ4 block format. Blocks are small (less
+//     than 64KB) and independent of each other, so the compressor is a plain
+//     greedy single-pass matcher with a small hash table, and every block can
+//     be decompressed on its own.
+//
+//     This file does not use anything from the rest of KexDll, and can be
+//     built on a non-Windows host with KEX_ENV_HOST defined for testing and
+//     benchmarking (see 01-Tests/vxlcomptest).
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef KEX_ENV_HOST
+#  include <KexHost.h>
+#  include "vxlcomp.h"
+#else
+#  include "buildcfg.h"
+#  include "kexdllp.h"
+#endif
+
+STATIC FORCEINLINE ULONG VxlpRead32(
+	IN	CONST BYTE	*Pointer)
+{
+	ULONG Value;
+
+	RtlCopyMemory(&Value, Pointer, sizeof(Value));
+	return Value;
+}
+
+STATIC FORCEINLINE ULONG VxlpCompressHash(
+	IN	ULONG	Sequence)
+{
+	return (Sequence * 2654435761U) >> (32 - VXL_COMPRESS_HASH_BITS);
+}
+
+//
+// Write out one sequence: a run of literals followed by a back-reference.
+// If Offset is zero, only the literals are written (this is how the last
+// sequence of a block looks). Returns FALSE if there is not enough space
+// left in the output buffer.
+//
+
+STATIC BOOLEAN VxlpEmitSequence(
+	OUT		PBYTE		Output,
+	IN OUT	PULONG		OutputPosition,
+	IN		ULONG		OutputCb,
+	IN		CONST BYTE	*Literals,
+	IN		ULONG		LiteralCb,
+	IN		ULONG		Offset,
+	IN		ULONG		MatchCb)
+{
+	ULONG Position;
+	ULONG Remaining;
+	ULONG RequiredCb;
+	PBYTE Token;
+
+	Position = *OutputPosition;
+
+	RequiredCb = 1 + (LiteralCb / 255) + 1 + LiteralCb;
+
+	if (Offset != 0) {
+		RequiredCb += 2 + (MatchCb / 255) + 1;
+	}
+
+	if (RequiredCb > OutputCb - Position) {
+		return FALSE;
+	}
+
+	Token = &Output[Position++];
+
+	if (LiteralCb >= 15) {
+		*Token = 15 << 4;
+
+		for (Remaining = LiteralCb - 15; Remaining >= 255; Remaining -= 255) {
+			Output[Position++] = 255;
+		}
+
+		Output[Position++] = (BYTE) Remaining;
+	} else {
+		*Token = (BYTE) (LiteralCb << 4);
+	}
+
+	RtlCopyMemory(&Output[Position], Literals, LiteralCb);
+	Position += LiteralCb;
+
+	if (Offset != 0) {
+		ASSERT (Offset <= VXL_COMPRESS_MAXIMUM_OFFSET);
+		ASSERT (MatchCb >= VXL_COMPRESS_MINIMUM_MATCH);
+
+		Output[Position++] = (BYTE) Offset;
+		Output[Position++] = (BYTE) (Offset >> 8);
+
+		MatchCb -= VXL_COMPRESS_MINIMUM_MATCH;
+
+		if (MatchCb >= 15) {
+			*Token |= 15;
+
+			for (Remaining = MatchCb - 15; Remaining >= 255; Remaining -= 255) {
+				Output[Position++] = 255;
+			}
+
+			Output[Position++] = (BYTE) Remaining;
+		} else {
+			*Token |= (BYTE) MatchCb;
+		}
+	}
+
+	*OutputPosition = Position;
+	return TRUE;
+}
+
+//
+// Compress InputCb bytes from Input into Output. WorkSpace must point to
+// VXL_COMPRESS_WORKSPACE_SIZE bytes of memory, which does not need to be
+// initialized. If OutputCb is at least VXL_COMPRESS_BOUND(InputCb), this
+// function cannot fail.
+//
+// Returns STATUS_BUFFER_TOO_SMALL if the compressed data does not fit into
+// the output buffer. This is not worth treating as an error - the caller
+// should just store the data uncompressed instead.
+//
+
+NTSTATUS VxlpCompressBlock(
+	IN	PCVOID	Input,
+	IN	ULONG	InputCb,
+	OUT	PVOID	Output,
+	IN	ULONG	OutputCb,
+	OUT	PULONG	CompressedCb,
+	IN	PVOID	WorkSpace)
+{
+	CONST BYTE *In;
+	PBYTE Out;
+	PULONG HashTable;
+	ULONG OutputPosition;
+	ULONG Anchor;
+
+	ASSERT (Input != NULL || InputCb == 0);
+	ASSERT (Output != NULL);
+	ASSERT (CompressedCb != NULL);
+	ASSERT (WorkSpace != NULL);
+
+	In = (CONST BYTE *) Input;
+	Out = (PBYTE) Output;
+	HashTable = (PULONG) WorkSpace;
+	OutputPosition = 0;
+	Anchor = 0;
+
+	*CompressedCb = 0;
+
+	if (InputCb > VXL_COMPRESS_MATCH_MARGIN) {
+		ULONG InputPosition;
+		ULONG MatchStartLimit;
+		ULONG MatchEndLimit;
+
+		MatchStartLimit = InputCb - VXL_COMPRESS_MATCH_MARGIN;
+		MatchEndLimit = InputCb - VXL_COMPRESS_LAST_LITERALS;
+
+		// Every slot points at offset 0 to begin with. That is a real
+		// position in the input, so this is harmless.
+		RtlZeroMemory(HashTable, VXL_COMPRESS_WORKSPACE_SIZE);
+		InputPosition = 1;
+
+		while (InputPosition < MatchStartLimit) {
+			ULONG Sequence;
+			ULONG Hash;
+			ULONG Candidate;
+			ULONG MatchCb;
+
+			Sequence = VxlpRead32(&In[InputPosition]);
+			Hash = VxlpCompressHash(Sequence);
+			Candidate = HashTable[Hash];
+			HashTable[Hash] = InputPosition;
+
+			if (InputPosition - Candidate > VXL_COMPRESS_MAXIMUM_OFFSET ||
+				VxlpRead32(&In[Candidate]) != Sequence) {
+
+				//
+				// No match. Step further ahead the longer we go without
+				// finding one, so that incompressible data goes through
+				// quickly.
+				//
+
+				InputPosition += 1 + ((InputPosition - Anchor) >> 6);
+				continue;
+			}
+
+			//
+			// Extend the match backwards into the pending literals, and then
+			// forwards as far as it goes.
+			//
+
+			while (InputPosition > Anchor && Candidate > 0 &&
+				   In[InputPosition - 1] == In[Candidate - 1]) {
+
+				--InputPosition;
+				--Candidate;
+			}
+
+			MatchCb = VXL_COMPRESS_MINIMUM_MATCH;
+
+			while (InputPosition + MatchCb < MatchEndLimit &&
+				   In[InputPosition + MatchCb] == In[Candidate + MatchCb]) {
+
+				++MatchCb;
+			}
+
+			if (!VxlpEmitSequence(
+				Out,
+				&OutputPosition,
+				OutputCb,
+				&In[Anchor],
+				InputPosition - Anchor,
+				InputPosition - Candidate,
+				MatchCb)) {
+
+				return STATUS_BUFFER_TOO_SMALL;
+			}
+
+			InputPosition += MatchCb;
+			Anchor = InputPosition;
+
+			//
+			// Remember a position inside the match, which helps a lot with
+			// the repetitive structure of log entries.
+			//
+
+			if (InputPosition - 2 < MatchStartLimit) {
+				HashTable[VxlpCompressHash(VxlpRead32(&In[InputPosition - 2]))] = InputPosition - 2;
+			}
+		}
+	}
+
+	if (!VxlpEmitSequence(Out, &OutputPosition, OutputCb, &In[Anchor], InputCb - Anchor, 0, 0)) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	*CompressedCb = OutputPosition;
+	return STATUS_SUCCESS;
+}
+
+//
+// Read the rest of a length that didn't fit into the 4 bits of the token.
+// Returns FALSE if the input ends before the length does, or if the length
+// is larger than Limit.
+//
+
+STATIC FORCEINLINE BOOLEAN VxlpReadExtendedLength(
+	IN		CONST BYTE	*In,
+	IN		ULONG		InputCb,
+	IN OUT	PULONG		InputPosition,
+	IN OUT	PULONG		Length,
+	IN		ULONG		Limit)
+{
+	BYTE Byte;
+
+	do {
+		if (*InputPosition >= InputCb) {
+			return FALSE;
+		}
+
+		Byte = In[(*InputPosition)++];
+		*Length += Byte;
+
+		if (*Length > Limit) {
+			return FALSE;
+		}
+	} while (Byte == 255);
+
+	return TRUE;
+}
+
+//
+// Decompress a block produced by VxlpCompressBlock. The compressed data
+// comes from a file, so it is not trusted: this function never reads or
+// writes outside of the buffers it is given, whatever the input contains.
+//
+// Returns STATUS_BAD_COMPRESSION_BUFFER if the input is malformed or the
+// decompressed data does not fit into the output buffer.
+//
+
+NTSTATUS VxlpDecompressBlock(
+	IN	PCVOID	Input,
+	IN	ULONG	InputCb,
+	OUT	PVOID	Output,
+	IN	ULONG	OutputCb,
+	OUT	PULONG	DecompressedCb)
+{
+	CONST BYTE *In;
+	PBYTE Out;
+	ULONG InputPosition;
+	ULONG OutputPosition;
+
+	ASSERT (Input != NULL || InputCb == 0);
+	ASSERT (Output != NULL || OutputCb == 0);
+	ASSERT (DecompressedCb != NULL);
+
+	In = (CONST BYTE *) Input;
+	Out = (PBYTE) Output;
+	InputPosition = 0;
+	OutputPosition = 0;
+
+	*DecompressedCb = 0;
+
+	while (TRUE) {
+		BYTE Token;
+		ULONG LiteralCb;
+		ULONG MatchCb;
+		ULONG Offset;
+		PBYTE Source;
+		PBYTE Destination;
+
+		if (InputPosition >= InputCb) {
+			// Blocks must end with a literal run.
+			return STATUS_BAD_COMPRESSION_BUFFER;
+		}
+
+		Token = In[InputPosition++];
+
+		//
+		// Copy the literals.
+		//
+
+		LiteralCb = Token >> 4;
+
+		if (LiteralCb == 15) {
+			if (!VxlpReadExtendedLength(In, InputCb, &InputPosition, &LiteralCb, InputCb)) {
+				return STATUS_BAD_COMPRESSION_BUFFER;
+			}
+		}
+
+		if (LiteralCb > InputCb - InputPosition || LiteralCb > OutputCb - OutputPosition) {
+			return STATUS_BAD_COMPRESSION_BUFFER;
+		}
+
+		RtlCopyMemory(&Out[OutputPosition], &In[InputPosition], LiteralCb);
+		InputPosition += LiteralCb;
+		OutputPosition += LiteralCb;
+
+		if (InputPosition == InputCb) {
+			break;
+		}
+
+		//
+		// Copy the match. It may overlap the bytes it is producing (that is
+		// how runs are encoded), so it has to be copied forwards one byte at
+		// a time.
+		//
+
+		if (InputCb - InputPosition < 2) {
+			return STATUS_BAD_COMPRESSION_BUFFER;
+		}
+
+		Offset = In[InputPosition] | (In[InputPosition + 1] << 8);
+		InputPosition += 2;
+
+		if (Offset == 0 || Offset > OutputPosition) {
+			return STATUS_BAD_COMPRESSION_BUFFER;
+		}
+
+		MatchCb = Token & 15;
+
+		if (MatchCb == 15) {
+			if (!VxlpReadExtendedLength(In, InputCb, &InputPosition, &MatchCb, OutputCb)) {
+				return STATUS_BAD_COMPRESSION_BUFFER;
+			}
+		}
+
+		MatchCb += VXL_COMPRESS_MINIMUM_MATCH;
+
+		if (MatchCb > OutputCb - OutputPosition) {
+			return STATUS_BAD_COMPRESSION_BUFFER;
+		}
+
+		Source = &Out[OutputPosition - Offset];
+		Destination = &Out[OutputPosition];
+		OutputPosition += MatchCb;
+
+		if (Offset >= MatchCb) {
+			RtlCopyMemory(Destination, Source, MatchCb);
+		} else {
+			do {
+				*Destination++ = *Source++;
+			} until (--MatchCb == 0);
+		}
+	}
+
+	*DecompressedCb = OutputPosition;
+	return STATUS_SUCCESS;
+}
+
+//
+// Find the block which contains the log entry with the specified index.
+// Blocks must be sorted by FirstEntryIndex. Returns NULL if the entry is not
+// inside any block (i.e. it is stored uncompressed).
+//
+
+PVXLBLOCKINDEXENTRY VxlpFindBlockIndexEntry(
+	IN	PVXLBLOCKINDEXENTRY	Blocks,
+	IN	ULONG				NumberOfBlocks,
+	IN	ULONG				EntryIndex)
+{
+	ULONG Low;
+	ULONG High;
+	PVXLBLOCKINDEXENTRY Block;
+
+	ASSERT (Blocks != NULL || NumberOfBlocks == 0);
+
+	//
+	// Find the first block that starts after the entry. The entry can only
+	// be in the block before that one.
+	//
+
+	Low = 0;
+	High = NumberOfBlocks;
+
+	while (Low < High) {
+		ULONG Middle;
+
+		Middle = Low + (High - Low) / 2;
+
+		if (Blocks[Middle].FirstEntryIndex <= EntryIndex) {
+			Low = Middle + 1;
+		} else {
+			High = Middle;
+		}
+	}
+
+	if (Low == 0) {
+		return NULL;
+	}
+
+	Block = &Blocks[Low - 1];
+
+	if (EntryIndex - Block->FirstEntryIndex >= Block->EntryCount) {
+		return NULL;
+	}
+
+	return Block;
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxlcomp.h
+//
+// Abstract:
+//
+//     Declarations for the VXL block compressor and block index (vxlcomp.c).
+//     This header is also used by the host build of vxlcomp.c, so it must
+//     not depend on anything except the basic types.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//
+// The compressed format is the LZ4 block format: a sequence of literal runs
+// and back-references with 16-bit offsets, ending with a literal run.
+//
+
+#define VXL_COMPRESS_HASH_BITS			12
+#define VXL_COMPRESS_WORKSPACE_SIZE		(sizeof(ULONG) << VXL_COMPRESS_HASH_BITS)
+#define VXL_COMPRESS_MINIMUM_MATCH		4
+#define VXL_COMPRESS_MAXIMUM_OFFSET		0xFFFF
+#define VXL_COMPRESS_LAST_LITERALS		5			// the last bytes are always literals
+#define VXL_COMPRESS_MATCH_MARGIN		12			// no match may start this close to the end
+
+// Largest possible compressed size of InputCb bytes of input.
+#define VXL_COMPRESS_BOUND(InputCb)		((InputCb) + ((InputCb) / 255) + 16)
+
+//
+// One compressed block of log entries, as seen by a reader. The reader keeps
+// an array of these, sorted by FirstEntryIndex, so that it can find the block
+// that contains any entry without decompressing anything else.
+//
+
+typedef struct _VXLBLOCKINDEXENTRY {
+	ULONG					FileOffset;				// of the VXLLOGFILEBLOCK record
+	ULONG					FirstEntryIndex;
+	ULONG					EntryCount;
+	PBYTE VOLATILE			Data;					// uncompressed contents, NULL until needed
+} TYPEDEF_TYPE_NAME(VXLBLOCKINDEXENTRY);
+
+NTSTATUS VxlpCompressBlock(
+	IN	PCVOID				Input,
+	IN	ULONG				InputCb,
+	OUT	PVOID				Output,
+	IN	ULONG				OutputCb,
+	OUT	PULONG				CompressedCb,
+	IN	PVOID				WorkSpace);
+
+NTSTATUS VxlpDecompressBlock(
+	IN	PCVOID				Input,
+	IN	ULONG				InputCb,
+	OUT	PVOID				Output,
+	IN	ULONG				OutputCb,
+	OUT	PULONG				DecompressedCb);
+
+PVXLBLOCKINDEXENTRY VxlpFindBlockIndexEntry(
+	IN	PVXLBLOCKINDEXENTRY	Blocks,
+	IN	ULONG				NumberOfBlocks,
+	IN	ULONG				EntryIndex);
\ No newline at end of file
@@ -0,0 +1,995 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxldefer.c
+//
+// Abstract:
+//
+//     Deferred formatting of log entries.
+//
+//     When a log is opened with VXL_OPEN_DEFERRED_FORMATTING, VxlWriteLogEx
+//     does not format the text of the entry. Instead, the format string is
+//     stored once in the string table, and each entry contains a copy of
+//     the arguments that the format string consumes (strings are copied by
+//     value, since the pointers are meaningless once the process is gone).
+//
+//     When the entry is read, the arguments are checked against the format
+//     string, laid out the same way as they would be on the stack, and the
+//     text is formatted from them into a buffer supplied by the reader. The
+//     text is not kept, so reading a large log doesn't leave behind a heap
+//     block for every entry.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Allow the log to be followed
+//     agent                17-Oct-2026  Check arguments against the format string.
+//     agent                17-Oct-2026  Format into the reader's buffer.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+
+// The source indices are filled out by code which only knows about
+// VXLLOGFILEENTRY, and the async flusher reads the time and severity.
+C_ASSERT (FIELD_OFFSET(VXLLOGFILEDEFERREDENTRY, SourceFunctionIndex) ==
+		  FIELD_OFFSET(VXLLOGFILEENTRY, SourceFunctionIndex));
+
+typedef struct _VXLARGUMENTWRITER {
+	PBYTE	Buffer;					// NULL when only measuring
+	ULONG	BufferCb;
+	ULONG	Offset;
+	ULONG	NumberOfArguments;
+} TYPEDEF_TYPE_NAME(VXLARGUMENTWRITER);
+
+typedef enum _VXLARGUMENTSIZE {
+	ArgumentSizeDefault,
+	ArgumentSizeShort,
+	ArgumentSizeLong,
+	ArgumentSizeLongLong,
+	ArgumentSizePointer
+} VXLARGUMENTSIZE;
+
+//
+// Append one argument. TerminatorCb bytes of zeroes are added after Data.
+//
+
+STATIC NTSTATUS VxlpPutArgument(
+	IN OUT	PVXLARGUMENTWRITER	Writer,
+	IN		UCHAR				Type,
+	IN		PCVOID				Data OPTIONAL,
+	IN		ULONG				DataCb,
+	IN		ULONG				TerminatorCb)
+{
+	ULONG ArgumentCb;
+
+	if (DataCb + TerminatorCb > 0xFF00) {
+		return STATUS_NOT_SUPPORTED;
+	}
+
+	if (++Writer->NumberOfArguments > VXL_DEFERRED_MAXIMUM_ARGUMENTS) {
+		return STATUS_NOT_SUPPORTED;
+	}
+
+	ArgumentCb = VXL_ARGUMENT_SIZE(DataCb + TerminatorCb);
+
+	if (Writer->Buffer) {
+		PVXLDEFERREDARGUMENT Argument;
+
+		if (Writer->Offset + ArgumentCb > Writer->BufferCb) {
+			// A string changed length between measuring and copying.
+			return STATUS_NOT_SUPPORTED;
+		}
+
+		Argument = (PVXLDEFERREDARGUMENT) (Writer->Buffer + Writer->Offset);
+		Argument->Type = Type;
+		Argument->Reserved = 0;
+		Argument->DataCb = (USHORT) (DataCb + TerminatorCb);
+
+		if (DataCb) {
+			RtlCopyMemory(Argument->Data, Data, DataCb);
+		}
+
+		RtlZeroMemory(
+			Argument->Data + DataCb,
+			ArgumentCb - FIELD_OFFSET(VXLDEFERREDARGUMENT, Data) - DataCb);
+	}
+
+	Writer->Offset += ArgumentCb;
+	return STATUS_SUCCESS;
+}
+
+STATIC NTSTATUS VxlpPutIntegerArgument(
+	IN OUT	PVXLARGUMENTWRITER	Writer,
+	IN		UCHAR				Type,
+	IN		ULONGLONG			Value)
+{
+	if (Type == VXL_ARGUMENT_INT32) {
+		LONG Value32;
+
+		Value32 = (LONG) Value;
+		return VxlpPutArgument(Writer, Type, &Value32, sizeof(Value32), 0);
+	}
+
+	return VxlpPutArgument(Writer, Type, &Value, sizeof(Value), 0);
+}
+
+STATIC ULONG VxlpBoundedStringCch(
+	IN	PCWSTR	String,
+	IN	LONG	Precision)
+{
+	ULONG Cch;
+
+	for (Cch = 0; String[Cch] && (Precision < 0 || Cch < (ULONG) Precision); ++Cch);
+	return Cch;
+}
+
+STATIC ULONG VxlpBoundedStringCchA(
+	IN	PCSTR	String,
+	IN	LONG	Precision)
+{
+	ULONG Cch;
+
+	for (Cch = 0; String[Cch] && (Precision < 0 || Cch < (ULONG) Precision); ++Cch);
+	return Cch;
+}
+
+typedef struct _VXLFORMATSPEC {
+	BOOLEAN			WidthArgument;		// width is '*'
+	BOOLEAN			PrecisionArgument;	// precision is '*'
+	LONG			Precision;			// -1 if there is none
+	VXLARGUMENTSIZE	Size;
+	WCHAR			Type;
+} TYPEDEF_TYPE_NAME(VXLFORMATSPEC);
+
+//
+// Parse one conversion specification. Pointer points just after the '%'.
+// Returns a pointer to the type character, which might be the terminator
+// if the format string is malformed.
+//
+
+STATIC PCWSTR VxlpParseFormatSpec(
+	IN	PCWSTR			Pointer,
+	OUT	PVXLFORMATSPEC	Spec)
+{
+	Spec->WidthArgument = FALSE;
+	Spec->PrecisionArgument = FALSE;
+	Spec->Precision = -1;
+	Spec->Size = ArgumentSizeDefault;
+
+	//
+	// flags
+	//
+
+	while (*Pointer == '-' || *Pointer == '+' || *Pointer == ' ' ||
+		   *Pointer == '#' || *Pointer == '0') {
+
+		++Pointer;
+	}
+
+	//
+	// width
+	//
+
+	if (*Pointer == '*') {
+		Spec->WidthArgument = TRUE;
+		++Pointer;
+	} else {
+		while (*Pointer >= '0' && *Pointer <= '9') {
+			++Pointer;
+		}
+	}
+
+	//
+	// precision
+	//
+
+	if (*Pointer == '.') {
+		++Pointer;
+
+		if (*Pointer == '*') {
+			Spec->PrecisionArgument = TRUE;
+			++Pointer;
+		} else {
+			Spec->Precision = 0;
+
+			while (*Pointer >= '0' && *Pointer <= '9') {
+				Spec->Precision = (Spec->Precision * 10) + (*Pointer++ - '0');
+			}
+		}
+	}
+
+	//
+	// size
+	//
+
+	switch (*Pointer) {
+	case 'h':
+		Spec->Size = ArgumentSizeShort;
+		++Pointer;
+
+		if (*Pointer == 'h') {
+			++Pointer;
+		}
+
+		break;
+	case 'l':
+		Spec->Size = ArgumentSizeLong;
+		++Pointer;
+
+		if (*Pointer == 'l') {
+			Spec->Size = ArgumentSizeLongLong;
+			++Pointer;
+		}
+
+		break;
+	case 'w':
+		Spec->Size = ArgumentSizeLong;
+		++Pointer;
+		break;
+	case 'L':
+	case 'q':
+	case 'j':
+		Spec->Size = ArgumentSizeLongLong;
+		++Pointer;
+		break;
+	case 'z':
+	case 't':
+		Spec->Size = ArgumentSizePointer;
+		++Pointer;
+		break;
+	case 'I':
+		++Pointer;
+
+		if (Pointer[0] == '6' && Pointer[1] == '4') {
+			Spec->Size = ArgumentSizeLongLong;
+			Pointer += 2;
+		} else if (Pointer[0] == '3' && Pointer[1] == '2') {
+			Pointer += 2;
+		} else {
+			Spec->Size = ArgumentSizePointer;
+		}
+
+		break;
+	}
+
+	Spec->Type = *Pointer;
+	return Pointer;
+}
+
+//
+// Find out which argument type VxlpCaptureArguments stores for a
+// conversion. String conversions can also store VXL_ARGUMENT_NULL_POINTER.
+// Returns 0 for %n, unknown type characters, and % at the end of the
+// string.
+//
+
+STATIC UCHAR VxlpGetArgumentType(
+	IN	PCVXLFORMATSPEC	Spec)
+{
+	switch (Spec->Type) {
+	case 'c':
+	case 'C':
+		return VXL_ARGUMENT_INT32;
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		if (Spec->Size == ArgumentSizeLongLong) {
+			return VXL_ARGUMENT_INT64;
+		} else if (Spec->Size == ArgumentSizePointer) {
+			return VXL_ARGUMENT_POINTER;
+		} else {
+			return VXL_ARGUMENT_INT32;
+		}
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		// Floating point arguments are always passed as doubles.
+		return VXL_ARGUMENT_INT64;
+	case 'p':
+	case 'P':
+		return VXL_ARGUMENT_POINTER;
+	case 's':
+	case 'S':
+		if ((Spec->Type == 's' && Spec->Size != ArgumentSizeShort) ||
+			(Spec->Type == 'S' && Spec->Size == ArgumentSizeLong)) {
+
+			return VXL_ARGUMENT_WIDE_STRING;
+		} else {
+			return VXL_ARGUMENT_ANSI_STRING;
+		}
+	case 'Z':
+		if (Spec->Size == ArgumentSizeLong) {
+			return VXL_ARGUMENT_UNICODE_STRING;
+		} else {
+			return VXL_ARGUMENT_ANSI_COUNTED;
+		}
+	default:
+		return 0;
+	}
+}
+
+//
+// Walk the format string, and copy every argument that it consumes into
+// the writer's buffer. Returns STATUS_NOT_SUPPORTED if the format string
+// contains anything that we can't capture, or is malformed.
+//
+
+STATIC NTSTATUS VxlpCaptureArguments(
+	IN OUT	PVXLARGUMENTWRITER	Writer,
+	IN		PCWSTR				Format,
+	IN		ARGLIST				ArgList)
+{
+	NTSTATUS Status;
+	PCWSTR Pointer;
+	VXLFORMATSPEC Spec;
+	LONG Precision;
+	PCWSTR WideString;
+	PCSTR AnsiString;
+	PCUNICODE_STRING UnicodeString;
+	PCANSI_STRING CountedString;
+
+	for (Pointer = Format; *Pointer; ++Pointer) {
+
+		if (*Pointer != '%') {
+			continue;
+		}
+
+		++Pointer;
+
+		if (*Pointer == '%') {
+			continue;
+		}
+
+		Pointer = VxlpParseFormatSpec(Pointer, &Spec);
+
+		if (Spec.WidthArgument) {
+			Status = VxlpPutIntegerArgument(Writer, VXL_ARGUMENT_INT32, va_arg(ArgList, LONG));
+			if (!NT_SUCCESS(Status)) {
+				return Status;
+			}
+		}
+
+		Precision = Spec.Precision;
+
+		if (Spec.PrecisionArgument) {
+			Precision = va_arg(ArgList, LONG);
+
+			Status = VxlpPutIntegerArgument(Writer, VXL_ARGUMENT_INT32, Precision);
+			if (!NT_SUCCESS(Status)) {
+				return Status;
+			}
+		}
+
+		switch (VxlpGetArgumentType(&Spec)) {
+		case VXL_ARGUMENT_INT32:
+			Status = VxlpPutIntegerArgument(Writer, VXL_ARGUMENT_INT32, va_arg(ArgList, LONG));
+			break;
+		case VXL_ARGUMENT_INT64:
+			Status = VxlpPutIntegerArgument(Writer, VXL_ARGUMENT_INT64, va_arg(ArgList, LONGLONG));
+			break;
+		case VXL_ARGUMENT_POINTER:
+			Status = VxlpPutIntegerArgument(Writer, VXL_ARGUMENT_POINTER, va_arg(ArgList, ULONG_PTR));
+			break;
+		case VXL_ARGUMENT_WIDE_STRING:
+			WideString = va_arg(ArgList, PCWSTR);
+
+			if (WideString) {
+				Status = VxlpPutArgument(
+					Writer,
+					VXL_ARGUMENT_WIDE_STRING,
+					WideString,
+					VxlpBoundedStringCch(WideString, Precision) * sizeof(WCHAR),
+					sizeof(WCHAR));
+			} else {
+				Status = VxlpPutArgument(Writer, VXL_ARGUMENT_NULL_POINTER, NULL, 0, 0);
+			}
+
+			break;
+		case VXL_ARGUMENT_ANSI_STRING:
+			AnsiString = va_arg(ArgList, PCSTR);
+
+			if (AnsiString) {
+				Status = VxlpPutArgument(
+					Writer,
+					VXL_ARGUMENT_ANSI_STRING,
+					AnsiString,
+					VxlpBoundedStringCchA(AnsiString, Precision),
+					sizeof(CHAR));
+			} else {
+				Status = VxlpPutArgument(Writer, VXL_ARGUMENT_NULL_POINTER, NULL, 0, 0);
+			}
+
+			break;
+		case VXL_ARGUMENT_UNICODE_STRING:
+			UnicodeString = va_arg(ArgList, PCUNICODE_STRING);
+
+			if (UnicodeString && UnicodeString->Buffer) {
+				Status = VxlpPutArgument(
+					Writer,
+					VXL_ARGUMENT_UNICODE_STRING,
+					UnicodeString->Buffer,
+					UnicodeString->Length & ~1,
+					0);
+			} else {
+				Status = VxlpPutArgument(Writer, VXL_ARGUMENT_NULL_POINTER, NULL, 0, 0);
+			}
+
+			break;
+		case VXL_ARGUMENT_ANSI_COUNTED:
+			CountedString = va_arg(ArgList, PCANSI_STRING);
+
+			if (CountedString && CountedString->Buffer) {
+				Status = VxlpPutArgument(
+					Writer,
+					VXL_ARGUMENT_ANSI_COUNTED,
+					CountedString->Buffer,
+					CountedString->Length,
+					0);
+			} else {
+				Status = VxlpPutArgument(Writer, VXL_ARGUMENT_NULL_POINTER, NULL, 0, 0);
+			}
+
+			break;
+		default:
+			// %n, unknown type characters, or % at the end of the string.
+			return STATUS_NOT_SUPPORTED;
+		}
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Check that the arguments stored with a deferred entry are exactly the
+// ones its format string consumes, of the types VxlpCaptureArguments
+// would have stored for it. Both the format string and the arguments come
+// from the file, so neither can be trusted: a %s which lines up with an
+// integer would have StringCchVPrintf read from an arbitrary address.
+//
+
+STATIC NTSTATUS VxlpCheckDeferredArguments(
+	IN	PCWSTR	Format,
+	IN	PCBYTE	ArgumentTypes,
+	IN	ULONG	NumberOfArguments)
+{
+	PCWSTR Pointer;
+	VXLFORMATSPEC Spec;
+	UCHAR Type;
+	ULONG Index;
+
+	Index = 0;
+
+	for (Pointer = Format; *Pointer; ++Pointer) {
+		if (*Pointer != '%') {
+			continue;
+		}
+
+		++Pointer;
+
+		if (*Pointer == '%') {
+			continue;
+		}
+
+		Pointer = VxlpParseFormatSpec(Pointer, &Spec);
+
+		if (Spec.WidthArgument) {
+			if (Index >= NumberOfArguments || ArgumentTypes[Index++] != VXL_ARGUMENT_INT32) {
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+		}
+
+		if (Spec.PrecisionArgument) {
+			if (Index >= NumberOfArguments || ArgumentTypes[Index++] != VXL_ARGUMENT_INT32) {
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+		}
+
+		Type = VxlpGetArgumentType(&Spec);
+
+		if (Type == 0 || Index >= NumberOfArguments) {
+			return STATUS_FILE_CORRUPT_ERROR;
+		}
+
+		if (ArgumentTypes[Index] != Type) {
+			switch (Type) {
+			case VXL_ARGUMENT_WIDE_STRING:
+			case VXL_ARGUMENT_ANSI_STRING:
+			case VXL_ARGUMENT_UNICODE_STRING:
+			case VXL_ARGUMENT_ANSI_COUNTED:
+				if (ArgumentTypes[Index] == VXL_ARGUMENT_NULL_POINTER) {
+					break;
+				}
+
+				// fall through
+			default:
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+		}
+
+		++Index;
+	}
+
+	if (Index != NumberOfArguments) {
+		return STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Write a deferred log entry. Returns STATUS_NOT_SUPPORTED if the entry
+// needs to be formatted immediately instead.
+//
+
+NTSTATUS VxlpWriteDeferredLogEntry(
+	IN	VXLHANDLE		LogHandle,
+	IN	PCWSTR			SourceComponent,
+	IN	PCWSTR			SourceFile,
+	IN	ULONG			SourceLine,
+	IN	PCWSTR			SourceFunction,
+	IN	VXLSEVERITY		Severity,
+	IN	PCWSTR			Format,
+	IN	ARGLIST			ArgList)
+{
+	NTSTATUS Status;
+	PVXLLOGFILEDEFERREDENTRY FileEntry;
+	ULONG FileEntryCb;
+	VXLARGUMENTWRITER Writer;
+	PTEB Teb;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->Flags & VXL_OPEN_DEFERRED_FORMATTING);
+	ASSERT (Format != NULL);
+
+	Teb = NtCurrentTeb();
+	FileEntry = NULL;
+	FileEntryCb = 0;
+
+	try {
+		//
+		// Find out how much space the arguments take up, then copy them.
+		// As in VxlWriteLogEx, the heap must not be used here.
+		//
+
+		RtlZeroMemory(&Writer, sizeof(Writer));
+
+		Status = VxlpCaptureArguments(&Writer, Format, ArgList);
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		FileEntryCb = FIELD_OFFSET(VXLLOGFILEDEFERREDENTRY, Arguments) + Writer.Offset;
+
+		if (FileEntryCb > 0xFFFF) {
+			// Let VxlWriteLogEx deal with it.
+			Status = STATUS_NOT_SUPPORTED;
+			leave;
+		}
+
+		FileEntry = (PVXLLOGFILEDEFERREDENTRY) StackAlloc(BYTE, FileEntryCb);
+		RtlZeroMemory(FileEntry, FIELD_OFFSET(VXLLOGFILEDEFERREDENTRY, Arguments));
+
+		Writer.Buffer = FileEntry->Arguments;
+		Writer.BufferCb = Writer.Offset;
+		Writer.Offset = 0;
+		Writer.NumberOfArguments = 0;
+
+		Status = VxlpCaptureArguments(&Writer, Format, ArgList);
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		FileEntryCb = FIELD_OFFSET(VXLLOGFILEDEFERREDENTRY, Arguments) + Writer.Offset;
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	FileEntry->RecordType = VXL_RECORD_DEFERRED_LOG_ENTRY;
+	FileEntry->RecordSize = (USHORT) FileEntryCb;
+	NtQuerySystemTime((PLONGLONG) &FileEntry->Time64);
+	FileEntry->ProcessId = HandleToUlong(Teb->ClientId.UniqueProcess);
+	FileEntry->ThreadId = HandleToUlong(Teb->ClientId.UniqueThread);
+	FileEntry->Severity = Severity;
+	FileEntry->SourceLine = SourceLine;
+	FileEntry->ArgumentsCb = (USHORT) Writer.Offset;
+
+	Status = VxlpFindOrCreateFormatIndex(LogHandle, Format, &FileEntry->FormatIndex);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	Status = VxlpFindOrCreateSourceIndices(
+		LogHandle,
+		SourceComponent,
+		SourceFile,
+		SourceFunction,
+		(PVXLLOGFILEENTRY) FileEntry);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	return VxlpWriteLogFileEntry(LogHandle, FileEntry, FileEntryCb, Severity);
+}
+
+typedef union _VXLCOUNTEDSTRING {
+	UNICODE_STRING	Unicode;
+	ANSI_STRING		Ansi;
+} TYPEDEF_TYPE_NAME(VXLCOUNTEDSTRING);
+
+//
+// Format the text of a deferred entry into Buffer. Returns
+// STATUS_BUFFER_OVERFLOW if the text had to be cut short to fit.
+//
+
+STATIC NTSTATUS VxlpFormatDeferredLogEntry(
+	IN	PCWSTR						Format,
+	IN	PCVXLLOGFILEDEFERREDENTRY	FileEntry,
+	OUT	PWSTR						Buffer,
+	IN	ULONG						BufferCch)
+{
+	NTSTATUS Status;
+	HRESULT Result;
+	ULONG Offset;
+	ULONG NumberOfSlots;
+	ULONG NumberOfArguments;
+	ULONG NumberOfCountedStrings;
+
+	// Every argument takes at most one LONGLONG worth of slots.
+	ULONG_PTR Slots[VXL_DEFERRED_MAXIMUM_ARGUMENTS * (sizeof(LONGLONG) / sizeof(ULONG_PTR))];
+	BYTE ArgumentTypes[VXL_DEFERRED_MAXIMUM_ARGUMENTS];
+	VXLCOUNTEDSTRING CountedStrings[VXL_DEFERRED_MAXIMUM_ARGUMENTS];
+
+	RtlZeroMemory(Slots, sizeof(Slots));
+	NumberOfSlots = 0;
+	NumberOfArguments = 0;
+	NumberOfCountedStrings = 0;
+
+	//
+	// Lay the arguments out in the same way as the compiler would have done
+	// when calling a varargs function, i.e. each argument takes up a whole
+	// number of pointer sized slots.
+	//
+
+	for (Offset = 0; Offset < FileEntry->ArgumentsCb;) {
+		PCVXLDEFERREDARGUMENT Argument;
+		ULONGLONG Value;
+
+		Argument = (PCVXLDEFERREDARGUMENT) (FileEntry->Arguments + Offset);
+
+		if (Offset + FIELD_OFFSET(VXLDEFERREDARGUMENT, Data) > FileEntry->ArgumentsCb ||
+			Offset + VXL_ARGUMENT_SIZE(Argument->DataCb) > FileEntry->ArgumentsCb ||
+			NumberOfArguments >= VXL_DEFERRED_MAXIMUM_ARGUMENTS) {
+
+			return STATUS_FILE_CORRUPT_ERROR;
+		}
+
+		ArgumentTypes[NumberOfArguments++] = Argument->Type;
+
+		switch (Argument->Type) {
+		case VXL_ARGUMENT_INT32:
+			if (Argument->DataCb != sizeof(LONG)) {
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+
+			Slots[NumberOfSlots++] = (ULONG_PTR) *(PLONG) Argument->Data;
+			break;
+		case VXL_ARGUMENT_INT64:
+			if (Argument->DataCb != sizeof(LONGLONG)) {
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+
+			RtlCopyMemory(&Slots[NumberOfSlots], Argument->Data, sizeof(LONGLONG));
+			NumberOfSlots += sizeof(LONGLONG) / sizeof(ULONG_PTR);
+			break;
+		case VXL_ARGUMENT_POINTER:
+			if (Argument->DataCb != sizeof(ULONGLONG)) {
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+
+			RtlCopyMemory(&Value, Argument->Data, sizeof(ULONGLONG));
+			Slots[NumberOfSlots++] = (ULONG_PTR) Value;
+			break;
+		case VXL_ARGUMENT_NULL_POINTER:
+			Slots[NumberOfSlots++] = 0;
+			break;
+		case VXL_ARGUMENT_WIDE_STRING:
+			if (Argument->DataCb < sizeof(WCHAR) || (Argument->DataCb & 1) ||
+				((PCWSTR) Argument->Data)[Argument->DataCb / sizeof(WCHAR) - 1] != '\0') {
+
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+
+			Slots[NumberOfSlots++] = (ULONG_PTR) Argument->Data;
+			break;
+		case VXL_ARGUMENT_ANSI_STRING:
+			if (Argument->DataCb < sizeof(CHAR) || Argument->Data[Argument->DataCb - 1] != '\0') {
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+
+			Slots[NumberOfSlots++] = (ULONG_PTR) Argument->Data;
+			break;
+		case VXL_ARGUMENT_UNICODE_STRING:
+		case VXL_ARGUMENT_ANSI_COUNTED:
+			if (NumberOfCountedStrings >= ARRAYSIZE(CountedStrings)) {
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+
+			// UNICODE_STRING and ANSI_STRING have the same layout.
+			CountedStrings[NumberOfCountedStrings].Unicode.Length = Argument->DataCb;
+			CountedStrings[NumberOfCountedStrings].Unicode.MaximumLength = Argument->DataCb;
+			CountedStrings[NumberOfCountedStrings].Unicode.Buffer = (PWCHAR) Argument->Data;
+			Slots[NumberOfSlots++] = (ULONG_PTR) &CountedStrings[NumberOfCountedStrings++];
+			break;
+		default:
+			return STATUS_FILE_CORRUPT_ERROR;
+		}
+
+		Offset += VXL_ARGUMENT_SIZE(Argument->DataCb);
+	}
+
+	Status = VxlpCheckDeferredArguments(Format, ArgumentTypes, NumberOfArguments);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	//
+	// Format the text. This is done in one pass straight into the caller's
+	// buffer, so a long entry is simply cut short.
+	//
+
+	try {
+		Result = StringCchVPrintf(Buffer, BufferCch, Format, (ARGLIST) Slots);
+
+		if (Result == STRSAFE_E_INSUFFICIENT_BUFFER) {
+			Status = STATUS_BUFFER_OVERFLOW;
+		} else if (FAILED(Result)) {
+			Status = STATUS_FILE_CORRUPT_ERROR;
+		} else {
+			Status = STATUS_SUCCESS;
+		}
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	return Status;
+}
+
+//
+// Used when the arguments of an entry are damaged. Showing the format string
+// is better than failing to show the entry at all.
+//
+
+STATIC NTSTATUS VxlpCopyFormatAsText(
+	IN	PCWSTR	Format,
+	OUT	PWSTR	Buffer,
+	IN	ULONG	BufferCch)
+{
+	HRESULT Result;
+
+	Result = StringCchCopy(Buffer, BufferCch, Format);
+
+	if (Result == STRSAFE_E_INSUFFICIENT_BUFFER) {
+		return STATUS_BUFFER_OVERFLOW;
+	} else if (FAILED(Result)) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Format the text of a deferred entry into a buffer supplied by the caller,
+// and split it into a header and a body in the same way as VxlWriteLogEx
+// does. The text takes up TextHeaderCch + TextCch characters of the buffer.
+//
+// Returns STATUS_BUFFER_OVERFLOW if the text was cut short to fit into the
+// buffer. The text is still valid in that case. Returns STATUS_BUFFER_TOO_SMALL
+// if there isn't even room for a null terminator.
+//
+
+NTSTATUS VxlpGetDeferredLogEntryText(
+	IN	VXLHANDLE					LogHandle,
+	IN	PCVXLLOGFILEDEFERREDENTRY	FileEntry,
+	OUT	PWSTR						Buffer,
+	IN	ULONG						BufferCch,
+	OUT	PULONG						TextHeaderCch,
+	OUT	PULONG						TextCch)
+{
+	NTSTATUS Status;
+	NTSTATUS SplitStatus;
+	PCWSTR Format;
+	ULONG TotalCch;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->OpenMode == GENERIC_READ);
+	ASSERT (FileEntry != NULL);
+	ASSERT (Buffer != NULL || BufferCch == 0);
+	ASSERT (TextHeaderCch != NULL);
+	ASSERT (TextCch != NULL);
+
+	if (BufferCch == 0) {
+		return STATUS_BUFFER_TOO_SMALL;
+	}
+
+	Format = VxlGetSourceString(LogHandle, VxlSourceFormat, FileEntry->FormatIndex);
+	if (!Format) {
+		return STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	Status = VxlpFormatDeferredLogEntry(Format, FileEntry, Buffer, BufferCch);
+
+	if (Status == STATUS_FILE_CORRUPT_ERROR || Status == STATUS_ACCESS_VIOLATION) {
+		Status = VxlpCopyFormatAsText(Format, Buffer, BufferCch);
+	}
+
+	if (!NT_SUCCESS(Status) && Status != STATUS_BUFFER_OVERFLOW) {
+		return Status;
+	}
+
+	SplitStatus = Status;
+	TotalCch = (ULONG) wcslen(Buffer) + 1;
+	VxlpSplitLogText(Buffer, &TotalCch, TextHeaderCch, TextCch);
+
+	return SplitStatus;
+}
+
+//
+// VxlReadLog and VxlReadMultipleEntriesLog hand out pointers to the text
+// without a buffer to put it in, so the text of deferred entries read that
+// way is kept in a small cache on the log handle. The oldest text is thrown
+// away once VXL_FORMATTED_TEXT_CACHE_SIZE other entries have been formatted.
+//
+
+NTSTATUS VxlpGetCachedDeferredLogEntryText(
+	IN	VXLHANDLE					LogHandle,
+	IN	ULONG						LogEntryIndex,
+	IN	PCVXLLOGFILEDEFERREDENTRY	FileEntry,
+	OUT	PPCVXLFORMATTEDTEXT			FormattedText)
+{
+	NTSTATUS Status;
+	PVXLFORMATTEDTEXTCACHE Cache;
+	PVXLFORMATTEDTEXT Text;
+	PWSTR Buffer;
+	ULONG TextHeaderCch;
+	ULONG TextCch;
+	ULONG Index;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->OpenMode == GENERIC_READ);
+	ASSERT (FileEntry != NULL);
+	ASSERT (FormattedText != NULL);
+
+	*FormattedText = NULL;
+
+	//
+	// See if it has been formatted already.
+	//
+
+	RtlAcquireSRWLockExclusive(&LogHandle->Lock);
+
+	Cache = LogHandle->FormattedTextCache;
+
+	if (!Cache) {
+		Cache = SafeAlloc(VXLFORMATTEDTEXTCACHE, 1);
+
+		if (Cache) {
+			RtlZeroMemory(Cache, sizeof(*Cache));
+			LogHandle->FormattedTextCache = Cache;
+		}
+	}
+
+	if (Cache) {
+		ForEachArrayItem (Cache->Slots, Index) {
+			if (Cache->Slots[Index] && Cache->Slots[Index]->LogEntryIndex == LogEntryIndex) {
+				*FormattedText = Cache->Slots[Index];
+				break;
+			}
+		}
+	}
+
+	RtlReleaseSRWLockExclusive(&LogHandle->Lock);
+
+	if (!Cache) {
+		return STATUS_NO_MEMORY;
+	}
+
+	if (*FormattedText) {
+		return STATUS_SUCCESS;
+	}
+
+	//
+	// Format it into a temporary buffer, and then keep only as much of it
+	// as is needed.
+	//
+
+	Buffer = SafeAlloc(WCHAR, VXL_READ_TEXT_BUFFER_CCH);
+	if (!Buffer) {
+		return STATUS_NO_MEMORY;
+	}
+
+	Status = VxlpGetDeferredLogEntryText(
+		LogHandle,
+		FileEntry,
+		Buffer,
+		VXL_READ_TEXT_BUFFER_CCH,
+		&TextHeaderCch,
+		&TextCch);
+
+	if (!NT_SUCCESS(Status) && Status != STATUS_BUFFER_OVERFLOW) {
+		SafeFree(Buffer);
+		return Status;
+	}
+
+	Text = (PVXLFORMATTEDTEXT) SafeAlloc(
+		BYTE,
+		sizeof(VXLFORMATTEDTEXT) + (TextHeaderCch + TextCch) * sizeof(WCHAR));
+
+	if (!Text) {
+		SafeFree(Buffer);
+		return STATUS_NO_MEMORY;
+	}
+
+	Text->LogEntryIndex = LogEntryIndex;
+	Text->TextHeaderCch = TextHeaderCch;
+	Text->TextCch = TextCch;
+	RtlCopyMemory(Text->Text, Buffer, (TextHeaderCch + TextCch) * sizeof(WCHAR));
+	SafeFree(Buffer);
+
+	//
+	// Put it in place of the oldest text in the cache.
+	//
+
+	RtlAcquireSRWLockExclusive(&LogHandle->Lock);
+	SafeFree(Cache->Slots[Cache->NextSlot]);
+	Cache->Slots[Cache->NextSlot] = Text;
+	Cache->NextSlot = (Cache->NextSlot + 1) % ARRAYSIZE(Cache->Slots);
+	RtlReleaseSRWLockExclusive(&LogHandle->Lock);
+
+	*FormattedText = Text;
+	return STATUS_SUCCESS;
+}
+
+VOID VxlpFreeFormattedTextCache(
+	IN	VXLHANDLE	LogHandle)
+{
+	PVXLFORMATTEDTEXTCACHE Cache;
+	ULONG Index;
+
+	ASSERT (LogHandle != NULL);
+
+	Cache = LogHandle->FormattedTextCache;
+
+	if (!Cache) {
+		return;
+	}
+
+	ForEachArrayItem (Cache->Slots, Index) {
+		SafeFree(Cache->Slots[Index]);
+	}
+
+	SafeFree(LogHandle->FormattedTextCache);
+}
\ No newline at end of file
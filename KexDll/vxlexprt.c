@@ -0,0 +1,564 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxlexprt.c
+//
+// Abstract:
+//
+//     Exports a whole log file, or several logs merged in time order, to
+//     text, CSV or JSON lines (see vxlfmt.c for the formats).
+//
+//     Formatting is what takes the time, so it is spread over a few worker
+//     threads. The log is split into chunks of consecutive entries, and each
+//     worker formats a chunk at a time into a large buffer. The calling
+//     thread writes the buffers out in order, so the file is written in big
+//     sequential pieces rather than one entry at a time.
+//
+//     The entries come from a merge stream (see vxlmerge.c), even when there
+//     is only one log. A worker takes the next chunk and reads its entries
+//     from the stream while holding MergeLock, so the chunks come out in
+//     order, and then reads and formats the entries without the lock.
+//
+//     There is a fixed number of buffers (slots), twice the number of
+//     workers. Chunk N always goes into slot N % NumberOfSlots, and a
+//     semaphore stops the workers from taking another chunk until a slot
+//     has been written out, so memory use doesn't depend on the size of the
+//     log and the workers can't get too far ahead of the writer.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Export several logs merged by time.
+//     agent                17-Oct-2026  Keep a time conversion cache per chunk.
+//     agent                17-Oct-2026  Give each chunk a text buffer.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+
+#define VXL_EXPORT_CHUNK_SIZE			4096		// entries formatted by a worker at a time
+#define VXL_EXPORT_MAXIMUM_WORKERS		16
+#define VXL_EXPORT_INITIAL_BUFFER_CB	0x100000
+
+typedef struct _VXLEXPORTSLOT {
+	PVXLMERGEDENTRY			Entries;				// VXL_EXPORT_CHUNK_SIZE of them
+	ULONG					NumberOfEntries;
+	PWSTR					TextBuffer;				// VXL_READ_TEXT_BUFFER_CCH, for deferred entries
+	PBYTE					Buffer;
+	ULONG					BufferCb;
+	ULONG					DataCb;
+	NTSTATUS				Status;
+	HANDLE					DoneEvent;				// set when the chunk in this slot is ready
+} TYPEDEF_TYPE_NAME(VXLEXPORTSLOT);
+
+typedef struct _VXLEXPORTCONTEXT {
+	ULONG					NumberOfLogs;
+	PVXLHANDLE				LogHandles;
+	VXLEXPORTFORMAT			Format;
+	LONGLONG				TimeZoneBias;
+	ULONG					NumberOfEntries;
+	ULONG					NumberOfChunks;
+	RTL_SRWLOCK				MergeLock;				// protects MergeHandle and NextChunk
+	VXLMERGEHANDLE			MergeHandle;
+	ULONG					NextChunk;
+	BOOLEAN VOLATILE		Cancelled;
+	HANDLE					FreeSlotSemaphore;
+	ULONG					NumberOfWorkers;
+	HANDLE					WorkerThreads[VXL_EXPORT_MAXIMUM_WORKERS];
+	ULONG					NumberOfSlots;
+	VXLEXPORTSLOT			Slots[2 * VXL_EXPORT_MAXIMUM_WORKERS];
+} TYPEDEF_TYPE_NAME(VXLEXPORTCONTEXT);
+
+//
+// Format one entry onto the end of a slot's buffer, making the buffer
+// bigger if it doesn't fit.
+//
+
+STATIC NTSTATUS VxlpAppendExportEntry(
+	IN		PVXLEXPORTCONTEXT	Context,
+	IN OUT	PVXLEXPORTSLOT		Slot,
+	IN OUT	PVXLTIMECACHE		TimeCache,
+	IN		PCVXLFORMATENTRY	Entry)
+{
+	ULONG EntryCb;
+
+	until ((EntryCb = VxlpFormatLogEntry(
+		Context->Format,
+		Entry,
+		Context->TimeZoneBias,
+		TimeCache,
+		Slot->Buffer + Slot->DataCb,
+		Slot->BufferCb - Slot->DataCb)) <= Slot->BufferCb - Slot->DataCb) {
+
+		PBYTE NewBuffer;
+		ULONG NewBufferCb;
+
+		NewBufferCb = max(Slot->BufferCb * 2, VXL_EXPORT_INITIAL_BUFFER_CB);
+		NewBufferCb = max(NewBufferCb, Slot->DataCb + EntryCb);
+
+		if (NewBufferCb < Slot->DataCb + EntryCb || NewBufferCb < Slot->BufferCb) {
+			// overflowed
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+
+		if (Slot->Buffer) {
+			NewBuffer = SafeReAlloc(Slot->Buffer, BYTE, NewBufferCb);
+		} else {
+			NewBuffer = SafeAlloc(BYTE, NewBufferCb);
+		}
+
+		if (!NewBuffer) {
+			return STATUS_NO_MEMORY;
+		}
+
+		Slot->Buffer = NewBuffer;
+		Slot->BufferCb = NewBufferCb;
+	}
+
+	Slot->DataCb += EntryCb;
+	return STATUS_SUCCESS;
+}
+
+//
+// Read and format the entries which have been put in a slot. Entries which
+// are next to each other in the same log are read together. Neighbouring
+// entries are nearly always in the same hour, so one time cache is kept for
+// the whole chunk and the calendar date is only worked out again when the
+// hour changes.
+//
+
+STATIC NTSTATUS VxlpFormatExportChunk(
+	IN		PVXLEXPORTCONTEXT	Context,
+	IN OUT	PVXLEXPORTSLOT		Slot)
+{
+	NTSTATUS Status;
+	VXLLOGENTRYVIEW Views[64];
+	VXLTIMECACHE TimeCache;
+	ULONG NumberOfViews;
+	ULONG Position;
+	ULONG Index;
+
+	Slot->DataCb = 0;
+	VxlpInitializeTimeCache(&TimeCache);
+
+	for (Position = 0; Position < Slot->NumberOfEntries; Position += NumberOfViews) {
+		PCVXLMERGEDENTRY First;
+		VXLHANDLE LogHandle;
+		ULONG RunLength;
+
+		if (Context->Cancelled) {
+			return STATUS_CANCELLED;
+		}
+
+		First = &Slot->Entries[Position];
+		LogHandle = Context->LogHandles[First->LogIndex];
+
+		for (RunLength = 1; RunLength < ARRAYSIZE(Views); ++RunLength) {
+			PCVXLMERGEDENTRY Next;
+
+			if (Position + RunLength >= Slot->NumberOfEntries) {
+				break;
+			}
+
+			Next = &Slot->Entries[Position + RunLength];
+
+			if (Next->LogIndex != First->LogIndex || Next->EntryIndex != First->EntryIndex + RunLength) {
+				break;
+			}
+		}
+
+		Status = VxlReadLogRange(
+			LogHandle,
+			First->EntryIndex,
+			RunLength,
+			Views,
+			&NumberOfViews,
+			Slot->TextBuffer,
+			VXL_READ_TEXT_BUFFER_CCH);
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+
+		if (NumberOfViews == 0) {
+			// shouldn't happen - the merge stream only returns entries which
+			// were in the log when it was created
+			return STATUS_INTERNAL_ERROR;
+		}
+
+		for (Index = 0; Index < NumberOfViews; ++Index) {
+			PCVXLLOGENTRYVIEW View;
+			VXLFORMATENTRY Entry;
+
+			View = &Views[Index];
+
+			if (View->Severity == LogSeverityInvalidValue) {
+				// couldn't be read
+				continue;
+			}
+
+			Entry.TextHeader		= View->TextHeader.Buffer ? View->TextHeader.Buffer : L"";
+			Entry.TextHeaderCch		= KexRtlUnicodeStringCch(&View->TextHeader);
+			Entry.Text				= View->Text.Buffer;
+			Entry.TextCch			= KexRtlUnicodeStringCch(&View->Text);
+			Entry.Severity			= VxlSeverityToText_ENG(View->Severity, FALSE);
+			Entry.SourceComponent	= VxlGetSourceString(LogHandle, VxlSourceComponent, View->SourceComponentIndex);
+			Entry.SourceFile		= VxlGetSourceString(LogHandle, VxlSourceFile, View->SourceFileIndex);
+			Entry.SourceFunction	= VxlGetSourceString(LogHandle, VxlSourceFunction, View->SourceFunctionIndex);
+			Entry.SourceLine		= View->SourceLine;
+			Entry.ProcessId			= View->ProcessId;
+			Entry.ThreadId			= View->ThreadId;
+			Entry.Time64			= View->Time64;
+
+			if (!Entry.SourceComponent) Entry.SourceComponent = L"";
+			if (!Entry.SourceFile) Entry.SourceFile = L"";
+			if (!Entry.SourceFunction) Entry.SourceFunction = L"";
+
+			Status = VxlpAppendExportEntry(Context, Slot, &TimeCache, &Entry);
+			if (!NT_SUCCESS(Status)) {
+				return Status;
+			}
+		}
+	}
+
+	return STATUS_SUCCESS;
+}
+
+STATIC NTSTATUS NTAPI VxlpExportWorkerThreadProc(
+	IN	PVOID	Parameter)
+{
+	NTSTATUS Status;
+	PVXLEXPORTCONTEXT Context;
+	PVXLEXPORTSLOT Slot;
+	ULONG ChunkIndex;
+
+	Context = (PVXLEXPORTCONTEXT) Parameter;
+
+	while (TRUE) {
+		NtWaitForSingleObject(Context->FreeSlotSemaphore, FALSE, NULL);
+
+		if (Context->Cancelled) {
+			break;
+		}
+
+		Slot = NULL;
+		Status = STATUS_SUCCESS;
+
+		RtlAcquireSRWLockExclusive(&Context->MergeLock);
+
+		ChunkIndex = Context->NextChunk;
+
+		if (ChunkIndex < Context->NumberOfChunks) {
+			++Context->NextChunk;
+			Slot = &Context->Slots[ChunkIndex % Context->NumberOfSlots];
+
+			Status = VxlReadMergeStream(
+				Context->MergeHandle,
+				VXL_EXPORT_CHUNK_SIZE,
+				Slot->Entries,
+				&Slot->NumberOfEntries);
+		}
+
+		RtlReleaseSRWLockExclusive(&Context->MergeLock);
+
+		if (!Slot) {
+			// Nothing left to do. Give the slot back so that the other
+			// workers find that out too.
+			NtReleaseSemaphore(Context->FreeSlotSemaphore, 1, NULL);
+			break;
+		}
+
+		if (NT_SUCCESS(Status)) {
+			Status = VxlpFormatExportChunk(Context, Slot);
+		}
+
+		Slot->Status = Status;
+		NtSetEvent(Slot->DoneEvent, NULL);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+STATIC NTSTATUS VxlpWriteExportData(
+	IN	HANDLE	FileHandle,
+	IN	PCVOID	Buffer,
+	IN	ULONG	BufferCb)
+{
+	NTSTATUS Status;
+	IO_STATUS_BLOCK IoStatusBlock;
+	LARGE_INTEGER ByteOffset;
+
+	ByteOffset.HighPart = -1;
+	ByteOffset.LowPart = FILE_WRITE_TO_END_OF_FILE;
+
+	Status = NtWriteFile(
+		FileHandle,
+		NULL,
+		NULL,
+		NULL,
+		&IoStatusBlock,
+		(PVOID) Buffer,
+		BufferCb,
+		&ByteOffset,
+		NULL);
+
+	if (Status == STATUS_PENDING) {
+		// file handle wasn't opened for synchronous I/O
+		NtWaitForSingleObject(FileHandle, FALSE, NULL);
+		Status = IoStatusBlock.Status;
+	}
+
+	return Status;
+}
+
+//
+// Write out every entry of a log to a file, in the specified format. The
+// file handle must have been opened with write access; the entries are
+// written to the end of it. The text is UTF-8. CSV and text files start with
+// a byte order mark.
+//
+// ProgressRoutine, if specified, is called from the calling thread after
+// each piece of the file has been written, with the number of entries that
+// have been written so far and the total. If it returns FALSE, the export
+// stops and STATUS_CANCELLED is returned.
+//
+// This works with logs which are still being written to; only the entries
+// which were there when it was called are exported.
+//
+
+NTSTATUS NTAPI VxlExportLog(
+	IN	VXLHANDLE						LogHandle,
+	IN	HANDLE							FileHandle,
+	IN	VXLEXPORTFORMAT					Format,
+	IN	PVXL_EXPORT_PROGRESS_ROUTINE	ProgressRoutine OPTIONAL,
+	IN	PVOID							ProgressContext OPTIONAL)
+{
+	if (!LogHandle || !FileHandle) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	if (Format < 0 || Format >= VxlExportFormatMaximum) {
+		return STATUS_INVALID_PARAMETER_3;
+	}
+
+	return VxlExportMergedLogs(
+		1,
+		&LogHandle,
+		FileHandle,
+		Format,
+		ProgressRoutine,
+		ProgressContext);
+}
+
+//
+// Same as VxlExportLog, but for several logs at once. The entries of all of
+// them are written to one file, merged in time order.
+//
+
+NTSTATUS NTAPI VxlExportMergedLogs(
+	IN	ULONG							NumberOfLogs,
+	IN	PVXLHANDLE						LogHandles,
+	IN	HANDLE							FileHandle,
+	IN	VXLEXPORTFORMAT					Format,
+	IN	PVXL_EXPORT_PROGRESS_ROUTINE	ProgressRoutine OPTIONAL,
+	IN	PVOID							ProgressContext OPTIONAL)
+{
+	NTSTATUS Status;
+	PVXLEXPORTCONTEXT Context;
+	BYTE Header[256];
+	ULONG HeaderCb;
+	ULONG ChunkIndex;
+	ULONG Index;
+
+	if (NumberOfLogs == 0 || !LogHandles || !FileHandle) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	if (Format < 0 || Format >= VxlExportFormatMaximum) {
+		return STATUS_INVALID_PARAMETER_4;
+	}
+
+	Context = SafeAlloc(VXLEXPORTCONTEXT, 1);
+	if (!Context) {
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlZeroMemory(Context, sizeof(*Context));
+	RtlInitializeSRWLock(&Context->MergeLock);
+	Context->NumberOfLogs = NumberOfLogs;
+	Context->LogHandles = LogHandles;
+	Context->Format = Format;
+
+	Status = VxlCreateMergeStream(
+		&Context->MergeHandle,
+		NumberOfLogs,
+		LogHandles,
+		&Context->NumberOfEntries);
+
+	if (!NT_SUCCESS(Status)) {
+		SafeFree(Context);
+		return Status;
+	}
+
+	Context->NumberOfChunks = (Context->NumberOfEntries + VXL_EXPORT_CHUNK_SIZE - 1) / VXL_EXPORT_CHUNK_SIZE;
+
+	// Every entry is converted with the same bias, so that the times in the
+	// file don't jump around if the time zone changes during the export.
+	do {
+		Context->TimeZoneBias = *(PLONGLONG) &SharedUserData->TimeZoneBias;
+	} until (SharedUserData->TimeZoneBias.High1Time == SharedUserData->TimeZoneBias.High2Time);
+
+	try {
+		HeaderCb = VxlpFormatExportHeader(Format, Header, sizeof(Header));
+		ASSERT (HeaderCb <= sizeof(Header));
+
+		if (HeaderCb != 0) {
+			Status = VxlpWriteExportData(FileHandle, Header, HeaderCb);
+			if (!NT_SUCCESS(Status)) {
+				leave;
+			}
+		}
+
+		if (Context->NumberOfChunks == 0) {
+			Status = STATUS_SUCCESS;
+			leave;
+		}
+
+		Context->NumberOfWorkers = NtCurrentPeb()->NumberOfProcessors;
+		Context->NumberOfWorkers = min(Context->NumberOfWorkers, Context->NumberOfChunks);
+		Context->NumberOfWorkers = min(Context->NumberOfWorkers, VXL_EXPORT_MAXIMUM_WORKERS);
+		Context->NumberOfWorkers = max(Context->NumberOfWorkers, 1);
+		Context->NumberOfSlots = Context->NumberOfWorkers * 2;
+
+		for (Index = 0; Index < Context->NumberOfSlots; ++Index) {
+			Context->Slots[Index].Entries = SafeAlloc(VXLMERGEDENTRY, VXL_EXPORT_CHUNK_SIZE);
+			Context->Slots[Index].TextBuffer = SafeAlloc(WCHAR, VXL_READ_TEXT_BUFFER_CCH);
+
+			if (!Context->Slots[Index].Entries || !Context->Slots[Index].TextBuffer) {
+				Status = STATUS_NO_MEMORY;
+				leave;
+			}
+
+			Status = NtCreateEvent(
+				&Context->Slots[Index].DoneEvent,
+				SYNCHRONIZE | EVENT_MODIFY_STATE,
+				NULL,
+				SynchronizationEvent,
+				FALSE);
+
+			if (!NT_SUCCESS(Status)) {
+				leave;
+			}
+		}
+
+		// Leave room above the number of slots for waking up all of the
+		// workers when the export is cancelled.
+		Status = NtCreateSemaphore(
+			&Context->FreeSlotSemaphore,
+			SEMAPHORE_ALL_ACCESS,
+			NULL,
+			Context->NumberOfSlots,
+			Context->NumberOfSlots + Context->NumberOfWorkers);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		for (Index = 0; Index < Context->NumberOfWorkers; ++Index) {
+			Status = RtlCreateUserThread(
+				NtCurrentProcess(),
+				NULL,
+				FALSE,
+				0,
+				0,
+				0,
+				VxlpExportWorkerThreadProc,
+				Context,
+				&Context->WorkerThreads[Index],
+				NULL);
+
+			if (!NT_SUCCESS(Status)) {
+				Context->WorkerThreads[Index] = NULL;
+				leave;
+			}
+		}
+
+		//
+		// Write out the chunks in order as they become ready.
+		//
+
+		for (ChunkIndex = 0; ChunkIndex < Context->NumberOfChunks; ++ChunkIndex) {
+			PVXLEXPORTSLOT Slot;
+
+			Slot = &Context->Slots[ChunkIndex % Context->NumberOfSlots];
+			NtWaitForSingleObject(Slot->DoneEvent, FALSE, NULL);
+
+			Status = Slot->Status;
+			if (!NT_SUCCESS(Status)) {
+				leave;
+			}
+
+			if (Slot->DataCb != 0) {
+				Status = VxlpWriteExportData(FileHandle, Slot->Buffer, Slot->DataCb);
+				if (!NT_SUCCESS(Status)) {
+					leave;
+				}
+			}
+
+			NtReleaseSemaphore(Context->FreeSlotSemaphore, 1, NULL);
+
+			if (ProgressRoutine) {
+				ULONG NumberOfEntriesWritten;
+
+				NumberOfEntriesWritten = min((ChunkIndex + 1) * VXL_EXPORT_CHUNK_SIZE, Context->NumberOfEntries);
+
+				unless (ProgressRoutine(ProgressContext, NumberOfEntriesWritten, Context->NumberOfEntries)) {
+					Status = STATUS_CANCELLED;
+					leave;
+				}
+			}
+		}
+
+		Status = STATUS_SUCCESS;
+	} finally {
+		Context->Cancelled = TRUE;
+
+		if (Context->NumberOfWorkers != 0) {
+			// Wake up any workers which are waiting for a slot. Each of them
+			// takes at most one more slot before it sees that it has to stop.
+			NtReleaseSemaphore(Context->FreeSlotSemaphore, Context->NumberOfWorkers, NULL);
+		}
+
+		for (Index = 0; Index < Context->NumberOfWorkers; ++Index) {
+			if (Context->WorkerThreads[Index]) {
+				NtWaitForSingleObject(Context->WorkerThreads[Index], FALSE, NULL);
+				NtClose(Context->WorkerThreads[Index]);
+			}
+		}
+
+		for (Index = 0; Index < Context->NumberOfSlots; ++Index) {
+			SafeFree(Context->Slots[Index].Entries);
+			SafeFree(Context->Slots[Index].TextBuffer);
+			SafeFree(Context->Slots[Index].Buffer);
+
+			if (Context->Slots[Index].DoneEvent) {
+				NtClose(Context->Slots[Index].DoneEvent);
+			}
+		}
+
+		if (Context->FreeSlotSemaphore) {
+			NtClose(Context->FreeSlotSemaphore);
+		}
+
+		VxlCloseMergeStream(&Context->MergeHandle);
+		SafeFree(Context);
+	}
+
+	return Status;
+}
\ No newline at end of file
@@ -0,0 +1,440 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxlfmt.c
+//
+// Abstract:
+//
+//     Turns log entries into UTF-8 text for VxlExportLog, in one of the
+//     formats in VXLEXPORTFORMAT:
+//
+//       Text        [time pid:tid component\file:line (function)] header // text
+//       CSV         one record per entry, with a header row (RFC 4180)
+//       JSON lines  one object per line
+//
+//     The plain text format uses local time, like the log viewer does. CSV
+//     and JSON use UTC (ISO 8601 with a trailing Z), so that the output
+//     doesn't depend on the time zone of the machine doing the export.
+//     The log viewer's own text export is UTF-16 with dates in the user's
+//     locale, which can't be done here. VxlView writes that one itself.
+//
+//     Nothing here allocates memory: each routine writes as much as fits in
+//     the caller's buffer and returns the number of bytes it needed, so the
+//     caller can make the buffer bigger and try again.
+//
+//     This file does not use anything from the rest of KexDll, and can be
+//     built on a non-Windows host with KEX_ENV_HOST defined for testing
+//     (see 01-Tests/vxlfmttest).
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Add VxlpFormatString.
+//     agent                17-Oct-2026  Convert times through a VXLTIMECACHE.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef KEX_ENV_HOST
+#  include <KexHost.h>
+#  include "vxlfmt.h"
+#else
+#  include "buildcfg.h"
+#  include "kexdllp.h"
+#endif
+
+typedef enum _VXLFORMATESCAPE {
+	FormatEscapeNone,
+	FormatEscapeCsv,
+	FormatEscapeJson
+} VXLFORMATESCAPE;
+
+typedef struct _VXLFORMATWRITER {
+	PBYTE					Buffer;
+	ULONG					BufferCb;
+	ULONG					Position;				// may be past the end of the buffer
+} TYPEDEF_TYPE_NAME(VXLFORMATWRITER);
+
+STATIC CONST CHAR VxlpHexDigits[] = "0123456789abcdef";
+
+STATIC FORCEINLINE VOID VxlpPutByte(
+	IN OUT	PVXLFORMATWRITER	Writer,
+	IN		BYTE				Byte)
+{
+	if (Writer->Position < Writer->BufferCb) {
+		Writer->Buffer[Writer->Position] = Byte;
+	}
+
+	++Writer->Position;
+}
+
+STATIC VOID VxlpPutAscii(
+	IN OUT	PVXLFORMATWRITER	Writer,
+	IN		PCSTR				String)
+{
+	while (*String) {
+		VxlpPutByte(Writer, (BYTE) *String++);
+	}
+}
+
+STATIC VOID VxlpPutDecimal(
+	IN OUT	PVXLFORMATWRITER	Writer,
+	IN		ULONG				Value,
+	IN		ULONG				MinimumDigits)
+{
+	CHAR Digits[10];
+	ULONG NumberOfDigits;
+
+	NumberOfDigits = 0;
+
+	do {
+		Digits[NumberOfDigits++] = (CHAR) ('0' + Value % 10);
+		Value /= 10;
+	} while (Value != 0);
+
+	while (MinimumDigits > NumberOfDigits) {
+		VxlpPutByte(Writer, '0');
+		--MinimumDigits;
+	}
+
+	while (NumberOfDigits != 0) {
+		VxlpPutByte(Writer, Digits[--NumberOfDigits]);
+	}
+}
+
+STATIC VOID VxlpPutHex(
+	IN OUT	PVXLFORMATWRITER	Writer,
+	IN		ULONG				Value,
+	IN		ULONG				MinimumDigits)
+{
+	CHAR Digits[8];
+	ULONG NumberOfDigits;
+
+	NumberOfDigits = 0;
+
+	do {
+		Digits[NumberOfDigits++] = VxlpHexDigits[Value & 0xF];
+		Value >>= 4;
+	} while (Value != 0);
+
+	while (MinimumDigits > NumberOfDigits) {
+		VxlpPutByte(Writer, '0');
+		--MinimumDigits;
+	}
+
+	while (NumberOfDigits != 0) {
+		VxlpPutByte(Writer, Digits[--NumberOfDigits]);
+	}
+}
+
+STATIC ULONG VxlpStringCch(
+	IN	PCWSTR	String)
+{
+	ULONG Cch;
+
+	for (Cch = 0; String[Cch] != '\0'; ++Cch);
+	return Cch;
+}
+
+//
+// Write out UTF-16 text as UTF-8, escaped as needed for the output format.
+// Unpaired surrogates become U+FFFD.
+//
+
+STATIC VOID VxlpPutText(
+	IN OUT	PVXLFORMATWRITER	Writer,
+	IN		PCWSTR				Text,
+	IN		ULONG				TextCch,
+	IN		VXLFORMATESCAPE		Escape)
+{
+	ULONG Index;
+
+	for (Index = 0; Index < TextCch; ++Index) {
+		ULONG Character;
+
+		Character = Text[Index];
+
+		if (Character < 0x80) {
+			if (Escape == FormatEscapeCsv && Character == '"') {
+				VxlpPutByte(Writer, '"');
+			} else if (Escape == FormatEscapeJson && (Character < 0x20 || Character == '"' || Character == '\\')) {
+				VxlpPutByte(Writer, '\\');
+
+				switch (Character) {
+				case '"':	VxlpPutByte(Writer, '"');	continue;
+				case '\\':	VxlpPutByte(Writer, '\\');	continue;
+				case '\b':	VxlpPutByte(Writer, 'b');	continue;
+				case '\f':	VxlpPutByte(Writer, 'f');	continue;
+				case '\n':	VxlpPutByte(Writer, 'n');	continue;
+				case '\r':	VxlpPutByte(Writer, 'r');	continue;
+				case '\t':	VxlpPutByte(Writer, 't');	continue;
+				}
+
+				VxlpPutAscii(Writer, "u00");
+				VxlpPutHex(Writer, Character, 2);
+				continue;
+			}
+
+			VxlpPutByte(Writer, (BYTE) Character);
+			continue;
+		}
+
+		if (Character >= 0xD800 && Character <= 0xDFFF) {
+			if (Character <= 0xDBFF && Index + 1 < TextCch &&
+				Text[Index + 1] >= 0xDC00 && Text[Index + 1] <= 0xDFFF) {
+
+				Character = 0x10000 + ((Character - 0xD800) << 10) + (Text[Index + 1] - 0xDC00);
+				++Index;
+			} else {
+				Character = 0xFFFD;
+			}
+		}
+
+		if (Character < 0x800) {
+			VxlpPutByte(Writer, (BYTE) (0xC0 | (Character >> 6)));
+		} else if (Character < 0x10000) {
+			VxlpPutByte(Writer, (BYTE) (0xE0 | (Character >> 12)));
+			VxlpPutByte(Writer, (BYTE) (0x80 | ((Character >> 6) & 0x3F)));
+		} else {
+			VxlpPutByte(Writer, (BYTE) (0xF0 | (Character >> 18)));
+			VxlpPutByte(Writer, (BYTE) (0x80 | ((Character >> 12) & 0x3F)));
+			VxlpPutByte(Writer, (BYTE) (0x80 | ((Character >> 6) & 0x3F)));
+		}
+
+		VxlpPutByte(Writer, (BYTE) (0x80 | (Character & 0x3F)));
+	}
+}
+
+//
+// Write a quoted CSV field or JSON string.
+//
+
+STATIC VOID VxlpPutQuotedText(
+	IN OUT	PVXLFORMATWRITER	Writer,
+	IN		PCWSTR				Text,
+	IN		ULONG				TextCch,
+	IN		VXLFORMATESCAPE		Escape)
+{
+	VxlpPutByte(Writer, '"');
+	VxlpPutText(Writer, Text, TextCch, Escape);
+	VxlpPutByte(Writer, '"');
+}
+
+//
+// Write a timestamp as YYYY-MM-DD HH:MM:SS.mmm, with a T instead of the
+// space and a Z on the end if it is in UTC. Time64 is in 100ns intervals
+// since 1601, like a FILETIME.
+//
+
+STATIC VOID VxlpPutTime(
+	IN OUT	PVXLFORMATWRITER	Writer,
+	IN OUT	PVXLTIMECACHE		TimeCache,
+	IN		LONGLONG			Time64,
+	IN		BOOLEAN				Utc)
+{
+	SYSTEMTIME Time;
+
+	VxlpConvertTime(TimeCache, Time64, &Time);
+
+	VxlpPutDecimal(Writer, Time.wYear, 4);
+	VxlpPutByte(Writer, '-');
+	VxlpPutDecimal(Writer, Time.wMonth, 2);
+	VxlpPutByte(Writer, '-');
+	VxlpPutDecimal(Writer, Time.wDay, 2);
+	VxlpPutByte(Writer, Utc ? 'T' : ' ');
+	VxlpPutDecimal(Writer, Time.wHour, 2);
+	VxlpPutByte(Writer, ':');
+	VxlpPutDecimal(Writer, Time.wMinute, 2);
+	VxlpPutByte(Writer, ':');
+	VxlpPutDecimal(Writer, Time.wSecond, 2);
+	VxlpPutByte(Writer, '.');
+	VxlpPutDecimal(Writer, Time.wMilliseconds, 3);
+
+	if (Utc) {
+		VxlpPutByte(Writer, 'Z');
+	}
+}
+
+//
+// Write whatever has to come before the first entry: a byte order mark, so
+// that Notepad and Excel know the file is UTF-8, and the CSV header row.
+//
+
+ULONG VxlpFormatExportHeader(
+	IN	VXLEXPORTFORMAT		Format,
+	OUT	PBYTE				Buffer,
+	IN	ULONG				BufferCb)
+{
+	VXLFORMATWRITER Writer;
+
+	Writer.Buffer = Buffer;
+	Writer.BufferCb = BufferCb;
+	Writer.Position = 0;
+
+	if (Format == VxlExportFormatText || Format == VxlExportFormatCsv) {
+		VxlpPutAscii(&Writer, "\xEF\xBB\xBF");
+	}
+
+	if (Format == VxlExportFormatCsv) {
+		VxlpPutAscii(&Writer, "Time,Severity,ProcessId,ThreadId,Component,File,Line,Function,TextHeader,Text\r\n");
+	}
+
+	return Writer.Position;
+}
+
+//
+// Format one log entry. TimeZoneBias is subtracted from the timestamp for
+// the formats which use local time. TimeCache must have been initialized
+// with VxlpInitializeTimeCache, and should be passed again for the next
+// entry. Returns the number of bytes needed, which is more than BufferCb
+// if the entry didn't fit.
+//
+
+ULONG VxlpFormatLogEntry(
+	IN		VXLEXPORTFORMAT		Format,
+	IN		PCVXLFORMATENTRY	Entry,
+	IN		LONGLONG			TimeZoneBias,
+	IN OUT	PVXLTIMECACHE		TimeCache,
+	OUT		PBYTE				Buffer,
+	IN		ULONG				BufferCb)
+{
+	VXLFORMATWRITER Writer;
+
+	ASSERT (Entry != NULL);
+
+	Writer.Buffer = Buffer;
+	Writer.BufferCb = BufferCb;
+	Writer.Position = 0;
+
+	switch (Format) {
+	case VxlExportFormatText:
+		VxlpPutByte(&Writer, '[');
+		VxlpPutTime(&Writer, TimeCache, Entry->Time64 - TimeZoneBias, FALSE);
+		VxlpPutByte(&Writer, ' ');
+		VxlpPutHex(&Writer, Entry->ProcessId, 4);
+		VxlpPutByte(&Writer, ':');
+		VxlpPutHex(&Writer, Entry->ThreadId, 4);
+		VxlpPutByte(&Writer, ' ');
+		VxlpPutText(&Writer, Entry->SourceComponent, VxlpStringCch(Entry->SourceComponent), FormatEscapeNone);
+		VxlpPutByte(&Writer, '\\');
+		VxlpPutText(&Writer, Entry->SourceFile, VxlpStringCch(Entry->SourceFile), FormatEscapeNone);
+		VxlpPutByte(&Writer, ':');
+		VxlpPutDecimal(&Writer, Entry->SourceLine, 0);
+		VxlpPutAscii(&Writer, " (");
+		VxlpPutText(&Writer, Entry->SourceFunction, VxlpStringCch(Entry->SourceFunction), FormatEscapeNone);
+		VxlpPutAscii(&Writer, ")] ");
+		VxlpPutText(&Writer, Entry->TextHeader, Entry->TextHeaderCch, FormatEscapeNone);
+
+		if (Entry->Text && Entry->TextCch != 0) {
+			VxlpPutAscii(&Writer, " // ");
+			VxlpPutText(&Writer, Entry->Text, Entry->TextCch, FormatEscapeNone);
+		}
+
+		VxlpPutAscii(&Writer, "\r\n");
+		break;
+	case VxlExportFormatCsv:
+		VxlpPutTime(&Writer, TimeCache, Entry->Time64, TRUE);
+		VxlpPutByte(&Writer, ',');
+		VxlpPutText(&Writer, Entry->Severity, VxlpStringCch(Entry->Severity), FormatEscapeNone);
+		VxlpPutByte(&Writer, ',');
+		VxlpPutDecimal(&Writer, Entry->ProcessId, 0);
+		VxlpPutByte(&Writer, ',');
+		VxlpPutDecimal(&Writer, Entry->ThreadId, 0);
+		VxlpPutByte(&Writer, ',');
+		VxlpPutQuotedText(&Writer, Entry->SourceComponent, VxlpStringCch(Entry->SourceComponent), FormatEscapeCsv);
+		VxlpPutByte(&Writer, ',');
+		VxlpPutQuotedText(&Writer, Entry->SourceFile, VxlpStringCch(Entry->SourceFile), FormatEscapeCsv);
+		VxlpPutByte(&Writer, ',');
+		VxlpPutDecimal(&Writer, Entry->SourceLine, 0);
+		VxlpPutByte(&Writer, ',');
+		VxlpPutQuotedText(&Writer, Entry->SourceFunction, VxlpStringCch(Entry->SourceFunction), FormatEscapeCsv);
+		VxlpPutByte(&Writer, ',');
+		VxlpPutQuotedText(&Writer, Entry->TextHeader, Entry->TextHeaderCch, FormatEscapeCsv);
+		VxlpPutByte(&Writer, ',');
+
+		if (Entry->Text) {
+			VxlpPutQuotedText(&Writer, Entry->Text, Entry->TextCch, FormatEscapeCsv);
+		}
+
+		VxlpPutAscii(&Writer, "\r\n");
+		break;
+	case VxlExportFormatJsonLines:
+		VxlpPutAscii(&Writer, "{\"time\":\"");
+		VxlpPutTime(&Writer, TimeCache, Entry->Time64, TRUE);
+		VxlpPutAscii(&Writer, "\",\"severity\":");
+		VxlpPutQuotedText(&Writer, Entry->Severity, VxlpStringCch(Entry->Severity), FormatEscapeJson);
+		VxlpPutAscii(&Writer, ",\"pid\":");
+		VxlpPutDecimal(&Writer, Entry->ProcessId, 0);
+		VxlpPutAscii(&Writer, ",\"tid\":");
+		VxlpPutDecimal(&Writer, Entry->ThreadId, 0);
+		VxlpPutAscii(&Writer, ",\"component\":");
+		VxlpPutQuotedText(&Writer, Entry->SourceComponent, VxlpStringCch(Entry->SourceComponent), FormatEscapeJson);
+		VxlpPutAscii(&Writer, ",\"file\":");
+		VxlpPutQuotedText(&Writer, Entry->SourceFile, VxlpStringCch(Entry->SourceFile), FormatEscapeJson);
+		VxlpPutAscii(&Writer, ",\"line\":");
+		VxlpPutDecimal(&Writer, Entry->SourceLine, 0);
+		VxlpPutAscii(&Writer, ",\"function\":");
+		VxlpPutQuotedText(&Writer, Entry->SourceFunction, VxlpStringCch(Entry->SourceFunction), FormatEscapeJson);
+		VxlpPutAscii(&Writer, ",\"header\":");
+		VxlpPutQuotedText(&Writer, Entry->TextHeader, Entry->TextHeaderCch, FormatEscapeJson);
+		VxlpPutAscii(&Writer, ",\"text\":");
+
+		if (Entry->Text) {
+			VxlpPutQuotedText(&Writer, Entry->Text, Entry->TextCch, FormatEscapeJson);
+		} else {
+			VxlpPutAscii(&Writer, "null");
+		}
+
+		VxlpPutAscii(&Writer, "}\n");
+		break;
+	default:
+		ASSERT (FALSE);
+		break;
+	}
+
+	return Writer.Position;
+}
+
+//
+// Format a single string as a field of the output format: as it is for
+// text, and quoted and escaped for CSV and JSON. This is for tools which
+// write out things other than log entries (for example, vxltool's top-N
+// reports) and want them to be quoted in the same way.
+//
+
+ULONG VxlpFormatString(
+	IN	VXLEXPORTFORMAT		Format,
+	IN	PCWSTR				String,
+	IN	ULONG				StringCch,
+	OUT	PBYTE				Buffer,
+	IN	ULONG				BufferCb)
+{
+	VXLFORMATWRITER Writer;
+
+	ASSERT (String != NULL);
+
+	Writer.Buffer = Buffer;
+	Writer.BufferCb = BufferCb;
+	Writer.Position = 0;
+
+	switch (Format) {
+	case VxlExportFormatText:
+		VxlpPutText(&Writer, String, StringCch, FormatEscapeNone);
+		break;
+	case VxlExportFormatCsv:
+		VxlpPutQuotedText(&Writer, String, StringCch, FormatEscapeCsv);
+		break;
+	case VxlExportFormatJsonLines:
+		VxlpPutQuotedText(&Writer, String, StringCch, FormatEscapeJson);
+		break;
+	default:
+		ASSERT (FALSE);
+		break;
+	}
+
+	return Writer.Position;
+}
\ No newline at end of file
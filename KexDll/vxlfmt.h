@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxlfmt.h
+//
+// Abstract:
+//
+//     Declarations for the log entry formatter used by VxlExportLog
+//     (vxlfmt.c). This header is also used by the host build of vxlfmt.c,
+//     so it must not depend on anything except the basic types.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Add VxlpFormatString.
+//     agent                17-Oct-2026  Convert times through a VXLTIMECACHE.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "vxltime.h"
+
+#ifdef KEX_ENV_HOST
+typedef enum _VXLEXPORTFORMAT {
+	VxlExportFormatText,
+	VxlExportFormatCsv,
+	VxlExportFormatJsonLines,
+	VxlExportFormatMaximum
+} VXLEXPORTFORMAT;
+#endif
+
+//
+// Everything the formatter needs to know about one log entry. The source
+// strings have already been looked up, so that the formatter doesn't need
+// a log handle.
+//
+
+typedef struct _VXLFORMATENTRY {
+	PCWSTR					TextHeader;
+	ULONG					TextHeaderCch;
+	PCWSTR					Text;					// NULL if the entry has no body text
+	ULONG					TextCch;
+	PCWSTR					Severity;
+	PCWSTR					SourceComponent;		// source strings are null terminated
+	PCWSTR					SourceFile;
+	PCWSTR					SourceFunction;
+	ULONG					SourceLine;
+	ULONG					ProcessId;
+	ULONG					ThreadId;
+	LONGLONG				Time64;					// UTC
+} TYPEDEF_TYPE_NAME(VXLFORMATENTRY);
+
+ULONG VxlpFormatExportHeader(
+	IN	VXLEXPORTFORMAT		Format,
+	OUT	PBYTE				Buffer,
+	IN	ULONG				BufferCb);
+
+ULONG VxlpFormatLogEntry(
+	IN		VXLEXPORTFORMAT		Format,
+	IN		PCVXLFORMATENTRY	Entry,
+	IN		LONGLONG			TimeZoneBias,
+	IN OUT	PVXLTIMECACHE		TimeCache,
+	OUT		PBYTE				Buffer,
+	IN		ULONG				BufferCb);
+
+ULONG VxlpFormatString(
+	IN	VXLEXPORTFORMAT		Format,
+	IN	PCWSTR				String,
+	IN	ULONG				StringCch,
+	OUT	PBYTE				Buffer,
+	IN	ULONG				BufferCb);
\ No newline at end of file
@@ -0,0 +1,1129 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxlindex.c
+//
+// Abstract:
+//
+//     Incremental index for log files opened with VXL_OPEN_INCREMENTAL_INDEX.
+//
+//     Normally, every record in a log file is looked at when it is opened
+//     for reading, so that EntryIndexToFileOffset can be filled out. For a
+//     log of several GB this takes a long time. In incremental mode, only
+//     the first VXL_INDEX_CHUNK_SIZE entries are indexed when the log is
+//     opened. The rest is indexed, one chunk at a time, by a background
+//     thread, or by whichever thread first asks for an entry that hasn't
+//     been reached yet.
+//
+//     EntryIndexToFileOffset is reserved in full up front, but only committed
+//     as far as the index has got.
+//
+//     When a log is opened with VXL_OPEN_FOLLOW, the index keeps growing as
+//     entries are added to the log (see vxltail.c).
+//
+//     Once a large log has been fully indexed, the index is saved to a .vxli
+//     file next to it. The next time the log is opened, the .vxli file is
+//     mapped copy-on-write and used as EntryIndexToFileOffset directly, so
+//     nothing needs to be scanned at all.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Let the index grow for VXL_OPEN_FOLLOW
+//     agent                17-Oct-2026  Share VxlpQueryLogLastWriteTime
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+
+STATIC CONST CHAR VXLI_MAGIC[] = {'V','X','L','I'};
+
+//
+// Get the NT name of a log file. There is room for one more character at
+// the end of the returned string. Free with RtlFreeUnicodeString.
+//
+
+NTSTATUS VxlpGetLogFileName(
+	IN	VXLHANDLE			LogHandle,
+	OUT	PUNICODE_STRING		FileName)
+{
+	NTSTATUS Status;
+	PUNICODE_STRING ObjectName;
+	ULONG ObjectNameCb;
+
+	RtlZeroMemory(FileName, sizeof(*FileName));
+
+	Status = NtQueryObject(
+		LogHandle->FileHandle,
+		ObjectNameInformation,
+		NULL,
+		0,
+		&ObjectNameCb);
+
+	if (Status != STATUS_INFO_LENGTH_MISMATCH && Status != STATUS_BUFFER_TOO_SMALL) {
+		return NT_SUCCESS(Status) ? STATUS_UNSUCCESSFUL : Status;
+	}
+
+	ObjectName = (PUNICODE_STRING) SafeAlloc(BYTE, ObjectNameCb);
+	if (!ObjectName) {
+		return STATUS_NO_MEMORY;
+	}
+
+	try {
+		Status = NtQueryObject(
+			LogHandle->FileHandle,
+			ObjectNameInformation,
+			ObjectName,
+			ObjectNameCb,
+			&ObjectNameCb);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		if (ObjectName->Length > 0xFFFE - sizeof(WCHAR)) {
+			Status = STATUS_NAME_TOO_LONG;
+			leave;
+		}
+
+		FileName->Length = ObjectName->Length;
+		FileName->MaximumLength = ObjectName->Length + sizeof(WCHAR);
+		FileName->Buffer = (PWSTR) RtlAllocateHeap(RtlProcessHeap(), 0, FileName->MaximumLength);
+
+		if (!FileName->Buffer) {
+			Status = STATUS_NO_MEMORY;
+			leave;
+		}
+
+		RtlCopyMemory(FileName->Buffer, ObjectName->Buffer, ObjectName->Length);
+	} finally {
+		SafeFree(ObjectName);
+	}
+
+	return Status;
+}
+
+//
+// Get the NT name of the .vxli file for a log, which is the name of the log
+// file with an "i" on the end. Free with RtlFreeUnicodeString.
+//
+
+STATIC NTSTATUS VxlpGetIndexFileName(
+	IN	VXLHANDLE			LogHandle,
+	OUT	PUNICODE_STRING		IndexFileName)
+{
+	NTSTATUS Status;
+
+	Status = VxlpGetLogFileName(LogHandle, IndexFileName);
+
+	if (NT_SUCCESS(Status)) {
+		IndexFileName->Buffer[IndexFileName->Length / sizeof(WCHAR)] = 'i';
+		IndexFileName->Length += sizeof(WCHAR);
+	}
+
+	return Status;
+}
+
+NTSTATUS VxlpQueryLogLastWriteTime(
+	IN	VXLHANDLE			LogHandle,
+	OUT	PLONGLONG			LastWriteTime)
+{
+	NTSTATUS Status;
+	IO_STATUS_BLOCK IoStatusBlock;
+	FILE_BASIC_INFORMATION BasicInformation;
+
+	Status = NtQueryInformationFile(
+		LogHandle->FileHandle,
+		&IoStatusBlock,
+		&BasicInformation,
+		sizeof(BasicInformation),
+		FileBasicInformation);
+
+	if (NT_SUCCESS(Status)) {
+		*LastWriteTime = BasicInformation.LastWriteTime.QuadPart;
+	}
+
+	return Status;
+}
+
+STATIC VOID VxlpFreeEntryOffsets(
+	IN	VXLHANDLE			LogHandle)
+{
+	PVXLINDEXCONTEXT IndexContext;
+
+	IndexContext = LogHandle->IndexContext;
+
+	if (IndexContext->IndexFileView) {
+		NtUnmapViewOfSection(NtCurrentProcess(), IndexContext->IndexFileView);
+		IndexContext->IndexFileView = NULL;
+	} else if (LogHandle->EntryIndexToFileOffset) {
+		PVOID RegionBase;
+		SIZE_T RegionSize;
+
+		RegionBase = LogHandle->EntryIndexToFileOffset;
+		RegionSize = 0;
+
+		NtFreeVirtualMemory(
+			NtCurrentProcess(),
+			&RegionBase,
+			&RegionSize,
+			MEM_RELEASE);
+	}
+}
+
+//
+// Make sure that the offsets of the first NumberOfEntries entries can be
+// stored. Must be called with the lock held exclusive.
+//
+
+STATIC NTSTATUS VxlpCommitIndex(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONG				NumberOfEntries)
+{
+	NTSTATUS Status;
+	PVXLINDEXCONTEXT IndexContext;
+	PVOID RegionBase;
+	SIZE_T RegionSize;
+
+	IndexContext = LogHandle->IndexContext;
+
+	ASSERT (NumberOfEntries <= IndexContext->NumberOfReservedEntries);
+
+	if (NumberOfEntries <= IndexContext->NumberOfCommittedEntries) {
+		return STATUS_SUCCESS;
+	}
+
+	RegionBase = &LogHandle->EntryIndexToFileOffset[IndexContext->NumberOfCommittedEntries];
+	RegionSize = (NumberOfEntries - IndexContext->NumberOfCommittedEntries) * sizeof(ULONG);
+
+	Status = NtAllocateVirtualMemory(
+		NtCurrentProcess(),
+		&RegionBase,
+		0,
+		&RegionSize,
+		MEM_COMMIT,
+		PAGE_READWRITE);
+
+	if (NT_SUCCESS(Status)) {
+		IndexContext->NumberOfCommittedEntries = NumberOfEntries;
+	}
+
+	return Status;
+}
+
+//
+// Write out a .vxli file for a fully indexed log. Failure doesn't matter,
+// it only means that the next open will be slower. Must be called with the
+// lock held exclusive.
+//
+
+STATIC VOID VxlpWriteIndexFile(
+	IN	VXLHANDLE			LogHandle)
+{
+	NTSTATUS Status;
+	UNICODE_STRING IndexFileName;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	IO_STATUS_BLOCK IoStatusBlock;
+	HANDLE IndexFileHandle;
+	VXLINDEXFILEHEADER IndexFileHeader;
+	PVXLINDEXFILEBLOCK Blocks;
+	PULONG StringOffsets;
+	ULONG NumberOfStrings;
+	ULONG SourceType;
+	ULONG Index;
+
+	ASSERT (LogHandle->IndexContext->Complete);
+
+	if (LogHandle->IndexContext->NumberOfEntries < VXL_INDEX_FILE_MINIMUM_ENTRIES) {
+		return;
+	}
+
+	if (LogHandle->Header->Dirty) {
+		// Still being written to, or the writer crashed.
+		return;
+	}
+
+	RtlZeroMemory(&IndexFileHeader, sizeof(IndexFileHeader));
+	RtlCopyMemory(IndexFileHeader.Magic, VXLI_MAGIC, sizeof(VXLI_MAGIC));
+	IndexFileHeader.Version = VXLI_VERSION;
+	IndexFileHeader.LogCommittedLength = LogHandle->IndexContext->CommittedLength;
+	IndexFileHeader.NumberOfEntries = LogHandle->IndexContext->NumberOfEntries;
+	IndexFileHeader.NumberOfBlocks = LogHandle->NumberOfBlocks;
+
+	Status = VxlpQueryLogLastWriteTime(LogHandle, &IndexFileHeader.LogLastWriteTime);
+	if (!NT_SUCCESS(Status)) {
+		return;
+	}
+
+	NumberOfStrings = 0;
+
+	ForEachArrayItem (IndexFileHeader.NumberOfStrings, SourceType) {
+		IndexFileHeader.NumberOfStrings[SourceType] = LogHandle->SourceTables->Tables[SourceType].NumberOfStrings;
+		NumberOfStrings += IndexFileHeader.NumberOfStrings[SourceType];
+	}
+
+	Status = VxlpGetIndexFileName(LogHandle, &IndexFileName);
+	if (!NT_SUCCESS(Status)) {
+		return;
+	}
+
+	IndexFileHandle = NULL;
+	Blocks = NULL;
+	StringOffsets = NULL;
+
+	try {
+		LONGLONG ByteOffset;
+
+		//
+		// The strings were loaded straight out of the mapped log file, so
+		// their record offsets can be worked out from where they are.
+		//
+
+		Blocks = SafeAlloc(VXLINDEXFILEBLOCK, max(LogHandle->NumberOfBlocks, 1));
+		StringOffsets = SafeAlloc(ULONG, max(NumberOfStrings, 1));
+
+		if (!Blocks || !StringOffsets) {
+			leave;
+		}
+
+		for (Index = 0; Index < LogHandle->NumberOfBlocks; ++Index) {
+			Blocks[Index].FileOffset = LogHandle->Blocks[Index].FileOffset;
+			Blocks[Index].FirstEntryIndex = LogHandle->Blocks[Index].FirstEntryIndex;
+			Blocks[Index].EntryCount = LogHandle->Blocks[Index].EntryCount;
+		}
+
+		NumberOfStrings = 0;
+
+		ForEachArrayItem (IndexFileHeader.NumberOfStrings, SourceType) {
+			for (Index = 0; Index < IndexFileHeader.NumberOfStrings[SourceType]; ++Index) {
+				PCWSTR String;
+
+				String = VxlGetSourceString(LogHandle, (VXLSOURCETYPE) SourceType, Index);
+				ASSERT (String != NULL);
+
+				StringOffsets[NumberOfStrings++] = (ULONG) (
+					VA_TO_RVA(LogHandle->MappedFile, String) - FIELD_OFFSET(VXLLOGFILESTRING, String));
+			}
+		}
+
+		InitializeObjectAttributes(
+			&ObjectAttributes,
+			&IndexFileName,
+			OBJ_CASE_INSENSITIVE,
+			NULL,
+			NULL);
+
+		Status = NtCreateFile(
+			&IndexFileHandle,
+			GENERIC_WRITE | SYNCHRONIZE,
+			&ObjectAttributes,
+			&IoStatusBlock,
+			NULL,
+			FILE_ATTRIBUTE_NORMAL,
+			FILE_SHARE_READ,
+			FILE_OVERWRITE_IF,
+			FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE | FILE_SEQUENTIAL_ONLY,
+			NULL,
+			0);
+
+		if (!NT_SUCCESS(Status)) {
+			IndexFileHandle = NULL;
+			leave;
+		}
+
+		//
+		// Write the header last. If anything before it fails, the space for
+		// the header is left as zeroes, and the .vxli file is never used.
+		//
+
+		ByteOffset = sizeof(IndexFileHeader);
+
+		Status = NtWriteFile(
+			IndexFileHandle,
+			NULL,
+			NULL,
+			NULL,
+			&IoStatusBlock,
+			LogHandle->EntryIndexToFileOffset,
+			IndexFileHeader.NumberOfEntries * sizeof(ULONG),
+			&ByteOffset,
+			NULL);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		ByteOffset += IndexFileHeader.NumberOfEntries * sizeof(ULONG);
+
+		if (IndexFileHeader.NumberOfBlocks) {
+			Status = NtWriteFile(
+				IndexFileHandle,
+				NULL,
+				NULL,
+				NULL,
+				&IoStatusBlock,
+				Blocks,
+				IndexFileHeader.NumberOfBlocks * sizeof(VXLINDEXFILEBLOCK),
+				&ByteOffset,
+				NULL);
+
+			if (!NT_SUCCESS(Status)) {
+				leave;
+			}
+
+			ByteOffset += IndexFileHeader.NumberOfBlocks * sizeof(VXLINDEXFILEBLOCK);
+		}
+
+		if (NumberOfStrings) {
+			Status = NtWriteFile(
+				IndexFileHandle,
+				NULL,
+				NULL,
+				NULL,
+				&IoStatusBlock,
+				StringOffsets,
+				NumberOfStrings * sizeof(ULONG),
+				&ByteOffset,
+				NULL);
+
+			if (!NT_SUCCESS(Status)) {
+				leave;
+			}
+		}
+
+		ByteOffset = 0;
+
+		Status = NtWriteFile(
+			IndexFileHandle,
+			NULL,
+			NULL,
+			NULL,
+			&IoStatusBlock,
+			&IndexFileHeader,
+			sizeof(IndexFileHeader),
+			&ByteOffset,
+			NULL);
+	} finally {
+		SafeClose(IndexFileHandle);
+		SafeFree(Blocks);
+		SafeFree(StringOffsets);
+		RtlFreeUnicodeString(&IndexFileName);
+	}
+}
+
+//
+// Try to use an existing .vxli file. Returns an error if there isn't one, or
+// if it doesn't match the log file.
+//
+
+STATIC NTSTATUS VxlpReadIndexFile(
+	IN	VXLHANDLE			LogHandle)
+{
+	NTSTATUS Status;
+	PVXLINDEXCONTEXT IndexContext;
+	UNICODE_STRING IndexFileName;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	IO_STATUS_BLOCK IoStatusBlock;
+	HANDLE IndexFileHandle;
+	HANDLE SectionHandle;
+	PVOID View;
+	SIZE_T ViewSize;
+	PCVXLINDEXFILEHEADER IndexFileHeader;
+	PCVXLINDEXFILEBLOCK Blocks;
+	PULONG StringOffsets;
+	ULONGLONG RequiredSize;
+	ULONGLONG CommittedLength;
+	LONGLONG LastWriteTime;
+	ULONG NumberOfStrings;
+	ULONG SourceType;
+	ULONG Index;
+
+	IndexContext = LogHandle->IndexContext;
+	CommittedLength = IndexContext->CommittedLength;
+
+	Status = VxlpQueryLogLastWriteTime(LogHandle, &LastWriteTime);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	Status = VxlpGetIndexFileName(LogHandle, &IndexFileName);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	InitializeObjectAttributes(
+		&ObjectAttributes,
+		&IndexFileName,
+		OBJ_CASE_INSENSITIVE,
+		NULL,
+		NULL);
+
+	Status = NtOpenFile(
+		&IndexFileHandle,
+		GENERIC_READ | SYNCHRONIZE,
+		&ObjectAttributes,
+		&IoStatusBlock,
+		FILE_SHARE_READ | FILE_SHARE_DELETE,
+		FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE);
+
+	RtlFreeUnicodeString(&IndexFileName);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	//
+	// Map it copy-on-write, since the offsets of entries inside compressed
+	// blocks get filled in when the blocks are decompressed.
+	//
+
+	Status = NtCreateSection(
+		&SectionHandle,
+		SECTION_MAP_READ,
+		NULL,
+		NULL,
+		PAGE_WRITECOPY,
+		SEC_COMMIT,
+		IndexFileHandle);
+
+	SafeClose(IndexFileHandle);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	View = NULL;
+	ViewSize = 0;
+
+	Status = NtMapViewOfSection(
+		SectionHandle,
+		NtCurrentProcess(),
+		&View,
+		0,
+		0,
+		NULL,
+		&ViewSize,
+		ViewUnmap,
+		0,
+		PAGE_WRITECOPY);
+
+	SafeClose(SectionHandle);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	try {
+		IndexFileHeader = (PCVXLINDEXFILEHEADER) View;
+
+		if (ViewSize < sizeof(VXLINDEXFILEHEADER) ||
+			!RtlEqualMemory(IndexFileHeader->Magic, VXLI_MAGIC, sizeof(VXLI_MAGIC)) ||
+			IndexFileHeader->Version != VXLI_VERSION ||
+			IndexFileHeader->LogCommittedLength != CommittedLength ||
+			IndexFileHeader->LogLastWriteTime != LastWriteTime ||
+			IndexFileHeader->NumberOfEntries != IndexContext->NumberOfEntries) {
+
+			Status = STATUS_FILE_INVALID;
+			leave;
+		}
+
+		NumberOfStrings = 0;
+
+		ForEachArrayItem (IndexFileHeader->NumberOfStrings, SourceType) {
+			if (IndexFileHeader->NumberOfStrings[SourceType] > 0x10000) {
+				Status = STATUS_FILE_INVALID;
+				leave;
+			}
+
+			NumberOfStrings += IndexFileHeader->NumberOfStrings[SourceType];
+		}
+
+		RequiredSize = sizeof(VXLINDEXFILEHEADER);
+		RequiredSize += (ULONGLONG) IndexFileHeader->NumberOfEntries * sizeof(ULONG);
+		RequiredSize += (ULONGLONG) IndexFileHeader->NumberOfBlocks * sizeof(VXLINDEXFILEBLOCK);
+		RequiredSize += (ULONGLONG) NumberOfStrings * sizeof(ULONG);
+
+		if (ViewSize < RequiredSize) {
+			Status = STATUS_FILE_INVALID;
+			leave;
+		}
+
+		Blocks = (PCVXLINDEXFILEBLOCK) RVA_TO_VA(
+			View,
+			sizeof(VXLINDEXFILEHEADER) + IndexFileHeader->NumberOfEntries * sizeof(ULONG));
+
+		StringOffsets = (PULONG) (Blocks + IndexFileHeader->NumberOfBlocks);
+
+		//
+		// Load the blocks and the strings. These are checked against the log
+		// file, since they are used without any further checks afterwards.
+		// Entry offsets are checked when the entries are read.
+		//
+
+		for (Index = 0; Index < IndexFileHeader->NumberOfBlocks; ++Index) {
+			PCVXLLOGFILEBLOCK Block;
+
+			if (Blocks[Index].FileOffset < LogHandle->Header->HeaderSize ||
+				Blocks[Index].FileOffset + sizeof(VXLLOGFILEBLOCK) > CommittedLength) {
+
+				Status = STATUS_FILE_CORRUPT_ERROR;
+				leave;
+			}
+
+			Block = (PCVXLLOGFILEBLOCK) RVA_TO_VA(LogHandle->MappedFile, Blocks[Index].FileOffset);
+
+			if (Block->RecordType != VXL_RECORD_COMPRESSED_BLOCK ||
+				Blocks[Index].FileOffset + Block->RecordSize > CommittedLength ||
+				Block->RecordSize < sizeof(VXLLOGFILEBLOCK) + Block->DataCb ||
+				Block->DataCb > Block->UncompressedCb ||
+				Block->UncompressedCb > VXL_BLOCK_SIZE ||
+				Block->EntryCount != Blocks[Index].EntryCount ||
+				Blocks[Index].FirstEntryIndex > IndexFileHeader->NumberOfEntries ||
+				Blocks[Index].EntryCount > IndexFileHeader->NumberOfEntries - Blocks[Index].FirstEntryIndex ||
+				(Index != 0 && Blocks[Index].FirstEntryIndex < Blocks[Index - 1].FirstEntryIndex + Blocks[Index - 1].EntryCount)) {
+
+				Status = STATUS_FILE_CORRUPT_ERROR;
+				leave;
+			}
+
+			Status = VxlpAddBlockToIndex(
+				LogHandle,
+				Blocks[Index].FileOffset,
+				Blocks[Index].FirstEntryIndex,
+				Blocks[Index].EntryCount);
+
+			if (!NT_SUCCESS(Status)) {
+				leave;
+			}
+		}
+
+		ForEachArrayItem (IndexFileHeader->NumberOfStrings, SourceType) {
+			for (Index = 0; Index < IndexFileHeader->NumberOfStrings[SourceType]; ++Index) {
+				PCVXLLOGFILESTRING StringRecord;
+				ULONG StringOffset;
+
+				StringOffset = *StringOffsets++;
+
+				if (StringOffset < LogHandle->Header->HeaderSize ||
+					StringOffset + sizeof(VXLLOGFILESTRING) + sizeof(WCHAR) > CommittedLength) {
+
+					Status = STATUS_FILE_CORRUPT_ERROR;
+					leave;
+				}
+
+				StringRecord = (PCVXLLOGFILESTRING) RVA_TO_VA(LogHandle->MappedFile, StringOffset);
+
+				if (StringRecord->RecordType != VXL_RECORD_SOURCE_STRING ||
+					StringRecord->RecordSize < sizeof(VXLLOGFILESTRING) + sizeof(WCHAR) ||
+					StringOffset + StringRecord->RecordSize > CommittedLength ||
+					StringRecord->SourceType != SourceType ||
+					StringRecord->Index != Index ||
+					StringRecord->String[(StringRecord->RecordSize - sizeof(VXLLOGFILESTRING)) / sizeof(WCHAR) - 1] != '\0') {
+
+					Status = STATUS_FILE_CORRUPT_ERROR;
+					leave;
+				}
+
+				Status = VxlpAddSourceString(
+					LogHandle,
+					(VXLSOURCETYPE) SourceType,
+					Index,
+					StringRecord->String);
+
+				if (!NT_SUCCESS(Status)) {
+					leave;
+				}
+			}
+		}
+
+		LogHandle->EntryIndexToFileOffset = (PULONG) RVA_TO_VA(View, sizeof(VXLINDEXFILEHEADER));
+		IndexContext->IndexFileView = View;
+		IndexContext->NumberOfIndexedEntries = IndexFileHeader->NumberOfEntries;
+		IndexContext->NumberOfCommittedEntries = IndexFileHeader->NumberOfEntries;
+		IndexContext->NumberOfUncheckedEntries = IndexFileHeader->NumberOfEntries;
+		IndexContext->ScanOffset = CommittedLength;
+		IndexContext->Complete = TRUE;
+		Status = STATUS_SUCCESS;
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	if (!NT_SUCCESS(Status)) {
+		NtUnmapViewOfSection(NtCurrentProcess(), View);
+
+		//
+		// Undo whatever was loaded, so that the log can be indexed from the
+		// start instead.
+		//
+
+		VxlpFreeBlockIndex(LogHandle);
+		VxlpDestroySourceTables(LogHandle);
+		IndexContext->ScanStatus = VxlpCreateSourceTables(LogHandle);
+	}
+
+	return Status;
+}
+
+//
+// Index the log until at least MinimumNumberOfEntries entries are indexed,
+// the end of the log is reached, or there is an error.
+//
+
+STATIC NTSTATUS VxlpExtendIndex(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONG				MinimumNumberOfEntries)
+{
+	NTSTATUS Status;
+	PVXLINDEXCONTEXT IndexContext;
+
+	IndexContext = LogHandle->IndexContext;
+	MinimumNumberOfEntries = min(MinimumNumberOfEntries, IndexContext->NumberOfEntries);
+
+	RtlAcquireSRWLockExclusive(&LogHandle->Lock);
+
+	try {
+		while (IndexContext->NumberOfIndexedEntries < MinimumNumberOfEntries &&
+			   NT_SUCCESS(IndexContext->ScanStatus) &&
+			   !IndexContext->Complete) {
+
+			ULONG Index;
+			ULONG StopIndex;
+
+			Index = IndexContext->NumberOfIndexedEntries;
+			StopIndex = min(
+				(Index + VXL_INDEX_CHUNK_SIZE) & ~(VXL_INDEX_CHUNK_SIZE - 1),
+				IndexContext->NumberOfEntries);
+
+			Status = VxlpCommitIndex(LogHandle, StopIndex);
+
+			if (NT_SUCCESS(Status)) {
+				Status = VxlpIndexRecords(
+					LogHandle,
+					&IndexContext->ScanOffset,
+					&Index,
+					StopIndex,
+					IndexContext->NumberOfEntries,
+					IndexContext->CommittedLength);
+			}
+
+			//
+			// A compressed block may have taken the index past StopIndex.
+			// Its entries are filled in when it is decompressed.
+			//
+
+			if (NT_SUCCESS(Status)) {
+				Status = VxlpCommitIndex(LogHandle, Index);
+			}
+
+			if (!NT_SUCCESS(Status)) {
+				IndexContext->ScanStatus = Status;
+				break;
+			}
+
+			InterlockedExchange((PLONG) &IndexContext->NumberOfIndexedEntries, Index);
+
+			if (StopIndex == IndexContext->NumberOfEntries) {
+				// VxlpIndexRecords has gone through to the end of the file.
+
+				if (Index != IndexContext->NumberOfEntries) {
+					//
+					// The header claims more entries than there is data. If
+					// the log is being written to, the writer may just not
+					// have updated the committed length yet.
+					//
+
+					unless (LogHandle->Flags & VXL_OPEN_FOLLOW) {
+						IndexContext->ScanStatus = STATUS_FILE_CORRUPT_ERROR;
+						break;
+					}
+
+					InterlockedExchange((PLONG) &IndexContext->NumberOfEntries, Index);
+				}
+
+				IndexContext->Complete = TRUE;
+				VxlpWriteIndexFile(LogHandle);
+			}
+		}
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		IndexContext->ScanStatus = GetExceptionCode();
+	}
+
+	if (IndexContext->NumberOfIndexedEntries >= min(MinimumNumberOfEntries, IndexContext->NumberOfEntries)) {
+		Status = STATUS_SUCCESS;
+	} else if (!NT_SUCCESS(IndexContext->ScanStatus)) {
+		Status = IndexContext->ScanStatus;
+	} else {
+		Status = STATUS_NO_MORE_ENTRIES;
+	}
+
+	RtlReleaseSRWLockExclusive(&LogHandle->Lock);
+	return Status;
+}
+
+STATIC NTSTATUS NTAPI VxlpIndexerThreadProc(
+	IN	PVOID	Parameter)
+{
+	VXLHANDLE LogHandle;
+	PVXLINDEXCONTEXT IndexContext;
+
+	LogHandle = (VXLHANDLE) Parameter;
+	IndexContext = LogHandle->IndexContext;
+
+	until (IndexContext->ShutdownRequested || IndexContext->Complete) {
+		NTSTATUS Status;
+
+		// One chunk at a time, so that readers don't wait long for the lock.
+		Status = VxlpExtendIndex(LogHandle, IndexContext->NumberOfIndexedEntries + 1);
+
+		if (!NT_SUCCESS(Status)) {
+			break;
+		}
+	}
+
+	RtlExitUserThread(STATUS_SUCCESS);
+}
+
+//
+// Set up incremental indexing for a version 2 log file which is being
+// opened for reading. Returns once the first chunk of entries is indexed.
+//
+
+NTSTATUS VxlpCreateIndexContext(
+	IN	VXLHANDLE			LogHandle)
+{
+	NTSTATUS Status;
+	PVXLINDEXCONTEXT IndexContext;
+	PVOID RegionBase;
+	SIZE_T RegionSize;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->OpenMode == GENERIC_READ);
+	ASSERT (LogHandle->Header->Version >= 2);
+	ASSERT (LogHandle->IndexContext == NULL);
+	ASSERT (LogHandle->EntryIndexToFileOffset == NULL);
+
+	IndexContext = SafeAlloc(VXLINDEXCONTEXT, 1);
+	if (!IndexContext) {
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlZeroMemory(IndexContext, sizeof(*IndexContext));
+
+	//
+	// A writer updates the entry counts before the committed length, so
+	// reading them in the opposite order means that there are never more
+	// entries in the committed data than the counts say.
+	//
+
+	IndexContext->CommittedLength = LogHandle->Header->CommittedLength;
+	MemoryBarrier();
+	IndexContext->NumberOfEntries = VxlpGetTotalLogEntryCount(LogHandle);
+	IndexContext->NumberOfReservedEntries = IndexContext->NumberOfEntries;
+	IndexContext->ScanOffset = LogHandle->Header->HeaderSize;
+	IndexContext->ScanStatus = STATUS_SUCCESS;
+	LogHandle->IndexContext = IndexContext;
+
+	if (!IndexContext->NumberOfEntries) {
+		unless (LogHandle->Flags & VXL_OPEN_FOLLOW) {
+			return STATUS_NO_MORE_ENTRIES;
+		}
+
+		// Everything, including any source strings, is picked up by the
+		// first call to VxlWaitForNewEntries.
+		IndexContext->CommittedLength = LogHandle->Header->HeaderSize;
+		IndexContext->Complete = TRUE;
+		return STATUS_SUCCESS;
+	}
+
+	Status = VxlpReadIndexFile(LogHandle);
+	if (NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	if (!NT_SUCCESS(IndexContext->ScanStatus)) {
+		// couldn't recover from a bad .vxli file
+		return IndexContext->ScanStatus;
+	}
+
+	RegionBase = NULL;
+	RegionSize = IndexContext->NumberOfEntries * sizeof(ULONG);
+
+	Status = NtAllocateVirtualMemory(
+		NtCurrentProcess(),
+		&RegionBase,
+		0,
+		&RegionSize,
+		MEM_RESERVE,
+		PAGE_READWRITE);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	LogHandle->EntryIndexToFileOffset = (PULONG) RegionBase;
+
+	//
+	// Index the first chunk now, so that the start of the log can be shown
+	// straight away, and leave the rest to the indexer thread.
+	//
+
+	Status = VxlpExtendIndex(LogHandle, VXL_INDEX_CHUNK_SIZE);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	if (!IndexContext->Complete) {
+		Status = RtlCreateUserThread(
+			NtCurrentProcess(),
+			NULL,
+			FALSE,
+			0,
+			0,
+			0,
+			VxlpIndexerThreadProc,
+			LogHandle,
+			&IndexContext->IndexerThread,
+			NULL);
+
+		if (!NT_SUCCESS(Status)) {
+			// Entries are still indexed on demand.
+			IndexContext->IndexerThread = NULL;
+		}
+	}
+
+	return STATUS_SUCCESS;
+}
+
+VOID VxlpDestroyIndexContext(
+	IN	VXLHANDLE			LogHandle)
+{
+	PVXLINDEXCONTEXT IndexContext;
+
+	ASSERT (LogHandle != NULL);
+
+	IndexContext = LogHandle->IndexContext;
+
+	if (!IndexContext) {
+		return;
+	}
+
+	if (IndexContext->IndexerThread) {
+		// The thread stops after the chunk it is working on, so this
+		// doesn't take long.
+		IndexContext->ShutdownRequested = TRUE;
+		NtWaitForSingleObject(IndexContext->IndexerThread, FALSE, NULL);
+		SafeClose(IndexContext->IndexerThread);
+	}
+
+	VxlpFreeEntryOffsets(LogHandle);
+	LogHandle->EntryIndexToFileOffset = NULL;
+	SafeFree(LogHandle->IndexContext);
+}
+
+//
+// Make sure that the offset of an entry is known before it is looked up.
+// Does nothing if the log was not opened with VXL_OPEN_INCREMENTAL_INDEX.
+//
+
+NTSTATUS VxlpEnsureEntryIndexed(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONG				EntryIndex)
+{
+	PVXLINDEXCONTEXT IndexContext;
+
+	ASSERT (LogHandle != NULL);
+
+	IndexContext = LogHandle->IndexContext;
+
+	if (!IndexContext || EntryIndex < IndexContext->NumberOfIndexedEntries) {
+		return STATUS_SUCCESS;
+	}
+
+	return VxlpExtendIndex(LogHandle, EntryIndex + 1);
+}
+
+//
+// Finish indexing the entries which were in the log when it was opened.
+//
+
+NTSTATUS VxlpCompleteIndex(
+	IN	VXLHANDLE			LogHandle)
+{
+	NTSTATUS Status;
+	PVXLINDEXCONTEXT IndexContext;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->IndexContext != NULL);
+
+	IndexContext = LogHandle->IndexContext;
+
+	until (IndexContext->Complete) {
+		Status = VxlpExtendIndex(LogHandle, IndexContext->NumberOfIndexedEntries + VXL_INDEX_CHUNK_SIZE);
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+	}
+
+	return IndexContext->ScanStatus;
+}
+
+//
+// Make room for the offsets of at least NumberOfEntries entries. Must be
+// called with the lock held exclusive.
+//
+
+STATIC NTSTATUS VxlpGrowIndex(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONG				NumberOfEntries)
+{
+	NTSTATUS Status;
+	PVXLINDEXCONTEXT IndexContext;
+	PVOID RegionBase;
+	SIZE_T RegionSize;
+	ULONG NumberOfReservedEntries;
+
+	IndexContext = LogHandle->IndexContext;
+
+	//
+	// Grow geometrically, so that a log which gets a few entries at a time
+	// isn't copied every time.
+	//
+
+	NumberOfReservedEntries = max(NumberOfEntries, VXL_INDEX_CHUNK_SIZE);
+
+	if (IndexContext->NumberOfReservedEntries < MAXULONG / 2) {
+		NumberOfReservedEntries = max(NumberOfReservedEntries, IndexContext->NumberOfReservedEntries * 2);
+	}
+
+	RegionBase = NULL;
+	RegionSize = NumberOfReservedEntries * sizeof(ULONG);
+
+	Status = NtAllocateVirtualMemory(
+		NtCurrentProcess(),
+		&RegionBase,
+		0,
+		&RegionSize,
+		MEM_RESERVE,
+		PAGE_READWRITE);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	if (IndexContext->NumberOfCommittedEntries) {
+		RegionSize = IndexContext->NumberOfCommittedEntries * sizeof(ULONG);
+
+		Status = NtAllocateVirtualMemory(
+			NtCurrentProcess(),
+			&RegionBase,
+			0,
+			&RegionSize,
+			MEM_COMMIT,
+			PAGE_READWRITE);
+	}
+
+	if (!NT_SUCCESS(Status)) {
+		RegionSize = 0;
+		NtFreeVirtualMemory(NtCurrentProcess(), &RegionBase, &RegionSize, MEM_RELEASE);
+		return Status;
+	}
+
+	RtlCopyMemory(
+		RegionBase,
+		LogHandle->EntryIndexToFileOffset,
+		IndexContext->NumberOfCommittedEntries * sizeof(ULONG));
+
+	VxlpFreeEntryOffsets(LogHandle);
+	LogHandle->EntryIndexToFileOffset = (PULONG) RegionBase;
+	IndexContext->NumberOfReservedEntries = NumberOfReservedEntries;
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Index whatever has been added to the log since it was last looked at, up
+// to CommittedLength. MaximumNumberOfEntries is an upper bound on the number
+// of entries in the log. Must be called with the lock held exclusive, after
+// the entries which were in the log when it was opened have been indexed.
+//
+
+NTSTATUS VxlpIndexNewRecords(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONGLONG			CommittedLength,
+	IN	ULONG				MaximumNumberOfEntries)
+{
+	NTSTATUS Status;
+	PVXLINDEXCONTEXT IndexContext;
+	ULONG Index;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->IndexContext != NULL);
+	ASSERT (LogHandle->IndexContext->Complete);
+
+	IndexContext = LogHandle->IndexContext;
+
+	if (!NT_SUCCESS(IndexContext->ScanStatus)) {
+		return IndexContext->ScanStatus;
+	}
+
+	if (CommittedLength <= IndexContext->CommittedLength) {
+		return STATUS_SUCCESS;
+	}
+
+	MaximumNumberOfEntries = max(MaximumNumberOfEntries, IndexContext->NumberOfEntries);
+
+	//
+	// The .vxli file can't grow, so its offsets are copied out the first
+	// time new entries turn up.
+	//
+
+	if (MaximumNumberOfEntries > IndexContext->NumberOfReservedEntries || IndexContext->IndexFileView) {
+		Status = VxlpGrowIndex(LogHandle, MaximumNumberOfEntries);
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+	}
+
+	Status = VxlpCommitIndex(LogHandle, MaximumNumberOfEntries);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	Index = IndexContext->NumberOfEntries;
+
+	try {
+		Status = VxlpIndexRecords(
+			LogHandle,
+			&IndexContext->ScanOffset,
+			&Index,
+			IndexContext->NumberOfReservedEntries,
+			IndexContext->NumberOfReservedEntries,
+			CommittedLength);
+
+		// Entries inside a block may have gone past MaximumNumberOfEntries.
+		if (NT_SUCCESS(Status)) {
+			Status = VxlpCommitIndex(LogHandle, Index);
+		}
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	if (!NT_SUCCESS(Status)) {
+		// The scan can't be picked up again from the middle.
+		IndexContext->ScanStatus = Status;
+		return Status;
+	}
+
+	IndexContext->CommittedLength = CommittedLength;
+	InterlockedExchange((PLONG) &IndexContext->NumberOfIndexedEntries, Index);
+	InterlockedExchange((PLONG) &IndexContext->NumberOfEntries, Index);
+
+	return STATUS_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,403 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxlmap.c
+//
+// Abstract:
+//
+//     Memory-mapped append mode for log files.
+//
+//     The log file is grown in large chunks and the end of it is kept mapped
+//     into memory. A writer reserves space for its entries by atomically
+//     advancing ReservedLength, copies them directly into the mapped view,
+//     and then waits for all writers that reserved space before it to finish
+//     before advancing CommittedLength past its own entries.
+//
+//     Readers use the CommittedLength field in the log file header to find
+//     out how much of the file actually contains valid data.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Give up on writers that never commit.
+//     agent                18-Oct-2026  Sleep while waiting, report giving up.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+
+#define ALIGN_DOWN_BY(Value, Alignment) ((Value) & ~((ULONGLONG) (Alignment) - 1))
+#define ALIGN_UP_BY(Value, Alignment) ALIGN_DOWN_BY((Value) + (Alignment) - 1, (Alignment))
+
+//
+// The 64-bit interlocked functions other than compare-exchange are not
+// available as intrinsics on x86.
+//
+
+STATIC INLINE LONGLONG VxlpInterlockedRead64(
+	IN	LONGLONG VOLATILE	*Target)
+{
+	return InterlockedCompareExchange64(Target, 0, 0);
+}
+
+STATIC INLINE LONGLONG VxlpInterlockedExchangeAdd64(
+	IN OUT	LONGLONG VOLATILE	*Addend,
+	IN		LONGLONG			Value)
+{
+	LONGLONG OldValue;
+
+	do {
+		OldValue = *Addend;
+	} until (InterlockedCompareExchange64(Addend, OldValue + Value, OldValue) == OldValue);
+
+	return OldValue;
+}
+
+//
+// Make sure the window covers file offsets [Offset, End), growing the file
+// if necessary. Must be called with the window lock held exclusive.
+//
+
+STATIC NTSTATUS VxlpMapWindow(
+	IN	PVXLMAPCONTEXT	MapContext,
+	IN	ULONGLONG		Offset,
+	IN	ULONGLONG		End)
+{
+	NTSTATUS Status;
+	ULONGLONG NewWindowOffset;
+	ULONGLONG NewWindowEnd;
+	LONGLONG SectionOffset;
+	SIZE_T ViewSize;
+	PVOID NewWindow;
+
+	ASSERT (MapContext != NULL);
+	ASSERT (End > Offset);
+
+	if (MapContext->Window && Offset >= MapContext->WindowOffset && End <= MapContext->WindowEnd) {
+		// Another writer already did it for us.
+		return STATUS_SUCCESS;
+	}
+
+	//
+	// Everything from the committed length onwards is either still being
+	// copied by some other writer, or hasn't been reserved yet. Start the
+	// new window there, so that the other writers don't have to remap it
+	// again immediately.
+	//
+
+	NewWindowOffset = VxlpInterlockedRead64(&MapContext->CommittedLength);
+	NewWindowOffset = min(NewWindowOffset, Offset);
+	NewWindowOffset = ALIGN_DOWN_BY(NewWindowOffset, VXL_MAP_VIEW_ALIGNMENT);
+
+	NewWindowEnd = max(MapContext->WindowEnd, ALIGN_UP_BY(End, VXL_MAP_GROWTH_INCREMENT));
+
+	if (NewWindowEnd > MAXULONG) {
+		// The read index uses 32 bit file offsets.
+		return STATUS_DISK_FULL;
+	}
+
+	if (NewWindowEnd > MapContext->WindowEnd) {
+		LONGLONG NewSectionSize;
+
+		// Extending a section that is backed by a data file also extends
+		// the file itself.
+		NewSectionSize = NewWindowEnd;
+		Status = NtExtendSection(MapContext->SectionHandle, &NewSectionSize);
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+	}
+
+	if (MapContext->Window) {
+		NtUnmapViewOfSection(NtCurrentProcess(), MapContext->Window);
+		MapContext->Window = NULL;
+	}
+
+	NewWindow = NULL;
+	SectionOffset = NewWindowOffset;
+	ViewSize = (SIZE_T) (NewWindowEnd - NewWindowOffset);
+
+	Status = NtMapViewOfSection(
+		MapContext->SectionHandle,
+		NtCurrentProcess(),
+		&NewWindow,
+		0,
+		0,
+		&SectionOffset,
+		&ViewSize,
+		ViewUnmap,
+		0,
+		PAGE_READWRITE);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	MapContext->Window = (PBYTE) NewWindow;
+	MapContext->WindowOffset = NewWindowOffset;
+	MapContext->WindowEnd = NewWindowEnd;
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Stop committing anything to the log. Called when a writer has reserved
+// space which will never be filled in. Everything written after this is
+// lost, so say so on the debugger console, and leave the log marked as
+// dirty when it is closed so that readers know it is incomplete.
+//
+
+STATIC VOID VxlpGiveUpMappedWrites(
+	IN	PVXLMAPCONTEXT	MapContext,
+	IN	NTSTATUS		Status)
+{
+	if (InterlockedExchange(&MapContext->Failed, TRUE) == FALSE) {
+		DbgPrint(
+			"VXL: giving up on the mapped log (status 0x%08lx), "
+			"later log entries will be lost\r\n",
+			Status);
+	}
+}
+
+NTSTATUS VxlpMappedAppendLogFileEntries(
+	IN	VXLHANDLE	LogHandle,
+	IN	PCVOID		Buffer,
+	IN	ULONG		BufferCb,
+	IN	PCULONG		SeverityCounts)
+{
+	NTSTATUS Status;
+	PVXLMAPCONTEXT MapContext;
+	ULONGLONG Offset;
+	ULONGLONG End;
+	ULONG SpinCount;
+	ULONG Index;
+	LONGLONG CommittedLength;
+	LONGLONG LastCommittedLength;
+	LONGLONG CurrentTime;
+	LONGLONG Deadline;
+	LONGLONG BackoffInterval;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->MapContext != NULL);
+	ASSERT (Buffer != NULL);
+	ASSERT (BufferCb != 0);
+	ASSERT (SeverityCounts != NULL);
+
+	MapContext = LogHandle->MapContext;
+
+	if (MapContext->Failed) {
+		return STATUS_UNSUCCESSFUL;
+	}
+
+	//
+	// Reserve space for the entries.
+	//
+
+	Offset = VxlpInterlockedExchangeAdd64(&MapContext->ReservedLength, BufferCb);
+	End = Offset + BufferCb;
+
+	//
+	// Copy the entries into the window, moving it first if necessary.
+	//
+
+	Status = STATUS_SUCCESS;
+	RtlAcquireSRWLockShared(&MapContext->WindowLock);
+
+	while (!MapContext->Window || Offset < MapContext->WindowOffset || End > MapContext->WindowEnd) {
+		RtlReleaseSRWLockShared(&MapContext->WindowLock);
+		RtlAcquireSRWLockExclusive(&MapContext->WindowLock);
+		Status = VxlpMapWindow(MapContext, Offset, End);
+		RtlReleaseSRWLockExclusive(&MapContext->WindowLock);
+
+		if (!NT_SUCCESS(Status)) {
+			break;
+		}
+
+		RtlAcquireSRWLockShared(&MapContext->WindowLock);
+	}
+
+	if (NT_SUCCESS(Status)) {
+		try {
+			RtlCopyMemory(
+				MapContext->Window + (Offset - MapContext->WindowOffset),
+				Buffer,
+				BufferCb);
+		} except (EXCEPTION_EXECUTE_HANDLER) {
+			// e.g. STATUS_IN_PAGE_ERROR if the disk is full
+			Status = GetExceptionCode();
+		}
+
+		RtlReleaseSRWLockShared(&MapContext->WindowLock);
+	}
+
+	if (!NT_SUCCESS(Status)) {
+		//
+		// We've reserved space that will now never be filled in, so nothing
+		// after it can be committed either. Tell anyone waiting behind us
+		// to give up.
+		//
+
+		VxlpGiveUpMappedWrites(MapContext, Status);
+		return Status;
+	}
+
+	//
+	// Wait for the writers in front of us to commit their entries. They are
+	// only copying memory, so this normally takes no time at all.
+	//
+	// A writer that fails returns normally and sets Failed, but a thread can
+	// also be terminated (e.g. by TerminateThread, or by another thread that
+	// calls ExitProcess) between reserving its space and committing it. The
+	// gap it leaves behind can never be committed, so if nobody in front of
+	// us makes any progress for VXL_MAP_COMMIT_TIMEOUT, treat it the same as
+	// a failed writer instead of spinning forever.
+	//
+	// NtYieldExecution only gives the processor to threads of the same or
+	// higher priority, so if the writer in front of us has a lower priority
+	// and was preempted before it committed, yielding doesn't let it run.
+	// After a short while, sleep instead.
+	//
+
+	SpinCount = 0;
+	BackoffInterval = -(VXL_MAP_BACKOFF_INTERVAL * 10000LL);
+	Deadline = 0;
+	LastCommittedLength = -1;
+
+	until ((CommittedLength = VxlpInterlockedRead64(&MapContext->CommittedLength)) == (LONGLONG) Offset) {
+		if (MapContext->Failed) {
+			return STATUS_UNSUCCESSFUL;
+		}
+
+		if (++SpinCount < 64) {
+			YieldProcessor();
+			continue;
+		}
+
+		if (CommittedLength != LastCommittedLength) {
+			LastCommittedLength = CommittedLength;
+			NtQuerySystemTime(&Deadline);
+			Deadline += VXL_MAP_COMMIT_TIMEOUT * 10000LL;
+		} else {
+			NtQuerySystemTime(&CurrentTime);
+
+			if (CurrentTime > Deadline) {
+				VxlpGiveUpMappedWrites(MapContext, STATUS_IO_TIMEOUT);
+				return STATUS_IO_TIMEOUT;
+			}
+		}
+
+		if (SpinCount < 80) {
+			NtYieldExecution();
+		} else {
+			NtDelayExecution(FALSE, &BackoffInterval);
+		}
+	}
+
+	//
+	// Now it is our turn. Update the header, and then let the next writer go.
+	//
+
+	try {
+		ForEachArrayItem (LogHandle->Header->EventSeverityTypeCount, Index) {
+			LogHandle->Header->EventSeverityTypeCount[Index] += SeverityCounts[Index];
+		}
+
+		LogHandle->Header->CommittedLength = End;
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	InterlockedCompareExchange64(&MapContext->CommittedLength, End, Offset);
+	return Status;
+}
+
+NTSTATUS VxlpCreateMapContext(
+	IN	VXLHANDLE	LogHandle)
+{
+	NTSTATUS Status;
+	PVXLMAPCONTEXT MapContext;
+	LONGLONG SectionSize;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->OpenMode == GENERIC_WRITE);
+	ASSERT (LogHandle->MapContext == NULL);
+
+	MapContext = SafeAlloc(VXLMAPCONTEXT, 1);
+	if (!MapContext) {
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlZeroMemory(MapContext, sizeof(*MapContext));
+	RtlInitializeSRWLock(&MapContext->WindowLock);
+
+	MapContext->ReservedLength = LogHandle->Header->CommittedLength;
+	MapContext->CommittedLength = LogHandle->Header->CommittedLength;
+
+	//
+	// Create a section at least one growth increment larger than the data
+	// that is already in the file. This extends the file.
+	//
+
+	SectionSize = ALIGN_UP_BY(MapContext->CommittedLength + 1, VXL_MAP_GROWTH_INCREMENT);
+
+	Status = NtCreateSection(
+		&MapContext->SectionHandle,
+		SECTION_MAP_READ | SECTION_MAP_WRITE | SECTION_EXTEND_SIZE,
+		NULL,
+		&SectionSize,
+		PAGE_READWRITE,
+		SEC_COMMIT,
+		LogHandle->FileHandle);
+
+	if (!NT_SUCCESS(Status)) {
+		SafeFree(MapContext);
+		return Status;
+	}
+
+	MapContext->WindowEnd = SectionSize;
+
+	Status = VxlpMapWindow(MapContext, MapContext->CommittedLength, SectionSize);
+	if (!NT_SUCCESS(Status)) {
+		SafeClose(MapContext->SectionHandle);
+		SafeFree(MapContext);
+		return Status;
+	}
+
+	LogHandle->MapContext = MapContext;
+	return STATUS_SUCCESS;
+}
+
+//
+// Unmap the window and release the section. The caller is responsible for
+// trimming the unused space off the end of the file afterwards (the file
+// cannot be truncated while any view of it is mapped).
+//
+
+VOID VxlpDestroyMapContext(
+	IN	VXLHANDLE	LogHandle)
+{
+	PVXLMAPCONTEXT MapContext;
+
+	ASSERT (LogHandle != NULL);
+
+	MapContext = LogHandle->MapContext;
+
+	if (!MapContext) {
+		return;
+	}
+
+	if (MapContext->Window) {
+		NtUnmapViewOfSection(NtCurrentProcess(), MapContext->Window);
+	}
+
+	SafeClose(MapContext->SectionHandle);
+	SafeFree(MapContext);
+	LogHandle->MapContext = NULL;
+}
\ No newline at end of file
@@ -0,0 +1,300 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxlmerge.c
+//
+// Abstract:
+//
+//     Merging several logs into one stream of entries in time order.
+//
+//     When a program starts child processes, each of them usually writes
+//     its own log, so one thing the user did ends up spread over many files.
+//     A merge stream goes through all of them at once and hands out
+//     (log, entry) pairs, oldest first.
+//
+//     The entries within each log are already in time order (they are
+//     appended as they are written), so this is a k-way merge and not a
+//     sort: a min-heap holds the next entry of every log which has any left.
+//     Only a small window of timestamps is looked up from each log at a
+//     time, so memory use doesn't depend on the size of the logs beyond the
+//     index which every reader already has.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+
+//
+// Look up the timestamps of the next few entries of a log. Returns FALSE if
+// there are none left.
+//
+
+STATIC BOOLEAN VxlpFillMergeWindow(
+	IN OUT	PVXLMERGECURSOR	Cursor)
+{
+	PVOID FileEntries[VXL_MERGE_WINDOW_SIZE];
+	ULONG Index;
+
+	Cursor->WindowEntryIndex += Cursor->WindowCount;
+	Cursor->WindowCount = 0;
+	Cursor->WindowPosition = 0;
+
+	if (Cursor->WindowEntryIndex >= Cursor->NumberOfEntries) {
+		return FALSE;
+	}
+
+	Cursor->WindowCount = min(Cursor->NumberOfEntries - Cursor->WindowEntryIndex, VXL_MERGE_WINDOW_SIZE);
+
+	VxlpGetLogFileEntries(
+		Cursor->LogHandle,
+		Cursor->WindowEntryIndex,
+		Cursor->WindowCount,
+		FileEntries);
+
+	for (Index = 0; Index < Cursor->WindowCount; ++Index) {
+		if (FileEntries[Index]) {
+			if (Cursor->LogHandle->Header->Version == 1) {
+				Cursor->LastTime = ((PVXLLOGFILEENTRY_V1) FileEntries[Index])->Time64;
+			} else {
+				// deferred entries have the time in the same place
+				Cursor->LastTime = ((PVXLLOGFILEENTRY) FileEntries[Index])->Time64;
+			}
+		}
+
+		// An entry which can't be read still goes into the stream, so that
+		// the number of entries adds up. Readers will find that it's bad.
+		Cursor->Times[Index] = Cursor->LastTime;
+	}
+
+	return TRUE;
+}
+
+//
+// Whether the next entry of the first log comes before the next entry of
+// the second. Ties go to the log which was specified first.
+//
+
+STATIC BOOLEAN VxlpMergeCursorPrecedes(
+	IN	PCVXLMERGECONTEXT	Context,
+	IN	ULONG				FirstLogIndex,
+	IN	ULONG				SecondLogIndex)
+{
+	PCVXLMERGECURSOR First;
+	PCVXLMERGECURSOR Second;
+	LONGLONG FirstTime;
+	LONGLONG SecondTime;
+
+	First = &Context->Cursors[FirstLogIndex];
+	Second = &Context->Cursors[SecondLogIndex];
+	FirstTime = First->Times[First->WindowPosition];
+	SecondTime = Second->Times[Second->WindowPosition];
+
+	if (FirstTime != SecondTime) {
+		return (FirstTime < SecondTime);
+	}
+
+	return (FirstLogIndex < SecondLogIndex);
+}
+
+STATIC VOID VxlpSiftDownMergeHeap(
+	IN OUT	PVXLMERGECONTEXT	Context,
+	IN		ULONG				Position)
+{
+	PULONG Heap;
+	ULONG LogIndex;
+
+	Heap = Context->Heap;
+	LogIndex = Heap[Position];
+
+	while (TRUE) {
+		ULONG Child;
+
+		Child = Position * 2 + 1;
+
+		if (Child >= Context->HeapSize) {
+			break;
+		}
+
+		if (Child + 1 < Context->HeapSize &&
+			VxlpMergeCursorPrecedes(Context, Heap[Child + 1], Heap[Child])) {
+
+			++Child;
+		}
+
+		unless (VxlpMergeCursorPrecedes(Context, Heap[Child], LogIndex)) {
+			break;
+		}
+
+		Heap[Position] = Heap[Child];
+		Position = Child;
+	}
+
+	Heap[Position] = LogIndex;
+}
+
+//
+// Create a stream which returns the entries of all of the specified logs
+// in time order. The logs must have been opened for reading and must stay
+// open until the stream is closed. Entries which are added to the logs
+// after the stream was created are not part of it.
+//
+// NumberOfEntries, if specified, receives the total number of entries
+// which the stream will return.
+//
+// A merge stream must not be used by more than one thread at a time.
+//
+
+KEXAPI NTSTATUS NTAPI VxlCreateMergeStream(
+	OUT	PVXLMERGEHANDLE	MergeHandle,
+	IN	ULONG			NumberOfLogs,
+	IN	PVXLHANDLE		LogHandles,
+	OUT	PULONG			NumberOfEntries OPTIONAL)
+{
+	PVXLMERGECONTEXT Context;
+	ULONG TotalNumberOfEntries;
+	ULONG Index;
+
+	if (!MergeHandle || NumberOfLogs == 0 || !LogHandles) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	*MergeHandle = NULL;
+
+	if (NumberOfLogs > (MAXULONG - FIELD_OFFSET(VXLMERGECONTEXT, Cursors)) /
+					   (sizeof(VXLMERGECURSOR) + sizeof(ULONG))) {
+
+		return STATUS_INVALID_PARAMETER_2;
+	}
+
+	for (Index = 0; Index < NumberOfLogs; ++Index) {
+		if (!LogHandles[Index]) {
+			return STATUS_INVALID_PARAMETER_3;
+		}
+
+		if (LogHandles[Index]->OpenMode != GENERIC_READ) {
+			return STATUS_INVALID_OPEN_MODE;
+		}
+	}
+
+	Context = (PVXLMERGECONTEXT) SafeAlloc(BYTE,
+		FIELD_OFFSET(VXLMERGECONTEXT, Cursors) +
+		NumberOfLogs * sizeof(VXLMERGECURSOR) +
+		NumberOfLogs * sizeof(ULONG));
+
+	if (!Context) {
+		return STATUS_NO_MEMORY;
+	}
+
+	Context->NumberOfLogs = NumberOfLogs;
+	Context->HeapSize = 0;
+	Context->Heap = (PULONG) &Context->Cursors[NumberOfLogs];
+	TotalNumberOfEntries = 0;
+
+	for (Index = 0; Index < NumberOfLogs; ++Index) {
+		PVXLMERGECURSOR Cursor;
+
+		Cursor = &Context->Cursors[Index];
+		Cursor->LogHandle = LogHandles[Index];
+		Cursor->NumberOfEntries = VxlpGetTotalLogEntryCount(Cursor->LogHandle);
+		Cursor->WindowEntryIndex = 0;
+		Cursor->WindowCount = 0;
+		Cursor->WindowPosition = 0;
+		Cursor->LastTime = 0;
+
+		if (TotalNumberOfEntries + Cursor->NumberOfEntries < TotalNumberOfEntries) {
+			// Too many entries to count with a ULONG. The rest of the logs
+			// would never be reached anyway.
+			SafeFree(Context);
+			return STATUS_INTEGER_OVERFLOW;
+		}
+
+		TotalNumberOfEntries += Cursor->NumberOfEntries;
+
+		if (VxlpFillMergeWindow(Cursor)) {
+			Context->Heap[Context->HeapSize++] = Index;
+		}
+	}
+
+	// turn the heap array into a heap
+	for (Index = Context->HeapSize / 2; Index-- > 0;) {
+		VxlpSiftDownMergeHeap(Context, Index);
+	}
+
+	if (NumberOfEntries) {
+		*NumberOfEntries = TotalNumberOfEntries;
+	}
+
+	*MergeHandle = Context;
+	return STATUS_SUCCESS;
+}
+
+//
+// Get the next entries of a merge stream. Returns STATUS_NO_MORE_ENTRIES
+// once all of them have been returned.
+//
+
+KEXAPI NTSTATUS NTAPI VxlReadMergeStream(
+	IN	VXLMERGEHANDLE	MergeHandle,
+	IN	ULONG			MaximumNumberOfEntries,
+	OUT	PVXLMERGEDENTRY	Entries,
+	OUT	PULONG			NumberOfEntriesRead)
+{
+	PVXLMERGECONTEXT Context;
+	ULONG Count;
+
+	if (NumberOfEntriesRead) {
+		*NumberOfEntriesRead = 0;
+	}
+
+	if (!MergeHandle || !Entries || !NumberOfEntriesRead) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	Context = MergeHandle;
+
+	if (Context->HeapSize == 0) {
+		return STATUS_NO_MORE_ENTRIES;
+	}
+
+	for (Count = 0; Count < MaximumNumberOfEntries && Context->HeapSize != 0; ++Count) {
+		PVXLMERGECURSOR Cursor;
+		ULONG LogIndex;
+
+		LogIndex = Context->Heap[0];
+		Cursor = &Context->Cursors[LogIndex];
+
+		Entries[Count].LogIndex = LogIndex;
+		Entries[Count].EntryIndex = Cursor->WindowEntryIndex + Cursor->WindowPosition;
+
+		if (++Cursor->WindowPosition == Cursor->WindowCount) {
+			unless (VxlpFillMergeWindow(Cursor)) {
+				// this log is finished
+				Context->Heap[0] = Context->Heap[--Context->HeapSize];
+			}
+		}
+
+		if (Context->HeapSize != 0) {
+			VxlpSiftDownMergeHeap(Context, 0);
+		}
+	}
+
+	*NumberOfEntriesRead = Count;
+	return STATUS_SUCCESS;
+}
+
+KEXAPI VOID NTAPI VxlCloseMergeStream(
+	IN OUT	PVXLMERGEHANDLE	MergeHandle)
+{
+	if (MergeHandle && *MergeHandle) {
+		SafeFree(*MergeHandle);
+	}
+}
\ No newline at end of file
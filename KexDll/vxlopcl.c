@@ -18,6 +18,17 @@
 //     vxiiduu              15-Oct-2022  Convert to v2 format.
 //     vxiiduu              12-Nov-2022  Convert to v3 + native API
 //     vxiiduu              08-Jan-2023  Set compressed attribute on vxl files
+//     agent                17-Oct-2026  Add VxlOpenLogEx and asynchronous mode
+//     agent                17-Oct-2026  Convert to v2 format, add mapped mode
+//     agent                17-Oct-2026  Load and free the source string tables
+//     agent                17-Oct-2026  Add deferred formatting mode
+//     agent                17-Oct-2026  Add compressed mode
+//     agent                17-Oct-2026  Add session logs
+//     agent                17-Oct-2026  Add incremental indexing
+//     agent                17-Oct-2026  Add follow mode
+//     agent                17-Oct-2026  Add text index
+//     agent                18-Oct-2026  Keep logs dirty if mapped writes failed
+//     agent                18-Oct-2026  Session logs are clean when the owner closes
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -26,6 +37,316 @@
 
 STATIC CONST CHAR VXLL_MAGIC[] = {'V','X','L','L'};
 
+//
+// Load the source names that are already defined in an existing log file
+// which is being opened for writing.
+//
+
+STATIC NTSTATUS VxlpLoadExistingSourceStrings(
+	IN	PVXLCONTEXT	Context,
+	IN	HANDLE		SectionHandle)
+{
+	NTSTATUS Status;
+	PVOID ExistingData;
+	SIZE_T ViewSize;
+
+	ExistingData = NULL;
+	ViewSize = (SIZE_T) Context->Header->CommittedLength;
+
+	Status = NtMapViewOfSection(
+		SectionHandle,
+		NtCurrentProcess(),
+		&ExistingData,
+		0,
+		0,
+		NULL,
+		&ViewSize,
+		ViewUnmap,
+		0,
+		PAGE_READONLY);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	try {
+		Status = VxlpLoadSourceStrings(
+			Context,
+			ExistingData,
+			0,
+			Context->Header->HeaderSize,
+			Context->Header->CommittedLength);
+	} finally {
+		NtUnmapViewOfSection(NtCurrentProcess(), ExistingData);
+	}
+
+	return Status;
+}
+
+//
+// Everything that needs to be done to open a log file, once the file
+// itself has been opened and Context->FileHandle, OpenMode and Flags have
+// been filled out.
+//
+
+STATIC NTSTATUS VxlpInitializeLogContext(
+	IN	PVXLCONTEXT			Context,
+	IN	PUNICODE_STRING		SourceApplication OPTIONAL,
+	IN	BOOLEAN				NewLogFileCreated)
+{
+	NTSTATUS Status;
+	HANDLE SectionHandle;
+	SIZE_T ViewSize;
+	ULONG SectionDesiredAccess;
+	ULONG SectionPageProtection;
+
+	SectionHandle = NULL;
+
+	try {
+		//
+		// Create a section backed by the entire log file.
+		// If we are opening for read only, map the entire log file into
+		// memory. If we are opening read-write, only map the header.
+		//
+
+		if (Context->OpenMode == GENERIC_READ) {
+			SectionDesiredAccess = SECTION_MAP_READ;
+			SectionPageProtection = PAGE_READONLY;
+		} else {
+			SectionDesiredAccess = SECTION_MAP_READ | SECTION_MAP_WRITE;
+			SectionPageProtection = PAGE_READWRITE;
+		}
+
+		Status = NtCreateSection(
+			&SectionHandle,
+			SectionDesiredAccess,
+			NULL,
+			NULL,
+			SectionPageProtection,
+			SEC_COMMIT,
+			Context->FileHandle);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		if (Context->OpenMode == GENERIC_READ) {
+			// map entire
+			ViewSize = 0;
+		} else {
+			// only map header
+			ViewSize = sizeof(VXLLOGFILEHEADER);
+		}
+
+		Status = NtMapViewOfSection(
+			SectionHandle,
+			NtCurrentProcess(),
+			&Context->MappedSection,
+			0,
+			0,
+			NULL,
+			&ViewSize,
+			ViewUnmap,
+			0,
+			Context->OpenMode == GENERIC_READ ? PAGE_READONLY : PAGE_READWRITE);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		//
+		// If we are creating a new log file, we must create a new
+		// log file header. Otherwise, we will validate the existing header.
+		//
+
+		if (NewLogFileCreated) {
+			UNICODE_STRING DestinationSourceApplication;
+
+			//
+			// New empty log file has been created.
+			// Populate it with a header.
+			//
+
+			if (!SourceApplication) {
+				Status = STATUS_INVALID_PARAMETER;
+				leave;
+			}
+
+			RtlZeroMemory(Context->Header, sizeof(*Context->Header));
+
+			RtlInitEmptyUnicodeString(
+				&DestinationSourceApplication,
+				Context->Header->SourceApplication,
+				sizeof(Context->Header->SourceApplication) - sizeof(WCHAR));
+
+			RtlCopyUnicodeString(&DestinationSourceApplication, SourceApplication);
+
+			Context->Header->Version = VXLL_VERSION;
+			Context->Header->HeaderSize = sizeof(VXLLOGFILEHEADER);
+			Context->Header->CommittedLength = sizeof(VXLLOGFILEHEADER);
+			RtlCopyMemory(Context->Header->Magic, VXLL_MAGIC, sizeof(VXLL_MAGIC));
+		} else {
+			//
+			// Opening existing log file. Validate the header.
+			//
+
+			if (!RtlEqualMemory(Context->Header->Magic, VXLL_MAGIC, sizeof(VXLL_MAGIC))) {
+				Status = STATUS_FILE_INVALID;
+				leave;
+			}
+
+			//
+			// Old versions can be read, but we will only append to a log
+			// file of the current version.
+			//
+
+			if (Context->Header->Version == 0 || Context->Header->Version > VXLL_VERSION) {
+				Status = STATUS_VERSION_MISMATCH;
+				leave;
+			}
+
+			if (Context->OpenMode == GENERIC_WRITE && Context->Header->Version != VXLL_VERSION) {
+				Status = STATUS_VERSION_MISMATCH;
+				leave;
+			}
+
+			if (Context->Header->Version == 1) {
+				if (ViewSize < VXLL_V1_HEADER_SIZE) {
+					Status = STATUS_FILE_INVALID;
+					leave;
+				}
+			} else {
+				if (Context->Header->HeaderSize < sizeof(VXLLOGFILEHEADER) ||
+					Context->Header->CommittedLength < Context->Header->HeaderSize) {
+
+					Status = STATUS_FILE_INVALID;
+					leave;
+				}
+
+				if (Context->OpenMode == GENERIC_READ && Context->Header->CommittedLength > ViewSize) {
+					// file was truncated
+					Status = STATUS_FILE_CORRUPT_ERROR;
+					leave;
+				}
+			}
+
+			if (Context->OpenMode == GENERIC_WRITE) {
+				//
+				// If source application parameter was specified, make sure
+				// that it is the same as what is in the log file.
+				//
+
+				if (SourceApplication) {
+					UNICODE_STRING SourceApplicationFromFile;
+
+					RtlInitUnicodeString(
+						&SourceApplicationFromFile,
+						Context->Header->SourceApplication);
+
+					if (!RtlEqualUnicodeString(SourceApplication, &SourceApplicationFromFile, TRUE)) {
+						Status = STATUS_SOURCE_APPLICATION_MISMATCH;
+						leave;
+					}
+				}
+
+				//
+				// Load the source names that are already defined in the
+				// file, so that new entries can refer to them. In a session
+				// log, other processes may be adding to them at any time, so
+				// they are loaded on demand instead (see vxlsess.c).
+				//
+
+				unless (Context->SessionContext) {
+					Status = VxlpLoadExistingSourceStrings(Context, SectionHandle);
+					if (!NT_SUCCESS(Status)) {
+						leave;
+					}
+				}
+			} else {
+				//
+				// Opened for reading - build the index, or start building
+				// it in the background. Following a log needs an index
+				// which can keep growing, so it implies incremental indexing.
+				//
+
+				// Version 1 logs have no committed length to follow.
+				if ((Context->Flags & VXL_OPEN_FOLLOW) && Context->Header->Version >= 2) {
+					Status = VxlpCreateFollowContext(Context, ViewSize);
+					if (!NT_SUCCESS(Status)) {
+						leave;
+					}
+				}
+
+				if ((Context->Flags & VXL_OPEN_READ_FLAGS) && Context->Header->Version >= 2) {
+					Status = VxlpCreateIndexContext(Context);
+				} else {
+					Status = VxlpBuildIndex(Context);
+				}
+
+				if (!NT_SUCCESS(Status)) {
+					leave;
+				}
+
+				if ((Context->Flags & VXL_OPEN_TEXT_INDEX) && Context->Header->Version >= 2) {
+					Status = VxlpCreateTextIndexContext(Context);
+					if (!NT_SUCCESS(Status)) {
+						leave;
+					}
+				}
+			}
+		}
+
+		//
+		// If opening the file for write access, mark the header as dirty.
+		//
+
+		if (Context->OpenMode == GENERIC_WRITE) {
+			Context->Header->Dirty = TRUE;
+			VxlpFlushLogFileHeader(Context);
+		}
+
+		//
+		// Map the end of the file for mapped mode.
+		//
+
+		if (Context->Flags & VXL_OPEN_MAPPED_WRITE) {
+			Status = VxlpCreateMapContext(Context);
+			if (!NT_SUCCESS(Status)) {
+				leave;
+			}
+		}
+
+		//
+		// Set up the block buffer for compressed mode. This must be done
+		// before asynchronous mode is set up, since the flusher thread writes
+		// into the block.
+		//
+
+		if (Context->Flags & VXL_OPEN_COMPRESSED) {
+			Status = VxlpCreateBlockContext(Context);
+			if (!NT_SUCCESS(Status)) {
+				leave;
+			}
+		}
+
+		//
+		// Start the flusher thread for asynchronous mode.
+		//
+
+		if (Context->Flags & VXL_OPEN_ASYNCHRONOUS_WRITE) {
+			Status = VxlpCreateAsyncContext(Context);
+			if (!NT_SUCCESS(Status)) {
+				leave;
+			}
+		}
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	SafeClose(SectionHandle);
+	return Status;
+}
+
 //
 // Open a log file.
 //
@@ -56,23 +377,28 @@ STATIC CONST CHAR VXLL_MAGIC[] = {'V','X','L','L'};
 //   See the documentation for NtCreateFile to understand what these
 //   values mean.
 //
-NTSTATUS NTAPI VxlOpenLog(
+// Flags
+//   Zero or more VXL_OPEN_* flags. VXL_OPEN_ASYNCHRONOUS_WRITE,
+//   VXL_OPEN_MAPPED_WRITE, VXL_OPEN_DEFERRED_FORMATTING,
+//   VXL_OPEN_COMPRESSED and VXL_OPEN_SESSION may only be specified together
+//   with GENERIC_WRITE. VXL_OPEN_INCREMENTAL_INDEX, VXL_OPEN_FOLLOW and
+//   VXL_OPEN_TEXT_INDEX may only be specified together with GENERIC_READ.
+//   VXL_OPEN_SESSION may not be combined with VXL_OPEN_MAPPED_WRITE.
+//
+NTSTATUS NTAPI VxlOpenLogEx(
 	OUT		PVXLHANDLE			LogHandle,
 	IN		PUNICODE_STRING		SourceApplication OPTIONAL,
 	IN		POBJECT_ATTRIBUTES	ObjectAttributes,
 	IN		ACCESS_MASK			DesiredAccess,
-	IN		ULONG				CreateDisposition)
+	IN		ULONG				CreateDisposition,
+	IN		ULONG				Flags)
 {
 	NTSTATUS Status;
-	HANDLE SectionHandle;
-	SIZE_T ViewSize;
 	IO_STATUS_BLOCK IoStatusBlock;
 	ULONG ShareAccess;
 	LONGLONG CreationInitialSize;
 	PVXLCONTEXT Context;
 	BOOLEAN NewLogFileCreated;
-	ULONG SectionDesiredAccess;
-	ULONG SectionPageProtection;
 
 	if (LogHandle) {
 		*LogHandle = NULL;
@@ -98,8 +424,23 @@ NTSTATUS NTAPI VxlOpenLog(
 		return STATUS_INVALID_PARAMETER;
 	}
 
+	if (Flags & ~VXL_OPEN_FLAGS_VALID_MASK) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	if ((Flags & ~VXL_OPEN_READ_FLAGS) && DesiredAccess != GENERIC_WRITE) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	if ((Flags & VXL_OPEN_READ_FLAGS) && DesiredAccess != GENERIC_READ) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	if ((Flags & VXL_OPEN_SESSION) && (Flags & VXL_OPEN_MAPPED_WRITE)) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
 	Context = NULL;
-	SectionHandle = NULL;
 
 	try {
 		//
@@ -115,8 +456,14 @@ NTSTATUS NTAPI VxlOpenLog(
 		//
 
 		Context->OpenMode = DesiredAccess;
+		Context->Flags = Flags;
 		DesiredAccess |= SYNCHRONIZE;
 
+		Status = VxlpCreateSourceTables(Context);
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
 		if (Context->OpenMode == GENERIC_READ) {
 			ShareAccess = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
 		} else {
@@ -188,166 +535,156 @@ NTSTATUS NTAPI VxlOpenLog(
 			// other file system that does not support compression. In this
 			// case we don't really care - we tried.
 			//
+			// Compressed log files are already about as small as they will
+			// get, and compressing them again would only slow down writes.
+			//
 
-			CompressionType = COMPRESSION_FORMAT_LZNT1;
-
-			NtFsControlFile(
-				Context->FileHandle,
-				NULL,
-				NULL,
-				NULL,
-				&IoStatusBlock,
-				FSCTL_SET_COMPRESSION,
-				&CompressionType,
-				sizeof(CompressionType),
-				NULL,
-				0);
+			unless (Flags & VXL_OPEN_COMPRESSED) {
+				CompressionType = COMPRESSION_FORMAT_LZNT1;
+
+				NtFsControlFile(
+					Context->FileHandle,
+					NULL,
+					NULL,
+					NULL,
+					&IoStatusBlock,
+					FSCTL_SET_COMPRESSION,
+					&CompressionType,
+					sizeof(CompressionType),
+					NULL,
+					0);
+			}
 		}
 
 		//
-		// Create a section backed by the entire log file.
-		// If we are opening for read only, map the entire log file into
-		// memory. If we are opening read-write, only map the header.
+		// In session mode, create the shared state before anything else,
+		// so that the header is only touched once we are part of the session.
 		//
 
-		if (Context->OpenMode == GENERIC_READ) {
-			SectionDesiredAccess = SECTION_MAP_READ;
-			SectionPageProtection = PAGE_READONLY;
-		} else {
-			SectionDesiredAccess = SECTION_MAP_READ | SECTION_MAP_WRITE;
-			SectionPageProtection = PAGE_READWRITE;
-		}
-
-		Status = NtCreateSection(
-			&SectionHandle,
-			SectionDesiredAccess,
-			NULL,
-			NULL,
-			SectionPageProtection,
-			SEC_COMMIT,
-			Context->FileHandle);
-
-		if (!NT_SUCCESS(Status)) {
-			leave;
+		if (Flags & VXL_OPEN_SESSION) {
+			Status = VxlpCreateSessionContext(Context, NULL);
+			if (!NT_SUCCESS(Status)) {
+				leave;
+			}
 		}
 
-		if (Context->OpenMode == GENERIC_READ) {
-			// map entire
-			ViewSize = 0;
-		} else {
-			// only map header
-			ViewSize = sizeof(VXLLOGFILEHEADER);
-		}
+		Status = VxlpInitializeLogContext(Context, SourceApplication, NewLogFileCreated);
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
 
-		Status = NtMapViewOfSection(
-			SectionHandle,
-			NtCurrentProcess(),
-			&Context->MappedSection,
-			0,
-			0,
-			NULL,
-			&ViewSize,
-			ViewUnmap,
-			0,
-			Context->OpenMode == GENERIC_READ ? PAGE_READONLY : PAGE_READWRITE);
+	if (!NT_SUCCESS(Status)) {
+		VxlCloseLog(&Context);
+	}
 
-		if (!NT_SUCCESS(Status)) {
-			leave;
-		}
+	*LogHandle = Context;
+	return Status;
+}
 
-		//
-		// If we are creating a new log file, we must create a new
-		// log file header. Otherwise, we will validate the existing header.
-		//
+NTSTATUS NTAPI VxlOpenLog(
+	OUT		PVXLHANDLE			LogHandle,
+	IN		PUNICODE_STRING		SourceApplication OPTIONAL,
+	IN		POBJECT_ATTRIBUTES	ObjectAttributes,
+	IN		ACCESS_MASK			DesiredAccess,
+	IN		ULONG				CreateDisposition)
+{
+	return VxlOpenLogEx(
+		LogHandle,
+		SourceApplication,
+		ObjectAttributes,
+		DesiredAccess,
+		CreateDisposition,
+		0);
+}
 
-		if (NewLogFileCreated) {
-			UNICODE_STRING DestinationSourceApplication;
+//
+// Join a session log which was opened by another process with
+// VXL_OPEN_SESSION. SessionHandles must have been filled out by
+// VxlDuplicateSessionLog, with the current process as the target.
+//
+// The handles in SessionHandles are owned by the new log handle once this
+// function is called, and they are closed if it fails.
+//
+// Flags may contain VXL_OPEN_ASYNCHRONOUS_WRITE, VXL_OPEN_DEFERRED_FORMATTING
+// and VXL_OPEN_COMPRESSED. VXL_OPEN_SESSION is implied.
+//
+NTSTATUS NTAPI VxlJoinSessionLog(
+	OUT		PVXLHANDLE			LogHandle,
+	IN		PCVXLSESSIONHANDLES	SessionHandles,
+	IN		ULONG				Flags)
+{
+	NTSTATUS Status;
+	PVXLCONTEXT Context;
 
-			//
-			// New empty log file has been created.
-			// Populate it with a header.
-			//
+	if (LogHandle) {
+		*LogHandle = NULL;
+	}
 
-			if (!SourceApplication) {
-				Status = STATUS_INVALID_PARAMETER;
-				leave;
-			}
+	if (!SessionHandles) {
+		return STATUS_INVALID_PARAMETER;
+	}
 
-			RtlZeroMemory(Context->Header, sizeof(*Context->Header));
+	Context = NULL;
 
-			RtlInitEmptyUnicodeString(
-				&DestinationSourceApplication,
-				Context->Header->SourceApplication,
-				sizeof(Context->Header->SourceApplication) - sizeof(WCHAR));
+	try {
+		if (!LogHandle || !SessionHandles->FileHandle ||
+			!SessionHandles->MutantHandle || !SessionHandles->SectionHandle) {
 
-			RtlCopyUnicodeString(&DestinationSourceApplication, SourceApplication);
+			Status = STATUS_INVALID_PARAMETER;
+			leave;
+		}
 
-			Context->Header->Version = VXLL_VERSION;
-			RtlCopyMemory(Context->Header->Magic, VXLL_MAGIC, sizeof(VXLL_MAGIC));
-		} else {
-			//
-			// Opening existing log file. Validate the header.
-			//
+		if ((Flags & ~VXL_OPEN_FLAGS_VALID_MASK) || (Flags & (VXL_OPEN_MAPPED_WRITE | VXL_OPEN_READ_FLAGS))) {
+			Status = STATUS_INVALID_PARAMETER;
+			leave;
+		}
 
-			if (!RtlEqualMemory(Context->Header->Magic, VXLL_MAGIC, sizeof(VXLL_MAGIC))) {
-				Status = STATUS_FILE_INVALID;
-				leave;
-			}
+		Context = SafeAllocSeh(VXLCONTEXT, 1);
 
-			if (Context->Header->Version != VXLL_VERSION) {
-				Status = STATUS_VERSION_MISMATCH;
-				leave;
-			}
+		RtlInitializeSRWLock(&Context->Lock);
 
-			if (Context->OpenMode == GENERIC_WRITE) {
-				//
-				// If source application parameter was specified, make sure
-				// that it is the same as what is in the log file.
-				//
+		Context->OpenMode = GENERIC_WRITE;
+		Context->Flags = Flags | VXL_OPEN_SESSION;
+		Context->FileHandle = (HANDLE) (ULONG_PTR) SessionHandles->FileHandle;
 
-				if (SourceApplication) {
-					UNICODE_STRING SourceApplicationFromFile;
+		// This takes over the mutant and section handles, even on failure.
+		Status = VxlpCreateSessionContext(Context, SessionHandles);
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
 
-					RtlInitUnicodeString(
-						&SourceApplicationFromFile,
-						Context->Header->SourceApplication);
+		Status = VxlpCreateSourceTables(Context);
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
 
-					if (!RtlEqualUnicodeString(SourceApplication, &SourceApplicationFromFile, TRUE)) {
-						Status = STATUS_SOURCE_APPLICATION_MISMATCH;
-						leave;
-					}
-				}
-			} else {
-				//
-				// Opened for reading - build the index.
-				//
+		Status = VxlpInitializeLogContext(Context, NULL, FALSE);
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
 
-				Status = VxlpBuildIndex(Context);
-				if (!NT_SUCCESS(Status)) {
-					leave;
-				}
+	if (!NT_SUCCESS(Status)) {
+		if (Context) {
+			VxlCloseLog(&Context);
+		} else {
+			if (SessionHandles->FileHandle) {
+				NtClose((HANDLE) (ULONG_PTR) SessionHandles->FileHandle);
 			}
-		}
 
-		//
-		// If opening the file for write access, mark the header as dirty.
-		//
+			if (SessionHandles->MutantHandle) {
+				NtClose((HANDLE) (ULONG_PTR) SessionHandles->MutantHandle);
+			}
 
-		if (Context->OpenMode == GENERIC_WRITE) {
-			Context->Header->Dirty = TRUE;
-			VxlpFlushLogFileHeader(Context);
+			if (SessionHandles->SectionHandle) {
+				NtClose((HANDLE) (ULONG_PTR) SessionHandles->SectionHandle);
+			}
 		}
-	} except (EXCEPTION_EXECUTE_HANDLER) {
-		Status = GetExceptionCode();
 	}
 
-	SafeClose(SectionHandle);
-
-	if (!NT_SUCCESS(Status)) {
-		VxlCloseLog(&Context);
+	if (LogHandle) {
+		*LogHandle = Context;
 	}
 
-	*LogHandle = Context;
 	return Status;
 }
 
@@ -363,16 +700,81 @@ NTSTATUS NTAPI VxlCloseLog(
 	Context = *LogHandle;
 
 	if (Context) {
-		if (Context->OpenMode == GENERIC_WRITE && Context->Header != NULL) {
-			Context->Header->Dirty = FALSE;
+		LONGLONG CommittedLength;
+		BOOLEAN LastWriter;
+		BOOLEAN SessionLockHeld;
+		BOOLEAN EntriesLost;
+
+		// Entries were lost if mapped writing had to be given up on.
+		EntriesLost = (Context->MapContext && Context->MapContext->Failed);
+
+		// Stop indexing, and write out any buffered entries, before the
+		// file goes away. The text index is built from the entry index,
+		// so it goes first.
+		VxlpDestroyTextIndexContext(Context);
+		VxlpDestroyIndexContext(Context);
+		VxlpDestroyAsyncContext(Context);
+		VxlpDestroyBlockContext(Context);
+		VxlpDestroyMapContext(Context);
+
+		CommittedLength = 0;
+		LastWriter = TRUE;
+		SessionLockHeld = FALSE;
+
+		if (Context->SessionContext) {
+			//
+			// A session log stays dirty until the last process which is
+			// writing to it, or the process which created it, closes it.
+			//
+
+			SessionLockHeld = NT_SUCCESS(VxlpAcquireSessionLock(Context));
+			LastWriter = VxlpLeaveSession(Context);
+		}
+
+		if (Context->OpenMode == GENERIC_WRITE && Context->Header != NULL && LastWriter) {
+			if (!EntriesLost) {
+				Context->Header->Dirty = FALSE;
+			}
+
+			if (Context->Header->Version >= 2) {
+				CommittedLength = Context->Header->CommittedLength;
+			}
 		}
 
+		VxlpFreeFormattedTextCache(Context);
+
 		if (Context->MappedSection) {
 			NtUnmapViewOfSection(NtCurrentProcess(), Context->MappedSection);
 		}
 
+		// Views which were replaced while following the log.
+		VxlpDestroyFollowContext(Context);
+
+		if (CommittedLength != 0) {
+			IO_STATUS_BLOCK IoStatusBlock;
+
+			//
+			// Trim off any space that was allocated in advance but never
+			// used. This can only be done once nothing is mapped.
+			//
+
+			NtSetInformationFile(
+				Context->FileHandle,
+				&IoStatusBlock,
+				&CommittedLength,
+				sizeof(CommittedLength),
+				FileEndOfFileInformation);
+		}
+
+		if (SessionLockHeld) {
+			VxlpReleaseSessionLock(Context);
+		}
+
+		VxlpDestroySessionContext(Context);
 		SafeClose(Context->FileHandle);
 		SafeFree(Context->EntryIndexToFileOffset);
+		VxlpFreeBlockIndex(Context);
+		VxlpDestroySourceTables(Context);
 		SafeFree(*LogHandle);
 	}
 
@@ -16,6 +16,12 @@
 //
 //     vxiiduu	            30-Sep-2022  Initial creation.
 //     vxiiduu              15-Oct-2022  Convert to v2 format.
+//     agent                17-Oct-2026  Support VXLL_VERSION 1 and 2 files, move
+//                                       source string handling to vxlsrc.c
+//     agent                17-Oct-2026  Index deferred log entries
+//     agent                17-Oct-2026  Index compressed blocks
+//     agent                17-Oct-2026  Allow the index to be built in steps
+//     agent                17-Oct-2026  Count entries seen by the reader
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -54,6 +60,16 @@ ULONG VxlpGetTotalLogEntryCount(
 	ASSERT (LogHandle != NULL);
 	ASSERT (LogHandle->Header != NULL);
 
+	//
+	// With an incremental index, the header may be changed by a writer while
+	// the log is being read, so the number of entries which the reader knows
+	// about is kept separately.
+	//
+
+	if (LogHandle->IndexContext) {
+		return LogHandle->IndexContext->NumberOfEntries;
+	}
+
 	Total = 0;
 
 	ForEachArrayItem (LogHandle->Header->EventSeverityTypeCount, Index) {
@@ -63,46 +79,89 @@ ULONG VxlpGetTotalLogEntryCount(
 	return Total;
 }
 
-ULONG VxlpSizeOfLogFileEntry(
-	IN	PVXLLOGFILEENTRY	Entry)
+ULONG VxlpGetLogFileHeaderSize(
+	IN	PCVXLLOGFILEHEADER	Header)
+{
+	ASSERT (Header != NULL);
+
+	if (Header->Version == 1) {
+		return VXLL_V1_HEADER_SIZE;
+	}
+
+	return Header->HeaderSize;
+}
+
+ULONG VxlpSizeOfLogFileEntryV1(
+	IN	PCVXLLOGFILEENTRY_V1	Entry)
 {
 	ULONG Size;
 
 	ASSERT (Entry != NULL);
 
-	Size = sizeof(VXLLOGFILEENTRY);
+	Size = sizeof(VXLLOGFILEENTRY_V1);
 	Size += Entry->TextHeaderCch * sizeof(WCHAR);
 	Size += Entry->TextCch * sizeof(WCHAR);
 
 	return Size;
 }
 
-NTSTATUS VxlpBuildIndex(
-	IN	VXLHANDLE			LogHandle)
+//
+// Check that a VXL_RECORD_LOG_ENTRY or VXL_RECORD_DEFERRED_LOG_ENTRY record
+// is big enough for what it claims to contain. The record must already be
+// known to fit inside the file (or block).
+//
+
+BOOLEAN VxlpIsValidLogEntryRecord(
+	IN	PCVXLLOGFILERECORD	Record)
 {
-	PVXLLOGFILEENTRY Entry;
-	ULONG TotalLogEntryCount;
-	ULONG Index;
-	ULONG SeverityIndex[LogSeverityMaximumValue];
+	ASSERT (Record != NULL);
 
-	ASSERT (LogHandle != NULL);
-	ASSERT (LogHandle->OpenMode == GENERIC_READ);
-	ASSERT (LogHandle->EntryIndexToFileOffset == NULL);
+	if (Record->RecordType == VXL_RECORD_LOG_ENTRY) {
+		return (Record->RecordSize >= sizeof(VXLLOGFILEENTRY));
+	} else if (Record->RecordType == VXL_RECORD_DEFERRED_LOG_ENTRY) {
+		PCVXLLOGFILEDEFERREDENTRY DeferredEntry;
 
-	TotalLogEntryCount = VxlpGetTotalLogEntryCount(LogHandle);
+		DeferredEntry = (PCVXLLOGFILEDEFERREDENTRY) Record;
 
-	if (!TotalLogEntryCount) {
-		return STATUS_NO_MORE_ENTRIES;
+		return (Record->RecordSize >= FIELD_OFFSET(VXLLOGFILEDEFERREDENTRY, Arguments) &&
+				Record->RecordSize >= FIELD_OFFSET(VXLLOGFILEDEFERREDENTRY, Arguments) + DeferredEntry->ArgumentsCb);
 	}
 
-	//
-	// Allocate memory for the index.
-	//
+	return FALSE;
+}
 
-	LogHandle->EntryIndexToFileOffset = SafeAllocSeh(ULONG, TotalLogEntryCount);
+//
+// Version 1 files have no record of how much data they contain, so we
+// have to trust the entry counts. The source names are in the header.
+//
+
+STATIC NTSTATUS VxlpBuildIndexV1(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONG				TotalLogEntryCount)
+{
+	NTSTATUS Status;
+	PVXLLOGFILEHEADER_V1 Header;
+	PVXLLOGFILEENTRY_V1 Entry;
+	ULONG Index;
+
+	Header = LogHandle->HeaderV1;
+
+	for (Index = 0; Index < ARRAYSIZE(Header->SourceComponents) && Header->SourceComponents[Index][0]; ++Index) {
+		Status = VxlpAddSourceString(LogHandle, VxlSourceComponent, Index, Header->SourceComponents[Index]);
+		ASSERT (NT_SUCCESS(Status));
+	}
+
+	for (Index = 0; Index < ARRAYSIZE(Header->SourceFiles) && Header->SourceFiles[Index][0]; ++Index) {
+		Status = VxlpAddSourceString(LogHandle, VxlSourceFile, Index, Header->SourceFiles[Index]);
+		ASSERT (NT_SUCCESS(Status));
+	}
+
+	for (Index = 0; Index < ARRAYSIZE(Header->SourceFunctions) && Header->SourceFunctions[Index][0]; ++Index) {
+		Status = VxlpAddSourceString(LogHandle, VxlSourceFunction, Index, Header->SourceFunctions[Index]);
+		ASSERT (NT_SUCCESS(Status));
+	}
 
-	Entry = (PVXLLOGFILEENTRY) (LogHandle->MappedFile + sizeof(VXLLOGFILEHEADER));
-	RtlZeroMemory(SeverityIndex, sizeof(SeverityIndex));
+	Entry = (PVXLLOGFILEENTRY_V1) (LogHandle->MappedFile + VXLL_V1_HEADER_SIZE);
 
 	for (Index = 0; TotalLogEntryCount--; ++Index) {
 		//
@@ -116,116 +175,226 @@ NTSTATUS VxlpBuildIndex(
 		// skip ahead to next entry
 		//
 
-		Entry = (PVXLLOGFILEENTRY) RVA_TO_VA(Entry, VxlpSizeOfLogFileEntry(Entry));
+		Entry = (PVXLLOGFILEENTRY_V1) RVA_TO_VA(Entry, VxlpSizeOfLogFileEntryV1(Entry));
 	}
 
 	return STATUS_SUCCESS;
 }
 
-NTSTATUS VxlpFindOrCreateSourceComponentIndex(
-	IN	VXLHANDLE			LogHandle,
-	IN	PCWSTR				SourceComponent,
-	OUT	PUCHAR				SourceComponentIndex)
+//
+// Index the records of a version 2 file, starting at the record at *Offset,
+// which is the *Index'th entry. Stops once *Index reaches StopIndex or at the
+// end of the data, whichever comes first, and updates *Offset and *Index to
+// where it stopped. Entries inside a compressed block are all counted at
+// once, so *Index may end up past StopIndex. If StopIndex is the total
+// number of entries, the rest of the data is still checked, and any source
+// strings after the last entry are loaded. Nothing at or past EndOfData is
+// looked at.
+//
+// Space for the offsets of at least StopIndex entries must be available in
+// LogHandle->EntryIndexToFileOffset.
+//
+
+NTSTATUS VxlpIndexRecords(
+	IN		VXLHANDLE			LogHandle,
+	IN OUT	PULONGLONG			Offset,
+	IN OUT	PULONG				Index,
+	IN		ULONG				StopIndex,
+	IN		ULONG				TotalLogEntryCount,
+	IN		ULONGLONG			EndOfData)
 {
-	ULONG Index;
+	NTSTATUS Status;
 
 	ASSERT (LogHandle != NULL);
-	ASSERT (SourceComponent != NULL);
-	ASSERT (SourceComponentIndex != NULL);
-	ASSERT (wcslen(SourceComponent) < ARRAYSIZE(LogHandle->Header->SourceComponents[0]));
-
-	for (Index = 0; Index < ARRAYSIZE(LogHandle->Header->SourceComponents); ++Index) {
-		if (StringEqual(LogHandle->Header->SourceComponents[Index], SourceComponent)) {
-			*SourceComponentIndex = Index;
-			return STATUS_SUCCESS;
-		} else if (LogHandle->Header->SourceComponents[Index][0] == '\0') {
-			HRESULT Result;
-
-			Result = StringCchCopy(
-				LogHandle->Header->SourceComponents[Index],
-				ARRAYSIZE(LogHandle->Header->SourceComponents[Index]),
-				SourceComponent);
-
-			if (FAILED(Result)) {
-				return STATUS_BUFFER_TOO_SMALL;
+	ASSERT (LogHandle->Header->Version >= 2);
+	ASSERT (Offset != NULL);
+	ASSERT (Index != NULL);
+	ASSERT (StopIndex <= TotalLogEntryCount);
+
+	while ((*Index < StopIndex || StopIndex == TotalLogEntryCount) &&
+		   *Offset + sizeof(VXLLOGFILERECORD) <= EndOfData) {
+
+		PVXLLOGFILERECORD Record;
+
+		Record = (PVXLLOGFILERECORD) (LogHandle->MappedFile + *Offset);
+
+		if (Record->RecordSize < sizeof(VXLLOGFILERECORD) ||
+			*Offset + Record->RecordSize > EndOfData) {
+
+			return STATUS_FILE_CORRUPT_ERROR;
+		}
+
+		if (Record->RecordType == VXL_RECORD_LOG_ENTRY) {
+			if (!VxlpIsValidLogEntryRecord(Record) || *Index >= TotalLogEntryCount) {
+				return STATUS_FILE_CORRUPT_ERROR;
 			}
 
-			*SourceComponentIndex = Index;
-			return STATUS_SUCCESS;
+			LogHandle->EntryIndexToFileOffset[(*Index)++] = (ULONG) *Offset;
+		} else if (Record->RecordType == VXL_RECORD_DEFERRED_LOG_ENTRY) {
+			if (!VxlpIsValidLogEntryRecord(Record) || *Index >= TotalLogEntryCount) {
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+
+			LogHandle->EntryIndexToFileOffset[(*Index)++] = (ULONG) *Offset;
+		} else if (Record->RecordType == VXL_RECORD_COMPRESSED_BLOCK) {
+			PVXLLOGFILEBLOCK Block;
+
+			Block = (PVXLLOGFILEBLOCK) Record;
+
+			if (Record->RecordSize < sizeof(VXLLOGFILEBLOCK) ||
+				Record->RecordSize < sizeof(VXLLOGFILEBLOCK) + Block->DataCb ||
+				Block->DataCb > Block->UncompressedCb ||
+				Block->UncompressedCb > VXL_BLOCK_SIZE ||
+				Block->EntryCount > TotalLogEntryCount - *Index) {
+
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+
+			//
+			// Don't look inside the block yet. It is decompressed, and the
+			// offsets of its entries are filled in, when one of them is read
+			// (see vxlblock.c). It may contain deferred entries.
+			//
+
+			Status = VxlpAddBlockToIndex(LogHandle, (ULONG) *Offset, *Index, Block->EntryCount);
+			if (!NT_SUCCESS(Status)) {
+				return Status;
+			}
+
+			*Index += Block->EntryCount;
+		} else if (Record->RecordType == VXL_RECORD_SOURCE_STRING) {
+			PVXLLOGFILESTRING StringRecord;
+
+			StringRecord = (PVXLLOGFILESTRING) Record;
+
+			if (Record->RecordSize < sizeof(VXLLOGFILESTRING) + sizeof(WCHAR) ||
+				StringRecord->String[(Record->RecordSize - sizeof(VXLLOGFILESTRING)) / sizeof(WCHAR) - 1] != '\0') {
+
+				return STATUS_FILE_CORRUPT_ERROR;
+			}
+
+			Status = VxlpAddSourceString(
+				LogHandle,
+				(VXLSOURCETYPE) StringRecord->SourceType,
+				StringRecord->Index,
+				StringRecord->String);
+
+			if (!NT_SUCCESS(Status)) {
+				return Status;
+			}
 		}
+
+		*Offset += Record->RecordSize;
 	}
 
-	return STATUS_TOO_MANY_INDICES;
+	return STATUS_SUCCESS;
 }
 
-NTSTATUS VxlpFindOrCreateSourceFileIndex(
+STATIC NTSTATUS VxlpBuildIndexV2(
 	IN	VXLHANDLE			LogHandle,
-	IN	PCWSTR				SourceFile,
-	OUT	PUCHAR				SourceFileIndex)
+	IN	ULONG				TotalLogEntryCount)
 {
+	NTSTATUS Status;
+	ULONGLONG Offset;
 	ULONG Index;
 
-	ASSERT (LogHandle != NULL);
-	ASSERT (SourceFile != NULL);
-	ASSERT (SourceFileIndex != NULL);
-	ASSERT (wcslen(SourceFile) < ARRAYSIZE(LogHandle->Header->SourceFiles[0]));
-
-	for (Index = 0; Index < ARRAYSIZE(LogHandle->Header->SourceFiles); ++Index) {
-		if (StringEqual(LogHandle->Header->SourceFiles[Index], SourceFile)) {
-			*SourceFileIndex = Index;
-			return STATUS_SUCCESS;
-		} else if (LogHandle->Header->SourceFiles[Index][0] == '\0') {
-			HRESULT Result;
-
-			Result = StringCchCopy(
-				LogHandle->Header->SourceFiles[Index],
-				ARRAYSIZE(LogHandle->Header->SourceFiles[Index]),
-				SourceFile);
-
-			if (FAILED(Result)) {
-				return STATUS_BUFFER_TOO_SMALL;
-			}
+	Offset = LogHandle->Header->HeaderSize;
+	Index = 0;
 
-			*SourceFileIndex = Index;
-			return STATUS_SUCCESS;
-		}
+	Status = VxlpIndexRecords(
+		LogHandle,
+		&Offset,
+		&Index,
+		TotalLogEntryCount,
+		TotalLogEntryCount,
+		LogHandle->Header->CommittedLength);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	if (Index != TotalLogEntryCount) {
+		// The header claims more entries than there is data.
+		return STATUS_FILE_CORRUPT_ERROR;
 	}
 
-	return STATUS_TOO_MANY_INDICES;
+	return STATUS_SUCCESS;
 }
 
-NTSTATUS VxlpFindOrCreateSourceFunctionIndex(
-	IN	VXLHANDLE			LogHandle,
-	IN	PCWSTR				SourceFunction,
-	OUT	PUCHAR				SourceFunctionIndex)
+NTSTATUS VxlpBuildIndex(
+	IN	VXLHANDLE			LogHandle)
 {
-	ULONG Index;
+	ULONG TotalLogEntryCount;
 
 	ASSERT (LogHandle != NULL);
-	ASSERT (SourceFunction != NULL);
-	ASSERT (SourceFunctionIndex != NULL);
-	ASSERT (wcslen(SourceFunction) < ARRAYSIZE(LogHandle->Header->SourceFunctions[0]));
-
-	for (Index = 0; Index < ARRAYSIZE(LogHandle->Header->SourceFunctions); ++Index) {
-		if (StringEqual(LogHandle->Header->SourceFunctions[Index], SourceFunction)) {
-			*SourceFunctionIndex = Index;
-			return STATUS_SUCCESS;
-		} else if (LogHandle->Header->SourceFunctions[Index][0] == '\0') {
-			HRESULT Result;
-
-			Result = StringCchCopy(
-				LogHandle->Header->SourceFunctions[Index],
-				ARRAYSIZE(LogHandle->Header->SourceFunctions[Index]),
-				SourceFunction);
-
-			if (FAILED(Result)) {
-				return STATUS_BUFFER_TOO_SMALL;
-			}
+	ASSERT (LogHandle->OpenMode == GENERIC_READ);
+	ASSERT (LogHandle->EntryIndexToFileOffset == NULL);
 
-			*SourceFunctionIndex = Index;
-			return STATUS_SUCCESS;
-		}
+	TotalLogEntryCount = VxlpGetTotalLogEntryCount(LogHandle);
+
+	if (!TotalLogEntryCount) {
+		return STATUS_NO_MORE_ENTRIES;
 	}
 
-	return STATUS_TOO_MANY_INDICES;
+	//
+	// Allocate memory for the index.
+	//
+
+	LogHandle->EntryIndexToFileOffset = SafeAllocSeh(ULONG, TotalLogEntryCount);
+
+	if (LogHandle->Header->Version == 1) {
+		return VxlpBuildIndexV1(LogHandle, TotalLogEntryCount);
+	} else {
+		return VxlpBuildIndexV2(LogHandle, TotalLogEntryCount);
+	}
+}
+
+//
+// Check for a double newline (\r\n\r\n) and replace the first \r\n
+// out of the two \r\n's with a single null character (\0), unless
+// the double newline occurs at the end of the string. The part before
+// the double newline is the text header and the rest is the text body.
+//
+// TextCch includes the null terminator, and is updated to account for the
+// characters that were removed. TextBodyCch is 0 if there is no body.
+//
+
+VOID VxlpSplitLogText(
+	IN OUT	PWSTR	Text,
+	IN OUT	PULONG	TextCch,
+	OUT		PULONG	TextHeaderCch,
+	OUT		PULONG	TextBodyCch)
+{
+	PWSTR DoubleNewLine;
+
+	ASSERT (Text != NULL);
+	ASSERT (TextCch != NULL);
+	ASSERT (*TextCch != 0);
+	ASSERT (TextHeaderCch != NULL);
+	ASSERT (TextBodyCch != NULL);
+
+	DoubleNewLine = (PWSTR) StringFind(Text, L"\r\n\r\n");
+
+	if (DoubleNewLine && DoubleNewLine[4]) {
+		*DoubleNewLine = '\0';
+		
+		RtlMoveMemory(
+			DoubleNewLine + 1,
+			DoubleNewLine + 4,
+			(*TextCch - (DoubleNewLine + 4 - Text)) * sizeof(WCHAR));
+
+		*TextCch -= 3;
+		*TextHeaderCch = (ULONG) (DoubleNewLine - Text + 1);
+		*TextBodyCch = *TextCch - *TextHeaderCch;
+
+		// NOTE: This assertion can get hit if the log string contains null
+		// characters. If you are hitting this assertion make sure that any
+		// UNICODE_STRINGs you are putting in the formatted text do not contain
+		// embedded nulls. Technically the log file format can support embedded
+		// nulls but the log viewer does not display any text after a null.
+		ASSERT (wcslen(Text + *TextHeaderCch) == *TextBodyCch - 1);
+	} else {
+		*TextHeaderCch = *TextCch;
+		*TextBodyCch = 0;
+	}
 }
\ No newline at end of file
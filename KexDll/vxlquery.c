@@ -16,6 +16,8 @@
 //
 //     vxiiduu	            30-Sep-2022  Initial creation.
 //     vxiiduu              12-Nov-2022  Convert to v3 + native API
+//     agent                17-Oct-2026  Add source string count classes
+//     agent                17-Oct-2026  Add LogNumberOfIndexedEvents
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -56,6 +58,10 @@ NTSTATUS NTAPI VxlQueryInformationLog(
 	case LogNumberOfDetailEvents:
 	case LogNumberOfDebugEvents:
 	case LogTotalNumberOfEvents:
+	case LogNumberOfSourceComponents:
+	case LogNumberOfSourceFiles:
+	case LogNumberOfSourceFunctions:
+	case LogNumberOfIndexedEvents:
 		RequiredBufferSize = sizeof(ULONG);
 		break;
 	case LogSourceApplication:
@@ -85,6 +91,20 @@ NTSTATUS NTAPI VxlQueryInformationLog(
 			break;
 		case LogTotalNumberOfEvents:
 			*(PULONG) Buffer = VxlpGetTotalLogEntryCount(LogHandle);
+			break;
+		case LogNumberOfSourceComponents:
+		case LogNumberOfSourceFiles:
+		case LogNumberOfSourceFunctions:
+			*(PULONG) Buffer = LogHandle->SourceTables->Tables[
+				VxlSourceComponent + (LogInformationClass - LogNumberOfSourceComponents)].NumberOfStrings;
+			break;
+		case LogNumberOfIndexedEvents:
+			if (LogHandle->IndexContext) {
+				*(PULONG) Buffer = LogHandle->IndexContext->NumberOfIndexedEntries;
+			} else {
+				*(PULONG) Buffer = VxlpGetTotalLogEntryCount(LogHandle);
+			}
+
 			break;
 		case LogSourceApplication:
 			RequiredBufferSize = wcslen(LogHandle->Header->SourceApplication) * sizeof(WCHAR);
@@ -15,97 +15,304 @@
 // Revision History:
 //
 //     vxiiduu	            19-Nov-2022  Initial creation.
+//     agent                17-Oct-2026  Support version 2 log entries
+//     agent                17-Oct-2026  Format deferred log entries on demand
+//     agent                17-Oct-2026  Read entries from compressed blocks
+//     agent                17-Oct-2026  Fix reading one entry past the end
+//     agent                17-Oct-2026  Add VxlReadLogRange
+//     agent                17-Oct-2026  Convert times through a VXLTIMECACHE
+//     agent                17-Oct-2026  Read deferred text into a caller buffer
 //
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "buildcfg.h"
 #include "kexdllp.h"
 
+// Number of entries looked up at a time by VxlReadLogRange.
+#define VXL_READ_BATCH_SIZE 64
+
+// The part of the caller's text buffer that VxlReadLogRange has used up.
+typedef struct _VXLREADTEXTBUFFER {
+	PWSTR	Buffer;
+	ULONG	BufferCch;
+	ULONG	UsedCch;
+} TYPEDEF_TYPE_NAME(VXLREADTEXTBUFFER);
+
+STATIC VOID VxlpSetLogEntryViewText(
+	OUT	PVXLLOGENTRYVIEW	View,
+	IN	PCWSTR				Text,
+	IN	ULONG				TextHeaderCch,
+	IN	ULONG				TextCch)
+{
+	RtlZeroMemory(&View->TextHeader, sizeof(View->TextHeader));
+	RtlZeroMemory(&View->Text, sizeof(View->Text));
+
+	if (TextHeaderCch != 0) {
+		View->TextHeader.Length			= (USHORT) ((TextHeaderCch - 1) * sizeof(WCHAR));
+		View->TextHeader.MaximumLength	= View->TextHeader.Length + sizeof(WCHAR);
+		View->TextHeader.Buffer			= (PWSTR) Text;
+	}
+
+	if (TextCch != 0) {
+		View->Text.Length				= (USHORT) ((TextCch - 1) * sizeof(WCHAR));
+		View->Text.MaximumLength		= View->Text.Length + sizeof(WCHAR);
+		View->Text.Buffer				= (PWSTR) Text + TextHeaderCch;
+	}
+}
+
+//
+// Fill out a view of a log entry, given a pointer to its record (see
+// VxlpGetLogFileEntry). Nothing is copied: the text points into the mapped
+// file or a decompressed block, both of which stay around until the log is
+// closed.
+//
+// The text of deferred entries is formatted into TextBuffer. If there is
+// no TextBuffer, it is left empty. Either way, TextIsTransient is set.
+// Returns STATUS_BUFFER_OVERFLOW if the text would fit into the buffer if
+// it was empty, so that the caller can stop and let its caller start over
+// with the buffer.
+//
+
+STATIC NTSTATUS VxlpFillLogEntryView(
+	IN		VXLHANDLE			LogHandle,
+	IN		PVOID				FileEntry,
+	OUT		PVXLLOGENTRYVIEW	View,
+	IN OUT	PVXLREADTEXTBUFFER	TextBuffer OPTIONAL)
+{
+	NTSTATUS Status;
+	PCWSTR Text;
+	ULONG TextHeaderCch;
+	ULONG TextCch;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (FileEntry != NULL);
+	ASSERT (View != NULL);
+
+	RtlZeroMemory(View, sizeof(*View));
+
+	if (LogHandle->Header->Version == 1) {
+		PVXLLOGFILEENTRY_V1 FileEntryV1;
+
+		FileEntryV1 = (PVXLLOGFILEENTRY_V1) FileEntry;
+
+		Text							= FileEntryV1->Text;
+		TextHeaderCch					= FileEntryV1->TextHeaderCch;
+		TextCch							= FileEntryV1->TextCch;
+
+		View->Time64					= FileEntryV1->Time64;
+		View->SourceComponentIndex		= FileEntryV1->SourceComponentIndex;
+		View->SourceFileIndex			= FileEntryV1->SourceFileIndex;
+		View->SourceFunctionIndex		= FileEntryV1->SourceFunctionIndex;
+		View->SourceLine				= FileEntryV1->SourceLine;
+		View->ProcessId					= FileEntryV1->ProcessId;
+		View->ThreadId					= FileEntryV1->ThreadId;
+		View->Severity					= FileEntryV1->Severity;
+	} else {
+		PVXLLOGFILEENTRY FileEntryV2;
+
+		FileEntryV2 = (PVXLLOGFILEENTRY) FileEntry;
+
+		if (FileEntryV2->RecordType == VXL_RECORD_DEFERRED_LOG_ENTRY) {
+			Text						= NULL;
+			TextHeaderCch				= 0;
+			TextCch						= 0;
+			View->TextIsTransient		= TRUE;
+
+			if (TextBuffer && TextBuffer->UsedCch < TextBuffer->BufferCch) {
+				ULONG AvailableCch;
+
+				AvailableCch = min(TextBuffer->BufferCch - TextBuffer->UsedCch, VXL_READ_TEXT_BUFFER_CCH);
+
+				Status = VxlpGetDeferredLogEntryText(
+					LogHandle,
+					(PCVXLLOGFILEDEFERREDENTRY) FileEntry,
+					TextBuffer->Buffer + TextBuffer->UsedCch,
+					AvailableCch,
+					&TextHeaderCch,
+					&TextCch);
+
+				if (Status == STATUS_BUFFER_OVERFLOW &&
+					TextBuffer->UsedCch != 0 &&
+					AvailableCch < VXL_READ_TEXT_BUFFER_CCH) {
+
+					return STATUS_BUFFER_OVERFLOW;
+				}
+
+				if (!NT_SUCCESS(Status) && Status != STATUS_BUFFER_OVERFLOW) {
+					return Status;
+				}
+
+				Text = TextBuffer->Buffer + TextBuffer->UsedCch;
+				TextBuffer->UsedCch += TextHeaderCch + TextCch;
+			} else if (TextBuffer && TextBuffer->UsedCch != 0) {
+				return STATUS_BUFFER_OVERFLOW;
+			}
+		} else {
+			Text						= FileEntryV2->Text;
+			TextHeaderCch				= FileEntryV2->TextHeaderCch;
+			TextCch						= FileEntryV2->TextCch;
+		}
+
+		// The rest of the fields are the same for deferred entries.
+		View->Time64					= FileEntryV2->Time64;
+		View->SourceComponentIndex		= FileEntryV2->SourceComponentIndex;
+		View->SourceFileIndex			= FileEntryV2->SourceFileIndex;
+		View->SourceFunctionIndex		= FileEntryV2->SourceFunctionIndex;
+		View->SourceLine				= FileEntryV2->SourceLine;
+		View->ProcessId					= FileEntryV2->ProcessId;
+		View->ThreadId					= FileEntryV2->ThreadId;
+		View->Severity					= FileEntryV2->Severity;
+	}
+
+	VxlpSetLogEntryViewText(View, Text, TextHeaderCch, TextCch);
+	return STATUS_SUCCESS;
+}
+
+//
+// Read the current time zone bias (the difference between UTC and local
+// time) from the shared user data page.
+//
+
+STATIC LONGLONG VxlpQueryTimeZoneBias(
+	VOID)
+{
+	LONGLONG TimeZoneBias;
+
+	do {
+		TimeZoneBias = *(PLONGLONG) &SharedUserData->TimeZoneBias;
+	} until (SharedUserData->TimeZoneBias.High1Time == SharedUserData->TimeZoneBias.High2Time);
+
+	return TimeZoneBias;
+}
+
 STATIC FORCEINLINE NTSTATUS VxlpReadLogInternal(
 	IN		VXLHANDLE		LogHandle,
 	IN		ULONG			LogEntryIndex,
+	IN		LONGLONG		TimeZoneBias,
+	IN OUT	PVXLTIMECACHE	TimeCache,
 	OUT		PVXLLOGENTRY	Entry)
 {
-	PVXLLOGFILEENTRY FileEntry;
-	TIME_FIELDS TimeFields;
-	LONGLONG LocalTime;
+	NTSTATUS Status;
+	PVOID FileEntry;
+	VXLLOGENTRYVIEW View;
 
 	ASSERT (Entry != NULL);
 	ASSERT (LogHandle != NULL);
 	ASSERT (LogHandle->MappedFile != NULL);
 	ASSERT (LogHandle->EntryIndexToFileOffset != NULL);
-	ASSERT (LogHandle->EntryIndexToFileOffset[LogEntryIndex] != 0);
 
 	//
 	// Use the index to look up the file offset for this log entry, and then
-	// convert it into a pointer to the log entry.
+	// convert it into a pointer to the log entry. If the entry is inside a
+	// compressed block, this decompresses the block.
 	//
 
-	FileEntry = (PVXLLOGFILEENTRY) RVA_TO_VA(
-		LogHandle->MappedFile,
-		LogHandle->EntryIndexToFileOffset[LogEntryIndex]);
+	Status = VxlpGetLogFileEntry(LogHandle, LogEntryIndex, &FileEntry);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	Status = VxlpFillLogEntryView(LogHandle, FileEntry, &View, NULL);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	if (View.TextIsTransient) {
+		PCVXLFORMATTEDTEXT FormattedText;
+
+		Status = VxlpGetCachedDeferredLogEntryText(
+			LogHandle,
+			LogEntryIndex,
+			(PCVXLLOGFILEDEFERREDENTRY) FileEntry,
+			&FormattedText);
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+
+		VxlpSetLogEntryViewText(
+			&View,
+			FormattedText->Text,
+			FormattedText->TextHeaderCch,
+			FormattedText->TextCch);
+	}
 
 	//
 	// Fill out the caller's provided VXLLOGENTRY structure.
 	//
 
-	RtlZeroMemory(Entry, sizeof(*Entry));
+	Entry->TextHeader				= View.TextHeader;
+	Entry->Text						= View.Text;
+	Entry->SourceComponentIndex		= View.SourceComponentIndex;
+	Entry->SourceFileIndex			= View.SourceFileIndex;
+	Entry->SourceFunctionIndex		= View.SourceFunctionIndex;
+	Entry->SourceLine				= View.SourceLine;
+	Entry->ClientId.UniqueProcess	= (HANDLE) View.ProcessId;
+	Entry->ClientId.UniqueThread	= (HANDLE) View.ThreadId;
+	Entry->Severity					= View.Severity;
 
-	if (FileEntry->TextHeaderCch != 0) {
-		Entry->TextHeader.Length		= (FileEntry->TextHeaderCch - 1) * sizeof(WCHAR);
-		Entry->TextHeader.MaximumLength	= Entry->TextHeader.Length + sizeof(WCHAR);
-		Entry->TextHeader.Buffer		= FileEntry->Text;
-	}
+	VxlpConvertTime(TimeCache, View.Time64 - TimeZoneBias, &Entry->Time);
 
-	if (FileEntry->TextCch != 0) {
-		Entry->Text.Length				= (FileEntry->TextCch - 1) * sizeof(WCHAR);
-		Entry->Text.MaximumLength		= Entry->Text.Length + sizeof(WCHAR);
-		Entry->Text.Buffer				= FileEntry->Text + FileEntry->TextHeaderCch;
-	}
+	return STATUS_SUCCESS;
+}
 
-	Entry->SourceComponentIndex		= FileEntry->SourceComponentIndex;
-	Entry->SourceFileIndex			= FileEntry->SourceFileIndex;
-	Entry->SourceFunctionIndex		= FileEntry->SourceFunctionIndex;
-	Entry->SourceLine				= FileEntry->SourceLine;
+//
+// Convert the timestamp of a log entry (UTC) into local time.
+//
 
-	Entry->ClientId.UniqueProcess	= (HANDLE) FileEntry->ProcessId;
-	Entry->ClientId.UniqueThread	= (HANDLE) FileEntry->ThreadId;
+VOID NTAPI VxlConvertLogEntryTime(
+	IN		LONGLONG		Time64,
+	OUT		PSYSTEMTIME		Time)
+{
+	VXLTIMECACHE TimeCache;
 
-	Entry->Severity					= FileEntry->Severity;
+	ASSERT (Time != NULL);
 
-	//
-	// Fill out the SYSTEMTIME structure in the VXLLOGENTRY structure.
-	// First, convert the 64-bit timestamp in the VXLLOGFILEENTRY from UTC
-	// to local time.
-	//
+	VxlpInitializeTimeCache(&TimeCache);
+	VxlpConvertTime(&TimeCache, Time64 - VxlpQueryTimeZoneBias(), Time);
+}
 
-	do {
-		LocalTime = FileEntry->Time64 - *(PLONGLONG) &SharedUserData->TimeZoneBias;
-	} until (SharedUserData->TimeZoneBias.High1Time == SharedUserData->TimeZoneBias.High2Time);
+//
+// Convert the timestamps of many log entries (see VxlReadLogRange) into
+// local time at once. This is much faster than calling VxlConvertLogEntryTime
+// for each of them when the entries are in time order, because the date
+// only has to be worked out when the hour changes.
+//
 
-	//
-	// Now convert the local time into a SYSTEMTIME.
-	//
+KEXAPI VOID NTAPI VxlConvertLogEntryTimes(
+	IN		ULONG				NumberOfEntries,
+	IN		PCVXLLOGENTRYVIEW	Views,
+	OUT		PSYSTEMTIME			Times)
+{
+	VXLTIMECACHE TimeCache;
+	LONGLONG TimeZoneBias;
+	ULONG Index;
 
-	RtlTimeToTimeFields(&LocalTime, &TimeFields);
-	Entry->Time.wYear			= TimeFields.Year;
-	Entry->Time.wMonth			= TimeFields.Month;
-	Entry->Time.wDay			= TimeFields.Day;
-	Entry->Time.wDayOfWeek		= TimeFields.Weekday;
-	Entry->Time.wHour			= TimeFields.Hour;
-	Entry->Time.wMinute			= TimeFields.Minute;
-	Entry->Time.wSecond			= TimeFields.Second;
-	Entry->Time.wMilliseconds	= TimeFields.Milliseconds;
+	ASSERT (NumberOfEntries == 0 || Views != NULL);
+	ASSERT (NumberOfEntries == 0 || Times != NULL);
 
-	return STATUS_SUCCESS;
+	VxlpInitializeTimeCache(&TimeCache);
+	TimeZoneBias = VxlpQueryTimeZoneBias();
+
+	for (Index = 0; Index < NumberOfEntries; ++Index) {
+		VxlpConvertTime(&TimeCache, Views[Index].Time64 - TimeZoneBias, &Times[Index]);
+	}
 }
 
+//
+// Read one log entry. The text of entries written with deferred formatting
+// is formatted into a small cache on the log handle, and is only valid
+// until VXL_FORMATTED_TEXT_CACHE_SIZE other such entries have been read.
+// New code should use VxlReadLogRange instead.
+//
+
 NTSTATUS NTAPI VxlReadLog(
 	IN		VXLHANDLE		LogHandle,
 	IN		ULONG			LogEntryIndex,
 	OUT		PVXLLOGENTRY	Entry)
 {
 	ULONG MaximumIndex;
+	VXLTIMECACHE TimeCache;
 
 	//
 	// Parameter validation
@@ -125,13 +332,136 @@ NTSTATUS NTAPI VxlReadLog(
 		return STATUS_NO_MORE_ENTRIES;
 	}
 
-	if (LogEntryIndex > MaximumIndex) {
+	// MaximumIndex is actually the number of entries.
+	if (LogEntryIndex >= MaximumIndex) {
 		return STATUS_NO_MORE_ENTRIES;
 	}
 
-	return VxlpReadLogInternal(LogHandle, LogEntryIndex, Entry);
+	VxlpInitializeTimeCache(&TimeCache);
+
+	return VxlpReadLogInternal(
+		LogHandle,
+		LogEntryIndex,
+		VxlpQueryTimeZoneBias(),
+		&TimeCache,
+		Entry);
 }
 
+//
+// Read up to NumberOfEntries consecutive log entries, starting at
+// FirstEntryIndex, into an array of views supplied by the caller. This is
+// much cheaper than calling VxlReadLog for each entry: the index is looked
+// up once per batch of entries, nothing is copied, and the timestamps are
+// left as they are in the file. Use VxlConvertLogEntryTimes to convert
+// the ones you need.
+//
+// The text of entries written with deferred formatting is formatted into
+// TextBuffer (see VXLLOGENTRYVIEW). A buffer of VXL_READ_TEXT_BUFFER_CCH
+// characters always has room for at least one entry. If TextBuffer is NULL,
+// the text of those entries is left empty, which is much faster if only the
+// other fields are wanted.
+//
+// Fewer entries than requested are read if the end of the log is reached,
+// or if TextBuffer is full. If a single entry can't be read (for example,
+// because it is corrupt), its view has a severity of LogSeverityInvalidValue
+// and the rest of the range is still read.
+//
+
+NTSTATUS NTAPI VxlReadLogRange(
+	IN		VXLHANDLE			LogHandle,
+	IN		ULONG				FirstEntryIndex,
+	IN		ULONG				NumberOfEntries,
+	OUT		PVXLLOGENTRYVIEW	Views,
+	OUT		PULONG				NumberOfEntriesRead,
+	OUT		PWSTR				TextBuffer OPTIONAL,
+	IN		ULONG				TextBufferCch)
+{
+	NTSTATUS Status;
+	PVOID FileEntries[VXL_READ_BATCH_SIZE];
+	VXLREADTEXTBUFFER ReadTextBuffer;
+	ULONG TotalNumberOfEntries;
+	ULONG BatchIndex;
+	ULONG Index;
+
+	//
+	// Parameter validation
+	//
+
+	if (!LogHandle || !Views || !NumberOfEntriesRead) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	if (!TextBuffer && TextBufferCch != 0) {
+		return STATUS_INVALID_PARAMETER_MIX;
+	}
+
+	*NumberOfEntriesRead = 0;
+
+	if (LogHandle->OpenMode != GENERIC_READ) {
+		return STATUS_INVALID_OPEN_MODE;
+	}
+
+	TotalNumberOfEntries = VxlpGetTotalLogEntryCount(LogHandle);
+
+	if (TotalNumberOfEntries == -1 || FirstEntryIndex >= TotalNumberOfEntries) {
+		return STATUS_NO_MORE_ENTRIES;
+	}
+
+	NumberOfEntries = min(NumberOfEntries, TotalNumberOfEntries - FirstEntryIndex);
+
+	ReadTextBuffer.Buffer = TextBuffer;
+	ReadTextBuffer.BufferCch = TextBufferCch;
+	ReadTextBuffer.UsedCch = 0;
+
+	for (BatchIndex = 0; BatchIndex < NumberOfEntries; BatchIndex += VXL_READ_BATCH_SIZE) {
+		ULONG BatchSize;
+
+		BatchSize = min(NumberOfEntries - BatchIndex, VXL_READ_BATCH_SIZE);
+
+		VxlpGetLogFileEntries(
+			LogHandle,
+			FirstEntryIndex + BatchIndex,
+			BatchSize,
+			FileEntries);
+
+		for (Index = 0; Index < BatchSize; ++Index) {
+			PVXLLOGENTRYVIEW View;
+
+			View = &Views[BatchIndex + Index];
+			Status = STATUS_FILE_CORRUPT_ERROR;
+
+			if (FileEntries[Index]) {
+				Status = VxlpFillLogEntryView(
+					LogHandle,
+					FileEntries[Index],
+					View,
+					TextBuffer ? &ReadTextBuffer : NULL);
+			}
+
+			if (Status == STATUS_BUFFER_OVERFLOW) {
+				// The text buffer is full. Leave the rest for next time.
+				*NumberOfEntriesRead = BatchIndex + Index;
+				return STATUS_SUCCESS;
+			}
+
+			if (!NT_SUCCESS(Status)) {
+				RtlZeroMemory(View, sizeof(*View));
+				View->Severity = LogSeverityInvalidValue;
+			}
+		}
+	}
+
+	*NumberOfEntriesRead = NumberOfEntries;
+	return STATUS_SUCCESS;
+}
+
+//
+// Read the log entries from LogEntryIndexStart to LogEntryIndexEnd, both
+// inclusive. Entry is an array of pointers to the caller's VXLLOGENTRY
+// structures. The text of deferred entries is only valid for as long as it
+// is for VxlReadLog. New code should use VxlReadLogRange instead.
+//
+
 NTSTATUS NTAPI VxlReadMultipleEntriesLog(
 	IN		VXLHANDLE		LogHandle,
 	IN		ULONG			LogEntryIndexStart,
@@ -141,6 +471,8 @@ NTSTATUS NTAPI VxlReadMultipleEntriesLog(
 	NTSTATUS Status;
 	ULONG Index;
 	ULONG MaximumIndex;
+	LONGLONG TimeZoneBias;
+	VXLTIMECACHE TimeCache;
 
 	//
 	// Parameter validation
@@ -154,6 +486,10 @@ NTSTATUS NTAPI VxlReadMultipleEntriesLog(
 		return STATUS_INVALID_PARAMETER_MIX;
 	}
 
+	if (LogHandle->OpenMode != GENERIC_READ) {
+		return STATUS_INVALID_OPEN_MODE;
+	}
+
 	MaximumIndex = VxlpGetTotalLogEntryCount(LogHandle) - 1;
 
 	if (MaximumIndex == -1) {
@@ -169,18 +505,26 @@ NTSTATUS NTAPI VxlReadMultipleEntriesLog(
 	}
 
 	//
-	// Fetch the requested log entries.
+	// Fetch the requested log entries. The time zone bias is only read once,
+	// so that all of the entries are converted the same way even if it
+	// changes in the middle.
 	//
 
-	for (Index = LogEntryIndexStart; Index < LogEntryIndexEnd; ++Index) {
-		Status = VxlpReadLogInternal(LogHandle, Index, Entry[Index - LogEntryIndexStart]);
+	TimeZoneBias = VxlpQueryTimeZoneBias();
+	VxlpInitializeTimeCache(&TimeCache);
+
+	for (Index = LogEntryIndexStart; Index <= LogEntryIndexEnd; ++Index) {
+		Status = VxlpReadLogInternal(
+			LogHandle,
+			Index,
+			TimeZoneBias,
+			&TimeCache,
+			Entry[Index - LogEntryIndexStart]);
 
 		if (!NT_SUCCESS(Status)) {
 			return Status;
 		}
-
-		++Index;
 	}
 
-	return Status;
+	return STATUS_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,532 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxlsess.c
+//
+// Abstract:
+//
+//     Session logs. A session log is a single log file which is written by
+//     a whole tree of processes, instead of every process opening its own.
+//
+//     The process which opens the log with VXL_OPEN_SESSION creates a mutant
+//     and a small shared section (VXLSESSIONDATA). VxlDuplicateSessionLog
+//     copies the file, mutant and section handles into another process,
+//     which then calls VxlJoinSessionLog to get a log handle of its own.
+//
+//     All appends to the file, in any process, are done while holding the
+//     mutant, at the committed length found in the (shared) log file header.
+//     If a process dies while holding the mutant, the mutant is abandoned,
+//     and the next writer simply overwrites whatever partial data was left
+//     past the committed length. A process which can't get the mutant for
+//     VXL_SESSION_LOCK_TIMEOUT (because another one is stuck, or holds on to
+//     it on purpose) leaves the session and writes a log file of its own.
+//
+//     Source string indices are shared by all processes in the session.
+//     Before a process defines a new string, it takes the mutant and loads
+//     any strings which the other processes have defined since it last
+//     looked, so that the indices always stay in order in the file.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                18-Oct-2026  Duplicate handles with less access, time
+//                                       out waiting for the session lock.
+//     agent                18-Oct-2026  The owner's close marks the log clean.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+
+#define ALIGN_DOWN_BY(Value, Alignment) ((Value) & ~((ULONGLONG) (Alignment) - 1))
+
+//
+// Set up the session context. If SessionHandles is NULL, a new session is
+// created. Otherwise, the handles (which must be valid in the current
+// process) are taken over by the log handle, even if this function fails.
+//
+
+NTSTATUS VxlpCreateSessionContext(
+	IN	VXLHANDLE			LogHandle,
+	IN	PCVXLSESSIONHANDLES	SessionHandles OPTIONAL)
+{
+	NTSTATUS Status;
+	PVXLSESSIONCONTEXT SessionContext;
+	LONGLONG SectionSize;
+	SIZE_T ViewSize;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->OpenMode == GENERIC_WRITE);
+	ASSERT (LogHandle->SessionContext == NULL);
+
+	SessionContext = SafeAlloc(VXLSESSIONCONTEXT, 1);
+	if (!SessionContext) {
+		if (SessionHandles) {
+			NtClose((HANDLE) (ULONG_PTR) SessionHandles->MutantHandle);
+			NtClose((HANDLE) (ULONG_PTR) SessionHandles->SectionHandle);
+		}
+
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlZeroMemory(SessionContext, sizeof(*SessionContext));
+	LogHandle->SessionContext = SessionContext;
+
+	if (SessionHandles) {
+		SessionContext->MutantHandle = (HANDLE) (ULONG_PTR) SessionHandles->MutantHandle;
+		SessionContext->SectionHandle = (HANDLE) (ULONG_PTR) SessionHandles->SectionHandle;
+	} else {
+		SessionContext->Owner = TRUE;
+
+		Status = NtCreateMutant(
+			&SessionContext->MutantHandle,
+			MUTANT_ALL_ACCESS,
+			NULL,
+			FALSE);
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+
+		SectionSize = sizeof(VXLSESSIONDATA);
+
+		Status = NtCreateSection(
+			&SessionContext->SectionHandle,
+			SECTION_MAP_READ | SECTION_MAP_WRITE,
+			NULL,
+			&SectionSize,
+			PAGE_READWRITE,
+			SEC_COMMIT,
+			NULL);
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+	}
+
+	ViewSize = 0;
+
+	Status = NtMapViewOfSection(
+		SessionContext->SectionHandle,
+		NtCurrentProcess(),
+		(PPVOID) &SessionContext->Data,
+		0,
+		0,
+		NULL,
+		&ViewSize,
+		ViewUnmap,
+		0,
+		PAGE_READWRITE);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	if (ViewSize < sizeof(VXLSESSIONDATA)) {
+		NtUnmapViewOfSection(NtCurrentProcess(), SessionContext->Data);
+		SessionContext->Data = NULL;
+		return STATUS_INVALID_VIEW_SIZE;
+	}
+
+	InterlockedIncrement(&SessionContext->Data->NumberOfWriters);
+	return STATUS_SUCCESS;
+}
+
+VOID VxlpDestroySessionContext(
+	IN	VXLHANDLE			LogHandle)
+{
+	PVXLSESSIONCONTEXT SessionContext;
+
+	ASSERT (LogHandle != NULL);
+
+	SessionContext = LogHandle->SessionContext;
+
+	if (!SessionContext) {
+		return;
+	}
+
+	if (SessionContext->Data) {
+		NtUnmapViewOfSection(NtCurrentProcess(), SessionContext->Data);
+	}
+
+	if (SessionContext->PrivateLog) {
+		VxlCloseLog((PVXLHANDLE) &SessionContext->PrivateLog);
+	}
+
+	SafeClose(SessionContext->SectionHandle);
+	SafeClose(SessionContext->MutantHandle);
+	SafeFree(LogHandle->SessionContext);
+}
+
+//
+// Once this process has left the session, its entries go to a log file of
+// its own next to the session log, named after it and our process ID. The
+// file is created the first time this is called. Returns NULL if it couldn't
+// be created (e.g. in a sandboxed process), in which case nothing more is
+// logged.
+//
+
+VXLHANDLE VxlpGetSessionPrivateLog(
+	IN	VXLHANDLE			LogHandle)
+{
+	NTSTATUS Status;
+	PVXLSESSIONCONTEXT SessionContext;
+	UNICODE_STRING SessionFileName;
+	UNICODE_STRING PrivateFileName;
+	UNICODE_STRING ProcessIdString;
+	UNICODE_STRING SourceApplication;
+	UNICODE_STRING Extension;
+	WCHAR ProcessIdBuffer[16];
+	WCHAR SourceApplicationBuffer[ARRAYSIZE(LogHandle->Header->SourceApplication)];
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	VXLHANDLE PrivateLog;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->SessionContext != NULL);
+	ASSERT (LogHandle->SessionContext->Detached);
+
+	SessionContext = LogHandle->SessionContext;
+
+	if (InterlockedExchange(&SessionContext->PrivateLogOpened, TRUE)) {
+		// Already done, or another thread is doing it right now, in which
+		// case this entry is lost.
+		return SessionContext->PrivateLog;
+	}
+
+	RtlZeroMemory(&PrivateFileName, sizeof(PrivateFileName));
+
+	Status = VxlpGetLogFileName(LogHandle, &SessionFileName);
+	if (!NT_SUCCESS(Status)) {
+		return NULL;
+	}
+
+	try {
+		// The header is shared with the other processes, so copy it out first.
+		RtlCopyMemory(SourceApplicationBuffer, LogHandle->Header->SourceApplication, sizeof(SourceApplicationBuffer));
+		SourceApplicationBuffer[ARRAYSIZE(SourceApplicationBuffer) - 1] = '\0';
+		RtlInitUnicodeString(&SourceApplication, SourceApplicationBuffer);
+
+		// e.g. "chrome-00000133428819212345678-1234.vxl" becomes
+		// "chrome-00000133428819212345678-1234-5678.vxl"
+		RtlInitConstantUnicodeString(&Extension, L".vxl");
+
+		if (KexRtlUnicodeStringEndsWith(&SessionFileName, &Extension, TRUE)) {
+			SessionFileName.Length -= Extension.Length;
+		}
+
+		RtlInitEmptyUnicodeString(&ProcessIdString, ProcessIdBuffer, sizeof(ProcessIdBuffer));
+		RtlIntegerToUnicodeString((ULONG) NtCurrentTeb()->ClientId.UniqueProcess, 10, &ProcessIdString);
+
+		PrivateFileName.MaximumLength = SessionFileName.Length + ProcessIdString.Length + 5 * sizeof(WCHAR);
+		PrivateFileName.Buffer = (PWSTR) RtlAllocateHeap(RtlProcessHeap(), 0, PrivateFileName.MaximumLength);
+
+		if (!PrivateFileName.Buffer) {
+			leave;
+		}
+
+		RtlCopyUnicodeString(&PrivateFileName, &SessionFileName);
+		RtlAppendUnicodeToString(&PrivateFileName, L"-");
+		RtlAppendUnicodeStringToString(&PrivateFileName, &ProcessIdString);
+		RtlAppendUnicodeToString(&PrivateFileName, L".vxl");
+
+		InitializeObjectAttributes(
+			&ObjectAttributes,
+			&PrivateFileName,
+			OBJ_CASE_INSENSITIVE,
+			NULL,
+			NULL);
+
+		//
+		// Keep it simple: the private log is written synchronously, so
+		// nothing needs to be flushed when the process crashes.
+		//
+
+		Status = VxlOpenLogEx(
+			&PrivateLog,
+			&SourceApplication,
+			&ObjectAttributes,
+			GENERIC_WRITE,
+			FILE_OVERWRITE_IF,
+			LogHandle->Flags & VXL_OPEN_DEFERRED_FORMATTING);
+
+		if (NT_SUCCESS(Status)) {
+			SessionContext->PrivateLog = PrivateLog;
+		}
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		NOTHING;
+	}
+
+	RtlFreeUnicodeString(&SessionFileName);
+	RtlFreeUnicodeString(&PrivateFileName);
+
+	return SessionContext->PrivateLog;
+}
+
+//
+// The session lock may be acquired recursively by the same thread. A child
+// process, which may be sandboxed and can't be trusted, could hold on to it
+// forever, so the wait is limited to VXL_SESSION_LOCK_TIMEOUT. After that,
+// this process leaves the session for good and the lock is never taken
+// again.
+//
+
+NTSTATUS VxlpAcquireSessionLock(
+	IN	VXLHANDLE			LogHandle)
+{
+	NTSTATUS Status;
+	LONGLONG Timeout;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->SessionContext != NULL);
+
+	if (LogHandle->SessionContext->Detached) {
+		return STATUS_LOCK_NOT_GRANTED;
+	}
+
+	Timeout = -(VXL_SESSION_LOCK_TIMEOUT * 10000LL);
+
+	Status = NtWaitForSingleObject(
+		LogHandle->SessionContext->MutantHandle,
+		FALSE,
+		(PLARGE_INTEGER) &Timeout);
+
+	if (Status == STATUS_ABANDONED) {
+		// Another process died while writing. Nothing past the committed
+		// length counts, so we can just carry on.
+		Status = STATUS_SUCCESS;
+	} else if (Status == STATUS_TIMEOUT) {
+		if (InterlockedExchange(&LogHandle->SessionContext->Detached, TRUE) == FALSE) {
+			DbgPrint("VXL: timed out waiting for the session log, leaving the session\r\n");
+		}
+
+		// STATUS_TIMEOUT is a success code.
+		Status = STATUS_LOCK_NOT_GRANTED;
+	}
+
+	return Status;
+}
+
+VOID VxlpReleaseSessionLock(
+	IN	VXLHANDLE			LogHandle)
+{
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->SessionContext != NULL);
+
+	NtReleaseMutant(LogHandle->SessionContext->MutantHandle, NULL);
+}
+
+//
+// Called once when the log is closed. Returns TRUE if the caller is
+// responsible for marking the log file as clean: when no other process has
+// the session log open any more, or when this process created the session.
+//
+// Children are often killed with TerminateProcess (browsers do this to their
+// renderers all the time), and never get to decrement NumberOfWriters. If
+// only the last writer could mark the log clean, it would stay dirty for
+// good. The process which created the session is normally the last to go,
+// so its close is taken as the end of the session. Any child which is still
+// writing after that keeps appending, but the log is no longer marked dirty.
+//
+
+BOOLEAN VxlpLeaveSession(
+	IN	VXLHANDLE			LogHandle)
+{
+	PVXLSESSIONCONTEXT SessionContext;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->SessionContext != NULL);
+
+	SessionContext = LogHandle->SessionContext;
+
+	if (!SessionContext->Data) {
+		// never joined
+		return FALSE;
+	}
+
+	return (InterlockedDecrement(&SessionContext->Data->NumberOfWriters) == 0 || SessionContext->Owner);
+}
+
+//
+// Load the strings which other processes have defined since we last looked.
+// Must be called with both the session lock and the source tables lock held.
+//
+
+NTSTATUS VxlpLoadSessionSourceStrings(
+	IN	VXLHANDLE			LogHandle)
+{
+	NTSTATUS Status;
+	PVXLSESSIONCONTEXT SessionContext;
+	HANDLE SectionHandle;
+	PVOID View;
+	LONGLONG ViewOffset;
+	SIZE_T ViewSize;
+	ULONGLONG StartOffset;
+	ULONGLONG EndOffset;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->SessionContext != NULL);
+
+	SessionContext = LogHandle->SessionContext;
+	StartOffset = max(SessionContext->ScannedLength, LogHandle->Header->HeaderSize);
+	EndOffset = LogHandle->Header->CommittedLength;
+
+	if (StartOffset >= EndOffset) {
+		return STATUS_SUCCESS;
+	}
+
+	//
+	// The file has grown since any section we might have had was created, so
+	// make a new one which covers the whole file as it is now.
+	//
+
+	Status = NtCreateSection(
+		&SectionHandle,
+		SECTION_MAP_READ,
+		NULL,
+		NULL,
+		PAGE_READONLY,
+		SEC_COMMIT,
+		LogHandle->FileHandle);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	View = NULL;
+	ViewOffset = ALIGN_DOWN_BY(StartOffset, VXL_MAP_VIEW_ALIGNMENT);
+	ViewSize = (SIZE_T) (EndOffset - ViewOffset);
+
+	Status = NtMapViewOfSection(
+		SectionHandle,
+		NtCurrentProcess(),
+		&View,
+		0,
+		0,
+		&ViewOffset,
+		&ViewSize,
+		ViewUnmap,
+		0,
+		PAGE_READONLY);
+
+	SafeClose(SectionHandle);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	try {
+		Status = VxlpLoadSourceStrings(
+			LogHandle,
+			View,
+			ViewOffset,
+			StartOffset,
+			EndOffset);
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	NtUnmapViewOfSection(NtCurrentProcess(), View);
+
+	if (NT_SUCCESS(Status)) {
+		SessionContext->ScannedLength = EndOffset;
+	}
+
+	return Status;
+}
+
+//
+// Duplicate the handles which another process needs in order to join a
+// session log into that process. ProcessHandle must have PROCESS_DUP_HANDLE
+// access. Pass the handles to the other process by any means, and call
+// VxlJoinSessionLog from within it.
+//
+// If the other process never joins the session, the handles are leaked
+// in that process.
+//
+
+KEXAPI NTSTATUS NTAPI VxlDuplicateSessionLog(
+	IN	VXLHANDLE			LogHandle,
+	IN	HANDLE				ProcessHandle,
+	OUT	PVXLSESSIONHANDLES	SessionHandles)
+{
+	NTSTATUS Status;
+	HANDLE SourceHandles[3];
+	HANDLE TargetHandles[3];
+	ULONG Index;
+
+	//
+	// The other process gets as little access as it needs to write to the
+	// log: no WRITE_DAC or DELETE on the file, and the mutant can only be
+	// waited on (which is also all it takes to release it).
+	//
+
+	STATIC CONST ACCESS_MASK TargetAccess[3] = {
+		FILE_GENERIC_READ | FILE_GENERIC_WRITE,
+		SYNCHRONIZE | MUTANT_QUERY_STATE,
+		SECTION_MAP_READ | SECTION_MAP_WRITE
+	};
+
+	if (!LogHandle || !ProcessHandle || !SessionHandles) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	RtlZeroMemory(SessionHandles, sizeof(*SessionHandles));
+
+	if (!LogHandle->SessionContext) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	SourceHandles[0] = LogHandle->FileHandle;
+	SourceHandles[1] = LogHandle->SessionContext->MutantHandle;
+	SourceHandles[2] = LogHandle->SessionContext->SectionHandle;
+	RtlZeroMemory(TargetHandles, sizeof(TargetHandles));
+
+	Status = STATUS_SUCCESS;
+
+	ForEachArrayItem (SourceHandles, Index) {
+		Status = NtDuplicateObject(
+			NtCurrentProcess(),
+			SourceHandles[Index],
+			ProcessHandle,
+			&TargetHandles[Index],
+			TargetAccess[Index],
+			0,
+			0);
+
+		if (!NT_SUCCESS(Status)) {
+			break;
+		}
+	}
+
+	if (!NT_SUCCESS(Status)) {
+		//
+		// Close whatever we managed to put into the other process.
+		//
+
+		ForEachArrayItem (TargetHandles, Index) {
+			if (TargetHandles[Index]) {
+				NtDuplicateObject(
+					ProcessHandle,
+					TargetHandles[Index],
+					NULL,
+					NULL,
+					0,
+					0,
+					DUPLICATE_CLOSE_SOURCE);
+			}
+		}
+
+		return Status;
+	}
+
+	SessionHandles->FileHandle = (ULONG) (ULONG_PTR) TargetHandles[0];
+	SessionHandles->MutantHandle = (ULONG) (ULONG_PTR) TargetHandles[1];
+	SessionHandles->SectionHandle = (ULONG) (ULONG_PTR) TargetHandles[2];
+
+	return STATUS_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,772 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxlsrc.c
+//
+// Abstract:
+//
+//     Source component, file and function name tables.
+//
+//     Each log entry refers to its source component, file and function by
+//     index. In write mode, the strings are looked up through a hash index,
+//     and whenever a new string is seen, a VXLLOGFILESTRING record defining
+//     it is appended to the log before the entry which uses it.
+//
+//     Since almost every log entry comes from a call site which has logged
+//     before, the indices are also cached per call site, keyed on the address
+//     of the __FUNCTIONW__ string. A cache hit does not take any locks.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Add format strings for deferred entries
+//     agent                17-Oct-2026  Never put string records into blocks
+//     agent                17-Oct-2026  Share string indices in session logs
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+
+//
+// Component indices are stored as a UCHAR in VXLLOGFILEENTRY. The others are
+// USHORT, but the hash buckets store index + 1, so one less is available.
+//
+
+STATIC CONST ULONG VxlpMaximumNumberOfSourceStrings[] = {
+	0x100,		// VxlSourceComponent
+	0xFFFF,		// VxlSourceFile
+	0xFFFF,		// VxlSourceFunction
+	0xFFFF		// VxlSourceFormat
+};
+
+STATIC CONST ULONG VxlpNoSeverityCounts[LogSeverityMaximumValue] = {0};
+
+STATIC INLINE ULONG VxlpHashSourceString(
+	IN	PCWSTR	String)
+{
+	ULONG Hash;
+
+	// FNV-1a
+	Hash = 2166136261;
+
+	while (*String) {
+		Hash ^= *String++;
+		Hash *= 16777619;
+	}
+
+	return Hash;
+}
+
+STATIC INLINE PCWSTR VxlpGetSourceStringFromTable(
+	IN	PCVXLSTRINGTABLE	Table,
+	IN	ULONG				Index)
+{
+	if (Index >= Table->NumberOfStrings) {
+		return NULL;
+	}
+
+	return Table->Pages[Index / VXL_STRING_TABLE_PAGE_SIZE][Index % VXL_STRING_TABLE_PAGE_SIZE];
+}
+
+STATIC INLINE BOOLEAN VxlpSourceStringMatches(
+	IN	PCVXLSTRINGTABLE	Table,
+	IN	ULONG				Index,
+	IN	PCWSTR				String)
+{
+	PCWSTR TableString;
+
+	TableString = VxlpGetSourceStringFromTable(Table, Index);
+
+	if (!TableString) {
+		return FALSE;
+	}
+
+	return StringEqual(TableString, String);
+}
+
+//
+// Make sure that there is room to store a string at Index, which must be
+// the next unused index. The caller must hold the lock, or be the only
+// thread with access to the tables.
+//
+
+STATIC NTSTATUS VxlpReserveSourceString(
+	IN	PVXLSTRINGTABLE		Table,
+	IN	ULONG				Index)
+{
+	PPCWSTR Page;
+
+	if (Index != Table->NumberOfStrings || Index >= Table->MaximumNumberOfStrings) {
+		return STATUS_TOO_MANY_INDICES;
+	}
+
+	Page = Table->Pages[Index / VXL_STRING_TABLE_PAGE_SIZE];
+
+	if (!Page) {
+		Page = SafeAlloc(PCWSTR, VXL_STRING_TABLE_PAGE_SIZE);
+		if (!Page) {
+			return STATUS_NO_MEMORY;
+		}
+
+		Table->Pages[Index / VXL_STRING_TABLE_PAGE_SIZE] = Page;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+STATIC VOID VxlpPublishSourceString(
+	IN	PVXLSTRINGTABLE		Table,
+	IN	ULONG				Index,
+	IN	PCWSTR				String)
+{
+	ASSERT (Index == Table->NumberOfStrings);
+	ASSERT (Table->Pages[Index / VXL_STRING_TABLE_PAGE_SIZE] != NULL);
+
+	Table->Pages[Index / VXL_STRING_TABLE_PAGE_SIZE][Index % VXL_STRING_TABLE_PAGE_SIZE] = String;
+
+	// Lock-free readers check the index against NumberOfStrings before
+	// looking at the page, so this must come last.
+	InterlockedIncrement((PLONG) &Table->NumberOfStrings);
+}
+
+STATIC VOID VxlpInsertSourceStringHash(
+	IN	PVXLSTRINGTABLE		Table,
+	IN	ULONG				Index)
+{
+	ULONG Bucket;
+
+	ASSERT (Table->NumberOfBuckets != 0);
+
+	Bucket = VxlpHashSourceString(VxlpGetSourceStringFromTable(Table, Index));
+
+	while (TRUE) {
+		Bucket &= Table->NumberOfBuckets - 1;
+
+		if (Table->Buckets[Bucket] == 0) {
+			Table->Buckets[Bucket] = (USHORT) (Index + 1);
+			break;
+		}
+
+		++Bucket;
+	}
+}
+
+//
+// Keep the hash index at most half full. It is rebuilt from scratch when
+// it grows, which is fine since this only happens a handful of times.
+//
+
+STATIC NTSTATUS VxlpGrowSourceStringHash(
+	IN	PVXLSTRINGTABLE		Table)
+{
+	PUSHORT NewBuckets;
+	PUSHORT OldBuckets;
+	ULONG NewNumberOfBuckets;
+	ULONG Index;
+
+	if ((Table->NumberOfStrings + 1) * 2 <= Table->NumberOfBuckets) {
+		return STATUS_SUCCESS;
+	}
+
+	NewNumberOfBuckets = max(64, Table->NumberOfBuckets * 2);
+	NewBuckets = SafeAlloc(USHORT, NewNumberOfBuckets);
+
+	if (!NewBuckets) {
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlZeroMemory(NewBuckets, NewNumberOfBuckets * sizeof(USHORT));
+
+	OldBuckets = Table->Buckets;
+	Table->Buckets = NewBuckets;
+	Table->NumberOfBuckets = NewNumberOfBuckets;
+
+	for (Index = 0; Index < Table->NumberOfStrings; ++Index) {
+		VxlpInsertSourceStringHash(Table, Index);
+	}
+
+	SafeFree(OldBuckets);
+	return STATUS_SUCCESS;
+}
+
+//
+// Allocate everything that is needed to add a copy of String at Index, so
+// that adding it afterwards cannot fail. Must be called with the lock held
+// exclusive.
+//
+
+STATIC NTSTATUS VxlpPrepareOwnedSourceString(
+	IN	PVXLSTRINGTABLE		Table,
+	IN	ULONG				Index,
+	IN	PCWSTR				String,
+	IN	ULONG				StringCch,
+	OUT	PPWSTR				StringCopy)
+{
+	NTSTATUS Status;
+
+	*StringCopy = NULL;
+
+	Status = VxlpReserveSourceString(Table, Index);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	Status = VxlpGrowSourceStringHash(Table);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	*StringCopy = SafeAlloc(WCHAR, StringCch);
+	if (!*StringCopy) {
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlCopyMemory(*StringCopy, String, StringCch * sizeof(WCHAR));
+	return STATUS_SUCCESS;
+}
+
+STATIC VOID VxlpAddOwnedSourceString(
+	IN	PVXLSTRINGTABLE		Table,
+	IN	ULONG				Index,
+	IN	PWSTR				StringCopy)
+{
+	VxlpPublishSourceString(Table, Index, StringCopy);
+	VxlpInsertSourceStringHash(Table, Index);
+}
+
+//
+// Must be called with the lock held (shared or exclusive).
+//
+
+STATIC BOOLEAN VxlpLookupSourceString(
+	IN	PCVXLSTRINGTABLE	Table,
+	IN	PCWSTR				String,
+	OUT	PUSHORT				Index)
+{
+	ULONG Bucket;
+
+	if (Table->NumberOfBuckets == 0) {
+		return FALSE;
+	}
+
+	Bucket = VxlpHashSourceString(String);
+
+	while (TRUE) {
+		ULONG Candidate;
+
+		Bucket &= Table->NumberOfBuckets - 1;
+		Candidate = Table->Buckets[Bucket];
+
+		if (Candidate == 0) {
+			return FALSE;
+		}
+
+		if (VxlpSourceStringMatches(Table, Candidate - 1, String)) {
+			*Index = (USHORT) (Candidate - 1);
+			return TRUE;
+		}
+
+		++Bucket;
+	}
+}
+
+//
+// Must be called with the lock held exclusive. If this is a session log,
+// the session lock must be held as well.
+//
+
+STATIC NTSTATUS VxlpCreateSourceString(
+	IN	VXLHANDLE		LogHandle,
+	IN	VXLSOURCETYPE	SourceType,
+	IN	PCWSTR			String,
+	OUT	PUSHORT			Index)
+{
+	NTSTATUS Status;
+	PVXLSTRINGTABLE Table;
+	PVXLLOGFILESTRING StringRecord;
+	PWSTR StringCopy;
+	ULONG StringCch;
+	ULONG RecordCb;
+	ULONG NewIndex;
+
+	Table = &LogHandle->SourceTables->Tables[SourceType];
+	NewIndex = Table->NumberOfStrings;
+
+	StringCch = (ULONG) wcslen(String) + 1;
+	RecordCb = sizeof(VXLLOGFILESTRING) + (StringCch * sizeof(WCHAR));
+
+	if (RecordCb > 0xFFFF) {
+		return STATUS_NAME_TOO_LONG;
+	}
+
+	Status = VxlpPrepareOwnedSourceString(Table, NewIndex, String, StringCch, &StringCopy);
+	if (!NT_SUCCESS(Status)) {
+		SafeFree(StringCopy);
+		return Status;
+	}
+
+	//
+	// Write the definition to the log before anything can refer to it.
+	// In compressed mode it goes straight to the file, ahead of the block
+	// which will contain the first entry that refers to it, so that readers
+	// can load all of the strings without decompressing anything.
+	//
+
+	StringRecord = (PVXLLOGFILESTRING) StackAlloc(BYTE, RecordCb);
+	StringRecord->RecordType = VXL_RECORD_SOURCE_STRING;
+	StringRecord->RecordSize = (USHORT) RecordCb;
+	StringRecord->SourceType = (USHORT) SourceType;
+	StringRecord->Index = (USHORT) NewIndex;
+	RtlCopyMemory(StringRecord->String, String, StringCch * sizeof(WCHAR));
+
+	Status = VxlpAppendLogFileRecords(LogHandle, StringRecord, RecordCb, VxlpNoSeverityCounts);
+	if (!NT_SUCCESS(Status)) {
+		SafeFree(StringCopy);
+		return Status;
+	}
+
+	VxlpAddOwnedSourceString(Table, NewIndex, StringCopy);
+
+	*Index = (USHORT) NewIndex;
+	return STATUS_SUCCESS;
+}
+
+//
+// Must be called with the lock held exclusive.
+//
+
+STATIC NTSTATUS VxlpFindOrCreateSourceString(
+	IN	VXLHANDLE		LogHandle,
+	IN	VXLSOURCETYPE	SourceType,
+	IN	PCWSTR			String,
+	OUT	PUSHORT			Index)
+{
+	NTSTATUS Status;
+	PCVXLSTRINGTABLE Table;
+
+	Table = &LogHandle->SourceTables->Tables[SourceType];
+
+	if (VxlpLookupSourceString(Table, String, Index)) {
+		return STATUS_SUCCESS;
+	}
+
+	unless (LogHandle->SessionContext) {
+		return VxlpCreateSourceString(LogHandle, SourceType, String, Index);
+	}
+
+	//
+	// In a session log, another process may already have defined this
+	// string, and in any case the next free index depends on what the other
+	// processes have done. Catch up with the file while holding the session
+	// lock, so that nobody else can define anything in the meantime.
+	//
+
+	Status = VxlpAcquireSessionLock(LogHandle);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	try {
+		Status = VxlpLoadSessionSourceStrings(LogHandle);
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		if (VxlpLookupSourceString(Table, String, Index)) {
+			Status = STATUS_SUCCESS;
+			leave;
+		}
+
+		Status = VxlpCreateSourceString(LogHandle, SourceType, String, Index);
+	} finally {
+		VxlpReleaseSessionLock(LogHandle);
+	}
+
+	return Status;
+}
+
+//
+// Fill out the source component, file and function indices of a log file
+// entry, adding any strings that have not been seen before.
+//
+
+NTSTATUS VxlpFindOrCreateSourceIndices(
+	IN	VXLHANDLE			LogHandle,
+	IN	PCWSTR				SourceComponent,
+	IN	PCWSTR				SourceFile,
+	IN	PCWSTR				SourceFunction,
+	OUT	PVXLLOGFILEENTRY	FileEntry)
+{
+	NTSTATUS Status;
+	PVXLSOURCETABLES SourceTables;
+	PVXLCALLSITE CallSite;
+	USHORT SourceComponentIndex;
+	USHORT SourceFileIndex;
+	USHORT SourceFunctionIndex;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->SourceTables != NULL);
+	ASSERT (SourceComponent != NULL);
+	ASSERT (SourceFile != NULL);
+	ASSERT (SourceFunction != NULL);
+	ASSERT (FileEntry != NULL);
+
+	SourceTables = LogHandle->SourceTables;
+	CallSite = &SourceTables->CallSiteCache[
+		((ULONG_PTR) SourceFunction >> 1) & (VXL_CALL_SITE_CACHE_SIZE - 1)];
+
+	//
+	// Fast path. The cached indices are only trusted if the strings they
+	// refer to are still equal to what we were passed, because the caller
+	// is not required to use constant strings. This also makes it harmless
+	// if another thread updates the cache entry while we are reading it.
+	//
+
+	if (CallSite->SourceFunction == SourceFunction) {
+		SourceComponentIndex = CallSite->SourceComponentIndex;
+		SourceFileIndex = CallSite->SourceFileIndex;
+		SourceFunctionIndex = CallSite->SourceFunctionIndex;
+
+		if (VxlpSourceStringMatches(&SourceTables->Tables[VxlSourceFunction], SourceFunctionIndex, SourceFunction) &&
+			VxlpSourceStringMatches(&SourceTables->Tables[VxlSourceFile], SourceFileIndex, SourceFile) &&
+			VxlpSourceStringMatches(&SourceTables->Tables[VxlSourceComponent], SourceComponentIndex, SourceComponent)) {
+
+			FileEntry->SourceComponentIndex = (UCHAR) SourceComponentIndex;
+			FileEntry->SourceFileIndex = SourceFileIndex;
+			FileEntry->SourceFunctionIndex = SourceFunctionIndex;
+			return STATUS_SUCCESS;
+		}
+	}
+
+	//
+	// Slow path.
+	//
+
+	RtlAcquireSRWLockExclusive(&SourceTables->Lock);
+
+	try {
+		Status = VxlpFindOrCreateSourceString(
+			LogHandle,
+			VxlSourceComponent,
+			SourceComponent,
+			&SourceComponentIndex);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		Status = VxlpFindOrCreateSourceString(
+			LogHandle,
+			VxlSourceFile,
+			SourceFile,
+			&SourceFileIndex);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		Status = VxlpFindOrCreateSourceString(
+			LogHandle,
+			VxlSourceFunction,
+			SourceFunction,
+			&SourceFunctionIndex);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		CallSite->SourceFunction = SourceFunction;
+		CallSite->SourceComponentIndex = SourceComponentIndex;
+		CallSite->SourceFileIndex = SourceFileIndex;
+		CallSite->SourceFunctionIndex = SourceFunctionIndex;
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	RtlReleaseSRWLockExclusive(&SourceTables->Lock);
+
+	if (NT_SUCCESS(Status)) {
+		FileEntry->SourceComponentIndex = (UCHAR) SourceComponentIndex;
+		FileEntry->SourceFileIndex = SourceFileIndex;
+		FileEntry->SourceFunctionIndex = SourceFunctionIndex;
+	}
+
+	return Status;
+}
+
+//
+// When appending to an existing log file, the strings that it already
+// defines must be loaded so that they are not defined a second time.
+// FileData is a view of the file starting at FileDataOffset, which covers
+// everything from StartOffset to EndOffset. StartOffset must be the offset
+// of a record. Strings which are already in the tables are skipped.
+//
+
+NTSTATUS VxlpLoadSourceStrings(
+	IN	VXLHANDLE	LogHandle,
+	IN	PCVOID		FileData,
+	IN	ULONGLONG	FileDataOffset,
+	IN	ULONGLONG	StartOffset,
+	IN	ULONGLONG	EndOffset)
+{
+	NTSTATUS Status;
+	PVXLSTRINGTABLE Table;
+	PWSTR StringCopy;
+	ULONGLONG Offset;
+	ULONGLONG EndOfData;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->SourceTables != NULL);
+	ASSERT (LogHandle->SourceTables->OwnsStrings);
+	ASSERT (FileData != NULL);
+	ASSERT (StartOffset >= FileDataOffset);
+
+	Offset = StartOffset;
+	EndOfData = EndOffset;
+
+	while (Offset + sizeof(VXLLOGFILERECORD) <= EndOfData) {
+		PCVXLLOGFILERECORD Record;
+		PCVXLLOGFILESTRING StringRecord;
+		ULONG StringCch;
+
+		Record = (PCVXLLOGFILERECORD) RVA_TO_VA(FileData, (ULONG_PTR) (Offset - FileDataOffset));
+
+		if (Record->RecordSize < sizeof(VXLLOGFILERECORD) ||
+			Offset + Record->RecordSize > EndOfData) {
+
+			return STATUS_FILE_CORRUPT_ERROR;
+		}
+
+		Offset += Record->RecordSize;
+
+		if (Record->RecordType != VXL_RECORD_SOURCE_STRING) {
+			continue;
+		}
+
+		StringRecord = (PCVXLLOGFILESTRING) Record;
+		StringCch = (Record->RecordSize - sizeof(VXLLOGFILESTRING)) / sizeof(WCHAR);
+
+		if (Record->RecordSize < sizeof(VXLLOGFILESTRING) + sizeof(WCHAR) ||
+			StringRecord->String[StringCch - 1] != '\0') {
+
+			return STATUS_FILE_CORRUPT_ERROR;
+		}
+
+		if (StringRecord->SourceType >= VxlSourceMaximum) {
+			continue;
+		}
+
+		Table = &LogHandle->SourceTables->Tables[StringRecord->SourceType];
+
+		if (StringRecord->Index < Table->NumberOfStrings) {
+			// Already known. In a session log, this happens with strings
+			// which we defined ourselves.
+			continue;
+		}
+
+		Status = VxlpPrepareOwnedSourceString(
+			Table,
+			StringRecord->Index,
+			StringRecord->String,
+			StringCch,
+			&StringCopy);
+
+		if (!NT_SUCCESS(Status)) {
+			SafeFree(StringCopy);
+			return Status;
+		}
+
+		VxlpAddOwnedSourceString(Table, StringRecord->Index, StringCopy);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Find the index of a format string for a deferred log entry, adding it if
+// it has not been seen before. Works the same way as the call site cache
+// above, except that it is keyed on the address of the format string.
+//
+
+NTSTATUS VxlpFindOrCreateFormatIndex(
+	IN	VXLHANDLE	LogHandle,
+	IN	PCWSTR		Format,
+	OUT	PUSHORT		FormatIndex)
+{
+	NTSTATUS Status;
+	PVXLSOURCETABLES SourceTables;
+	PVXLFORMATCACHEENTRY CacheEntry;
+	USHORT Index;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->SourceTables != NULL);
+	ASSERT (Format != NULL);
+	ASSERT (FormatIndex != NULL);
+
+	SourceTables = LogHandle->SourceTables;
+	CacheEntry = &SourceTables->FormatCache[
+		((ULONG_PTR) Format >> 1) & (VXL_CALL_SITE_CACHE_SIZE - 1)];
+
+	if (CacheEntry->Format == Format) {
+		Index = CacheEntry->FormatIndex;
+
+		if (VxlpSourceStringMatches(&SourceTables->Tables[VxlSourceFormat], Index, Format)) {
+			*FormatIndex = Index;
+			return STATUS_SUCCESS;
+		}
+	}
+
+	RtlAcquireSRWLockExclusive(&SourceTables->Lock);
+
+	try {
+		Status = VxlpFindOrCreateSourceString(
+			LogHandle,
+			VxlSourceFormat,
+			Format,
+			&Index);
+
+		if (NT_SUCCESS(Status)) {
+			CacheEntry->Format = Format;
+			CacheEntry->FormatIndex = Index;
+		}
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	RtlReleaseSRWLockExclusive(&SourceTables->Lock);
+
+	if (NT_SUCCESS(Status)) {
+		*FormatIndex = Index;
+	}
+
+	return Status;
+}
+
+//
+// Used when reading a log file. String must stay valid until the log is
+// closed (normally it points into the mapped file).
+//
+
+NTSTATUS VxlpAddSourceString(
+	IN	VXLHANDLE		LogHandle,
+	IN	VXLSOURCETYPE	SourceType,
+	IN	ULONG			Index,
+	IN	PCWSTR			String)
+{
+	NTSTATUS Status;
+	PVXLSTRINGTABLE Table;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->SourceTables != NULL);
+	ASSERT (!LogHandle->SourceTables->OwnsStrings);
+	ASSERT (String != NULL);
+
+	if (SourceType < 0 || SourceType >= VxlSourceMaximum) {
+		// Don't fail - a later version might add more source types.
+		return STATUS_SUCCESS;
+	}
+
+	Table = &LogHandle->SourceTables->Tables[SourceType];
+
+	Status = VxlpReserveSourceString(Table, Index);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	VxlpPublishSourceString(Table, Index, String);
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS VxlpCreateSourceTables(
+	IN	VXLHANDLE	LogHandle)
+{
+	PVXLSOURCETABLES SourceTables;
+	ULONG Index;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->SourceTables == NULL);
+
+	SourceTables = SafeAlloc(VXLSOURCETABLES, 1);
+	if (!SourceTables) {
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlZeroMemory(SourceTables, sizeof(*SourceTables));
+	RtlInitializeSRWLock(&SourceTables->Lock);
+	SourceTables->OwnsStrings = (LogHandle->OpenMode == GENERIC_WRITE);
+
+	ForEachArrayItem (SourceTables->Tables, Index) {
+		SourceTables->Tables[Index].MaximumNumberOfStrings = VxlpMaximumNumberOfSourceStrings[Index];
+	}
+
+	LogHandle->SourceTables = SourceTables;
+	return STATUS_SUCCESS;
+}
+
+VOID VxlpDestroySourceTables(
+	IN	VXLHANDLE	LogHandle)
+{
+	PVXLSOURCETABLES SourceTables;
+	ULONG TableIndex;
+
+	ASSERT (LogHandle != NULL);
+
+	SourceTables = LogHandle->SourceTables;
+
+	if (!SourceTables) {
+		return;
+	}
+
+	ForEachArrayItem (SourceTables->Tables, TableIndex) {
+		PVXLSTRINGTABLE Table;
+		ULONG Index;
+
+		Table = &SourceTables->Tables[TableIndex];
+
+		if (SourceTables->OwnsStrings) {
+			for (Index = 0; Index < Table->NumberOfStrings; ++Index) {
+				PWSTR String;
+
+				String = (PWSTR) VxlpGetSourceStringFromTable(Table, Index);
+				SafeFree(String);
+			}
+		}
+
+		ForEachArrayItem (Table->Pages, Index) {
+			SafeFree(Table->Pages[Index]);
+		}
+
+		SafeFree(Table->Buckets);
+	}
+
+	SafeFree(LogHandle->SourceTables);
+}
+
+//
+// Retrieve the name of a source component, file or function, given the
+// index found in a VXLLOGENTRY structure.
+//
+// Returns NULL if Index is not valid. The returned string remains valid
+// until the log is closed.
+//
+PCWSTR NTAPI VxlGetSourceString(
+	IN	VXLHANDLE		LogHandle,
+	IN	VXLSOURCETYPE	SourceType,
+	IN	ULONG			Index)
+{
+	if (!LogHandle || !LogHandle->SourceTables) {
+		return NULL;
+	}
+
+	if (SourceType < 0 || SourceType >= VxlSourceMaximum) {
+		return NULL;
+	}
+
+	return VxlpGetSourceStringFromTable(&LogHandle->SourceTables->Tables[SourceType], Index);
+}
\ No newline at end of file
@@ -0,0 +1,439 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxltail.c
+//
+// Abstract:
+//
+//     Following a log which is still being written to (VXL_OPEN_FOLLOW).
+//
+//     A reader normally only sees the entries which were in the log when it
+//     was opened. VxlWaitForNewEntries looks at the committed length in the
+//     log file header, which writers update after each append, and indexes
+//     whatever has been added since (see VxlpIndexNewRecords in vxlindex.c).
+//
+//     Once the file has grown past the end of the view which the reader has
+//     mapped, the whole file is mapped again. Old views stay mapped until the
+//     log is closed, since the text of entries which have already been read
+//     points into them.
+//
+//     A change notification on the directory which contains the log wakes up
+//     waiters early. It isn't reliable on its own, because writers in mapped
+//     mode don't cause one for every append, so the header is also checked
+//     every VXL_FOLLOW_POLL_INTERVAL milliseconds.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+
+//
+// Open the directory which contains the log, for change notifications.
+// Following still works without them, so failure isn't fatal.
+//
+
+STATIC VOID VxlpOpenLogDirectory(
+	IN	VXLHANDLE			LogHandle)
+{
+	NTSTATUS Status;
+	PVXLFOLLOWCONTEXT FollowContext;
+	UNICODE_STRING DirectoryName;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	IO_STATUS_BLOCK IoStatusBlock;
+
+	FollowContext = LogHandle->FollowContext;
+
+	Status = VxlpGetLogFileName(LogHandle, &DirectoryName);
+	if (!NT_SUCCESS(Status)) {
+		return;
+	}
+
+	// cut the name down to the last backslash
+	while (DirectoryName.Length != 0 &&
+		   DirectoryName.Buffer[DirectoryName.Length / sizeof(WCHAR) - 1] != '\\') {
+
+		DirectoryName.Length -= sizeof(WCHAR);
+	}
+
+	if (DirectoryName.Length > sizeof(WCHAR)) {
+		InitializeObjectAttributes(
+			&ObjectAttributes,
+			&DirectoryName,
+			OBJ_CASE_INSENSITIVE,
+			NULL,
+			NULL);
+
+		Status = NtOpenFile(
+			&FollowContext->DirectoryHandle,
+			FILE_LIST_DIRECTORY,
+			&ObjectAttributes,
+			&IoStatusBlock,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			FILE_DIRECTORY_FILE);
+
+		if (!NT_SUCCESS(Status)) {
+			FollowContext->DirectoryHandle = NULL;
+		}
+	}
+
+	RtlFreeUnicodeString(&DirectoryName);
+
+	if (!FollowContext->DirectoryHandle) {
+		return;
+	}
+
+	Status = NtCreateEvent(
+		&FollowContext->ChangeEvent,
+		EVENT_ALL_ACCESS,
+		NULL,
+		NotificationEvent,
+		FALSE);
+
+	if (!NT_SUCCESS(Status)) {
+		FollowContext->ChangeEvent = NULL;
+		SafeClose(FollowContext->DirectoryHandle);
+	}
+}
+
+NTSTATUS VxlpCreateFollowContext(
+	IN	VXLHANDLE			LogHandle,
+	IN	SIZE_T				MappedLength)
+{
+	PVXLFOLLOWCONTEXT FollowContext;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->OpenMode == GENERIC_READ);
+	ASSERT (LogHandle->FollowContext == NULL);
+
+	FollowContext = SafeAlloc(VXLFOLLOWCONTEXT, 1);
+	if (!FollowContext) {
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlZeroMemory(FollowContext, sizeof(*FollowContext));
+	FollowContext->MappedLength = MappedLength;
+	LogHandle->FollowContext = FollowContext;
+
+	VxlpOpenLogDirectory(LogHandle);
+	return STATUS_SUCCESS;
+}
+
+VOID VxlpDestroyFollowContext(
+	IN	VXLHANDLE			LogHandle)
+{
+	PVXLFOLLOWCONTEXT FollowContext;
+	ULONG Index;
+
+	ASSERT (LogHandle != NULL);
+
+	FollowContext = LogHandle->FollowContext;
+
+	if (!FollowContext) {
+		return;
+	}
+
+	if (FollowContext->DirectoryHandle) {
+		SafeClose(FollowContext->DirectoryHandle);
+
+		if (FollowContext->NotificationPending) {
+			LONGLONG Timeout;
+
+			//
+			// Closing the directory cancels the notification, but it may
+			// not have finished writing to IoStatusBlock yet.
+			//
+
+			Timeout = -(1000 * 10000LL);
+			NtWaitForSingleObject(FollowContext->ChangeEvent, FALSE, (PLARGE_INTEGER) &Timeout);
+		}
+	}
+
+	SafeClose(FollowContext->ChangeEvent);
+
+	for (Index = 0; Index < FollowContext->NumberOfRetiredViews; ++Index) {
+		NtUnmapViewOfSection(NtCurrentProcess(), FollowContext->RetiredViews[Index]);
+	}
+
+	SafeFree(FollowContext->RetiredViews);
+	SafeFree(LogHandle->FollowContext);
+}
+
+//
+// Map the whole log file again, now that it has grown past the end of the
+// current view. Must be called with the lock held exclusive.
+//
+
+STATIC NTSTATUS VxlpRemapLogFile(
+	IN	VXLHANDLE			LogHandle,
+	IN	ULONGLONG			CommittedLength)
+{
+	NTSTATUS Status;
+	PVXLFOLLOWCONTEXT FollowContext;
+	HANDLE SectionHandle;
+	PVOID View;
+	SIZE_T ViewSize;
+	PPVOID RetiredViews;
+
+	FollowContext = LogHandle->FollowContext;
+
+	Status = NtCreateSection(
+		&SectionHandle,
+		SECTION_MAP_READ,
+		NULL,
+		NULL,
+		PAGE_READONLY,
+		SEC_COMMIT,
+		LogHandle->FileHandle);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	View = NULL;
+	ViewSize = 0;
+
+	Status = NtMapViewOfSection(
+		SectionHandle,
+		NtCurrentProcess(),
+		&View,
+		0,
+		0,
+		NULL,
+		&ViewSize,
+		ViewUnmap,
+		0,
+		PAGE_READONLY);
+
+	SafeClose(SectionHandle);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	if (ViewSize < CommittedLength) {
+		// file was truncated
+		NtUnmapViewOfSection(NtCurrentProcess(), View);
+		return STATUS_FILE_CORRUPT_ERROR;
+	}
+
+	if (FollowContext->RetiredViews) {
+		RetiredViews = SafeReAlloc(FollowContext->RetiredViews, PVOID, FollowContext->NumberOfRetiredViews + 1);
+	} else {
+		RetiredViews = SafeAlloc(PVOID, 1);
+	}
+
+	if (!RetiredViews) {
+		NtUnmapViewOfSection(NtCurrentProcess(), View);
+		return STATUS_NO_MEMORY;
+	}
+
+	RetiredViews[FollowContext->NumberOfRetiredViews++] = LogHandle->MappedSection;
+	FollowContext->RetiredViews = RetiredViews;
+	FollowContext->MappedLength = ViewSize;
+	LogHandle->MappedSection = View;
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Index any entries which have been committed to the log since it was
+// last looked at.
+//
+
+STATIC NTSTATUS VxlpFollowLog(
+	IN	VXLHANDLE			LogHandle)
+{
+	NTSTATUS Status;
+	PVXLINDEXCONTEXT IndexContext;
+	ULONGLONG CommittedLength;
+	ULONG MaximumNumberOfEntries;
+	ULONG Index;
+
+	IndexContext = LogHandle->IndexContext;
+
+	Status = VxlpCompleteIndex(LogHandle);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	if (LogHandle->Header->CommittedLength <= IndexContext->CommittedLength) {
+		// nothing new
+		return STATUS_SUCCESS;
+	}
+
+	RtlAcquireSRWLockExclusive(&LogHandle->Lock);
+
+	try {
+		//
+		// The committed length has to be read before the entry counts (see
+		// VxlpCreateIndexContext).
+		//
+
+		CommittedLength = LogHandle->Header->CommittedLength;
+		MemoryBarrier();
+		MaximumNumberOfEntries = 0;
+
+		ForEachArrayItem (LogHandle->Header->EventSeverityTypeCount, Index) {
+			MaximumNumberOfEntries += LogHandle->Header->EventSeverityTypeCount[Index];
+		}
+
+		if (CommittedLength > LogHandle->FollowContext->MappedLength) {
+			Status = VxlpRemapLogFile(LogHandle, CommittedLength);
+			if (!NT_SUCCESS(Status)) {
+				leave;
+			}
+		}
+
+		Status = VxlpIndexNewRecords(LogHandle, CommittedLength, MaximumNumberOfEntries);
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	RtlReleaseSRWLockExclusive(&LogHandle->Lock);
+	return Status;
+}
+
+//
+// Ask to be told when something in the log's directory changes, unless
+// that has already been done.
+//
+
+STATIC VOID VxlpArmChangeNotification(
+	IN	VXLHANDLE			LogHandle)
+{
+	NTSTATUS Status;
+	PVXLFOLLOWCONTEXT FollowContext;
+
+	FollowContext = LogHandle->FollowContext;
+
+	if (!FollowContext->DirectoryHandle) {
+		return;
+	}
+
+	if (InterlockedCompareExchange(&FollowContext->NotificationPending, TRUE, FALSE) != FALSE) {
+		return;
+	}
+
+	// This also resets ChangeEvent.
+	Status = NtNotifyChangeDirectoryFile(
+		FollowContext->DirectoryHandle,
+		FollowContext->ChangeEvent,
+		NULL,
+		NULL,
+		&FollowContext->IoStatusBlock,
+		FollowContext->NotifyBuffer,
+		sizeof(FollowContext->NotifyBuffer),
+		FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE,
+		FALSE);
+
+	if (Status != STATUS_PENDING) {
+		InterlockedExchange(&FollowContext->NotificationPending, FALSE);
+	}
+}
+
+//
+// Wait until the log contains more than NumberOfKnownEntries entries, and
+// make the new entries available to VxlReadLog. The log must have been
+// opened with VXL_OPEN_FOLLOW.
+//
+// Timeout
+//   Same as for NtWaitForSingleObject: negative values are relative, in
+//   100ns units, and positive values are absolute system times. If NULL,
+//   wait forever. A zero timeout picks up any new entries without waiting.
+//
+// NumberOfEntries
+//   Receives the number of entries in the log, which is also returned by
+//   LogTotalNumberOfEvents from now on. Filled in even on timeout.
+//
+// Returns STATUS_TIMEOUT if there were no new entries in time.
+//
+
+KEXAPI NTSTATUS NTAPI VxlWaitForNewEntries(
+	IN		VXLHANDLE		LogHandle,
+	IN		ULONG			NumberOfKnownEntries,
+	IN		PLARGE_INTEGER	Timeout OPTIONAL,
+	OUT		PULONG			NumberOfEntries OPTIONAL)
+{
+	NTSTATUS Status;
+	PVXLFOLLOWCONTEXT FollowContext;
+	LONGLONG Deadline;
+	LONGLONG CurrentTime;
+
+	if (NumberOfEntries) {
+		*NumberOfEntries = 0;
+	}
+
+	if (!LogHandle) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	FollowContext = LogHandle->FollowContext;
+
+	if (!FollowContext) {
+		return STATUS_INVALID_OPEN_MODE;
+	}
+
+	Deadline = 0;
+
+	if (Timeout) {
+		if (Timeout->QuadPart <= 0) {
+			NtQuerySystemTime(&Deadline);
+			Deadline -= Timeout->QuadPart;
+		} else {
+			Deadline = Timeout->QuadPart;
+		}
+	}
+
+	while (TRUE) {
+		LONGLONG WaitTime;
+
+		Status = VxlpFollowLog(LogHandle);
+		if (!NT_SUCCESS(Status)) {
+			break;
+		}
+
+		if (LogHandle->IndexContext->NumberOfEntries > NumberOfKnownEntries) {
+			break;
+		}
+
+		WaitTime = -(VXL_FOLLOW_POLL_INTERVAL * 10000LL);
+
+		if (Timeout) {
+			NtQuerySystemTime(&CurrentTime);
+
+			if (CurrentTime >= Deadline) {
+				Status = STATUS_TIMEOUT;
+				break;
+			}
+
+			WaitTime = max(WaitTime, CurrentTime - Deadline);
+		}
+
+		VxlpArmChangeNotification(LogHandle);
+
+		if (FollowContext->NotificationPending) {
+			Status = NtWaitForSingleObject(FollowContext->ChangeEvent, FALSE, (PLARGE_INTEGER) &WaitTime);
+
+			if (Status == STATUS_WAIT_0) {
+				InterlockedExchange(&FollowContext->NotificationPending, FALSE);
+			}
+		} else {
+			NtDelayExecution(FALSE, &WaitTime);
+		}
+	}
+
+	if (NumberOfEntries) {
+		*NumberOfEntries = LogHandle->IndexContext->NumberOfEntries;
+	}
+
+	return Status;
+}
\ No newline at end of file
@@ -0,0 +1,943 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxltext.c
+//
+// Abstract:
+//
+//     Trigram index of the text of a log, for log files opened with
+//     VXL_OPEN_TEXT_INDEX.
+//
+//     Searching for text in a large log means looking at the text of every
+//     entry. The text index narrows this down: the only entries which can
+//     contain a piece of text are the ones which contain all of its trigrams,
+//     so the lists of entries for each trigram are intersected, and only the
+//     entries that are left over need to be looked at.
+//
+//     The index is built by a background thread once the log has been
+//     opened, and saved to a .vxlt file next to the log. The next time the
+//     log is opened, the .vxlt file is mapped and used straight away, if the
+//     log has not changed since. See kexdllp.h for the layout of the index.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//     agent                17-Oct-2026  Format deferred text into a buffer of our own.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "buildcfg.h"
+#include "kexdllp.h"
+
+STATIC CONST CHAR VXLT_MAGIC[] = {'V','X','L','T'};
+
+typedef struct _VXLTEXTINDEXBUILDER {
+	PULONG					BucketOffsets;
+	PBYTE					Postings;
+	PULONG					BucketSizes;			// bytes of postings (pass 1) or bytes written (pass 2)
+	PULONG					LastEntry;				// index plus one of the last entry added to each bucket
+	PWSTR					TextBuffer;				// VXL_READ_TEXT_BUFFER_CCH, for deferred entries
+	BOOLEAN					CountOnly;				// pass 1 only works out how big the buckets are
+} TYPEDEF_TYPE_NAME(VXLTEXTINDEXBUILDER);
+
+//
+// Case folding for the index. Everything outside ASCII is lumped together,
+// since the case insensitive searches in VxlView fold more than ASCII and
+// the index must never leave out an entry that one of them would find.
+//
+#define VxlpFoldIndexChar(Char) (((Char) >= 0x80) ? 0x80 : ToUpper(Char))
+
+STATIC FORCEINLINE ULONG VxlpTrigramBucket(
+	IN	PCWCHAR	Trigram)
+{
+	ULONG Hash;
+
+	Hash = VxlpFoldIndexChar(Trigram[0]) * 0x9E3779B1;
+	Hash = (Hash ^ VxlpFoldIndexChar(Trigram[1])) * 0x85EBCA77;
+	Hash = (Hash ^ VxlpFoldIndexChar(Trigram[2])) * 0xC2B2AE3D;
+
+	return Hash >> (32 - VXL_TEXT_INDEX_BUCKET_BITS);
+}
+
+STATIC FORCEINLINE ULONG VxlpPostingCb(
+	IN	ULONG	Value)
+{
+	ULONG Cb;
+
+	for (Cb = 1; Value >= 0x80; ++Cb) {
+		Value >>= 7;
+	}
+
+	return Cb;
+}
+
+//
+// Read one posting. Returns FALSE if it runs past End.
+//
+
+STATIC FORCEINLINE BOOLEAN VxlpReadPosting(
+	IN OUT	PCBYTE	*Position,
+	IN		PCBYTE	End,
+	OUT		PULONG	Value)
+{
+	ULONG Shift;
+
+	*Value = 0;
+
+	for (Shift = 0; Shift < 32; Shift += 7) {
+		BYTE Byte;
+
+		if (*Position >= End) {
+			return FALSE;
+		}
+
+		Byte = *(*Position)++;
+		*Value |= (Byte & 0x7F) << Shift;
+
+		unless (Byte & 0x80) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+//
+// Get the NT name of the .vxlt file for a log, which is the name of the log
+// file with a "t" on the end. Free with RtlFreeUnicodeString.
+//
+
+STATIC NTSTATUS VxlpGetTextIndexFileName(
+	IN	VXLHANDLE			LogHandle,
+	OUT	PUNICODE_STRING		TextIndexFileName)
+{
+	NTSTATUS Status;
+
+	Status = VxlpGetLogFileName(LogHandle, TextIndexFileName);
+
+	if (NT_SUCCESS(Status)) {
+		TextIndexFileName->Buffer[TextIndexFileName->Length / sizeof(WCHAR)] = 't';
+		TextIndexFileName->Length += sizeof(WCHAR);
+	}
+
+	return Status;
+}
+
+//
+// Add the trigrams of one string of an entry to the index. Entries must be
+// added in order.
+//
+
+STATIC NTSTATUS VxlpAddTextToIndex(
+	IN	PVXLTEXTINDEXBUILDER	Builder,
+	IN	ULONG					EntryIndex,
+	IN	PCUNICODE_STRING		Text)
+{
+	ULONG TextCch;
+	ULONG Index;
+
+	TextCch = KexRtlUnicodeStringCch(Text);
+
+	for (Index = 0; Index + 2 < TextCch; ++Index) {
+		ULONG Bucket;
+		ULONG Value;
+		ULONG Cb;
+
+		Bucket = VxlpTrigramBucket(&Text->Buffer[Index]);
+
+		if (Builder->LastEntry[Bucket] == EntryIndex + 1) {
+			// already in there
+			continue;
+		}
+
+		Value = EntryIndex + 1 - Builder->LastEntry[Bucket];
+		Cb = VxlpPostingCb(Value);
+		Builder->LastEntry[Bucket] = EntryIndex + 1;
+
+		if (Builder->CountOnly) {
+			if (Builder->BucketSizes[Bucket] + Cb < Builder->BucketSizes[Bucket]) {
+				return STATUS_INSUFFICIENT_RESOURCES;
+			}
+
+			Builder->BucketSizes[Bucket] += Cb;
+		} else {
+			PBYTE Position;
+
+			// The log must have given back the same text both times.
+			if (Builder->BucketOffsets[Bucket] + Builder->BucketSizes[Bucket] + Cb >
+				Builder->BucketOffsets[Bucket + 1]) {
+
+				return STATUS_INTERNAL_ERROR;
+			}
+
+			Position = &Builder->Postings[Builder->BucketOffsets[Bucket] + Builder->BucketSizes[Bucket]];
+			Builder->BucketSizes[Bucket] += Cb;
+
+			while (Value >= 0x80) {
+				*Position++ = (BYTE) (Value | 0x80);
+				Value >>= 7;
+			}
+
+			*Position = (BYTE) Value;
+		}
+	}
+
+	return STATUS_SUCCESS;
+}
+
+STATIC NTSTATUS VxlpAddEntriesToIndex(
+	IN	VXLHANDLE				LogHandle,
+	IN	PVXLTEXTINDEXBUILDER	Builder,
+	IN	ULONG					NumberOfEntries)
+{
+	NTSTATUS Status;
+	VXLLOGENTRYVIEW Views[64];
+	ULONG NumberOfViews;
+	ULONG EntryIndex;
+	ULONG Index;
+
+	RtlZeroMemory(Builder->LastEntry, VXL_TEXT_INDEX_NUMBER_OF_BUCKETS * sizeof(ULONG));
+	RtlZeroMemory(Builder->BucketSizes, VXL_TEXT_INDEX_NUMBER_OF_BUCKETS * sizeof(ULONG));
+
+	for (EntryIndex = 0; EntryIndex < NumberOfEntries; EntryIndex += NumberOfViews) {
+		if ((EntryIndex & 255) == 0 && LogHandle->TextIndexContext->ShutdownRequested) {
+			return STATUS_CANCELLED;
+		}
+
+		Status = VxlReadLogRange(
+			LogHandle,
+			EntryIndex,
+			min(NumberOfEntries - EntryIndex, ARRAYSIZE(Views)),
+			Views,
+			&NumberOfViews,
+			Builder->TextBuffer,
+			VXL_READ_TEXT_BUFFER_CCH);
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+
+		for (Index = 0; Index < NumberOfViews; ++Index) {
+			if (Views[Index].Severity == LogSeverityInvalidValue) {
+				// can't be read, so nobody will be looking for it either
+				continue;
+			}
+
+			Status = VxlpAddTextToIndex(Builder, EntryIndex + Index, &Views[Index].TextHeader);
+			if (!NT_SUCCESS(Status)) {
+				return Status;
+			}
+
+			if (Views[Index].Text.Buffer) {
+				Status = VxlpAddTextToIndex(Builder, EntryIndex + Index, &Views[Index].Text);
+				if (!NT_SUCCESS(Status)) {
+					return Status;
+				}
+			}
+		}
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Save a newly built index to a .vxlt file. Failure doesn't matter, it only
+// means that the index has to be built again next time.
+//
+
+STATIC VOID VxlpWriteTextIndexFile(
+	IN	VXLHANDLE				LogHandle,
+	IN	PCVXLTEXTINDEXHEADER	TextIndex,
+	IN	ULONG					TextIndexCb)
+{
+	NTSTATUS Status;
+	UNICODE_STRING TextIndexFileName;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	IO_STATUS_BLOCK IoStatusBlock;
+	HANDLE TextIndexFileHandle;
+	LONGLONG ByteOffset;
+
+	if (TextIndex->NumberOfEntries < VXL_TEXT_INDEX_MINIMUM_ENTRIES) {
+		return;
+	}
+
+	if (LogHandle->Header->Dirty) {
+		// Still being written to, or the writer crashed.
+		return;
+	}
+
+	Status = VxlpGetTextIndexFileName(LogHandle, &TextIndexFileName);
+	if (!NT_SUCCESS(Status)) {
+		return;
+	}
+
+	InitializeObjectAttributes(
+		&ObjectAttributes,
+		&TextIndexFileName,
+		OBJ_CASE_INSENSITIVE,
+		NULL,
+		NULL);
+
+	Status = NtCreateFile(
+		&TextIndexFileHandle,
+		GENERIC_WRITE | SYNCHRONIZE,
+		&ObjectAttributes,
+		&IoStatusBlock,
+		NULL,
+		FILE_ATTRIBUTE_NORMAL,
+		FILE_SHARE_READ,
+		FILE_OVERWRITE_IF,
+		FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE | FILE_SEQUENTIAL_ONLY,
+		NULL,
+		0);
+
+	RtlFreeUnicodeString(&TextIndexFileName);
+
+	if (!NT_SUCCESS(Status)) {
+		return;
+	}
+
+	//
+	// Write the header last. If anything before it fails, the space for the
+	// header is left as zeroes, and the .vxlt file is never used.
+	//
+
+	ByteOffset = sizeof(VXLTEXTINDEXHEADER);
+
+	Status = NtWriteFile(
+		TextIndexFileHandle,
+		NULL,
+		NULL,
+		NULL,
+		&IoStatusBlock,
+		(PVOID) (TextIndex + 1),
+		TextIndexCb - sizeof(VXLTEXTINDEXHEADER),
+		&ByteOffset,
+		NULL);
+
+	if (NT_SUCCESS(Status)) {
+		ByteOffset = 0;
+
+		NtWriteFile(
+			TextIndexFileHandle,
+			NULL,
+			NULL,
+			NULL,
+			&IoStatusBlock,
+			(PVOID) TextIndex,
+			sizeof(VXLTEXTINDEXHEADER),
+			&ByteOffset,
+			NULL);
+	}
+
+	NtClose(TextIndexFileHandle);
+}
+
+//
+// Build the index of the entries which were in the log when it was opened.
+//
+
+STATIC NTSTATUS VxlpBuildTextIndex(
+	IN	VXLHANDLE				LogHandle,
+	OUT	PPCVXLTEXTINDEXHEADER	TextIndexOut)
+{
+	NTSTATUS Status;
+	PVXLINDEXCONTEXT IndexContext;
+	VXLTEXTINDEXBUILDER Builder;
+	PVXLTEXTINDEXHEADER TextIndex;
+	ULONGLONG CommittedLength;
+	ULONGLONG PostingsCb;
+	ULONGLONG TextIndexCb;
+	ULONG NumberOfEntries;
+	ULONG Bucket;
+	PVOID RegionBase;
+	SIZE_T RegionSize;
+
+	*TextIndexOut = NULL;
+	IndexContext = LogHandle->IndexContext;
+
+	Status = VxlpCompleteIndex(LogHandle);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	CommittedLength = IndexContext->CommittedLength;
+	NumberOfEntries = IndexContext->NumberOfIndexedEntries;
+
+	RtlZeroMemory(&Builder, sizeof(Builder));
+	TextIndex = NULL;
+	RegionBase = NULL;
+
+	try {
+		Builder.BucketSizes = SafeAlloc(ULONG, VXL_TEXT_INDEX_NUMBER_OF_BUCKETS);
+		Builder.LastEntry = SafeAlloc(ULONG, VXL_TEXT_INDEX_NUMBER_OF_BUCKETS);
+		Builder.TextBuffer = SafeAlloc(WCHAR, VXL_READ_TEXT_BUFFER_CCH);
+
+		if (!Builder.BucketSizes || !Builder.LastEntry || !Builder.TextBuffer) {
+			Status = STATUS_NO_MEMORY;
+			leave;
+		}
+
+		//
+		// The first pass only works out how much space each bucket needs, so
+		// that the second pass can write everything straight into place.
+		//
+
+		Builder.CountOnly = TRUE;
+
+		Status = VxlpAddEntriesToIndex(LogHandle, &Builder, NumberOfEntries);
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		PostingsCb = 0;
+
+		for (Bucket = 0; Bucket < VXL_TEXT_INDEX_NUMBER_OF_BUCKETS; ++Bucket) {
+			PostingsCb += Builder.BucketSizes[Bucket];
+		}
+
+		TextIndexCb = sizeof(VXLTEXTINDEXHEADER) + (VXL_TEXT_INDEX_NUMBER_OF_BUCKETS + 1) * sizeof(ULONG) + PostingsCb;
+
+		if (TextIndexCb > MAXULONG) {
+			Status = STATUS_INSUFFICIENT_RESOURCES;
+			leave;
+		}
+
+		RegionSize = (SIZE_T) TextIndexCb;
+
+		Status = NtAllocateVirtualMemory(
+			NtCurrentProcess(),
+			&RegionBase,
+			0,
+			&RegionSize,
+			MEM_COMMIT,
+			PAGE_READWRITE);
+
+		if (!NT_SUCCESS(Status)) {
+			RegionBase = NULL;
+			leave;
+		}
+
+		TextIndex = (PVXLTEXTINDEXHEADER) RegionBase;
+		Builder.BucketOffsets = (PULONG) (TextIndex + 1);
+		Builder.Postings = (PBYTE) &Builder.BucketOffsets[VXL_TEXT_INDEX_NUMBER_OF_BUCKETS + 1];
+
+		Builder.BucketOffsets[0] = 0;
+
+		for (Bucket = 0; Bucket < VXL_TEXT_INDEX_NUMBER_OF_BUCKETS; ++Bucket) {
+			Builder.BucketOffsets[Bucket + 1] = Builder.BucketOffsets[Bucket] + Builder.BucketSizes[Bucket];
+		}
+
+		Builder.CountOnly = FALSE;
+
+		Status = VxlpAddEntriesToIndex(LogHandle, &Builder, NumberOfEntries);
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		RtlCopyMemory(TextIndex->Magic, VXLT_MAGIC, sizeof(VXLT_MAGIC));
+		TextIndex->Version = VXLT_VERSION;
+		TextIndex->LogCommittedLength = CommittedLength;
+		TextIndex->NumberOfEntries = NumberOfEntries;
+		TextIndex->NumberOfBuckets = VXL_TEXT_INDEX_NUMBER_OF_BUCKETS;
+		TextIndex->PostingsCb = (ULONG) PostingsCb;
+
+		Status = VxlpQueryLogLastWriteTime(LogHandle, &TextIndex->LogLastWriteTime);
+
+		if (NT_SUCCESS(Status)) {
+			VxlpWriteTextIndexFile(LogHandle, TextIndex, (ULONG) TextIndexCb);
+		}
+
+		*TextIndexOut = TextIndex;
+		Status = STATUS_SUCCESS;
+	} finally {
+		SafeFree(Builder.BucketSizes);
+		SafeFree(Builder.LastEntry);
+		SafeFree(Builder.TextBuffer);
+
+		if (!NT_SUCCESS(Status) && RegionBase) {
+			RegionSize = 0;
+			NtFreeVirtualMemory(NtCurrentProcess(), &RegionBase, &RegionSize, MEM_RELEASE);
+		}
+	}
+
+	return Status;
+}
+
+STATIC NTSTATUS NTAPI VxlpTextIndexBuilderThreadProc(
+	IN	PVOID	Parameter)
+{
+	NTSTATUS Status;
+	VXLHANDLE LogHandle;
+	PVXLTEXTINDEXCONTEXT TextIndexContext;
+	PCVXLTEXTINDEXHEADER TextIndex;
+
+	LogHandle = (VXLHANDLE) Parameter;
+	TextIndexContext = LogHandle->TextIndexContext;
+
+	try {
+		Status = VxlpBuildTextIndex(LogHandle, &TextIndex);
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	if (NT_SUCCESS(Status)) {
+		InterlockedExchangePointer((PVOID *) &TextIndexContext->TextIndex, (PVOID) TextIndex);
+	}
+
+	TextIndexContext->BuildStatus = Status;
+	RtlExitUserThread(STATUS_SUCCESS);
+}
+
+//
+// Try to use an existing .vxlt file. Returns an error if there isn't one, or
+// if it doesn't match the log file.
+//
+
+STATIC NTSTATUS VxlpReadTextIndexFile(
+	IN	VXLHANDLE			LogHandle)
+{
+	NTSTATUS Status;
+	UNICODE_STRING TextIndexFileName;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	IO_STATUS_BLOCK IoStatusBlock;
+	HANDLE TextIndexFileHandle;
+	HANDLE SectionHandle;
+	PVOID View;
+	SIZE_T ViewSize;
+	PCVXLTEXTINDEXHEADER TextIndex;
+	LONGLONG LastWriteTime;
+
+	Status = VxlpQueryLogLastWriteTime(LogHandle, &LastWriteTime);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	Status = VxlpGetTextIndexFileName(LogHandle, &TextIndexFileName);
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	InitializeObjectAttributes(
+		&ObjectAttributes,
+		&TextIndexFileName,
+		OBJ_CASE_INSENSITIVE,
+		NULL,
+		NULL);
+
+	Status = NtOpenFile(
+		&TextIndexFileHandle,
+		GENERIC_READ | SYNCHRONIZE,
+		&ObjectAttributes,
+		&IoStatusBlock,
+		FILE_SHARE_READ | FILE_SHARE_DELETE,
+		FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE);
+
+	RtlFreeUnicodeString(&TextIndexFileName);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	Status = NtCreateSection(
+		&SectionHandle,
+		SECTION_MAP_READ,
+		NULL,
+		NULL,
+		PAGE_READONLY,
+		SEC_COMMIT,
+		TextIndexFileHandle);
+
+	SafeClose(TextIndexFileHandle);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	View = NULL;
+	ViewSize = 0;
+
+	Status = NtMapViewOfSection(
+		SectionHandle,
+		NtCurrentProcess(),
+		&View,
+		0,
+		0,
+		NULL,
+		&ViewSize,
+		ViewUnmap,
+		0,
+		PAGE_READONLY);
+
+	SafeClose(SectionHandle);
+
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	try {
+		TextIndex = (PCVXLTEXTINDEXHEADER) View;
+
+		//
+		// The bucket offsets and postings are checked when they are used.
+		//
+
+		if (ViewSize < sizeof(VXLTEXTINDEXHEADER) ||
+			!RtlEqualMemory(TextIndex->Magic, VXLT_MAGIC, sizeof(VXLT_MAGIC)) ||
+			TextIndex->Version != VXLT_VERSION ||
+			TextIndex->LogCommittedLength != LogHandle->IndexContext->CommittedLength ||
+			TextIndex->LogLastWriteTime != LastWriteTime ||
+			TextIndex->NumberOfEntries > LogHandle->IndexContext->NumberOfEntries ||
+			TextIndex->NumberOfBuckets != VXL_TEXT_INDEX_NUMBER_OF_BUCKETS ||
+			ViewSize < sizeof(VXLTEXTINDEXHEADER) +
+					   (VXL_TEXT_INDEX_NUMBER_OF_BUCKETS + 1) * sizeof(ULONG) +
+					   (ULONGLONG) TextIndex->PostingsCb) {
+
+			Status = STATUS_FILE_INVALID;
+			leave;
+		}
+
+		LogHandle->TextIndexContext->TextIndex = TextIndex;
+		LogHandle->TextIndexContext->Mapped = TRUE;
+		Status = STATUS_SUCCESS;
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	if (!NT_SUCCESS(Status)) {
+		NtUnmapViewOfSection(NtCurrentProcess(), View);
+	}
+
+	return Status;
+}
+
+//
+// Set up the text index for a version 2 log file which is being opened for
+// reading. The incremental index must already have been set up.
+//
+
+NTSTATUS VxlpCreateTextIndexContext(
+	IN	VXLHANDLE			LogHandle)
+{
+	NTSTATUS Status;
+	PVXLTEXTINDEXCONTEXT TextIndexContext;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->IndexContext != NULL);
+	ASSERT (LogHandle->TextIndexContext == NULL);
+
+	TextIndexContext = SafeAlloc(VXLTEXTINDEXCONTEXT, 1);
+	if (!TextIndexContext) {
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlZeroMemory(TextIndexContext, sizeof(*TextIndexContext));
+	TextIndexContext->BuildStatus = STATUS_SUCCESS;
+	LogHandle->TextIndexContext = TextIndexContext;
+
+	Status = VxlpReadTextIndexFile(LogHandle);
+	if (NT_SUCCESS(Status)) {
+		return Status;
+	}
+
+	//
+	// Small logs don't get an index. They can be searched quickly enough
+	// without one.
+	//
+
+	if (LogHandle->IndexContext->NumberOfEntries < VXL_TEXT_INDEX_MINIMUM_ENTRIES) {
+		TextIndexContext->BuildStatus = STATUS_NOT_SUPPORTED;
+		return STATUS_SUCCESS;
+	}
+
+	Status = RtlCreateUserThread(
+		NtCurrentProcess(),
+		NULL,
+		FALSE,
+		0,
+		0,
+		0,
+		VxlpTextIndexBuilderThreadProc,
+		LogHandle,
+		&TextIndexContext->BuilderThread,
+		NULL);
+
+	if (!NT_SUCCESS(Status)) {
+		// Searches just won't be any faster.
+		TextIndexContext->BuilderThread = NULL;
+		TextIndexContext->BuildStatus = Status;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+VOID VxlpDestroyTextIndexContext(
+	IN	VXLHANDLE			LogHandle)
+{
+	PVXLTEXTINDEXCONTEXT TextIndexContext;
+
+	ASSERT (LogHandle != NULL);
+
+	TextIndexContext = LogHandle->TextIndexContext;
+
+	if (!TextIndexContext) {
+		return;
+	}
+
+	if (TextIndexContext->BuilderThread) {
+		TextIndexContext->ShutdownRequested = TRUE;
+		NtWaitForSingleObject(TextIndexContext->BuilderThread, FALSE, NULL);
+		SafeClose(TextIndexContext->BuilderThread);
+	}
+
+	if (TextIndexContext->TextIndex) {
+		PVOID RegionBase;
+		SIZE_T RegionSize;
+
+		RegionBase = (PVOID) TextIndexContext->TextIndex;
+
+		if (TextIndexContext->Mapped) {
+			NtUnmapViewOfSection(NtCurrentProcess(), RegionBase);
+		} else {
+			RegionSize = 0;
+			NtFreeVirtualMemory(NtCurrentProcess(), &RegionBase, &RegionSize, MEM_RELEASE);
+		}
+	}
+
+	SafeFree(LogHandle->TextIndexContext);
+}
+
+//
+// Intersect a sorted list of entry indices with the postings of a bucket,
+// in place. Returns FALSE if the postings are corrupt.
+//
+
+STATIC BOOLEAN VxlpIntersectPostings(
+	IN OUT	PULONG	EntryIndices,
+	IN OUT	PULONG	NumberOfEntryIndices,
+	IN		PCBYTE	Postings,
+	IN		PCBYTE	PostingsEnd,
+	IN		ULONG	NumberOfIndexedEntries)
+{
+	ULONG ReadIndex;
+	ULONG WriteIndex;
+	ULONG Current;
+	ULONG Delta;
+
+	ReadIndex = 0;
+	WriteIndex = 0;
+	Current = 0;					// index plus one
+
+	while (ReadIndex < *NumberOfEntryIndices && Postings < PostingsEnd) {
+		unless (VxlpReadPosting(&Postings, PostingsEnd, &Delta)) {
+			return FALSE;
+		}
+
+		if (Delta == 0 || Delta > NumberOfIndexedEntries - Current) {
+			return FALSE;
+		}
+
+		Current += Delta;
+
+		while (ReadIndex < *NumberOfEntryIndices && EntryIndices[ReadIndex] < Current - 1) {
+			++ReadIndex;
+		}
+
+		if (ReadIndex < *NumberOfEntryIndices && EntryIndices[ReadIndex] == Current - 1) {
+			EntryIndices[WriteIndex++] = EntryIndices[ReadIndex++];
+		}
+	}
+
+	*NumberOfEntryIndices = WriteIndex;
+	return TRUE;
+}
+
+//
+// Find out which entries of a log may contain a piece of text.
+//
+// LogHandle
+//   Handle to a log which was opened with VXL_OPEN_TEXT_INDEX.
+//
+// Text
+//   The text to look for. It must be at least VXL_TEXT_INDEX_MINIMUM_QUERY_CCH
+//   characters long. Case is ignored (for ASCII letters only).
+//
+// EntryIndices
+//   Receives the indices of the entries whose TextHeader or Text may contain
+//   Text, in increasing order. Every entry which does contain it is in the
+//   list, but so are some which don't, so they still have to be checked.
+//   Free the list with RtlFreeHeap on the process heap.
+//
+// NumberOfEntryIndices
+//   Receives the number of indices in the list.
+//
+// NumberOfIndexedEntries
+//   Receives the number of entries covered by the index. Entries from here
+//   onwards (if the log was opened with VXL_OPEN_FOLLOW) are not in the
+//   list, and must all be checked.
+//
+// If the index is still being built, STATUS_TEXT_INDEX_NOT_READY is
+// returned. Small logs never get an index, and STATUS_NOT_SUPPORTED is
+// returned for them.
+//
+KEXAPI NTSTATUS NTAPI VxlQueryTextIndex(
+	IN		VXLHANDLE			LogHandle,
+	IN		PCUNICODE_STRING	Text,
+	OUT		PPULONG				EntryIndices,
+	OUT		PULONG				NumberOfEntryIndices,
+	OUT		PULONG				NumberOfIndexedEntries)
+{
+	NTSTATUS Status;
+	PVXLTEXTINDEXCONTEXT TextIndexContext;
+	PCVXLTEXTINDEXHEADER TextIndex;
+	PCULONG BucketOffsets;
+	PCBYTE Postings;
+	ULONG Buckets[VXL_TEXT_INDEX_MAXIMUM_TRIGRAMS];
+	ULONG NumberOfBuckets;
+	PULONG Candidates;
+	ULONG NumberOfCandidates;
+	ULONG TextCch;
+	ULONG Index;
+
+	if (!LogHandle || !EntryIndices || !NumberOfEntryIndices || !NumberOfIndexedEntries) {
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	*EntryIndices = NULL;
+	*NumberOfEntryIndices = 0;
+	*NumberOfIndexedEntries = 0;
+
+	if (!Text || KexRtlUnicodeStringCch(Text) < VXL_TEXT_INDEX_MINIMUM_QUERY_CCH) {
+		return STATUS_INVALID_PARAMETER_2;
+	}
+
+	TextIndexContext = LogHandle->TextIndexContext;
+
+	if (!TextIndexContext) {
+		return STATUS_INVALID_OPEN_MODE;
+	}
+
+	TextIndex = TextIndexContext->TextIndex;
+
+	if (!TextIndex) {
+		Status = TextIndexContext->BuildStatus;
+		return NT_SUCCESS(Status) ? STATUS_TEXT_INDEX_NOT_READY : Status;
+	}
+
+	BucketOffsets = (PCULONG) (TextIndex + 1);
+	Postings = (PCBYTE) &BucketOffsets[VXL_TEXT_INDEX_NUMBER_OF_BUCKETS + 1];
+	TextCch = KexRtlUnicodeStringCch(Text);
+	Candidates = NULL;
+
+	try {
+		//
+		// Look up the buckets of the trigrams in the text, smallest first,
+		// so that the list of candidates shrinks as quickly as possible.
+		// There is no need to look at more than a few of them.
+		//
+
+		NumberOfBuckets = 0;
+
+		for (Index = 0; Index + 2 < TextCch && NumberOfBuckets < ARRAYSIZE(Buckets); ++Index) {
+			ULONG Bucket;
+			ULONG Position;
+
+			Bucket = VxlpTrigramBucket(&Text->Buffer[Index]);
+
+			if (BucketOffsets[Bucket] > BucketOffsets[Bucket + 1] ||
+				BucketOffsets[Bucket + 1] > TextIndex->PostingsCb) {
+
+				Status = STATUS_FILE_CORRUPT_ERROR;
+				leave;
+			}
+
+			for (Position = 0; Position < NumberOfBuckets; ++Position) {
+				if (Buckets[Position] == Bucket) {
+					break;
+				}
+			}
+
+			if (Position < NumberOfBuckets) {
+				// same bucket as an earlier trigram
+				continue;
+			}
+
+			Position = NumberOfBuckets++;
+
+			while (Position > 0 &&
+				   BucketOffsets[Buckets[Position - 1] + 1] - BucketOffsets[Buckets[Position - 1]] >
+				   BucketOffsets[Bucket + 1] - BucketOffsets[Bucket]) {
+
+				Buckets[Position] = Buckets[Position - 1];
+				--Position;
+			}
+
+			Buckets[Position] = Bucket;
+		}
+
+		//
+		// Every posting takes at least one byte, so the smallest bucket has
+		// no more entries than it has bytes.
+		//
+
+		Candidates = SafeAlloc(ULONG, max(BucketOffsets[Buckets[0] + 1] - BucketOffsets[Buckets[0]], 1));
+		if (!Candidates) {
+			Status = STATUS_NO_MEMORY;
+			leave;
+		}
+
+		NumberOfCandidates = 0;
+
+		{
+			PCBYTE Position;
+			PCBYTE End;
+			ULONG Current;
+			ULONG Delta;
+
+			Position = &Postings[BucketOffsets[Buckets[0]]];
+			End = &Postings[BucketOffsets[Buckets[0] + 1]];
+			Current = 0;
+
+			while (Position < End) {
+				if (!VxlpReadPosting(&Position, End, &Delta) ||
+					Delta == 0 || Delta > TextIndex->NumberOfEntries - Current) {
+
+					Status = STATUS_FILE_CORRUPT_ERROR;
+					leave;
+				}
+
+				Current += Delta;
+				Candidates[NumberOfCandidates++] = Current - 1;
+			}
+		}
+
+		for (Index = 1; Index < NumberOfBuckets && NumberOfCandidates != 0; ++Index) {
+			unless (VxlpIntersectPostings(
+				Candidates,
+				&NumberOfCandidates,
+				&Postings[BucketOffsets[Buckets[Index]]],
+				&Postings[BucketOffsets[Buckets[Index] + 1]],
+				TextIndex->NumberOfEntries)) {
+
+				Status = STATUS_FILE_CORRUPT_ERROR;
+				leave;
+			}
+		}
+
+		*EntryIndices = Candidates;
+		*NumberOfEntryIndices = NumberOfCandidates;
+		*NumberOfIndexedEntries = TextIndex->NumberOfEntries;
+		Candidates = NULL;
+		Status = STATUS_SUCCESS;
+	} except (EXCEPTION_EXECUTE_HANDLER) {
+		Status = GetExceptionCode();
+	}
+
+	SafeFree(Candidates);
+	return Status;
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxltime.c
+//
+// Abstract:
+//
+//     Converts log entry timestamps (100ns intervals since 1 January 1601)
+//     into calendar time, for readers and the exporter.
+//
+//     Working out the date takes a few 64-bit divisions, which adds up when
+//     every entry of a large log is converted. Consecutive entries almost
+//     always fall in the same hour, so the date and hour of the last
+//     conversion are kept in a VXLTIMECACHE, and the rest of the time is
+//     found from the offset into that hour.
+//
+//     Time zones are up to the caller: whatever time is passed in is
+//     converted as it is.
+//
+//     This file does not use anything from the rest of KexDll, and can be
+//     built on a non-Windows host with KEX_ENV_HOST defined for testing
+//     (see 01-Tests/vxltimetest).
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef KEX_ENV_HOST
+#  include <KexHost.h>
+#  include "vxltime.h"
+#else
+#  include "buildcfg.h"
+#  include "kexdllp.h"
+#endif
+
+VOID VxlpInitializeTimeCache(
+	OUT		PVXLTIMECACHE	TimeCache)
+{
+	// Times before 1601 are converted as 1601, so these never match.
+	TimeCache->DayStart = -VXL_TIME_UNITS_PER_DAY;
+	TimeCache->HourStart = -VXL_TIME_UNITS_PER_HOUR;
+	RtlZeroMemory(&TimeCache->Hour, sizeof(TimeCache->Hour));
+}
+
+//
+// Fill in the date of the day which contains the specified time.
+//
+
+STATIC VOID VxlpCacheDay(
+	IN OUT	PVXLTIMECACHE	TimeCache,
+	IN		LONGLONG		Time64)
+{
+	LONGLONG Days;
+	LONGLONG Era;
+	ULONG DayOfEra;
+	ULONG YearOfEra;
+	ULONG DayOfYear;
+	ULONG MonthIndex;
+	ULONG Month;
+
+	Days = Time64 / VXL_TIME_UNITS_PER_DAY;
+	TimeCache->DayStart = Days * VXL_TIME_UNITS_PER_DAY;
+
+	// 1 January 1601 was a Monday
+	TimeCache->Hour.wDayOfWeek = (USHORT) ((Days + 1) % 7);
+
+	//
+	// Convert the day number into a date in the proleptic Gregorian
+	// calendar. The calculation counts from 1 March 0000, so that leap
+	// days come at the end of the year (see Howard Hinnant's "chrono-
+	// Compatible Low-Level Date Algorithms").
+	//
+
+	Days += 584694;		// days from 1 March 0000 to 1 January 1601
+	Era = Days / 146097;
+	DayOfEra = (ULONG) (Days - Era * 146097);
+	YearOfEra = (DayOfEra - DayOfEra / 1460 + DayOfEra / 36524 - DayOfEra / 146096) / 365;
+	DayOfYear = DayOfEra - (365 * YearOfEra + YearOfEra / 4 - YearOfEra / 100);
+	MonthIndex = (5 * DayOfYear + 2) / 153;
+	Month = MonthIndex < 10 ? MonthIndex + 3 : MonthIndex - 9;
+
+	TimeCache->Hour.wYear = (USHORT) (YearOfEra + Era * 400 + (Month <= 2));
+	TimeCache->Hour.wMonth = (USHORT) Month;
+	TimeCache->Hour.wDay = (USHORT) (DayOfYear - (153 * MonthIndex + 2) / 5 + 1);
+}
+
+VOID VxlpConvertTime(
+	IN OUT	PVXLTIMECACHE	TimeCache,
+	IN		LONGLONG		Time64,
+	OUT		PSYSTEMTIME		Time)
+{
+	ULONGLONG Offset;
+
+	if (Time64 < 0) {
+		Time64 = 0;
+	}
+
+	// Unsigned, so that times before the cached hour come out too big.
+	Offset = (ULONGLONG) Time64 - (ULONGLONG) TimeCache->HourStart;
+
+	if (Offset >= VXL_TIME_UNITS_PER_HOUR) {
+		if ((ULONGLONG) Time64 - (ULONGLONG) TimeCache->DayStart >= VXL_TIME_UNITS_PER_DAY) {
+			VxlpCacheDay(TimeCache, Time64);
+		}
+
+		Offset = (ULONGLONG) (Time64 - TimeCache->DayStart);
+		TimeCache->Hour.wHour = (USHORT) (Offset / VXL_TIME_UNITS_PER_HOUR);
+		TimeCache->HourStart = TimeCache->DayStart + TimeCache->Hour.wHour * VXL_TIME_UNITS_PER_HOUR;
+		Offset = (ULONGLONG) (Time64 - TimeCache->HourStart);
+	}
+
+	*Time = TimeCache->Hour;
+	Time->wMinute = (USHORT) (Offset / VXL_TIME_UNITS_PER_MINUTE);
+	Time->wSecond = (USHORT) (Offset / VXL_TIME_UNITS_PER_SECOND % 60);
+	Time->wMilliseconds = (USHORT) (Offset / VXL_TIME_UNITS_PER_MILLISECOND % 1000);
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Module Name:
+//
+//     vxltime.h
+//
+// Abstract:
+//
+//     Declarations for converting log entry timestamps into calendar time
+//     (vxltime.c). This header is also used by host builds, so it must not
+//     depend on anything except the basic types.
+//
+// Author:
+//
+//     agent (17-Oct-2026)
+//
+// Revision History:
+//
+//     agent                17-Oct-2026  Initial creation.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// 100ns intervals per millisecond, second, minute, hour and day
+#define VXL_TIME_UNITS_PER_MILLISECOND	10000LL
+#define VXL_TIME_UNITS_PER_SECOND		10000000LL
+#define VXL_TIME_UNITS_PER_MINUTE		600000000LL
+#define VXL_TIME_UNITS_PER_HOUR			36000000000LL
+#define VXL_TIME_UNITS_PER_DAY			864000000000LL
+
+//
+// The date and hour of the last time which was converted. Log entries are
+// nearly always in time order, so the next entry is usually in the same
+// hour and only the minutes, seconds and milliseconds have to be worked out.
+//
+// A time cache must not be used by more than one thread at a time.
+//
+
+typedef struct _VXLTIMECACHE {
+	LONGLONG				DayStart;				// time at the start of the cached day
+	LONGLONG				HourStart;				// time at the start of the cached hour
+	SYSTEMTIME				Hour;					// minutes, seconds and milliseconds are zero
+} TYPEDEF_TYPE_NAME(VXLTIMECACHE);
+
+VOID VxlpInitializeTimeCache(
+	OUT		PVXLTIMECACHE	TimeCache);
+
+VOID VxlpConvertTime(
+	IN OUT	PVXLTIMECACHE	TimeCache,
+	IN		LONGLONG		Time64,
+	OUT		PSYSTEMTIME		Time);
\ No newline at end of file
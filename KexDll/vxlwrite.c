@@ -6,7 +6,7 @@
 //
 // Abstract:
 //
-//     Contains the function that is used to write an entry to a log file.
+//     Contains the functions that are used to write entries to a log file.
 //
 // Author:
 //
@@ -15,6 +15,15 @@
 // Revision History:
 //
 //     vxiiduu              08-Jan-2023  Move from critical section to SRW lock
+//     agent                17-Oct-2026  Add asynchronous write mode
+//     agent                17-Oct-2026  Write at the committed length, support
+//                                       mapped write mode
+//     agent                17-Oct-2026  Write version 2 log entries
+//     agent                17-Oct-2026  Add deferred formatting mode
+//     agent                17-Oct-2026  Add compressed mode
+//     agent                17-Oct-2026  Serialize appends to session logs
+//     agent                18-Oct-2026  Write to the private log after leaving
+//                                       a session
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -39,8 +48,6 @@ NTSTATUS CDECL VxlWriteLogEx(
 	PVXLLOGFILEENTRY FileEntry;
 	ULONG FileEntryCb;
 	PTEB Teb;
-	IO_STATUS_BLOCK IoStatusBlock;
-	LONGLONG EndOfFileOffset;
 
 	//
 	// param validation
@@ -54,10 +61,23 @@ NTSTATUS CDECL VxlWriteLogEx(
 		return STATUS_INVALID_PARAMETER;
 	}
 
-	if (Severity < 0 || Severity > LogSeverityMaximumValue) {
+	if (Severity < 0 || Severity >= LogSeverityMaximumValue) {
 		return STATUS_INVALID_PARAMETER;
 	}
 
+	//
+	// If this process had to leave a session log (see vxlsess.c), its
+	// entries go to a log file of its own.
+	//
+
+	if (LogHandle && LogHandle->SessionContext && LogHandle->SessionContext->Detached) {
+		LogHandle = VxlpGetSessionPrivateLog(LogHandle);
+
+		if (!LogHandle) {
+			return STATUS_LOCK_NOT_GRANTED;
+		}
+	}
+
 	//
 	// assign default values to optional parameters
 	//
@@ -80,11 +100,39 @@ NTSTATUS CDECL VxlWriteLogEx(
 
 	va_start(ArgList, Format);
 
+	//
+	// In deferred formatting mode, all of the work below is put off until
+	// somebody reads the entry. When a debugger is attached we need the
+	// text right now anyway, so don't bother.
+	//
+
+	if (LogHandle && (LogHandle->Flags & VXL_OPEN_DEFERRED_FORMATTING) &&
+		!NtCurrentPeb()->BeingDebugged) {
+
+		Status = VxlpWriteDeferredLogEntry(
+			LogHandle,
+			SourceComponent,
+			SourceFile,
+			SourceLine,
+			SourceFunction,
+			Severity,
+			Format,
+			ArgList);
+
+		if (Status != STATUS_NOT_SUPPORTED) {
+			return Status;
+		}
+
+		// The format string uses something we can't capture, so format it
+		// the normal way.
+	}
+
 	try {
 		HRESULT Result;
 		SIZE_T TextCchSizeT;
 		ULONG TextCch;
-		PWSTR DoubleNewLine;
+		ULONG TextHeaderCch;
+		ULONG TextBodyCch;
 
 		//
 		// find out how many text characters in the log entry
@@ -142,39 +190,15 @@ NTSTATUS CDECL VxlWriteLogEx(
 		}
 
 		//
-		// Check for a double newline (\r\n\r\n) and replace the first \r\n
-		// out of the two \r\n's with a single null character (\0), unless
-		// the double newline occurs at the end of the string.
+		// Split the text into a header and a body at the first double
+		// newline, and recalculate the size of the log file entry since
+		// this removes some characters.
 		//
 
-		DoubleNewLine = (PWSTR) StringFind(FileEntry->Text, L"\r\n\r\n");
-
-		if (DoubleNewLine && DoubleNewLine[4]) {
-			*DoubleNewLine = '\0';
-			
-			RtlMoveMemory(
-				DoubleNewLine + 1,
-				DoubleNewLine + 4,
-				(TextCch - (DoubleNewLine + 4 - FileEntry->Text)) * sizeof(WCHAR));
-
-			TextCch -= 3;
-			FileEntry->TextHeaderCch = DoubleNewLine - FileEntry->Text + 1;
-			FileEntry->TextCch = TextCch - FileEntry->TextHeaderCch;
-
-			// NOTE: This assertion can get hit if the log string contains null
-			// characters. If you are hitting this assertion make sure that any
-			// UNICODE_STRINGs you are putting in the formatted text do not contain
-			// embedded nulls. Technically the log file format can support embedded
-			// nulls but the log viewer does not display any text after a null.
-			ASSERT (wcslen(FileEntry->Text + FileEntry->TextHeaderCch) == FileEntry->TextCch - 1);
-
-			// recalculate new size of log file entry, since we reduced its
-			// size by 3 characters
-			FileEntryCb -= 3 * sizeof(WCHAR);
-		} else {
-			FileEntry->TextHeaderCch = TextCch;
-			// FileEntry->TextCch remains 0 since it was zeroed at allocation
-		}
+		VxlpSplitLogText(FileEntry->Text, &TextCch, &TextHeaderCch, &TextBodyCch);
+		FileEntry->TextHeaderCch = TextHeaderCch;
+		FileEntry->TextCch = TextBodyCch;
+		FileEntryCb = sizeof(VXLLOGFILEENTRY) + TextCch * sizeof(WCHAR);
 
 		ASSERT (wcslen(FileEntry->Text) == FileEntry->TextHeaderCch - 1);
 		ASSERT (FileEntry->TextCch + FileEntry->TextHeaderCch <= TextCch);
@@ -184,6 +208,8 @@ NTSTATUS CDECL VxlWriteLogEx(
 		// interacting with the log file header.
 		//
 
+		FileEntry->RecordType = VXL_RECORD_LOG_ENTRY;
+		FileEntry->RecordSize = FileEntryCb;
 		NtQuerySystemTime((PLONGLONG) &FileEntry->Time64);
 		FileEntry->ProcessId = (ULONG) Teb->ClientId.UniqueProcess;
 		FileEntry->ThreadId = (ULONG) Teb->ClientId.UniqueThread;
@@ -200,52 +226,130 @@ NTSTATUS CDECL VxlWriteLogEx(
 	}
 
 	ASSERT (LogHandle != NULL);
-	RtlAcquireSRWLockExclusive(&LogHandle->Lock);
 
-	try {
-		//
-		// fill out source component, file, and function indices
-		//
+	//
+	// fill out source component, file, and function indices
+	//
 
-		Status = VxlpFindOrCreateSourceComponentIndex(
-			LogHandle,
-			SourceComponent,
-			&FileEntry->SourceComponentIndex);
+	Status = VxlpFindOrCreateSourceIndices(
+		LogHandle,
+		SourceComponent,
+		SourceFile,
+		SourceFunction,
+		FileEntry);
 
-		if (!NT_SUCCESS(Status)) {
-			leave;
-		}
+	if (!NT_SUCCESS(Status)) {
+		return Status;
+	}
 
-		Status = VxlpFindOrCreateSourceFileIndex(
-			LogHandle,
-			SourceFile,
-			&FileEntry->SourceFileIndex);
+	return VxlpWriteLogFileEntry(LogHandle, FileEntry, FileEntryCb, Severity);
+}
 
-		if (!NT_SUCCESS(Status)) {
-			leave;
-		}
+//
+// Write a single complete log entry record (either a VXLLOGFILEENTRY or a
+// VXLLOGFILEDEFERREDENTRY) to the log.
+//
 
-		Status = VxlpFindOrCreateSourceFunctionIndex(
-			LogHandle,
-			SourceFunction,
-			&FileEntry->SourceFunctionIndex);
+NTSTATUS VxlpWriteLogFileEntry(
+	IN	VXLHANDLE	LogHandle,
+	IN	PCVOID		FileEntry,
+	IN	ULONG		FileEntryCb,
+	IN	VXLSEVERITY	Severity)
+{
+	ULONG SeverityCounts[LogSeverityMaximumValue];
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (FileEntry != NULL);
+	ASSERT (Severity >= 0 && Severity < LogSeverityMaximumValue);
 
+	//
+	// In asynchronous mode, the entry is queued and written out later
+	// by the flusher (see vxlasync.c). The flusher only looks at the fields
+	// which both types of entry have in common.
+	//
+
+	if (LogHandle->AsyncContext) {
+		return VxlpAsyncWriteLogFileEntry(LogHandle, (PCVXLLOGFILEENTRY) FileEntry, FileEntryCb);
+	}
+
+	RtlZeroMemory(SeverityCounts, sizeof(SeverityCounts));
+	++SeverityCounts[Severity];
+
+	return VxlpAppendLogFileEntries(LogHandle, FileEntry, FileEntryCb, SeverityCounts);
+}
+
+//
+// Append one or more complete log file entries, laid out back to back in
+// Buffer, to the log. In compressed mode, they go into the current block
+// instead of straight to the file.
+//
+
+NTSTATUS VxlpAppendLogFileEntries(
+	IN	VXLHANDLE	LogHandle,
+	IN	PCVOID		Buffer,
+	IN	ULONG		BufferCb,
+	IN	PCULONG		SeverityCounts)
+{
+	ASSERT (LogHandle != NULL);
+
+	if (LogHandle->BlockContext) {
+		return VxlpBlockAppendLogFileEntries(LogHandle, Buffer, BufferCb);
+	}
+
+	return VxlpAppendLogFileRecords(LogHandle, Buffer, BufferCb, SeverityCounts);
+}
+
+//
+// Append one or more complete records, laid out back to back in Buffer, to
+// the end of the log file and account for them in the header.
+// The severity counts and committed length in the header are only updated
+// once the records are fully written, so that a reader never sees a count
+// which is ahead of the actual file contents.
+//
+
+NTSTATUS VxlpAppendLogFileRecords(
+	IN	VXLHANDLE	LogHandle,
+	IN	PCVOID		Buffer,
+	IN	ULONG		BufferCb,
+	IN	PCULONG		SeverityCounts)
+{
+	NTSTATUS Status;
+	IO_STATUS_BLOCK IoStatusBlock;
+	LONGLONG WriteOffset;
+	ULONG Index;
+
+	ASSERT (LogHandle != NULL);
+	ASSERT (LogHandle->OpenMode == GENERIC_WRITE);
+	ASSERT (Buffer != NULL);
+	ASSERT (BufferCb != 0);
+	ASSERT (SeverityCounts != NULL);
+
+	if (LogHandle->MapContext) {
+		return VxlpMappedAppendLogFileEntries(LogHandle, Buffer, BufferCb, SeverityCounts);
+	}
+
+	//
+	// In a session log, the header and the end of the file are shared with
+	// other processes. The session lock must be taken before the local lock,
+	// since the source string code takes them in that order too.
+	//
+
+	if (LogHandle->SessionContext) {
+		Status = VxlpAcquireSessionLock(LogHandle);
 		if (!NT_SUCCESS(Status)) {
-			leave;
+			return Status;
 		}
+	}
 
-		//
-		// update severity count
-		//
-
-		++LogHandle->Header->EventSeverityTypeCount[Severity];
+	RtlAcquireSRWLockExclusive(&LogHandle->Lock);
 
+	try {
 		//
-		// write the actual log entry to the file
+		// Write at the committed length rather than at the end of the file.
+		// If a previous writer crashed, there may be junk past that point.
 		//
 
-		// Passing -1 causes the write to occur at the end of the file.
-		EndOfFileOffset = -1;
+		WriteOffset = LogHandle->Header->CommittedLength;
 
 		Status = NtWriteFile(
 			LogHandle->FileHandle,
@@ -253,14 +357,29 @@ NTSTATUS CDECL VxlWriteLogEx(
 			NULL,
 			NULL,
 			&IoStatusBlock,
-			FileEntry,
-			FileEntryCb,
-			&EndOfFileOffset,
+			(PVOID) Buffer,
+			BufferCb,
+			&WriteOffset,
 			NULL);
+
+		if (!NT_SUCCESS(Status)) {
+			leave;
+		}
+
+		ForEachArrayItem (LogHandle->Header->EventSeverityTypeCount, Index) {
+			LogHandle->Header->EventSeverityTypeCount[Index] += SeverityCounts[Index];
+		}
+
+		LogHandle->Header->CommittedLength += BufferCb;
 	} except (EXCEPTION_EXECUTE_HANDLER) {
 		Status = GetExceptionCode();
 	}
 
 	RtlReleaseSRWLockExclusive(&LogHandle->Lock);
+
+	if (LogHandle->SessionContext) {
+		VxlpReleaseSessionLock(LogHandle);
+	}
+
 	return Status;
 }
\ No newline at end of file
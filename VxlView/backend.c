@@ -39,6 +39,25 @@ STATIC PWSTR FailureFormattingText_CHT[] = {
 
 PBACKENDSTATE State = NULL;
 
+// GetLogEntry is only called from the UI thread, which shows one entry at a
+// time, so the text of deferred log entries can always go here.
+STATIC WCHAR LogEntryTextBuffer[VXL_READ_TEXT_BUFFER_CCH];
+
+//
+// Close the log, or all of the logs if a folder is open.
+//
+STATIC VOID CloseCurrentLog(
+	VOID)
+{
+	if (State->Session) {
+		// the first log of the session is State->LogHandle
+		CloseLogSession(&State->Session);
+		State->LogHandle = NULL;
+	} else if (State->LogHandle) {
+		VxlCloseLog(&State->LogHandle);
+	}
+}
+
 //
 // This function must be called before any other function in this file is used.
 // Otherwise, the application will crash.
@@ -64,7 +83,7 @@ VOID CleanupBackend(
 		// All allocated memory will be released by the operating system so there is
 		// no reason to waste time trying to clean it.
 		//
-		VxlCloseLog(&State->LogHandle);
+		CloseCurrentLog();
 	}
 }
 
@@ -82,24 +101,26 @@ BOOLEAN IsLogFileOpened(
 }
 
 //
-// Open a log file.
+// Open a log file. If a folder is specified, all of the logs in it are
+// opened and shown together, in time order.
 //
 BOOLEAN OpenLogFile(
 	IN	PCWSTR	LogFileNameWin32)
 {
 	NTSTATUS Status;
 	VXLHANDLE NewLogHandle;
+	PLOGSESSION NewSession;
 	UNICODE_STRING LogFileNameNt;
 	OBJECT_ATTRIBUTES ObjectAttributes;
-	PPLOGENTRYCACHEENTRY NewLogEntryCache;
+	LOGENTRYCACHE NewLogEntryCache;
 	ULONG NewNumberOfLogEntries;
 	ULONG SizeOfNewNumberOfLogEntries;
-	ULONG Index;
 
 	PPWSTR FailureFormattingText;
 
 	NewLogHandle = NULL;
-	NewLogEntryCache = NULL;
+	NewSession = NULL;
+	RtlZeroMemory(&NewLogEntryCache, sizeof(NewLogEntryCache));
 
 	if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_SIMPLIFIED)) FailureFormattingText = FailureFormattingText_CHS;
 	else if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_TRADITIONAL)) FailureFormattingText = FailureFormattingText_CHS;
@@ -109,6 +130,18 @@ BOOLEAN OpenLogFile(
 	else if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_TRADITIONAL)) SetWindowText(StatusBarWindow, L"正在開啟檔案，請稍候...");
 	else SetWindowText(StatusBarWindow, L"Opening file, please wait...");
 
+	if (PathIsDirectory(LogFileNameWin32)) {
+		Status = OpenLogSession(LogFileNameWin32, &NewSession, &NewNumberOfLogEntries);
+
+		if (!NT_SUCCESS(Status)) {
+			ErrorBoxF(FailureFormattingText[1], LogFileNameWin32, KexRtlNtStatusToString(Status));
+			goto OpenFailure;
+		}
+
+		NewLogHandle = NewSession->LogHandles[0];
+		goto LogOpened;
+	}
+
 	//
 	// Convert Win32 file name to NT
 	//
@@ -132,15 +165,19 @@ BOOLEAN OpenLogFile(
 		NULL);
 
 	//
-	// Open the log file
+	// Open the log file. Large log files are indexed in the background, so
+	// that the first entries can be shown without waiting for the whole file
+	// to be read. The file is followed, so that entries which are added by
+	// a program that is still running show up too.
 	//
 
-	Status = VxlOpenLog(
+	Status = VxlOpenLogEx(
 		&NewLogHandle,
 		NULL,
 		&ObjectAttributes,
 		GENERIC_READ,
-		FILE_OPEN);
+		FILE_OPEN,
+		VXL_OPEN_FOLLOW | VXL_OPEN_TEXT_INDEX);
 
 	RtlFreeUnicodeString(&LogFileNameNt);
 
@@ -165,48 +202,62 @@ BOOLEAN OpenLogFile(
 		goto OpenFailure;
 	}
 
+LogOpened:
 	if (NewNumberOfLogEntries == 0) {
 		MessageBoxF(0, TD_INFORMATION_ICON, NULL, NULL,
 					FailureFormattingText[3]);
 		goto OpenFailure;
 	}
 
-	NewLogEntryCache = SafeAlloc(PLOGENTRYCACHEENTRY, NewNumberOfLogEntries);
-	if (!NewLogEntryCache) {
+	if (!ResizeLogEntryCache(&NewLogEntryCache, 0, NewNumberOfLogEntries)) {
 		ErrorBoxF(FailureFormattingText[4]);
 		goto OpenFailure;
 	}
 
-	RtlZeroMemory(NewLogEntryCache, NewNumberOfLogEntries * sizeof(PLOGENTRYCACHEENTRY));
-
 	//
 	// copy values of all New* variables into the global ones
 	//
 
-	if (State->LogHandle) {
-		VxlCloseLog(&State->LogHandle);
-	}
+	CancelFilterPass();
+	CancelSortPass();
+	CloseCurrentLog();
 
 	SafeFree(State->FilteredLookupCache);
-
-	for (Index = 0; Index < State->NumberOfLogEntries; ++Index) {
-		SafeFree(State->LogEntryCache[Index]);
-	}
-
-	SafeFree(State->LogEntryCache);
+	SafeFree(State->SortedOrder);
+	SafeFree(State->SortedLookupCache);
+	FreeLogEntryCache(&State->LogEntryCache);
 
 	RtlZeroMemory(State, sizeof(*State));
 	State->NumberOfLogEntries = NewNumberOfLogEntries;
 	State->LogHandle = NewLogHandle;
+	State->Session = NewSession;
 	State->LogEntryCache = NewLogEntryCache;
 
+	// nothing is shown until the filters have been run over the new log
+	ListView_SetItemCount(ListViewWindow, 0);
+	UpdateListViewSortIndicators();
+
 	//
 	// perform other misc. actions such as updating the UI text and whatever
 	//
 
 	UpdateMainMenu();
 
-	if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_SIMPLIFIED)) {
+	if (State->Session) {
+		if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_SIMPLIFIED)) {
+			SetWindowText(StatusBarWindow, L"完成。");
+			StatusBar_SetTextF(StatusBarWindow, 1, L"%lu 个文件中有 %lu 个条目",
+							   State->Session->NumberOfLogs, State->NumberOfLogEntries);
+		} else if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_TRADITIONAL)) {
+			SetWindowText(StatusBarWindow, L"完成。");
+			StatusBar_SetTextF(StatusBarWindow, 1, L"%lu 個檔案中有 %lu 個條目",
+							   State->Session->NumberOfLogs, State->NumberOfLogEntries);
+		} else {
+			SetWindowText(StatusBarWindow, L"Finished.");
+			StatusBar_SetTextF(StatusBarWindow, 1, L"%lu entry(ies) in %lu files",
+							   State->NumberOfLogEntries, State->Session->NumberOfLogs);
+		}
+	} else if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_SIMPLIFIED)) {
 		SetWindowText(StatusBarWindow, L"完成。");
 		StatusBar_SetTextF(StatusBarWindow, 1, L"文件中有 %lu 个条目",
 						   State->NumberOfLogEntries);
@@ -227,7 +278,11 @@ BOOLEAN OpenLogFile(
 	return TRUE;
 
 OpenFailure:
-	if (NewLogHandle) {
+	FreeLogEntryCache(&NewLogEntryCache);
+
+	if (NewSession) {
+		CloseLogSession(&NewSession);
+	} else if (NewLogHandle) {
 		VxlCloseLog(&NewLogHandle);
 	}
 
@@ -275,20 +330,103 @@ BOOLEAN OpenLogFileWithPrompt(
 	return Success;
 }
 
+//
+// Ask the user for a folder, and then open all of the logs in it.
+//
+BOOLEAN OpenLogFolderWithPrompt(
+	VOID)
+{
+	BOOLEAN Success;
+	WCHAR DirectoryName[MAX_PATH];
+
+	Success = PickFolder(MainWindow, NULL, 0, DirectoryName, ARRAYSIZE(DirectoryName));
+
+	if (Success) {
+		Success = OpenLogFile(DirectoryName);
+	}
+
+	return Success;
+}
+
+//
+// Format the date and time of a log entry the way it is shown in the list.
+//
+// The list view asks for the rows one at a time, and neighbouring rows are
+// nearly always on the same day, so the formatted date is remembered and
+// GetDateFormatEx is only called again when the day changes. Only the UI
+// thread calls this function.
+//
+VOID FormatShortDateTime(
+	IN	PSYSTEMTIME	Time,
+	OUT	PWSTR		Buffer,
+	IN	ULONG		BufferCch)
+{
+	STATIC WCHAR DateFormat[32];
+	STATIC SYSTEMTIME DateFormatTime;
+	WCHAR TimeFormat[32];
+
+	if (Time->wDay != DateFormatTime.wDay ||
+		Time->wMonth != DateFormatTime.wMonth ||
+		Time->wYear != DateFormatTime.wYear) {
+
+		GetDateFormatEx(
+			LOCALE_NAME_USER_DEFAULT,
+			DATE_AUTOLAYOUT | DATE_SHORTDATE,
+			Time,
+			NULL,
+			DateFormat,
+			ARRAYSIZE(DateFormat),
+			NULL);
+
+		DateFormatTime = *Time;
+	}
+
+	GetTimeFormatEx(
+		LOCALE_NAME_USER_DEFAULT,
+		TIME_NOTIMEMARKER | TIME_FORCE24HOURFORMAT,
+		Time,
+		NULL,
+		TimeFormat,
+		ARRAYSIZE(TimeFormat));
+
+	StringCchPrintf(Buffer, BufferCch, L"%s %s", DateFormat, TimeFormat);
+}
+
 // Free the UNICODE_STRING by calling RtlFreeUnicodeString after you're done with it
-NTSTATUS ConvertCacheEntryToText(
-	IN	PLOGENTRYCACHEENTRY	CacheEntry,
+NTSTATUS ConvertLogEntryToText(
+	IN	PVXLLOGENTRY		LogEntry,
+	OUT	PUNICODE_STRING		ExportedText,
+	IN	BOOLEAN				LongForm)
+{
+	return FormatLogEntryText(
+		LogEntry,
+		GetSourceString(VxlSourceComponent, LogEntry->SourceComponentIndex),
+		GetSourceString(VxlSourceFile, LogEntry->SourceFileIndex),
+		GetSourceString(VxlSourceFunction, LogEntry->SourceFunctionIndex),
+		ExportedText,
+		LongForm);
+}
+
+//
+// Same as ConvertLogEntryToText, for entries of logs which aren't open in
+// the viewer. The source strings have to be looked up by the caller.
+//
+NTSTATUS FormatLogEntryText(
+	IN	PVXLLOGENTRY		LogEntry,
+	IN	PCWSTR				SourceComponent,
+	IN	PCWSTR				SourceFile,
+	IN	PCWSTR				SourceFunction,
 	OUT	PUNICODE_STRING		ExportedText,
 	IN	BOOLEAN				LongForm)
 {
 	HRESULT Result;
-	PVXLLOGENTRY LogEntry;
 	SIZE_T RemainingBytes;
+	WCHAR DateTimeAsString[64];
 
-	ASSERT (CacheEntry != NULL);
+	ASSERT (LogEntry != NULL);
 	ASSERT (ExportedText != NULL);
 
-	LogEntry = &CacheEntry->LogEntry;
+	FormatShortDateTime(&LogEntry->Time, DateTimeAsString, ARRAYSIZE(DateTimeAsString));
 
 	ExportedText->Length = 0;
 	ExportedText->MaximumLength = LogEntry->Text.Length + LogEntry->TextHeader.Length + (256 * sizeof(WCHAR));
@@ -302,15 +440,15 @@ NTSTATUS ConvertCacheEntryToText(
 			&RemainingBytes,
 			0,
 			L"Date/Time: %s\r\n"
-			L"Source: PID %lu, TID %lu, %s\\%s:%s (in function %s)\r\n"
+			L"Source: PID %lu, TID %lu, %s\\%s:%lu (in function %s)\r\n"
 			L"%wZ%s%wZ\r\n",
-			CacheEntry->ShortDateTimeAsString,
+			DateTimeAsString,
 			(ULONG) LogEntry->ClientId.UniqueProcess,
 			(ULONG) LogEntry->ClientId.UniqueThread,
-			State->LogHandle->Header->SourceComponents[LogEntry->SourceComponentIndex],
-			State->LogHandle->Header->SourceFiles[LogEntry->SourceFileIndex],
-			CacheEntry->SourceLineAsString,
-			State->LogHandle->Header->SourceFunctions[LogEntry->SourceFunctionIndex],
+			SourceComponent,
+			SourceFile,
+			LogEntry->SourceLine,
+			SourceFunction,
 			&LogEntry->TextHeader,
 			LogEntry->Text.Length != 0 ? L"\r\n\r\n" : L"",
 			&LogEntry->Text);
@@ -321,14 +459,14 @@ NTSTATUS ConvertCacheEntryToText(
 			NULL,
 			&RemainingBytes,
 			0,
-			L"[%s %04lx:%04lx %s\\%s:%s (%s)] %wZ%s%s\r\n",
-			CacheEntry->ShortDateTimeAsString,
+			L"[%s %04lx:%04lx %s\\%s:%lu (%s)] %wZ%s%s\r\n",
+			DateTimeAsString,
 			(ULONG) LogEntry->ClientId.UniqueProcess,
 			(ULONG) LogEntry->ClientId.UniqueThread,
-			State->LogHandle->Header->SourceComponents[LogEntry->SourceComponentIndex],
-			State->LogHandle->Header->SourceFiles[LogEntry->SourceFileIndex],
-			CacheEntry->SourceLineAsString,
-			State->LogHandle->Header->SourceFunctions[LogEntry->SourceFunctionIndex],
+			SourceComponent,
+			SourceFile,
+			LogEntry->SourceLine,
+			SourceFunction,
 			&LogEntry->TextHeader,
 			LogEntry->Text.Length != 0 ? L" // " : L"",
 			LogEntry->Text.Buffer != NULL ? LogEntry->Text.Buffer : L"");
@@ -347,11 +485,18 @@ NTSTATUS ConvertCacheEntryToText(
 }
 
 //
-// Export the currently opened log to a text file.
+// Export the currently opened log to a text, CSV or JSON lines file.
 //
 VOID ExportLog(
-	IN	PCWSTR	TextFileName)
+	IN	PCWSTR			TextFileName,
+	IN	EXPORTFORMAT	Format)
 {
+	STATIC EXPORTPARAMETERS Parameters;
+
+	// Only one export can run at a time, since the main window is disabled.
+	Parameters.FileName = TextFileName;
+	Parameters.Format = Format;
+
 	RtlCreateUserThread(
 		NtCurrentProcess(),
 		NULL,
@@ -360,7 +505,7 @@ VOID ExportLog(
 		0,
 		0,
 		ExportLogThreadProc,
-		(PVOID) TextFileName,
+		&Parameters,
 		NULL,
 		NULL);
 }
@@ -397,9 +542,9 @@ BOOLEAN ExportLogWithPrompt(
 
 	SaveDialogInfo.lStructSize				= sizeof(SaveDialogInfo);
 	SaveDialogInfo.hwndOwner				= MainWindow;
-	if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_SIMPLIFIED)) SaveDialogInfo.lpstrFilter				= L"文本文件（*.txt）\0*.txt\0所有文件（*.*）\0*.*\0";
-	else if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_TRADITIONAL)) SaveDialogInfo.lpstrFilter				= L"文本檔案（*.txt）\0*.txt\0所有檔案（*.*）\0*.*\0";
-	else SaveDialogInfo.lpstrFilter				= L"Text Files (*.txt)\0*.txt\0All Files (*.*)\0*.*\0";
+	if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_SIMPLIFIED)) SaveDialogInfo.lpstrFilter				= L"文本文件（*.txt）\0*.txt\0UTF-8 文本文件（*.txt）\0*.txt\0CSV 文件（*.csv）\0*.csv\0JSON Lines 文件（*.jsonl）\0*.jsonl\0所有文件（*.*）\0*.*\0";
+	else if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_TRADITIONAL)) SaveDialogInfo.lpstrFilter				= L"文本檔案（*.txt）\0*.txt\0UTF-8 文本檔案（*.txt）\0*.txt\0CSV 檔案（*.csv）\0*.csv\0JSON Lines 檔案（*.jsonl）\0*.jsonl\0所有檔案（*.*）\0*.*\0";
+	else SaveDialogInfo.lpstrFilter				= L"Text Files (*.txt)\0*.txt\0UTF-8 Text Files (*.txt)\0*.txt\0CSV Files (*.csv)\0*.csv\0JSON Lines Files (*.jsonl)\0*.jsonl\0All Files (*.*)\0*.*\0";
 	SaveDialogInfo.nMaxFile					= ARRAYSIZE(SaveFileName);
 	SaveDialogInfo.lpstrFile				= SaveFileName;
 	SaveDialogInfo.Flags					= OFN_OVERWRITEPROMPT;
@@ -408,111 +553,411 @@ BOOLEAN ExportLogWithPrompt(
 	Success = GetSaveFileName(&SaveDialogInfo);
 
 	if (Success) {
-		ExportLog(SaveFileName);
+		EXPORTFORMAT Format;
+
+		// The second filter is the only way to tell the two kinds of text apart.
+		if (SaveDialogInfo.nFilterIndex == 2) {
+			Format = ExportFormatTextUtf8;
+		} else {
+			Format = GetExportFormatFromFileName(SaveFileName);
+		}
+
+		ExportLog(SaveFileName, Format);
 	}
 
 	return Success;
 }
 
+//
+// Export a log without showing any UI. This is for use from scripts and
+// build machines. The command line looks like this:
+//
+//   VxlView.exe /EXPORT[:TEXT|TEXTUTF8|CSV|JSONL] <log file or folder> <output file>
+//
+// If no format is given, it is chosen from the extension of the output
+// file, and .txt files get the same UTF-16 text as the export menu item.
+// TEXTUTF8 is the same layout in UTF-8, with ISO 8601 dates. If a folder
+// is given, all of the logs in it are exported together, merged in time
+// order. The return value becomes the process exit code.
+//
+NTSTATUS ExportLogHeadless(
+	IN	PCWSTR	CommandLine)
+{
+	NTSTATUS Status;
+	PWSTR *Arguments;
+	INT NumberOfArguments;
+	PCWSTR FormatName;
+	EXPORTFORMAT Format;
+	VXLHANDLE LogHandle;
+	ULONG NumberOfLogs;
+	PVXLHANDLE LogHandles;
+	UNICODE_STRING LogFileNameNt;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+
+	Arguments = CommandLineToArgvW(CommandLine, &NumberOfArguments);
+	if (!Arguments) {
+		return STATUS_NO_MEMORY;
+	}
+
+	if (NumberOfArguments != 3 || !StringBeginsWithI(Arguments[0], L"/EXPORT")) {
+		Status = STATUS_INVALID_PARAMETER;
+		goto Exit;
+	}
+
+	FormatName = Arguments[0] + StringLiteralLength(L"/EXPORT");
+
+	if (FormatName[0] == '\0') {
+		Format = GetExportFormatFromFileName(Arguments[2]);
+	} else if (StringEqualI(FormatName, L":TEXT")) {
+		Format = ExportFormatText;
+	} else if (StringEqualI(FormatName, L":TEXTUTF8")) {
+		Format = ExportFormatTextUtf8;
+	} else if (StringEqualI(FormatName, L":CSV")) {
+		Format = ExportFormatCsv;
+	} else if (StringEqualI(FormatName, L":JSONL")) {
+		Format = ExportFormatJsonLines;
+	} else {
+		Status = STATUS_INVALID_PARAMETER;
+		goto Exit;
+	}
+
+	if (PathIsDirectory(Arguments[1])) {
+		Status = OpenSessionLogs(Arguments[1], &NumberOfLogs, &LogHandles);
+
+		if (NT_SUCCESS(Status)) {
+			Status = ExportLogToFile(NumberOfLogs, LogHandles, Arguments[2], Format, NULL, NULL);
+		}
+
+		CloseSessionLogs(NumberOfLogs, &LogHandles);
+		goto Exit;
+	}
+
+	Status = RtlDosPathNameToNtPathName_U_WithStatus(
+		Arguments[1],
+		&LogFileNameNt,
+		NULL,
+		NULL);
+
+	if (!NT_SUCCESS(Status)) {
+		goto Exit;
+	}
+
+	InitializeObjectAttributes(&ObjectAttributes, &LogFileNameNt, OBJ_CASE_INSENSITIVE, NULL, NULL);
+
+	Status = VxlOpenLogEx(
+		&LogHandle,
+		NULL,
+		&ObjectAttributes,
+		GENERIC_READ,
+		FILE_OPEN,
+		0);
+
+	RtlFreeUnicodeString(&LogFileNameNt);
+
+	if (!NT_SUCCESS(Status)) {
+		goto Exit;
+	}
+
+	Status = ExportLogToFile(1, &LogHandle, Arguments[2], Format, NULL, NULL);
+	VxlCloseLog(&LogHandle);
+
+Exit:
+	LocalFree(Arguments);
+	return Status;
+}
+
+//
+// Add any source components which were found after the log was opened to
+// the filter list.
+//
+VOID UpdateSourceComponents(
+	VOID)
+{
+	if (IsLogFileOpened()) {
+		AddSourceComponents(State->LogHandle);
+	}
+}
+
+//
+// Pick up any entries which have been added to the log since it was opened.
+// Called periodically by the main window.
+//
+VOID CheckForNewLogEntries(
+	VOID)
+{
+	NTSTATUS Status;
+	LARGE_INTEGER Timeout;
+	ULONG NewNumberOfLogEntries;
+	ULONG FirstUnfilteredEntryIndex;
+
+	if (!IsLogFileOpened()) {
+		return;
+	}
+
+	if (!IsWindowEnabled(MainWindow)) {
+		// the log is being exported
+		return;
+	}
+
+	if (State->Session) {
+		// the logs in a folder aren't followed
+		return;
+	}
+
+	Timeout.QuadPart = 0;
+
+	Status = VxlWaitForNewEntries(
+		State->LogHandle,
+		State->NumberOfLogEntries,
+		&Timeout,
+		&NewNumberOfLogEntries);
+
+	// STATUS_TIMEOUT means there is nothing new.
+	if (Status != STATUS_SUCCESS) {
+		return;
+	}
+
+	//
+	// Only the new entries need to be filtered, unless the filters are still
+	// being run over the ones before them. The pass has to be stopped either
+	// way, since the cache is about to move.
+	//
+
+	if (State->FilterPass) {
+		FirstUnfilteredEntryIndex = State->FilterPass->FirstEntryIndex;
+	} else {
+		FirstUnfilteredEntryIndex = State->NumberOfLogEntries;
+	}
+
+	CancelFilterPass();
+	CancelSortPass();
+
+	if (!ResizeLogEntryCache(&State->LogEntryCache, State->NumberOfLogEntries, NewNumberOfLogEntries)) {
+		StartFilterPass(FirstUnfilteredEntryIndex);
+		StartSortPass();
+		return;
+	}
+
+	State->NumberOfLogEntries = NewNumberOfLogEntries;
+
+	StartFilterPass(FirstUnfilteredEntryIndex);
+	StartSortPass();
+	AddSourceComponents(State->LogHandle);
+
+	if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_SIMPLIFIED)) {
+		StatusBar_SetTextF(StatusBarWindow, 1, L"文件中有 %lu 个条目",
+						   State->NumberOfLogEntries);
+	} else if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_TRADITIONAL)) {
+		StatusBar_SetTextF(StatusBarWindow, 1, L"檔案中有 %lu 個條目",
+						   State->NumberOfLogEntries);
+	} else {
+		StatusBar_SetTextF(StatusBarWindow, 1, L"%lu entry(ies) in file",
+						   State->NumberOfLogEntries);
+	}
+}
+
 VOID SetBackendFilters(
 	IN	PBACKENDFILTERS	Filters)
 {
 	CopyMemory(&State->Filters, Filters, sizeof(*Filters));
 	RebuildFilterCache();
-	ListView_SetItemCount(ListViewWindow, State->EstimatedNumberOfFilteredLogEntries);
 }
 
-ULONG GetLogEntryRawIndex(
-	IN	ULONG	EntryIndex)
+//
+// Called when all the workers of a filter pass have finished (or straight
+// away, for small passes). Puts the results of the pass into the filtered
+// lookup table, in order, and updates the list view.
+//
+VOID FinishFilterPass(
+	IN	ULONG	Generation)
 {
-	ULONG DisplayIndex;
-	ULONG RawIndex;
+	PFILTERPASS FilterPass;
+	PULONG NewFilteredLookupCache;
+	ULONG NumberOfFilteredLogEntries;
+	ULONG Index;
+
+	FilterPass = State->FilterPass;
+
+	if (!FilterPass || FilterPass->Generation != Generation) {
+		// cancelled
+		return;
+	}
+
+	if (FilterPass->Failed) {
+		CancelFilterPass();
+		return;
+	}
 
 	//
-	// if we already cached this, we don't need to evaluate filters
+	// A pass which doesn't start at the beginning adds to the results which
+	// are already there.
 	//
-	if (State->FilteredLookupCache[EntryIndex] != ((ULONG) -1)) {
-		return State->FilteredLookupCache[EntryIndex];
+
+	if (FilterPass->FirstEntryIndex == 0) {
+		NumberOfFilteredLogEntries = 0;
+	} else {
+		NumberOfFilteredLogEntries = State->FilteredNumberOfLogEntries;
 	}
 
-	for (DisplayIndex = 0;
-		 DisplayIndex < State->EstimatedNumberOfFilteredLogEntries && DisplayIndex <= EntryIndex;
-		 DisplayIndex++) {
+	for (Index = 0; Index < FilterPass->NumberOfChunks; ++Index) {
+		NumberOfFilteredLogEntries += FilterPass->Chunks[Index].NumberOfMatches;
+	}
 
-		//
-		// Run every entry against the filters up to the requested display index,
-		// if it hasn't been filtered already.
-		//
-		if (State->FilteredLookupCache[DisplayIndex] != -1) {
-			continue;
-		}
+	if (FilterPass->FirstEntryIndex == 0) {
+		NewFilteredLookupCache = SafeAlloc(ULONG, max(NumberOfFilteredLogEntries, 1));
+	} else {
+		NewFilteredLookupCache = SafeReAlloc(State->FilteredLookupCache, ULONG, max(NumberOfFilteredLogEntries, 1));
+	}
 
-		if (DisplayIndex != 0) {
-			RawIndex = State->FilteredLookupCache[DisplayIndex - 1] + 1;
-		} else {
-			RawIndex = 0;
-		}
+	if (!NewFilteredLookupCache) {
+		CancelFilterPass();
+		return;
+	}
 
-		for (; RawIndex < State->NumberOfLogEntries; RawIndex++) {
-			PLOGENTRYCACHEENTRY CacheEntry;
+	if (FilterPass->FirstEntryIndex == 0) {
+		SafeFree(State->FilteredLookupCache);
+		State->FilteredNumberOfLogEntries = 0;
+	}
 
-			CacheEntry = GetLogEntryRaw(RawIndex);
+	State->FilteredLookupCache = NewFilteredLookupCache;
 
-			if (!CacheEntry) {
-				continue;
-			}
+	for (Index = 0; Index < FilterPass->NumberOfChunks; ++Index) {
+		PFILTERCHUNK Chunk;
 
-			if (LogEntryMatchesFilters(CacheEntry)) {
-				State->FilteredLookupCache[DisplayIndex] = RawIndex;
-				break;
-			}
+		Chunk = &FilterPass->Chunks[Index];
 
-			if (RawIndex == (State->NumberOfLogEntries - 1)) {
-				// we have reached the end, there are no more filtered entries
-				ListView_SetItemCountEx(ListViewWindow, DisplayIndex, LVSICF_NOINVALIDATEALL);
-			}
-		}
+		CopyMemory(
+			&State->FilteredLookupCache[State->FilteredNumberOfLogEntries],
+			Chunk->Matches,
+			Chunk->NumberOfMatches * sizeof(ULONG));
+
+		State->FilteredNumberOfLogEntries += Chunk->NumberOfMatches;
+	}
+
+	ASSERT (State->FilteredNumberOfLogEntries == NumberOfFilteredLogEntries);
+
+	// the order stays the same, but the entries which are shown don't
+	RebuildSortedLookupCache();
+
+	if (FilterPass->FirstEntryIndex == 0) {
+		ListView_SetItemCount(ListViewWindow, State->FilteredNumberOfLogEntries);
+	} else {
+		// Don't disturb the selection or the scroll position.
+		ListView_SetItemCountEx(
+			ListViewWindow,
+			State->FilteredNumberOfLogEntries,
+			LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL);
+	}
+
+	// nothing left to cancel, this just cleans up
+	CancelFilterPass();
+}
+
+ULONG GetLogEntryRawIndex(
+	IN	ULONG	EntryIndex)
+{
+	if (EntryIndex >= State->FilteredNumberOfLogEntries) {
+		return (ULONG) -1;
+	}
+
+	if (State->SortedLookupCache) {
+		return State->SortedLookupCache[EntryIndex];
 	}
 
 	return State->FilteredLookupCache[EntryIndex];
 }
 
-// This function is rather inefficient as it was hacked in after the core backend
-// was already designed. It's used for the Ctrl+G "go to raw entry" functionality.
+//
+// Used for the Ctrl+G "go to raw entry" functionality. The filtered lookup
+// table is in order of raw index, so it can be searched directly. When the
+// list is sorted, it has to be searched from start to end.
+//
 ULONG GetLogEntryIndexFromRawIndex(
 	IN	ULONG	RawIndex)
 {
-	ULONG RawIndexOfItem;
-	ULONG Index;
+	ULONG Low;
+	ULONG High;
+
+	if (State->SortedLookupCache) {
+		for (Low = 0; Low < State->FilteredNumberOfLogEntries; ++Low) {
+			if (State->SortedLookupCache[Low] == RawIndex) {
+				return Low;
+			}
+		}
 
-	Index = 0;
+		return (ULONG) -1;
+	}
+
+	Low = 0;
+	High = State->FilteredNumberOfLogEntries;
 
-	do {
-		RawIndexOfItem = GetLogEntryRawIndex(Index);
+	while (Low < High) {
+		ULONG Middle;
 
-		if (RawIndexOfItem == RawIndex) {
-			return Index;
+		Middle = Low + (High - Low) / 2;
+
+		if (State->FilteredLookupCache[Middle] < RawIndex) {
+			Low = Middle + 1;
+		} else {
+			High = Middle;
 		}
+	}
 
-		++Index;
-	} until (RawIndexOfItem == RawIndex || RawIndexOfItem == -1);
+	if (Low < State->FilteredNumberOfLogEntries && State->FilteredLookupCache[Low] == RawIndex) {
+		return Low;
+	}
 
 	return (ULONG) -1;
 }
 
 //
-// Get a log entry, respecting the current filters.
+// Called when the list view is about to ask for the rows from FirstEntryIndex
+// to LastEntryIndex (inclusive, respecting the current filters), so that they
+// can be read from the log in a few batches rather than one by one.
 //
-PLOGENTRYCACHEENTRY GetLogEntry(
-	IN	ULONG	EntryIndex)
+VOID PrefetchLogEntries(
+	IN	ULONG	FirstEntryIndex,
+	IN	ULONG	LastEntryIndex)
+{
+	ULONG EntryIndex;
+	ULONG LastRawIndex;
+
+	if (FirstEntryIndex > LastEntryIndex || LastEntryIndex >= State->FilteredNumberOfLogEntries) {
+		return;
+	}
+
+	LastRawIndex = GetLogEntryRawIndex(LastEntryIndex);
+
+	for (EntryIndex = FirstEntryIndex; EntryIndex <= LastEntryIndex; ++EntryIndex) {
+		ULONG RawIndex;
+
+		RawIndex = GetLogEntryRawIndex(EntryIndex);
+
+		if (State->LogEntryCache.Severity[RawIndex] == SEVERITY_NOT_LOADED) {
+			// Entries in between which are filtered out get loaded too, but
+			// that costs less than another trip to the log. When the list is
+			// sorted, the rows aren't in file order, but the sort has loaded
+			// all of the entries apart from the newest ones, which are.
+			LoadLogEntries(RawIndex, RawIndex <= LastRawIndex ? min(LastRawIndex - RawIndex + 1, LOAD_BATCH_SIZE) : 1);
+		}
+	}
+}
+
+//
+// Get a log entry, respecting the current filters. The text of the entry is
+// only valid until the next call.
+//
+BOOLEAN GetLogEntry(
+	IN	ULONG			EntryIndex,
+	OUT	PVXLLOGENTRY	LogEntry)
 {
 	ULONG RawIndex;
 
 	RawIndex = GetLogEntryRawIndex(EntryIndex);
 
 	if (RawIndex == -1) {
-		return NULL;
+		return FALSE;
 	}
 
-	return GetLogEntryRaw(RawIndex);
+	return GetLogEntryRaw(RawIndex, LogEntry, LogEntryTextBuffer, ARRAYSIZE(LogEntryTextBuffer));
 }
\ No newline at end of file
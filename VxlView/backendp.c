@@ -7,62 +7,314 @@
 // This file contains private functions of the backend.
 //
 
-NTSTATUS NTAPI ExportLogThreadProc(
-	IN	PVOID	Parameter)
+//
+// Pick an export format from the extension of the output file name.
+// Anything which isn't .csv or .jsonl is exported as text.
+//
+EXPORTFORMAT GetExportFormatFromFileName(
+	IN	PCWSTR	FileName)
+{
+	PCWSTR Extension;
+
+	Extension = PathFindExtension(FileName);
+
+	if (StringEqualI(Extension, L".csv")) {
+		return ExportFormatCsv;
+	} else if (StringEqualI(Extension, L".jsonl") || StringEqualI(Extension, L".json")) {
+		return ExportFormatJsonLines;
+	} else {
+		return ExportFormatText;
+	}
+}
+
+STATIC NTSTATUS WriteExportBuffer(
+	IN	HANDLE	FileHandle,
+	IN	PCVOID	Buffer,
+	IN	ULONG	BufferCb)
 {
-	NTSTATUS Status;
-	HANDLE FileHandle;
-	UNICODE_STRING TextFileNameNt;
-	OBJECT_ATTRIBUTES ObjectAttributes;
 	IO_STATUS_BLOCK IoStatusBlock;
-	PCWSTR TextFileNameWin32;
-	ULONG EntryIndex;
-	ULONG MaxEntryIndex;
-	ULONG SizeofMaxEntryIndex;
-	ULONG CompletedPercentage;
-	ULONG PreviousCompletedPercentage;
 
-	SetClassLongPtr(MainWindow, GCLP_HCURSOR, (LONG_PTR) LoadCursor(NULL, IDC_WAIT));
-	EnableWindow(MainWindow, FALSE);
+	if (BufferCb == 0) {
+		return STATUS_SUCCESS;
+	}
 
-	TextFileNameWin32 = (PCWSTR) Parameter;
-	EntryIndex = 0;
-	SizeofMaxEntryIndex = sizeof(MaxEntryIndex);
-	CompletedPercentage = 0;
-	PreviousCompletedPercentage = 0;
+	return NtWriteFile(
+		FileHandle,
+		NULL,
+		NULL,
+		NULL,
+		&IoStatusBlock,
+		(PVOID) Buffer,
+		BufferCb,
+		NULL,
+		NULL);
+}
 
-	//
-	// find out total number of log entries, for calculating percentage
-	//
+//
+// Write out the log entries (in the order given by MergedEntries) in the
+// text format which the export menu item has always produced: each entry is
+// exactly what the "copy" context menu item puts on the clipboard, in UTF-16,
+// without a byte order mark. The text is collected into EXPORT_BUFFER_SIZE
+// bytes and written out in one go.
+//
+STATIC NTSTATUS ExportTextEntries(
+	IN		PVXLHANDLE			LogHandles,
+	IN		PCVXLMERGEDENTRY	MergedEntries,
+	IN		ULONG				NumberOfMergedEntries,
+	IN		HANDLE				FileHandle,
+	IN OUT	PBYTE				Buffer,
+	IN OUT	PULONG				BufferCb,
+	IN		PWSTR				TextBuffer)
+{
+	NTSTATUS Status;
+	VXLLOGENTRYVIEW Views[LOAD_BATCH_SIZE];
+	SYSTEMTIME Times[LOAD_BATCH_SIZE];
+	ULONG NumberOfViews;
+	ULONG Position;
+	ULONG Index;
 
-	Status = VxlQueryInformationLog(
-		State->LogHandle,
-		LogTotalNumberOfEvents,
-		&MaxEntryIndex,
-		&SizeofMaxEntryIndex);
+	for (Position = 0; Position < NumberOfMergedEntries; Position += NumberOfViews) {
+		PCVXLMERGEDENTRY First;
+		VXLHANDLE LogHandle;
+		ULONG RunLength;
+
+		First = &MergedEntries[Position];
+		LogHandle = LogHandles[First->LogIndex];
+
+		for (RunLength = 1; RunLength < LOAD_BATCH_SIZE && Position + RunLength < NumberOfMergedEntries; ++RunLength) {
+			PCVXLMERGEDENTRY Next;
+
+			Next = &MergedEntries[Position + RunLength];
+
+			if (Next->LogIndex != First->LogIndex || Next->EntryIndex != First->EntryIndex + RunLength) {
+				break;
+			}
+		}
+
+		Status = VxlReadLogRange(
+			LogHandle,
+			First->EntryIndex,
+			RunLength,
+			Views,
+			&NumberOfViews,
+			TextBuffer,
+			VXL_READ_TEXT_BUFFER_CCH);
+
+		if (!NT_SUCCESS(Status)) {
+			return Status;
+		}
+
+		if (NumberOfViews == 0) {
+			return STATUS_INTERNAL_ERROR;
+		}
+
+		VxlConvertLogEntryTimes(NumberOfViews, Views, Times);
+
+		for (Index = 0; Index < NumberOfViews; ++Index) {
+			PCVXLLOGENTRYVIEW View;
+			VXLLOGENTRY LogEntry;
+			UNICODE_STRING ExportedText;
+			PCWSTR SourceComponent;
+			PCWSTR SourceFile;
+			PCWSTR SourceFunction;
+
+			View = &Views[Index];
+
+			if (View->Severity == LogSeverityInvalidValue) {
+				// couldn't be read
+				continue;
+			}
+
+			LogEntry.TextHeader = View->TextHeader;
+			LogEntry.Text = View->Text;
+			LogEntry.Severity = View->Severity;
+			LogEntry.SourceComponentIndex = View->SourceComponentIndex;
+			LogEntry.SourceFileIndex = View->SourceFileIndex;
+			LogEntry.SourceFunctionIndex = View->SourceFunctionIndex;
+			LogEntry.SourceLine = View->SourceLine;
+			LogEntry.ClientId.UniqueProcess = UlongToHandle(View->ProcessId);
+			LogEntry.ClientId.UniqueThread = UlongToHandle(View->ThreadId);
+			LogEntry.Time = Times[Index];
+
+			SourceComponent = VxlGetSourceString(LogHandle, VxlSourceComponent, View->SourceComponentIndex);
+			SourceFile = VxlGetSourceString(LogHandle, VxlSourceFile, View->SourceFileIndex);
+			SourceFunction = VxlGetSourceString(LogHandle, VxlSourceFunction, View->SourceFunctionIndex);
+
+			// Entries which are too long are cut short, as they always were.
+			FormatLogEntryText(
+				&LogEntry,
+				SourceComponent ? SourceComponent : L"",
+				SourceFile ? SourceFile : L"",
+				SourceFunction ? SourceFunction : L"",
+				&ExportedText,
+				FALSE);
+
+			if (!ExportedText.Buffer) {
+				return STATUS_NO_MEMORY;
+			}
+
+			if (*BufferCb + ExportedText.Length > EXPORT_BUFFER_SIZE) {
+				Status = WriteExportBuffer(FileHandle, Buffer, *BufferCb);
+				*BufferCb = 0;
+
+				if (!NT_SUCCESS(Status)) {
+					RtlFreeUnicodeString(&ExportedText);
+					return Status;
+				}
+			}
+
+			// An entry is never bigger than the buffer, since its length fits in a USHORT.
+			RtlCopyMemory(Buffer + *BufferCb, ExportedText.Buffer, ExportedText.Length);
+			*BufferCb += ExportedText.Length;
+			RtlFreeUnicodeString(&ExportedText);
+		}
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Export one or more logs in the viewer's own text format (see
+// ExportFormatText). A single log is written in file order, as it always
+// has been. Several logs are merged in time order.
+//
+STATIC NTSTATUS ExportLogAsText(
+	IN	ULONG							NumberOfLogs,
+	IN	PVXLHANDLE						LogHandles,
+	IN	HANDLE							FileHandle,
+	IN	PVXL_EXPORT_PROGRESS_ROUTINE	ProgressRoutine OPTIONAL,
+	IN	PVOID							ProgressContext OPTIONAL)
+{
+	NTSTATUS Status;
+	VXLMERGEHANDLE MergeHandle;
+	VXLMERGEDENTRY MergedEntries[LOAD_BATCH_SIZE];
+	ULONG NumberOfMergedEntries;
+	ULONG NumberOfEntries;
+	ULONG NumberOfEntriesWritten;
+	ULONG SizeOfNumberOfEntries;
+	PBYTE Buffer;
+	ULONG BufferCb;
+	PWSTR TextBuffer;
+	ULONG Index;
+
+	MergeHandle = NULL;
+	Buffer = NULL;
+	BufferCb = 0;
+	TextBuffer = NULL;
+	NumberOfEntriesWritten = 0;
+
+	if (NumberOfLogs > 1) {
+		Status = VxlCreateMergeStream(&MergeHandle, NumberOfLogs, LogHandles, &NumberOfEntries);
+	} else {
+		SizeOfNumberOfEntries = sizeof(NumberOfEntries);
+		Status = VxlQueryInformationLog(
+			LogHandles[0],
+			LogTotalNumberOfEvents,
+			&NumberOfEntries,
+			&SizeOfNumberOfEntries);
+	}
 
 	if (!NT_SUCCESS(Status)) {
-		goto Finished;
+		goto Exit;
 	}
 
-	// safe to do this because we refuse to open log files with no entries
-	--MaxEntryIndex;
+	Buffer = SafeAlloc(BYTE, EXPORT_BUFFER_SIZE);
+	TextBuffer = SafeAlloc(WCHAR, VXL_READ_TEXT_BUFFER_CCH);
 
-	//
-	// Convert win32 name to NT name and open the destination file
-	//
+	if (!Buffer || !TextBuffer) {
+		Status = STATUS_NO_MEMORY;
+		goto Exit;
+	}
+
+	while (NumberOfEntriesWritten < NumberOfEntries) {
+		if (MergeHandle) {
+			Status = VxlReadMergeStream(
+				MergeHandle,
+				ARRAYSIZE(MergedEntries),
+				MergedEntries,
+				&NumberOfMergedEntries);
+
+			if (!NT_SUCCESS(Status)) {
+				goto Exit;
+			}
+
+			if (NumberOfMergedEntries == 0) {
+				break;
+			}
+		} else {
+			NumberOfMergedEntries = min(NumberOfEntries - NumberOfEntriesWritten, ARRAYSIZE(MergedEntries));
+
+			for (Index = 0; Index < NumberOfMergedEntries; ++Index) {
+				MergedEntries[Index].LogIndex = 0;
+				MergedEntries[Index].EntryIndex = NumberOfEntriesWritten + Index;
+			}
+		}
+
+		Status = ExportTextEntries(
+			LogHandles,
+			MergedEntries,
+			NumberOfMergedEntries,
+			FileHandle,
+			Buffer,
+			&BufferCb,
+			TextBuffer);
+
+		if (!NT_SUCCESS(Status)) {
+			goto Exit;
+		}
+
+		NumberOfEntriesWritten += NumberOfMergedEntries;
+
+		if (ProgressRoutine && !ProgressRoutine(ProgressContext, NumberOfEntriesWritten, NumberOfEntries)) {
+			Status = STATUS_CANCELLED;
+			goto Exit;
+		}
+	}
+
+	Status = WriteExportBuffer(FileHandle, Buffer, BufferCb);
+
+Exit:
+	if (MergeHandle) {
+		VxlCloseMergeStream(&MergeHandle);
+	}
+
+	SafeFree(Buffer);
+	SafeFree(TextBuffer);
+
+	return Status;
+}
+
+//
+// Create (or overwrite) the output file and export a whole log into it.
+// If there are several logs, they are merged in time order. Used by both
+// the export menu item and the /EXPORT command line switch.
+//
+NTSTATUS ExportLogToFile(
+	IN	ULONG							NumberOfLogs,
+	IN	PVXLHANDLE						LogHandles,
+	IN	PCWSTR							FileNameWin32,
+	IN	EXPORTFORMAT					Format,
+	IN	PVXL_EXPORT_PROGRESS_ROUTINE	ProgressRoutine OPTIONAL,
+	IN	PVOID							ProgressContext OPTIONAL)
+{
+	NTSTATUS Status;
+	VXLEXPORTFORMAT VxlFormat;
+	HANDLE FileHandle;
+	UNICODE_STRING FileNameNt;
+	OBJECT_ATTRIBUTES ObjectAttributes;
+	IO_STATUS_BLOCK IoStatusBlock;
 
 	Status = RtlDosPathNameToNtPathName_U_WithStatus(
-		TextFileNameWin32,
-		&TextFileNameNt,
+		FileNameWin32,
+		&FileNameNt,
 		NULL,
 		NULL);
 
 	if (!NT_SUCCESS(Status)) {
-		goto Finished;
+		return Status;
 	}
 
-	InitializeObjectAttributes(&ObjectAttributes, &TextFileNameNt, OBJ_CASE_INSENSITIVE, NULL, NULL);
+	InitializeObjectAttributes(&ObjectAttributes, &FileNameNt, OBJ_CASE_INSENSITIVE, NULL, NULL);
 
 	Status = NtCreateFile(
 		&FileHandle,
@@ -73,75 +325,115 @@ NTSTATUS NTAPI ExportLogThreadProc(
 		FILE_ATTRIBUTE_NORMAL,
 		FILE_SHARE_READ,
 		FILE_OVERWRITE_IF,
-		FILE_NON_DIRECTORY_FILE,
+		FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT,
 		NULL,
 		0);
 
-	RtlFreeUnicodeString(&TextFileNameNt);
+	RtlFreeUnicodeString(&FileNameNt);
 
 	if (!NT_SUCCESS(Status)) {
-		goto Finished;
+		return Status;
 	}
 
-	//
-	// loop over every log entry, convert to text and write out to the file
-	//
+	switch (Format) {
+	case ExportFormatText:
+		Status = ExportLogAsText(
+			NumberOfLogs,
+			LogHandles,
+			FileHandle,
+			ProgressRoutine,
+			ProgressContext);
+
+		NtClose(FileHandle);
+		return Status;
+	case ExportFormatTextUtf8:
+		VxlFormat = VxlExportFormatText;
+		break;
+	case ExportFormatCsv:
+		VxlFormat = VxlExportFormatCsv;
+		break;
+	case ExportFormatJsonLines:
+		VxlFormat = VxlExportFormatJsonLines;
+		break;
+	default:
+		ASSUME (FALSE);
+	}
 
-	while (EntryIndex <= MaxEntryIndex) {
-		PLOGENTRYCACHEENTRY CacheEntry;
-		UNICODE_STRING ExportedText;
-		LONGLONG ByteOffset;
+	Status = VxlExportMergedLogs(
+		NumberOfLogs,
+		LogHandles,
+		FileHandle,
+		VxlFormat,
+		ProgressRoutine,
+		ProgressContext);
 
-		CacheEntry = GetLogEntryRaw(EntryIndex++);
-		ConvertCacheEntryToText(CacheEntry, &ExportedText, FALSE);
+	NtClose(FileHandle);
+	return Status;
+}
 
-		//
-		// Write out the text to the file.
-		//
+STATIC BOOLEAN NTAPI ExportLogProgressRoutine(
+	IN	PVOID	Context,
+	IN	ULONG	NumberOfEntriesWritten,
+	IN	ULONG	NumberOfEntries)
+{
+	PULONG PreviousCompletedPercentage;
+	ULONG CompletedPercentage;
 
-		ByteOffset = -1; // write at end of file
-		
-		// wait for previous write to complete before starting a new one
-		Status = NtWaitForSingleObject(FileHandle, FALSE, NULL);
-		ASSERT (Status == STATUS_SUCCESS);
+	PreviousCompletedPercentage = (PULONG) Context;
+	CompletedPercentage = (ULONG) ((ULONGLONG) NumberOfEntriesWritten * 100 / max(NumberOfEntries, 1));
+	ASSERT (CompletedPercentage <= 100);
 
-		Status = NtWriteFile(
-			FileHandle,
-			NULL,
-			NULL,
-			NULL,
-			&IoStatusBlock,
-			ExportedText.Buffer,
-			ExportedText.Length,
-			&ByteOffset,
-			NULL);
+	//
+	// Avoid expensive UI update if the percentage hasn't changed
+	//
 
-		RtlFreeUnicodeString(&ExportedText);
-		ASSERT (NT_SUCCESS(Status));
+	if (CompletedPercentage != *PreviousCompletedPercentage) {
+		if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_SIMPLIFIED)) SetWindowTextF(StatusBarWindow, L"正在导出日志条目。请稍候...（%ld%%）", CompletedPercentage);
+		else if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_TRADITIONAL)) SetWindowTextF(StatusBarWindow, L"正在導出日誌條目。請稍候...（%ld%%）", CompletedPercentage);
+		else SetWindowTextF(StatusBarWindow, L"Exporting log entries. Please wait... (%ld%%)", CompletedPercentage);
+		*PreviousCompletedPercentage = CompletedPercentage;
+	}
 
-		//
-		// Calculate percentage completed, for UI update
-		//
+	return TRUE;
+}
 
-		CompletedPercentage = (EntryIndex + 1) * 100 / (MaxEntryIndex + 1);
-		ASSERT (CompletedPercentage <= 100);
-		ASSERT (PreviousCompletedPercentage <= 100);
+NTSTATUS NTAPI ExportLogThreadProc(
+	IN	PVOID	Parameter)
+{
+	NTSTATUS Status;
+	PCEXPORTPARAMETERS Parameters;
+	ULONG PreviousCompletedPercentage;
+	ULONG NumberOfLogs;
+	PVXLHANDLE LogHandles;
 
-		//
-		// Avoid expensive UI update if the percentage hasn't changed
-		//
+	SetClassLongPtr(MainWindow, GCLP_HCURSOR, (LONG_PTR) LoadCursor(NULL, IDC_WAIT));
+	EnableWindow(MainWindow, FALSE);
 
-		if (CompletedPercentage != PreviousCompletedPercentage) {
-			if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_SIMPLIFIED)) SetWindowTextF(StatusBarWindow, L"正在导出日志条目。请稍候...（%ld%%）", CompletedPercentage);
-			else if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_TRADITIONAL)) SetWindowTextF(StatusBarWindow, L"正在導出日誌條目。請稍候...（%ld%%）", CompletedPercentage);
-			else SetWindowTextF(StatusBarWindow, L"Exporting log entries. Please wait... (%ld%%)", CompletedPercentage);
-			PreviousCompletedPercentage = CompletedPercentage;
-		}
+	Parameters = (PCEXPORTPARAMETERS) Parameter;
+	PreviousCompletedPercentage = 0;
+
+	//
+	// Apart from plain text, the entries are formatted and written out by
+	// KexDll on several threads. We only need to keep the status bar up to
+	// date.
+	//
+
+	if (State->Session) {
+		NumberOfLogs = State->Session->NumberOfLogs;
+		LogHandles = State->Session->LogHandles;
+	} else {
+		NumberOfLogs = 1;
+		LogHandles = &State->LogHandle;
 	}
 
-	NtClose(FileHandle);
+	Status = ExportLogToFile(
+		NumberOfLogs,
+		LogHandles,
+		Parameters->FileName,
+		Parameters->Format,
+		ExportLogProgressRoutine,
+		&PreviousCompletedPercentage);
 
-Finished:
 	EnableWindow(MainWindow, TRUE);
 	SetClassLongPtr(MainWindow, GCLP_HCURSOR, (LONG_PTR) LoadCursor(NULL, IDC_ARROW));
 
@@ -161,108 +453,379 @@ Finished:
 	return Status;
 }
 
+//
+// When a folder is open, the source indices in the cache refer to the
+// session's tables instead of the log's.
+//
+STATIC PCWSTR LookUpSourceString(
+	IN	VXLHANDLE		LogHandle,
+	IN	VXLSOURCETYPE	SourceType,
+	IN	ULONG			Index)
+{
+	if (State->Session) {
+		return GetSessionSourceString(State->Session, SourceType, Index);
+	}
+
+	return VxlGetSourceString(LogHandle, SourceType, Index);
+}
+
 VOID PopulateSourceComponents(
 	IN	VXLHANDLE	LogHandle)
 {
 	HWND SourceComponentListViewWindow;
-	ULONG Index;
 
 	SourceComponentListViewWindow = GetDlgItem(FilterWindow, IDC_COMPONENTLIST);
 	ListView_DeleteAllItems(SourceComponentListViewWindow);
+	AddSourceComponents(LogHandle);
+}
 
-	for (Index = 0; Index < ARRAYSIZE(LogHandle->Header->SourceComponents) &&
-					LogHandle->Header->SourceComponents[Index][0] != '\0'; ++Index) {
+//
+// Large logs are indexed in the background, so more source components can
+// turn up after the log has been opened. New components are shown checked.
+//
+VOID AddSourceComponents(
+	IN	VXLHANDLE	LogHandle)
+{
+	HWND SourceComponentListViewWindow;
+	ULONG Index;
+
+	SourceComponentListViewWindow = GetDlgItem(FilterWindow, IDC_COMPONENTLIST);
+	Index = ListView_GetItemCount(SourceComponentListViewWindow);
+
+	for (; LookUpSourceString(LogHandle, VxlSourceComponent, Index) != NULL; ++Index) {
 		LVITEM Item;
 
 		Item.mask = LVIF_TEXT;
 		Item.iItem = Index;
 		Item.iSubItem = 0;
-		Item.pszText = LogHandle->Header->SourceComponents[Index];
+		Item.pszText = (PWSTR) LookUpSourceString(LogHandle, VxlSourceComponent, Index);
 
 		ListView_InsertItem(SourceComponentListViewWindow, &Item);
 		ListView_SetCheckState(SourceComponentListViewWindow, Index, TRUE);
 	}
 }
 
-PLOGENTRYCACHEENTRY AddLogEntryToCache(
-	IN	ULONG			EntryIndex,
-	IN	PVXLLOGENTRY	LogEntry)
+//
+// Returns an empty string instead of NULL, so the result can always be
+// displayed.
+//
+PCWSTR GetSourceString(
+	IN	VXLSOURCETYPE	SourceType,
+	IN	ULONG			Index)
+{
+	PCWSTR String;
+
+	String = LookUpSourceString(State->LogHandle, SourceType, Index);
+
+	if (!String) {
+		return L"";
+	}
+
+	return String;
+}
+
+ULONG GetNumberOfSourceStrings(
+	IN	VXLSOURCETYPE	SourceType)
+{
+	ULONG Index;
+
+	if (State->Session) {
+		return State->Session->NumberOfSourceStrings[SourceType];
+	}
+
+	for (Index = 0; LookUpSourceString(State->LogHandle, SourceType, Index) != NULL; ++Index);
+	return Index;
+}
+
+STATIC BOOLEAN ResizeLogEntryCacheColumn(
+	IN OUT	PVOID	*Column,
+	IN		SIZE_T	ElementSize,
+	IN		ULONG	OldNumberOfLogEntries,
+	IN		ULONG	NewNumberOfLogEntries)
 {
-	PLOGENTRYCACHEENTRY CacheEntry;
-	WCHAR DateFormat[32];
-	WCHAR TimeFormat[32];
+	PBYTE NewColumn;
 
-	CacheEntry = SafeAlloc(LOGENTRYCACHEENTRY, 1);
-	if (!CacheEntry) {
-		return NULL;
+	if (*Column) {
+		NewColumn = SafeReAlloc(*Column, BYTE, NewNumberOfLogEntries * ElementSize);
+	} else {
+		NewColumn = SafeAlloc(BYTE, NewNumberOfLogEntries * ElementSize);
+	}
+
+	if (!NewColumn) {
+		return FALSE;
+	}
+
+	RtlZeroMemory(
+		NewColumn + OldNumberOfLogEntries * ElementSize,
+		(NewNumberOfLogEntries - OldNumberOfLogEntries) * ElementSize);
+
+	*Column = NewColumn;
+	return TRUE;
+}
+
+//
+// Make room in the log entry cache for NewNumberOfLogEntries entries. The
+// new entries are not loaded. If this fails, some of the arrays may have
+// been made bigger already, which does no harm.
+//
+BOOLEAN ResizeLogEntryCache(
+	IN OUT	PLOGENTRYCACHE	LogEntryCache,
+	IN		ULONG			OldNumberOfLogEntries,
+	IN		ULONG			NewNumberOfLogEntries)
+{
+	ASSERT (NewNumberOfLogEntries >= OldNumberOfLogEntries);
+
+	if (NewNumberOfLogEntries == OldNumberOfLogEntries) {
+		return TRUE;
 	}
 
-	RtlZeroMemory(CacheEntry, sizeof(*CacheEntry));
-	CacheEntry->LogEntry = *LogEntry;
-	
+	if (!ResizeLogEntryCacheColumn((PPVOID) &LogEntryCache->SourceComponentIndex, sizeof(USHORT), OldNumberOfLogEntries, NewNumberOfLogEntries) ||
+		!ResizeLogEntryCacheColumn((PPVOID) &LogEntryCache->SourceFileIndex, sizeof(USHORT), OldNumberOfLogEntries, NewNumberOfLogEntries) ||
+		!ResizeLogEntryCacheColumn((PPVOID) &LogEntryCache->SourceFunctionIndex, sizeof(USHORT), OldNumberOfLogEntries, NewNumberOfLogEntries) ||
+		!ResizeLogEntryCacheColumn((PPVOID) &LogEntryCache->SourceLine, sizeof(ULONG), OldNumberOfLogEntries, NewNumberOfLogEntries) ||
+		!ResizeLogEntryCacheColumn((PPVOID) &LogEntryCache->ProcessId, sizeof(ULONG), OldNumberOfLogEntries, NewNumberOfLogEntries) ||
+		!ResizeLogEntryCacheColumn((PPVOID) &LogEntryCache->ThreadId, sizeof(ULONG), OldNumberOfLogEntries, NewNumberOfLogEntries) ||
+		!ResizeLogEntryCacheColumn((PPVOID) &LogEntryCache->Time, sizeof(SYSTEMTIME), OldNumberOfLogEntries, NewNumberOfLogEntries) ||
+		!ResizeLogEntryCacheColumn((PPVOID) &LogEntryCache->TextHeader, sizeof(PCWSTR), OldNumberOfLogEntries, NewNumberOfLogEntries) ||
+		!ResizeLogEntryCacheColumn((PPVOID) &LogEntryCache->TextHeaderLength, sizeof(USHORT), OldNumberOfLogEntries, NewNumberOfLogEntries) ||
+		!ResizeLogEntryCacheColumn((PPVOID) &LogEntryCache->Text, sizeof(PCWSTR), OldNumberOfLogEntries, NewNumberOfLogEntries) ||
+		!ResizeLogEntryCacheColumn((PPVOID) &LogEntryCache->TextLength, sizeof(USHORT), OldNumberOfLogEntries, NewNumberOfLogEntries) ||
+		!ResizeLogEntryCacheColumn((PPVOID) &LogEntryCache->Severity, sizeof(UCHAR), OldNumberOfLogEntries, NewNumberOfLogEntries)) {
+
+		return FALSE;
+	}
+
+	FillMemory(
+		LogEntryCache->Severity + OldNumberOfLogEntries,
+		NewNumberOfLogEntries - OldNumberOfLogEntries,
+		SEVERITY_NOT_LOADED);
+
+	return TRUE;
+}
+
+VOID FreeLogEntryCache(
+	IN OUT	PLOGENTRYCACHE	LogEntryCache)
+{
+	SafeFree(LogEntryCache->Severity);
+	SafeFree(LogEntryCache->SourceComponentIndex);
+	SafeFree(LogEntryCache->SourceFileIndex);
+	SafeFree(LogEntryCache->SourceFunctionIndex);
+	SafeFree(LogEntryCache->SourceLine);
+	SafeFree(LogEntryCache->ProcessId);
+	SafeFree(LogEntryCache->ThreadId);
+	SafeFree(LogEntryCache->Time);
+	SafeFree(LogEntryCache->TextHeader);
+	SafeFree(LogEntryCache->TextHeaderLength);
+	SafeFree(LogEntryCache->Text);
+	SafeFree(LogEntryCache->TextLength);
+}
+
+VOID AddLogEntryToCache(
+	IN	ULONG				EntryIndex,
+	IN	PCVXLLOGENTRYVIEW	LogEntry,
+	IN	PSYSTEMTIME			Time)
+{
+	PLOGENTRYCACHE LogEntryCache;
+
+	LogEntryCache = &State->LogEntryCache;
+
 	//
-	// pre-calc some strings
+	// Filter workers and the UI thread may load the same entry at the same
+	// time, but they both write the same values, so that doesn't matter.
 	//
 
-	GetDateFormatEx(
-		LOCALE_NAME_USER_DEFAULT,
-		DATE_AUTOLAYOUT | DATE_SHORTDATE,
-		&LogEntry->Time,
-		NULL,
-		DateFormat,
-		ARRAYSIZE(DateFormat),
-		NULL);
+	LogEntryCache->SourceComponentIndex[EntryIndex] = LogEntry->SourceComponentIndex;
+	LogEntryCache->SourceFileIndex[EntryIndex] = LogEntry->SourceFileIndex;
+	LogEntryCache->SourceFunctionIndex[EntryIndex] = LogEntry->SourceFunctionIndex;
+	LogEntryCache->SourceLine[EntryIndex] = LogEntry->SourceLine;
+	LogEntryCache->ProcessId[EntryIndex] = LogEntry->ProcessId;
+	LogEntryCache->ThreadId[EntryIndex] = LogEntry->ThreadId;
+	LogEntryCache->Time[EntryIndex] = *Time;
+
+	if (LogEntry->TextIsTransient) {
+		LogEntryCache->TextHeader[EntryIndex] = NULL;
+		LogEntryCache->TextHeaderLength[EntryIndex] = TEXT_NOT_CACHED;
+		LogEntryCache->Text[EntryIndex] = NULL;
+		LogEntryCache->TextLength[EntryIndex] = 0;
+	} else {
+		LogEntryCache->TextHeader[EntryIndex] = LogEntry->TextHeader.Buffer;
+		LogEntryCache->TextHeaderLength[EntryIndex] = LogEntry->TextHeader.Length;
+		LogEntryCache->Text[EntryIndex] = LogEntry->Text.Buffer;
+		LogEntryCache->TextLength[EntryIndex] = LogEntry->Text.Length;
+	}
 
-	GetTimeFormatEx(
-		LOCALE_NAME_USER_DEFAULT,
-		TIME_NOTIMEMARKER | TIME_FORCE24HOURFORMAT,
-		&LogEntry->Time,
-		NULL,
-		TimeFormat,
-		ARRAYSIZE(CacheEntry->ShortDateTimeAsString));
+	// Volatile stores are release stores with MSVC, so anyone who sees the
+	// severity also sees everything above.
+	*((UCHAR VOLATILE *) &LogEntryCache->Severity[EntryIndex]) = (UCHAR) LogEntry->Severity;
+}
+
+//
+// Read the log entries in a range into the cache, unless they are there
+// already. Entries which can't be read are left out.
+//
+VOID LoadLogEntries(
+	IN	ULONG	FirstEntryIndex,
+	IN	ULONG	NumberOfEntries)
+{
+	NTSTATUS Status;
+	PLOGENTRYCACHE LogEntryCache;
+	VXLLOGENTRYVIEW LogEntries[LOAD_BATCH_SIZE];
+	SYSTEMTIME Times[LOAD_BATCH_SIZE];
+	ULONG NumberOfLogEntries;
+	ULONG EndEntryIndex;
+	ULONG EntryIndex;
+	ULONG Index;
 
-	StringCchPrintf(
-		CacheEntry->ShortDateTimeAsString,
-		ARRAYSIZE(CacheEntry->ShortDateTimeAsString),
-		L"%s %s", DateFormat, TimeFormat);
+	if (State->Session) {
+		LoadSessionLogEntries(FirstEntryIndex, NumberOfEntries);
+		return;
+	}
 
-	StringCchPrintf(
-		CacheEntry->SourceLineAsString,
-		ARRAYSIZE(CacheEntry->SourceLineAsString),
-		L"%lu", LogEntry->SourceLine);
+	LogEntryCache = &State->LogEntryCache;
+	EndEntryIndex = min(FirstEntryIndex + NumberOfEntries, State->NumberOfLogEntries);
+	EntryIndex = FirstEntryIndex;
 
-	State->LogEntryCache[EntryIndex] = CacheEntry;
-	return CacheEntry;
+	while (EntryIndex < EndEntryIndex) {
+		if (*((UCHAR VOLATILE *) &LogEntryCache->Severity[EntryIndex]) != SEVERITY_NOT_LOADED) {
+			++EntryIndex;
+			continue;
+		}
+
+		Status = VxlReadLogRange(
+			State->LogHandle,
+			EntryIndex,
+			min(EndEntryIndex - EntryIndex, LOAD_BATCH_SIZE),
+			LogEntries,
+			&NumberOfLogEntries,
+			NULL,
+			0);
+
+		if (!NT_SUCCESS(Status)) {
+			break;
+		}
+
+		VxlConvertLogEntryTimes(NumberOfLogEntries, LogEntries, Times);
+
+		for (Index = 0; Index < NumberOfLogEntries; ++Index) {
+			if (LogEntries[Index].Severity != LogSeverityInvalidValue) {
+				AddLogEntryToCache(EntryIndex + Index, &LogEntries[Index], &Times[Index]);
+			}
+		}
+
+		EntryIndex += NumberOfLogEntries;
+	}
+}
+
+//
+// Format the text of a deferred log entry (which the cache doesn't keep)
+// into TextBuffer. If that can't be done, the text is left empty.
+//
+STATIC VOID ReadLogEntryText(
+	IN	ULONG			EntryIndex,
+	OUT	PVXLLOGENTRY	LogEntry,
+	OUT	PWSTR			TextBuffer,
+	IN	ULONG			TextBufferCch)
+{
+	NTSTATUS Status;
+	VXLHANDLE LogHandle;
+	ULONG LogEntryIndex;
+	VXLLOGENTRYVIEW View;
+	ULONG NumberOfViews;
+
+	if (State->Session) {
+		PCVXLMERGEDENTRY MergedEntry;
+
+		MergedEntry = &State->Session->MergedOrder[EntryIndex];
+		LogHandle = State->Session->LogHandles[MergedEntry->LogIndex];
+		LogEntryIndex = MergedEntry->EntryIndex;
+	} else {
+		LogHandle = State->LogHandle;
+		LogEntryIndex = EntryIndex;
+	}
+
+	Status = VxlReadLogRange(
+		LogHandle,
+		LogEntryIndex,
+		1,
+		&View,
+		&NumberOfViews,
+		TextBuffer,
+		TextBufferCch);
+
+	if (NT_SUCCESS(Status) && NumberOfViews == 1 && View.TextHeader.Buffer != NULL) {
+		LogEntry->TextHeader = View.TextHeader;
+		LogEntry->Text = View.Text;
+	} else {
+		RtlInitUnicodeString(&LogEntry->TextHeader, L"");
+	}
 }
 
 //
 // Retrieve a log entry from the cache or from the log file.
 // This function does not apply any filters.
 //
-PLOGENTRYCACHEENTRY GetLogEntryRaw(
-	IN	ULONG	EntryIndex)
+// The text of deferred log entries is formatted into TextBuffer, and is only
+// valid until the buffer is used again. If there is no TextBuffer, their text
+// is left empty, which is fine for anyone who doesn't need to look at it.
+//
+BOOLEAN GetLogEntryRaw(
+	IN	ULONG			EntryIndex,
+	OUT	PVXLLOGENTRY	LogEntry,
+	OUT	PWSTR			TextBuffer OPTIONAL,
+	IN	ULONG			TextBufferCch)
 {
-	NTSTATUS Status;
-	PLOGENTRYCACHEENTRY CacheEntry;
+	PLOGENTRYCACHE LogEntryCache;
+	UCHAR Severity;
 
-	CacheEntry = State->LogEntryCache[EntryIndex];
+	LogEntryCache = &State->LogEntryCache;
+	Severity = *((UCHAR VOLATILE *) &LogEntryCache->Severity[EntryIndex]);
 
-	if (!CacheEntry) {
-		VXLLOGENTRY LogEntry;
+	if (Severity == SEVERITY_NOT_LOADED) {
+		LoadLogEntries(EntryIndex, 1);
+		Severity = *((UCHAR VOLATILE *) &LogEntryCache->Severity[EntryIndex]);
 
-		Status = VxlReadLog(State->LogHandle, EntryIndex, &LogEntry);
-		if (!NT_SUCCESS(Status)) {
-			return NULL;
+		if (Severity == SEVERITY_NOT_LOADED) {
+			// couldn't be read
+			return FALSE;
 		}
+	}
 
-		CacheEntry = AddLogEntryToCache(EntryIndex, &LogEntry);
+	LogEntry->Severity = (VXLSEVERITY) Severity;
+	LogEntry->SourceComponentIndex = LogEntryCache->SourceComponentIndex[EntryIndex];
+	LogEntry->SourceFileIndex = LogEntryCache->SourceFileIndex[EntryIndex];
+	LogEntry->SourceFunctionIndex = LogEntryCache->SourceFunctionIndex[EntryIndex];
+	LogEntry->SourceLine = LogEntryCache->SourceLine[EntryIndex];
+	LogEntry->ClientId.UniqueProcess = (HANDLE) LogEntryCache->ProcessId[EntryIndex];
+	LogEntry->ClientId.UniqueThread = (HANDLE) LogEntryCache->ThreadId[EntryIndex];
+	LogEntry->Time = LogEntryCache->Time[EntryIndex];
+
+	LogEntry->TextHeader.Buffer = (PWSTR) LogEntryCache->TextHeader[EntryIndex];
+	LogEntry->TextHeader.Length = LogEntryCache->TextHeaderLength[EntryIndex];
+	LogEntry->TextHeader.MaximumLength = LogEntry->TextHeader.Length + sizeof(WCHAR);
+
+	LogEntry->Text.Buffer = (PWSTR) LogEntryCache->Text[EntryIndex];
+	LogEntry->Text.Length = LogEntryCache->TextLength[EntryIndex];
+	LogEntry->Text.MaximumLength = LogEntry->Text.Buffer ? LogEntry->Text.Length + sizeof(WCHAR) : 0;
+
+	if (LogEntry->TextHeader.Length == TEXT_NOT_CACHED) {
+		if (TextBuffer && TextBufferCch != 0) {
+			ReadLogEntryText(EntryIndex, LogEntry, TextBuffer, TextBufferCch);
+		} else {
+			RtlInitUnicodeString(&LogEntry->TextHeader, L"");
+		}
 	}
 
-	return CacheEntry;
+	return TRUE;
 }
 
+//
+// TextSearcher, if present, is the text filter prepared by StartFilterPass.
+// It is only used for plain (not wildcard or exact) searches.
+//
 BOOLEAN LogEntryMatchesFilters(
-	IN	PLOGENTRYCACHEENTRY	CacheEntry)
+	IN	PCBACKENDFILTERS			Filters,
+	IN	PKEX_RTL_STRING_SEARCHER	TextSearcher OPTIONAL,
+	IN	PVXLLOGENTRY				LogEntry)
 {
 	BOOLEAN LogEntryMatchesTextFilter;
 
@@ -273,72 +836,77 @@ BOOLEAN LogEntryMatchesFilters(
 	//
 	// This function is one of the most critical when it comes to user experience,
 	// since it is called potentially hundreds of thousands of times when the user
-	// wants to search for text.
+	// wants to search for text. It is called from the filter worker threads, so it
+	// must not touch the global state.
 	//
 
 	// 1. Does the log entry match the severity filter? If not, then we don't display
 	//    this log entry.
-	if (State->Filters.SeverityFilters[CacheEntry->LogEntry.Severity] == FALSE) {
+	if (Filters->SeverityFilters[LogEntry->Severity] == FALSE) {
 		return FALSE;
 	}
 
 	// 2. Does this log entry match the source component filter? If not, then we don't
 	//    display this log entry.
-	if (State->Filters.ComponentFilters[CacheEntry->LogEntry.SourceComponentIndex] == FALSE) {
+	if (Filters->ComponentFilters[LogEntry->SourceComponentIndex] == FALSE) {
 		return FALSE;
 	}
 
 	// 3. Does this log entry match the text filter? Note: empty filter always matches.
 	LogEntryMatchesTextFilter = FALSE;
 
-	if (State->Filters.TextFilter.Length == 0) {
+	if (Filters->TextFilter.Length == 0) {
 		// empty filter
 		LogEntryMatchesTextFilter = TRUE;
 	} else {
 		PUNICODE_STRING TextToSearch;
 
-		TextToSearch = &CacheEntry->LogEntry.TextHeader;
+		TextToSearch = &LogEntry->TextHeader;
 
 SearchAgain:
-		if (State->Filters.TextFilterWildcardMatch) {
+		if (Filters->TextFilterWildcardMatch) {
 			LogEntryMatchesTextFilter = RtlIsNameInExpression(
-				&State->Filters.TextFilter,
+				&Filters->TextFilter,
 				TextToSearch,
-				!State->Filters.TextFilterCaseSensitive,
+				!Filters->TextFilterCaseSensitive,
 				NULL);
 		} else {
-			if (State->Filters.TextFilterCaseSensitive) {
-				if (State->Filters.TextFilterExact) {
-					if (StringEqual(TextToSearch->Buffer, State->Filters.TextFilter.Buffer)) {
+			if (TextSearcher && !Filters->TextFilterExact) {
+				if (KexRtlApplyStringSearcher(TextSearcher, TextToSearch)) {
+					LogEntryMatchesTextFilter = TRUE;
+				}
+			} else if (Filters->TextFilterCaseSensitive) {
+				if (Filters->TextFilterExact) {
+					if (StringEqual(TextToSearch->Buffer, Filters->TextFilter.Buffer)) {
 						LogEntryMatchesTextFilter = TRUE;
 					}
 				} else {
-					if (StringSearch(TextToSearch->Buffer, State->Filters.TextFilter.Buffer)) {
+					if (StringSearch(TextToSearch->Buffer, Filters->TextFilter.Buffer)) {
 						LogEntryMatchesTextFilter = TRUE;
 					}
 				}
 			} else {
-				if (State->Filters.TextFilterExact) {
-					if (StringEqualI(TextToSearch->Buffer, State->Filters.TextFilter.Buffer)) {
+				if (Filters->TextFilterExact) {
+					if (StringEqualI(TextToSearch->Buffer, Filters->TextFilter.Buffer)) {
 						LogEntryMatchesTextFilter = TRUE;
 					}
 				} else {
-					if (StringSearchI(TextToSearch->Buffer, State->Filters.TextFilter.Buffer)) {
+					if (StringSearchI(TextToSearch->Buffer, Filters->TextFilter.Buffer)) {
 						LogEntryMatchesTextFilter = TRUE;
 					}
 				}
 			}
 		}
 
-		if (State->Filters.TextFilterWhole && TextToSearch == &CacheEntry->LogEntry.TextHeader) {
-			if (CacheEntry->LogEntry.Text.Buffer != NULL) {
-				TextToSearch = &CacheEntry->LogEntry.Text;
+		if (Filters->TextFilterWhole && TextToSearch == &LogEntry->TextHeader) {
+			if (LogEntry->Text.Buffer != NULL) {
+				TextToSearch = &LogEntry->Text;
 				goto SearchAgain;
 			}
 		}
 	}
 
-	if (State->Filters.TextFilterInverted) {
+	if (Filters->TextFilterInverted) {
 		LogEntryMatchesTextFilter = !LogEntryMatchesTextFilter;
 	}
 
@@ -346,64 +914,398 @@ SearchAgain:
 }
 
 //
-// Returns an ESTIMATE of the number of log entries that will be displayed
-// by those filters. This estimate is not accurate for log files with many
-// entries, because creating an accurate value for the number of log entries
-// for any given filter requires evaluating the filter on all of the log
-// entries.
-// The estimate will always be equal to or greater than the actual number of
-// log entries that match the filters.
+// Run the filters over one chunk of a filter pass. Returns FALSE if the
+// pass was cancelled or there wasn't enough memory.
 //
-ULONG EstimateNumberOfFilteredLogEntries(
-	VOID)
+STATIC BOOLEAN FilterChunk(
+	IN	PFILTERPASS	FilterPass,
+	IN	ULONG		ChunkIndex,
+	IN	PWSTR		TextBuffer OPTIONAL)
+{
+	PFILTERCHUNK Chunk;
+	ULONG FirstPosition;
+	ULONG LastPosition;
+	ULONG Position;
+
+	//
+	// A chunk covers FILTER_CHUNK_SIZE positions, which are either entry
+	// indices counted from FirstEntryIndex or, if the text index has narrowed
+	// the pass down, positions in the list of candidates.
+	//
+
+	Chunk = &FilterPass->Chunks[ChunkIndex];
+	FirstPosition = ChunkIndex * FILTER_CHUNK_SIZE;
+	LastPosition = min(FirstPosition + FILTER_CHUNK_SIZE, FilterPass->NumberOfCandidates);
+
+	Chunk->Matches = SafeAlloc(ULONG, LastPosition - FirstPosition);
+	if (!Chunk->Matches) {
+		FilterPass->Failed = TRUE;
+		return FALSE;
+	}
+
+	for (Position = FirstPosition; Position < LastPosition; ++Position) {
+		VXLLOGENTRY LogEntry;
+		ULONG Index;
+
+		// check every so often whether the user has changed the filters again
+		if ((Position & 255) == 0 && FilterPass->Cancelled) {
+			return FALSE;
+		}
+
+		if (FilterPass->Candidates) {
+			Index = FilterPass->Candidates[Position];
+		} else {
+			Index = FilterPass->FirstEntryIndex + Position;
+
+			if ((Position % LOAD_BATCH_SIZE) == 0) {
+				LoadLogEntries(Index, min(LastPosition - Position, LOAD_BATCH_SIZE));
+			}
+		}
+
+		if (!GetLogEntryRaw(Index, &LogEntry, TextBuffer, TextBuffer ? VXL_READ_TEXT_BUFFER_CCH : 0)) {
+			// couldn't be read
+			continue;
+		}
+
+		if (LogEntryMatchesFilters(&FilterPass->Filters, FilterPass->TextSearcher, &LogEntry)) {
+			Chunk->Matches[Chunk->NumberOfMatches++] = Index;
+		}
+	}
+
+	return TRUE;
+}
+
+STATIC NTSTATUS NTAPI FilterWorkerThreadProc(
+	IN	PVOID	Parameter)
+{
+	PFILTERPASS FilterPass;
+	ULONG ChunkIndex;
+	PWSTR TextBuffer;
+
+	FilterPass = (PFILTERPASS) Parameter;
+	TextBuffer = NULL;
+
+	//
+	// Each worker needs a buffer of its own for the text of deferred log
+	// entries, but only if the filters look at the text at all.
+	//
+
+	if (FilterPass->Filters.TextFilter.Length != 0) {
+		TextBuffer = SafeAlloc(WCHAR, VXL_READ_TEXT_BUFFER_CCH);
+
+		if (!TextBuffer) {
+			FilterPass->Failed = TRUE;
+		}
+	}
+
+	until (FilterPass->Cancelled || FilterPass->Failed) {
+		ChunkIndex = InterlockedIncrement(&FilterPass->NextChunk) - 1;
+
+		if (ChunkIndex >= FilterPass->NumberOfChunks) {
+			break;
+		}
+
+		if (!FilterChunk(FilterPass, ChunkIndex, TextBuffer)) {
+			break;
+		}
+	}
+
+	SafeFree(TextBuffer);
+
+	//
+	// The last worker out lets the UI thread know. If the pass has been
+	// cancelled in the meantime, the generation won't match any more and
+	// the message is ignored.
+	//
+
+	if (InterlockedDecrement(&FilterPass->NumberOfActiveWorkers) == 0) {
+		PostMessage(MainWindow, WM_FILTERPASSCOMPLETE, FilterPass->Generation, 0);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Ask the text index of the log which entries can contain the text filter,
+// so that the filter pass only has to look at those. Entries which aren't
+// covered by the index yet (for example, the ones which have been added
+// since the log was opened) are always looked at. If the index can't be
+// used, the pass looks at every entry, as usual.
+//
+STATIC VOID GetTextFilterCandidates(
+	IN	PFILTERPASS	FilterPass)
+{
+	NTSTATUS Status;
+	PULONG IndexedCandidates;
+	ULONG NumberOfIndexedCandidates;
+	ULONG NumberOfIndexedEntries;
+	ULONG FirstUnindexedEntryIndex;
+	ULONG NumberOfCandidates;
+	ULONG Index;
+
+	if (KexRtlUnicodeStringCch(&FilterPass->Filters.TextFilter) < VXL_TEXT_INDEX_MINIMUM_QUERY_CCH) {
+		return;
+	}
+
+	if (State->Session) {
+		// the logs in a folder don't have text indexes
+		return;
+	}
+
+	Status = VxlQueryTextIndex(
+		State->LogHandle,
+		&FilterPass->Filters.TextFilter,
+		&IndexedCandidates,
+		&NumberOfIndexedCandidates,
+		&NumberOfIndexedEntries);
+
+	if (!NT_SUCCESS(Status)) {
+		// not built yet, or the log is too small to have one
+		return;
+	}
+
+	FirstUnindexedEntryIndex = max(FilterPass->FirstEntryIndex, NumberOfIndexedEntries);
+	FirstUnindexedEntryIndex = min(FirstUnindexedEntryIndex, FilterPass->NumberOfLogEntries);
+
+	FilterPass->Candidates = SafeAlloc(
+		ULONG,
+		NumberOfIndexedCandidates + (FilterPass->NumberOfLogEntries - FirstUnindexedEntryIndex));
+
+	if (!FilterPass->Candidates) {
+		SafeFree(IndexedCandidates);
+		return;
+	}
+
+	NumberOfCandidates = 0;
+
+	for (Index = 0; Index < NumberOfIndexedCandidates; ++Index) {
+		ULONG EntryIndex;
+
+		EntryIndex = IndexedCandidates[Index];
+
+		if (EntryIndex >= FilterPass->FirstEntryIndex && EntryIndex < FirstUnindexedEntryIndex) {
+			FilterPass->Candidates[NumberOfCandidates++] = EntryIndex;
+		}
+	}
+
+	for (Index = FirstUnindexedEntryIndex; Index < FilterPass->NumberOfLogEntries; ++Index) {
+		FilterPass->Candidates[NumberOfCandidates++] = Index;
+	}
+
+	FilterPass->NumberOfCandidates = NumberOfCandidates;
+	SafeFree(IndexedCandidates);
+}
+
+//
+// Wait for the workers of a filter pass to exit and free everything
+// belonging to it.
+//
+STATIC VOID DestroyFilterPass(
+	IN	PFILTERPASS	FilterPass)
 {
-	ULONG NumberOfFilteredLogEntries;
 	ULONG Index;
 
-	NumberOfFilteredLogEntries = 0;
+	if (FilterPass->NumberOfWorkers != 0) {
+		NtWaitForMultipleObjects(
+			FilterPass->NumberOfWorkers,
+			FilterPass->WorkerThreads,
+			WaitAllObject,
+			FALSE,
+			NULL);
+
+		for (Index = 0; Index < FilterPass->NumberOfWorkers; ++Index) {
+			NtClose(FilterPass->WorkerThreads[Index]);
+		}
+	}
+
+	if (FilterPass->Chunks) {
+		for (Index = 0; Index < FilterPass->NumberOfChunks; ++Index) {
+			SafeFree(FilterPass->Chunks[Index].Matches);
+		}
+	}
+
+	if (FilterPass->TextSearcher) {
+		KexRtlDeleteStringSearcher(&FilterPass->TextSearcher);
+	}
+
+	SafeFree(FilterPass->Candidates);
+	SafeFree(FilterPass->Chunks);
+	SafeFree(FilterPass->Filters.TextFilter.Buffer);
+	SafeFree(FilterPass);
+}
+
+//
+// Start running the current filters over the log entries from FirstEntryIndex
+// onwards, in the background. Any pass which is already running is cancelled.
+// The list view keeps showing the previous results until the new ones are
+// ready (see FinishFilterPass).
+//
+VOID StartFilterPass(
+	IN	ULONG	FirstEntryIndex)
+{
+	NTSTATUS Status;
+	PFILTERPASS FilterPass;
+	ULONG NumberOfWorkers;
+
+	CancelFilterPass();
+
+	FilterPass = SafeAlloc(FILTERPASS, 1);
+	if (!FilterPass) {
+		return;
+	}
+
+	RtlZeroMemory(FilterPass, sizeof(*FilterPass));
+	FilterPass->Generation = ++State->FilterPassGeneration;
+	FilterPass->FirstEntryIndex = FirstEntryIndex;
+	FilterPass->NumberOfLogEntries = State->NumberOfLogEntries;
+	ASSERT (FirstEntryIndex <= FilterPass->NumberOfLogEntries);
+
+	//
+	// The text filter buffer belongs to the filter controls, which free it
+	// the next time the filters change, so the pass needs its own copy.
+	//
+
+	FilterPass->Filters = State->Filters;
+	RtlInitEmptyUnicodeString(&FilterPass->Filters.TextFilter, NULL, 0);
+
+	if (State->Filters.TextFilter.Length != 0) {
+		PWSTR TextFilter;
+		USHORT TextFilterCb;
+
+		TextFilterCb = State->Filters.TextFilter.Length;
+		TextFilter = SafeAlloc(WCHAR, TextFilterCb / sizeof(WCHAR) + 1);
+
+		if (!TextFilter) {
+			SafeFree(FilterPass);
+			return;
+		}
+
+		CopyMemory(TextFilter, State->Filters.TextFilter.Buffer, TextFilterCb);
+		TextFilter[TextFilterCb / sizeof(WCHAR)] = '\0';
+		RtlInitEmptyUnicodeString(&FilterPass->Filters.TextFilter, TextFilter, TextFilterCb + sizeof(WCHAR));
+		FilterPass->Filters.TextFilter.Length = TextFilterCb;
 
-	if (State->NumberOfLogEntries < 2000000) {
 		//
-		// do an accurate estimate - evaluate all the entries
+		// Plain substring searches are done with a string searcher, which
+		// only has to look at the text filter once for the whole pass. If
+		// it can't be created, LogEntryMatchesFilters falls back to the
+		// plain string functions.
 		//
-		for (Index = 0; Index < State->NumberOfLogEntries; Index++) {
-			PLOGENTRYCACHEENTRY CacheEntry;
 
-			CacheEntry = GetLogEntryRaw(Index);
+		unless (FilterPass->Filters.TextFilterWildcardMatch || FilterPass->Filters.TextFilterExact) {
+			KexRtlCreateStringSearcher(
+				&FilterPass->TextSearcher,
+				&FilterPass->Filters.TextFilter,
+				FilterPass->Filters.TextFilterCaseSensitive ? 0 : KEX_RTL_STRING_SEARCHER_CASE_INSENSITIVE);
+		}
+	}
 
-			if (LogEntryMatchesFilters(CacheEntry)) {
-				NumberOfFilteredLogEntries++;
-			}
+	FilterPass->NumberOfCandidates = FilterPass->NumberOfLogEntries - FirstEntryIndex;
+
+	unless (FilterPass->Filters.TextFilterWildcardMatch || FilterPass->Filters.TextFilterInverted) {
+		GetTextFilterCandidates(FilterPass);
+	}
+
+	FilterPass->NumberOfChunks = (FilterPass->NumberOfCandidates + FILTER_CHUNK_SIZE - 1) / FILTER_CHUNK_SIZE;
+
+	if (FilterPass->NumberOfChunks != 0) {
+		FilterPass->Chunks = SafeAlloc(FILTERCHUNK, FilterPass->NumberOfChunks);
+
+		if (!FilterPass->Chunks) {
+			DestroyFilterPass(FilterPass);
+			return;
 		}
-	} else {
+
+		RtlZeroMemory(FilterPass->Chunks, FilterPass->NumberOfChunks * sizeof(FILTERCHUNK));
+	}
+
+	State->FilterPass = FilterPass;
+
+	//
+	// Small logs (and the entries added to a log since it was last looked at)
+	// are filtered right away. It isn't worth starting threads for them.
+	//
+
+	if (FilterPass->NumberOfChunks <= 1) {
+		if (FilterPass->NumberOfChunks == 1) {
+			FilterChunk(FilterPass, 0);
+		}
+
+		FinishFilterPass(FilterPass->Generation);
+		return;
+	}
+
+	NumberOfWorkers = min(NtCurrentPeb()->NumberOfProcessors, FilterPass->NumberOfChunks);
+	NumberOfWorkers = max(NumberOfWorkers, 1);
+	NumberOfWorkers = min(NumberOfWorkers, FILTER_MAXIMUM_WORKERS);
+	FilterPass->NumberOfActiveWorkers = NumberOfWorkers;
+
+	while (FilterPass->NumberOfWorkers < NumberOfWorkers) {
+		Status = RtlCreateUserThread(
+			NtCurrentProcess(),
+			NULL,
+			FALSE,
+			0,
+			0,
+			0,
+			FilterWorkerThreadProc,
+			FilterPass,
+			&FilterPass->WorkerThreads[FilterPass->NumberOfWorkers],
+			NULL);
+
+		if (!NT_SUCCESS(Status)) {
+			break;
+		}
+
+		++FilterPass->NumberOfWorkers;
+	}
+
+	if (FilterPass->NumberOfWorkers < NumberOfWorkers) {
 		//
-		// inaccurate estimate - just wing it
+		// Account for the workers which couldn't be started. If that leaves
+		// none running (either none started, or the ones which did have
+		// already run out of chunks), finish the pass on this thread.
 		//
-		for (Index = 0; Index < LogSeverityMaximumValue; Index++) {
-			if (State->Filters.SeverityFilters[Index]) {
-				NumberOfFilteredLogEntries += State->LogHandle->Header->EventSeverityTypeCount[Index];
-			}
+
+		if (InterlockedExchangeAdd(
+				&FilterPass->NumberOfActiveWorkers,
+				-(LONG) (NumberOfWorkers - FilterPass->NumberOfWorkers)) ==
+			(LONG) (NumberOfWorkers - FilterPass->NumberOfWorkers)) {
+
+			FilterPass->NumberOfActiveWorkers = 1;
+			FilterWorkerThreadProc(FilterPass);
+			return;
 		}
 	}
 
-	return NumberOfFilteredLogEntries;
+	SetClassLongPtr(MainWindow, GCLP_HCURSOR, (LONG_PTR) LoadCursor(NULL, IDC_APPSTARTING));
 }
 
-VOID RebuildFilterCache(
+//
+// Stop the filter pass which is in progress, if there is one, and throw away
+// its results. Must be called before the log entry cache is changed.
+//
+VOID CancelFilterPass(
 	VOID)
 {
-	ULONG EstimatedNumberOfFilteredLogEntries;
+	if (!State->FilterPass) {
+		return;
+	}
 
-	//
-	// clear the filtered entries lookup table
-	//
-	SafeFree(State->FilteredLookupCache);
+	State->FilterPass->Cancelled = TRUE;
+	DestroyFilterPass(State->FilterPass);
+	State->FilterPass = NULL;
 
-	//
-	// reallocate and initialize the lookup table
-	//
-	EstimatedNumberOfFilteredLogEntries = EstimateNumberOfFilteredLogEntries();
-	State->EstimatedNumberOfFilteredLogEntries = EstimatedNumberOfFilteredLogEntries;
-	State->FilteredLookupCache = SafeAlloc(ULONG, EstimatedNumberOfFilteredLogEntries);
-	FillMemory(State->FilteredLookupCache, EstimatedNumberOfFilteredLogEntries * sizeof(ULONG), 0xFF);
+	if (!State->SortPass) {
+		SetClassLongPtr(MainWindow, GCLP_HCURSOR, (LONG_PTR) LoadCursor(NULL, IDC_ARROW));
+	}
+}
+
+//
+// Run the current filters over all of the log entries.
+//
+VOID RebuildFilterCache(
+	VOID)
+{
+	StartFilterPass(0);
 }
\ No newline at end of file
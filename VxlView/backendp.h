@@ -4,16 +4,160 @@
 // Private header file for the backend.
 //
 
+#define FILTER_CHUNK_SIZE 16384				// entries filtered by one worker at a time
+#define FILTER_MAXIMUM_WORKERS 32
+#define LOAD_BATCH_SIZE 64					// entries read from the log at a time
+#define SORT_CHUNK_SIZE 65536				// entries sorted by one worker before the runs are merged
+#define SORT_MAXIMUM_WORKERS 32
+#define EXPORT_BUFFER_SIZE 0x100000			// bytes of text written to the file at a time
+
+//
+// The log entry cache keeps each field of VXLLOGENTRY in an array of its own,
+// indexed by raw entry index, rather than allocating a structure for every
+// entry. Text is not copied - the pointers stay valid until the log is closed.
+// The text of deferred entries (see VXL_OPEN_DEFERRED_FORMATTING) isn't kept
+// at all, since it would only stay valid until the next read. Its length is
+// TEXT_NOT_CACHED, and GetLogEntryRaw formats it again when it is needed.
+// An entry has been loaded once its severity is no longer SEVERITY_NOT_LOADED.
+// The severity is written last.
+//
+#define SEVERITY_NOT_LOADED 0xFF
+#define TEXT_NOT_CACHED 0xFFFF				// odd, so never the length of any text
+
+typedef struct {
+	PUCHAR Severity;
+	PUSHORT SourceComponentIndex;
+	PUSHORT SourceFileIndex;
+	PUSHORT SourceFunctionIndex;
+	PULONG SourceLine;
+	PULONG ProcessId;
+	PULONG ThreadId;
+	PSYSTEMTIME Time;
+	PPCWSTR TextHeader;
+	PUSHORT TextHeaderLength;
+	PPCWSTR Text;						// NULL if the entry has no body text
+	PUSHORT TextLength;
+} LOGENTRYCACHE, *PLOGENTRYCACHE, **PPLOGENTRYCACHE, *CONST PCLOGENTRYCACHE, **CONST PPCLOGENTRYCACHE;
+
+typedef struct {
+	ULONG NumberOfMatches;
+	PULONG Matches;						// raw indices of the matching entries, in order
+} FILTERCHUNK, *PFILTERCHUNK, **PPFILTERCHUNK, *CONST PCFILTERCHUNK, **CONST PPCFILTERCHUNK;
+
+//
+// One run of the filters over the log, split into chunks which are handed
+// out to worker threads. If FirstEntryIndex is not zero, the results are
+// appended to the current filtered lookup table instead of replacing it.
+//
+typedef struct {
+	ULONG Generation;					// identifies the pass in WM_FILTERPASSCOMPLETE
+	BACKENDFILTERS Filters;				// copy of the filters, including the text
+	PKEX_RTL_STRING_SEARCHER TextSearcher;	// prepared text filter, for plain substring searches
+	ULONG FirstEntryIndex;
+	ULONG NumberOfLogEntries;
+
+	PULONG Candidates;					// entries which can match, in order, or NULL for all of them
+	ULONG NumberOfCandidates;			// from FirstEntryIndex onwards
+
+	ULONG NumberOfChunks;
+	PFILTERCHUNK Chunks;
+	LONG VOLATILE NextChunk;
+
+	ULONG NumberOfWorkers;
+	LONG VOLATILE NumberOfActiveWorkers;
+	HANDLE WorkerThreads[FILTER_MAXIMUM_WORKERS];
+	BOOLEAN VOLATILE Cancelled;
+	BOOLEAN Failed;						// ran out of memory
+} FILTERPASS, *PFILTERPASS, **PPFILTERPASS, *CONST PCFILTERPASS, **CONST PPCFILTERPASS;
+
+//
+// One run of sorting (see sort.c). The entries from FirstEntryIndex onwards
+// are split into chunks, which the workers sort separately. The sorted chunks
+// are then merged in pairs, level by level, by whichever worker finishes the
+// second half of a pair. The merges go back and forth between the two Runs
+// buffers. If FirstEntryIndex is not zero, the result is finally merged into
+// the current sorted order of the entries before it.
+//
+typedef struct {
+	ULONG Generation;					// identifies the pass in WM_SORTPASSCOMPLETE
+	LOGENTRYSORTKEY SortKey;
+	BOOLEAN Descending;
+	ULONG FirstEntryIndex;
+	ULONG NumberOfLogEntries;
+
+	VXLSOURCETYPE RankedSourceType;		// for the sort keys which are source strings
+	ULONG NumberOfRanks;
+	PUSHORT Ranks;						// source string index -> position in alphabetical order
+
+	PULONGLONG Keys;					// sort key of each entry, from FirstEntryIndex onwards
+	PULONG Runs[2];						// raw indices, from FirstEntryIndex onwards
+	PCULONG PreviousOrder;				// State->SortedOrder when the pass was started
+	PULONG SortedOrder;					// the result, once the last merge is done
+
+	ULONG NumberOfChunks;
+	ULONG NumberOfLevels;				// levels of merges above the chunks
+	PLONG MergeCounters;				// halves of each pair which are finished
+	LONG VOLATILE NextChunk;
+
+	ULONG NumberOfWorkers;
+	LONG VOLATILE NumberOfActiveWorkers;
+	HANDLE WorkerThreads[SORT_MAXIMUM_WORKERS];
+	BOOLEAN VOLATILE Cancelled;
+	BOOLEAN Failed;						// ran out of memory
+} SORTPASS, *PSORTPASS, **PPSORTPASS, *CONST PCSORTPASS, **CONST PPCSORTPASS;
+
+// Passed to ExportLogThreadProc.
+typedef struct {
+	PCWSTR FileName;
+	EXPORTFORMAT Format;
+} EXPORTPARAMETERS, *PEXPORTPARAMETERS, **PPEXPORTPARAMETERS, *CONST PCEXPORTPARAMETERS, **CONST PPCEXPORTPARAMETERS;
+
+//
+// When a folder is opened, all of the logs in it are shown together, merged
+// in time order. Raw entry indices then go through MergedOrder, and the source
+// indices in the log entry cache refer to the session's own source tables, in
+// which each string appears only once, rather than to those of the logs.
+//
+#define SESSION_SOURCE_TYPES (VxlSourceFunction + 1)
+
 typedef struct {
-	VXLHANDLE LogHandle;
-	PPLOGENTRYCACHEENTRY LogEntryCache;	// Array of pointers to LOGENTRYCACHEENTRY structures. Some of the
-										// pointers may be NULL. The following condition holds:
-										//     if (LogEntryCache) {
-										//         DefHeapSize(LogEntryCache) / sizeof(PLOGENTRYCACHEENTRY) == NumberOfLogEntries;
-										//     }
+	ULONG NumberOfSourceStrings[SESSION_SOURCE_TYPES];
+	PUSHORT SourceIndexMap[SESSION_SOURCE_TYPES];		// index in the log -> index in the session
+} SESSIONLOG, *PSESSIONLOG, **PPSESSIONLOG, *CONST PCSESSIONLOG, **CONST PPCSESSIONLOG;
+
+typedef struct {
+	ULONG NumberOfLogs;
+	PVXLHANDLE LogHandles;
+	PSESSIONLOG Logs;
+	PVXLMERGEDENTRY MergedOrder;		// raw entry index -> entry of one of the logs
+	ULONG NumberOfSourceStrings[SESSION_SOURCE_TYPES];
+	PPCWSTR SourceStrings[SESSION_SOURCE_TYPES];		// point into the logs
+} LOGSESSION, *PLOGSESSION, **PPLOGSESSION, *CONST PCLOGSESSION, **CONST PPCLOGSESSION;
+
+typedef struct {
+	VXLHANDLE LogHandle;				// the first log of the session, if a folder is open
+	PLOGSESSION Session;				// only when a folder is open, otherwise NULL
+	LOGENTRYCACHE LogEntryCache;		// Each array has room for at least NumberOfLogEntries entries.
 	BACKENDFILTERS Filters;
-	ULONG EstimatedNumberOfFilteredLogEntries;
 	PULONG FilteredLookupCache;			// display entry -> cache entry lookup table
+	PFILTERPASS FilterPass;				// filter pass in progress, or NULL
+	ULONG FilterPassGeneration;
+
+	//
+	// The sorted order covers all of the entries, not just the ones which
+	// match the filters, so it doesn't have to be worked out again when the
+	// filters change. SortedLookupCache is the part of it which matches the
+	// filters, followed by the matching entries which haven't been sorted
+	// yet, in file order.
+	//
+
+	LOGENTRYSORTKEY SortKey;
+	BOOLEAN SortDescending;
+	PULONG SortedOrder;					// sorted raw indices of the first SortedNumberOfLogEntries entries
+	ULONG SortedNumberOfLogEntries;
+	PULONG SortedLookupCache;			// display entry -> cache entry lookup table, or NULL for file order
+	PSORTPASS SortPass;					// sort pass in progress, or NULL
+	ULONG SortPassGeneration;
 	
 	ULONG NumberOfLogEntries;			// number of log entries in the file
 	ULONG FilteredNumberOfLogEntries;	// number of log entries that are displayed by the user's filter selection
@@ -27,16 +171,85 @@ extern PBACKENDSTATE State;
 //
 // Private functions, defined in backendp.c
 //
+EXPORTFORMAT GetExportFormatFromFileName(
+	IN	PCWSTR	FileName);
+NTSTATUS ExportLogToFile(
+	IN	ULONG							NumberOfLogs,
+	IN	PVXLHANDLE						LogHandles,
+	IN	PCWSTR							FileNameWin32,
+	IN	EXPORTFORMAT					Format,
+	IN	PVXL_EXPORT_PROGRESS_ROUTINE	ProgressRoutine OPTIONAL,
+	IN	PVOID							ProgressContext OPTIONAL);
 NTSTATUS NTAPI ExportLogThreadProc(
 	IN	PVOID	Parameter);
 VOID PopulateSourceComponents(
 	IN	VXLHANDLE	LogHandle);
-PLOGENTRYCACHEENTRY GetLogEntryRaw(
-	IN	ULONG	EntryIndex);
-PLOGENTRYCACHEENTRY AddLogEntryToCache(
+VOID AddSourceComponents(
+	IN	VXLHANDLE	LogHandle);
+PCWSTR GetSourceString(
+	IN	VXLSOURCETYPE	SourceType,
+	IN	ULONG			Index);
+ULONG GetNumberOfSourceStrings(
+	IN	VXLSOURCETYPE	SourceType);
+BOOLEAN ResizeLogEntryCache(
+	IN OUT	PLOGENTRYCACHE	LogEntryCache,
+	IN		ULONG			OldNumberOfLogEntries,
+	IN		ULONG			NewNumberOfLogEntries);
+VOID FreeLogEntryCache(
+	IN OUT	PLOGENTRYCACHE	LogEntryCache);
+BOOLEAN GetLogEntryRaw(
 	IN	ULONG			EntryIndex,
-	IN	PVXLLOGENTRY	LogEntry);
+	OUT	PVXLLOGENTRY	LogEntry,
+	OUT	PWSTR			TextBuffer OPTIONAL,
+	IN	ULONG			TextBufferCch);
+VOID AddLogEntryToCache(
+	IN	ULONG				EntryIndex,
+	IN	PCVXLLOGENTRYVIEW	LogEntry,
+	IN	PSYSTEMTIME			Time);
+VOID LoadLogEntries(
+	IN	ULONG	FirstEntryIndex,
+	IN	ULONG	NumberOfEntries);
 VOID RebuildFilterCache(
 	VOID);
+VOID StartFilterPass(
+	IN	ULONG	FirstEntryIndex);
+VOID CancelFilterPass(
+	VOID);
 BOOLEAN LogEntryMatchesFilters(
-	IN	PLOGENTRYCACHEENTRY	CacheEntry);
\ No newline at end of file
+	IN	PCBACKENDFILTERS			Filters,
+	IN	PKEX_RTL_STRING_SEARCHER	TextSearcher OPTIONAL,
+	IN	PVXLLOGENTRY				LogEntry);
+
+//
+// Private functions, defined in session.c
+//
+NTSTATUS OpenSessionLogs(
+	IN	PCWSTR		DirectoryNameWin32,
+	OUT	PULONG		NumberOfLogs,
+	OUT	PPVXLHANDLE	LogHandles);
+VOID CloseSessionLogs(
+	IN		ULONG		NumberOfLogs,
+	IN OUT	PPVXLHANDLE	LogHandles);
+NTSTATUS OpenLogSession(
+	IN	PCWSTR			DirectoryNameWin32,
+	OUT	PPLOGSESSION	Session,
+	OUT	PULONG			NumberOfLogEntries);
+VOID CloseLogSession(
+	IN OUT	PPLOGSESSION	Session);
+PCWSTR GetSessionSourceString(
+	IN	PCLOGSESSION	Session,
+	IN	VXLSOURCETYPE	SourceType,
+	IN	ULONG			Index);
+VOID LoadSessionLogEntries(
+	IN	ULONG	FirstEntryIndex,
+	IN	ULONG	NumberOfEntries);
+
+//
+// Private functions, defined in sort.c
+//
+VOID StartSortPass(
+	VOID);
+VOID CancelSortPass(
+	VOID);
+VOID RebuildSortedLookupCache(
+	VOID);
\ No newline at end of file
@@ -31,6 +31,7 @@
 #define PROMPT_FOR_FILE_ON_STARTUP TRUE
 
 #pragma comment(lib, "shell32.lib")
+#pragma comment(lib, "ole32.lib")
 #pragma comment(lib, "uxtheme.lib")
 
 #define KEX_COMPONENT L"VxlView"
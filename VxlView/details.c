@@ -71,7 +71,7 @@ VOID PopulateDetailsWindow(
 {
 	WCHAR DateFormat[64];
 	WCHAR TimeFormat[32];
-	PLOGENTRYCACHEENTRY CacheEntry;
+	VXLLOGENTRY LogEntry;
 	HWND DetailsMessageTextWindow;
 	PCWSTR SourceFormattingText;
 
@@ -79,15 +79,14 @@ VOID PopulateDetailsWindow(
 	else if (CURRENTLANG == MAKELANGID(LANG_CHINESE, SUBLANG_CHINESE_TRADITIONAL)) SourceFormattingText = L"【%04lx：%04lx】，%s（%s，第 %lu 行，在函數 %s 中）";
 	else SourceFormattingText = L"[%04lx:%04lx], %s (%s, line %lu, in function %s)";
 
-	CacheEntry = GetLogEntry(EntryIndex);
-	if (!CacheEntry) {
+	if (!GetLogEntry(EntryIndex, &LogEntry)) {
 		return;
 	}
 
 	GetDateFormatEx(
 		LOCALE_NAME_USER_DEFAULT,
 		DATE_AUTOLAYOUT | DATE_LONGDATE,
-		&CacheEntry->LogEntry.Time,
+		&LogEntry.Time,
 		NULL,
 		DateFormat,
 		ARRAYSIZE(DateFormat),
@@ -96,34 +95,34 @@ VOID PopulateDetailsWindow(
 	GetTimeFormatEx(
 		LOCALE_NAME_USER_DEFAULT,
 		0,
-		&CacheEntry->LogEntry.Time,
+		&LogEntry.Time,
 		NULL,
 		TimeFormat,
 		ARRAYSIZE(TimeFormat));
 
 	SetDlgItemTextF(DetailsWindow, IDC_DETAILSSEVERITYTEXT, L"%s (%s)",
-					VxlSeverityToText(CacheEntry->LogEntry.Severity, FALSE),
-					VxlSeverityToText(CacheEntry->LogEntry.Severity, TRUE));
+					VxlSeverityToText(LogEntry.Severity, FALSE),
+					VxlSeverityToText(LogEntry.Severity, TRUE));
 
 	SetDlgItemTextF(DetailsWindow, IDC_DETAILSDATETIMETEXT, L"%s    %s", DateFormat, TimeFormat);
 	
 	SetDlgItemTextF(DetailsWindow, IDC_DETAILSSOURCETEXT, SourceFormattingText,
-					(ULONG) CacheEntry->LogEntry.ClientId.UniqueProcess,
-					(ULONG) CacheEntry->LogEntry.ClientId.UniqueThread,
-					State->LogHandle->Header->SourceComponents[CacheEntry->LogEntry.SourceComponentIndex],
-					State->LogHandle->Header->SourceFiles[CacheEntry->LogEntry.SourceFileIndex],
-					CacheEntry->LogEntry.SourceLine,
-					State->LogHandle->Header->SourceFunctions[CacheEntry->LogEntry.SourceFunctionIndex]);
+					(ULONG) LogEntry.ClientId.UniqueProcess,
+					(ULONG) LogEntry.ClientId.UniqueThread,
+					GetSourceString(VxlSourceComponent, LogEntry.SourceComponentIndex),
+					GetSourceString(VxlSourceFile, LogEntry.SourceFileIndex),
+					LogEntry.SourceLine,
+					GetSourceString(VxlSourceFunction, LogEntry.SourceFunctionIndex));
 
 	DetailsMessageTextWindow = GetDlgItem(DetailsWindow, IDC_DETAILSMESSAGETEXT);
-	SetWindowText(DetailsMessageTextWindow, CacheEntry->LogEntry.TextHeader.Buffer);
+	SetWindowText(DetailsMessageTextWindow, LogEntry.TextHeader.Buffer);
 
-	if (CacheEntry->LogEntry.Text.Length != 0) {
+	if (LogEntry.Text.Length != 0) {
 		// append the rest of the log entry text
 		Edit_SetSel(DetailsMessageTextWindow, INT_MAX, INT_MAX);
 		Edit_ReplaceSel(DetailsMessageTextWindow, L"\r\n\r\n");
 		Edit_SetSel(DetailsMessageTextWindow, INT_MAX, INT_MAX);
-		Edit_ReplaceSel(DetailsMessageTextWindow, CacheEntry->LogEntry.Text.Buffer);
+		Edit_ReplaceSel(DetailsMessageTextWindow, LogEntry.Text.Buffer);
 	}
 }
 
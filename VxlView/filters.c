@@ -202,6 +202,11 @@ VOID BuildBackendFilters(
 			ComponentListWindow, 
 			ListView_MapIDToIndex(ComponentListWindow, Index));
 	}
+
+	// components which aren't in the list yet are shown
+	for (; Index < ARRAYSIZE(Filters->ComponentFilters); ++Index) {
+		Filters->ComponentFilters[Index] = TRUE;
+	}
 }
 
 VOID UpdateFilters(
@@ -213,6 +218,7 @@ VOID UpdateFilters(
 		return;
 	}
 
+	UpdateSourceComponents();
 	BuildBackendFilters(&Filters);
 	SetBackendFilters(&Filters);
 }
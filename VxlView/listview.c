@@ -45,6 +45,17 @@ STATIC CONST USHORT ColumnDefaultWidths[] = {
 	90, 130, 80, 80, 40, 130, 500
 };
 
+// what clicking on each column header sorts by
+STATIC CONST LOGENTRYSORTKEY ColumnSortKeys[] = {
+	SortKeySeverity,
+	SortKeyDateTime,
+	SortKeySourceComponent,
+	SortKeySourceFile,
+	SortKeySourceLine,
+	SortKeySourceFunction,
+	SortKeyNone
+};
+
 STATIC CONST USHORT SeverityIcons[] = {
 	1027,		// Critical
 	98,			// Error
@@ -162,46 +173,98 @@ VOID ResetListView(
 }
 
 //
-// Called by MainWndProc when the list-view control wants data.
+// Called by MainWndProc when the list-view control wants data. The date and
+// source line are only formatted here, for the rows which are visible, into
+// the buffer which the list-view control supplies.
 //
 VOID PopulateListViewItem(
 	IN OUT	LPLVITEM	Item)
 {
-	PLOGENTRYCACHEENTRY CacheEntry;
+	VXLLOGENTRY LogEntry;
 
-	CacheEntry = GetLogEntry(Item->iItem);
-	if (!CacheEntry) {
+	if (!GetLogEntry(Item->iItem, &LogEntry)) {
 		return;
 	}
 
 	switch (Item->iSubItem) {
 	case ColumnSeverity:
-		Item->iImage = CacheEntry->LogEntry.Severity;
-		Item->pszText = (PWSTR) VxlSeverityToText(CacheEntry->LogEntry.Severity, FALSE);
+		Item->iImage = LogEntry.Severity;
+		Item->pszText = (PWSTR) VxlSeverityToText(LogEntry.Severity, FALSE);
 		break;
 	case ColumnDateTime:
-		Item->pszText = CacheEntry->ShortDateTimeAsString;
+		if (Item->mask & LVIF_TEXT) {
+			FormatShortDateTime(&LogEntry.Time, Item->pszText, Item->cchTextMax);
+		}
 		break;
 	case ColumnSourceComponent:
-		Item->pszText = State->LogHandle->Header->SourceComponents[CacheEntry->LogEntry.SourceComponentIndex];
+		Item->pszText = (PWSTR) GetSourceString(VxlSourceComponent, LogEntry.SourceComponentIndex);
 		break;
 	case ColumnSourceFile:
-		Item->pszText = State->LogHandle->Header->SourceFiles[CacheEntry->LogEntry.SourceFileIndex];
+		Item->pszText = (PWSTR) GetSourceString(VxlSourceFile, LogEntry.SourceFileIndex);
 		break;
 	case ColumnSourceLine:
-		Item->pszText = CacheEntry->SourceLineAsString;
+		if (Item->mask & LVIF_TEXT) {
+			StringCchPrintf(Item->pszText, Item->cchTextMax, L"%lu", LogEntry.SourceLine);
+		}
 		break;
 	case ColumnSourceFunction:
-		Item->pszText = State->LogHandle->Header->SourceFunctions[CacheEntry->LogEntry.SourceFunctionIndex];
+		Item->pszText = (PWSTR) GetSourceString(VxlSourceFunction, LogEntry.SourceFunctionIndex);
 		break;
 	case ColumnText:
-		Item->pszText = CacheEntry->LogEntry.TextHeader.Buffer;
+		Item->pszText = LogEntry.TextHeader.Buffer;
 		break;
 	default:
 		ASSUME (FALSE);
 	}
 }
 
+//
+// Sort by the specified key, or if the list is already sorted by it, turn
+// the order around.
+//
+STATIC VOID SortListView(
+	IN	LOGENTRYSORTKEY	SortKey)
+{
+	SortLogEntries(SortKey, SortKey == State->SortKey ? !State->SortDescending : FALSE);
+	UpdateListViewSortIndicators();
+}
+
+VOID HandleListViewColumnClick(
+	IN	ULONG	Column)
+{
+	if (Column >= ColumnMaxValue || ColumnSortKeys[Column] == SortKeyNone) {
+		return;
+	}
+
+	SortListView(ColumnSortKeys[Column]);
+}
+
+//
+// Show an arrow on the header of the column which the list is sorted by.
+//
+VOID UpdateListViewSortIndicators(
+	VOID)
+{
+	HWND ListViewHeaderWindow;
+	HDITEM HeaderItem;
+	ULONG Index;
+
+	ListViewHeaderWindow = ListView_GetHeader(ListViewWindow);
+
+	for (Index = 0; Index < ColumnMaxValue; ++Index) {
+		HeaderItem.mask = HDI_FORMAT;
+		Header_GetItem(ListViewHeaderWindow, Index, &HeaderItem);
+
+		HeaderItem.fmt &= ~(HDF_SORTUP | HDF_SORTDOWN);
+
+		if (State->SortKey != SortKeyNone && ColumnSortKeys[Index] == State->SortKey) {
+			HeaderItem.fmt |= State->SortDescending ? HDF_SORTDOWN : HDF_SORTUP;
+		}
+
+		Header_SetItem(ListViewHeaderWindow, Index, &HeaderItem);
+	}
+}
+
 VOID HandleListViewContextMenu(
 	IN	PPOINT	ClickPoint)
 {
@@ -214,14 +277,26 @@ VOID HandleListViewContextMenu(
 	HGLOBAL CopiedText;
 	UNICODE_STRING LogEntryText;
 	PWCHAR TextBuffer;
-	PLOGENTRYCACHEENTRY CacheEntry;
+	VXLLOGENTRY LogEntry;
 	ULONG MenuSelection;
 
 	ListViewHeaderWindow = ListView_GetHeader(ListViewWindow);
 	GetWindowRect(ListViewHeaderWindow, &ListViewHeaderWindowRect);
 
 	if (PtInRect(&ListViewHeaderWindowRect, *ClickPoint)) {
-		// user right clicked on the column headers
+		// user right clicked on the column headers - the fields which
+		// don't have a column can be sorted by from here
+		MenuSelection = ContextMenu(ListViewWindow, IDM_HEADERMENU, ClickPoint);
+
+		if (MenuSelection == M_SORTPROCESSID) {
+			SortListView(SortKeyProcessId);
+		} else if (MenuSelection == M_SORTTHREADID) {
+			SortListView(SortKeyThreadId);
+		} else if (MenuSelection == M_SORTNONE) {
+			SortLogEntries(SortKeyNone, FALSE);
+			UpdateListViewSortIndicators();
+		}
+
 		return;
 	}
 
@@ -240,13 +315,12 @@ VOID HandleListViewContextMenu(
 		return;
 	}
 
-	CacheEntry = GetLogEntry(EntryIndex);
-	if (!CacheEntry) {
+	if (!GetLogEntry(EntryIndex, &LogEntry)) {
 		return;
 	}
 
-	Status = ConvertCacheEntryToText(
-		CacheEntry,
+	Status = ConvertLogEntryToText(
+		&LogEntry,
 		&LogEntryText,
 		MenuSelection == M_COPYLONG ? TRUE : FALSE);
 
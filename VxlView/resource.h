@@ -38,6 +38,7 @@
 #define M_OPEN 202
 #define M_EXPORT 203
 #define M_EXIT 204
+#define M_OPENFOLDER 205
 #define M_COLUMNS 211
 #define M_ABOUT 221
 #define M_FIND 230
@@ -51,6 +52,11 @@
 #define M_COPY 261
 #define M_COPYLONG 262
 
+#define IDM_HEADERMENU 270
+#define M_SORTPROCESSID 271
+#define M_SORTTHREADID 272
+#define M_SORTNONE 273
+
 #define IDA_ACCELERATORS 300
 
 #define IDI_APPICON 501
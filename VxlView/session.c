@@ -0,0 +1,472 @@
+﻿#include "vxlview.h"
+#include "backendp.h"
+
+//
+// This file contains functions to open all of the logs in a folder, so that
+// they can be shown together. A program which starts other programs leaves
+// one log per process, and it is much easier to see what happened when the
+// entries of all of them are in one list, in the order they were written.
+//
+// The order is worked out once, when the folder is opened, with a merge
+// stream from KexDll. Only the order itself is kept (8 bytes per entry), so
+// this doesn't need much more memory than opening the biggest log on its own.
+//
+
+//
+// Open every .vxl file in a directory. The handles must be closed with
+// CloseSessionLogs, even if there are none.
+//
+NTSTATUS OpenSessionLogs(
+	IN	PCWSTR		DirectoryNameWin32,
+	OUT	PULONG		NumberOfLogs,
+	OUT	PPVXLHANDLE	LogHandles)
+{
+	NTSTATUS Status;
+	HANDLE FindHandle;
+	WIN32_FIND_DATA FindData;
+	WCHAR FileNameWin32[MAX_PATH];
+	ULONG MaximumNumberOfLogs;
+
+	*NumberOfLogs = 0;
+	*LogHandles = NULL;
+	MaximumNumberOfLogs = 0;
+
+	StringCchPrintf(FileNameWin32, ARRAYSIZE(FileNameWin32), L"%s\\*.vxl", DirectoryNameWin32);
+	FindHandle = FindFirstFile(FileNameWin32, &FindData);
+
+	if (FindHandle == INVALID_HANDLE_VALUE) {
+		return STATUS_NO_SUCH_FILE;
+	}
+
+	Status = STATUS_SUCCESS;
+
+	do {
+		UNICODE_STRING FileNameNt;
+		OBJECT_ATTRIBUTES ObjectAttributes;
+
+		if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			continue;
+		}
+
+		if (*NumberOfLogs == MaximumNumberOfLogs) {
+			PVXLHANDLE NewLogHandles;
+
+			MaximumNumberOfLogs = max(MaximumNumberOfLogs * 2, 16);
+
+			if (*LogHandles) {
+				NewLogHandles = SafeReAlloc(*LogHandles, VXLHANDLE, MaximumNumberOfLogs);
+			} else {
+				NewLogHandles = SafeAlloc(VXLHANDLE, MaximumNumberOfLogs);
+			}
+
+			if (!NewLogHandles) {
+				Status = STATUS_NO_MEMORY;
+				break;
+			}
+
+			*LogHandles = NewLogHandles;
+		}
+
+		StringCchPrintf(
+			FileNameWin32,
+			ARRAYSIZE(FileNameWin32),
+			L"%s\\%s",
+			DirectoryNameWin32,
+			FindData.cFileName);
+
+		Status = RtlDosPathNameToNtPathName_U_WithStatus(
+			FileNameWin32,
+			&FileNameNt,
+			NULL,
+			NULL);
+
+		if (!NT_SUCCESS(Status)) {
+			break;
+		}
+
+		InitializeObjectAttributes(&ObjectAttributes, &FileNameNt, OBJ_CASE_INSENSITIVE, NULL, NULL);
+
+		//
+		// The logs in a folder are not followed and don't get a text index.
+		// Entries added later wouldn't fit into the merged order, and the
+		// text index of one log is no use for searching all of them.
+		//
+
+		Status = VxlOpenLogEx(
+			&(*LogHandles)[*NumberOfLogs],
+			NULL,
+			&ObjectAttributes,
+			GENERIC_READ,
+			FILE_OPEN,
+			0);
+
+		RtlFreeUnicodeString(&FileNameNt);
+
+		if (!NT_SUCCESS(Status)) {
+			break;
+		}
+
+		++*NumberOfLogs;
+	} while (FindNextFile(FindHandle, &FindData));
+
+	FindClose(FindHandle);
+
+	if (NT_SUCCESS(Status) && *NumberOfLogs == 0) {
+		Status = STATUS_NO_SUCH_FILE;
+	}
+
+	return Status;
+}
+
+VOID CloseSessionLogs(
+	IN		ULONG		NumberOfLogs,
+	IN OUT	PPVXLHANDLE	LogHandles)
+{
+	ULONG Index;
+
+	if (!*LogHandles) {
+		return;
+	}
+
+	for (Index = 0; Index < NumberOfLogs; ++Index) {
+		VxlCloseLog(&(*LogHandles)[Index]);
+	}
+
+	SafeFree(*LogHandles);
+}
+
+//
+// Find a string in one of the session's source tables, adding it if it
+// isn't there yet. There are only a few hundred different source files and
+// functions in VxKex, so a linear search is fine.
+//
+STATIC USHORT AddSessionSourceString(
+	IN OUT	PLOGSESSION		Session,
+	IN		VXLSOURCETYPE	SourceType,
+	IN		PCWSTR			String)
+{
+	ULONG Index;
+	ULONG MaximumNumberOfStrings;
+
+	for (Index = 0; Index < Session->NumberOfSourceStrings[SourceType]; ++Index) {
+		if (StringEqual(Session->SourceStrings[SourceType][Index], String)) {
+			return (USHORT) Index;
+		}
+	}
+
+	if (SourceType == VxlSourceComponent) {
+		MaximumNumberOfStrings = ARRAYSIZE(State->Filters.ComponentFilters);
+	} else {
+		MaximumNumberOfStrings = (USHORT) -1;
+	}
+
+	if (Index >= MaximumNumberOfStrings) {
+		// Out of room. The source filters can't tell these apart anyway.
+		return (USHORT) (MaximumNumberOfStrings - 1);
+	}
+
+	Session->SourceStrings[SourceType][Index] = String;
+	Session->NumberOfSourceStrings[SourceType] = Index + 1;
+	return (USHORT) Index;
+}
+
+//
+// Build the tables which turn the source indices of each log into indices
+// into the session's source tables. This is done after the merged order has
+// been worked out, since by then every log has been read to the end and all
+// of their source strings are known.
+//
+STATIC NTSTATUS BuildSessionSourceTables(
+	IN OUT	PLOGSESSION	Session)
+{
+	VXLSOURCETYPE SourceType;
+	ULONG LogIndex;
+	ULONG Index;
+
+	for (SourceType = 0; SourceType < SESSION_SOURCE_TYPES; ++SourceType) {
+		ULONG TotalNumberOfStrings;
+
+		TotalNumberOfStrings = 0;
+
+		for (LogIndex = 0; LogIndex < Session->NumberOfLogs; ++LogIndex) {
+			PSESSIONLOG Log;
+
+			Log = &Session->Logs[LogIndex];
+
+			for (Index = 0; VxlGetSourceString(Session->LogHandles[LogIndex], SourceType, Index); ++Index);
+
+			Log->NumberOfSourceStrings[SourceType] = Index;
+			Log->SourceIndexMap[SourceType] = SafeAlloc(USHORT, max(Index, 1));
+
+			if (!Log->SourceIndexMap[SourceType]) {
+				return STATUS_NO_MEMORY;
+			}
+
+			TotalNumberOfStrings += Index;
+		}
+
+		Session->SourceStrings[SourceType] = SafeAlloc(PCWSTR, max(TotalNumberOfStrings, 1));
+
+		if (!Session->SourceStrings[SourceType]) {
+			return STATUS_NO_MEMORY;
+		}
+
+		for (LogIndex = 0; LogIndex < Session->NumberOfLogs; ++LogIndex) {
+			PSESSIONLOG Log;
+
+			Log = &Session->Logs[LogIndex];
+
+			for (Index = 0; Index < Log->NumberOfSourceStrings[SourceType]; ++Index) {
+				Log->SourceIndexMap[SourceType][Index] = AddSessionSourceString(
+					Session,
+					SourceType,
+					VxlGetSourceString(Session->LogHandles[LogIndex], SourceType, Index));
+			}
+		}
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Open all of the logs in a directory and work out the order in which
+// their entries are shown.
+//
+NTSTATUS OpenLogSession(
+	IN	PCWSTR			DirectoryNameWin32,
+	OUT	PPLOGSESSION	Session,
+	OUT	PULONG			NumberOfLogEntries)
+{
+	NTSTATUS Status;
+	PLOGSESSION NewSession;
+	VXLMERGEHANDLE MergeHandle;
+	ULONG NumberOfMergedEntries;
+
+	*Session = NULL;
+	*NumberOfLogEntries = 0;
+	MergeHandle = NULL;
+
+	NewSession = SafeAlloc(LOGSESSION, 1);
+	if (!NewSession) {
+		return STATUS_NO_MEMORY;
+	}
+
+	RtlZeroMemory(NewSession, sizeof(*NewSession));
+
+	Status = OpenSessionLogs(
+		DirectoryNameWin32,
+		&NewSession->NumberOfLogs,
+		&NewSession->LogHandles);
+
+	if (!NT_SUCCESS(Status)) {
+		goto Failure;
+	}
+
+	NewSession->Logs = SafeAlloc(SESSIONLOG, NewSession->NumberOfLogs);
+	if (!NewSession->Logs) {
+		Status = STATUS_NO_MEMORY;
+		goto Failure;
+	}
+
+	RtlZeroMemory(NewSession->Logs, NewSession->NumberOfLogs * sizeof(SESSIONLOG));
+
+	Status = VxlCreateMergeStream(
+		&MergeHandle,
+		NewSession->NumberOfLogs,
+		NewSession->LogHandles,
+		NumberOfLogEntries);
+
+	if (!NT_SUCCESS(Status)) {
+		goto Failure;
+	}
+
+	NewSession->MergedOrder = SafeAlloc(VXLMERGEDENTRY, max(*NumberOfLogEntries, 1));
+	if (!NewSession->MergedOrder) {
+		Status = STATUS_NO_MEMORY;
+		goto Failure;
+	}
+
+	NumberOfMergedEntries = 0;
+
+	while (NumberOfMergedEntries < *NumberOfLogEntries) {
+		ULONG NumberOfEntriesRead;
+
+		Status = VxlReadMergeStream(
+			MergeHandle,
+			*NumberOfLogEntries - NumberOfMergedEntries,
+			&NewSession->MergedOrder[NumberOfMergedEntries],
+			&NumberOfEntriesRead);
+
+		if (!NT_SUCCESS(Status)) {
+			goto Failure;
+		}
+
+		NumberOfMergedEntries += NumberOfEntriesRead;
+	}
+
+	VxlCloseMergeStream(&MergeHandle);
+
+	Status = BuildSessionSourceTables(NewSession);
+	if (!NT_SUCCESS(Status)) {
+		goto Failure;
+	}
+
+	*Session = NewSession;
+	return STATUS_SUCCESS;
+
+Failure:
+	VxlCloseMergeStream(&MergeHandle);
+	CloseLogSession(&NewSession);
+	*NumberOfLogEntries = 0;
+	return Status;
+}
+
+VOID CloseLogSession(
+	IN OUT	PPLOGSESSION	Session)
+{
+	PLOGSESSION SessionToClose;
+	ULONG SourceType;
+	ULONG LogIndex;
+
+	SessionToClose = *Session;
+
+	if (!SessionToClose) {
+		return;
+	}
+
+	if (SessionToClose->Logs) {
+		for (LogIndex = 0; LogIndex < SessionToClose->NumberOfLogs; ++LogIndex) {
+			for (SourceType = 0; SourceType < SESSION_SOURCE_TYPES; ++SourceType) {
+				SafeFree(SessionToClose->Logs[LogIndex].SourceIndexMap[SourceType]);
+			}
+		}
+	}
+
+	for (SourceType = 0; SourceType < SESSION_SOURCE_TYPES; ++SourceType) {
+		SafeFree(SessionToClose->SourceStrings[SourceType]);
+	}
+
+	CloseSessionLogs(SessionToClose->NumberOfLogs, &SessionToClose->LogHandles);
+	SafeFree(SessionToClose->Logs);
+	SafeFree(SessionToClose->MergedOrder);
+	SafeFree(*Session);
+}
+
+//
+// Returns NULL if there is no such string, like VxlGetSourceString.
+//
+PCWSTR GetSessionSourceString(
+	IN	PCLOGSESSION	Session,
+	IN	VXLSOURCETYPE	SourceType,
+	IN	ULONG			Index)
+{
+	if (SourceType < 0 || SourceType >= SESSION_SOURCE_TYPES) {
+		return NULL;
+	}
+
+	if (Index >= Session->NumberOfSourceStrings[SourceType]) {
+		return NULL;
+	}
+
+	return Session->SourceStrings[SourceType][Index];
+}
+
+STATIC USHORT TranslateSourceIndex(
+	IN	PCSESSIONLOG	Log,
+	IN	VXLSOURCETYPE	SourceType,
+	IN	ULONG			Index)
+{
+	if (Index < Log->NumberOfSourceStrings[SourceType]) {
+		return Log->SourceIndexMap[SourceType][Index];
+	}
+
+	// The log doesn't have a string for this index. Pick one which has no
+	// string in the session either, as long as it's in range for the
+	// component filters.
+	if (SourceType == VxlSourceComponent) {
+		return ARRAYSIZE(State->Filters.ComponentFilters) - 1;
+	} else {
+		return (USHORT) -1;
+	}
+}
+
+//
+// Same as LoadLogEntries, for when a folder is open. Entries which are next
+// to each other in the merged order and in the same log are read together.
+//
+VOID LoadSessionLogEntries(
+	IN	ULONG	FirstEntryIndex,
+	IN	ULONG	NumberOfEntries)
+{
+	NTSTATUS Status;
+	PLOGSESSION Session;
+	PLOGENTRYCACHE LogEntryCache;
+	VXLLOGENTRYVIEW LogEntries[LOAD_BATCH_SIZE];
+	SYSTEMTIME Times[LOAD_BATCH_SIZE];
+	ULONG NumberOfLogEntries;
+	ULONG EndEntryIndex;
+	ULONG EntryIndex;
+	ULONG Index;
+
+	Session = State->Session;
+	LogEntryCache = &State->LogEntryCache;
+	EndEntryIndex = min(FirstEntryIndex + NumberOfEntries, State->NumberOfLogEntries);
+	EntryIndex = FirstEntryIndex;
+
+	while (EntryIndex < EndEntryIndex) {
+		PCVXLMERGEDENTRY First;
+		PSESSIONLOG Log;
+		ULONG RunLength;
+
+		if (*((UCHAR VOLATILE *) &LogEntryCache->Severity[EntryIndex]) != SEVERITY_NOT_LOADED) {
+			++EntryIndex;
+			continue;
+		}
+
+		First = &Session->MergedOrder[EntryIndex];
+		Log = &Session->Logs[First->LogIndex];
+
+		for (RunLength = 1; RunLength < LOAD_BATCH_SIZE && EntryIndex + RunLength < EndEntryIndex; ++RunLength) {
+			PCVXLMERGEDENTRY Next;
+
+			Next = &Session->MergedOrder[EntryIndex + RunLength];
+
+			if (Next->LogIndex != First->LogIndex || Next->EntryIndex != First->EntryIndex + RunLength) {
+				break;
+			}
+		}
+
+		Status = VxlReadLogRange(
+			Session->LogHandles[First->LogIndex],
+			First->EntryIndex,
+			RunLength,
+			LogEntries,
+			&NumberOfLogEntries,
+			NULL,
+			0);
+
+		if (!NT_SUCCESS(Status) || NumberOfLogEntries == 0) {
+			break;
+		}
+
+		VxlConvertLogEntryTimes(NumberOfLogEntries, LogEntries, Times);
+
+		for (Index = 0; Index < NumberOfLogEntries; ++Index) {
+			PVXLLOGENTRYVIEW LogEntry;
+
+			LogEntry = &LogEntries[Index];
+
+			if (LogEntry->Severity == LogSeverityInvalidValue) {
+				continue;
+			}
+
+			LogEntry->SourceComponentIndex = TranslateSourceIndex(Log, VxlSourceComponent, LogEntry->SourceComponentIndex);
+			LogEntry->SourceFileIndex = TranslateSourceIndex(Log, VxlSourceFile, LogEntry->SourceFileIndex);
+			LogEntry->SourceFunctionIndex = TranslateSourceIndex(Log, VxlSourceFunction, LogEntry->SourceFunctionIndex);
+
+			AddLogEntryToCache(EntryIndex + Index, LogEntry, &Times[Index]);
+		}
+
+		EntryIndex += NumberOfLogEntries;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,869 @@
+﻿#include "vxlview.h"
+#include "backendp.h"
+
+//
+// This file contains functions to show the log entries sorted by one of
+// their fields, when the user clicks on a column header.
+//
+// Only an array of raw entry indices (4 bytes per entry) is sorted, never the
+// entries themselves, and it covers every entry of the log, so it stays valid
+// when the filters change: the filtered view is made by walking through it
+// and picking out the entries which match (see RebuildSortedLookupCache).
+// Entries which are added to the log later are sorted on their own and then
+// merged in.
+//
+// With millions of entries, sorting takes a while even when it is split
+// between all of the processors, so it is done in the background, the same
+// way as filtering. The list is shown in file order until it is finished.
+//
+
+//
+// Work out the key which an entry is sorted by. Entries with equal keys are
+// kept in file order, because the sort is stable and starts in file order.
+//
+STATIC ULONGLONG GetSortKey(
+	IN	PCSORTPASS	SortPass,
+	IN	ULONG		RawIndex)
+{
+	PLOGENTRYCACHE LogEntryCache;
+	ULONGLONG Key;
+	ULONG SourceIndex;
+	PSYSTEMTIME Time;
+
+	LogEntryCache = &State->LogEntryCache;
+
+	switch (SortPass->SortKey) {
+	case SortKeySeverity:
+		Key = LogEntryCache->Severity[RawIndex];
+		break;
+	case SortKeyDateTime:
+		Time = &LogEntryCache->Time[RawIndex];
+
+		Key = ((ULONGLONG) Time->wYear << 36) |
+			  ((ULONGLONG) Time->wMonth << 32) |
+			  ((ULONGLONG) Time->wDay << 27) |
+			  ((ULONGLONG) Time->wHour << 22) |
+			  ((ULONGLONG) Time->wMinute << 16) |
+			  ((ULONGLONG) Time->wSecond << 10) |
+			  Time->wMilliseconds;
+
+		break;
+	case SortKeySourceComponent:
+	case SortKeySourceFile:
+	case SortKeySourceFunction:
+		if (SortPass->SortKey == SortKeySourceComponent) {
+			SourceIndex = LogEntryCache->SourceComponentIndex[RawIndex];
+		} else if (SortPass->SortKey == SortKeySourceFile) {
+			SourceIndex = LogEntryCache->SourceFileIndex[RawIndex];
+		} else {
+			SourceIndex = LogEntryCache->SourceFunctionIndex[RawIndex];
+		}
+
+		if (SourceIndex < SortPass->NumberOfRanks) {
+			Key = SortPass->Ranks[SourceIndex];
+		} else {
+			// turned up after the pass was started - put it after the others
+			Key = 0x10000 + SourceIndex;
+		}
+
+		if (SortPass->SortKey == SortKeySourceFile) {
+			Key = (Key << 32) | LogEntryCache->SourceLine[RawIndex];
+		}
+
+		break;
+	case SortKeySourceLine:
+		Key = LogEntryCache->SourceLine[RawIndex];
+		break;
+	case SortKeyProcessId:
+		Key = LogEntryCache->ProcessId[RawIndex];
+		break;
+	case SortKeyThreadId:
+		Key = LogEntryCache->ThreadId[RawIndex];
+		break;
+	default:
+		ASSUME (FALSE);
+	}
+
+	if (SortPass->Descending) {
+		Key = ~Key;
+	}
+
+	return Key;
+}
+
+//
+// Sort the indices of source strings alphabetically.
+//
+STATIC VOID SortSourceStrings(
+	IN		PPCWSTR	Strings,
+	IN OUT	PUSHORT	Indices,
+	OUT		PUSHORT	Temporary,
+	IN		ULONG	NumberOfIndices)
+{
+	ULONG Middle;
+	ULONG Left;
+	ULONG Right;
+	ULONG Index;
+
+	if (NumberOfIndices < 2) {
+		return;
+	}
+
+	Middle = NumberOfIndices / 2;
+	SortSourceStrings(Strings, Indices, Temporary, Middle);
+	SortSourceStrings(Strings, Indices + Middle, Temporary, NumberOfIndices - Middle);
+
+	Left = 0;
+	Right = Middle;
+
+	for (Index = 0; Index < NumberOfIndices; ++Index) {
+		if (Right >= NumberOfIndices ||
+			(Left < Middle && lstrcmpi(Strings[Indices[Left]], Strings[Indices[Right]]) <= 0)) {
+
+			Temporary[Index] = Indices[Left++];
+		} else {
+			Temporary[Index] = Indices[Right++];
+		}
+	}
+
+	CopyMemory(Indices, Temporary, NumberOfIndices * sizeof(USHORT));
+}
+
+//
+// Entries are sorted by the name of their component, file or function, not
+// by its index (which only depends on which one was logged first), so find
+// out where each of the names comes in alphabetical order.
+//
+STATIC BOOLEAN RankSourceStrings(
+	IN OUT	PSORTPASS		SortPass,
+	IN		VXLSOURCETYPE	SourceType)
+{
+	PPCWSTR Strings;
+	PUSHORT Indices;
+	PUSHORT Temporary;
+	ULONG NumberOfStrings;
+	ULONG Index;
+
+	NumberOfStrings = min(GetNumberOfSourceStrings(SourceType), 0x10000);
+
+	SortPass->RankedSourceType = SourceType;
+	SortPass->NumberOfRanks = NumberOfStrings;
+	SortPass->Ranks = SafeAlloc(USHORT, max(NumberOfStrings, 1));
+	Strings = SafeAlloc(PCWSTR, max(NumberOfStrings, 1));
+	Indices = SafeAlloc(USHORT, max(NumberOfStrings, 1));
+	Temporary = SafeAlloc(USHORT, max(NumberOfStrings, 1));
+
+	if (!SortPass->Ranks || !Strings || !Indices || !Temporary) {
+		SafeFree(Strings);
+		SafeFree(Indices);
+		SafeFree(Temporary);
+		return FALSE;
+	}
+
+	for (Index = 0; Index < NumberOfStrings; ++Index) {
+		Strings[Index] = GetSourceString(SourceType, Index);
+		Indices[Index] = (USHORT) Index;
+	}
+
+	SortSourceStrings(Strings, Indices, Temporary, NumberOfStrings);
+
+	for (Index = 0; Index < NumberOfStrings; ++Index) {
+		SortPass->Ranks[Indices[Index]] = (USHORT) Index;
+	}
+
+	SafeFree(Strings);
+	SafeFree(Indices);
+	SafeFree(Temporary);
+	return TRUE;
+}
+
+//
+// Merge two sorted runs of raw indices. When the keys are equal, the entry
+// from the left run goes first, which keeps the sort stable.
+//
+STATIC VOID MergeSortRuns(
+	IN	PCSORTPASS	SortPass,
+	IN	PCULONG		Left,
+	IN	ULONG		LeftCount,
+	IN	PCULONG		Right,
+	IN	ULONG		RightCount,
+	OUT	PULONG		Output)
+{
+	PULONGLONG Keys;
+	ULONG FirstEntryIndex;
+
+	Keys = SortPass->Keys;
+	FirstEntryIndex = SortPass->FirstEntryIndex;
+
+	//
+	// Log entries are mostly sorted by time already, and often by process
+	// and thread too, so check whether the runs are in order as they are.
+	//
+
+	if (LeftCount != 0 && RightCount != 0 &&
+		Keys[Left[LeftCount - 1] - FirstEntryIndex] <= Keys[Right[0] - FirstEntryIndex]) {
+
+		CopyMemory(Output, Left, LeftCount * sizeof(ULONG));
+		CopyMemory(Output + LeftCount, Right, RightCount * sizeof(ULONG));
+		return;
+	}
+
+	while (LeftCount != 0 && RightCount != 0) {
+		if (Keys[*Right - FirstEntryIndex] < Keys[*Left - FirstEntryIndex]) {
+			*Output++ = *Right++;
+			--RightCount;
+		} else {
+			*Output++ = *Left++;
+			--LeftCount;
+		}
+	}
+
+	CopyMemory(Output, Left, LeftCount * sizeof(ULONG));
+	CopyMemory(Output + LeftCount, Right, RightCount * sizeof(ULONG));
+}
+
+//
+// Work out the keys of the entries in one chunk and sort it. Returns FALSE
+// if the pass was cancelled.
+//
+STATIC BOOLEAN SortChunk(
+	IN	PSORTPASS	SortPass,
+	IN	ULONG		ChunkIndex)
+{
+	ULONG NumberOfEntries;
+	ULONG FirstPosition;
+	ULONG LastPosition;
+	ULONG Position;
+	PULONG Source;
+	PULONG Target;
+	ULONG Width;
+
+	NumberOfEntries = SortPass->NumberOfLogEntries - SortPass->FirstEntryIndex;
+	FirstPosition = ChunkIndex * SORT_CHUNK_SIZE;
+	LastPosition = min(FirstPosition + SORT_CHUNK_SIZE, NumberOfEntries);
+
+	for (Position = FirstPosition; Position < LastPosition; ++Position) {
+		ULONG RawIndex;
+
+		RawIndex = SortPass->FirstEntryIndex + Position;
+
+		if (((Position - FirstPosition) % LOAD_BATCH_SIZE) == 0) {
+			if (SortPass->Cancelled) {
+				return FALSE;
+			}
+
+			LoadLogEntries(RawIndex, min(LastPosition - Position, LOAD_BATCH_SIZE));
+		}
+
+		SortPass->Keys[Position] = GetSortKey(SortPass, RawIndex);
+		SortPass->Runs[0][Position] = RawIndex;
+	}
+
+	//
+	// Sort small runs by insertion, and then merge them in pairs back and
+	// forth between the two buffers until the chunk is one run.
+	//
+
+	Source = SortPass->Runs[0] + FirstPosition;
+	Target = SortPass->Runs[1] + FirstPosition;
+	NumberOfEntries = LastPosition - FirstPosition;
+
+	for (Position = 0; Position < NumberOfEntries; Position += 16) {
+		ULONG RunEnd;
+		ULONG Index;
+
+		RunEnd = min(Position + 16, NumberOfEntries);
+
+		for (Index = Position + 1; Index < RunEnd; ++Index) {
+			ULONG RawIndex;
+			ULONGLONG Key;
+			ULONG Hole;
+
+			RawIndex = Source[Index];
+			Key = SortPass->Keys[RawIndex - SortPass->FirstEntryIndex];
+
+			for (Hole = Index; Hole > Position; --Hole) {
+				if (SortPass->Keys[Source[Hole - 1] - SortPass->FirstEntryIndex] <= Key) {
+					break;
+				}
+
+				Source[Hole] = Source[Hole - 1];
+			}
+
+			Source[Hole] = RawIndex;
+		}
+	}
+
+	for (Width = 16; Width < NumberOfEntries; Width *= 2) {
+		PULONG Swap;
+
+		if (SortPass->Cancelled) {
+			return FALSE;
+		}
+
+		for (Position = 0; Position < NumberOfEntries; Position += 2 * Width) {
+			ULONG Middle;
+			ULONG End;
+
+			Middle = min(Position + Width, NumberOfEntries);
+			End = min(Position + 2 * Width, NumberOfEntries);
+
+			MergeSortRuns(
+				SortPass,
+				Source + Position, Middle - Position,
+				Source + Middle, End - Middle,
+				Target + Position);
+		}
+
+		Swap = Source;
+		Source = Target;
+		Target = Swap;
+	}
+
+	if (Source != SortPass->Runs[0] + FirstPosition) {
+		CopyMemory(SortPass->Runs[0] + FirstPosition, Source, NumberOfEntries * sizeof(ULONG));
+	}
+
+	return TRUE;
+}
+
+//
+// Number of runs at a level of merges. Level 0 is the sorted chunks.
+//
+STATIC ULONG GetNumberOfRunsAtLevel(
+	IN	PCSORTPASS	SortPass,
+	IN	ULONG		Level)
+{
+	return ((SortPass->NumberOfChunks - 1) >> Level) + 1;
+}
+
+//
+// Merge the two halves of a run at one level up from them (or copy the run,
+// if it only has one half). Runs at even levels are in Runs[0] and runs at
+// odd levels are in Runs[1].
+//
+STATIC VOID MergeRunAtLevel(
+	IN	PSORTPASS	SortPass,
+	IN	ULONG		Level,
+	IN	ULONG		RunIndex)
+{
+	ULONG NumberOfEntries;
+	ULONG FirstChunk;
+	ULONG MiddleChunk;
+	ULONG LastChunk;
+	ULONG FirstPosition;
+	ULONG MiddlePosition;
+	ULONG LastPosition;
+	PULONG Source;
+	PULONG Target;
+
+	NumberOfEntries = SortPass->NumberOfLogEntries - SortPass->FirstEntryIndex;
+
+	FirstChunk = RunIndex << Level;
+	MiddleChunk = min(FirstChunk + (1 << (Level - 1)), SortPass->NumberOfChunks);
+	LastChunk = min(FirstChunk + (1 << Level), SortPass->NumberOfChunks);
+
+	FirstPosition = FirstChunk * SORT_CHUNK_SIZE;
+	MiddlePosition = min(MiddleChunk * SORT_CHUNK_SIZE, NumberOfEntries);
+	LastPosition = min(LastChunk * SORT_CHUNK_SIZE, NumberOfEntries);
+
+	Source = SortPass->Runs[(Level - 1) & 1];
+	Target = SortPass->Runs[Level & 1];
+
+	MergeSortRuns(
+		SortPass,
+		Source + FirstPosition, MiddlePosition - FirstPosition,
+		Source + MiddlePosition, LastPosition - MiddlePosition,
+		Target + FirstPosition);
+}
+
+//
+// Merge the newly sorted entries into the order of the entries which were
+// sorted before. There are usually only a few new ones (the ones which have
+// been added to the log since it was last looked at), so each of them is
+// put in its place with a binary search and the old entries in between are
+// copied across in one go.
+//
+STATIC BOOLEAN MergeWithPreviousOrder(
+	IN	PSORTPASS	SortPass,
+	IN	PCULONG		Run)
+{
+	ULONG NumberOfEntries;
+	ULONG PreviousPosition;
+	ULONG OutputPosition;
+	ULONG Position;
+
+	NumberOfEntries = SortPass->NumberOfLogEntries - SortPass->FirstEntryIndex;
+	SortPass->SortedOrder = SafeAlloc(ULONG, SortPass->NumberOfLogEntries);
+
+	if (!SortPass->SortedOrder) {
+		return FALSE;
+	}
+
+	PreviousPosition = 0;
+	OutputPosition = 0;
+
+	for (Position = 0; Position < NumberOfEntries; ++Position) {
+		ULONGLONG Key;
+		ULONG Low;
+		ULONG High;
+
+		Key = SortPass->Keys[Run[Position] - SortPass->FirstEntryIndex];
+		Low = PreviousPosition;
+		High = SortPass->FirstEntryIndex;
+
+		// the old entries come first when the keys are equal
+		while (Low < High) {
+			ULONG Middle;
+
+			Middle = Low + (High - Low) / 2;
+
+			if (GetSortKey(SortPass, SortPass->PreviousOrder[Middle]) <= Key) {
+				Low = Middle + 1;
+			} else {
+				High = Middle;
+			}
+		}
+
+		CopyMemory(
+			&SortPass->SortedOrder[OutputPosition],
+			&SortPass->PreviousOrder[PreviousPosition],
+			(Low - PreviousPosition) * sizeof(ULONG));
+
+		OutputPosition += Low - PreviousPosition;
+		PreviousPosition = Low;
+		SortPass->SortedOrder[OutputPosition++] = Run[Position];
+	}
+
+	CopyMemory(
+		&SortPass->SortedOrder[OutputPosition],
+		&SortPass->PreviousOrder[PreviousPosition],
+		(SortPass->FirstEntryIndex - PreviousPosition) * sizeof(ULONG));
+
+	return TRUE;
+}
+
+//
+// Called by whoever sorted a chunk. Merges the chunk with its neighbour, and
+// the result with its neighbour and so on, as far as it can: if a neighbour
+// isn't finished yet, the worker which finishes it carries on instead.
+//
+STATIC VOID MergeSortedChunk(
+	IN	PSORTPASS	SortPass,
+	IN	ULONG		ChunkIndex)
+{
+	ULONG Level;
+	ULONG RunIndex;
+	ULONG CounterBase;
+
+	Level = 0;
+	RunIndex = ChunkIndex;
+	CounterBase = 0;
+
+	while (Level < SortPass->NumberOfLevels) {
+		if ((RunIndex ^ 1) < GetNumberOfRunsAtLevel(SortPass, Level)) {
+			// The other half exists. Whoever gets here second does the merge.
+			if (InterlockedIncrement(&SortPass->MergeCounters[CounterBase + RunIndex / 2]) == 1) {
+				return;
+			}
+		}
+
+		if (SortPass->Cancelled) {
+			return;
+		}
+
+		CounterBase += GetNumberOfRunsAtLevel(SortPass, Level + 1);
+		RunIndex /= 2;
+		++Level;
+
+		MergeRunAtLevel(SortPass, Level, RunIndex);
+	}
+
+	//
+	// This was the last merge, so everything from FirstEntryIndex onwards
+	// is sorted.
+	//
+
+	if (SortPass->FirstEntryIndex == 0) {
+		SortPass->SortedOrder = SortPass->Runs[Level & 1];
+		SortPass->Runs[Level & 1] = NULL;
+	} else {
+		unless (MergeWithPreviousOrder(SortPass, SortPass->Runs[Level & 1])) {
+			SortPass->Failed = TRUE;
+		}
+	}
+}
+
+STATIC NTSTATUS NTAPI SortWorkerThreadProc(
+	IN	PVOID	Parameter)
+{
+	PSORTPASS SortPass;
+	ULONG ChunkIndex;
+
+	SortPass = (PSORTPASS) Parameter;
+
+	until (SortPass->Cancelled) {
+		ChunkIndex = InterlockedIncrement(&SortPass->NextChunk) - 1;
+
+		if (ChunkIndex >= SortPass->NumberOfChunks) {
+			break;
+		}
+
+		if (!SortChunk(SortPass, ChunkIndex)) {
+			break;
+		}
+
+		MergeSortedChunk(SortPass, ChunkIndex);
+	}
+
+	if (InterlockedDecrement(&SortPass->NumberOfActiveWorkers) == 0) {
+		PostMessage(MainWindow, WM_SORTPASSCOMPLETE, SortPass->Generation, 0);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+//
+// Wait for the workers of a sort pass to exit and free everything belonging
+// to it.
+//
+STATIC VOID DestroySortPass(
+	IN	PSORTPASS	SortPass)
+{
+	ULONG Index;
+
+	if (SortPass->NumberOfWorkers != 0) {
+		NtWaitForMultipleObjects(
+			SortPass->NumberOfWorkers,
+			SortPass->WorkerThreads,
+			WaitAllObject,
+			FALSE,
+			NULL);
+
+		for (Index = 0; Index < SortPass->NumberOfWorkers; ++Index) {
+			NtClose(SortPass->WorkerThreads[Index]);
+		}
+	}
+
+	SafeFree(SortPass->Ranks);
+	SafeFree(SortPass->Keys);
+	SafeFree(SortPass->Runs[0]);
+	SafeFree(SortPass->Runs[1]);
+	SafeFree(SortPass->SortedOrder);
+	SafeFree(SortPass->MergeCounters);
+	SafeFree(SortPass);
+}
+
+//
+// Sort the entries which haven't been sorted yet (all of them, the first
+// time) in the background, and merge them into the sorted order. Any pass
+// which is already running is cancelled. Does nothing if the entries are
+// shown in file order.
+//
+VOID StartSortPass(
+	VOID)
+{
+	NTSTATUS Status;
+	PSORTPASS SortPass;
+	ULONG NumberOfEntries;
+	ULONG NumberOfCounters;
+	ULONG NumberOfWorkers;
+	ULONG Level;
+
+	CancelSortPass();
+
+	if (State->SortKey == SortKeyNone) {
+		return;
+	}
+
+	SortPass = SafeAlloc(SORTPASS, 1);
+	if (!SortPass) {
+		return;
+	}
+
+	RtlZeroMemory(SortPass, sizeof(*SortPass));
+	SortPass->Generation = ++State->SortPassGeneration;
+	SortPass->SortKey = State->SortKey;
+	SortPass->Descending = State->SortDescending;
+	SortPass->FirstEntryIndex = State->SortedNumberOfLogEntries;
+	SortPass->NumberOfLogEntries = State->NumberOfLogEntries;
+	SortPass->PreviousOrder = State->SortedOrder;
+	ASSERT (SortPass->FirstEntryIndex <= SortPass->NumberOfLogEntries);
+
+	NumberOfEntries = SortPass->NumberOfLogEntries - SortPass->FirstEntryIndex;
+	SortPass->NumberOfChunks = (NumberOfEntries + SORT_CHUNK_SIZE - 1) / SORT_CHUNK_SIZE;
+
+	if (SortPass->NumberOfChunks == 0) {
+		// nothing new
+		SafeFree(SortPass);
+		return;
+	}
+
+	if (SortPass->SortKey == SortKeySourceComponent) {
+		if (!RankSourceStrings(SortPass, VxlSourceComponent)) goto Failure;
+	} else if (SortPass->SortKey == SortKeySourceFile) {
+		if (!RankSourceStrings(SortPass, VxlSourceFile)) goto Failure;
+	} else if (SortPass->SortKey == SortKeySourceFunction) {
+		if (!RankSourceStrings(SortPass, VxlSourceFunction)) goto Failure;
+	}
+
+	//
+	// Every level of merges has half as many runs as the one below it, so
+	// there are fewer counters than chunks, apart from the ones which are
+	// left over when a level has an odd number of runs.
+	//
+
+	NumberOfCounters = 0;
+
+	for (Level = 1; GetNumberOfRunsAtLevel(SortPass, Level - 1) > 1; ++Level) {
+		NumberOfCounters += GetNumberOfRunsAtLevel(SortPass, Level);
+	}
+
+	SortPass->NumberOfLevels = Level - 1;
+	SortPass->Keys = SafeAlloc(ULONGLONG, NumberOfEntries);
+	SortPass->Runs[0] = SafeAlloc(ULONG, NumberOfEntries);
+	SortPass->Runs[1] = SafeAlloc(ULONG, NumberOfEntries);
+	SortPass->MergeCounters = SafeAlloc(LONG, max(NumberOfCounters, 1));
+
+	if (!SortPass->Keys || !SortPass->Runs[0] || !SortPass->Runs[1] || !SortPass->MergeCounters) {
+		goto Failure;
+	}
+
+	RtlZeroMemory(SortPass->MergeCounters, max(NumberOfCounters, 1) * sizeof(LONG));
+	State->SortPass = SortPass;
+
+	//
+	// The entries which are added to a log while it is open don't need
+	// threads to sort them.
+	//
+
+	if (SortPass->NumberOfChunks == 1) {
+		SortChunk(SortPass, 0);
+		MergeSortedChunk(SortPass, 0);
+		FinishSortPass(SortPass->Generation);
+		return;
+	}
+
+	NumberOfWorkers = min(NtCurrentPeb()->NumberOfProcessors, SortPass->NumberOfChunks);
+	NumberOfWorkers = max(NumberOfWorkers, 1);
+	NumberOfWorkers = min(NumberOfWorkers, SORT_MAXIMUM_WORKERS);
+	SortPass->NumberOfActiveWorkers = NumberOfWorkers;
+
+	while (SortPass->NumberOfWorkers < NumberOfWorkers) {
+		Status = RtlCreateUserThread(
+			NtCurrentProcess(),
+			NULL,
+			FALSE,
+			0,
+			0,
+			0,
+			SortWorkerThreadProc,
+			SortPass,
+			&SortPass->WorkerThreads[SortPass->NumberOfWorkers],
+			NULL);
+
+		if (!NT_SUCCESS(Status)) {
+			break;
+		}
+
+		++SortPass->NumberOfWorkers;
+	}
+
+	if (SortPass->NumberOfWorkers < NumberOfWorkers) {
+		//
+		// Account for the workers which couldn't be started. If that leaves
+		// none running, finish the pass on this thread.
+		//
+
+		if (InterlockedExchangeAdd(
+				&SortPass->NumberOfActiveWorkers,
+				-(LONG) (NumberOfWorkers - SortPass->NumberOfWorkers)) ==
+			(LONG) (NumberOfWorkers - SortPass->NumberOfWorkers)) {
+
+			SortPass->NumberOfActiveWorkers = 1;
+			SortWorkerThreadProc(SortPass);
+			return;
+		}
+	}
+
+	SetClassLongPtr(MainWindow, GCLP_HCURSOR, (LONG_PTR) LoadCursor(NULL, IDC_APPSTARTING));
+	return;
+
+Failure:
+	DestroySortPass(SortPass);
+}
+
+//
+// Stop the sort pass which is in progress, if there is one, and throw away
+// its results. Must be called before the log entry cache is changed.
+//
+VOID CancelSortPass(
+	VOID)
+{
+	if (!State->SortPass) {
+		return;
+	}
+
+	State->SortPass->Cancelled = TRUE;
+	DestroySortPass(State->SortPass);
+	State->SortPass = NULL;
+
+	if (!State->FilterPass) {
+		SetClassLongPtr(MainWindow, GCLP_HCURSOR, (LONG_PTR) LoadCursor(NULL, IDC_ARROW));
+	}
+}
+
+//
+// Make the lookup table for the list view out of the sorted order and the
+// results of the filters. The entries which haven't been sorted yet go at
+// the end, in file order.
+//
+VOID RebuildSortedLookupCache(
+	VOID)
+{
+	PULONG Matches;
+	ULONG NumberOfSortedMatches;
+	ULONG FirstUnsortedMatch;
+	ULONG Index;
+
+	SafeFree(State->SortedLookupCache);
+
+	if (State->SortKey == SortKeyNone || !State->SortedOrder || State->FilteredNumberOfLogEntries == 0) {
+		return;
+	}
+
+	//
+	// Mark the entries which match the filters in a bitmap, so that the
+	// sorted order can be walked through once.
+	//
+
+	Matches = SafeAlloc(ULONG, (State->SortedNumberOfLogEntries + 31) / 32);
+	State->SortedLookupCache = SafeAlloc(ULONG, State->FilteredNumberOfLogEntries);
+
+	if (!Matches || !State->SortedLookupCache) {
+		// show them in file order instead
+		SafeFree(Matches);
+		SafeFree(State->SortedLookupCache);
+		return;
+	}
+
+	RtlZeroMemory(Matches, ((State->SortedNumberOfLogEntries + 31) / 32) * sizeof(ULONG));
+
+	// the filtered lookup table is in file order
+	for (Index = 0; Index < State->FilteredNumberOfLogEntries; ++Index) {
+		ULONG RawIndex;
+
+		RawIndex = State->FilteredLookupCache[Index];
+
+		if (RawIndex >= State->SortedNumberOfLogEntries) {
+			break;
+		}
+
+		Matches[RawIndex / 32] |= 1UL << (RawIndex % 32);
+	}
+
+	FirstUnsortedMatch = Index;
+	NumberOfSortedMatches = 0;
+
+	for (Index = 0; Index < State->SortedNumberOfLogEntries; ++Index) {
+		ULONG RawIndex;
+
+		RawIndex = State->SortedOrder[Index];
+
+		if (Matches[RawIndex / 32] & (1UL << (RawIndex % 32))) {
+			State->SortedLookupCache[NumberOfSortedMatches++] = RawIndex;
+		}
+	}
+
+	ASSERT (NumberOfSortedMatches == FirstUnsortedMatch);
+
+	CopyMemory(
+		&State->SortedLookupCache[NumberOfSortedMatches],
+		&State->FilteredLookupCache[FirstUnsortedMatch],
+		(State->FilteredNumberOfLogEntries - FirstUnsortedMatch) * sizeof(ULONG));
+
+	SafeFree(Matches);
+}
+
+//
+// Show the list in a different order. The entry which was selected stays
+// selected.
+//
+STATIC VOID RefreshSortedListView(
+	VOID)
+{
+	ULONG SelectedRawIndex;
+	ULONG SelectedIndex;
+
+	SelectedIndex = ListView_GetNextItem(ListViewWindow, -1, LVNI_FOCUSED);
+	SelectedRawIndex = GetLogEntryRawIndex(SelectedIndex);
+
+	RebuildSortedLookupCache();
+	InvalidateRect(ListViewWindow, NULL, FALSE);
+
+	if (SelectedRawIndex != -1) {
+		SelectedIndex = GetLogEntryIndexFromRawIndex(SelectedRawIndex);
+
+		if (SelectedIndex != -1) {
+			SelectListViewItemByIndex(SelectedIndex);
+		}
+	}
+}
+
+//
+// Called when all the workers of a sort pass have finished (or straight
+// away, for small passes).
+//
+VOID FinishSortPass(
+	IN	ULONG	Generation)
+{
+	PSORTPASS SortPass;
+
+	SortPass = State->SortPass;
+
+	if (!SortPass || SortPass->Generation != Generation) {
+		// cancelled
+		return;
+	}
+
+	if (SortPass->Failed || !SortPass->SortedOrder) {
+		CancelSortPass();
+		return;
+	}
+
+	SafeFree(State->SortedOrder);
+	State->SortedOrder = SortPass->SortedOrder;
+	State->SortedNumberOfLogEntries = SortPass->NumberOfLogEntries;
+	SortPass->SortedOrder = NULL;
+
+	// nothing left to cancel, this just cleans up
+	CancelSortPass();
+
+	RefreshSortedListView();
+}
+
+//
+// Change the order which the log entries are shown in.
+//
+VOID SortLogEntries(
+	IN	LOGENTRYSORTKEY	SortKey,
+	IN	BOOLEAN			Descending)
+{
+	if (SortKey == SortKeyNone) {
+		Descending = FALSE;
+	}
+
+	if (SortKey == State->SortKey && Descending == State->SortDescending) {
+		return;
+	}
+
+	CancelSortPass();
+	SafeFree(State->SortedOrder);
+
+	State->SortKey = SortKey;
+	State->SortDescending = Descending;
+	State->SortedNumberOfLogEntries = 0;
+
+	RefreshSortedListView();
+	StartSortPass();
+}
\ No newline at end of file
@@ -48,6 +48,8 @@ PCWSTR VxlSeverityToText(
 NTSTATUS NTAPI EntryPoint(
 	IN	PVOID	Parameter)
 {
+	NTSTATUS Status;
+	PCWSTR CommandLine;
 	HACCEL Accelerators;
 	MSG Message;
 	INITCOMMONCONTROLSEX InitComctl;
@@ -78,6 +80,20 @@ NTSTATUS NTAPI EntryPoint(
 
 	KexgApplicationFriendlyName = FRIENDLYAPPNAME;
 
+	//
+	// VxlView.exe /EXPORT ... converts a log without showing any windows.
+	//
+
+	CommandLine = GetCommandLineWithoutImageName();
+	if (StringBeginsWithI(CommandLine, L"/EXPORT")) {
+		Status = ExportLogHeadless(CommandLine);
+		LdrShutdownProcess();
+		return NtTerminateProcess(NtCurrentProcess(), Status);
+	}
+
+	// for the folder picker
+	CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+
 	Accelerators = LoadAccelerators(NULL, MAKEINTRESOURCE(IDA_ACCELERATORS));
 	CreateDialog(NULL, MAKEINTRESOURCE(IDD_MAINWND), NULL, MainWndProc);
 
@@ -139,6 +155,14 @@ INT_PTR CALLBACK MainWndProc(
 		if (!Success) {
 			ExitProcess(0);
 		}
+
+		SetTimer(MainWindow, FOLLOW_TIMER_ID, FOLLOW_TIMER_INTERVAL, NULL);
+	} else if (Message == WM_TIMER && WParam == FOLLOW_TIMER_ID) {
+		CheckForNewLogEntries();
+	} else if (Message == WM_FILTERPASSCOMPLETE) {
+		FinishFilterPass((ULONG) WParam);
+	} else if (Message == WM_SORTPASSCOMPLETE) {
+		FinishSortPass((ULONG) WParam);
 	} else if (Message == WM_CLOSE) {
 		SaveListViewColumns();
 		SaveWindowPlacement();
@@ -185,6 +209,9 @@ INT_PTR CALLBACK MainWndProc(
 		case M_OPEN:
 			OpenLogFileWithPrompt();
 			break;
+		case M_OPENFOLDER:
+			OpenLogFolderWithPrompt();
+			break;
 		case M_EXPORT:
 			ExportLogWithPrompt();
 			break;
@@ -222,6 +249,13 @@ INT_PTR CALLBACK MainWndProc(
 
 				Item = &((NMLVDISPINFO *) LParam)->item;
 				PopulateListViewItem(Item);
+			} else if (Notification->code == LVN_ODCACHEHINT) {
+				LPNMLVCACHEHINT CacheHint;
+
+				CacheHint = (LPNMLVCACHEHINT) LParam;
+				PrefetchLogEntries(CacheHint->iFrom, CacheHint->iTo);
+			} else if (Notification->code == LVN_COLUMNCLICK) {
+				HandleListViewColumnClick(((LPNMLISTVIEW) LParam)->iSubItem);
 			} else if (Notification->code == LVN_ITEMCHANGED) {
 				LPNMLISTVIEW ChangedItemInfo;
 
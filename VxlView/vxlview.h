@@ -5,6 +5,18 @@
 
 #define UNCONST(Type) *(Type*)&
 
+// timer which checks whether entries have been added to the open log
+#define FOLLOW_TIMER_ID 1
+#define FOLLOW_TIMER_INTERVAL 1000
+
+// posted to the main window when the filters have been run over the log
+// WParam is the generation of the filter pass
+#define WM_FILTERPASSCOMPLETE (WM_APP + 1)
+
+// posted to the main window when the log entries have been sorted
+// WParam is the generation of the sort pass
+#define WM_SORTPASSCOMPLETE (WM_APP + 2)
+
 EXTERN LANGID CURRENTLANG;
 EXTERN PWSTR FRIENDLYAPPNAME;
 
@@ -19,11 +31,22 @@ typedef enum {
 	ColumnMaxValue
 } LOGENTRYCOLUMNS;
 
-typedef struct {
-	VXLLOGENTRY LogEntry;
-	WCHAR SourceLineAsString[11];
-	WCHAR ShortDateTimeAsString[32];
-} LOGENTRYCACHEENTRY, *PLOGENTRYCACHEENTRY, **PPLOGENTRYCACHEENTRY, *CONST PCLOGENTRYCACHEENTRY, **CONST PPCLOGENTRYCACHEENTRY;
+//
+// Orders which the log entries can be shown in. Entries which compare equal
+// are always kept in file order.
+//
+typedef enum {
+	SortKeyNone,								// file order
+	SortKeySeverity,
+	SortKeyDateTime,
+	SortKeySourceComponent,
+	SortKeySourceFile,							// then by line
+	SortKeySourceLine,
+	SortKeySourceFunction,
+	SortKeyProcessId,
+	SortKeyThreadId,
+	SortKeyMaxValue
+} LOGENTRYSORTKEY;
 
 typedef struct {
 	UNICODE_STRING TextFilter;					// same as what user typed in search box
@@ -33,9 +56,22 @@ typedef struct {
 	BOOLEAN TextFilterExact;
 	BOOLEAN TextFilterWhole;
 	BOOLEAN SeverityFilters[LogSeverityMaximumValue];
-	BOOLEAN ComponentFilters[64];
+	BOOLEAN ComponentFilters[256];
 } BACKENDFILTERS, *PBACKENDFILTERS, **PPBACKENDFILTERS, *CONST PCBACKENDFILTERS, **CONST PPCBACKENDFILTERS;
 
+//
+// Formats which a log can be exported in. ExportFormatText is what the log
+// viewer has always exported: UTF-16, with dates in the user's locale. KexDll
+// can't format dates like that, so the viewer writes that one itself. The
+// rest are written by VxlExportMergedLogs.
+//
+typedef enum {
+	ExportFormatText,
+	ExportFormatTextUtf8,
+	ExportFormatCsv,
+	ExportFormatJsonLines
+} EXPORTFORMAT;
+
 // backend.c
 
 VOID InitializeBackend(
@@ -48,22 +84,48 @@ BOOLEAN OpenLogFile(
 	IN	PCWSTR	LogFileName);
 BOOLEAN OpenLogFileWithPrompt(
 	VOID);
+BOOLEAN OpenLogFolderWithPrompt(
+	VOID);
 VOID ExportLog(
-	IN	PCWSTR	TextFileName);
+	IN	PCWSTR			TextFileName,
+	IN	EXPORTFORMAT	Format);
 BOOLEAN ExportLogWithPrompt(
 	VOID);
+NTSTATUS ExportLogHeadless(
+	IN	PCWSTR	CommandLine);
 ULONG GetLogEntryRawIndex(
 	IN	ULONG	EntryIndex);
 ULONG GetLogEntryIndexFromRawIndex(
 	IN	ULONG	RawIndex);
-PLOGENTRYCACHEENTRY GetLogEntry(
-	IN	ULONG	EntryIndex);
+BOOLEAN GetLogEntry(
+	IN	ULONG			EntryIndex,
+	OUT	PVXLLOGENTRY	LogEntry);
+VOID PrefetchLogEntries(
+	IN	ULONG	FirstEntryIndex,
+	IN	ULONG	LastEntryIndex);
 VOID SetBackendFilters(
 	IN	PBACKENDFILTERS	Filters);
-NTSTATUS ConvertCacheEntryToText(
-	IN	PLOGENTRYCACHEENTRY	CacheEntry,
+VOID UpdateSourceComponents(
+	VOID);
+VOID CheckForNewLogEntries(
+	VOID);
+VOID FinishFilterPass(
+	IN	ULONG	Generation);
+NTSTATUS ConvertLogEntryToText(
+	IN	PVXLLOGENTRY		LogEntry,
+	OUT	PUNICODE_STRING		ExportedText,
+	IN	BOOLEAN				LongForm);
+NTSTATUS FormatLogEntryText(
+	IN	PVXLLOGENTRY		LogEntry,
+	IN	PCWSTR				SourceComponent,
+	IN	PCWSTR				SourceFile,
+	IN	PCWSTR				SourceFunction,
 	OUT	PUNICODE_STRING		ExportedText,
 	IN	BOOLEAN				LongForm);
+VOID FormatShortDateTime(
+	IN	PSYSTEMTIME	Time,
+	OUT	PWSTR		Buffer,
+	IN	ULONG		BufferCch);
 
 // config.c
 
@@ -144,6 +206,18 @@ VOID HandleListViewContextMenu(
 	IN	PPOINT	ClickPoint);
 VOID SelectListViewItemByIndex(
 	IN	ULONG	Index);
+VOID HandleListViewColumnClick(
+	IN	ULONG	Column);
+VOID UpdateListViewSortIndicators(
+	VOID);
+
+// sort.c
+
+VOID SortLogEntries(
+	IN	LOGENTRYSORTKEY	SortKey,
+	IN	BOOLEAN			Descending);
+VOID FinishSortPass(
+	IN	ULONG	Generation);
 
 // statusbar.c
 